@@ -3,10 +3,17 @@
 #include <debug.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
+#include "threads/percpu.h"
+#include "threads/spinlock.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/trace.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
 
 /* The code in this file is an interface to an ATA (IDE)
    controller.  It attempts to comply to [ATA-3]. */
@@ -14,6 +21,7 @@
 /* ATA command block port addresses. */
 #define reg_data(CHANNEL) ((CHANNEL)->reg_base + 0)     /* Data. */
 #define reg_error(CHANNEL) ((CHANNEL)->reg_base + 1)    /* Error. */
+#define reg_features(CHANNEL) reg_error (CHANNEL)       /* Features (w/o). */
 #define reg_nsect(CHANNEL) ((CHANNEL)->reg_base + 2)    /* Sector Count. */
 #define reg_lbal(CHANNEL) ((CHANNEL)->reg_base + 3)     /* LBA 0:7. */
 #define reg_lbam(CHANNEL) ((CHANNEL)->reg_base + 4)     /* LBA 15:8. */
@@ -28,10 +36,24 @@
 #define reg_ctl(CHANNEL) ((CHANNEL)->reg_base + 0x206)  /* Control (w/o). */
 #define reg_alt_status(CHANNEL) reg_ctl (CHANNEL)       /* Alt Status (r/o). */
 
+/* Bus master IDE port addresses, for DMA. */
+#define reg_bm_command(CHANNEL) ((CHANNEL)->bm_base + 0)  /* Command. */
+#define reg_bm_status(CHANNEL) ((CHANNEL)->bm_base + 2)   /* Status. */
+#define reg_bm_prdt(CHANNEL) ((CHANNEL)->bm_base + 4)     /* PRD table. */
+
+/* Bus master Command Register bits. */
+#define BM_CMD_START 0x01       /* Start transfer. */
+#define BM_CMD_READ 0x08        /* Transfer from disk to memory. */
+
+/* Bus master Status Register bits, cleared by writing 1. */
+#define BM_STA_ERR 0x02         /* Error. */
+#define BM_STA_INTR 0x04        /* Interrupt. */
+
 /* Alternate Status Register bits. */
 #define STA_BSY 0x80            /* Busy. */
 #define STA_DRDY 0x40           /* Device Ready. */
 #define STA_DRQ 0x08            /* Data Request. */
+#define STA_ERR 0x01            /* Error. */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04           /* Software Reset. */
@@ -47,6 +69,50 @@
 #define CMD_IDENTIFY_DEVICE 0xec        /* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
+#define CMD_READ_MULTIPLE 0xc4          /* READ MULTIPLE. */
+#define CMD_WRITE_MULTIPLE 0xc5         /* WRITE MULTIPLE. */
+#define CMD_SET_MULTIPLE_MODE 0xc6      /* SET MULTIPLE MODE. */
+#define CMD_READ_DMA 0xc8               /* READ DMA. */
+#define CMD_WRITE_DMA 0xca              /* WRITE DMA. */
+#define CMD_READ_SECTOR_EXT 0x24        /* READ SECTOR EXT. */
+#define CMD_WRITE_SECTOR_EXT 0x34       /* WRITE SECTOR EXT. */
+#define CMD_READ_MULTIPLE_EXT 0x29      /* READ MULTIPLE EXT. */
+#define CMD_WRITE_MULTIPLE_EXT 0x39     /* WRITE MULTIPLE EXT. */
+#define CMD_READ_DMA_EXT 0x25           /* READ DMA EXT. */
+#define CMD_WRITE_DMA_EXT 0x35          /* WRITE DMA EXT. */
+#define CMD_FLUSH_CACHE 0xe7            /* FLUSH CACHE. */
+#define CMD_FLUSH_CACHE_EXT 0xea        /* FLUSH CACHE EXT. */
+#define CMD_SET_FEATURES 0xef           /* SET FEATURES. */
+
+/* SET FEATURES subcommands. */
+#define FEAT_WCACHE_ON 0x02             /* Enable write cache. */
+
+/* Sectors that 28-bit LBA commands can reach.  Beyond, a disk that
+   supports it is addressed with the 48-bit EXT commands, which take
+   each register twice, high-order byte first. */
+#define LBA28_SECTORS (1ULL << 28)
+
+/* Physical region descriptor, one piece of memory for the bus
+   master to transfer.  A piece may not cross a 64 kB boundary. */
+struct prd {
+	uint32_t addr;              /* Physical address. */
+	uint16_t size;              /* Bytes, with 0 meaning 64 kB. */
+	uint16_t flags;             /* PRD_EOT in the last descriptor. */
+};
+#define PRD_EOT 0x8000          /* End of table. */
+
+/* Most bios merged into one command, and the descriptors needed
+   for the largest such command. */
+#define BIO_MERGE_MAX 16
+#define PRD_CNT (DISK_MULTIPLE_MAX * DISK_SECTOR_SIZE / 0x10000 + BIO_MERGE_MAX)
+
+/* Ticks a best-effort bio may wait in the queue before it goes
+   first.  Real-time bios wait half as long, idle ones twice. */
+#define BIO_DEADLINE (TIMER_FREQ / 2)
+
+/* Use DMA where possible?  Cleared by the kernel command line option
+   -pio. */
+bool disk_use_dma = true;
 
 /* An ATA device. */
 struct disk {
@@ -56,9 +122,19 @@ struct disk {
 
 	bool is_ata;                /* 1=This device is an ATA disk. */
 	disk_sector_t capacity;     /* Capacity in sectors (if is_ata). */
-
-	long long read_cnt;         /* Number of sectors read. */
-	long long write_cnt;        /* Number of sectors written. */
+	bool lba48;                 /* Supports 48-bit LBA? */
+	bool write_cache;           /* Write cache enabled, to be flushed? */
+	bool flush_ext;             /* Supports FLUSH CACHE EXT? */
+	size_t block_cnt;           /* Sectors per interrupt with READ and
+								   WRITE MULTIPLE, or 1 if not used. */
+	bool dma;                   /* Transfer by DMA when possible? */
+
+	struct percpu_counter read_cnt;  /* Number of sectors read. */
+	struct percpu_counter write_cnt; /* Number of sectors written. */
+
+	/* Covered by disabling interrupts. */
+	struct diskstat stats;      /* Statistics of requests. */
+	unsigned in_flight;         /* Requests submitted, not completed. */
 };
 
 /* An ATA channel (aka controller).
@@ -67,40 +143,69 @@ struct channel {
 	char name[8];               /* Name, e.g. "hd0". */
 	uint16_t reg_base;          /* Base I/O port. */
 	uint8_t irq;                /* Interrupt in use. */
+	uint16_t bm_base;           /* Bus master base I/O port, or 0 if the
+								   channel cannot do DMA. */
+	struct prd prd[PRD_CNT]     /* Descriptors for the bus master. */
+		__attribute__ ((aligned (256)));
 
 	struct lock lock;           /* Must acquire to access the controller. */
 	bool expecting_interrupt;   /* True if an interrupt is expected, false if
 								   any interrupt would be spurious. */
 	struct semaphore completion_wait;   /* Up'd by interrupt handler. */
 
+	struct spinlock queue_lock; /* Protects QUEUE, HEAD and the
+								   statistics of DEVICES. */
+	struct list queue;          /* Submitted bios, oldest first. */
+	struct semaphore queue_cnt; /* Number of bios in queue. */
+	uint64_t head;              /* Position after the last request, as
+								   bio_position() gives it. */
+
 	struct disk devices[2];     /* The devices on this channel. */
+
+	bool probed;                /* Devices known yet? */
+	struct semaphore probe_done;    /* Up'd once probed is set. */
 };
 
 /* We support the two "legacy" ATA channels found in a standard PC. */
 #define CHANNEL_CNT 2
 static struct channel channels[CHANNEL_CNT];
 
+/* Keeps the lines that the channels' probes print whole. */
+static struct lock identify_lock;
+
 static void reset_channel (struct channel *);
 static bool check_device_type (struct disk *);
 static void identify_ata_device (struct disk *);
+static bool set_feature (struct disk *, uint8_t feature);
+
+static void set_multiple_mode (struct disk *, size_t block_cnt);
 
-static void select_sector (struct disk *, disk_sector_t);
+static bool select_sector (struct disk *, disk_sector_t, size_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
-static void input_sector (struct channel *, void *);
-static void output_sector (struct channel *, const void *);
+static void input_sectors (struct channel *, void *, size_t cnt);
+static void output_sectors (struct channel *, const void *, size_t cnt);
 
 static void wait_until_idle (const struct disk *);
 static bool wait_while_busy (const struct disk *);
 static void select_device (const struct disk *);
 static void select_device_wait (const struct disk *);
 
+static uint16_t find_bus_master (void);
+static bool dma_transfer (struct bio *, size_t cnt);
+static void pio_transfer (struct bio *, size_t cnt);
+
+static void channel_thread (void *channel_);
+static bool wait_probed (struct channel *);
+
 static void interrupt_handler (struct intr_frame *);
 
-/* Initialize the disk subsystem and detect disks. */
+/* Initialize the disk subsystem and start detecting disks. */
 void
 disk_init (void) {
+	uint16_t bm_base = disk_use_dma ? find_bus_master () : 0;
 	size_t chan_no;
 
+	lock_init (&identify_lock);
 	for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++) {
 		struct channel *c = &channels[chan_no];
 		int dev_no;
@@ -119,9 +224,17 @@ disk_init (void) {
 			default:
 				NOT_REACHED ();
 		}
+		c->bm_base = bm_base != 0 ? bm_base + 8 * chan_no : 0;
 		lock_init (&c->lock);
+		lock_register (&c->lock, c->name);
 		c->expecting_interrupt = false;
 		sema_init (&c->completion_wait, 0);
+		spin_lock_init (&c->queue_lock);
+		list_init (&c->queue);
+		sema_init (&c->queue_cnt, 0);
+		c->head = 0;
+		c->probed = false;
+		sema_init (&c->probe_done, 0);
 
 		/* Initialize devices. */
 		for (dev_no = 0; dev_no < 2; dev_no++) {
@@ -132,24 +245,25 @@ disk_init (void) {
 
 			d->is_ata = false;
 			d->capacity = 0;
-
-			d->read_cnt = d->write_cnt = 0;
+			d->lba48 = false;
+			d->write_cache = d->flush_ext = false;
+			d->block_cnt = 1;
+			d->dma = false;
+
+			percpu_counter_reset (&d->read_cnt);
+			percpu_counter_reset (&d->write_cnt);
+			memset (&d->stats, 0, sizeof d->stats);
+			d->in_flight = 0;
 		}
 
 		/* Register interrupt handler. */
 		intr_register_ext (c->irq, interrupt_handler, c->name);
 
-		/* Reset hardware. */
-		reset_channel (c);
-
-		/* Distinguish ATA hard disks from other devices. */
-		if (check_device_type (&c->devices[0]))
-			check_device_type (&c->devices[1]);
-
-		/* Read hard disk identity information. */
-		for (dev_no = 0; dev_no < 2; dev_no++)
-			if (c->devices[dev_no].is_ata)
-				identify_ata_device (&c->devices[dev_no]);
+		/* Start the thread that probes the channel and then runs its
+		   requests.  Probing waits 150 ms for the reset alone, so the
+		   channels are probed at the same time, while the boot goes
+		   on; disk_get() waits only for the channel it looks at. */
+		thread_create (c->name, PRI_MAX, channel_thread, c);
 	}
 
 	/* DO NOT MODIFY BELOW LINES. */
@@ -166,13 +280,101 @@ disk_print_stats (void) {
 
 		for (dev_no = 0; dev_no < 2; dev_no++) {
 			struct disk *d = disk_get (chan_no, dev_no);
-			if (d != NULL && d->is_ata)
-				printf ("%s: %lld reads, %lld writes\n",
-						d->name, d->read_cnt, d->write_cnt);
+			if (d != NULL && d->is_ata) {
+				struct diskstat ds;
+				uint64_t requests;
+
+				printf ("%s: %lld reads, %lld writes\n", d->name,
+						(long long) percpu_counter_read (&d->read_cnt),
+						(long long) percpu_counter_read (&d->write_cnt));
+				disk_get_stats (d, &ds);
+				requests = ds.reads + ds.writes;
+				if (requests == 0)
+					continue;
+				printf ("%s: %llu read and %llu write requests, "
+						"%llu bytes read, %llu bytes written\n",
+						d->name, ds.reads, ds.writes, ds.bytes_read,
+						ds.bytes_written);
+				printf ("%s: queue depth %llu max, %llu.%02llu average, "
+						"%llu cycles busy\n", d->name, ds.queue_depth_max,
+						ds.queue_depth_sum / requests,
+						ds.queue_depth_sum * 100 / requests % 100,
+						ds.busy_cycles);
+				for (size_t i = 0; i < DISKSTAT_SIZES; i++)
+					if (ds.sizes[i] > 0)
+						printf ("%s: %llu requests of %zu to %zu sectors\n",
+								d->name, ds.sizes[i], (size_t) 1 << i,
+								((size_t) 2 << i) - 1);
+				for (size_t i = 0; i < DISKSTAT_BUCKETS; i++)
+					if (ds.latency[i] > 0)
+						printf ("%s: %llu requests under 2^%zu cycles\n",
+								d->name, ds.latency[i], i + DISKSTAT_SHIFT + 1);
+			}
 		}
 	}
 }
 
+/* Copies the request statistics of disk D into DS. */
+void
+disk_get_stats (struct disk *d, struct diskstat *ds) {
+	ASSERT (d != NULL);
+
+	spin_lock (&d->channel->queue_lock);
+	*ds = d->stats;
+	spin_unlock (&d->channel->queue_lock);
+}
+
+/* Returns the bucket of the log2 histogram of VALUE >> SHIFT, with
+   BUCKETS buckets, that VALUE belongs in. */
+static size_t
+log2_bucket (uint64_t value, int shift, size_t buckets) {
+	size_t bucket = 0;
+
+	for (value >>= shift; value > 1 && bucket < buckets - 1; value >>= 1)
+		bucket++;
+	return bucket;
+}
+
+/* Counts the submission of bio B in its disk's statistics.  The
+   channel's queue_lock must be held. */
+static void
+stats_submit (struct bio *b) {
+	struct diskstat *ds = &b->disk->stats;
+
+	ASSERT (b->disk->channel->queue_lock.locked);
+
+	b->submitted = rdtsc ();
+	if (b->write) {
+		ds->writes++;
+		ds->bytes_written += b->cnt * DISK_SECTOR_SIZE;
+	} else {
+		ds->reads++;
+		ds->bytes_read += b->cnt * DISK_SECTOR_SIZE;
+	}
+	ds->sizes[log2_bucket (b->cnt, 0, DISKSTAT_SIZES)]++;
+	ds->queue_depth_sum += ++b->disk->in_flight;
+	if (b->disk->in_flight > ds->queue_depth_max)
+		ds->queue_depth_max = b->disk->in_flight;
+}
+
+/* Counts the completion of the bios of request REQ, which kept
+   their disk busy from TSC START to END. */
+static void
+stats_complete (struct bio *req, uint64_t start, uint64_t end) {
+	struct diskstat *ds = &req->disk->stats;
+	struct spinlock *queue_lock = &req->disk->channel->queue_lock;
+	struct bio *b;
+
+	spin_lock (queue_lock);
+	ds->busy_cycles += end - start;
+	for (b = req; b != NULL; b = b->next) {
+		ds->latency[log2_bucket (end - b->submitted, DISKSTAT_SHIFT,
+				DISKSTAT_BUCKETS)]++;
+		b->disk->in_flight--;
+	}
+	spin_unlock (queue_lock);
+}
+
 /* Returns the disk numbered DEV_NO--either 0 or 1 for master or
    slave, respectively--within the channel numbered CHAN_NO.
 
@@ -186,7 +388,7 @@ struct disk *
 disk_get (int chan_no, int dev_no) {
 	ASSERT (dev_no == 0 || dev_no == 1);
 
-	if (chan_no < (int) CHANNEL_CNT) {
+	if (chan_no < (int) CHANNEL_CNT && wait_probed (&channels[chan_no])) {
 		struct disk *d = &channels[chan_no].devices[dev_no];
 		if (d->is_ata)
 			return d;
@@ -194,6 +396,32 @@ disk_get (int chan_no, int dev_no) {
 	return NULL;
 }
 
+/* Returns the disk named NAME, e.g. "hd1:0", or a null pointer
+   if there is no such ATA disk.  Lets the kernel command line move
+   the file system and swap disks around, for instance onto
+   different channels, whose requests then run in parallel. */
+struct disk *
+disk_find (const char *name) {
+	int chan_no, dev_no;
+
+	for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
+		for (dev_no = 0; dev_no < 2; dev_no++) {
+			struct disk *d = &channels[chan_no].devices[dev_no];
+			if (!strcmp (d->name, name))
+				return disk_get (chan_no, dev_no);
+		}
+	return NULL;
+}
+
+/* Returns true if disks A and B are on the same channel, so that
+   their requests wait for each other. */
+bool
+disk_shares_channel (const struct disk *a, const struct disk *b) {
+	ASSERT (a != NULL && b != NULL);
+
+	return a->channel == b->channel;
+}
+
 /* Returns the size of disk D, measured in DISK_SECTOR_SIZE-byte
    sectors. */
 disk_sector_t
@@ -203,52 +431,383 @@ disk_size (struct disk *d) {
 	return d->capacity;
 }
 
+/* Asynchronous requests.  A struct bio asks for a transfer of
+   sectors between a disk and memory.  disk_submit() queues it on
+   the disk's channel and returns at once; a thread per channel
+   carries out the requests of its queue in order, one command
+   each, and calls each one's END function when it is done.  END
+   runs in that thread, so it must not block: it would hold up
+   every other request on the channel, including those of whoever
+   it waits for.  bio_signal() is the usual choice.
+
+   Each bio is tagged with the I/O class of the thread that submits
+   it (see thread_get_ioprio()), and only bios of the best class in
+   the queue are candidates, so that a foreground read does not wait
+   behind a burst of writeback, readahead or swap-out from threads
+   in the idle class.  Among the candidates, the queue is served in
+   C-SCAN order: the next request is the one at the lowest position
+   at or after the end of the last, wrapping around to the lowest,
+   so the heads sweep one way across the disk instead of seeking
+   back and forth among concurrent users.  Bios that continue the
+   chosen one on the same disk in the same direction are merged with
+   it into a single command, up to BIO_MERGE_MAX of them, whatever
+   their class.  A bio whose deadline has passed goes next
+   regardless, earliest deadline first, so none starves; that bounds
+   how long an idle-class bio that a foreground thread ends up
+   waiting for can be held back.
+
+   The synchronous functions below submit a request and wait for
+   it. */
+
+/* Initializes B to transfer the CNT sectors from SEC_NO on
+   between disk D and BUFFER, to the disk if WRITE is true, and to
+   call END when done.  CNT may be at most DISK_MULTIPLE_MAX. */
+void
+bio_init (struct bio *b, struct disk *d, disk_sector_t sec_no, size_t cnt,
+		void *buffer, bool write, bio_end_func *end, void *aux) {
+	ASSERT (d != NULL);
+	ASSERT (buffer != NULL);
+	ASSERT (cnt > 0 && cnt <= DISK_MULTIPLE_MAX);
+	ASSERT (end != NULL);
+
+	b->disk = d;
+	b->sector = sec_no;
+	b->cnt = cnt;
+	b->buffer = buffer;
+	b->write = write;
+	b->end = end;
+	b->aux = aux;
+}
+
+/* A bio_end_func that ups the semaphore B's AUX points to. */
+void
+bio_signal (struct bio *b) {
+	sema_up (b->aux);
+}
+
+/* Queues B for its disk and returns without waiting.  B, and its
+   buffer, must stay put until its END function is called. */
+void
+disk_submit (struct bio *b) {
+	struct channel *c = b->disk->channel;
+
+	b->ioprio = thread_get_ioprio ();
+	b->deadline = timer_ticks () + (b->ioprio == IOPRIO_RT ? BIO_DEADLINE / 2
+			: b->ioprio == IOPRIO_IDLE ? BIO_DEADLINE * 2 : BIO_DEADLINE);
+	spin_lock (&c->queue_lock);
+	stats_submit (b);
+	list_push_back (&c->queue, &b->elem);
+	spin_unlock (&c->queue_lock);
+	sema_up (&c->queue_cnt);
+}
+
+/* Returns B's place in the sweep order of its channel. */
+static uint64_t
+bio_position (const struct bio *b) {
+	return (uint64_t) b->disk->dev_no << 32 | b->sector;
+}
+
+/* Removes the next request from C's queue, as described above, and
+   returns its first bio.  The bios merged with it follow through
+   their NEXT members, and *CNT is set to their total sectors. */
+static struct bio *
+next_request (struct channel *c, size_t *cnt) {
+	struct bio *first = NULL, *lowest = NULL, *oldest = NULL, *last;
+	struct list_elem *e;
+	size_t merged = 1;
+	int class = IOPRIO_IDLE;
+
+	ASSERT (c->queue_lock.locked);
+	ASSERT (!list_empty (&c->queue));
+
+	for (e = list_begin (&c->queue); e != list_end (&c->queue);
+			e = list_next (e)) {
+		struct bio *b = list_entry (e, struct bio, elem);
+
+		if (oldest == NULL || b->deadline < oldest->deadline)
+			oldest = b;
+		if (b->ioprio < class)
+			class = b->ioprio;
+	}
+	if (timer_ticks () >= oldest->deadline)
+		first = oldest;
+	else {
+		for (e = list_begin (&c->queue); e != list_end (&c->queue);
+				e = list_next (e)) {
+			struct bio *b = list_entry (e, struct bio, elem);
+			uint64_t pos = bio_position (b);
+
+			if (b->ioprio != class)
+				continue;
+			if (lowest == NULL || pos < bio_position (lowest))
+				lowest = b;
+			if (pos >= c->head
+					&& (first == NULL || pos < bio_position (first)))
+				first = b;
+		}
+		if (first == NULL)
+			first = lowest;
+	}
+	list_remove (&first->elem);
+	first->next = NULL;
+	*cnt = first->cnt;
+
+	for (last = first; merged < BIO_MERGE_MAX; merged++) {
+		struct bio *b = NULL;
+
+		for (e = list_begin (&c->queue); e != list_end (&c->queue);
+				e = list_next (e)) {
+			b = list_entry (e, struct bio, elem);
+			if (b->disk == first->disk && b->write == first->write
+					&& b->sector == first->sector + *cnt
+					&& *cnt + b->cnt <= DISK_MULTIPLE_MAX)
+				break;
+			b = NULL;
+		}
+		if (b == NULL)
+			break;
+
+		/* Its up of queue_cnt is ours now. */
+		list_remove (&b->elem);
+		sema_try_down (&c->queue_cnt);
+		b->next = NULL;
+		last->next = b;
+		last = b;
+		*cnt += b->cnt;
+	}
+	c->head = bio_position (first) + *cnt;
+	return first;
+}
+
+/* Finds out which devices channel C has and identifies its ATA
+   disks. */
+static void
+probe_channel (struct channel *c) {
+	/* Reset hardware. */
+	reset_channel (c);
+
+	/* Distinguish ATA hard disks from other devices. */
+	if (check_device_type (&c->devices[0]))
+		check_device_type (&c->devices[1]);
+
+	/* Read hard disk identity information. */
+	for (int dev_no = 0; dev_no < 2; dev_no++)
+		if (c->devices[dev_no].is_ata)
+			identify_ata_device (&c->devices[dev_no]);
+
+	c->probed = true;
+	sema_up (&c->probe_done);
+}
+
+/* Waits until channel C has been probed, if it may sleep.  Returns
+   true if C has been probed. */
+static bool
+wait_probed (struct channel *c) {
+	if (!c->probed && !intr_context () && intr_get_level () == INTR_ON) {
+		sema_down (&c->probe_done);
+		sema_up (&c->probe_done);
+	}
+	return c->probed;
+}
+
+/* Waits until every channel has been probed.  Called before the
+   kernel runs its actions, so that nothing the probes print comes
+   in the middle of their output. */
+void
+disk_wait_probes (void) {
+	for (size_t chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
+		wait_probed (&channels[chan_no]);
+}
+
+/* Body of the thread of CHANNEL_, a struct channel, which probes
+   it and then carries out the bios in its queue, if it has any
+   disks. */
+static void
+channel_thread (void *channel_) {
+	struct channel *c = channel_;
+
+	probe_channel (c);
+	if (!c->devices[0].is_ata && !c->devices[1].is_ata)
+		return;
+
+	/* Under -fair our PRI_MAX counts for nothing, so reserve a share
+	   of the CPU instead to keep completions prompt. */
+	if (thread_fair)
+		thread_set_deadline (2, 5, 10);
+
+	for (;;) {
+		struct bio *req, *b, *next;
+		uint64_t start;
+		size_t cnt;
+
+		sema_down (&c->queue_cnt);
+		spin_lock (&c->queue_lock);
+		req = next_request (c, &cnt);
+		spin_unlock (&c->queue_lock);
+
+		lock_acquire (&c->lock);
+		start = rdtsc ();
+		if (!dma_transfer (req, cnt))
+			pio_transfer (req, cnt);
+		stats_complete (req, start, rdtsc ());
+		lock_release (&c->lock);
+
+		for (b = req; b != NULL; b = next) {
+			next = b->next;
+			b->end (b);
+		}
+	}
+}
+
+/* Carries out a transfer like bio_init() describes and waits for
+   it to finish. */
+static void
+disk_transfer (struct disk *d, disk_sector_t sec_no, size_t cnt,
+		void *buffer, bool write) {
+	struct semaphore done;
+	struct bio b;
+
+	if (write)
+		TRACE (DISK_WRITE_BEGIN, sec_no);
+	else
+		TRACE (DISK_READ_BEGIN, sec_no);
+
+	sema_init (&done, 0);
+	bio_init (&b, d, sec_no, cnt, buffer, write, bio_signal, &done);
+	disk_submit (&b);
+	sema_down (&done);
+
+	if (write)
+		TRACE (DISK_WRITE_END, sec_no);
+	else
+		TRACE (DISK_READ_END, sec_no);
+}
+
 /* Reads sector SEC_NO from disk D into BUFFER, which must have
    room for DISK_SECTOR_SIZE bytes.
    Internally synchronizes accesses to disks, so external
    per-disk locking is unneeded. */
 void
 disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) {
-	struct channel *c;
-
-	ASSERT (d != NULL);
-	ASSERT (buffer != NULL);
-
-	c = d->channel;
-	lock_acquire (&c->lock);
-	select_sector (d, sec_no);
-	issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-	sema_down (&c->completion_wait);
-	if (!wait_while_busy (d))
-		PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-	input_sector (c, buffer);
-	d->read_cnt++;
-	lock_release (&c->lock);
+	disk_read_multiple (d, sec_no, 1, buffer);
 }
 
 /* Write sector SEC_NO to disk D from BUFFER, which must contain
    DISK_SECTOR_SIZE bytes.  Returns after the disk has
-   acknowledged receiving the data.
+   acknowledged receiving the data, which with its write cache on
+   may not be on the media until disk_flush().
    Internally synchronizes accesses to disks, so external
    per-disk locking is unneeded. */
 void
 disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer) {
-	struct channel *c;
+	disk_write_multiple (d, sec_no, 1, buffer);
+}
 
-	ASSERT (d != NULL);
-	ASSERT (buffer != NULL);
+/* Reads the CNT sectors starting at SEC_NO from disk D into
+   BUFFER, which must have room for CNT * DISK_SECTOR_SIZE bytes,
+   with a single command.  CNT may be at most DISK_MULTIPLE_MAX.
+   If D supports READ MULTIPLE, the disk interrupts once per
+   block of sectors instead of once per sector.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void
+disk_read_multiple (struct disk *d, disk_sector_t sec_no, size_t cnt,
+		void *buffer) {
+	disk_transfer (d, sec_no, cnt, buffer, false);
+}
+
+/* Writes the CNT sectors starting at SEC_NO to disk D from
+   BUFFER, which must contain CNT * DISK_SECTOR_SIZE bytes, with
+   a single command, like disk_read_multiple().  Returns after
+   the disk has acknowledged receiving all the data.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void
+disk_write_multiple (struct disk *d, disk_sector_t sec_no, size_t cnt,
+		const void *buffer) {
+	disk_transfer (d, sec_no, cnt, (void *) buffer, true);
+}
+
+/* Has disk D write what its write cache holds to the media, so that
+   every write completed before the call is durable, and waits for
+   it.  The file system calls this as a barrier where it needs some
+   writes to be on disk before others, and to make them durable.
+   Does nothing if the disk's write cache is off. */
+void
+disk_flush (struct disk *d) {
+	struct channel *c = d->channel;
 
-	c = d->channel;
+	if (!d->write_cache)
+		return;
 	lock_acquire (&c->lock);
-	select_sector (d, sec_no);
-	issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-	if (!wait_while_busy (d))
-		PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-	output_sector (c, buffer);
+	select_device_wait (d);
+	issue_pio_command (c, d->flush_ext ? CMD_FLUSH_CACHE_EXT : CMD_FLUSH_CACHE);
 	sema_down (&c->completion_wait);
-	d->write_cnt++;
+	wait_while_busy (d);
+	if ((inb (reg_alt_status (c)) & STA_ERR) != 0)
+		PANIC ("%s: disk flush failed", d->name);
 	lock_release (&c->lock);
 }
+
+/* Moves the next N sectors of the request whose current bio is
+   *B, from sector *IDX within it on, between the disk and the
+   bios' buffers, advancing *B and *IDX. */
+static void
+pio_move (struct channel *c, struct bio **b, size_t *idx, size_t n) {
+	for (; n > 0; n--) {
+		uint8_t *p = (uint8_t *) (*b)->buffer + *idx * DISK_SECTOR_SIZE;
+
+		if ((*b)->write)
+			output_sectors (c, p, 1);
+		else
+			input_sectors (c, p, 1);
+		if (++*idx == (*b)->cnt) {
+			*b = (*b)->next;
+			*idx = 0;
+		}
+	}
+}
+
+/* Carries out request REQ, of CNT sectors in all, in PIO mode.
+   The request's channel must be locked. */
+static void
+pio_transfer (struct bio *req, size_t cnt) {
+	struct disk *d = req->disk;
+	struct channel *c = d->channel;
+	struct bio *b = req;
+	size_t idx = 0;
+	bool ext;
+
+	ext = select_sector (d, req->sector, cnt);
+	if (req->write)
+		issue_pio_command (c, d->block_cnt > 1
+				? (ext ? CMD_WRITE_MULTIPLE_EXT : CMD_WRITE_MULTIPLE)
+				: (ext ? CMD_WRITE_SECTOR_EXT : CMD_WRITE_SECTOR_RETRY));
+	else
+		issue_pio_command (c, d->block_cnt > 1
+				? (ext ? CMD_READ_MULTIPLE_EXT : CMD_READ_MULTIPLE)
+				: (ext ? CMD_READ_SECTOR_EXT : CMD_READ_SECTOR_RETRY));
+	while (cnt > 0) {
+		size_t n = cnt < d->block_cnt ? cnt : d->block_cnt;
+
+		if (req->write) {
+			if (!wait_while_busy (d))
+				PANIC ("%s: disk write failed, sector=%"PRDSNu,
+						d->name, req->sector);
+			pio_move (c, &b, &idx, n);
+			sema_down (&c->completion_wait);
+			percpu_counter_add (&d->write_cnt, n);
+		} else {
+			sema_down (&c->completion_wait);
+			if (!wait_while_busy (d))
+				PANIC ("%s: disk read failed, sector=%"PRDSNu,
+						d->name, req->sector);
+			pio_move (c, &b, &idx, n);
+			percpu_counter_add (&d->read_cnt, n);
+		}
+		cnt -= n;
+	}
+}
 
 /* Disk detection and identification. */
 
@@ -359,12 +918,37 @@ identify_ata_device (struct disk *d) {
 		d->is_ata = false;
 		return;
 	}
-	input_sector (c, id);
+	input_sectors (c, id, 1);
 
-	/* Calculate capacity. */
+	/* Calculate capacity.  A disk with the 48-bit address feature
+	   set enabled gives its full size in words 100 to 103; sectors
+	   beyond what a disk_sector_t can number are not used. */
 	d->capacity = id[60] | ((uint32_t) id[61] << 16);
+	d->lba48 = (id[83] & (1 << 10)) != 0 && (id[86] & (1 << 10)) != 0;
+	if (d->lba48) {
+		uint64_t capacity = id[100] | ((uint64_t) id[101] << 16)
+			| ((uint64_t) id[102] << 32) | ((uint64_t) id[103] << 48);
+
+		d->capacity = capacity > UINT32_MAX ? UINT32_MAX : capacity;
+	}
+
+	/* Use READ and WRITE MULTIPLE with the largest block the disk
+	   supports, if more than one sector. */
+	if ((id[47] & 0xff) > 1)
+		set_multiple_mode (d, id[47] & 0xff);
+
+	/* Use DMA if both the disk and its channel can. */
+	d->dma = c->bm_base != 0 && (id[49] & (1 << 8)) != 0;
+
+	/* Turn on the write cache if the disk has one, so that a write
+	   completes once the disk has the data; disk_flush() has it
+	   written to the media when that matters. */
+	d->flush_ext = d->lba48 && (id[83] & (1 << 13)) != 0;
+	if ((id[82] & (1 << 5)) != 0)
+		d->write_cache = set_feature (d, FEAT_WCACHE_ON);
 
 	/* Print identification message. */
+	lock_acquire (&identify_lock);
 	printf ("%s: detected %'"PRDSNu" sector (", d->name, d->capacity);
 	if (d->capacity > 1024 / DISK_SECTOR_SIZE * 1024 * 1024)
 		printf ("%"PRDSNu" GB",
@@ -379,7 +963,39 @@ identify_ata_device (struct disk *d) {
 	print_ata_string ((char *) &id[27], 40);
 	printf ("\", serial \"");
 	print_ata_string ((char *) &id[10], 20);
-	printf ("\"\n");
+	printf ("\"%s%s\n", d->dma ? ", DMA" : "",
+			d->write_cache ? ", write cache" : "");
+	lock_release (&identify_lock);
+}
+
+/* Sends a SET MULTIPLE MODE command to disk D for blocks of
+   BLOCK_CNT sectors, and sets D's block_cnt member if the disk
+   accepts it. */
+static void
+set_multiple_mode (struct disk *d, size_t block_cnt) {
+	struct channel *c = d->channel;
+
+	select_device_wait (d);
+	outb (reg_nsect (c), block_cnt);
+	issue_pio_command (c, CMD_SET_MULTIPLE_MODE);
+	sema_down (&c->completion_wait);
+	wait_while_busy (d);
+	if ((inb (reg_alt_status (c)) & STA_ERR) == 0)
+		d->block_cnt = block_cnt;
+}
+
+/* Sends a SET FEATURES command with subcommand FEATURE to disk D.
+   Returns true if the disk accepts it. */
+static bool
+set_feature (struct disk *d, uint8_t feature) {
+	struct channel *c = d->channel;
+
+	select_device_wait (d);
+	outb (reg_features (c), feature);
+	issue_pio_command (c, CMD_SET_FEATURES);
+	sema_down (&c->completion_wait);
+	wait_while_busy (d);
+	return (inb (reg_alt_status (c)) & STA_ERR) == 0;
 }
 
 /* Prints STRING, which consists of SIZE bytes in a funky format:
@@ -402,26 +1018,38 @@ print_ata_string (char *string, size_t size) {
 }
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
-static void
-select_sector (struct disk *d, disk_sector_t sec_no) {
+   writes SEC_NO and the count CNT to the disk's sector selection
+   registers.  (We use LBA mode.)  A count of 256 is written as
+   0.  Returns true if the sectors are past what 28-bit LBA reaches,
+   so that the command must be an EXT one, false otherwise. */
+static bool
+select_sector (struct disk *d, disk_sector_t sec_no, size_t cnt) {
 	struct channel *c = d->channel;
+	uint64_t lba = sec_no;
+	bool ext = lba + cnt > LBA28_SECTORS;
 
-	ASSERT (sec_no < d->capacity);
-	ASSERT (sec_no < (1UL << 28));
+	ASSERT (sec_no < d->capacity && cnt <= d->capacity - sec_no);
+	ASSERT (!ext || d->lba48);
+	ASSERT (cnt > 0 && cnt <= DISK_MULTIPLE_MAX);
 
 	select_device_wait (d);
-	outb (reg_nsect (c), 1);
-	outb (reg_lbal (c), sec_no);
-	outb (reg_lbam (c), sec_no >> 8);
-	outb (reg_lbah (c), (sec_no >> 16));
-	outb (reg_device (c),
-			DEV_MBS | DEV_LBA | (d->dev_no == 1 ? DEV_DEV : 0) | (sec_no >> 24));
+	if (ext) {
+		outb (reg_nsect (c), cnt >> 8);
+		outb (reg_lbal (c), lba >> 24);
+		outb (reg_lbam (c), lba >> 32);
+		outb (reg_lbah (c), lba >> 40);
+	}
+	outb (reg_nsect (c), cnt % DISK_MULTIPLE_MAX);
+	outb (reg_lbal (c), lba);
+	outb (reg_lbam (c), lba >> 8);
+	outb (reg_lbah (c), lba >> 16);
+	outb (reg_device (c), DEV_MBS | DEV_LBA | (d->dev_no == 1 ? DEV_DEV : 0)
+			| (ext ? 0 : lba >> 24));
+	return ext;
 }
 
 /* Writes COMMAND to channel C and prepares for receiving a
-   completion interrupt. */
+   completion interrupt.  DMA commands are issued the same way. */
 static void
 issue_pio_command (struct channel *c, uint8_t command) {
 	/* Interrupts must be enabled or our semaphore will never be
@@ -432,20 +1060,163 @@ issue_pio_command (struct channel *c, uint8_t command) {
 	outb (reg_command (c), command);
 }
 
-/* Reads a sector from channel C's data register in PIO mode into
-   SECTOR, which must have room for DISK_SECTOR_SIZE bytes. */
+/* Reads CNT sectors from channel C's data register in PIO mode
+   into SECTORS, which must have room for CNT * DISK_SECTOR_SIZE
+   bytes. */
 static void
-input_sector (struct channel *c, void *sector) {
-	insw (reg_data (c), sector, DISK_SECTOR_SIZE / 2);
+input_sectors (struct channel *c, void *sectors, size_t cnt) {
+	insw (reg_data (c), sectors, cnt * DISK_SECTOR_SIZE / 2);
 }
 
-/* Writes SECTOR to channel C's data register in PIO mode.
-   SECTOR must contain DISK_SECTOR_SIZE bytes. */
+/* Writes SECTORS to channel C's data register in PIO mode.
+   SECTORS must contain CNT * DISK_SECTOR_SIZE bytes. */
 static void
-output_sector (struct channel *c, const void *sector) {
-	outsw (reg_data (c), sector, DISK_SECTOR_SIZE / 2);
+output_sectors (struct channel *c, const void *sectors, size_t cnt) {
+	outsw (reg_data (c), sectors, cnt * DISK_SECTOR_SIZE / 2);
 }
 
+/* Bus master DMA.  The IDE controller of a PC, a PCI device, can
+   move the data of a command between the disk and memory itself, as
+   listed in a table of physical region descriptors, and interrupts
+   once at the end.  The CPU is free meanwhile.  Only buffers in
+   the kernel's direct map of physical memory below 4 GB can be
+   used that way; other transfers fall back to PIO. */
+
+/* PCI configuration space, through configuration mechanism #1. */
+#define PCI_CONFIG_ADDR 0xcf8
+#define PCI_CONFIG_DATA 0xcfc
+
+/* Returns the 32-bit register at offset REG in the configuration
+   space of PCI function FUNC of device DEV on bus 0. */
+static uint32_t
+pci_read_config (int dev, int func, int reg) {
+	outl (PCI_CONFIG_ADDR, 0x80000000 | dev << 11 | func << 8 | reg);
+	return inl (PCI_CONFIG_DATA);
+}
+
+/* Writes VALUE to the 32-bit register at offset REG in the
+   configuration space of PCI function FUNC of device DEV on bus
+   0. */
+static void
+pci_write_config (int dev, int func, int reg, uint32_t value) {
+	outl (PCI_CONFIG_ADDR, 0x80000000 | dev << 11 | func << 8 | reg);
+	outl (PCI_CONFIG_DATA, value);
+}
+
+/* Looks on PCI bus 0 for an IDE controller that can be a bus
+   master, enables bus mastering on it and returns its bus master
+   base I/O port, the primary channel's.  The secondary channel's
+   follow 8 ports later.  Returns 0 if there is no such
+   controller. */
+static uint16_t
+find_bus_master (void) {
+	for (int dev = 0; dev < 32; dev++)
+		for (int func = 0; func < 8; func++) {
+			uint32_t id = pci_read_config (dev, func, 0x00);
+			uint32_t class = pci_read_config (dev, func, 0x08) >> 8;
+			bool multi = (pci_read_config (dev, 0, 0x0c) & 0x800000) != 0;
+			uint32_t bar4;
+
+			if ((id & 0xffff) == 0xffff || (func > 0 && !multi)) {
+				if (func == 0 || !multi)
+					break;
+				continue;
+			}
+
+			/* Mass storage, IDE, bus master capable. */
+			if ((class >> 8) != 0x0101 || (class & 0x80) == 0)
+				continue;
+			bar4 = pci_read_config (dev, func, 0x20);
+			if ((bar4 & 1) == 0 || (bar4 & 0xfffc) == 0)
+				continue;
+
+			/* Enable I/O space and bus mastering. */
+			pci_write_config (dev, func, 0x04,
+					pci_read_config (dev, func, 0x04) | 0x05);
+			return bar4 & 0xfffc;
+		}
+	return 0;
+}
+
+/* Returns true if the buffer of bio B can be used for DMA. */
+static bool
+dma_capable (const struct bio *b) {
+	size_t size = b->cnt * DISK_SECTOR_SIZE;
+
+	return is_kernel_vaddr (b->buffer) && ((uintptr_t) b->buffer & 1) == 0
+		&& vtop (b->buffer) + size <= 0x100000000ULL;
+}
+
+/* Fills in the descriptor table of channel C for the buffers of
+   request REQ and hands it to the bus master.  Returns false if
+   some buffer cannot be used for DMA. */
+static bool
+dma_setup (struct channel *c, struct bio *req) {
+	struct bio *b;
+	size_t i = 0;
+
+	for (b = req; b != NULL; b = b->next)
+		if (!dma_capable (b))
+			return false;
+
+	for (b = req; b != NULL; b = b->next) {
+		uint64_t pa = vtop (b->buffer);
+		size_t size = b->cnt * DISK_SECTOR_SIZE;
+
+		for (; size > 0; i++) {
+			size_t n = 0x10000 - (pa & 0xffff);
+
+			ASSERT (i < PRD_CNT);
+			if (n > size)
+				n = size;
+			c->prd[i].addr = pa;
+			c->prd[i].size = n & 0xffff;
+			c->prd[i].flags = 0;
+			pa += n;
+			size -= n;
+		}
+	}
+	c->prd[i - 1].flags = PRD_EOT;
+	outl (reg_bm_prdt (c), vtop (c->prd));
+	return true;
+}
+
+/* Carries out request REQ, of CNT sectors in all, by DMA.  The
+   request's channel must be locked.  Returns false, with nothing
+   done, if its disk or its buffers cannot do DMA. */
+static bool
+dma_transfer (struct bio *req, size_t cnt) {
+	struct disk *d = req->disk;
+	struct channel *c = d->channel;
+	uint8_t direction = req->write ? 0 : BM_CMD_READ;
+	uint8_t bm_status;
+
+	if (!d->dma || !dma_setup (c, req))
+		return false;
+
+	outb (reg_bm_command (c), direction);
+	outb (reg_bm_status (c), BM_STA_ERR | BM_STA_INTR);
+	if (select_sector (d, req->sector, cnt))
+		issue_pio_command (c, req->write ? CMD_WRITE_DMA_EXT : CMD_READ_DMA_EXT);
+	else
+		issue_pio_command (c, req->write ? CMD_WRITE_DMA : CMD_READ_DMA);
+	outb (reg_bm_command (c), direction | BM_CMD_START);
+	sema_down (&c->completion_wait);
+	outb (reg_bm_command (c), direction);
+
+	bm_status = inb (reg_bm_status (c));
+	outb (reg_bm_status (c), BM_STA_ERR | BM_STA_INTR);
+	if ((bm_status & BM_STA_ERR) != 0
+			|| (inb (reg_alt_status (c)) & STA_ERR) != 0)
+		PANIC ("%s: disk %s failed, sector=%"PRDSNu,
+				d->name, req->write ? "write" : "read", req->sector);
+	if (req->write)
+		percpu_counter_add (&d->write_cnt, cnt);
+	else
+		percpu_counter_add (&d->read_cnt, cnt);
+	return true;
+}
+
 /* Low-level ATA primitives. */
 
 /* Wait up to 10 seconds for the controller to become idle, that
@@ -532,13 +1303,13 @@ interrupt_handler (struct intr_frame *f) {
 static void
 inspect_read_cnt (struct intr_frame *f) {
 	struct disk * d = disk_get (f->R.rdx, f->R.rcx);
-	f->R.rax = d->read_cnt;
+	f->R.rax = percpu_counter_read (&d->read_cnt);
 }
 
 static void
 inspect_write_cnt (struct intr_frame *f) {
 	struct disk * d = disk_get (f->R.rdx, f->R.rcx);
-	f->R.rax = d->write_cnt;
+	f->R.rax = percpu_counter_read (&d->write_cnt);
 }
 
 /* Tool for testing disk r/w cnt. Calling this function via int 0x43 and int 0x44.
@@ -6,10 +6,16 @@
 /* Stores keys from the keyboard and serial port. */
 static struct intq buffer;
 
+/* Lets one reader at a time take keys, so that the interrupt
+   handlers and the reader are the buffer's only producer and
+   consumer. */
+static struct lock reader_lock;
+
 /* Initializes the input buffer. */
 void
 input_init (void) {
 	intq_init (&buffer);
+	lock_init (&reader_lock);
 }
 
 /* Adds a key to the input buffer.
@@ -30,14 +36,37 @@ input_getc (void) {
 	enum intr_level old_level;
 	uint8_t key;
 
+	lock_acquire (&reader_lock);
 	old_level = intr_disable ();
 	key = intq_getc (&buffer);
 	serial_notify ();
 	intr_set_level (old_level);
+	lock_release (&reader_lock);
 
 	return key;
 }
 
+/* Retrieves up to SIZE keys from the input buffer into BUF, all
+   that are there, in one go, and returns how many.  If the buffer
+   is empty, waits for a key to be pressed first, so that at least
+   one key is retrieved unless SIZE is 0. */
+size_t
+input_read (uint8_t *buf, size_t size) {
+	enum intr_level old_level;
+	size_t cnt;
+
+	/* As the only consumer, the keys come out with interrupts
+	   on. */
+	lock_acquire (&reader_lock);
+	cnt = intq_read (&buffer, buf, size);
+	old_level = intr_disable ();
+	serial_notify ();
+	intr_set_level (old_level);
+	lock_release (&reader_lock);
+
+	return cnt;
+}
+
 /* Returns true if the input buffer is full,
    false otherwise.
    Interrupts must be off. */
@@ -2,14 +2,17 @@
 #include <debug.h>
 #include "threads/thread.h"
 
-static int next (int pos);
+static size_t slot (size_t pos);
+static size_t load (const size_t *);
 static void wait (struct intq *q, struct thread **waiter);
 static void signal (struct intq *q, struct thread **waiter);
+static void wake (struct intq *q, struct thread **waiter);
 
 /* Initializes interrupt queue Q. */
 void
 intq_init (struct intq *q) {
 	lock_init (&q->lock);
+	spin_lock_init (&q->wait_lock);
 	q->not_full = q->not_empty = NULL;
 	q->head = q->tail = 0;
 }
@@ -25,7 +28,7 @@ intq_empty (const struct intq *q) {
 bool
 intq_full (const struct intq *q) {
 	ASSERT (intr_get_level () == INTR_OFF);
-	return next (q->head) == q->tail;
+	return q->head - q->tail == INTQ_BUFSIZE;
 }
 
 /* Removes a byte from Q and returns it.
@@ -44,12 +47,36 @@ intq_getc (struct intq *q) {
 		lock_release (&q->lock);
 	}
 
-	byte = q->buf[q->tail];
-	q->tail = next (q->tail);
+	byte = q->buf[slot (q->tail)];
+	q->tail++;
 	signal (q, &q->not_full);
 	return byte;
 }
 
+/* Removes up to SIZE bytes from Q into BUF, as many as Q holds, and
+   returns the number removed.  If Q is empty, first sleeps until a
+   byte is added, so that at least one byte is removed unless SIZE
+   is 0.  Like intq_get_bulk(), may be called with interrupts on by
+   Q's only consumer.  Must not be called from an interrupt
+   handler. */
+size_t
+intq_read (struct intq *q, uint8_t *buf, size_t size) {
+	size_t cnt;
+
+	ASSERT (!intr_context ());
+	while ((cnt = intq_get_bulk (q, buf, size)) == 0 && size > 0) {
+		enum intr_level old_level = intr_disable ();
+
+		if (intq_empty (q)) {
+			lock_acquire (&q->lock);
+			wait (q, &q->not_empty);
+			lock_release (&q->lock);
+		}
+		intr_set_level (old_level);
+	}
+	return cnt;
+}
+
 /* Adds BYTE to the end of Q.
    Q must not be full if called from an interrupt handler.
    Otherwise, if Q is full, first sleeps until a byte is
@@ -64,28 +91,79 @@ intq_putc (struct intq *q, uint8_t byte) {
 		lock_release (&q->lock);
 	}
 
-	q->buf[q->head] = byte;
-	q->head = next (q->head);
+	q->buf[slot (q->head)] = byte;
+	q->head++;
 	signal (q, &q->not_empty);
 }
 
-/* Returns the position after POS within an intq. */
-static int
-next (int pos) {
-	return (pos + 1) % INTQ_BUFSIZE;
+/* Removes up to SIZE bytes from Q into BUF, as many as Q holds, and
+   returns the number removed.  Never sleeps.  Interrupts may be on,
+   as long as the caller is Q's only consumer. */
+size_t
+intq_get_bulk (struct intq *q, uint8_t *buf, size_t size) {
+	size_t tail = q->tail;
+	size_t avail = load (&q->head) - tail;
+	size_t cnt = size < avail ? size : avail;
+
+	/* Read the bytes before giving their room back. */
+	for (size_t i = 0; i < cnt; i++)
+		buf[i] = q->buf[slot (tail + i)];
+	barrier ();
+	*(volatile size_t *) &q->tail = tail + cnt;
+	if (cnt > 0)
+		wake (q, &q->not_full);
+	return cnt;
+}
+
+/* Adds up to SIZE bytes from BUF to the end of Q, as many as there
+   is room for, and returns the number added.  Never sleeps.
+   Interrupts may be on, as long as the caller is Q's only
+   producer. */
+size_t
+intq_put_bulk (struct intq *q, const uint8_t *buf, size_t size) {
+	size_t head = q->head;
+	size_t room = INTQ_BUFSIZE - (head - load (&q->tail));
+	size_t cnt = size < room ? size : room;
+
+	/* Write the bytes before publishing them. */
+	for (size_t i = 0; i < cnt; i++)
+		q->buf[slot (head + i)] = buf[i];
+	barrier ();
+	*(volatile size_t *) &q->head = head + cnt;
+	if (cnt > 0)
+		wake (q, &q->not_empty);
+	return cnt;
+}
+
+/* Returns the index in an intq's buffer of position POS. */
+static size_t
+slot (size_t pos) {
+	return pos & (INTQ_BUFSIZE - 1);
+}
+
+/* Returns *P, the other side's index, read afresh from memory. */
+static size_t
+load (const size_t *p) {
+	return *(const volatile size_t *) p;
 }
 
 /* WAITER must be the address of Q's not_empty or not_full
-   member.  Waits until the given condition is true. */
+   member.  Waits until the given condition is true, or returns at
+   once if it already is by the time Q's wait_lock is held: the
+   other side, possibly on another CPU, may have just made it so.
+   Callers check again. */
 static void
-wait (struct intq *q UNUSED, struct thread **waiter) {
+wait (struct intq *q, struct thread **waiter) {
 	ASSERT (!intr_context ());
 	ASSERT (intr_get_level () == INTR_OFF);
-	ASSERT ((waiter == &q->not_empty && intq_empty (q))
-			|| (waiter == &q->not_full && intq_full (q)));
+	ASSERT (waiter == &q->not_empty || waiter == &q->not_full);
 
-	*waiter = thread_current ();
-	thread_block ();
+	spin_lock (&q->wait_lock);
+	if (waiter == &q->not_empty ? intq_empty (q) : intq_full (q)) {
+		*waiter = thread_current ();
+		thread_block_on (&q->wait_lock);
+	}
+	spin_unlock (&q->wait_lock);
 }
 
 /* WAITER must be the address of Q's not_empty or not_full
@@ -93,13 +171,25 @@ wait (struct intq *q UNUSED, struct thread **waiter) {
    thread is waiting for the condition, wakes it up and resets
    the waiting thread. */
 static void
-signal (struct intq *q UNUSED, struct thread **waiter) {
+signal (struct intq *q, struct thread **waiter) {
 	ASSERT (intr_get_level () == INTR_OFF);
 	ASSERT ((waiter == &q->not_empty && !intq_empty (q))
 			|| (waiter == &q->not_full && !intq_full (q)));
 
+	wake (q, waiter);
+}
+
+/* Wakes up the thread in *WAITER, if any, once the index that
+   makes its condition true has been published.  A waiter checks
+   the condition and sets *WAITER under Q's wait_lock, and taking
+   the lock here orders the publication before the check of
+   *WAITER, so either it sees the new index or we see it. */
+static void
+wake (struct intq *q, struct thread **waiter) {
+	spin_lock (&q->wait_lock);
 	if (*waiter != NULL) {
 		thread_unblock (*waiter);
 		*waiter = NULL;
 	}
+	spin_unlock (&q->wait_lock);
 }
@@ -6,6 +6,7 @@
 #include "devices/input.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
+#include "threads/softirq.h"
 
 /* Keyboard data register port. */
 #define DATA_REG 0x60
@@ -23,11 +24,22 @@ static bool caps_lock;
 /* Number of keys pressed. */
 static int64_t key_cnt;
 
+/* Scancodes read by the interrupt handler and not yet decoded by
+   kbd_softirq().  Only touched with interrupts off; a scancode that
+   finds the ring full is lost. */
+#define SCANCODE_CNT 64
+static uint16_t scancodes[SCANCODE_CNT];
+static unsigned scancode_head, scancode_tail;   /* Only grow. */
+static struct softirq_work kbd_work;
+
 static intr_handler_func keyboard_interrupt;
+static softirq_func kbd_softirq;
+static void decode_scancode (unsigned code);
 
 /* Initializes the keyboard. */
 void
 kbd_init (void) {
+	softirq_work_init (&kbd_work, kbd_softirq, NULL);
 	intr_register_ext (0x21, keyboard_interrupt, "8042 Keyboard");
 }
 
@@ -84,27 +96,54 @@ static const struct keymap shifted_keymap[] = {
 
 static bool map_key (const struct keymap[], unsigned scancode, uint8_t *);
 
+/* Keyboard interrupt handler.  Only reads the scancode, leaving it
+   to kbd_softirq(). */
 static void
 keyboard_interrupt (struct intr_frame *args UNUSED) {
+	/* Keyboard scancode. */
+	unsigned code;
+
+	/* Read scancode, including second byte if prefix code. */
+	code = inb (DATA_REG);
+	if (code == 0xe0)
+		code = (code << 8) | inb (DATA_REG);
+
+	if (scancode_tail - scancode_head < SCANCODE_CNT) {
+		scancodes[scancode_tail++ % SCANCODE_CNT] = code;
+		softirq_queue (&kbd_work);
+	}
+}
+
+/* Decodes the scancodes the interrupt handler has read. */
+static void
+kbd_softirq (void *aux UNUSED) {
+	enum intr_level old_level = intr_disable ();
+
+	while (scancode_head != scancode_tail) {
+		unsigned code = scancodes[scancode_head++ % SCANCODE_CNT];
+
+		intr_set_level (old_level);
+		decode_scancode (code);
+		old_level = intr_disable ();
+	}
+	intr_set_level (old_level);
+}
+
+/* Interprets scancode CODE, updating the shift state or adding a
+   character to the input buffer. */
+static void
+decode_scancode (unsigned code) {
 	/* Status of shift keys. */
 	bool shift = left_shift || right_shift;
 	bool alt = left_alt || right_alt;
 	bool ctrl = left_ctrl || right_ctrl;
 
-	/* Keyboard scancode. */
-	unsigned code;
-
 	/* False if key pressed, true if key released. */
 	bool release;
 
 	/* Character that corresponds to `code'. */
 	uint8_t c;
 
-	/* Read scancode, including second byte if prefix code. */
-	code = inb (DATA_REG);
-	if (code == 0xe0)
-		code = (code << 8) | inb (DATA_REG);
-
 	/* Bit 0x80 distinguishes key press from key release
 	   (even if there's a prefix). */
 	release = (code & 0x80) != 0;
@@ -135,10 +174,12 @@ keyboard_interrupt (struct intr_frame *args UNUSED) {
 				c += 0x80;
 
 			/* Append to keyboard buffer. */
+			enum intr_level old_level = intr_disable ();
 			if (!input_full ()) {
 				key_cnt++;
 				input_putc (c);
 			}
+			intr_set_level (old_level);
 		}
 	} else {
 		/* Maps a keycode into a shift state variable. */
@@ -1,10 +1,10 @@
 #include "devices/serial.h"
 #include <debug.h>
 #include "devices/input.h"
-#include "devices/intq.h"
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
+#include "threads/spinlock.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
 
@@ -33,6 +33,13 @@
 #define MCR_REG (IO_BASE + 4)   /* MODEM Control Register. */
 #define LSR_REG (IO_BASE + 5)   /* Line Status Register (read-only). */
 
+/* FIFO Control Register bits. */
+#define FCR_ENABLE 0x01         /* Enable the FIFOs. */
+#define FCR_CLEAR 0x06          /* Empty both FIFOs. */
+
+/* Bytes the transmit FIFO holds. */
+#define FIFO_SIZE 16
+
 /* Interrupt Enable Register bits. */
 #define IER_RECV 0x01           /* Interrupt when data received. */
 #define IER_XMIT 0x02           /* Interrupt when transmit finishes. */
@@ -51,11 +58,25 @@
 /* Transmission mode. */
 static enum { UNINIT, POLL, QUEUE } mode;
 
-/* Data to be transmitted. */
-static struct intq txq;
+/* Data to be transmitted, in a ring of TXQ_SIZE bytes.
+   TXQ_HEAD and TXQ_TAIL only ever grow; the bytes between them
+   wait to go out, oldest at TXQ_TAIL.  Each time the transmit
+   FIFO runs empty, up to FIFO_SIZE bytes move into it at once.
+
+   A thread that finds the ring full sleeps as TXQ_WAITER until
+   the transmit interrupt makes room, and TXQ_LOCK makes any
+   others wait their turn for that.  The rest, and the port's
+   transmit side, is covered by SERIAL_LOCK, which the interrupt
+   handler takes too. */
+#define TXQ_SIZE 4096
+static uint8_t txq[TXQ_SIZE];
+static size_t txq_head, txq_tail;
+static struct thread *txq_waiter;
+static struct lock txq_lock;
+static struct spinlock serial_lock = SPINLOCK_INITIALIZER;
 
 static void set_serial (int bps);
-static void putc_poll (uint8_t);
+static void tx_burst (void);
 static void write_ier (void);
 static intr_handler_func serial_interrupt;
 
@@ -67,10 +88,10 @@ static void
 init_poll (void) {
 	ASSERT (mode == UNINIT);
 	outb (IER_REG, 0);                    /* Turn off all interrupts. */
-	outb (FCR_REG, 0);                    /* Disable FIFO. */
+	outb (FCR_REG, FCR_ENABLE | FCR_CLEAR); /* Enable FIFO. */
 	set_serial (115200);                  /* 115.2 kbps, N-8-1. */
 	outb (MCR_REG, MCR_OUT2);             /* Required to enable interrupts. */
-	intq_init (&txq);
+	lock_init (&txq_lock);
 	mode = POLL;
 }
 
@@ -79,57 +100,107 @@ init_poll (void) {
    waiting for the serial device to become ready. */
 void
 serial_init_queue (void) {
-	enum intr_level old_level;
-
 	if (mode == UNINIT)
 		init_poll ();
 	ASSERT (mode == POLL);
 
 	intr_register_ext (0x20 + 4, serial_interrupt, "serial");
+	spin_lock (&serial_lock);
 	mode = QUEUE;
-	old_level = intr_disable ();
 	write_ier ();
-	intr_set_level (old_level);
+	spin_unlock (&serial_lock);
 }
 
 /* Sends BYTE to the serial port. */
 void
 serial_putc (uint8_t byte) {
-	enum intr_level old_level = intr_disable ();
+	serial_write (&byte, 1);
+}
+
+/* Makes room in the transmit ring, which is full, with
+   serial_lock held.  If interrupts were off before, as OLD_LEVEL
+   tells, waiting for the transmit interrupt would mean turning
+   them back on.  That's impolite, so we wait for the FIFO to empty
+   by polling and fill it ourselves instead. */
+static void
+make_room (enum intr_level old_level) {
+	enum intr_level level;
+
+	ASSERT (serial_lock.locked);
+
+	if (old_level == INTR_OFF || intr_context ()) {
+		while ((inb (LSR_REG) & LSR_THRE) == 0)
+			continue;
+		tx_burst ();
+		return;
+	}
+
+	/* TXQ_LOCK may block, so it is taken and released with
+	   serial_lock let go. */
+	write_ier ();
+	level = spin_unlock_irqoff (&serial_lock);
+	lock_acquire (&txq_lock);
+	spin_relock (&serial_lock, level);
+	while (txq_head - txq_tail == TXQ_SIZE) {
+		txq_waiter = thread_current ();
+		thread_block_on (&serial_lock);
+	}
+	level = spin_unlock_irqoff (&serial_lock);
+	lock_release (&txq_lock);
+	spin_relock (&serial_lock, level);
+}
+
+/* Sends the N bytes in BUF to the serial port.  serial_lock is
+   taken once for the lot, and the bytes go into the transmit ring
+   as many at a time as there is room for. */
+void
+serial_write (const uint8_t *buf, size_t n) {
+	enum intr_level old_level = intr_get_level ();
 
+	spin_lock (&serial_lock);
 	if (mode != QUEUE) {
 		/* If we're not set up for interrupt-driven I/O yet,
-		   use dumb polling to transmit a byte. */
+		   use dumb polling to transmit, a FIFO's worth at a
+		   time. */
 		if (mode == UNINIT)
 			init_poll ();
-		putc_poll (byte);
+		while (n > 0) {
+			size_t cnt = n < FIFO_SIZE ? n : FIFO_SIZE;
+
+			while ((inb (LSR_REG) & LSR_THRE) == 0)
+				continue;
+			n -= cnt;
+			while (cnt-- > 0)
+				outb (THR_REG, *buf++);
+		}
 	} else {
-		/* Otherwise, queue a byte and update the interrupt enable
-		   register. */
-		if (old_level == INTR_OFF && intq_full (&txq)) {
-			/* Interrupts are off and the transmit queue is full.
-			   If we wanted to wait for the queue to empty,
-			   we'd have to reenable interrupts.
-			   That's impolite, so we'll send a character via
-			   polling instead. */
-			putc_poll (intq_getc (&txq));
+		/* Otherwise, queue the bytes and update the interrupt
+		   enable register. */
+		while (n > 0) {
+			if (txq_head - txq_tail == TXQ_SIZE)
+				make_room (old_level);
+			while (n > 0 && txq_head - txq_tail < TXQ_SIZE) {
+				txq[txq_head++ % TXQ_SIZE] = *buf++;
+				n--;
+			}
 		}
-
-		intq_putc (&txq, byte);
 		write_ier ();
 	}
 
-	intr_set_level (old_level);
+	spin_unlock (&serial_lock);
 }
 
 /* Flushes anything in the serial buffer out the port in polling
    mode. */
 void
 serial_flush (void) {
-	enum intr_level old_level = intr_disable ();
-	while (!intq_empty (&txq))
-		putc_poll (intq_getc (&txq));
-	intr_set_level (old_level);
+	spin_lock (&serial_lock);
+	while (txq_tail != txq_head) {
+		while ((inb (LSR_REG) & LSR_THRE) == 0)
+			continue;
+		tx_burst ();
+	}
+	spin_unlock (&serial_lock);
 }
 
 /* The fullness of the input buffer may have changed.  Reassess
@@ -139,8 +210,10 @@ serial_flush (void) {
 void
 serial_notify (void) {
 	ASSERT (intr_get_level () == INTR_OFF);
+	spin_lock (&serial_lock);
 	if (mode == QUEUE)
 		write_ier ();
+	spin_unlock (&serial_lock);
 }
 
 /* Configures the serial port for BPS bits per second. */
@@ -167,11 +240,11 @@ static void
 write_ier (void) {
 	uint8_t ier = 0;
 
-	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (serial_lock.locked);
 
 	/* Enable transmit interrupt if we have any characters to
 	   transmit. */
-	if (!intq_empty (&txq))
+	if (txq_tail != txq_head)
 		ier |= IER_XMIT;
 
 	/* Enable receive interrupt if we have room to store any
@@ -182,15 +255,19 @@ write_ier (void) {
 	outb (IER_REG, ier);
 }
 
-/* Polls the serial port until it's ready,
-   and then transmits BYTE. */
+/* Moves up to FIFO_SIZE bytes from the transmit ring into the
+   transmit FIFO, which must be empty, and wakes up a thread
+   waiting for room in the ring. */
 static void
-putc_poll (uint8_t byte) {
-	ASSERT (intr_get_level () == INTR_OFF);
-
-	while ((inb (LSR_REG) & LSR_THRE) == 0)
-		continue;
-	outb (THR_REG, byte);
+tx_burst (void) {
+	ASSERT (serial_lock.locked);
+
+	for (int i = 0; i < FIFO_SIZE && txq_tail != txq_head; i++)
+		outb (THR_REG, txq[txq_tail++ % TXQ_SIZE]);
+	if (txq_waiter != NULL && txq_head - txq_tail < TXQ_SIZE) {
+		thread_unblock (txq_waiter);
+		txq_waiter = NULL;
+	}
 }
 
 /* Serial interrupt handler. */
@@ -201,15 +278,18 @@ serial_interrupt (struct intr_frame *f UNUSED) {
 	inb (IIR_REG);
 
 	/* As long as we have room to receive a byte, and the hardware
-	   has a byte for us, receive a byte.  */
+	   has a byte for us, receive a byte.  input_putc() calls
+	   serial_notify(), so serial_lock is not held yet. */
 	while (!input_full () && (inb (LSR_REG) & LSR_DR) != 0)
 		input_putc (inb (RBR_REG));
 
-	/* As long as we have a byte to transmit, and the hardware is
-	   ready to accept a byte for transmission, transmit a byte. */
-	while (!intq_empty (&txq) && (inb (LSR_REG) & LSR_THRE) != 0)
-		outb (THR_REG, intq_getc (&txq));
+	/* If we have bytes to transmit and the transmit FIFO has run
+	   empty, refill it. */
+	spin_lock (&serial_lock);
+	if (txq_tail != txq_head && (inb (LSR_REG) & LSR_THRE) != 0)
+		tx_burst ();
 
 	/* Update interrupt enable register based on queue status. */
 	write_ier ();
+	spin_unlock (&serial_lock);
 }
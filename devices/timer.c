@@ -1,12 +1,23 @@
 #include "devices/timer.h"
 #include <debug.h>
+#include <clock-page.h>
+#include <heap.h>
 #include <inttypes.h>
 #include <round.h>
 #include <stdio.h>
+#include "threads/apic.h"
+#include "threads/atomic.h"
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
+#include "threads/palloc.h"
+#include "threads/profile.h"
+#include "threads/softirq.h"
+#include "threads/spinlock.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/workqueue.h"
+#include "intrinsic.h"
 
 /* See [8254] for hardware details of the 8254 timer chip. */
 
@@ -25,24 +36,157 @@ static int64_t ticks;
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+/* Page that user processes map read-only to read ticks; see
+   lib/clock-page.h.  Updated whenever ticks changes. */
+static struct clock_page *clock_page;
+
+/* 8254 input frequency divided by TIMER_FREQ, rounded to
+   nearest: the PIT count of one timer tick. */
+#define PIT_TICK_COUNT ((1193180 + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Longest one-shot the 16-bit PIT counter can time, in ticks. */
+#define TICKLESS_MAX_TICKS (0xffff / PIT_TICK_COUNT)
+
+/* If true, the idle thread stops the periodic tick and programs
+   a one-shot interrupt for the next sleeper deadline.
+   Controlled by kernel command-line option "-tickless". */
+bool timer_tickless;
+
+/* Pending one-shot programmed by timer_idle_enter(), or 0 ticks
+   if the PIT is in its normal periodic mode. */
+static int64_t oneshot_ticks;       /* Ticks the one-shot covers. */
+static unsigned oneshot_count;      /* PIT count it was started with. */
+static unsigned oneshot_first;      /* PIT count left in the tick it began in. */
+
+/* Nanoseconds per timer tick. */
+#define NS_PER_TICK (1000000000 / TIMER_FREQ)
+
+/* High-resolution sleep.  Sub-tick sleeps block on a heap ordered
+   by deadline in nanoseconds.  With a local APIC they are woken by
+   its timer, set to go off once at the earliest deadline.
+   Otherwise the CMOS real-time clock's periodic interrupt wakes
+   them, which runs at RTC_HZ only while the heap is not empty.
+   Delays shorter than one RTC period are not worth blocking for,
+   so they still busy-wait. */
+#define RTC_HZ 8192
+#define RTC_RATE 3                  /* 32768 >> (RTC_RATE - 1) == RTC_HZ. */
+#define RTC_PERIOD_NS (1000000000 / RTC_HZ)
+
+/* A thread in timer_hr_sleep(). */
+struct hr_sleeper {
+	struct heap_elem elem;          /* Element in hr_sleepers. */
+	int64_t deadline;               /* timer_ns() at which to wake. */
+	struct thread *thread;          /* The sleeping thread. */
+};
+
+static struct heap hr_sleepers;
+
+/* Protects hr_sleepers and the RTC's periodic interrupt enable.
+   The sleepers may be on any CPU, and any CPU's APIC timer may be
+   the one that wakes them. */
+static struct spinlock hr_lock = SPINLOCK_INITIALIZER;
+
+/* Local APIC timer counts per timer tick, or 0 if the RTC wakes
+   high-resolution sleepers.  Set by calibrate_apic(). */
+static uint64_t apic_per_tick;
+
+/* Latest value returned by timer_ns(), which keeps it monotonic.
+   With the PIT's count, which takes two reads to latch, under
+   pit_lock. */
+static int64_t last_ns;
+static struct spinlock pit_lock = SPINLOCK_INITIALIZER;
+
+/* TSC at the tick that made ticks its current value.  With
+   ticks, under timer_seq, so that timer_ns() can read the pair
+   without turning interrupts off. */
+static uint64_t tick_tsc;
+static struct seqlock timer_seq;
+
+/* Work of the timer interrupt that can wait until after it: waking
+   sleepers and the MLFQS recalculations, which walk every thread.
+   The flags say which recalculations are due. */
+static struct softirq_work timer_work;
+static bool mlfqs_second_due;       /* load_avg and every recent_cpu. */
+static bool mlfqs_priority_due;     /* The running thread's priority. */
+
 static intr_handler_func timer_interrupt;
+static intr_handler_func tick_interrupt;
+static softirq_func timer_softirq;
+static intr_handler_func rtc_interrupt;
+static intr_handler_func apic_timer_interrupt;
+static void timer_hr_sleep (int64_t ns);
+static void hr_wake (int64_t now);
+static void hr_arm (int64_t now);
+static bool hr_sleeper_less (const struct heap_elem *, const struct heap_elem *,
+		void *aux);
+static uint8_t cmos_read (uint8_t reg);
+static void cmos_write (uint8_t reg, uint8_t value);
+static bool calibrate_tsc (void);
+static void calibrate_apic (void);
+static unsigned pit_wait (unsigned counts);
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
+static void pit_program (uint8_t mode, uint16_t count);
+static uint16_t pit_read (void);
 
 /* Sets up the 8254 Programmable Interval Timer (PIT) to
    interrupt PIT_FREQ times per second, and registers the
    corresponding interrupt. */
 void timer_init (void) {
-	/* 8254 input frequency divided by TIMER_FREQ, rounded to
-	   nearest. */
-	uint16_t count = (1193180 + TIMER_FREQ / 2) / TIMER_FREQ;
-
-	outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
-	outb (0x40, count & 0xff);
-	outb (0x40, count >> 8);
+	pit_program (0x34, PIT_TICK_COUNT); /* CW: counter 0, LSB then MSB, mode 2, binary. */
 
+	seqlock_init (&timer_seq);
+	clock_page = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+	clock_page->freq = TIMER_FREQ;
+	softirq_work_init (&timer_work, timer_softirq, NULL);
 	intr_register_ext (0x20, timer_interrupt, "8254 Timer");
+
+	/* Set the RTC's periodic rate, but leave its interrupt off
+	   until someone sleeps. */
+	heap_init (&hr_sleepers, hr_sleeper_less, NULL);
+	cmos_write (0x0a, (cmos_read (0x0a) & 0xf0) | RTC_RATE);
+	cmos_write (0x0b, cmos_read (0x0b) & ~0x40);
+	cmos_read (0x0c);
+	intr_register_ext (0x28, rtc_interrupt, "RTC");
+	if (apic_enabled ()) {
+		intr_register_ext (APIC_VEC_TIMER, apic_timer_interrupt, "LAPIC Timer");
+		intr_register_ext (APIC_VEC_TICK, tick_interrupt, "Tick IPI");
+	}
+}
+
+/* TSC cycles per timer tick, or 0 if the TSC is not used. */
+static uint64_t tsc_per_tick;
+
+/* PIT counts over which calibrate_tsc() measures the TSC: a
+   quarter of a tick. */
+#define TSC_CALIBRATE_COUNTS (PIT_TICK_COUNT / 4)
+
+/* Busy-wait iterations timed against the TSC by calibrate_tsc(). */
+#define TSC_CALIBRATE_LOOPS (1u << 18)
+
+/* True if timer_set_calibration() gave the results of an earlier
+   calibration to use instead. */
+static bool calibration_cached;
+
+/* Makes timer_calibrate() use LOOPS loops per tick, TSC TSC cycles
+   per tick and, if there is a local APIC, APIC of its counts per
+   tick, as printed by timer_print_calibration() on an earlier boot
+   of the same machine, instead of measuring them.  A value of 0 is
+   measured anyway, which is also how one can say there is no TSC.
+   Called while parsing the kernel command line. */
+void timer_set_calibration (unsigned loops, uint64_t tsc, uint64_t apic) {
+	loops_per_tick = loops;
+	tsc_per_tick = tsc;
+	apic_per_tick = apic;
+	calibration_cached = loops != 0;
+}
+
+/* Prints the kernel command-line option that skips calibration on
+   later boots of this machine. */
+void timer_print_calibration (void) {
+	printf ("-calib=%u:%"PRIu64":%"PRIu64"\n",
+			loops_per_tick, tsc_per_tick, apic_per_tick);
 }
 
 /* Calibrates loops_per_tick, used to implement brief delays. */
@@ -50,8 +194,25 @@ void timer_calibrate (void) {
 	unsigned high_bit, test_bit;
 
 	ASSERT (intr_get_level () == INTR_ON);
+	if (calibration_cached) {
+		/* The local APIC may have been turned off since. */
+		if (!apic_enabled ())
+			apic_per_tick = 0;
+		else if (apic_per_tick == 0)
+			calibrate_apic ();
+		printf ("Calibrating timer...  %'"PRIu64" loops/s (cached).\n",
+				(uint64_t) loops_per_tick * TIMER_FREQ);
+		return;
+	}
+	calibrate_apic ();
 	printf ("Calibrating timer...  ");
 
+	if (calibrate_tsc ()) {
+		printf ("%'"PRIu64" loops/s (TSC %'"PRIu64" Hz).\n",
+				(uint64_t) loops_per_tick * TIMER_FREQ, tsc_per_tick * TIMER_FREQ);
+		return;
+	}
+
 	/* Approximate loops_per_tick as the largest power-of-two
 	   still less than one timer tick. */
 	loops_per_tick = 1u << 10;
@@ -72,13 +233,67 @@ void timer_calibrate (void) {
 /* Returns the number of timer ticks since the OS booted. */
 /* 현재 ticks를 반환하는 함수 */
 int64_t timer_ticks (void) {
-	enum intr_level old_level = intr_disable ();
-	int64_t t = ticks;
-	intr_set_level (old_level);
+	/* ticks is only written by the timer interrupt, and reading an
+	   aligned 64-bit value is atomic, so no need to turn
+	   interrupts off. */
+	int64_t t = atomic_read_64 (&ticks);
 	barrier ();
 	return t;
 }
 
+/* Returns the frequency of the TSC in Hz as calibrated by
+   timer_calibrate(), or 0 if the TSC is not used. */
+uint64_t timer_tsc_hz (void) {
+	return tsc_per_tick * TIMER_FREQ;
+}
+
+/* Returns the kernel virtual address of the clock page, for
+   mapping into user processes. */
+void *timer_clock_page (void) {
+	return clock_page;
+}
+
+/* Returns the number of nanoseconds since the OS booted.  With a
+   calibrated TSC, this is the time of the last tick plus the TSC
+   cycles since, capped at one tick so that it never passes the
+   next tick's value before that tick is counted.  Otherwise it is
+   measured by the PIT, whose resolution is one PIT count, about
+   838 ns, except while the idle thread has stopped the periodic
+   tick, when it is one timer tick. */
+int64_t timer_ns (void) {
+	int64_t ns;
+
+	if (tsc_per_tick != 0) {
+		int64_t t;
+		uint64_t since;
+		unsigned seq;
+
+		do {
+			seq = seqlock_read_begin (&timer_seq);
+			t = ticks;
+			since = rdtsc () - tick_tsc;
+		} while (seqlock_read_retry (&timer_seq, seq));
+
+		if (since >= tsc_per_tick)
+			since = tsc_per_tick - 1;
+		return t * NS_PER_TICK + (int64_t) (since * NS_PER_TICK / tsc_per_tick);
+	}
+
+	spin_lock (&pit_lock);
+	ns = ticks * NS_PER_TICK;
+
+	if (oneshot_ticks == 0)
+		ns += (int64_t) (PIT_TICK_COUNT - pit_read ()) * NS_PER_TICK / PIT_TICK_COUNT;
+
+	/* Just after the counter reloads, the tick it finished may not
+	   have been counted yet; never go backward because of that. */
+	if (ns < last_ns)
+		ns = last_ns;
+	last_ns = ns;
+	spin_unlock (&pit_lock);
+	return ns;
+}
+
 /* Returns the number of timer ticks elapsed since THEN, which
    should be a value once returned by timer_ticks(). */
 /* 시작 시간 아후로 경과된 시간(ticks)을 반환하는 함수 */
@@ -97,6 +312,31 @@ void timer_sleep (int64_t ticks) {
 	thread_sleep(start + ticks);
 }
 
+/* Suspends execution for at least TICKS timer ticks and at most
+   SLACK more, for sleepers that need not wake at an exact tick.
+   The wakeup is moved, within that window, onto the next sleeper's
+   deadline if it falls there, or else onto the tick in the window
+   that is the multiple of the highest power of 2.  Sleepers with
+   overlapping windows thus tend to share a tick, which wakes them
+   in one batch, and tickless idle waits longer between ticks. */
+// 깨어날 tick을 다른 쓰레드와 맞춰서 한 번에 깨움
+void timer_sleep_slack (int64_t ticks, int64_t slack) {
+	int64_t start = timer_ticks ();
+	int64_t lo = start + ticks, hi = lo + (slack > 0 ? slack : 0);
+	int64_t next = get_next_tick_to_awake ();
+	int64_t wake = hi;
+
+	ASSERT (intr_get_level () == INTR_ON);
+
+	if (next >= lo && next <= hi)
+		wake = next;
+	else
+		/* 가장 낮은 1 비트를 지워도 창 안이면 계속 지움 */
+		while (wake > 0 && (wake & (wake - 1)) >= lo)
+			wake &= wake - 1;
+	thread_sleep (wake);
+}
+
 /* Suspends execution for approximately MS milliseconds. */
 /* ms시간동안 실행을 정지시키는 함수 */
 void timer_msleep (int64_t ms) {
@@ -121,29 +361,223 @@ void timer_print_stats (void) {
 	printf ("Timer: %"PRId64" ticks\n", timer_ticks ()); // ticks를 %l 포맷으로 출력
 }
 
+/* Called by the idle thread, with interrupts off, just before it
+   halts.  In tickless mode, replaces the periodic tick by a
+   one-shot interrupt at the next sleeper deadline, as far as the
+   PIT can count.  Under the MLFQS the one-shot never passes a
+   second boundary, so the load average is still updated on time.
+   The other CPUs take their ticks from ours, so with more than one
+   CPU online the tick never stops. */
+void timer_idle_enter (void) {
+	int64_t target, skip;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	if (!timer_tickless || oneshot_ticks != 0 || cpu_cnt > 1)
+		return;
+
+	/* High-resolution sleepers need the PIT's sub-tick count. */
+	if (!heap_empty (&hr_sleepers))
+		return;
+
+	target = get_next_tick_to_awake ();
+	if (workqueue_next_expiry () < target)
+		target = workqueue_next_expiry ();
+	if (thread_mlfqs && target > ticks - ticks % TIMER_FREQ + TIMER_FREQ)
+		target = ticks - ticks % TIMER_FREQ + TIMER_FREQ;
+
+	skip = target - ticks;
+	if (skip > TICKLESS_MAX_TICKS)
+		skip = TICKLESS_MAX_TICKS;
+	if (skip < 2)
+		return;
+
+	/* Finish the current tick, then count SKIP - 1 more. */
+	oneshot_first = pit_read ();
+	oneshot_count = oneshot_first + (skip - 1) * PIT_TICK_COUNT;
+	oneshot_ticks = skip;
+	pit_program (0x30, oneshot_count); /* CW: counter 0, LSB then MSB, mode 0, binary. */
+}
+
+/* Called by the scheduler, with interrupts off, when it switches
+   away from the idle thread.  If another interrupt woke the CPU
+   before the one-shot expired, accounts for the whole ticks that
+   have passed and restores the periodic tick.  Returns the number
+   of ticks accounted. */
+int64_t timer_idle_exit (void) {
+	unsigned elapsed;
+	int64_t passed = 0;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	if (oneshot_ticks == 0 || this_cpu () != &cpus[0])
+		return 0;
+
+	elapsed = oneshot_count - pit_read ();
+	if (elapsed >= oneshot_first)
+		passed = 1 + (elapsed - oneshot_first) / PIT_TICK_COUNT;
+	if (passed >= oneshot_ticks)
+		passed = oneshot_ticks - 1; /* Its interrupt is pending. */
+
+	/* Before any whole tick has passed, ticks and tick_tsc still
+	   describe the tick the one-shot began in. */
+	if (passed > 0) {
+		seqlock_write_begin (&timer_seq);
+		ticks += passed;
+		tick_tsc = rdtsc ();
+		seqlock_write_end (&timer_seq);
+		clock_page->ticks = ticks;
+	}
+	oneshot_ticks = 0;
+	pit_program (0x34, PIT_TICK_COUNT);
+	return passed;
+}
+
 /* Timer interrupt handler. */
 /* 타이머 인터럽트 핸들러 */
 // 전역변수 ticks를 증가시켜주며, 쓰레드를 깨워주는 함수
-static void timer_interrupt (struct intr_frame *args UNUSED) {
+static void timer_interrupt (struct intr_frame *args) {
+	if (profile_enabled)
+		profile_sample (args);
+	if (oneshot_ticks != 0) {
+		/* The idle one-shot expired: go back to the periodic tick
+		   and account the ticks it skipped to the idle thread. */
+		pit_program (0x34, PIT_TICK_COUNT);
+		while (--oneshot_ticks > 0) {
+			ticks++;
+			thread_tick ();
+		}
+	}
+
+	seqlock_write_begin (&timer_seq);
 	ticks++;
+	tick_tsc = rdtsc ();
+	seqlock_write_end (&timer_seq);
+	clock_page->ticks = ticks;
+	if (cpu_cnt > 1)
+		apic_send_ipi_others (APIC_VEC_TICK);
 	thread_tick ();
-	// 깨울 쓰레드가 존재한다면 깨워줌
-	// if (get_next_tick_to_awake() <= ticks) {
-	// 	thread_awake(ticks);
-	// }
 
 	/* advanced scheduling */
 	if (thread_mlfqs) {
 		mlfqs_increment_recent_cpu();
-		if (ticks % 4 == 0) {
-			mlfqs_recalc_priority();
-			if (ticks % TIMER_FREQ == 0) {
-				mlfqs_recalc_recent_cpu ();
-				mlfqs_load_avg();
-			}
-		}
+		if (ticks % TIMER_FREQ == 0)
+			mlfqs_second_due = true;
+		if (ticks % 4 == 0)
+			mlfqs_priority_due = true;
 	}
-	thread_awake(ticks);
+
+	// 깨울 쓰레드가 존재한다면 깨워줌. 대부분의 tick에서는 비교 한 번으로 끝남
+	if (mlfqs_second_due || mlfqs_priority_due
+			|| get_next_tick_to_awake() <= ticks)
+		softirq_queue (&timer_work);
+}
+
+/* Timer tick of the other CPUs.  The PIT interrupts only the boot
+   CPU, whose timer_interrupt() passes each tick on to the others
+   with an IPI, so only the running thread's share of the tick's
+   work is left to do here. */
+static void tick_interrupt (struct intr_frame *args UNUSED) {
+	thread_tick ();
+	if (thread_mlfqs)
+		mlfqs_increment_recent_cpu ();
+}
+
+/* Deferred part of the timer interrupt. */
+static void timer_softirq (void *aux UNUSED) {
+	enum intr_level old_level;
+	bool second, priority;
+	int64_t now;
+
+	old_level = intr_disable ();
+	second = mlfqs_second_due;
+	priority = mlfqs_priority_due;
+	mlfqs_second_due = mlfqs_priority_due = false;
+	now = ticks;
+	intr_set_level (old_level);
+
+	if (second) {
+		mlfqs_load_avg();
+		mlfqs_recalc_recent_cpu (); // 모든 쓰레드의 recent_cpu와 priority
+	}
+	if (priority)
+		mlfqs_recalc_priority(); // running 쓰레드의 priority만
+
+	if (get_next_tick_to_awake() <= now)
+		thread_awake(now);
+}
+
+/* Sets loops_per_tick from the speed of the TSC, measured against
+   the PIT over TSC_CALIBRATE_COUNTS, and the TSC cycles taken by
+   TSC_CALIBRATE_LOOPS iterations of busy_wait().  This takes a few
+   milliseconds, where probing with too_many_loops() waits for a
+   full tick per probe.  Returns false, leaving loops_per_tick
+   alone, if there is no TSC or the results are not plausible. */
+static bool calibrate_tsc (void) {
+	uint32_t eax, ebx, ecx, edx;
+	enum intr_level old_level;
+	uint64_t tsc_start, tsc_pit, tsc_loop, loops;
+	unsigned elapsed;
+
+	cpuid (1, &eax, &ebx, &ecx, &edx);
+	if (!(edx & (1u << 4)))           /* CPUID.1:EDX.TSC */
+		return false;
+
+	old_level = intr_disable ();
+	tsc_start = rdtsc ();
+	elapsed = pit_wait (TSC_CALIBRATE_COUNTS);
+	tsc_pit = rdtsc () - tsc_start;
+
+	tsc_start = rdtsc ();
+	busy_wait (TSC_CALIBRATE_LOOPS);
+	tsc_loop = rdtsc () - tsc_start;
+	intr_set_level (old_level);
+
+	if (tsc_pit == 0 || tsc_loop == 0)
+		return false;
+	tsc_per_tick = tsc_pit * PIT_TICK_COUNT / elapsed;
+	loops = TSC_CALIBRATE_LOOPS * tsc_per_tick / tsc_loop;
+	if (loops < (1u << 10) || loops > UINT32_MAX) {
+		tsc_per_tick = 0;
+		return false;
+	}
+	loops_per_tick = loops;
+	return true;
+}
+
+/* Sets apic_per_tick from the counts the local APIC timer runs
+   down while the PIT counts TSC_CALIBRATE_COUNTS, if there is a
+   local APIC.  From then on its timer, not the RTC, wakes
+   high-resolution sleepers. */
+static void calibrate_apic (void) {
+	enum intr_level old_level;
+	unsigned elapsed;
+	uint32_t left;
+
+	if (!apic_enabled ())
+		return;
+
+	old_level = intr_disable ();
+	apic_timer_start (UINT32_MAX);
+	elapsed = pit_wait (TSC_CALIBRATE_COUNTS);
+	left = apic_timer_read ();
+	apic_timer_start (0);
+	intr_set_level (old_level);
+
+	apic_per_tick = (uint64_t) (UINT32_MAX - left) * PIT_TICK_COUNT / elapsed;
+}
+
+/* Busy-waits until the PIT has counted down at least COUNTS,
+   allowing for its reload at 0 in mode 2, and returns the exact
+   number.  Interrupts must be off. */
+static unsigned pit_wait (unsigned counts) {
+	unsigned elapsed = 0;
+	uint16_t prev = pit_read (), cur;
+
+	while (elapsed < counts) {
+		cur = pit_read ();
+		elapsed += cur <= prev ? prev - cur : prev + PIT_TICK_COUNT - cur;
+		prev = cur;
+	}
+	return elapsed;
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
@@ -191,6 +625,11 @@ static void real_time_sleep (int64_t num, int32_t denom) {
 		   timer_sleep() because it will yield the CPU to other
 		   processes. */
 		timer_sleep (ticks);
+	} else if (num * (1000000000 / denom) >= RTC_PERIOD_NS) {
+		/* Less than a tick, but long enough to block until the
+		   high-resolution timer wakes us. */
+		ASSERT (1000000000 % denom == 0);
+		timer_hr_sleep (num * (1000000000 / denom));
 	} else {
 		/* Otherwise, use a busy-wait loop for more accurate
 		   sub-tick timing.  We scale the numerator and denominator
@@ -198,4 +637,119 @@ static void real_time_sleep (int64_t num, int32_t denom) {
 		ASSERT (denom % 1000 == 0);
 		busy_wait (loops_per_tick * num / 1000 * TIMER_FREQ / (denom / 1000));
 	}
-}
\ No newline at end of file
+}
+
+/* Blocks the current thread for at least NS nanoseconds.  The local
+   APIC timer is set for the new deadline if it is the earliest, or
+   else the RTC interrupt is turned on for as long as anyone is
+   sleeping here. */
+static void timer_hr_sleep (int64_t ns) {
+	struct hr_sleeper sleeper;
+
+	ASSERT (intr_get_level () == INTR_ON);
+
+	sleeper.deadline = timer_ns () + ns;
+	sleeper.thread = thread_current ();
+
+	spin_lock (&hr_lock);
+	if (apic_per_tick == 0 && heap_empty (&hr_sleepers))
+		cmos_write (0x0b, cmos_read (0x0b) | 0x40);
+	heap_push (&hr_sleepers, &sleeper.elem);
+	if (apic_per_tick != 0 && heap_top (&hr_sleepers) == &sleeper.elem)
+		hr_arm (timer_ns ());
+	thread_block_on (&hr_lock);
+	spin_unlock (&hr_lock);
+}
+
+/* RTC periodic interrupt handler. */
+static void rtc_interrupt (struct intr_frame *args UNUSED) {
+	int64_t now = timer_ns ();
+
+	spin_lock (&hr_lock);
+	cmos_read (0x0c);             /* Acknowledge, or it won't fire again. */
+	hr_wake (now);
+	if (heap_empty (&hr_sleepers))
+		cmos_write (0x0b, cmos_read (0x0b) & ~0x40);
+	spin_unlock (&hr_lock);
+}
+
+/* Local APIC timer interrupt handler, for the one-shot set by
+   hr_arm(). */
+static void apic_timer_interrupt (struct intr_frame *args UNUSED) {
+	int64_t now = timer_ns ();
+
+	spin_lock (&hr_lock);
+	hr_wake (now);
+	if (!heap_empty (&hr_sleepers))
+		hr_arm (now);
+	spin_unlock (&hr_lock);
+}
+
+/* Wakes the high-resolution sleepers whose deadline is NOW or
+   before, preempting the running thread if one of them has a
+   higher priority.  hr_lock must be held. */
+static void hr_wake (int64_t now) {
+	while (!heap_empty (&hr_sleepers)) {
+		struct hr_sleeper *s = heap_entry (heap_top (&hr_sleepers),
+				struct hr_sleeper, elem);
+		if (s->deadline > now)
+			break;
+		heap_pop (&hr_sleepers);
+		thread_unblock (s->thread);
+		if (s->thread->priority > thread_current ()->priority)
+			intr_yield_on_return ();
+	}
+}
+
+/* Sets the local APIC timer to go off at the earliest deadline in
+   hr_sleepers, which must not be empty, given that it is NOW.
+   hr_lock must be held. */
+static void hr_arm (int64_t now) {
+	struct hr_sleeper *s = heap_entry (heap_top (&hr_sleepers),
+			struct hr_sleeper, elem);
+	uint64_t count = 1;
+
+	if (s->deadline > now)
+		count += (uint64_t) (s->deadline - now) * apic_per_tick / NS_PER_TICK;
+	apic_timer_start (count < UINT32_MAX ? count : UINT32_MAX);
+}
+
+/* Orders hr_sleepers by deadline, earliest on top. */
+static bool hr_sleeper_less (const struct heap_elem *a_,
+		const struct heap_elem *b_, void *aux UNUSED) {
+	const struct hr_sleeper *a = heap_entry (a_, struct hr_sleeper, elem);
+	const struct hr_sleeper *b = heap_entry (b_, struct hr_sleeper, elem);
+
+	return a->deadline < b->deadline;
+}
+
+/* Returns CMOS register REG.  Setting bit 7 of the index keeps
+   NMIs disabled while we access the CMOS. */
+static uint8_t cmos_read (uint8_t reg) {
+	outb (0x70, 0x80 | reg);
+	return inb (0x71);
+}
+
+/* Sets CMOS register REG to VALUE. */
+static void cmos_write (uint8_t reg, uint8_t value) {
+	outb (0x70, 0x80 | reg);
+	outb (0x71, value);
+}
+
+/* Programs PIT counter 0 with control word MODE and initial
+   COUNT. */
+static void pit_program (uint8_t mode, uint16_t count) {
+	outb (0x43, mode);
+	outb (0x40, count & 0xff);
+	outb (0x40, count >> 8);
+}
+
+/* Returns the current value of PIT counter 0. */
+static uint16_t pit_read (void) {
+	uint8_t lo, hi;
+
+	outb (0x43, 0x00);    /* CW: counter 0, latch count. */
+	lo = inb (0x40);
+	hi = inb (0x40);
+	return lo | (hi << 8);
+}
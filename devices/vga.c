@@ -4,7 +4,7 @@
 #include <stddef.h>
 #include <string.h>
 #include "threads/io.h"
-#include "threads/interrupt.h"
+#include "threads/spinlock.h"
 #include "threads/vaddr.h"
 
 /* VGA text screen support.  See [FREEVGA] for more information. */
@@ -13,10 +13,25 @@
 #define COL_CNT 80
 #define ROW_CNT 25
 
+/* Rows of text that fit in the 32 kB of text memory.  The display
+   shows ROW_CNT of them starting at row TOP, so scrolling up a
+   line is moving TOP down a row, through the CRTC start address
+   register, instead of copying the screen.  Only once the display
+   reaches the last of these rows are its rows copied back to the
+   start. */
+#define VROW_CNT (0x8000 / (COL_CNT * 2))
+
 /* Current cursor position.  (0,0) is in the upper left corner of
    the display. */
 static size_t cx, cy;
 
+/* Row of text memory shown at the top of the display. */
+static size_t top;
+
+/* Protects the display state above and the CRTC, against
+   interrupt handlers and other CPUs that write to the console. */
+static struct spinlock vga_lock = SPINLOCK_INITIALIZER;
+
 /* Attribute value for gray text on a black background. */
 #define GRAY_ON_BLACK 0x07
 
@@ -25,10 +40,12 @@ static size_t cx, cy;
    The attribute at (x,y) is fb[y][x][1]. */
 static uint8_t (*fb)[COL_CNT][2];
 
+static void put (int c);
 static void clear_row (size_t y);
 static void cls (void);
 static void newline (void);
 static void move_cursor (void);
+static void set_start (void);
 static void find_cursor (size_t *x, size_t *y);
 
 /* Initializes the VGA text display. */
@@ -39,6 +56,7 @@ init (void) {
 	if (!inited) {
 		fb = ptov (0xb8000);
 		find_cursor (&cx, &cy);
+		set_start ();
 		inited = true;
 	}
 }
@@ -47,12 +65,36 @@ init (void) {
    characters in the conventional ways.  */
 void
 vga_putc (int c) {
-	/* Disable interrupts to lock out interrupt handlers
-	   that might write to the console. */
-	enum intr_level old_level = intr_disable ();
+	char c2 = c;
+
+	vga_write (&c2, 1);
+}
 
+/* Writes the N characters in BUF to the VGA text display, as
+   vga_putc() would one by one, but moving the hardware cursor and
+   the display start just once at the end. */
+void
+vga_write (const char *buf, size_t n) {
+	size_t old_top;
+
+	spin_lock (&vga_lock);
 	init ();
+	old_top = top;
+	while (n-- > 0)
+		put (*buf++);
+
+	/* Update display start and cursor position. */
+	if (top != old_top)
+		set_start ();
+	move_cursor ();
 
+	spin_unlock (&vga_lock);
+}
+
+/* Writes C at the cursor, or acts on it if it is a control
+   character, without moving the hardware cursor. */
+static void
+put (int c) {
 	switch (c) {
 		case '\n':
 			newline ();
@@ -78,17 +120,12 @@ vga_putc (int c) {
 			break;
 
 		default:
-			fb[cy][cx][0] = c;
-			fb[cy][cx][1] = GRAY_ON_BLACK;
+			fb[top + cy][cx][0] = c;
+			fb[top + cy][cx][1] = GRAY_ON_BLACK;
 			if (++cx >= COL_CNT)
 				newline ();
 			break;
 	}
-
-	/* Update cursor position. */
-	move_cursor ();
-
-	intr_set_level (old_level);
 }
 
 /* Clears the screen and moves the cursor to the upper left. */
@@ -96,22 +133,24 @@ static void
 cls (void) {
 	size_t y;
 
+	top = 0;
 	for (y = 0; y < ROW_CNT; y++)
 		clear_row (y);
 
 	cx = cy = 0;
+	set_start ();
 	move_cursor ();
 }
 
-/* Clears row Y to spaces. */
+/* Clears display row Y to spaces. */
 static void
 clear_row (size_t y) {
 	size_t x;
 
 	for (x = 0; x < COL_CNT; x++)
 	{
-		fb[y][x][0] = ' ';
-		fb[y][x][1] = GRAY_ON_BLACK;
+		fb[top + y][x][0] = ' ';
+		fb[top + y][x][1] = GRAY_ON_BLACK;
 	}
 }
 
@@ -125,7 +164,13 @@ newline (void) {
 	if (cy >= ROW_CNT)
 	{
 		cy = ROW_CNT - 1;
-		memmove (&fb[0], &fb[1], sizeof fb[0] * (ROW_CNT - 1));
+		if (top + ROW_CNT < VROW_CNT)
+			top++;
+		else
+		{
+			memmove (&fb[0], &fb[top + 1], sizeof fb[0] * (ROW_CNT - 1));
+			top = 0;
+		}
 		clear_row (ROW_CNT - 1);
 	}
 }
@@ -134,11 +179,21 @@ newline (void) {
 static void
 move_cursor (void) {
 	/* See [FREEVGA] under "Manipulating the Text-mode Cursor". */
-	uint16_t cp = cx + COL_CNT * cy;
+	uint16_t cp = cx + COL_CNT * (top + cy);
 	outw (0x3d4, 0x0e | (cp & 0xff00));
 	outw (0x3d4, 0x0f | (cp << 8));
 }
 
+/* Shows the display from row TOP of text memory on. */
+static void
+set_start (void) {
+	/* See [FREEVGA] under "CRTC Registers", Start Address High and
+	   Low. */
+	uint16_t start = COL_CNT * top;
+	outw (0x3d4, 0x0c | (start & 0xff00));
+	outw (0x3d4, 0x0d | (start << 8));
+}
+
 /* Reads the current hardware cursor position into (*X,*Y). */
 static void
 find_cursor (size_t *x, size_t *y) {
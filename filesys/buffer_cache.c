@@ -0,0 +1,1135 @@
+/* buffer_cache.c: Write-back cache of file system sectors. */
+
+#include "filesys/buffer_cache.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <memstat.h>
+#include <ohash.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/filesys.h"
+#include "filesys/journal.h"
+#include "filesys/mount.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/tunable.h"
+#include "threads/vaddr.h"
+
+/* Sector buffer cache.
+ *
+ * Every sector of a mounted disk that the inode layer reads or
+ * writes goes through one of the cache's buffers, found by sector
+ * number in an open-addressing hash table of the mount's, in its
+ * struct bc_part.  A write only changes the buffer and marks it
+ * dirty; it reaches the disk when the buffer is replaced, when
+ * kworkerd flushes the cache every BC_FLUSH_TICKS, or when the mount
+ * is closed.  Writing a whole sector needs no read first.
+ *
+ * Buffers are replaced by 2Q, so that one long sequential read does
+ * not push out the sectors that are used over and over.  A sector
+ * brought in goes on the PROBATION queue, which is first in, first
+ * out, and leaves the cache from there unless it is wanted again
+ * after it has gone: the sectors that last left probation are
+ * remembered, without their data, and if one comes back it goes on
+ * the PROTECTED queue, replaced by the second-chance clock.  Uses of
+ * a sector while it is on probation do not count, since a reader
+ * going through a sector a piece at a time uses it many times in a
+ * row.  Probation is replaced from while it holds more than
+ * BC_PROBATION_MAX entries; a stream of reads, however long, then only
+ * ever replaces its own sectors.
+ *
+ * The buffers, the queues and kworkerd are shared by all mounts, so
+ * that a busy disk may have the buffers an idle one does not use.  A
+ * mount's part of the cache has the index of its sectors and those
+ * that last left its probation.
+ *
+ * Metadata, the inodes and the contents of directories, is read with
+ * buffer_cache_read_meta() and written with buffer_cache_write_meta()
+ * and goes on the protected queue at once, so that it stays cached
+ * while data streams through.
+ *
+ * The cache has BC_SIZE buffers of its own, in the kernel pool, and
+ * grows by a page of buffers at a time into the user pool, up to
+ * bc_limit buffers, BC_MAX unless tuned lower, while more than
+ * 1/BC_LEND_DIV of that pool is free.  It gives pages back through
+ * its shrinker, see palloc.c, when user processes need them: a page
+ * goes back once none of its buffers is dirty or busy, which takes
+ * no I/O.
+ *
+ * Runs of whole sectors that miss the cache are read from the disk
+ * with one disk_read_multiple() each, by buffer_cache_read_sectors()
+ * and by readahead.
+ *
+ * kworkerd also reads sectors ahead of time for sequential readers,
+ * as asked by buffer_cache_read_ahead(), so that the disk works while
+ * the reader copies what it has.  A sector read ahead starts out not
+ * accessed, so that if it goes unused it is the first to go.  It also
+ * prefetches scattered sectors, as asked by buffer_cache_prefetch(),
+ * such as the inodes of the entries of a directory being listed,
+ * which are then usually opened one after another: the sectors are
+ * read in order of position, with those close together read in one
+ * request, gaps of up to BC_PREFETCH_GAP sectors included.
+ * kflushd wakes kworkerd for each flush, which with FAT also writes
+ * out the FAT sectors that changed, after the data; without, it
+ * commits the metadata to the journal first.
+ *
+ * With FAT, sectors written with buffer_cache_write_meta(), the FAT
+ * among them, are metadata that the flush of data passes over and
+ * fat_flush() writes after it.  Without FAT, sectors written with buffer_cache_write_meta() are
+ * metadata, kept for the journal.  A metadata sector changed since
+ * the last commit is PINNED: it is not replaced or written in place
+ * until journal_commit() has taken a snapshot of it, and it is
+ * COMMITTING, and cannot change, until the commit record is on disk.
+ * After that the flush leaves it be; it is written in place when it
+ * is replaced, by buffer_cache_checkpoint(), or, synchronously,
+ * before it is changed again, so that what is in place is always what
+ * was last committed.  So that there are always entries to replace, a
+ * thread that would pin more than BC_PIN_MAX entries has a commit
+ * made first.
+ *
+ * A data sector written for a file is on the DIRTY list of the
+ * file's struct bc_owner while it is dirty or being written, so that
+ * buffer_cache_sync() can write just that file's sectors.  An entry
+ * belongs to one owner at a time, the file that wrote it last.
+ *
+ * Readahead and flushes submit their disk requests asynchronously,
+ * all of a batch at once, and wait for them without BC_LOCK.  An
+ * entry being read is LOADING, and whoever wants it waits on
+ * BC_IO_DONE; an entry being written is WRITING, and may still be
+ * read and written, since a write during the transfer makes it dirty
+ * again.  Neither kind can be replaced.
+ *
+ * BC_LOCK covers the cache, including the disk I/O of a miss.  It is
+ * taken inside the inode locks and frame_lock.  Data is copied to and
+ * from the caller's buffer with it held, so a user buffer must be
+ * pinned: a page fault there might need the cache again. */
+#define BC_SIZE 64
+#define BC_CHUNK (PGSIZE / DISK_SECTOR_SIZE)
+#define BC_MAX (BC_SIZE * 8)
+#define BC_LEND_DIV 8
+#define BC_FLUSH_TICKS TIMER_FREQ
+#define BC_FLUSH_SLACK (BC_FLUSH_TICKS / 4)
+#define BC_RA_QUEUE 8
+#define BC_RA_CHUNK (PGSIZE / DISK_SECTOR_SIZE)
+#define BC_PREFETCH_GAP 4
+#define BC_FLUSH_BATCH 8
+#define BC_PIN_MAX (BC_SIZE / 2)
+#define BC_PROBATION_MAX (bc_cnt / 4)
+#define BC_GHOST_MAX (BC_MAX / 2)
+
+/* A cached sector. */
+struct bc_entry {
+	disk_sector_t sector;       /* Sector held, if VALID. */
+	bool valid;                 /* Holds a sector? */
+	bool dirty;                 /* Changed since it was last written? */
+	bool accessed;              /* Used since the clock last passed? */
+	bool loading;               /* Being read by readahead? */
+	bool writing;               /* Being written by a flush? */
+	bool meta;                  /* Metadata, for the journal? */
+	bool pinned;                /* Changed since the last commit? */
+	bool committing;            /* In the commit being written? */
+	bool protected;             /* On bc_protected, not bc_probation? */
+	struct mount *mnt;          /* Mount the sector is of, if VALID. */
+	struct list_elem queue_elem; /* Element in a queue, if VALID. */
+	struct bc_owner *owner;     /* File it is dirty for, or NULL. */
+	struct list_elem owner_elem; /* Element in OWNER's DIRTY list. */
+	uint8_t *data;              /* DISK_SECTOR_SIZE bytes. */
+	struct ohash_elem elem;     /* Element in MNT's index, if VALID. */
+};
+
+/* A page worth of entries. */
+struct bc_chunk {
+	struct bc_entry entries[BC_CHUNK];
+	uint8_t *data;              /* Their data, one page. */
+	bool borrowed;              /* DATA is from the user pool? */
+};
+
+static struct bc_chunk bc_base[BC_SIZE / BC_CHUNK];
+static struct bc_chunk *bc_chunks[BC_MAX / BC_CHUNK];
+static size_t bc_chunk_cnt;
+static size_t bc_cnt;           /* Number of entries, in all chunks. */
+static size_t bc_limit = BC_MAX; /* Most entries to grow to. */
+static struct tunable bc_limit_tunable = {
+	.name = "fs.cache_max", .value = &bc_limit,
+	.min = BC_SIZE, .max = BC_MAX,
+};
+static struct list bc_free;             /* Entries not VALID. */
+static struct list bc_probation;        /* Entries used once, oldest first. */
+static struct list bc_protected;        /* Entries used again, for the clock. */
+static size_t bc_probation_cnt;         /* Number of entries on probation. */
+
+static struct lock bc_lock;
+static struct condition bc_io_done;    /* Some LOADING or WRITING ended. */
+static struct lock bc_flush_lock;      /* One flush at a time. */
+
+/* Work for kworkerd, covered by bc_lock.  Each request is followed by
+ * an up of BC_WORK. */
+struct bc_read_ahead {
+	struct mount *mnt;          /* Mount to read from. */
+	disk_sector_t sector;       /* First sector to read. */
+	size_t cnt;                 /* Number of sectors. */
+};
+static struct bc_read_ahead bc_ra_queue[BC_RA_QUEUE];
+static size_t bc_ra_head, bc_ra_cnt;   /* Oldest request, requests. */
+static struct mount *bc_ra_mnt;        /* Mount being read ahead for. */
+static bool bc_flush_pending;
+static struct semaphore bc_work;
+#ifndef EFILESYS
+static size_t bc_pinned_cnt;           /* Number of PINNED entries. */
+#endif
+
+/* Statistics. */
+static long long bc_hit_cnt, bc_miss_cnt, bc_ra_sector_cnt;
+
+static uint64_t bc_hash (const struct ohash_elem *, void *aux);
+static bool bc_less (const struct ohash_elem *, const struct ohash_elem *,
+		void *aux);
+static void kworkerd (void *aux);
+static void kflushd (void *aux);
+static size_t bc_shrink (size_t page_cnt);
+static void bc_clean (struct bc_entry *);
+
+static struct shrinker bc_shrinker = { .shrink = bc_shrink };
+
+/* Returns entry I of the cache, counting across its chunks. */
+static inline struct bc_entry *
+bc_entry_at (size_t i) {
+	return &bc_chunks[i / BC_CHUNK]->entries[i % BC_CHUNK];
+}
+
+/* Adds CHUNK, with DATA for its entries, to the cache, with all of
+ * its entries free. */
+static void
+bc_chunk_add (struct bc_chunk *chunk, uint8_t *data, bool borrowed) {
+	chunk->data = data;
+	chunk->borrowed = borrowed;
+	for (size_t i = 0; i < BC_CHUNK; i++) {
+		struct bc_entry *e = &chunk->entries[i];
+
+		e->valid = false;
+		e->loading = e->writing = false;
+		e->owner = NULL;
+		e->data = data + i * DISK_SECTOR_SIZE;
+		list_push_back (&bc_free, &e->queue_elem);
+	}
+	bc_chunks[bc_chunk_cnt++] = chunk;
+	bc_cnt += BC_CHUNK;
+}
+
+/* Initializes the buffer cache and starts its flusher. */
+void
+buffer_cache_init (void) {
+	uint8_t *data = palloc_get_multiple (PAL_ASSERT,
+			BC_SIZE * DISK_SECTOR_SIZE / PGSIZE);
+
+	ASSERT (BC_RA_CHUNK + BC_FLUSH_BATCH < BC_SIZE);
+	ASSERT (BC_SIZE % BC_CHUNK == 0);
+
+	lock_init (&bc_lock);
+	lock_register (&bc_lock, "buffer cache");
+	cond_init (&bc_io_done);
+	lock_init (&bc_flush_lock);
+	sema_init (&bc_work, 0);
+	list_init (&bc_free);
+	list_init (&bc_probation);
+	list_init (&bc_protected);
+	for (size_t i = 0; i < BC_SIZE / BC_CHUNK; i++)
+		bc_chunk_add (&bc_base[i], data + i * PGSIZE, false);
+	palloc_register_shrinker (&bc_shrinker);
+	tunable_register (&bc_limit_tunable);
+	thread_create ("kworkerd", PRI_DEFAULT, kworkerd, NULL);
+	thread_create ("kflushd", PRI_DEFAULT, kflushd, NULL);
+}
+
+/* Sets up the part of the cache for MNT, whose metadata goes through
+ * the journal if JOURNALED is true.  Returns false if memory is
+ * short. */
+bool
+buffer_cache_mount (struct mount *mnt, bool journaled) {
+	struct bc_part *part = &mnt->cache;
+
+	part->ghosts = malloc (BC_GHOST_MAX * sizeof *part->ghosts);
+	if (part->ghosts == NULL)
+		return false;
+	if (!ohash_init (&part->index, bc_hash, bc_less, NULL)) {
+		free (part->ghosts);
+		return false;
+	}
+	part->ghost_head = part->ghost_cnt = 0;
+	part->journaled = journaled;
+	return true;
+}
+
+/* Writes what MNT has dirty in the cache to its disk, and drops its
+ * sectors from the cache, for unmounting it.  Nothing else may use
+ * MNT meanwhile, and with a journal, all of its metadata must have
+ * been committed. */
+void
+buffer_cache_unmount (struct mount *mnt) {
+	struct bc_part *part = &mnt->cache;
+
+	buffer_cache_flush ();
+	buffer_cache_checkpoint ();
+
+	/* The flush lock keeps the shrinker from dropping chunks while
+	 * the entries are gone through by index. */
+	lock_acquire (&bc_flush_lock);
+	lock_acquire (&bc_lock);
+	for (size_t i = 0; i < bc_ra_cnt; i++) {
+		struct bc_read_ahead *ra
+			= &bc_ra_queue[(bc_ra_head + i) % BC_RA_QUEUE];
+
+		if (ra->mnt == mnt)
+			ra->cnt = 0;
+	}
+	while (bc_ra_mnt == mnt)
+		cond_wait (&bc_io_done, &bc_lock);
+	for (size_t i = 0; i < bc_cnt; i++) {
+		struct bc_entry *e = bc_entry_at (i);
+
+		while (e->valid && e->mnt == mnt && e->writing)
+			cond_wait (&bc_io_done, &bc_lock);
+		if (!e->valid || e->mnt != mnt)
+			continue;
+		ASSERT (!e->pinned && !e->loading);
+		list_remove (&e->queue_elem);
+		if (!e->protected)
+			bc_probation_cnt--;
+		bc_clean (e);
+		ohash_delete (&part->index, &e->elem);
+		e->valid = false;
+		list_push_back (&bc_free, &e->queue_elem);
+	}
+	lock_release (&bc_lock);
+	lock_release (&bc_flush_lock);
+
+	ohash_destroy (&part->index, NULL);
+	free (part->ghosts);
+	disk_flush (mnt->disk);
+}
+
+/* Returns the hash of entry E. */
+static uint64_t
+bc_hash (const struct ohash_elem *e, void *aux UNUSED) {
+	return hash_u64 (ohash_entry (e, struct bc_entry, elem)->sector);
+}
+
+/* Returns true if entry A holds a lower sector than entry B. */
+static bool
+bc_less (const struct ohash_elem *a, const struct ohash_elem *b,
+		void *aux UNUSED) {
+	return ohash_entry (a, struct bc_entry, elem)->sector
+		< ohash_entry (b, struct bc_entry, elem)->sector;
+}
+
+/* Makes entry E belong to OWNER, which may be null. */
+static void
+bc_set_owner (struct bc_entry *e, struct bc_owner *owner) {
+	if (e->owner == owner)
+		return;
+	if (e->owner != NULL)
+		list_remove (&e->owner_elem);
+	e->owner = owner;
+	if (owner != NULL)
+		list_push_back (&owner->dirty, &e->owner_elem);
+}
+
+/* Writes entry E to disk if it is dirty. */
+static void
+bc_clean (struct bc_entry *e) {
+	ASSERT (lock_held_by_current_thread (&bc_lock));
+
+	if (e->valid && e->dirty) {
+		disk_write (e->mnt->disk, e->sector, e->data);
+		e->dirty = false;
+	}
+	bc_set_owner (e, NULL);
+}
+
+/* Remembers that SECTOR of PART left probation. */
+static void
+bc_ghost_add (struct bc_part *part, disk_sector_t sector) {
+	part->ghosts[part->ghost_head] = sector;
+	part->ghost_head = (part->ghost_head + 1) % BC_GHOST_MAX;
+	if (part->ghost_cnt < BC_GHOST_MAX)
+		part->ghost_cnt++;
+}
+
+/* Returns true if SECTOR of PART is remembered as having left
+ * probation, forgetting it. */
+static bool
+bc_ghost_take (struct bc_part *part, disk_sector_t sector) {
+	for (size_t i = 0; i < part->ghost_cnt; i++) {
+		size_t idx = (part->ghost_head + BC_GHOST_MAX - 1 - i) % BC_GHOST_MAX;
+
+		if (part->ghosts[idx] == sector) {
+			/* Fill the hole with the oldest one. */
+			size_t oldest = (part->ghost_head + BC_GHOST_MAX - part->ghost_cnt)
+				% BC_GHOST_MAX;
+
+			part->ghosts[idx] = part->ghosts[oldest];
+			part->ghost_cnt--;
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Returns true if entry E can be replaced now. */
+static bool
+bc_replaceable (const struct bc_entry *e) {
+	return !e->loading && !e->writing && !e->pinned;
+}
+
+/* Returns the oldest entry on probation that can be replaced, or a
+ * null pointer if there is none. */
+static struct bc_entry *
+bc_victim_probation (void) {
+	for (struct list_elem *el = list_begin (&bc_probation);
+			el != list_end (&bc_probation); el = list_next (el)) {
+		struct bc_entry *e = list_entry (el, struct bc_entry, queue_elem);
+
+		if (bc_replaceable (e))
+			return e;
+	}
+	return NULL;
+}
+
+/* Returns the protected entry that the clock picks, or a null pointer
+ * if none can be replaced.  The front of bc_protected is under the
+ * hand, and an entry passed over goes to the back. */
+static struct bc_entry *
+bc_victim_protected (void) {
+	size_t left = 2 * (bc_cnt - bc_probation_cnt);
+
+	for (; left > 0 && !list_empty (&bc_protected); left--) {
+		struct bc_entry *e = list_entry (list_front (&bc_protected),
+				struct bc_entry, queue_elem);
+
+		if (bc_replaceable (e) && !e->accessed)
+			return e;
+		e->accessed = false;
+		list_push_back (&bc_protected, list_pop_front (&bc_protected));
+	}
+	return NULL;
+}
+
+/* Adds a chunk of entries to the cache, on a page borrowed from the
+ * user pool, if the cache has fewer than bc_limit entries and more than
+ * 1/BC_LEND_DIV of the pool is free.  Returns true if successful. */
+static bool
+bc_grow (void) {
+	struct memstat ms;
+	struct bc_chunk *chunk;
+	uint8_t *data;
+
+	if (bc_cnt >= bc_limit)
+		return false;
+	palloc_get_stats (&ms);
+	if (ms.user_free <= ms.user_pages / BC_LEND_DIV)
+		return false;
+	chunk = malloc (sizeof *chunk);
+	data = chunk != NULL ? palloc_get_page (PAL_USER) : NULL;
+	if (data == NULL) {
+		free (chunk);
+		return false;
+	}
+	bc_chunk_add (chunk, data, true);
+	return true;
+}
+
+/* Returns true if CHUNK holds nothing that could not be dropped
+ * without writing it first. */
+static bool
+bc_chunk_idle (const struct bc_chunk *chunk) {
+	for (size_t i = 0; i < BC_CHUNK; i++) {
+		const struct bc_entry *e = &chunk->entries[i];
+
+		if (e->valid && (e->dirty || !bc_replaceable (e)))
+			return false;
+	}
+	return true;
+}
+
+/* Drops the entries of CHUNK, which is idle, from the cache, and
+ * frees it. */
+static void
+bc_chunk_drop (struct bc_chunk *chunk) {
+	for (size_t i = 0; i < BC_CHUNK; i++) {
+		struct bc_entry *e = &chunk->entries[i];
+
+		list_remove (&e->queue_elem);
+		if (e->valid) {
+			if (!e->protected)
+				bc_probation_cnt--;
+			ohash_delete (&e->mnt->cache.index, &e->elem);
+		}
+	}
+	bc_cnt -= BC_CHUNK;
+	palloc_free_page (chunk->data);
+	free (chunk);
+}
+
+/* Gives back up to PAGE_CNT pages that the cache borrowed from the
+ * user pool, the last borrowed first, and returns how many.  Only
+ * idle chunks go, so that nothing has to be written; nothing goes if
+ * the cache is busy, since a shrinker must not sleep, or is being
+ * flushed, since a flush goes through the entries by index. */
+static size_t
+bc_shrink (size_t page_cnt) {
+	size_t freed = 0;
+
+	if (lock_held_by_current_thread (&bc_flush_lock)
+			|| lock_held_by_current_thread (&bc_lock)
+			|| !lock_try_acquire (&bc_flush_lock))
+		return 0;
+	if (!lock_try_acquire (&bc_lock)) {
+		lock_release (&bc_flush_lock);
+		return 0;
+	}
+	for (size_t i = bc_chunk_cnt; i-- > 0 && freed < page_cnt; ) {
+		struct bc_chunk *chunk = bc_chunks[i];
+
+		if (!chunk->borrowed || !bc_chunk_idle (chunk))
+			continue;
+		bc_chunk_drop (chunk);
+		bc_chunks[i] = bc_chunks[--bc_chunk_cnt];
+		freed++;
+	}
+	lock_release (&bc_lock);
+	lock_release (&bc_flush_lock);
+	return freed;
+}
+
+/* Frees an entry, writing back the sector it held, and returns it.
+ * The cache grows instead while it may, see bc_grow().  Probation
+ * gives up its oldest while it is over BC_PROBATION_MAX,
+ * and otherwise the protected queue gives up one by the clock.  At
+ * most BC_RA_CHUNK + BC_FLUSH_BATCH entries are in the middle of a
+ * transfer, and about BC_PIN_MAX are pinned, so if one queue has none
+ * to free the other does. */
+static struct bc_entry *
+bc_evict (void) {
+	struct bc_entry *e;
+
+	if (!list_empty (&bc_free) || bc_grow ())
+		return list_entry (list_pop_front (&bc_free), struct bc_entry,
+				queue_elem);
+	if (bc_probation_cnt > BC_PROBATION_MAX || list_empty (&bc_protected)) {
+		e = bc_victim_probation ();
+		if (e == NULL)
+			e = bc_victim_protected ();
+	} else {
+		e = bc_victim_protected ();
+		if (e == NULL)
+			e = bc_victim_probation ();
+	}
+	ASSERT (e != NULL);
+
+	list_remove (&e->queue_elem);
+	if (!e->protected) {
+		bc_probation_cnt--;
+		bc_ghost_add (&e->mnt->cache, e->sector);
+	}
+	bc_clean (e);
+	ohash_delete (&e->mnt->cache.index, &e->elem);
+	e->valid = false;
+	return e;
+}
+
+/* Moves entry E, if it is on probation, to the protected queue. */
+static void
+bc_protect (struct bc_entry *e) {
+	if (e->protected)
+		return;
+	list_remove (&e->queue_elem);
+	bc_probation_cnt--;
+	e->protected = true;
+	list_push_back (&bc_protected, &e->queue_elem);
+}
+
+/* Returns the entry holding SECTOR of MNT, or a null pointer if
+ * SECTOR is not cached, even if the entry is still LOADING. */
+static struct bc_entry *
+bc_lookup (struct mount *mnt, disk_sector_t sector) {
+	struct bc_entry key;
+	struct ohash_elem *found;
+
+	ASSERT (lock_held_by_current_thread (&bc_lock));
+
+	key.sector = sector;
+	found = ohash_find (&mnt->cache.index, &key.elem);
+	return found != NULL ? ohash_entry (found, struct bc_entry, elem) : NULL;
+}
+
+/* Returns the entry holding SECTOR of MNT, waiting for it to be
+ * loaded if needed, or a null pointer if SECTOR is not cached. */
+static struct bc_entry *
+bc_find (struct mount *mnt, disk_sector_t sector) {
+	struct bc_entry *e;
+
+	while ((e = bc_lookup (mnt, sector)) != NULL && e->loading)
+		cond_wait (&bc_io_done, &bc_lock);
+	return e;
+}
+
+/* Frees an entry and makes it hold SECTOR of MNT, which must not be
+ * cached, with its contents not loaded.  The entry goes on the
+ * protected queue if HOT is true or SECTOR left probation lately,
+ * and on probation otherwise. */
+static struct bc_entry *
+bc_install (struct mount *mnt, disk_sector_t sector, bool hot) {
+	struct bc_entry *e = bc_evict ();
+
+	e->mnt = mnt;
+	e->sector = sector;
+	e->dirty = false;
+	e->meta = e->pinned = e->committing = false;
+	e->valid = true;
+	ohash_insert (&mnt->cache.index, &e->elem);
+	e->protected = bc_ghost_take (&mnt->cache, sector) || hot;
+	if (e->protected)
+		list_push_back (&bc_protected, &e->queue_elem);
+	else {
+		list_push_back (&bc_probation, &e->queue_elem);
+		bc_probation_cnt++;
+	}
+	return e;
+}
+
+/* Returns the entry holding SECTOR of MNT, bringing it into the
+ * cache if needed, and protected if HOT is true.  The sector is read
+ * from disk only if LOAD is true, for a caller that is going to
+ * overwrite all of it otherwise. */
+static struct bc_entry *
+bc_get (struct mount *mnt, disk_sector_t sector, bool load, bool hot) {
+	struct bc_entry *e = bc_find (mnt, sector);
+
+	if (e != NULL) {
+		if (hot)
+			bc_protect (e);
+		bc_hit_cnt++;
+	} else {
+		e = bc_install (mnt, sector, hot);
+		if (load)
+			disk_read (mnt->disk, sector, e->data);
+		bc_miss_cnt++;
+	}
+	e->accessed = true;
+	return e;
+}
+
+/* Copies the CNT sectors of MNT from SECTOR on into BUFFER,
+ * bringing the ones that are not cached into the cache with one disk
+ * read for each run of them. */
+static void
+bc_load_sectors (struct mount *mnt, disk_sector_t sector, size_t cnt,
+		uint8_t *buffer) {
+	size_t i = 0;
+
+	ASSERT (lock_held_by_current_thread (&bc_lock));
+
+	while (i < cnt) {
+		struct bc_entry *e = bc_find (mnt, sector + i);
+		size_t run;
+
+		if (e != NULL) {
+			memcpy (buffer + i * DISK_SECTOR_SIZE, e->data, DISK_SECTOR_SIZE);
+			e->accessed = true;
+			bc_hit_cnt++;
+			i++;
+			continue;
+		}
+
+		for (run = 1; i + run < cnt && run < DISK_MULTIPLE_MAX
+				&& bc_lookup (mnt, sector + i + run) == NULL; run++)
+			continue;
+		disk_read_multiple (mnt->disk, sector + i, run,
+				buffer + i * DISK_SECTOR_SIZE);
+		for (; run > 0; run--, i++) {
+			e = bc_install (mnt, sector + i, false);
+			memcpy (e->data, buffer + i * DISK_SECTOR_SIZE, DISK_SECTOR_SIZE);
+			e->accessed = true;
+			bc_miss_cnt++;
+		}
+	}
+}
+
+/* Copies SIZE bytes at offset OFS in SECTOR of MNT into BUFFER,
+ * which must not fault. */
+void
+buffer_cache_read (struct mount *mnt, disk_sector_t sector, void *buffer,
+		off_t ofs, size_t size) {
+	ASSERT (ofs >= 0 && ofs + size <= DISK_SECTOR_SIZE);
+
+	lock_acquire (&bc_lock);
+	memcpy (buffer, bc_get (mnt, sector, true, false)->data + ofs, size);
+	lock_release (&bc_lock);
+}
+
+/* Copies SIZE bytes of metadata at offset OFS in SECTOR into BUFFER,
+ * as buffer_cache_read() does, and keeps SECTOR protected. */
+void
+buffer_cache_read_meta (struct mount *mnt, disk_sector_t sector,
+		void *buffer, off_t ofs, size_t size) {
+	ASSERT (ofs >= 0 && ofs + size <= DISK_SECTOR_SIZE);
+
+	lock_acquire (&bc_lock);
+	memcpy (buffer, bc_get (mnt, sector, true, true)->data + ofs, size);
+	lock_release (&bc_lock);
+}
+
+/* Copies the CNT whole sectors of MNT from SECTOR on into BUFFER,
+ * which must not fault, reading each run of them that is not cached
+ * with a single disk command. */
+void
+buffer_cache_read_sectors (struct mount *mnt, disk_sector_t sector,
+		size_t cnt, void *buffer) {
+	lock_acquire (&bc_lock);
+	bc_load_sectors (mnt, sector, cnt, buffer);
+	lock_release (&bc_lock);
+}
+
+/* Returns the entry holding SECTOR of MNT, brought in as by
+ * bc_get(), ready for a write of metadata, or of data if META is
+ * false: if SECTOR holds metadata of a journaled mount, not
+ * COMMITTING or WRITING, with what was committed written in place,
+ * and pinned.  The metadata of a mount without a journal is written
+ * as data is. */
+static struct bc_entry *
+bc_get_for_write (struct mount *mnt, disk_sector_t sector, bool load,
+		bool meta) {
+	struct bc_entry *e;
+
+#ifndef EFILESYS
+	meta = meta && mnt->cache.journaled;
+	while ((e = bc_find (mnt, sector)) != NULL || meta) {
+		if (e != NULL && !e->meta && !meta)
+			break;
+		if (e != NULL && (e->committing || e->writing))
+			cond_wait (&bc_io_done, &bc_lock);
+		else if ((e == NULL || !e->pinned) && bc_pinned_cnt >= BC_PIN_MAX
+				&& !journal_committing ()) {
+			bc_flush_pending = true;
+			sema_up (&bc_work);
+			cond_wait (&bc_io_done, &bc_lock);
+		} else
+			break;
+	}
+	e = bc_get (mnt, sector, load, meta);
+	if ((meta || e->meta) && !e->pinned) {
+		bc_clean (e);
+		e->meta = e->pinned = true;
+		bc_pinned_cnt++;
+	}
+#else
+	e = bc_get (mnt, sector, load, meta);
+	if (meta)
+		e->meta = true;
+#endif
+	return e;
+}
+
+/* Copies SIZE bytes from BUFFER, which must not fault, to offset OFS
+ * in SECTOR of MNT, a sector of the file that OWNER, if nonnull,
+ * stands for. */
+void
+buffer_cache_write (struct mount *mnt, disk_sector_t sector,
+		const void *buffer, off_t ofs, size_t size, struct bc_owner *owner) {
+	struct bc_entry *e;
+
+	ASSERT (ofs >= 0 && ofs + size <= DISK_SECTOR_SIZE);
+
+	lock_acquire (&bc_lock);
+	e = bc_get_for_write (mnt, sector, size < DISK_SECTOR_SIZE, false);
+	memcpy (e->data + ofs, buffer, size);
+	e->dirty = true;
+	bc_set_owner (e, e->meta ? NULL : owner);
+	lock_release (&bc_lock);
+}
+
+/* Copies SIZE bytes of metadata from BUFFER, which must not fault, to
+ * offset OFS in SECTOR of MNT, as buffer_cache_write() does.  Without
+ * FAT, on a journaled mount, the sector reaches the disk through the
+ * journal, and a commit, not buffer_cache_sync(), makes it durable. */
+void
+buffer_cache_write_meta (struct mount *mnt, disk_sector_t sector,
+		const void *buffer, off_t ofs, size_t size, struct bc_owner *owner) {
+	struct bc_entry *e;
+
+	ASSERT (ofs >= 0 && ofs + size <= DISK_SECTOR_SIZE);
+
+	lock_acquire (&bc_lock);
+	e = bc_get_for_write (mnt, sector, size < DISK_SECTOR_SIZE, true);
+	memcpy (e->data + ofs, buffer, size);
+	e->dirty = true;
+	bc_set_owner (e, e->meta ? NULL : owner);
+	lock_release (&bc_lock);
+}
+
+/* Writes the CNT entries in BATCH, which are dirty, to disk, all
+ * submitted together and waited for without BC_LOCK, which the
+ * caller holds. */
+static void
+bc_write_batch (struct bc_entry *batch[], size_t cnt) {
+	struct bio bios[BC_FLUSH_BATCH];
+	struct semaphore done;
+
+	ASSERT (cnt <= BC_FLUSH_BATCH);
+
+	sema_init (&done, 0);
+	for (size_t i = 0; i < cnt; i++) {
+		struct bc_entry *e = batch[i];
+
+		e->dirty = false;
+		e->writing = true;
+		bio_init (&bios[i], e->mnt->disk, e->sector, 1, e->data, true,
+				bio_signal, &done);
+		disk_submit (&bios[i]);
+	}
+	lock_release (&bc_lock);
+
+	for (size_t i = 0; i < cnt; i++)
+		sema_down (&done);
+	lock_acquire (&bc_lock);
+	for (size_t i = 0; i < cnt; i++) {
+		batch[i]->writing = false;
+		if (!batch[i]->dirty)
+			bc_set_owner (batch[i], NULL);
+	}
+	cond_broadcast (&bc_io_done, &bc_lock);
+}
+
+/* Writes every dirty data sector in the cache to disk, or, if META
+ * is true, every dirty metadata sector that has been committed,
+ * BC_FLUSH_BATCH entries at a time.  The writes of a batch are
+ * submitted together and waited for without the lock, so readers do
+ * not wait for them. */
+static void
+bc_write_dirty (bool meta) {
+	lock_acquire (&bc_flush_lock);
+	for (size_t i = 0; ; i += BC_FLUSH_BATCH) {
+		struct bc_entry *batch[BC_FLUSH_BATCH];
+		size_t cnt = 0;
+
+		lock_acquire (&bc_lock);
+		if (i >= bc_cnt) {
+			lock_release (&bc_lock);
+			break;
+		}
+		for (size_t j = i; j < i + BC_FLUSH_BATCH && j < bc_cnt; j++) {
+			struct bc_entry *e = bc_entry_at (j);
+
+			if (e->valid && e->dirty && !e->writing && e->meta == meta
+					&& !e->pinned)
+				batch[cnt++] = e;
+		}
+		if (cnt > 0)
+			bc_write_batch (batch, cnt);
+		lock_release (&bc_lock);
+	}
+	lock_release (&bc_flush_lock);
+}
+
+/* Writes every dirty data sector in the cache to disk.  Metadata is
+ * left to the journal. */
+void
+buffer_cache_flush (void) {
+	bc_write_dirty (false);
+}
+
+/* Initializes OWNER, for a file with no dirty sectors. */
+void
+buffer_cache_owner_init (struct bc_owner *owner) {
+	list_init (&owner->dirty);
+}
+
+/* Writes the dirty sectors of the file that OWNER stands for to disk,
+ * and waits for those already being written.  Returns when none is
+ * dirty. */
+void
+buffer_cache_sync (struct bc_owner *owner) {
+	lock_acquire (&bc_lock);
+	for (;;) {
+		struct bc_entry *batch[BC_FLUSH_BATCH];
+		size_t cnt = 0;
+		bool busy = false;
+
+		for (struct list_elem *el = list_begin (&owner->dirty);
+				el != list_end (&owner->dirty) && cnt < BC_FLUSH_BATCH;
+				el = list_next (el)) {
+			struct bc_entry *e = list_entry (el, struct bc_entry, owner_elem);
+
+			if (e->writing)
+				busy = true;
+			else
+				batch[cnt++] = e;
+		}
+		if (cnt > 0)
+			bc_write_batch (batch, cnt);
+		else if (busy)
+			cond_wait (&bc_io_done, &bc_lock);
+		else
+			break;
+	}
+	lock_release (&bc_lock);
+}
+
+/* Lets go of the sectors of OWNER, which is going away.  They stay
+ * dirty. */
+void
+buffer_cache_disown (struct bc_owner *owner) {
+	lock_acquire (&bc_lock);
+	while (!list_empty (&owner->dirty))
+		bc_set_owner (list_entry (list_front (&owner->dirty), struct bc_entry,
+					owner_elem), NULL);
+	lock_release (&bc_lock);
+}
+
+/* Writes in place every metadata sector that is committed but not
+ * written yet, or with FAT, every dirty one. */
+void
+buffer_cache_checkpoint (void) {
+	bc_write_dirty (true);
+}
+
+#ifndef EFILESYS
+
+/* Copies the pinned sectors of MNT, up to MAX of them, into IMAGES,
+ * one after another, with their sector numbers in SECTORS, and marks
+ * them COMMITTING.  Returns how many there are.  Called by
+ * journal_commit(). */
+size_t
+buffer_cache_snapshot (struct mount *mnt, disk_sector_t sectors[],
+		uint8_t *images, size_t max) {
+	size_t cnt = 0;
+
+	lock_acquire (&bc_lock);
+	for (size_t i = 0; i < bc_cnt && cnt < max; i++) {
+		struct bc_entry *e = bc_entry_at (i);
+
+		if (!e->valid || e->mnt != mnt || !e->pinned || e->committing)
+			continue;
+		sectors[cnt] = e->sector;
+		memcpy (images + cnt++ * DISK_SECTOR_SIZE, e->data, DISK_SECTOR_SIZE);
+		e->committing = true;
+	}
+	lock_release (&bc_lock);
+	return cnt;
+}
+
+/* Marks the sectors of the last snapshot of MNT committed, now that
+ * the commit record is on disk. */
+void
+buffer_cache_committed (struct mount *mnt) {
+	lock_acquire (&bc_lock);
+	for (size_t i = 0; i < bc_cnt; i++) {
+		struct bc_entry *e = bc_entry_at (i);
+
+		if (e->valid && e->mnt == mnt && e->committing) {
+			e->committing = e->pinned = false;
+			bc_pinned_cnt--;
+		}
+	}
+	cond_broadcast (&bc_io_done, &bc_lock);
+	lock_release (&bc_lock);
+}
+#endif
+
+/* Asks kworkerd to bring the CNT sectors of MNT from SECTOR on into
+ * the cache, for a reader expected to want them soon.  If kworkerd is
+ * too far behind, the request is dropped. */
+void
+buffer_cache_read_ahead (struct mount *mnt, disk_sector_t sector,
+		size_t cnt) {
+	bool queued = false;
+
+	lock_acquire (&bc_lock);
+	if (bc_ra_cnt < BC_RA_QUEUE) {
+		struct bc_read_ahead *ra =
+			&bc_ra_queue[(bc_ra_head + bc_ra_cnt++) % BC_RA_QUEUE];
+
+		ra->mnt = mnt;
+		ra->sector = sector;
+		ra->cnt = cnt;
+		queued = true;
+	}
+	lock_release (&bc_lock);
+	if (queued)
+		sema_up (&bc_work);
+}
+
+/* Compares sectors A and B, for sort(). */
+static int
+sector_compare (const void *a_, const void *b_, void *aux UNUSED) {
+	disk_sector_t a = *(const disk_sector_t *) a_;
+	disk_sector_t b = *(const disk_sector_t *) b_;
+
+	return a < b ? -1 : a > b;
+}
+
+/* Asks kworkerd to bring the CNT SECTORS of MNT, in any order, into
+ * the cache, for a reader expected to want each of them soon.
+ * SECTORS is reordered.  Requests kworkerd has no room for are
+ * dropped. */
+void
+buffer_cache_prefetch (struct mount *mnt, disk_sector_t sectors[],
+		size_t cnt) {
+	size_t queued = 0;
+	size_t i, n = 0;
+
+	lock_acquire (&bc_lock);
+	for (i = 0; i < cnt; i++)
+		if (bc_lookup (mnt, sectors[i]) == NULL)
+			sectors[n++] = sectors[i];
+	sort (sectors, n, sizeof *sectors, sector_compare, NULL);
+
+	for (i = 0; i < n && bc_ra_cnt < BC_RA_QUEUE; queued++) {
+		disk_sector_t first = sectors[i], last = first;
+		struct bc_read_ahead *ra;
+
+		while (++i < n && sectors[i] - last <= BC_PREFETCH_GAP + 1
+				&& sectors[i] - first < BC_RA_CHUNK)
+			last = sectors[i];
+		ra = &bc_ra_queue[(bc_ra_head + bc_ra_cnt++) % BC_RA_QUEUE];
+		ra->mnt = mnt;
+		ra->sector = first;
+		ra->cnt = last - first + 1;
+	}
+	lock_release (&bc_lock);
+	while (queued-- > 0)
+		sema_up (&bc_work);
+}
+
+/* Reads the CNT sectors of MNT from SECTOR on that are not cached
+ * yet, at most BC_RA_CHUNK, with one request submitted for each run
+ * of them, into entries that stay LOADING until all are done. */
+static void
+bc_read_ahead_chunk (struct mount *mnt, disk_sector_t sector, size_t cnt) {
+	static uint8_t buffer[BC_RA_CHUNK * DISK_SECTOR_SIZE];
+	struct bc_entry *loading[BC_RA_CHUNK];
+	struct bio bios[BC_RA_CHUNK];
+	struct semaphore done;
+	size_t bio_cnt = 0;
+
+	ASSERT (cnt <= BC_RA_CHUNK);
+
+	sema_init (&done, 0);
+	lock_acquire (&bc_lock);
+	for (size_t i = 0; i < cnt; ) {
+		size_t run;
+
+		if (bc_lookup (mnt, sector + i) != NULL) {
+			loading[i++] = NULL;
+			continue;
+		}
+		for (run = 0; i + run < cnt
+				&& (run == 0 || bc_lookup (mnt, sector + i + run) == NULL);
+				run++) {
+			struct bc_entry *e = bc_install (mnt, sector + i + run, false);
+
+			e->loading = true;
+			e->accessed = false;
+			loading[i + run] = e;
+		}
+		bio_init (&bios[bio_cnt], mnt->disk, sector + i, run,
+				buffer + i * DISK_SECTOR_SIZE, false, bio_signal, &done);
+		disk_submit (&bios[bio_cnt++]);
+		i += run;
+	}
+	lock_release (&bc_lock);
+	if (bio_cnt == 0)
+		return;
+
+	for (size_t i = 0; i < bio_cnt; i++)
+		sema_down (&done);
+	lock_acquire (&bc_lock);
+	for (size_t i = 0; i < cnt; i++)
+		if (loading[i] != NULL) {
+			memcpy (loading[i]->data, buffer + i * DISK_SECTOR_SIZE,
+					DISK_SECTOR_SIZE);
+			loading[i]->loading = false;
+			bc_ra_sector_cnt++;
+		}
+	cond_broadcast (&bc_io_done, &bc_lock);
+	lock_release (&bc_lock);
+}
+
+/* Reads the sectors of RA that are not cached yet, BC_RA_CHUNK at a
+ * time. */
+static void
+bc_do_read_ahead (const struct bc_read_ahead *ra) {
+	for (size_t i = 0; i < ra->cnt; i += BC_RA_CHUNK)
+		bc_read_ahead_chunk (ra->mnt, ra->sector + i,
+				ra->cnt - i < BC_RA_CHUNK ? ra->cnt - i : BC_RA_CHUNK);
+}
+
+/* Body of the kworkerd thread, which does the readahead and the
+ * periodic flushes. */
+static void
+kworkerd (void *aux UNUSED) {
+	/* Nobody waits on our writes and reads ahead until later. */
+	thread_set_ioprio (IOPRIO_IDLE);
+	for (;;) {
+		struct bc_read_ahead ra = { .cnt = 0 };
+		bool flush;
+
+		sema_down (&bc_work);
+		lock_acquire (&bc_lock);
+		flush = bc_flush_pending;
+		bc_flush_pending = false;
+		if (bc_ra_cnt > 0) {
+			ra = bc_ra_queue[bc_ra_head];
+			bc_ra_head = (bc_ra_head + 1) % BC_RA_QUEUE;
+			bc_ra_cnt--;
+			bc_ra_mnt = ra.mnt;
+		}
+		lock_release (&bc_lock);
+
+		if (flush) {
+#ifndef EFILESYS
+			journal_commit ();
+#endif
+			buffer_cache_flush ();
+#ifdef EFILESYS
+			/* The FAT must not reach the disk before the data. */
+			mount_flush_disks ();
+			fat_flush ();
+#endif
+		}
+		if (ra.cnt > 0) {
+			bc_do_read_ahead (&ra);
+			lock_acquire (&bc_lock);
+			bc_ra_mnt = NULL;
+			cond_broadcast (&bc_io_done, &bc_lock);
+			lock_release (&bc_lock);
+		}
+	}
+}
+
+/* Body of the kflushd thread, which has the cache flushed every
+ * BC_FLUSH_TICKS, so that a crash loses at most that much.  It may
+ * come up to BC_FLUSH_SLACK ticks early, to share a wakeup with
+ * other sleepers. */
+static void
+kflushd (void *aux UNUSED) {
+	for (;;) {
+		timer_sleep_slack (BC_FLUSH_TICKS - BC_FLUSH_SLACK, BC_FLUSH_SLACK);
+		lock_acquire (&bc_lock);
+		bc_flush_pending = true;
+		lock_release (&bc_lock);
+		sema_up (&bc_work);
+	}
+}
+
+/* Prints buffer cache statistics. */
+void
+buffer_cache_print_stats (void) {
+	printf ("Buffer cache: %lld hits, %lld misses, %lld sectors read ahead\n",
+			bc_hit_cnt, bc_miss_cnt, bc_ra_sector_cnt);
+}
@@ -0,0 +1,290 @@
+/* dcache.c: Cache of directory entries. */
+
+#include "filesys/dcache.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <ohash.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/directory.h"
+#include "threads/atomic.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* Directory entry cache.
+ *
+ * Remembers, for a directory inode, on a mount, and a name in it,
+ * the sector of
+ * the inode that the name refers to, or that there is no such name
+ * at all, so that looking a name up again does not have to read the
+ * directory.  The directory code keeps the cache right: each entry
+ * added or removed is entered, as present or absent, and a new
+ * directory drops whatever was cached for an old one in its sector.
+ *
+ * A name that is a symbolic link may also remember the inode the
+ * link finally leads to, so that following it reads neither the
+ * link nor its target's directory entry.  That answer depends on
+ * every name passed on the way, so it is only good until the next
+ * change to any name: each change advances dcache_gen, and a
+ * resolution is believed only if it was made in the current
+ * generation.  Names change far less often than they are looked
+ * up, and filling the cache on a lookup is no change.
+ *
+ * At most DCACHE_SIZE names are kept, and the least recently used
+ * one goes to make room.  DCACHE_LOCK covers everything, and is
+ * taken inside the locks of the directory code. */
+#define DCACHE_SIZE 256
+
+/* A cached name. */
+struct dentry {
+	struct mount *mnt;                  /* Mount DIR is on. */
+	disk_sector_t dir;                  /* Directory inode sector. */
+	char name[NAME_MAX + 1];            /* Name within DIR. */
+	disk_sector_t sector;               /* Inode sector, or DCACHE_NONE. */
+	disk_sector_t link;                 /* Where the link leads, or DCACHE_NONE. */
+	unsigned link_gen;                  /* dcache_gen when LINK was found. */
+	struct ohash_elem elem;             /* Element in dcache_index. */
+	struct list_elem lru_elem;          /* Element in dcache_lru. */
+};
+
+static struct ohash dcache_index;       /* All entries, by MNT, DIR, NAME. */
+static struct list dcache_lru;          /* Least recently used first. */
+static size_t dcache_cnt;
+static struct lock dcache_lock;
+static struct kmem_cache *dentry_cache;
+static unsigned dcache_gen;             /* Number of changes to names. */
+
+/* Statistics. */
+static long long dcache_hit_cnt, dcache_neg_hit_cnt, dcache_miss_cnt;
+static long long dcache_link_hit_cnt;
+
+static void dcache_store (struct mount *, disk_sector_t dir,
+		const char *name, disk_sector_t sector, bool change);
+
+/* Returns the hash of entry E. */
+static uint64_t
+dentry_hash (const struct ohash_elem *e, void *aux UNUSED) {
+	const struct dentry *d = ohash_entry (e, struct dentry, elem);
+	return hash_string (d->name) ^ hash_u64 (d->dir) ^ hash_ptr (d->mnt);
+}
+
+/* Returns true if entry A orders before entry B. */
+static bool
+dentry_less (const struct ohash_elem *a_, const struct ohash_elem *b_,
+		void *aux UNUSED) {
+	const struct dentry *a = ohash_entry (a_, struct dentry, elem);
+	const struct dentry *b = ohash_entry (b_, struct dentry, elem);
+
+	if (a->mnt != b->mnt)
+		return a->mnt < b->mnt;
+	if (a->dir != b->dir)
+		return a->dir < b->dir;
+	return strcmp (a->name, b->name) < 0;
+}
+
+/* Initializes the directory entry cache. */
+void
+dcache_init (void) {
+	lock_init (&dcache_lock);
+	lock_register (&dcache_lock, "dcache");
+	list_init (&dcache_lru);
+	if (!ohash_init (&dcache_index, dentry_hash, dentry_less, NULL))
+		PANIC ("dcache_init: out of memory");
+	dentry_cache = kmem_cache_create ("dentry", sizeof (struct dentry),
+			0, NULL);
+}
+
+/* Returns the entry for NAME in DIR on MNT, or a null pointer.
+ * dcache_lock must be held. */
+static struct dentry *
+dcache_find (struct mount *mnt, disk_sector_t dir, const char *name) {
+	struct dentry key;
+	struct ohash_elem *e;
+
+	key.mnt = mnt;
+	key.dir = dir;
+	strlcpy (key.name, name, sizeof key.name);
+	e = ohash_find (&dcache_index, &key.elem);
+	return e != NULL ? ohash_entry (e, struct dentry, elem) : NULL;
+}
+
+/* Looks up NAME in directory DIR on MNT.  Returns false if the cache does
+ * not know about it.  Otherwise, returns true and stores into
+ * *SECTOR the sector of its inode, or DCACHE_NONE if DIR has no
+ * such name. */
+bool
+dcache_lookup (struct mount *mnt, disk_sector_t dir, const char *name,
+		disk_sector_t *sector) {
+	struct dentry *d;
+
+	/* A name that is too long is never in the cache. */
+	if (strlen (name) > NAME_MAX)
+		return false;
+
+	lock_acquire (&dcache_lock);
+	d = dcache_find (mnt, dir, name);
+	if (d != NULL) {
+		list_remove (&d->lru_elem);
+		list_push_back (&dcache_lru, &d->lru_elem);
+		*sector = d->sector;
+		if (d->sector != DCACHE_NONE)
+			dcache_hit_cnt++;
+		else
+			dcache_neg_hit_cnt++;
+	} else
+		dcache_miss_cnt++;
+	lock_release (&dcache_lock);
+	return d != NULL;
+}
+
+/* Records that NAME in directory DIR on MNT has come to refer to
+ * the inode at SECTOR, or, if SECTOR is DCACHE_NONE, that NAME has
+ * been removed from DIR. */
+void
+dcache_insert (struct mount *mnt, disk_sector_t dir, const char *name,
+		disk_sector_t sector) {
+	dcache_store (mnt, dir, name, sector, true);
+}
+
+/* Records what a lookup of NAME in directory DIR on MNT found on
+ * disk: the inode at SECTOR, or, if SECTOR is DCACHE_NONE, no
+ * NAME. */
+void
+dcache_fill (struct mount *mnt, disk_sector_t dir, const char *name,
+		disk_sector_t sector) {
+	dcache_store (mnt, dir, name, sector, false);
+}
+
+/* Records that NAME in directory DIR on MNT refers to the inode at
+ * SECTOR, advancing dcache_gen if CHANGE says that this is a
+ * change to the name.  If memory is short, the cache just forgets
+ * NAME. */
+static void
+dcache_store (struct mount *mnt, disk_sector_t dir, const char *name,
+		disk_sector_t sector, bool change) {
+	struct dentry *d;
+
+	if (change)
+		atomic_fetch_add ((int *) &dcache_gen, 1);
+	if (strlen (name) > NAME_MAX)
+		return;
+
+	lock_acquire (&dcache_lock);
+	d = dcache_find (mnt, dir, name);
+	if (d != NULL) {
+		list_remove (&d->lru_elem);
+		d->sector = sector;
+		d->link = DCACHE_NONE;
+		list_push_back (&dcache_lru, &d->lru_elem);
+		goto done;
+	}
+
+	if (dcache_cnt >= DCACHE_SIZE) {
+		/* Reuse the least recently used entry. */
+		d = list_entry (list_pop_front (&dcache_lru), struct dentry,
+				lru_elem);
+		ohash_delete (&dcache_index, &d->elem);
+		dcache_cnt--;
+	} else {
+		d = kmem_cache_alloc (dentry_cache);
+		if (d == NULL)
+			goto done;
+	}
+	d->mnt = mnt;
+	d->dir = dir;
+	strlcpy (d->name, name, sizeof d->name);
+	d->sector = sector;
+	d->link = DCACHE_NONE;
+	list_push_back (&dcache_lru, &d->lru_elem);
+	ohash_insert (&dcache_index, &d->elem);
+	dcache_cnt++;
+
+done:
+	lock_release (&dcache_lock);
+}
+
+/* Returns the current generation of names, to pass to
+ * dcache_insert_link() for a link about to be followed. */
+unsigned
+dcache_generation (void) {
+	return dcache_gen;
+}
+
+/* Looks up NAME in directory DIR on MNT as a symbolic link.  Returns true
+ * and stores into *SECTOR the inode it leads to if that is known
+ * and no name has changed since it was found. */
+bool
+dcache_lookup_link (struct mount *mnt, disk_sector_t dir, const char *name,
+		disk_sector_t *sector) {
+	struct dentry *d;
+	bool found = false;
+
+	if (strlen (name) > NAME_MAX)
+		return false;
+
+	lock_acquire (&dcache_lock);
+	d = dcache_find (mnt, dir, name);
+	if (d != NULL && d->link != DCACHE_NONE && d->link_gen == dcache_gen) {
+		list_remove (&d->lru_elem);
+		list_push_back (&dcache_lru, &d->lru_elem);
+		*sector = d->link;
+		dcache_link_hit_cnt++;
+		found = true;
+	}
+	lock_release (&dcache_lock);
+	return found;
+}
+
+/* Records that symbolic link NAME in directory DIR on MNT leads to the
+ * inode at SECTOR, as found by following it in generation GEN, as
+ * returned by dcache_generation() before the walk began.  If a
+ * name has changed since, the walk may have seen a mix of old and
+ * new names, so the result is dropped. */
+void
+dcache_insert_link (struct mount *mnt, disk_sector_t dir, const char *name,
+		disk_sector_t sector, unsigned gen) {
+	struct dentry *d;
+
+	if (strlen (name) > NAME_MAX)
+		return;
+
+	lock_acquire (&dcache_lock);
+	d = dcache_find (mnt, dir, name);
+	if (d != NULL && gen == dcache_gen) {
+		d->link = sector;
+		d->link_gen = gen;
+	}
+	lock_release (&dcache_lock);
+}
+
+/* Forgets every name cached for directory DIR on MNT, whose sector
+ * is about to hold a new directory, or, if DIR is DCACHE_NONE, for
+ * every directory on MNT, which is being unmounted. */
+void
+dcache_purge_dir (struct mount *mnt, disk_sector_t dir) {
+	struct list_elem *e, *next;
+
+	atomic_fetch_add ((int *) &dcache_gen, 1);
+	lock_acquire (&dcache_lock);
+	for (e = list_begin (&dcache_lru); e != list_end (&dcache_lru); e = next) {
+		struct dentry *d = list_entry (e, struct dentry, lru_elem);
+
+		next = list_next (e);
+		if (d->mnt == mnt && (d->dir == dir || dir == DCACHE_NONE)) {
+			list_remove (&d->lru_elem);
+			ohash_delete (&dcache_index, &d->elem);
+			dcache_cnt--;
+			kmem_cache_free (dentry_cache, d);
+		}
+	}
+	lock_release (&dcache_lock);
+}
+
+/* Prints directory entry cache statistics. */
+void
+dcache_print_stats (void) {
+	printf ("Dentry cache: %lld hits, %lld negative hits, %lld misses, "
+			"%lld link hits\n", dcache_hit_cnt, dcache_neg_hit_cnt,
+			dcache_miss_cnt, dcache_link_hit_cnt);
+}
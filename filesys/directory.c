@@ -1,15 +1,22 @@
 #include "filesys/directory.h"
 #include <stdio.h>
 #include <string.h>
+#include <hash.h>
 #include <list.h>
+#include <round.h>
+#include "filesys/buffer_cache.h"
+#include "filesys/dcache.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "filesys/mount.h"
 #include "threads/malloc.h"
 
 /* A directory. */
 struct dir {
 	struct inode *inode;                /* Backing store. */
 	off_t pos;                          /* Current position. */
+	off_t readdir_end;                  /* Where the last readdir ended. */
+	off_t prefetched;                   /* Inodes prefetched up to here. */
 };
 
 /* A single directory entry. */
@@ -19,34 +26,96 @@ struct dir_entry {
 	bool in_use;                        /* In use or free? */
 };
 
+/* Directory layout.
+ *
+ * A small directory is a plain array of entries, searched from
+ * front to back.  Once it has DIR_LINEAR_MAX entries and needs
+ * room for another, it is rewritten as a hash table: the first
+ * sector holds a struct dir_index, and each sector after it is a
+ * bucket of DIR_BUCKET_ENTRIES entries.  A name lives in the bucket
+ * its hash_string() selects, or, if that bucket was full when the
+ * name was added, in one of the buckets after it; a full bucket
+ * says so in OVERFLOW, so that a lookup knows to go on.  Looking up
+ * a name therefore reads one sector, or a few.  The table doubles,
+ * rewritten in full, when it is 3/4 full.
+ *
+ * The header starts with an entry that is not in use, so that a
+ * directory can tell which layout it has from its first entry.
+ *
+ * Each operation on a directory's entries holds the lock of the
+ * directory's inode, taken with inode_lock(), so that, for example,
+ * two files cannot be added under one name, and so that the dentry
+ * cache always agrees with the directory. */
+#define DIR_LINEAR_MAX 24
+#define DIR_BUCKET_ENTRIES (DISK_SECTOR_SIZE / sizeof (struct dir_entry))
+#define DIR_INDEX_MAGIC 0x58444e49      /* "INDX", never a sector. */
+
+/* Header of a hashed directory. */
+struct dir_index {
+	struct dir_entry marker;            /* Not in use, INDEX_MAGIC. */
+	uint32_t bucket_cnt;                /* Number of buckets. */
+	uint32_t entry_cnt;                 /* Number of entries in use. */
+};
+
+/* A bucket of a hashed directory.  Takes up one sector. */
+struct dir_bucket {
+	struct dir_entry entries[DIR_BUCKET_ENTRIES];
+	uint32_t overflow;                  /* Entries went on to the next? */
+	uint8_t unused[DISK_SECTOR_SIZE - DIR_BUCKET_ENTRIES
+		* sizeof (struct dir_entry) - sizeof (uint32_t)];
+};
+
+/* Returns the byte offset of bucket IDX. */
+static inline off_t
+bucket_ofs (size_t idx) {
+	return (off_t) (idx + 1) * DISK_SECTOR_SIZE;
+}
+
+/* Allocator for struct dir. */
+static struct kmem_cache *dir_cache;
+
+/* Initializes the directory module. */
+void
+dir_init (void) {
+	dir_cache = kmem_cache_create ("dir", sizeof (struct dir), 0, NULL);
+	dcache_init ();
+}
+
 /* Creates a directory with space for ENTRY_CNT entries in the
- * given SECTOR.  Returns true if successful, false on failure. */
+ * given SECTOR of MNT.  Returns true if successful, false on
+ * failure. */
 bool
-dir_create (disk_sector_t sector, size_t entry_cnt) {
-	return inode_create (sector, entry_cnt * sizeof (struct dir_entry));
+dir_create (struct mount *mnt, disk_sector_t sector, size_t entry_cnt) {
+	dcache_purge_dir (mnt, sector);
+	return inode_create (mnt, sector, entry_cnt * sizeof (struct dir_entry));
 }
 
 /* Opens and returns the directory for the given INODE, of which
  * it takes ownership.  Returns a null pointer on failure. */
 struct dir *
 dir_open (struct inode *inode) {
-	struct dir *dir = calloc (1, sizeof *dir);
+	struct dir *dir = kmem_cache_alloc (dir_cache);
 	if (inode != NULL && dir != NULL) {
+		inode_set_meta (inode);
 		dir->inode = inode;
 		dir->pos = 0;
+		dir->readdir_end = 0;
+		dir->prefetched = 0;
 		return dir;
 	} else {
 		inode_close (inode);
-		free (dir);
+		kmem_cache_free (dir_cache, dir);
 		return NULL;
 	}
 }
 
-/* Opens the root directory and returns a directory for it.
- * Return true if successful, false on failure. */
+/* Opens the root directory of the root mount and returns a
+ * directory for it.  Return true if successful, false on failure. */
 struct dir *
 dir_open_root (void) {
-	return dir_open (inode_open (ROOT_DIR_SECTOR));
+	struct mount *mnt = mount_root ();
+
+	return dir_open (inode_open (mnt, mnt->root_sector));
 }
 
 /* Opens and returns a new directory for the same inode as DIR.
@@ -61,7 +130,7 @@ void
 dir_close (struct dir *dir) {
 	if (dir != NULL) {
 		inode_close (dir->inode);
-		free (dir);
+		kmem_cache_free (dir_cache, dir);
 	}
 }
 
@@ -71,6 +140,69 @@ dir_get_inode (struct dir *dir) {
 	return dir->inode;
 }
 
+/* Makes dir_readdir() on DIR go on from POS, which dir_tell() on a
+ * directory for the same inode returned. */
+void
+dir_seek (struct dir *dir, off_t pos) {
+	dir->pos = pos;
+}
+
+/* Returns where dir_readdir() on DIR goes on from. */
+off_t
+dir_tell (struct dir *dir) {
+	return dir->pos;
+}
+
+/* Reads the header of DIR into *IDX and returns true if DIR is
+ * hashed, or returns false if it is a plain array. */
+static bool
+read_index (const struct dir *dir, struct dir_index *idx) {
+	return inode_read_at (dir->inode, idx, sizeof *idx, 0) == sizeof *idx
+		&& !idx->marker.in_use
+		&& idx->marker.inode_sector == DIR_INDEX_MAGIC
+		&& idx->bucket_cnt > 0;
+}
+
+/* Reads bucket B of DIR into *BUCKET.  Returns true if successful. */
+static bool
+read_bucket (const struct dir *dir, size_t b, struct dir_bucket *bucket) {
+	return inode_read_at (dir->inode, bucket, sizeof *bucket, bucket_ofs (b))
+		== sizeof *bucket;
+}
+
+/* Searches hashed DIR, with header IDX, for NAME, like lookup(). */
+static bool
+index_lookup (const struct dir *dir, const struct dir_index *idx,
+		const char *name, struct dir_entry *ep, off_t *ofsp) {
+	struct dir_bucket *bucket = malloc (sizeof *bucket);
+	size_t b = hash_string (name) % idx->bucket_cnt;
+	bool found = false;
+
+	if (bucket == NULL)
+		return false;
+	for (size_t n = 0; n < idx->bucket_cnt && read_bucket (dir, b, bucket);
+			n++, b = (b + 1) % idx->bucket_cnt) {
+		for (size_t i = 0; i < DIR_BUCKET_ENTRIES; i++) {
+			struct dir_entry *e = &bucket->entries[i];
+
+			if (e->in_use && !strcmp (name, e->name)) {
+				if (ep != NULL)
+					*ep = *e;
+				if (ofsp != NULL)
+					*ofsp = bucket_ofs (b) + i * sizeof *e;
+				found = true;
+				goto done;
+			}
+		}
+		if (!bucket->overflow)
+			break;
+	}
+
+done:
+	free (bucket);
+	return found;
+}
+
 /* Searches DIR for a file with the given NAME.
  * If successful, returns true, sets *EP to the directory entry
  * if EP is non-null, and sets *OFSP to the byte offset of the
@@ -81,11 +213,15 @@ static bool
 lookup (const struct dir *dir, const char *name,
 		struct dir_entry *ep, off_t *ofsp) {
 	struct dir_entry e;
+	struct dir_index idx;
 	size_t ofs;
 
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
+	if (read_index (dir, &idx))
+		return index_lookup (dir, &idx, name, ep, ofsp);
+
 	for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
 			ofs += sizeof e)
 		if (e.in_use && !strcmp (name, e.name)) {
@@ -106,19 +242,214 @@ lookup (const struct dir *dir, const char *name,
 bool
 dir_lookup (const struct dir *dir, const char *name,
 		struct inode **inode) {
+	struct mount *mnt;
+	disk_sector_t parent, sector;
 	struct dir_entry e;
 
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
-	if (lookup (dir, name, &e, NULL)) // dir에서 name이란 이름의 파일이 존재하면 true, 없으면 false 반환
-		*inode = inode_open (e.inode_sector); // 반환된 inode
+	mnt = inode_get_mount (dir->inode);
+	parent = inode_get_inumber (dir->inode);
+
+	/* The dentry cache answers most lookups without reading DIR. */
+	inode_lock (dir->inode);
+	if (!dcache_lookup (mnt, parent, name, &sector)) {
+		sector = lookup (dir, name, &e, NULL) ? e.inode_sector : DCACHE_NONE;
+		dcache_fill (mnt, parent, name, sector);
+	}
+	if (sector != DCACHE_NONE)
+		*inode = inode_open (mnt, sector); // 반환된 inode
 	else
 		*inode = NULL;
+	inode_unlock (dir->inode);
 
 	return *inode != NULL;
 }
 
+/* Most symbolic links followed by one lookup, so that a loop of
+ * links fails instead of hanging. */
+#define SYMLINK_DEPTH_MAX 8
+
+/* Returns the name in DIR that symbolic link TARGET refers to.
+ * Every file is in the root directory, so leading "/" and "./"
+ * only say that again. */
+static const char *
+link_name (const char *target) {
+	for (;;) {
+		if (target[0] == '/')
+			target++;
+		else if (target[0] == '.' && target[1] == '/')
+			target += 2;
+		else
+			return target;
+	}
+}
+
+/* Like dir_lookup(), but if NAME is a symbolic link, follows it,
+ * and any links it leads to, to the file at the end.  The answer
+ * is remembered in the dentry cache, so that following NAME again
+ * opens that file directly. */
+bool
+dir_lookup_follow (const struct dir *dir, const char *name,
+		struct inode **inode) {
+	struct mount *mnt;
+	disk_sector_t parent, sector;
+	unsigned gen;
+	int depth;
+
+	ASSERT (dir != NULL);
+	ASSERT (name != NULL);
+
+	mnt = inode_get_mount (dir->inode);
+	parent = inode_get_inumber (dir->inode);
+	if (dcache_lookup_link (mnt, parent, name, &sector)) {
+		*inode = inode_open (mnt, sector);
+		return *inode != NULL;
+	}
+
+	gen = dcache_generation ();
+	if (!dir_lookup (dir, name, inode))
+		return false;
+	for (depth = 0; inode_is_symlink (*inode); depth++) {
+		struct inode *link = *inode;
+		bool found = false;
+
+		if (depth < SYMLINK_DEPTH_MAX)
+			found = dir_lookup (dir, link_name (inode_symlink_target (link)),
+					inode);
+		inode_close (link);
+		if (!found) {
+			*inode = NULL;
+			return false;
+		}
+	}
+	if (depth > 0)
+		dcache_insert_link (mnt, parent, name, inode_get_inumber (*inode), gen);
+	return true;
+}
+
+/* Puts entry E into the first bucket with room, starting from the
+ * one for its name, in the BUCKET_CNT buckets at BUCKETS, marking
+ * full buckets passed over.  Returns false if all are full. */
+static bool
+place_entry (struct dir_bucket *buckets, size_t bucket_cnt,
+		const struct dir_entry *e) {
+	size_t b = hash_string (e->name) % bucket_cnt;
+
+	for (size_t n = 0; n < bucket_cnt; n++, b = (b + 1) % bucket_cnt) {
+		for (size_t i = 0; i < DIR_BUCKET_ENTRIES; i++)
+			if (!buckets[b].entries[i].in_use) {
+				buckets[b].entries[i] = *e;
+				return true;
+			}
+		buckets[b].overflow = true;
+	}
+	return false;
+}
+
+/* Rewrites DIR as a hash table with room for at least ENTRY_CNT
+ * entries, moving its entries there.  Returns true if successful,
+ * false if memory or disk space is short, in which case DIR is
+ * unchanged. */
+static bool
+rebuild_index (struct dir *dir, size_t entry_cnt) {
+	struct dir_index idx, *new_idx;
+	struct dir_entry e;
+	struct dir_bucket *buckets;
+	size_t bucket_cnt, size;
+	uint8_t *image;
+	bool indexed = read_index (dir, &idx);
+	off_t ofs, end;
+	bool success = false;
+
+	bucket_cnt = DIV_ROUND_UP (entry_cnt * 4, DIR_BUCKET_ENTRIES * 3);
+	if (bucket_cnt < 4)
+		bucket_cnt = 4;
+	size = bucket_ofs (bucket_cnt);
+	image = calloc (1, size);
+	if (image == NULL)
+		return false;
+	new_idx = (struct dir_index *) image;
+	buckets = (struct dir_bucket *) (image + DISK_SECTOR_SIZE);
+	new_idx->marker.inode_sector = DIR_INDEX_MAGIC;
+	new_idx->marker.in_use = false;
+	new_idx->bucket_cnt = bucket_cnt;
+
+	/* Gather the entries from whichever layout DIR has now. */
+	ofs = indexed ? bucket_ofs (0) : 0;
+	end = indexed ? bucket_ofs (idx.bucket_cnt) : inode_length (dir->inode);
+	while (ofs + (off_t) sizeof e <= end) {
+		if (indexed && (ofs % DISK_SECTOR_SIZE) / sizeof e
+				>= DIR_BUCKET_ENTRIES) {
+			ofs = ROUND_UP (ofs, DISK_SECTOR_SIZE);
+			continue;
+		}
+		if (inode_read_at (dir->inode, &e, sizeof e, ofs) != sizeof e)
+			goto done;
+		ofs += sizeof e;
+		if (e.in_use) {
+			if (!place_entry (buckets, bucket_cnt, &e))
+				goto done;
+			new_idx->entry_cnt++;
+		}
+	}
+
+	/* Grow the file first, so that a full disk leaves DIR alone. */
+	if (inode_write_at (dir->inode, image + size - 1, 1, size - 1) != 1)
+		goto done;
+	success = inode_write_at (dir->inode, image, size, 0) == (off_t) size;
+
+done:
+	free (image);
+	return success;
+}
+
+/* Adds entry E to hashed DIR, with header IDX, growing the table
+ * first if it is 3/4 full.  Returns true if successful. */
+static bool
+index_add (struct dir *dir, struct dir_index *idx, const struct dir_entry *e) {
+	struct dir_bucket *bucket;
+	size_t b;
+	bool success = false;
+
+	if ((idx->entry_cnt + 1) * 4 > idx->bucket_cnt * DIR_BUCKET_ENTRIES * 3) {
+		if (!rebuild_index (dir, (idx->entry_cnt + 1) * 2)
+				|| !read_index (dir, idx))
+			return false;
+	}
+
+	bucket = malloc (sizeof *bucket);
+	if (bucket == NULL)
+		return false;
+	b = hash_string (e->name) % idx->bucket_cnt;
+	for (size_t n = 0; n < idx->bucket_cnt && read_bucket (dir, b, bucket);
+			n++, b = (b + 1) % idx->bucket_cnt) {
+		for (size_t i = 0; i < DIR_BUCKET_ENTRIES; i++)
+			if (!bucket->entries[i].in_use) {
+				off_t ofs = bucket_ofs (b) + i * sizeof *e;
+
+				success = inode_write_at (dir->inode, e, sizeof *e, ofs)
+					== sizeof *e;
+				goto done;
+			}
+		if (!bucket->overflow) {
+			uint32_t overflow = true;
+
+			inode_write_at (dir->inode, &overflow, sizeof overflow,
+					bucket_ofs (b) + offsetof (struct dir_bucket, overflow));
+		}
+	}
+
+done:
+	free (bucket);
+	if (success) {
+		idx->entry_cnt++;
+		inode_write_at (dir->inode, idx, sizeof *idx, 0);
+	}
+	return success;
+}
+
 /* Adds a file named NAME to DIR, which must not already contain a
  * file by that name.  The file's inode is in sector
  * INODE_SECTOR.
@@ -127,20 +458,38 @@ dir_lookup (const struct dir *dir, const char *name,
  * error occurs. */
 bool
 dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) {
-	struct dir_entry e;
+	struct mount *mnt;
+	disk_sector_t parent, cached;
+	struct dir_entry e, slot;
+	struct dir_index idx;
 	off_t ofs;
 	bool success = false;
 
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
+	mnt = inode_get_mount (dir->inode);
+	parent = inode_get_inumber (dir->inode);
+
 	/* Check NAME for validity. */
 	if (*name == '\0' || strlen (name) > NAME_MAX)
 		return false;
 
-	/* Check that NAME is not in use. */
-	if (lookup (dir, name, NULL, NULL))
+	/* Check that NAME is not in use.  A name that the dentry cache
+	 * knows to be absent needs no search. */
+	inode_lock (dir->inode);
+	if (!dcache_lookup (mnt, parent, name, &cached) || cached != DCACHE_NONE)
+		if (lookup (dir, name, NULL, NULL))
+			goto done;
+
+	/* A hashed directory keeps its own free slots. */
+	e.in_use = true;
+	strlcpy (e.name, name, sizeof e.name);
+	e.inode_sector = inode_sector;
+	if (read_index (dir, &idx)) {
+		success = index_add (dir, &idx, &e);
 		goto done;
+	}
 
 	/* Set OFS to offset of free slot.
 	 * If there are no free slots, then it will be set to the
@@ -149,18 +498,27 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) {
 	 * inode_read_at() will only return a short read at end of file.
 	 * Otherwise, we'd need to verify that we didn't get a short
 	 * read due to something intermittent such as low memory. */
-	for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-			ofs += sizeof e)
-		if (!e.in_use)
+	for (ofs = 0; inode_read_at (dir->inode, &slot, sizeof slot, ofs)
+			== sizeof slot; ofs += sizeof slot)
+		if (!slot.in_use)
 			break;
 
+	/* A directory full at DIR_LINEAR_MAX entries or more becomes
+	 * hashed instead of growing. */
+	if (ofs >= inode_length (dir->inode)
+			&& ofs / (off_t) sizeof e >= DIR_LINEAR_MAX) {
+		success = rebuild_index (dir, ofs / sizeof e + 1)
+			&& read_index (dir, &idx) && index_add (dir, &idx, &e);
+		goto done;
+	}
+
 	/* Write slot. */
-	e.in_use = true;
-	strlcpy (e.name, name, sizeof e.name);
-	e.inode_sector = inode_sector;
 	success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
 
 done:
+	if (success)
+		dcache_insert (mnt, parent, name, inode_sector);
+	inode_unlock (dir->inode);
 	return success;
 }
 
@@ -170,6 +528,7 @@ done:
 bool
 dir_remove (struct dir *dir, const char *name) {
 	struct dir_entry e;
+	struct dir_index idx;
 	struct inode *inode = NULL;
 	bool success = false;
 	off_t ofs;
@@ -178,11 +537,12 @@ dir_remove (struct dir *dir, const char *name) {
 	ASSERT (name != NULL);
 
 	/* Find directory entry. */
+	inode_lock (dir->inode);
 	if (!lookup (dir, name, &e, &ofs))
 		goto done;
 
 	/* Open inode. */
-	inode = inode_open (e.inode_sector);
+	inode = inode_open (inode_get_mount (dir->inode), e.inode_sector);
 	if (inode == NULL)
 		goto done;
 
@@ -190,12 +550,20 @@ dir_remove (struct dir *dir, const char *name) {
 	e.in_use = false;
 	if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e)
 		goto done;
+	if (read_index (dir, &idx)) {
+		idx.entry_cnt--;
+		inode_write_at (dir->inode, &idx, sizeof idx, 0);
+	}
+
+	dcache_insert (inode_get_mount (dir->inode), inode_get_inumber (dir->inode),
+			name, DCACHE_NONE);
 
 	/* Remove inode. */
 	inode_remove (inode);
 	success = true;
 
 done:
+	inode_unlock (dir->inode);
 	inode_close (inode);
 	return success;
 }
@@ -205,14 +573,89 @@ done:
  * contains no more entries. */
 bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1]) {
-	struct dir_entry e;
+	struct dirent e;
 
-	while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) {
-		dir->pos += sizeof e;
-		if (e.in_use) {
-			strlcpy (name, e.name, NAME_MAX + 1);
-			return true;
+	if (dir_readdir_multiple (dir, &e, 1) == 0)
+		return false;
+	strlcpy (name, e.d_name, NAME_MAX + 1);
+	return true;
+}
+
+/* Inode prefetch.  A program that lists a directory often goes on
+ * to open each entry it finds, as tar does, and each open reads an
+ * inode sector from wherever it is on the disk.  Once a listing looks
+ * like a walk, because it asked for several entries at once or went on
+ * from where the last one stopped, each sector's worth of entries
+ * read has the inodes of the entries in use prefetched, by
+ * buffer_cache_prefetch(), which reads them in order of position.
+ * The opens that follow then mostly find their inodes cached. */
+
+/* Prefetches the inodes of the entries in use among the CNT entries
+ * of CHUNK, read from POS in DIR, that were not prefetched before. */
+static void
+prefetch_inodes (struct dir *dir, const struct dir_entry chunk[], size_t cnt,
+		off_t pos) {
+	disk_sector_t sectors[DIR_BUCKET_ENTRIES];
+	size_t n = 0;
+
+	for (size_t i = 0; i < cnt; i++, pos += sizeof *chunk)
+		if (pos >= dir->prefetched && chunk[i].in_use)
+			sectors[n++] = chunk[i].inode_sector;
+	if (pos > dir->prefetched)
+		dir->prefetched = pos;
+	if (n > 0)
+		buffer_cache_prefetch (inode_get_mount (dir->inode), sectors, n);
+}
+
+/* Reads up to MAX of the next entries in DIR into ENTS, reading the
+ * directory a sector's worth of entries at a time.  Returns the
+ * number read, which is 0 if the directory contains no more
+ * entries. */
+size_t
+dir_readdir_multiple (struct dir *dir, struct dirent *ents, size_t max) {
+	struct dir_entry chunk[DIR_BUCKET_ENTRIES];
+	struct dir_index idx;
+	off_t end = -1;
+	size_t cnt = 0;
+	bool walk = max > 1 || (dir->pos != 0 && dir->pos == dir->readdir_end);
+
+	/* In a hashed directory, go through the buckets, skipping the
+	 * header and the end of each sector. */
+	inode_lock (dir->inode);
+	if (read_index (dir, &idx)) {
+		end = bucket_ofs (idx.bucket_cnt);
+		if (dir->pos < bucket_ofs (0))
+			dir->pos = bucket_ofs (0);
+	}
+
+	while (cnt < max && (end < 0 || dir->pos < end)) {
+		size_t n = DIR_BUCKET_ENTRIES, got, i;
+
+		if (end >= 0) {
+			size_t slot = (dir->pos % DISK_SECTOR_SIZE) / sizeof *chunk;
+
+			if (slot >= DIR_BUCKET_ENTRIES) {
+				dir->pos = ROUND_UP (dir->pos, DISK_SECTOR_SIZE);
+				continue;
+			}
+			n -= slot;
 		}
+		got = inode_read_at (dir->inode, chunk, n * sizeof *chunk, dir->pos)
+			/ sizeof *chunk;
+		if (got == 0)
+			break;
+		if (walk)
+			prefetch_inodes (dir, chunk, got, dir->pos);
+
+		for (i = 0; i < got && cnt < max; i++)
+			if (chunk[i].in_use) {
+				ents[cnt].d_ino = chunk[i].inode_sector;
+				strlcpy (ents[cnt].d_name, chunk[i].name, sizeof ents[cnt].d_name);
+				cnt++;
+			}
+		dir->pos += i * sizeof *chunk;
 	}
-	return false;
+	dir->readdir_end = dir->pos;
+	inode_unlock (dir->inode);
+	return cnt;
 }
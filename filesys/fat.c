@@ -1,8 +1,13 @@
 #include "filesys/fat.h"
+#include <bitmap.h>
 #include "devices/disk.h"
+#include "filesys/buffer_cache.h"
 #include "filesys/filesys.h"
+#include "filesys/mount.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/vaddr.h"
 #include <stdio.h>
 #include <string.h>
 
@@ -16,134 +21,156 @@ struct fat_boot {
 	unsigned int root_dir_cluster;
 };
 
-/* FAT FS */
+/* The FAT of a mount.
+ *
+ * The FAT is not held in memory.  Its sectors are read and written
+ * through the buffer cache as metadata, as they are used, so that
+ * the ones in use stay cached and the rest cost nothing; the cache
+ * writes them after the data, see fat_flush().
+ *
+ * USED tells which clusters are in use, for finding free ones
+ * without reading the FAT.  It is filled in lazily, so that
+ * mounting does not read the whole FAT: the clusters of a FAT
+ * sector not SCANNED yet count as in use, and fat_find_free() scans
+ * further sectors, from SCAN_NEXT on, when it finds no free cluster
+ * among those it knows.
+ *
+ * Each mount has its own, and WRITE_LOCK covers only that one. */
+
+/* FAT entries per sector. */
+#define FAT_PER_SECTOR (DISK_SECTOR_SIZE / sizeof (cluster_t))
+
 struct fat_fs {
 	struct fat_boot bs;
-	unsigned int *fat;
 	unsigned int fat_length;
 	disk_sector_t data_start;
 	cluster_t last_clst;
 	struct lock write_lock;
+	struct bitmap *used;      /* One bit per cluster, set if in use. */
+	struct bitmap *scanned;   /* One bit per FAT sector, set if in USED. */
+	size_t scan_next;         /* Where to look for a sector to scan. */
+	cluster_t next_clst;      /* Where to look for a new chain. */
+	cluster_t entries[FAT_PER_SECTOR]; /* A sector being scanned. */
 };
 
-static struct fat_fs *fat_fs;
+/* A new chain starts where at least this many clusters are free, if
+ * there is such a place, so that the file can grow contiguously. */
+#define FAT_NEW_RUN 8
 
-void fat_boot_create (void);
-void fat_fs_init (void);
+void fat_boot_create (struct mount *);
+void fat_fs_init (struct fat_fs *);
+static void fat_used_init (struct fat_fs *, bool known_free);
 
+/* Reads the FAT boot sector of MNT, or makes one up if the disk has
+ * none, and sets up MNT's FAT from it. */
 void
-fat_init (void) {
-	fat_fs = calloc (1, sizeof (struct fat_fs));
-	if (fat_fs == NULL)
+fat_init (struct mount *mnt) {
+	struct fat_fs *fs = calloc (1, sizeof (struct fat_fs));
+	if (fs == NULL)
 		PANIC ("FAT init failed");
 
+	lock_init (&fs->write_lock);
+	mnt->fat = fs;
+
 	// Read boot sector from the disk
 	unsigned int *bounce = malloc (DISK_SECTOR_SIZE);
 	if (bounce == NULL)
 		PANIC ("FAT init failed");
-	disk_read (filesys_disk, FAT_BOOT_SECTOR, bounce);
-	memcpy (&fat_fs->bs, bounce, sizeof (fat_fs->bs));
+	disk_read (mnt->disk, FAT_BOOT_SECTOR, bounce);
+	memcpy (&fs->bs, bounce, sizeof (fs->bs));
 	free (bounce);
 
 	// Extract FAT info
-	if (fat_fs->bs.magic != FAT_MAGIC)
-		fat_boot_create ();
-	fat_fs_init ();
+	if (fs->bs.magic != FAT_MAGIC)
+		fat_boot_create (mnt);
+	fat_fs_init (fs);
 }
 
 void
-fat_open (void) {
-	fat_fs->fat = calloc (fat_fs->fat_length, sizeof (cluster_t));
-	if (fat_fs->fat == NULL)
-		PANIC ("FAT load failed");
-
-	// Load FAT directly from the disk
-	uint8_t *buffer = (uint8_t *) fat_fs->fat;
-	off_t bytes_read = 0;
-	off_t bytes_left = sizeof (fat_fs->fat);
-	const off_t fat_size_in_bytes = fat_fs->fat_length * sizeof (cluster_t);
-	for (unsigned i = 0; i < fat_fs->bs.fat_sectors; i++) {
-		bytes_left = fat_size_in_bytes - bytes_read;
-		if (bytes_left >= DISK_SECTOR_SIZE) {
-			disk_read (filesys_disk, fat_fs->bs.fat_start + i,
-			           buffer + bytes_read);
-			bytes_read += DISK_SECTOR_SIZE;
-		} else {
-			uint8_t *bounce = malloc (DISK_SECTOR_SIZE);
-			if (bounce == NULL)
-				PANIC ("FAT load failed");
-			disk_read (filesys_disk, fat_fs->bs.fat_start + i, bounce);
-			memcpy (buffer + bytes_read, bounce, bytes_left);
-			bytes_read += bytes_left;
-			free (bounce);
-		}
-	}
+fat_open (struct mount *mnt) {
+	struct fat_fs *fs = mnt->fat;
+
+	lock_acquire (&fs->write_lock);
+	fat_used_init (fs, false);
+	lock_release (&fs->write_lock);
 }
 
+/* Writes the sectors of the FAT changed since they were last
+ * written, with those of every mount, along with the other metadata
+ * in the buffer cache.  The periodic flush calls this after writing
+ * the data, so that a crash loses little, and what is on disk of a
+ * chain has mostly had its clusters written. */
 void
-fat_close (void) {
+fat_flush (void) {
+	buffer_cache_checkpoint ();
+}
+
+void
+fat_close (struct mount *mnt) {
 	// Write FAT boot sector
 	uint8_t *bounce = calloc (1, DISK_SECTOR_SIZE);
 	if (bounce == NULL)
 		PANIC ("FAT close failed");
-	memcpy (bounce, &fat_fs->bs, sizeof (fat_fs->bs));
-	disk_write (filesys_disk, FAT_BOOT_SECTOR, bounce);
+	memcpy (bounce, &mnt->fat->bs, sizeof (mnt->fat->bs));
+	disk_write (mnt->disk, FAT_BOOT_SECTOR, bounce);
 	free (bounce);
 
-	// Write FAT directly to the disk
-	uint8_t *buffer = (uint8_t *) fat_fs->fat;
-	off_t bytes_wrote = 0;
-	off_t bytes_left = sizeof (fat_fs->fat);
-	const off_t fat_size_in_bytes = fat_fs->fat_length * sizeof (cluster_t);
-	for (unsigned i = 0; i < fat_fs->bs.fat_sectors; i++) {
-		bytes_left = fat_size_in_bytes - bytes_wrote;
-		if (bytes_left >= DISK_SECTOR_SIZE) {
-			disk_write (filesys_disk, fat_fs->bs.fat_start + i,
-			            buffer + bytes_wrote);
-			bytes_wrote += DISK_SECTOR_SIZE;
-		} else {
-			bounce = calloc (1, DISK_SECTOR_SIZE);
-			if (bounce == NULL)
-				PANIC ("FAT close failed");
-			memcpy (bounce, buffer + bytes_wrote, bytes_left);
-			disk_write (filesys_disk, fat_fs->bs.fat_start + i, bounce);
-			bytes_wrote += bytes_left;
-			free (bounce);
-		}
-	}
+	// Write what changed of the FAT to the disk, after the data
+	buffer_cache_flush ();
+	fat_flush ();
 }
 
+/* Frees MNT's FAT, which is closed. */
 void
-fat_create (void) {
+fat_destroy (struct mount *mnt) {
+	bitmap_destroy (mnt->fat->used);
+	bitmap_destroy (mnt->fat->scanned);
+	free (mnt->fat);
+	mnt->fat = NULL;
+}
+
+void
+fat_create (struct mount *mnt) {
+	struct fat_fs *fs = mnt->fat;
+
 	// Create FAT boot
-	fat_boot_create ();
-	fat_fs_init ();
+	fat_boot_create (mnt);
+	fat_fs_init (fs);
 
-	// Create FAT table
-	fat_fs->fat = calloc (fat_fs->fat_length, sizeof (cluster_t));
-	if (fat_fs->fat == NULL)
-		PANIC ("FAT creation failed");
+	// Create FAT table, all of it free
+	uint8_t *zeros = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+	for (size_t i = 0; i < fs->bs.fat_sectors; i += PGSIZE / DISK_SECTOR_SIZE) {
+		size_t cnt = fs->bs.fat_sectors - i;
+		if (cnt > PGSIZE / DISK_SECTOR_SIZE)
+			cnt = PGSIZE / DISK_SECTOR_SIZE;
+		disk_write_multiple (mnt->disk, fs->bs.fat_start + i, cnt, zeros);
+	}
+	palloc_free_page (zeros);
+
+	lock_acquire (&fs->write_lock);
+	fat_used_init (fs, true);
 
 	// Set up ROOT_DIR_CLST
-	fat_put (ROOT_DIR_CLUSTER, EOChain);
+	fat_put (mnt, ROOT_DIR_CLUSTER, EOChain);
+	lock_release (&fs->write_lock);
 
 	// Fill up ROOT_DIR_CLUSTER region with 0
 	uint8_t *buf = calloc (1, DISK_SECTOR_SIZE);
 	if (buf == NULL)
 		PANIC ("FAT create failed due to OOM");
-	disk_write (filesys_disk, cluster_to_sector (ROOT_DIR_CLUSTER), buf);
+	disk_write (mnt->disk, cluster_to_sector (mnt, ROOT_DIR_CLUSTER), buf);
 	free (buf);
 }
 
 void
-fat_boot_create (void) {
+fat_boot_create (struct mount *mnt) {
 	unsigned int fat_sectors =
-	    (disk_size (filesys_disk) - 1)
+	    (disk_size (mnt->disk) - 1)
 	    / (DISK_SECTOR_SIZE / sizeof (cluster_t) * SECTORS_PER_CLUSTER + 1) + 1;
-	fat_fs->bs = (struct fat_boot){
+	mnt->fat->bs = (struct fat_boot){
 	    .magic = FAT_MAGIC,
 	    .sectors_per_cluster = SECTORS_PER_CLUSTER,
-	    .total_sectors = disk_size (filesys_disk),
+	    .total_sectors = disk_size (mnt->disk),
 	    .fat_start = 1,
 	    .fat_sectors = fat_sectors,
 	    .root_dir_cluster = ROOT_DIR_CLUSTER,
@@ -151,43 +178,316 @@ fat_boot_create (void) {
 }
 
 void
-fat_fs_init (void) {
-	/* TODO: Your code goes here. */
+fat_fs_init (struct fat_fs *fat_fs) {
+	disk_sector_t data_clusters;
+
+	fat_fs->fat_length = fat_fs->bs.fat_sectors * DISK_SECTOR_SIZE
+		/ sizeof (cluster_t);
+	fat_fs->data_start = fat_fs->bs.fat_start + fat_fs->bs.fat_sectors;
+
+	/* Cluster 0 means "no cluster", so data clusters start at 1. */
+	data_clusters = (fat_fs->bs.total_sectors - fat_fs->data_start)
+		/ SECTORS_PER_CLUSTER;
+	if (fat_fs->fat_length > data_clusters + 1)
+		fat_fs->fat_length = data_clusters + 1;
+	fat_fs->last_clst = fat_fs->fat_length - 1;
+}
+
+/* Sets up the bitmap of clusters in use, with every cluster free if
+ * KNOWN_FREE is true, for a FAT just made, and otherwise with none
+ * known, to be scanned as needed.  Cluster 0 stands for no cluster
+ * and is never handed out.  write_lock must be held. */
+static void
+fat_used_init (struct fat_fs *fat_fs, bool known_free) {
+	bitmap_destroy (fat_fs->used);
+	bitmap_destroy (fat_fs->scanned);
+	fat_fs->used = bitmap_create (fat_fs->fat_length);
+	fat_fs->scanned = bitmap_create (fat_fs->bs.fat_sectors);
+	if (fat_fs->used == NULL || fat_fs->scanned == NULL)
+		PANIC ("FAT free cluster map creation failed");
+	bitmap_set_all (fat_fs->used, !known_free);
+	bitmap_set_all (fat_fs->scanned, known_free);
+	bitmap_mark (fat_fs->used, 0);
+	fat_fs->scan_next = 0;
+	fat_fs->next_clst = ROOT_DIR_CLUSTER + 1;
+}
+
+/* Reads FAT sector SEC, if it has not been scanned yet, and records
+ * in the bitmap which of its clusters are in use.  write_lock must
+ * be held. */
+static void
+fat_scan_sector (struct mount *mnt, size_t sec) {
+	struct fat_fs *fat_fs = mnt->fat;
+
+	if (bitmap_test (fat_fs->scanned, sec))
+		return;
+	buffer_cache_read_meta (mnt, fat_fs->bs.fat_start + sec, fat_fs->entries,
+			0, DISK_SECTOR_SIZE);
+	for (size_t i = 0; i < FAT_PER_SECTOR; i++) {
+		cluster_t c = sec * FAT_PER_SECTOR + i;
+
+		if (c >= 1 && c < fat_fs->fat_length)
+			bitmap_set (fat_fs->used, c, fat_fs->entries[i] != 0);
+	}
+	bitmap_mark (fat_fs->scanned, sec);
+}
+
+/* Scans the next FAT sector not scanned yet, from SCAN_NEXT on.
+ * Returns false if all of them have been.  write_lock must be
+ * held. */
+static bool
+fat_scan_next (struct mount *mnt) {
+	struct fat_fs *fat_fs = mnt->fat;
+	size_t sec = bitmap_scan (fat_fs->scanned, fat_fs->scan_next, 1, false);
+
+	if (sec == BITMAP_ERROR)
+		sec = bitmap_scan (fat_fs->scanned, 0, 1, false);
+	if (sec == BITMAP_ERROR)
+		return false;
+	fat_scan_sector (mnt, sec);
+	fat_fs->scan_next = sec + 1 < fat_fs->bs.fat_sectors ? sec + 1 : 0;
+	return true;
+}
+
+/* Returns a free cluster for the chain whose last cluster is CLST,
+ * or for a new chain if CLST is 0, among those known to be free, or
+ * 0 if there is none.  A chain grows into the cluster right after
+ * its last one if it can, and new chains go after the last one
+ * started, where there is room for them to grow.  write_lock must be
+ * held. */
+static cluster_t
+fat_find_known_free (struct mount *mnt, cluster_t clst) {
+	struct fat_fs *fat_fs = mnt->fat;
+	struct bitmap *used = fat_fs->used;
+	size_t c;
+
+	if (clst != 0) {
+		if (clst < fat_fs->last_clst) {
+			fat_scan_sector (mnt, (clst + 1) / FAT_PER_SECTOR);
+			if (!bitmap_test (used, clst + 1))
+				return clst + 1;
+		}
+		c = bitmap_scan (used, clst, 1, false);
+	} else {
+		c = bitmap_scan (used, fat_fs->next_clst, FAT_NEW_RUN, false);
+		if (c == BITMAP_ERROR)
+			c = bitmap_scan (used, 0, FAT_NEW_RUN, false);
+		if (c == BITMAP_ERROR)
+			c = bitmap_scan (used, fat_fs->next_clst, 1, false);
+		if (c != BITMAP_ERROR)
+			fat_fs->next_clst = c + 1 < fat_fs->fat_length ? c + 1 : 0;
+	}
+	if (c == BITMAP_ERROR)
+		c = bitmap_scan (used, 0, 1, false);
+	return c != BITMAP_ERROR ? c : 0;
+}
+
+/* Returns a free cluster for the chain whose last cluster is CLST,
+ * as fat_find_known_free() does, scanning more of the FAT if none
+ * is known, or 0 if the disk is full.  write_lock must be held. */
+static cluster_t
+fat_find_free (struct mount *mnt, cluster_t clst) {
+	cluster_t c;
+
+	while ((c = fat_find_known_free (mnt, clst)) == 0 && fat_scan_next (mnt))
+		continue;
+	return c;
 }
 
 /*----------------------------------------------------------------------------*/
 /* FAT handling                                                               */
 /*----------------------------------------------------------------------------*/
 
-/* Add a cluster to the chain.
+/* Add a cluster to the chain in MNT's FAT.
  * If CLST is 0, start a new chain.
  * Returns 0 if fails to allocate a new cluster. */
 cluster_t
-fat_create_chain (cluster_t clst) {
-	/* TODO: Your code goes here. */
+fat_create_chain (struct mount *mnt, cluster_t clst) {
+	cluster_t new;
+
+	lock_acquire (&mnt->fat->write_lock);
+	new = fat_find_free (mnt, clst);
+	if (new != 0) {
+		fat_put (mnt, new, EOChain);
+		if (clst != 0)
+			fat_put (mnt, clst, new);
+	}
+	lock_release (&mnt->fat->write_lock);
+	return new;
 }
 
-/* Remove the chain of clusters starting from CLST.
+/* Remove the chain of clusters starting from CLST in MNT's FAT.
  * If PCLST is 0, assume CLST as the start of the chain. */
 void
-fat_remove_chain (cluster_t clst, cluster_t pclst) {
-	/* TODO: Your code goes here. */
+fat_remove_chain (struct mount *mnt, cluster_t clst, cluster_t pclst) {
+	lock_acquire (&mnt->fat->write_lock);
+	while (clst != 0 && clst != EOChain) {
+		cluster_t next = fat_get (mnt, clst);
+
+		fat_put (mnt, clst, 0);
+		clst = next;
+	}
+	if (pclst != 0)
+		fat_put (mnt, pclst, EOChain);
+	lock_release (&mnt->fat->write_lock);
 }
 
-/* Update a value in the FAT table. */
+/* Update a value in MNT's FAT table.  write_lock must be held. */
 void
-fat_put (cluster_t clst, cluster_t val) {
-	/* TODO: Your code goes here. */
+fat_put (struct mount *mnt, cluster_t clst, cluster_t val) {
+	struct fat_fs *fat_fs = mnt->fat;
+
+	ASSERT (clst >= 1 && clst < fat_fs->fat_length);
+	buffer_cache_write_meta (mnt, fat_fs->bs.fat_start + clst / FAT_PER_SECTOR,
+			&val, clst % FAT_PER_SECTOR * sizeof val, sizeof val, NULL);
+	bitmap_set (fat_fs->used, clst, val != 0);
 }
 
-/* Fetch a value in the FAT table. */
+/* Fetch a value in MNT's FAT table. */
 cluster_t
-fat_get (cluster_t clst) {
-	/* TODO: Your code goes here. */
+fat_get (struct mount *mnt, cluster_t clst) {
+	struct fat_fs *fat_fs = mnt->fat;
+	cluster_t val;
+
+	ASSERT (clst >= 1 && clst < fat_fs->fat_length);
+	buffer_cache_read_meta (mnt, fat_fs->bs.fat_start + clst / FAT_PER_SECTOR,
+			&val, clst % FAT_PER_SECTOR * sizeof val, sizeof val);
+	return val;
 }
 
-/* Covert a cluster # to a sector number. */
+/* Covert a cluster # of MNT to a sector number. */
 disk_sector_t
-cluster_to_sector (cluster_t clst) {
-	/* TODO: Your code goes here. */
+cluster_to_sector (struct mount *mnt, cluster_t clst) {
+	ASSERT (clst >= 1);
+	return mnt->fat->data_start + (clst - 1) * SECTORS_PER_CLUSTER;
+}
+
+/* Converts SECTOR of MNT, the first sector of a cluster, to its
+ * cluster #. */
+cluster_t
+sector_to_cluster (struct mount *mnt, disk_sector_t sector) {
+	ASSERT (sector >= mnt->fat->data_start);
+	return (sector - mnt->fat->data_start) / SECTORS_PER_CLUSTER + 1;
+}
+
+/*----------------------------------------------------------------------------*/
+/* Cluster chain maps                                                         */
+/*----------------------------------------------------------------------------*/
+
+/* Initializes MAP for the chain of MNT that starts at START, which
+ * may be 0 for no chain.  Nothing is looked up until it is needed. */
+void
+fat_map_init (struct fat_map *map, struct mount *mnt, cluster_t start) {
+	map->mnt = mnt;
+	map->start = start;
+	map->runs = NULL;
+	map->run_cnt = 0;
+	map->run_cap = 0;
+	lock_init (&map->lock);
+}
+
+/* Forgets what MAP knows, for a chain that now starts at START.
+ * Must be called whenever clusters are removed from the chain, or
+ * the chain is started.  Clusters added at its end are found
+ * without it, since a lookup past the known extents goes on from
+ * the last known cluster. */
+void
+fat_map_reset (struct fat_map *map, cluster_t start) {
+	lock_acquire (&map->lock);
+	map->start = start;
+	map->run_cnt = 0;
+	lock_release (&map->lock);
+}
+
+/* Frees the resources MAP holds. */
+void
+fat_map_destroy (struct fat_map *map) {
+	free (map->runs);
+	map->runs = NULL;
+	map->run_cnt = map->run_cap = 0;
+}
+
+/* Appends cluster CLST, at INDEX in the chain, to MAP.  Returns
+ * false if memory is short. */
+static bool
+fat_map_append (struct fat_map *map, uint32_t index, cluster_t clst) {
+	struct fat_extent *last = map->run_cnt > 0
+		? &map->runs[map->run_cnt - 1] : NULL;
+
+	if (last != NULL && clst == last->clst + last->length) {
+		last->length++;
+		return true;
+	}
+	if (map->run_cnt == map->run_cap) {
+		size_t cap = map->run_cap > 0 ? map->run_cap * 2 : 4;
+		struct fat_extent *runs = realloc (map->runs, cap * sizeof *runs);
+
+		if (runs == NULL)
+			return false;
+		map->runs = runs;
+		map->run_cap = cap;
+	}
+	map->runs[map->run_cnt++] = (struct fat_extent) {
+		.index = index, .clst = clst, .length = 1 };
+	return true;
+}
+
+/* Returns the cluster at INDEX in the chain of MAP, or 0 if the
+ * chain is shorter than that.  If RUN_LEFT is nonnull, also stores
+ * in it the number of clusters, that one included, known to follow
+ * consecutively on disk. */
+cluster_t
+fat_map_lookup (struct fat_map *map, uint32_t index, uint32_t *run_left) {
+	cluster_t clst = 0;
+	uint32_t left = 0;
+	struct fat_extent *last;
+
+	lock_acquire (&map->lock);
+
+	/* Follow the chain past the known extents as far as INDEX. */
+	last = map->run_cnt > 0 ? &map->runs[map->run_cnt - 1] : NULL;
+	if (last == NULL || index >= last->index + last->length) {
+		uint32_t i = last != NULL ? last->index + last->length : 0;
+		cluster_t c = last != NULL
+			? fat_get (map->mnt, last->clst + last->length - 1) : map->start;
+
+		for (; c != 0 && c != EOChain && i <= index;
+				c = fat_get (map->mnt, c), i++)
+			if (!fat_map_append (map, i, c)) {
+				/* No memory to remember the rest, so just walk it. */
+				while (c != 0 && c != EOChain && i < index) {
+					c = fat_get (map->mnt, c);
+					i++;
+				}
+				if (c != 0 && c != EOChain) {
+					clst = c;
+					left = 1;
+				}
+				goto done;
+			}
+	}
+
+	/* Find the last extent that starts at or before INDEX. */
+	if (map->run_cnt > 0) {
+		size_t lo = 0, hi = map->run_cnt;
+
+		while (hi - lo > 1) {
+			size_t mid = (lo + hi) / 2;
+
+			if (map->runs[mid].index <= index)
+				lo = mid;
+			else
+				hi = mid;
+		}
+		if (index < map->runs[lo].index + map->runs[lo].length) {
+			clst = map->runs[lo].clst + (index - map->runs[lo].index);
+			left = map->runs[lo].length - (index - map->runs[lo].index);
+		}
+	}
+
+done:
+	lock_release (&map->lock);
+	if (run_left != NULL)
+		*run_left = left;
+	return clst;
 }
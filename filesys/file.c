@@ -1,56 +1,170 @@
 #include "filesys/file.h"
 #include <debug.h>
 #include "filesys/inode.h"
+#include "filesys/pipe.h"
+#include "devices/disk.h"
+#include "threads/atomic.h"
 #include "threads/malloc.h"
+#include "threads/tunable.h"
+#include <uio.h>
+
+/* Allocator for struct file. */
+static struct kmem_cache *file_cache;
+
+/* Largest readahead window, in sectors; see read_ahead(). */
+static size_t ra_max_sectors = 64;
+static struct tunable ra_max_tunable = {
+	.name = "fs.readahead_max", .value = &ra_max_sectors,
+	.min = 4, .max = 1024,
+};
+
+/* Initializes the file module. */
+void
+file_init (void) {
+	file_cache = kmem_cache_create ("file", sizeof (struct file), 0, NULL);
+	tunable_register (&ra_max_tunable);
+}
 
 /* Opens a file for the given INODE, of which it takes ownership,
  * and returns the new file.  Returns a null pointer if an
  * allocation fails or if INODE is null. */
 struct file *
 file_open (struct inode *inode) {
-	struct file *file = calloc (1, sizeof *file); // calloc: sizeof *file 크기의 변수를 1개 저장할 수 있는 공간 할당
-												  // 성공: 할당된 메모리의 시작 주소 반환, 실패: NULL 반환
+	struct file *file = kmem_cache_alloc (file_cache); // 성공: 할당된 메모리의 시작 주소 반환, 실패: NULL 반환
 	if (inode != NULL && file != NULL) { // inode가 NULL이 아니고 파일 open을 위한 메모리가 성공적으로 할당되었을 때
 		file->inode = inode; 		// 인자로 받은 파일에 대한 정보인 inode를 file 구조체의 inode 멤버 변수에 넣어줌
 		file->pos = 0;
 		file->deny_write = false;
-		file->dup_count = 0;		// project2 - extra
+		file->dir = false;
+		file->ref_cnt = 1;
+		file->ra_next = 0;
+		file->ra_end = 0;
+		file->ra_window = 0;
+		file->pipe = NULL;
+		file->pipe_writer = false;
 		return file;				// 열고 싶은 파일의 정보를 넣어준 file 구조체를 리턴해줌
 	} else {
 		inode_close (inode);
-		free (file);
+		kmem_cache_free (file_cache, file);
 		return NULL;
 	}
 }
 
+/* Opens a file for INODE, a directory, as file_open() does.  The
+ * file can be read, and its position is where dir_readdir() goes on
+ * from, but not written. */
+struct file *
+file_open_dir (struct inode *inode) {
+	struct file *file = file_open (inode);
+	if (file != NULL)
+		file->dir = true;
+	return file;
+}
+
+/* Makes FILE, newly allocated, an end of PIPE, the write end if
+ * WRITER is true.  The caller has opened the end in PIPE. */
+static void
+file_init_pipe (struct file *file, struct pipe *pipe, bool writer) {
+	file->inode = NULL;
+	file->pos = 0;
+	file->deny_write = false;
+	file->dir = false;
+	file->ref_cnt = 1;
+	file->ra_next = file->ra_end = file->ra_window = 0;
+	file->pipe = pipe;
+	file->pipe_writer = writer;
+}
+
+/* Creates a pipe and opens a file for each end of it, storing the
+ * read end in *READER and the write end in *WRITER.  Reads and
+ * writes of the files go through the pipe, see filesys/pipe.c; they
+ * have no inode, position or length.  Returns false if memory is
+ * short. */
+bool
+file_open_pipe (struct file **reader, struct file **writer) {
+	struct pipe *pipe = pipe_create ();
+	struct file *r, *w;
+
+	if (pipe == NULL)
+		return false;
+	r = kmem_cache_alloc (file_cache);
+	w = kmem_cache_alloc (file_cache);
+	if (r == NULL || w == NULL) {
+		kmem_cache_free (file_cache, r);
+		kmem_cache_free (file_cache, w);
+		pipe_close (pipe, false);
+		pipe_close (pipe, true);
+		return false;
+	}
+	file_init_pipe (r, pipe, false);
+	file_init_pipe (w, pipe, true);
+	*reader = r;
+	*writer = w;
+	return true;
+}
+
+/* Opens another end of the same kind of the pipe that FILE is an end
+ * of.  Returns a null pointer if unsuccessful. */
+static struct file *
+file_reopen_pipe (struct file *file) {
+	struct file *nfile = kmem_cache_alloc (file_cache);
+
+	if (nfile != NULL) {
+		pipe_reopen (file->pipe, file->pipe_writer);
+		file_init_pipe (nfile, file->pipe, file->pipe_writer);
+	}
+	return nfile;
+}
+
 /* Opens and returns a new file for the same inode as FILE.
  * Returns a null pointer if unsuccessful. */
 struct file *
 file_reopen (struct file *file) {
-	return file_open (inode_reopen (file->inode));
+	if (file->pipe != NULL)
+		return file_reopen_pipe (file);
+
+	struct file *nfile = file_open (inode_reopen (file->inode));
+	if (nfile != NULL)
+		nfile->dir = file->dir;
+	return nfile;
 }
 
 /* Duplicate the file object including attributes and returns a new file for the
  * same inode as FILE. Returns a null pointer if unsuccessful. */
 struct file *
 file_duplicate (struct file *file) {
-	struct file *nfile = file_open (inode_reopen (file->inode));
+	struct file *nfile = file->pipe != NULL ? file_reopen_pipe (file)
+		: file_open (inode_reopen (file->inode));
 	if (nfile) {
 		nfile->pos = file->pos;
+		nfile->dir = file->dir;
 		if (file->deny_write)
 			file_deny_write (nfile);
-		nfile->dup_count = file->dup_count;
 	}
 	return nfile;
 }
 
-/* Closes FILE. */
+/* Adds a reference to FILE and returns it.  fork() and dup2() use
+ * this to give a new descriptor the same open file, position and
+ * all, instead of a copy; file_reopen() and file_duplicate() make a
+ * new one.  References are counted atomically, as the holders may be
+ * different processes. */
+struct file *
+file_dup (struct file *file) {
+	atomic_fetch_add (&file->ref_cnt, 1);
+	return file;
+}
+
+/* Drops a reference to FILE, closing it when the last one is
+ * gone. */
 void
 file_close (struct file *file) {
-	if (file != NULL) {
+	if (file != NULL && atomic_fetch_add (&file->ref_cnt, -1) == 1) {
+		if (file->pipe != NULL)
+			pipe_close (file->pipe, file->pipe_writer);
 		file_allow_write (file);
 		inode_close (file->inode);
-		free (file);
+		kmem_cache_free (file_cache, file);
 	}
 }
 
@@ -60,6 +174,48 @@ file_get_inode (struct file *file) {
 	return file->inode;
 }
 
+/* Returns true if FILE was opened as a directory. */
+bool
+file_is_dir (struct file *file) {
+	return file->dir;
+}
+
+/* Sequential readahead.  A file_read() that starts where the last
+ * one ended continues a sequential stream.  The window is RA_MIN
+ * sectors for the first read of a stream and doubles with each one
+ * after, up to RA_MAX; after each read, whatever of the window past
+ * its end has not been asked for yet is read ahead in the background.
+ * Any other read ends the stream.  RA_MAX is ra_max_sectors, which
+ * can be tuned. */
+#define RA_MIN (4 * DISK_SECTOR_SIZE)
+#define RA_MAX ((off_t) ra_max_sectors * DISK_SECTOR_SIZE)
+
+/* Notes a read of BYTES bytes at START in FILE, and reads ahead if
+ * it is sequential. */
+static void
+read_ahead (struct file *file, off_t start, off_t bytes) {
+	off_t end = start + bytes;
+
+	if (bytes <= 0)
+		return;
+	if (start != file->ra_next) {
+		file->ra_window = 0;
+		file->ra_next = end;
+		return;
+	}
+
+	file->ra_window = file->ra_window == 0 ? RA_MIN
+		: file->ra_window * 2 < RA_MAX ? file->ra_window * 2 : RA_MAX;
+	file->ra_next = end;
+	if (file->ra_end < end)
+		file->ra_end = end;
+	if (file->ra_end < end + file->ra_window) {
+		inode_read_ahead (file->inode, end + file->ra_window - file->ra_end,
+				file->ra_end);
+		file->ra_end = end + file->ra_window;
+	}
+}
+
 /* Reads SIZE bytes from FILE into BUFFER,
  * starting at the file's current position.
  * Returns the number of bytes actually read,
@@ -67,7 +223,14 @@ file_get_inode (struct file *file) {
  * Advances FILE's position by the number of bytes read. */
 off_t
 file_read (struct file *file, void *buffer, off_t size) {
+	if (file->pipe != NULL) {
+		struct iovec iov = { .iov_base = buffer,
+			.iov_len = size > 0 ? size : 0 };
+		return file_readv (file, &iov, 1);
+	}
+
 	off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
+	read_ahead (file, file->pos, bytes_read);
 	file->pos += bytes_read;
 	return bytes_read;
 }
@@ -79,6 +242,8 @@ file_read (struct file *file, void *buffer, off_t size) {
  * The file's current position is unaffected. */
 off_t
 file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs) {
+	if (file->pipe != NULL)
+		return -1;
 	return inode_read_at (file->inode, buffer, size, file_ofs);
 }
 
@@ -91,7 +256,16 @@ file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs) {
  * Advances FILE's position by the number of bytes read. */
 off_t
 file_write (struct file *file, const void *buffer, off_t size) {
-	off_t bytes_written = inode_write_at (file->inode, buffer, size, file->pos);
+	off_t bytes_written;
+
+	if (file->pipe != NULL) {
+		struct iovec iov = { .iov_base = (void *) buffer,
+			.iov_len = size > 0 ? size : 0 };
+		return file_writev (file, &iov, 1);
+	}
+	if (file->dir)
+		return 0;
+	bytes_written = inode_write_at (file->inode, buffer, size, file->pos);
 	file->pos += bytes_written;
 	return bytes_written;
 }
@@ -106,9 +280,47 @@ file_write (struct file *file, const void *buffer, off_t size) {
 off_t
 file_write_at (struct file *file, const void *buffer, off_t size,
 		off_t file_ofs) {
+	if (file->pipe != NULL)
+		return -1;
+	if (file->dir)
+		return 0;
 	return inode_write_at (file->inode, buffer, size, file_ofs);
 }
 
+/* Reads from FILE, starting at the file's current position, into
+ * the CNT buffers in IOV in turn, as one read.
+ * Returns the number of bytes actually read,
+ * which may be less than the buffers hold if end of file is reached.
+ * Advances FILE's position by the number of bytes read. */
+off_t
+file_readv (struct file *file, const struct iovec *iov, int cnt) {
+	if (file->pipe != NULL)
+		return file->pipe_writer ? -1 : pipe_readv (file->pipe, iov, cnt);
+
+	off_t bytes_read = inode_readv (file->inode, iov, cnt, file->pos);
+	read_ahead (file, file->pos, bytes_read);
+	file->pos += bytes_read;
+	return bytes_read;
+}
+
+/* Writes the CNT buffers in IOV in turn into FILE, starting at the
+ * file's current position, as one write.
+ * Returns the number of bytes actually written,
+ * which may be less than the buffers hold if the disk is full.
+ * Advances FILE's position by the number of bytes written. */
+off_t
+file_writev (struct file *file, const struct iovec *iov, int cnt) {
+	off_t bytes_written;
+
+	if (file->pipe != NULL)
+		return file->pipe_writer ? pipe_writev (file->pipe, iov, cnt) : -1;
+	if (file->dir)
+		return 0;
+	bytes_written = inode_writev (file->inode, iov, cnt, file->pos);
+	file->pos += bytes_written;
+	return bytes_written;
+}
+
 /* Prevents write operations on FILE's underlying inode
  * until file_allow_write() is called or FILE is closed. */
 void
@@ -138,9 +350,32 @@ file_allow_write (struct file *file) {
 off_t
 file_length (struct file *file) {
 	ASSERT (file != NULL);
+	if (file->pipe != NULL)
+		return 0;
 	return inode_length (file->inode);
 }
 
+/* Reserves disk space for the SIZE bytes of FILE at OFFSET, growing
+ * it to OFFSET + SIZE bytes if it is shorter.  Returns true if
+ * successful. */
+bool
+file_reserve (struct file *file, off_t offset, off_t size) {
+	ASSERT (file != NULL);
+	if (file->dir || file->pipe != NULL)
+		return false;
+	return inode_reserve (file->inode, offset, size);
+}
+
+/* Writes FILE's changes to disk, as inode_sync() does, so that they
+ * survive a crash.  If DATA_ONLY is true, the inode is written only
+ * if it has changed. */
+void
+file_sync (struct file *file, bool data_only) {
+	ASSERT (file != NULL);
+	if (file->pipe == NULL)
+		inode_sync (file->inode, data_only);
+}
+
 /* Sets the current position in FILE to NEW_POS bytes from the
  * start of the file.
  * 시스템콜 함수인 seek()에서 fd가 가리키는 file의 pos(current position)를 new_pos로 바꿔주는 함수
@@ -2,55 +2,45 @@
 #include <debug.h>
 #include <stdio.h>
 #include <string.h>
+#include "filesys/buffer_cache.h"
 #include "filesys/file.h"
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
+#include "filesys/mount.h"
 #include "filesys/directory.h"
 #include "devices/disk.h"
 
-/* The disk that contains the file system. */
-struct disk *filesys_disk;
+/* Name of the disk to use, see disk_find(). */
+const char *filesys_disk_name = "hd0:1";
 
-static void do_format (void);
+static bool filesys_add (const char *name, off_t initial_size,
+		const char *target);
 
 /* Initializes the file system module.
  * If FORMAT is true, reformats the file system. */
 void
 filesys_init (bool format) {
-	filesys_disk = disk_get (0, 1);
-	if (filesys_disk == NULL)
-		PANIC ("hd0:1 (hdb) not present, file system initialization failed");
+	struct disk *disk = disk_find (filesys_disk_name);
+	if (disk == NULL)
+		PANIC ("%s not present, file system initialization failed",
+				filesys_disk_name);
 
+	buffer_cache_init ();
 	inode_init ();
+	file_init ();
+	dir_init ();
+	mount_init ();
 
-#ifdef EFILESYS
-	fat_init ();
-
-	if (format)
-		do_format ();
-
-	fat_open ();
-#else
-	/* Original FS */
-	free_map_init ();
-
-	if (format)
-		do_format ();
-
-	free_map_open ();
-#endif
+	/* The first mount is the root. */
+	if (mount_open (disk, format) == NULL)
+		PANIC ("%s: file system initialization failed", filesys_disk_name);
 }
 
 /* Shuts down the file system module, writing any unwritten data
  * to disk. */
 void
 filesys_done (void) {
-	/* Original FS */
-#ifdef EFILESYS
-	fat_close ();
-#else
-	free_map_close ();
-#endif
+	mount_close (mount_root ());
 }
 
 /* Creates a file named NAME with the given INITIAL_SIZE.
@@ -59,14 +49,54 @@ filesys_done (void) {
  * or if internal memory allocation fails. */
 bool
 filesys_create (const char *name, off_t initial_size) {
+	return filesys_add (name, initial_size, NULL);
+}
+
+/* Creates a symbolic link named LINKPATH to TARGET, which need not
+ * exist.  Opening LINKPATH then opens whatever TARGET names at the
+ * time.  Returns true if successful, false otherwise.
+ * Fails if a file named LINKPATH already exists, if TARGET is
+ * longer than SYMLINK_MAX, or if internal memory allocation
+ * fails. */
+bool
+filesys_symlink (const char *target, const char *linkpath) {
+	if (strlen (target) > SYMLINK_MAX)
+		return false;
+	return filesys_add (linkpath, 0, target);
+}
+
+/* Creates NAME in the root directory: a file with the given
+ * INITIAL_SIZE, or, if TARGET is not null, a symbolic link to
+ * TARGET. */
+static bool
+filesys_add (const char *name, off_t initial_size, const char *target) {
 	disk_sector_t inode_sector = 0;
 	struct dir *dir = dir_open_root ();
+	/* The new inode goes on the directory's own disk. */
+	struct mount *mnt = dir != NULL
+		? inode_get_mount (dir_get_inode (dir)) : NULL;
+#ifdef EFILESYS
+	cluster_t inode_clst = dir != NULL ? fat_create_chain (mnt, 0) : 0;
+	if (inode_clst != 0)
+		inode_sector = cluster_to_sector (mnt, inode_clst);
+	bool success = (inode_clst != 0
+			&& (target != NULL
+				? inode_create_symlink (mnt, inode_sector, target)
+				: inode_create (mnt, inode_sector, initial_size))
+			&& dir_add (dir, name, inode_sector));
+	if (!success && inode_clst != 0)
+		fat_remove_chain (mnt, inode_clst, 0);
+#else
 	bool success = (dir != NULL
-			&& free_map_allocate (1, &inode_sector)
-			&& inode_create (inode_sector, initial_size)
+			&& free_map_allocate (mnt, 1,
+				inode_get_inumber (dir_get_inode (dir)), &inode_sector)
+			&& (target != NULL
+				? inode_create_symlink (mnt, inode_sector, target)
+				: inode_create (mnt, inode_sector, initial_size))
 			&& dir_add (dir, name, inode_sector));
 	if (!success && inode_sector != 0)
-		free_map_release (inode_sector, 1);
+		free_map_release (mnt, inode_sector, 1);
+#endif
 	dir_close (dir);
 
 	return success;
@@ -81,14 +111,19 @@ struct file *
 filesys_open (const char *name) {
 	struct dir *dir = dir_open_root ();
 	struct inode *inode = NULL;
-
-	if (dir != NULL)
-		dir_lookup (dir, name, &inode); 
+	bool is_dir = false;
+
+	/* "/" is the root directory itself, for reading its entries. */
+	if (dir != NULL && !strcmp (name, "/")) {
+		inode = inode_reopen (dir_get_inode (dir));
+		is_dir = true;
+	} else if (dir != NULL)
+		dir_lookup_follow (dir, name, &inode); 
 		// 우리가 입력한 파일 이름을 컴퓨터가 알고 있는 파일 이름으로 바꾸는 과정
 		// 현 dir에 해당 name의 파일이 있는지 보고, 있으면 인자 inode에 해당 파일의 inode를 새김
 	dir_close (dir);
 
-	return file_open (inode);
+	return is_dir ? file_open_dir (inode) : file_open (inode);
 }
 
 /* Deletes the file named NAME.
@@ -103,22 +138,3 @@ filesys_remove (const char *name) {
 
 	return success;
 }
-
-/* Formats the file system. */
-static void
-do_format (void) {
-	printf ("Formatting file system...");
-
-#ifdef EFILESYS
-	/* Create FAT and save it to the disk. */
-	fat_create ();
-	fat_close ();
-#else
-	free_map_create ();
-	if (!dir_create (ROOT_DIR_SECTOR, 16))
-		PANIC ("root directory creation failed");
-	free_map_close ();
-#endif
-
-	printf ("done.\n");
-}
@@ -1,77 +1,307 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <round.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
+#include "filesys/mount.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
 
-static struct file *free_map_file;   /* Free map file. */
-static struct bitmap *free_map;      /* Free map, one bit per disk sector. */
+#ifndef EFILESYS
+/* Locality groups.
+ *
+ * The disk is divided into groups of FREE_MAP_GROUP_SECTORS sectors,
+ * and FREE_MAP_GROUP_FREE has the number of free sectors in each.
+ * An allocation is made near a sector the caller names: a file's
+ * inode near its directory's, its data near the inode, and each run
+ * of data right after the last.  The search starts there and goes
+ * up, wrapping around, through the groups that have room enough,
+ * without scanning the bits of the others.  Files made one after the
+ * other in a directory thus end up close to it and to each other. */
+#define FREE_MAP_GROUP_SECTORS 512
 
-/* Initializes the free map. */
+/* Bits of the map in each sector of its file. */
+#define FREE_MAP_SECTOR_BITS (DISK_SECTOR_SIZE * 8)
+
+/* The free map is changed in memory, under its lock, and the
+ * sectors of it that changed are written to its file by
+ * free_map_flush(), which each journal commit calls, and at
+ * free_map_close().  Allocating sectors thus
+ * never writes a file, which would take the free map file's inode
+ * locks and frame_lock inside the lock of the inode being grown.
+ *
+ * A flush writes the map without LOCK, as the buffer cache writes a
+ * sector: a change made meanwhile marks its sector changed again, so
+ * the next flush has it.  FLUSH_LOCK keeps two flushes from
+ * overlapping.
+ *
+ * The map is metadata like any other, and the journal commits it
+ * with the inodes that refer to it.  Each change is made between
+ * journal_begin() and journal_end(), so that the commit, which
+ * flushes the map, sees it as of one moment.
+ *
+ * Each mount has its own map. */
+struct free_map {
+	struct file *file;          /* Free map file. */
+	struct bitmap *map;         /* One bit per disk sector. */
+	uint16_t *group_free;       /* Free sectors in each group. */
+	size_t group_cnt;           /* Number of groups. */
+	struct bitmap *changed;     /* Sectors of FILE changed since written. */
+	struct lock lock;           /* Covers all but FILE's contents. */
+	struct lock flush_lock;     /* One flush at a time. */
+};
+
+/* Returns the number of sectors in group G of FM. */
+static size_t
+group_size (struct free_map *fm, size_t g) {
+	size_t end = (g + 1) * FREE_MAP_GROUP_SECTORS;
+
+	if (end > bitmap_size (fm->map))
+		end = bitmap_size (fm->map);
+	return end - g * FREE_MAP_GROUP_SECTORS;
+}
+
+/* Counts the free sectors in each group of FM afresh, and marks no
+ * sector of the file changed, after the whole map was read or
+ * written. */
+static void
+recount (struct free_map *fm) {
+	for (size_t g = 0; g < fm->group_cnt; g++)
+		fm->group_free[g] = bitmap_count (fm->map,
+				g * FREE_MAP_GROUP_SECTORS, group_size (fm, g), false);
+	bitmap_set_all (fm->changed, false);
+}
+
+/* Marks the CNT sectors starting at SECTOR used if USED is true, or
+ * free otherwise, and keeps the group counts and the changed sectors
+ * of the file up to date.  The caller holds FM's lock. */
+static void
+mark (struct free_map *fm, disk_sector_t sector, size_t cnt, bool used) {
+	size_t first, last;
+
+	if (cnt == 0)
+		return;
+	bitmap_set_multiple (fm->map, sector, cnt, used);
+	for (size_t s = sector, end; s < sector + cnt; s = end) {
+		size_t g = s / FREE_MAP_GROUP_SECTORS;
+
+		end = (g + 1) * FREE_MAP_GROUP_SECTORS;
+		if (end > sector + cnt)
+			end = sector + cnt;
+		if (used)
+			fm->group_free[g] -= end - s;
+		else
+			fm->group_free[g] += end - s;
+	}
+	first = sector / FREE_MAP_SECTOR_BITS;
+	last = (sector + cnt - 1) / FREE_MAP_SECTOR_BITS;
+	bitmap_set_multiple (fm->changed, first, last - first + 1, true);
+}
+
+/* Initializes the free map of MNT.  Room is kept for the journal on
+ * every mount, so that any of them may be the root. */
 void
-free_map_init (void) {
-	free_map = bitmap_create (disk_size (filesys_disk));
-	if (free_map == NULL)
+free_map_init (struct mount *mnt) {
+	size_t sectors = disk_size (mnt->disk);
+	struct free_map *fm = calloc (1, sizeof *fm);
+
+	if (fm == NULL)
+		PANIC ("free map creation failed");
+	lock_init (&fm->lock);
+	lock_register (&fm->lock, "free map");
+	lock_init (&fm->flush_lock);
+	fm->map = bitmap_create (sectors);
+	fm->changed = bitmap_create (DIV_ROUND_UP (sectors,
+				FREE_MAP_SECTOR_BITS));
+	fm->group_cnt = DIV_ROUND_UP (sectors, FREE_MAP_GROUP_SECTORS);
+	fm->group_free = malloc (fm->group_cnt * sizeof *fm->group_free);
+	if (fm->map == NULL || fm->changed == NULL || fm->group_free == NULL)
 		PANIC ("bitmap creation failed--disk is too large");
-	bitmap_mark (free_map, FREE_MAP_SECTOR);
-	bitmap_mark (free_map, ROOT_DIR_SECTOR);
+	for (size_t g = 0; g < fm->group_cnt; g++)
+		fm->group_free[g] = group_size (fm, g);
+
+	mark (fm, FREE_MAP_SECTOR, 1, true);
+	mark (fm, ROOT_DIR_SECTOR, 1, true);
+	mark (fm, JOURNAL_SECTOR, JOURNAL_SECTORS + 1, true);
+	mnt->free_map = fm;
 }
 
-/* Allocates CNT consecutive sectors from the free map and stores
- * the first into *SECTORP.
- * Returns true if successful, false if all sectors were
- * available. */
-bool
-free_map_allocate (size_t cnt, disk_sector_t *sectorp) {
-	disk_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-	if (sector != BITMAP_ERROR
-			&& free_map_file != NULL
-			&& !bitmap_write (free_map, free_map_file)) {
-		bitmap_set_multiple (free_map, sector, cnt, false);
-		sector = BITMAP_ERROR;
+/* Frees the free map of MNT, which is closed. */
+void
+free_map_destroy (struct mount *mnt) {
+	struct free_map *fm = mnt->free_map;
+
+	bitmap_destroy (fm->map);
+	bitmap_destroy (fm->changed);
+	free (fm->group_free);
+	free (fm);
+	mnt->free_map = NULL;
+}
+
+/* Returns the first sector of CNT free ones in a row in FM that
+ * start in groups FROM up to TO, at or after sector START, or
+ * BITMAP_ERROR if there are none there.  Only groups with CNT free
+ * sectors, or all of theirs free if CNT is more than a group, are
+ * looked at. */
+static size_t
+scan_groups (struct free_map *fm, size_t cnt, size_t from, size_t to,
+		size_t start) {
+	size_t need = cnt < FREE_MAP_GROUP_SECTORS ? cnt : FREE_MAP_GROUP_SECTORS;
+	size_t g = from;
+
+	while (g < to) {
+		size_t sector;
+
+		if (fm->group_free[g] < need) {
+			g++;
+			continue;
+		}
+		if (start < g * FREE_MAP_GROUP_SECTORS)
+			start = g * FREE_MAP_GROUP_SECTORS;
+		sector = bitmap_scan (fm->map, start, cnt, false);
+		if (sector == BITMAP_ERROR)
+			return BITMAP_ERROR;
+		if (sector / FREE_MAP_GROUP_SECTORS == g)
+			return sector;
+
+		/* None starts before SECTOR; go on from its group. */
+		start = sector;
+		g = sector / FREE_MAP_GROUP_SECTORS;
 	}
-	if (sector != BITMAP_ERROR)
+	return BITMAP_ERROR;
+}
+
+/* Allocates CNT consecutive sectors from the free map of MNT, as
+ * near after sector NEAR as it can, and stores the first into
+ * *SECTORP.  Returns true if successful, false if not enough sectors
+ * in a row were available. */
+bool
+free_map_allocate (struct mount *mnt, size_t cnt, disk_sector_t near,
+		disk_sector_t *sectorp) {
+	struct free_map *fm = mnt->free_map;
+	size_t g = near / FREE_MAP_GROUP_SECTORS;
+	size_t sector;
+
+	ASSERT (cnt > 0);
+
+	journal_begin ();
+	lock_acquire (&fm->lock);
+	if (near >= bitmap_size (fm->map))
+		near = g = 0;
+	sector = scan_groups (fm, cnt, g, fm->group_cnt, near);
+	if (sector == BITMAP_ERROR)
+		sector = scan_groups (fm, cnt, 0, g + 1, 0);
+	if (sector == BITMAP_ERROR)
+		/* A run across groups that are each too full. */
+		sector = bitmap_scan (fm->map, 0, cnt, false);
+	if (sector != BITMAP_ERROR) {
+		mark (fm, sector, cnt, true);
 		*sectorp = sector;
+	}
+	lock_release (&fm->lock);
+	journal_end ();
 	return sector != BITMAP_ERROR;
 }
 
-/* Makes CNT sectors starting at SECTOR available for use. */
+/* Allocates the CNT sectors starting at SECTOR from the free map of
+ * MNT, if they are all free.  Returns true if successful. */
+bool
+free_map_allocate_at (struct mount *mnt, disk_sector_t sector, size_t cnt) {
+	struct free_map *fm = mnt->free_map;
+	bool success;
+
+	journal_begin ();
+	lock_acquire (&fm->lock);
+	success = sector + cnt <= bitmap_size (fm->map)
+		&& bitmap_none (fm->map, sector, cnt);
+	if (success)
+		mark (fm, sector, cnt, true);
+	lock_release (&fm->lock);
+	journal_end ();
+	return success;
+}
+
+/* Makes CNT sectors of MNT starting at SECTOR available for use. */
 void
-free_map_release (disk_sector_t sector, size_t cnt) {
-	ASSERT (bitmap_all (free_map, sector, cnt));
-	bitmap_set_multiple (free_map, sector, cnt, false);
-	bitmap_write (free_map, free_map_file);
+free_map_release (struct mount *mnt, disk_sector_t sector, size_t cnt) {
+	struct free_map *fm = mnt->free_map;
+
+	journal_begin ();
+	lock_acquire (&fm->lock);
+	ASSERT (bitmap_all (fm->map, sector, cnt));
+	mark (fm, sector, cnt, false);
+	lock_release (&fm->lock);
+	journal_end ();
 }
 
-/* Opens the free map file and reads it from disk. */
+/* Writes the sectors of the free map of MNT that have changed since
+ * they were last written to its file, through the buffer cache. */
 void
-free_map_open (void) {
-	free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
-	if (free_map_file == NULL)
+free_map_flush (struct mount *mnt) {
+	struct free_map *fm = mnt->free_map;
+
+	lock_acquire (&fm->flush_lock);
+	for (size_t i = 0; i < bitmap_size (fm->changed); i++) {
+		bool changed;
+
+		lock_acquire (&fm->lock);
+		changed = fm->file != NULL && bitmap_test (fm->changed, i);
+		if (changed)
+			bitmap_reset (fm->changed, i);
+		lock_release (&fm->lock);
+
+		if (changed && !bitmap_write_part (fm->map, fm->file,
+					i * FREE_MAP_SECTOR_BITS, FREE_MAP_SECTOR_BITS))
+			bitmap_mark (fm->changed, i);
+	}
+	lock_release (&fm->flush_lock);
+}
+
+/* Opens the free map file of MNT and reads it from disk. */
+void
+free_map_open (struct mount *mnt) {
+	struct free_map *fm = mnt->free_map;
+
+	fm->file = file_open (inode_open (mnt, FREE_MAP_SECTOR));
+	if (fm->file == NULL)
 		PANIC ("can't open free map");
-	if (!bitmap_read (free_map, free_map_file))
+	inode_set_meta (file_get_inode (fm->file));
+	if (!bitmap_read (fm->map, fm->file))
 		PANIC ("can't read free map");
+	recount (fm);
 }
 
-/* Writes the free map to disk and closes the free map file. */
+/* Writes the free map of MNT to disk and closes the free map
+ * file. */
 void
-free_map_close (void) {
-	file_close (free_map_file);
+free_map_close (struct mount *mnt) {
+	struct free_map *fm = mnt->free_map;
+
+	free_map_flush (mnt);
+	file_close (fm->file);
+	fm->file = NULL;
 }
 
-/* Creates a new free map file on disk and writes the free map to
- * it. */
+/* Creates a new free map file on MNT's disk and writes the free map
+ * to it. */
 void
-free_map_create (void) {
+free_map_create (struct mount *mnt) {
+	struct free_map *fm = mnt->free_map;
+
 	/* Create inode. */
-	if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map)))
+	if (!inode_create (mnt, FREE_MAP_SECTOR, bitmap_file_size (fm->map)))
 		PANIC ("free map creation failed");
 
 	/* Write bitmap to file. */
-	free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
-	if (free_map_file == NULL)
+	fm->file = file_open (inode_open (mnt, FREE_MAP_SECTOR));
+	if (fm->file == NULL)
 		PANIC ("can't open free map");
-	if (!bitmap_write (free_map, free_map_file))
+	inode_set_meta (file_get_inode (fm->file));
+	if (!bitmap_write (fm->map, fm->file))
 		PANIC ("can't write free map");
+	recount (fm);
 }
+#endif /* !EFILESYS */
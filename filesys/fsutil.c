@@ -1,5 +1,6 @@
 #include "filesys/fsutil.h"
 #include <debug.h>
+#include <round.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -9,8 +10,13 @@
 #include "devices/disk.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/synch.h"
 #include "threads/vaddr.h"
 
+/* Sectors that fsutil_put() and fsutil_get() move at a time. */
+#define FSUTIL_CHUNK_SECTORS 128
+#define FSUTIL_CHUNK_PAGES (FSUTIL_CHUNK_SECTORS * DISK_SECTOR_SIZE / PGSIZE)
+
 /* List files in the root directory. */
 void
 fsutil_ls (char **argv UNUSED) {
@@ -82,20 +88,17 @@ fsutil_put (char **argv) {
 	struct disk *src;
 	struct file *dst;
 	off_t size;
-	void *buffer;
-	
-	// for (int i = 0; i < sizeof(argv) / sizeof(char); i++)    // 배열의 요소 개수만큼 반복
-    // {
-    //     printf("테스트 '%s'\n", argv[i]);    // 배열의 인덱스에 반복문의 변수 i를 지정
-    // }
-
-	
+	uint8_t *buffers[2];
+	struct bio bio;
+	struct semaphore done;
+	size_t left, i;
+
 	printf ("Putting '%s' into the file system...\n", file_name);
 
-	/* Allocate buffer. */
-	buffer = malloc (DISK_SECTOR_SIZE);
-	if (buffer == NULL)
-		PANIC ("couldn't allocate buffer");
+	/* Allocate buffers, one to read into while the other is
+	 * written. */
+	buffers[0] = palloc_get_multiple (PAL_ASSERT, FSUTIL_CHUNK_PAGES);
+	buffers[1] = palloc_get_multiple (PAL_ASSERT, FSUTIL_CHUNK_PAGES);
 
 	/* Open source disk and read file size. */
 	src = disk_get (1, 0);
@@ -103,25 +106,50 @@ fsutil_put (char **argv) {
 		PANIC ("couldn't open source disk (hdc or hd1:0)");
 
 	/* Read file size. */
-	disk_read (src, sector++, buffer);
-	if (memcmp (buffer, "PUT", 4))
+	disk_read (src, sector++, buffers[0]);
+	if (memcmp (buffers[0], "PUT", 4))
 		PANIC ("%s: missing PUT signature on scratch disk", file_name);
-	size = ((int32_t *) buffer)[1];
+	size = ((int32_t *) buffers[0])[1];
 	if (size < 0)
 		PANIC ("%s: invalid file size %d", file_name, size);
+	left = DIV_ROUND_UP (size, DISK_SECTOR_SIZE);
+	if (sector + left > disk_size (src))
+		PANIC ("%s: file runs past end of scratch disk", file_name);
 
-	/* Create destination file. */
-	if (!filesys_create (file_name, size))
+	/* Create destination file, with all of its sectors allocated up
+	 * front, as few runs as the disk allows. */
+	if (!filesys_create (file_name, 0))
 		PANIC ("%s: create failed", file_name);
 	dst = filesys_open (file_name);
 	if (dst == NULL)
 		PANIC ("%s: open failed", file_name);
-
-	/* Do copy. */
-	while (size > 0) {
-		int chunk_size = size > DISK_SECTOR_SIZE ? DISK_SECTOR_SIZE : size;
-		disk_read (src, sector++, buffer);
-		if (file_write (dst, buffer, chunk_size) != chunk_size)
+	if (size > 0 && !file_reserve (dst, 0, size))
+		PANIC ("%s: out of space for %"PROTd" bytes", file_name, size);
+
+	/* Do copy.  The scratch disk is on another channel from the
+	 * file system's disk, so the next chunk is read while this one
+	 * is written. */
+	sema_init (&done, 0);
+	for (i = 0; left > 0; i++) {
+		size_t cnt = left < FSUTIL_CHUNK_SECTORS ? left : FSUTIL_CHUNK_SECTORS;
+		off_t chunk_size = size < (off_t) (cnt * DISK_SECTOR_SIZE)
+			? size : (off_t) (cnt * DISK_SECTOR_SIZE);
+
+		if (i == 0) {
+			bio_init (&bio, src, sector, cnt, buffers[0], false, bio_signal,
+					&done);
+			disk_submit (&bio);
+		}
+		sema_down (&done);
+		sector += cnt;
+		left -= cnt;
+		if (left > 0) {
+			bio_init (&bio, src, sector, left < FSUTIL_CHUNK_SECTORS
+					? left : FSUTIL_CHUNK_SECTORS, buffers[(i + 1) % 2], false,
+					bio_signal, &done);
+			disk_submit (&bio);
+		}
+		if (file_write (dst, buffers[i % 2], chunk_size) != chunk_size)
 			PANIC ("%s: write failed with %"PROTd" bytes unwritten",
 					file_name, size);
 		size -= chunk_size;
@@ -129,7 +157,8 @@ fsutil_put (char **argv) {
 
 	/* Finish up. */
 	file_close (dst);
-	free (buffer);
+	palloc_free_multiple (buffers[0], FSUTIL_CHUNK_PAGES);
+	palloc_free_multiple (buffers[1], FSUTIL_CHUNK_PAGES);
 }
 
 /* Copies file FILE_NAME from the file system to the scratch disk.
@@ -148,7 +177,7 @@ fsutil_get (char **argv) {
 	static disk_sector_t sector = 0;
 
 	const char *file_name = argv[1];
-	void *buffer;
+	uint8_t *buffer;
 	struct file *src;
 	struct disk *dst;
 	off_t size;
@@ -156,9 +185,7 @@ fsutil_get (char **argv) {
 	printf ("Getting '%s' from the file system...\n", file_name);
 
 	/* Allocate buffer. */
-	buffer = malloc (DISK_SECTOR_SIZE);
-	if (buffer == NULL)
-		PANIC ("couldn't allocate buffer");
+	buffer = palloc_get_multiple (PAL_ASSERT, FSUTIL_CHUNK_PAGES);
 
 	/* Open source file. */
 	src = filesys_open (file_name);
@@ -179,17 +206,21 @@ fsutil_get (char **argv) {
 
 	/* Do copy. */
 	while (size > 0) {
-		int chunk_size = size > DISK_SECTOR_SIZE ? DISK_SECTOR_SIZE : size;
-		if (sector >= disk_size (dst))
+		off_t chunk_size = size > FSUTIL_CHUNK_SECTORS * DISK_SECTOR_SIZE
+			? FSUTIL_CHUNK_SECTORS * DISK_SECTOR_SIZE : size;
+		size_t cnt = DIV_ROUND_UP (chunk_size, DISK_SECTOR_SIZE);
+
+		if (sector + cnt > disk_size (dst))
 			PANIC ("%s: out of space on scratch disk", file_name);
 		if (file_read (src, buffer, chunk_size) != chunk_size)
 			PANIC ("%s: read failed with %"PROTd" bytes unread", file_name, size);
-		memset (buffer + chunk_size, 0, DISK_SECTOR_SIZE - chunk_size);
-		disk_write (dst, sector++, buffer);
+		memset (buffer + chunk_size, 0, cnt * DISK_SECTOR_SIZE - chunk_size);
+		disk_write_multiple (dst, sector, cnt, buffer);
+		sector += cnt;
 		size -= chunk_size;
 	}
 
 	/* Finish up. */
 	file_close (src);
-	free (buffer);
+	palloc_free_multiple (buffer, FSUTIL_CHUNK_PAGES);
 }
@@ -1,22 +1,100 @@
 #include "filesys/inode.h"
+#include <hash.h>
 #include <list.h>
+#include <ohash.h>
 #include <debug.h>
 #include <round.h>
 #include <string.h>
+#include <uio.h>
+#include "filesys/buffer_cache.h"
+#include "filesys/fat.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "filesys/journal.h"
+#include "filesys/mount.h"
 #include "threads/malloc.h"
+#include "threads/atomic.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#ifdef VM
+#include "vm/vm.h"
+#endif
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+#ifndef EFILESYS
+/* A run of consecutive sectors of a file's data, or a hole. */
+struct inode_extent {
+	disk_sector_t start;                /* First sector, or INODE_HOLE. */
+	uint32_t length;                    /* Number of sectors. */
+};
+
+/* START of an extent that is a hole: sectors of the file that have
+ * no disk sectors and read as zeros.  Sector 0 holds the free map's
+ * inode, so it is never file data. */
+#define INODE_HOLE 0
+
+/* Number of extents in the inode itself, in its indirect sector,
+ * and in all. */
+#define INODE_DIRECT_EXTENTS 61
+#define INODE_INDIRECT_EXTENTS \
+	(DISK_SECTOR_SIZE / sizeof (struct inode_extent))
+#define INODE_EXTENTS (INODE_DIRECT_EXTENTS + INODE_INDIRECT_EXTENTS)
+#endif
+
+/* Longest file whose data fits in the inode itself. */
+#define INODE_INLINE_MAX 492
+
+/* Inode flags. */
+#define INODE_INLINE 0x1                /* Data is in INLINE_DATA. */
+#define INODE_SYMLINK 0x2               /* Data is a symbolic link's target. */
+
 /* On-disk inode.
- * Must be exactly DISK_SECTOR_SIZE bytes long. */
+ * Must be exactly DISK_SECTOR_SIZE bytes long.
+ *
+ * A file of up to INODE_INLINE_MAX bytes keeps its data in the
+ * inode, so that it costs no sector of its own and is read along
+ * with the inode.  Every inode starts out so, and moves its data to
+ * sectors of its own when it grows past that.
+ *
+ * Otherwise, with FAT, the data is a cluster chain; without, it is
+ * a list of extents, in file order, the first INODE_DIRECT_EXTENTS
+ * of them here and the rest in the INDIRECT sector.  Sectors are
+ * allocated as a file grows, as few runs as possible for each
+ * write.  An inline inode has no chain, or no extents.
+ *
+ * Without FAT, a file may have holes: whole sectors that a write
+ * past end of file, or inode_create(), skipped over are an extent
+ * with no disk sectors, which reads as zeros, until they are first
+ * written.  A FAT chain has no way to leave a cluster out, so with
+ * FAT the sectors are allocated all the same.
+ *
+ * Sectors are allocated without being written.  Only the first
+ * VALID_LENGTH bytes of the file have ever been written; the rest,
+ * up to LENGTH, read as zeros without touching the disk, and a write
+ * past VALID_LENGTH zeros the sectors between first.  A file that
+ * grows by appending, or into space reserved by inode_reserve(), so
+ * never writes a sector twice.  VALID_LENGTH is LENGTH for an inline
+ * inode. */
 struct inode_disk {
-	disk_sector_t start;                /* First data sector. */
 	off_t length;                       /* File size in bytes. */
+	off_t valid_length;                 /* Bytes written from the start. */
 	unsigned magic;                     /* Magic number. */
-	uint32_t unused[125];               /* Not used. */
+#ifdef EFILESYS
+	cluster_t start;                    /* First data cluster, or 0. */
+	uint16_t unused;                    /* Not used. */
+#else
+	disk_sector_t indirect;             /* Sector of more extents, or 0. */
+	uint16_t extent_cnt;                /* Number of extents in use. */
+#endif
+	uint16_t flags;                     /* INODE_* flags. */
+	union {
+#ifndef EFILESYS
+		struct inode_extent extents[INODE_DIRECT_EXTENTS]; /* Extents. */
+#endif
+		uint8_t inline_data[INODE_INLINE_MAX]; /* Data, if INODE_INLINE. */
+	};
 };
 
 /* Returns the number of sectors to allocate for an inode SIZE
@@ -26,46 +104,647 @@ bytes_to_sectors (off_t size) {
 	return DIV_ROUND_UP (size, DISK_SECTOR_SIZE);
 }
 
-/* In-memory inode. */
+/* In-memory inode.
+ *
+ * RW covers DATA and the layout of the file's sectors.  Reading and
+ * writing within the file share it; growing the file takes it
+ * exclusively.  It is held only around the inode's own data and the
+ * buffer cache, never while frame_lock is taken, since whoever holds
+ * frame_lock may need RW to write back a mapped page of the file.
+ *
+ * LOCK covers DENY_WRITE_CNT and REMOVED, and is lent to the user of
+ * the inode through inode_lock(); the directory layer holds it
+ * around each operation on a directory's entries.
+ *
+ * The inode sector itself, and the data of a META inode, a directory
+ * or the free map, are written as metadata, which goes through the
+ * journal.
+ *
+ * OWNER lists the data sectors the inode has dirty in the buffer
+ * cache, for inode_sync().  SYNCED is false once the on-disk inode
+ * has changed since the last inode_sync(). */
 struct inode {
-	struct list_elem elem;              /* Element in inode list. */
+	struct ohash_elem elem;             /* Element in open_inodes. */
+	struct list_elem lru_elem;          /* Element in closed_inodes. */
+	struct mount *mnt;                  /* Mount the inode is on. */
 	disk_sector_t sector;               /* Sector number of disk location. */
 	int open_cnt;                       /* Number of openers. */
 	bool removed;                       /* True if deleted, false otherwise. */
+	bool meta;                          /* Data is metadata? */
 	int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+	struct lock lock;                   /* Metadata; see above. */
+	struct rwlock rw;                   /* Data; see above. */
 	struct inode_disk data;             /* Inode content. */
+	struct bc_owner owner;              /* Dirty sectors in the cache. */
+	bool synced;                        /* On-disk inode synced? */
+#ifdef EFILESYS
+	struct fat_map map;                 /* Clusters of the data. */
+#else
+	struct inode_extent *indirect;      /* Indirect extents, or NULL. */
+#endif
 };
 
+#ifndef EFILESYS
+/* Returns extent I of INODE. */
+static struct inode_extent *
+extent_at (struct inode *inode, size_t i) {
+	ASSERT (i < INODE_EXTENTS);
+	if (i < INODE_DIRECT_EXTENTS)
+		return &inode->data.extents[i];
+	ASSERT (inode->indirect != NULL);
+	return &inode->indirect[i - INODE_DIRECT_EXTENTS];
+}
+#endif
+
+/* Returns true if INODE's data is in the inode itself. */
+static inline bool
+inode_is_inline (const struct inode *inode) {
+	return (inode->data.flags & INODE_INLINE) != 0;
+}
+
+/* Returns the disk sector that holds sector IDX of INODE's data,
+ * or -1 if none has been allocated, whatever the length of INODE.
+ * If RUN_LEFT is nonnull, also stores in it how many sectors,
+ * that one included, follow it on disk in INODE, or, if IDX is in a
+ * hole, how many of the hole's sectors are left from IDX. */
+static disk_sector_t
+index_to_sector (struct inode *inode, size_t idx, size_t *run_left) {
+#ifdef EFILESYS
+	uint32_t left;
+	cluster_t clst = fat_map_lookup (&inode->map, idx / SECTORS_PER_CLUSTER,
+			&left);
+
+	if (clst == 0)
+		return -1;
+	if (run_left != NULL)
+		*run_left = left * SECTORS_PER_CLUSTER - idx % SECTORS_PER_CLUSTER;
+	return cluster_to_sector (inode->mnt, clst) + idx % SECTORS_PER_CLUSTER;
+#else
+	for (size_t i = 0; i < inode->data.extent_cnt; i++) {
+		struct inode_extent *e = extent_at (inode, i);
+
+		if (idx < e->length) {
+			if (run_left != NULL)
+				*run_left = e->length - idx;
+			return e->start != INODE_HOLE ? e->start + idx : (disk_sector_t) -1;
+		}
+		idx -= e->length;
+	}
+	return -1;
+#endif
+}
+
 /* Returns the disk sector that contains byte offset POS within
  * INODE.
  * Returns -1 if INODE does not contain data for a byte at offset
- * POS. */
+ * POS.
+ * If RUN_LEFT is nonnull, also stores in it how many sectors,
+ * that one included, follow it on disk in INODE. */
 static disk_sector_t
-byte_to_sector (const struct inode *inode, off_t pos) {
+byte_to_sector (struct inode *inode, off_t pos, size_t *run_left) {
 	ASSERT (inode != NULL);
-	if (pos < inode->data.length)
-		return inode->data.start + pos / DISK_SECTOR_SIZE;
-	else
+	if (pos >= inode->data.length)
 		return -1;
+	return index_to_sector (inode, pos / DISK_SECTOR_SIZE, run_left);
+}
+
+/* Writes INODE's on-disk inode, and its indirect extents if any. */
+static void
+inode_save (struct inode *inode) {
+	inode->synced = false;
+	buffer_cache_write_meta (inode->mnt, inode->sector, &inode->data, 0,
+			DISK_SECTOR_SIZE, &inode->owner);
+#ifndef EFILESYS
+	if (inode->indirect != NULL)
+		buffer_cache_write_meta (inode->mnt, inode->data.indirect,
+				inode->indirect, 0, DISK_SECTOR_SIZE, &inode->owner);
+#endif
+}
+
+/* Writes SIZE bytes from BUFFER at offset OFS in SECTOR, which holds
+ * data of INODE, as metadata if INODE's data is metadata. */
+static void
+write_sector (struct inode *inode, disk_sector_t sector, const void *buffer,
+		off_t ofs, size_t size) {
+	if (inode->meta)
+		buffer_cache_write_meta (inode->mnt, sector, buffer, ofs, size,
+				&inode->owner);
+	else
+		buffer_cache_write (inode->mnt, sector, buffer, ofs, size,
+				&inode->owner);
+}
+
+#ifndef EFILESYS
+/* Makes sure INODE has room for CNT extents, allocating its indirect
+ * sector if need be.  Returns false if it cannot. */
+static bool
+reserve_extents (struct inode *inode, size_t cnt) {
+	if (cnt > INODE_EXTENTS)
+		return false;
+	if (cnt > INODE_DIRECT_EXTENTS && inode->indirect == NULL) {
+		inode->indirect = calloc (1, DISK_SECTOR_SIZE);
+		if (inode->indirect == NULL)
+			return false;
+		if (!free_map_allocate (inode->mnt, 1, inode->sector,
+					&inode->data.indirect)) {
+			free (inode->indirect);
+			inode->indirect = NULL;
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Returns true if extent B continues extent A: both holes, or both
+ * data with B's sectors right after A's. */
+static bool
+extent_continues (const struct inode_extent *a, const struct inode_extent *b) {
+	if (a->start == INODE_HOLE || b->start == INODE_HOLE)
+		return a->start == b->start;
+	return a->start + a->length == b->start;
+}
+
+/* Appends the CNT sectors from START, or a hole of CNT sectors if
+ * START is INODE_HOLE, to INODE's extents.  Returns false if there
+ * is no room for another extent. */
+static bool
+add_extent (struct inode *inode, disk_sector_t start, size_t cnt) {
+	size_t n = inode->data.extent_cnt;
+	struct inode_extent *last = n > 0 ? extent_at (inode, n - 1) : NULL;
+	struct inode_extent e = { .start = start, .length = cnt };
+
+	if (last != NULL && extent_continues (last, &e)) {
+		last->length += cnt;
+		return true;
+	}
+	if (!reserve_extents (inode, n + 1))
+		return false;
+	*extent_at (inode, n) = e;
+	inode->data.extent_cnt++;
+	return true;
 }
 
-/* List of open inodes, so that opening a single inode twice
- * returns the same `struct inode'. */
-static struct list open_inodes;
+/* Replaces extent I of INODE, a hole, by the CNT sectors from START
+ * at LEFT sectors into it, and what is left of the hole on either
+ * side, merging the new sectors with the extents next to them where
+ * they continue each other.  Returns false, changing nothing, if
+ * there is no room for the extents. */
+static bool
+split_hole (struct inode *inode, size_t i, size_t left, disk_sector_t start,
+		size_t cnt) {
+	struct inode_extent hole = *extent_at (inode, i);
+	struct inode_extent parts[3];
+	size_t part_cnt = 0, n = inode->data.extent_cnt, j;
+
+	ASSERT (hole.start == INODE_HOLE && left + cnt <= hole.length);
+	if (left > 0)
+		parts[part_cnt++] = (struct inode_extent) { INODE_HOLE, left };
+	parts[part_cnt++] = (struct inode_extent) { start, cnt };
+	if (left + cnt < hole.length)
+		parts[part_cnt++] = (struct inode_extent) {
+			INODE_HOLE, hole.length - left - cnt };
+	if (!reserve_extents (inode, n + part_cnt - 1))
+		return false;
+
+	/* Make room and put the parts in place of the hole. */
+	for (j = n; j-- > i + 1; )
+		*extent_at (inode, j + part_cnt - 1) = *extent_at (inode, j);
+	for (j = 0; j < part_cnt; j++)
+		*extent_at (inode, i + j) = parts[j];
+	n += part_cnt - 1;
+
+	/* Merge neighbours that continue each other, around the parts. */
+	j = i > 0 ? i - 1 : 0;
+	while (j + 1 < n && j < i + part_cnt) {
+		struct inode_extent *a = extent_at (inode, j);
+		struct inode_extent *b = extent_at (inode, j + 1);
+
+		if (extent_continues (a, b)) {
+			a->length += b->length;
+			for (size_t k = j + 1; k + 1 < n; k++)
+				*extent_at (inode, k) = *extent_at (inode, k + 1);
+			n--;
+		} else
+			j++;
+	}
+	inode->data.extent_cnt = n;
+	return true;
+}
+
+/* Frees the sectors of INODE's data after the first KEEP, and the
+ * indirect sector if it is no longer needed. */
+static void
+release_sectors (struct inode *inode, size_t keep) {
+	size_t pos = 0, cnt = 0;
+
+	for (size_t i = 0; i < inode->data.extent_cnt; i++) {
+		struct inode_extent *e = extent_at (inode, i);
+		size_t kept = keep > pos ? keep - pos : 0;
+
+		pos += e->length;
+		if (kept < e->length) {
+			if (e->start != INODE_HOLE)
+				free_map_release (inode->mnt, e->start + kept,
+						e->length - kept);
+			e->length = kept;
+		}
+		if (e->length > 0)
+			cnt = i + 1;
+	}
+	inode->data.extent_cnt = cnt;
+	if (cnt <= INODE_DIRECT_EXTENTS && inode->indirect != NULL) {
+		free_map_release (inode->mnt, inode->data.indirect, 1);
+		inode->data.indirect = 0;
+		free (inode->indirect);
+		inode->indirect = NULL;
+	}
+}
+
+/* Allocates up to *CNT consecutive sectors for INODE, preferably
+ * starting at HINT, if HINT is not INODE_HOLE, or else near it or
+ * the inode itself, and stores the first in *START and how many
+ * there are in *CNT.  Returns false if the disk is full. */
+static bool
+allocate_run (struct inode *inode, disk_sector_t hint, size_t *cnt,
+		disk_sector_t *start) {
+	disk_sector_t near = hint != INODE_HOLE ? hint : inode->sector;
+
+	if (hint != INODE_HOLE && free_map_allocate_at (inode->mnt, hint, *cnt)) {
+		*start = hint;
+		return true;
+	}
+	while (*cnt > 0 && !free_map_allocate (inode->mnt, *cnt, near, start))
+		*cnt /= 2;
+	return *cnt > 0;
+}
+#endif
+
+/* Allocates CNT more sectors at the end of INODE's data, after a
+ * hole of HOLE_CNT sectors; with FAT, the hole is allocated too.
+ * Returns true if successful, false, having allocated nothing, if
+ * the disk is full. */
+static bool
+allocate_sectors (struct inode *inode, size_t hole_cnt, size_t cnt) {
+	size_t have = bytes_to_sectors (inode->data.length);
+#ifdef EFILESYS
+	cnt += hole_cnt;
+	size_t clst_have = DIV_ROUND_UP (have, SECTORS_PER_CLUSTER);
+	size_t clst_want = DIV_ROUND_UP (have + cnt, SECTORS_PER_CLUSTER);
+	cluster_t last = clst_have > 0
+		? fat_map_lookup (&inode->map, clst_have - 1, NULL) : 0;
+	cluster_t first = 0, clst = last;
+
+	/* fat_create_chain() puts each cluster right after the one
+	 * before if it can. */
+	for (; clst_have < clst_want; clst_have++) {
+		clst = fat_create_chain (inode->mnt, clst);
+		if (clst == 0) {
+			if (first != 0)
+				fat_remove_chain (inode->mnt, first, last);
+			return false;
+		}
+		if (first == 0)
+			first = clst;
+	}
+	if (inode->data.start == 0 && first != 0) {
+		inode->data.start = first;
+		fat_map_reset (&inode->map, first);
+	}
+	return true;
+#else
+	if (hole_cnt > 0 && !add_extent (inode, INODE_HOLE, hole_cnt))
+		goto fail;
+	while (cnt > 0) {
+		size_t n = inode->data.extent_cnt;
+		struct inode_extent *last = n > 0 ? extent_at (inode, n - 1) : NULL;
+		size_t chunk = cnt;
+		disk_sector_t start;
+
+		/* Best is to extend the last extent in place; next best, one
+		 * new extent for all of it; failing that, a few smaller ones. */
+		if (!allocate_run (inode, last != NULL && last->start != INODE_HOLE
+					? last->start + last->length : INODE_HOLE, &chunk, &start))
+			goto fail;
+		if (!add_extent (inode, start, chunk)) {
+			free_map_release (inode->mnt, start, chunk);
+			goto fail;
+		}
+		cnt -= chunk;
+	}
+	return true;
+
+fail:
+	release_sectors (inode, have);
+	return false;
+#endif
+}
+
+/* Frees the data and the inode sector of INODE. */
+static void
+release_blocks (struct inode *inode) {
+#ifdef EFILESYS
+	fat_remove_chain (inode->mnt, sector_to_cluster (inode->mnt, inode->sector),
+			0);
+	if (inode->data.start != 0)
+		fat_remove_chain (inode->mnt, inode->data.start, 0);
+#else
+	free_map_release (inode->mnt, inode->sector, 1);
+	release_sectors (inode, 0);
+#endif
+}
+
+static bool inode_extend (struct inode *, off_t length, off_t hole_to);
+
+/* A sector of zeros. */
+static const char zeros[DISK_SECTOR_SIZE];
+
+/* Moves the data of inline INODE to sectors of its own.  Returns
+ * false, leaving INODE as it was, if memory or the disk is short. */
+static bool
+inode_uninline (struct inode *inode) {
+	struct inode_disk *old = malloc (sizeof *old);
+	off_t length = inode->data.length;
+
+	if (old == NULL)
+		return false;
+	*old = inode->data;
+	memset (inode->data.inline_data, 0, sizeof inode->data.inline_data);
+	inode->data.flags &= ~INODE_INLINE;
+	inode->data.length = inode->data.valid_length = 0;
+	if (!inode_extend (inode, length, 0)) {
+		inode->data = *old;
+		free (old);
+		return false;
+	}
+	for (off_t pos = 0; pos < length; pos += DISK_SECTOR_SIZE)
+		write_sector (inode, byte_to_sector (inode, pos, NULL),
+				old->inline_data + pos, 0,
+				length - pos < DISK_SECTOR_SIZE ? length - pos : DISK_SECTOR_SIZE);
+	inode->data.valid_length = length;
+	inode_save (inode);
+	free (old);
+	return true;
+}
+
+/* Grows INODE to LENGTH bytes, if it is shorter.  The new sectors
+ * are allocated but not written: they lie past the valid length, so
+ * they read as zeros.  The new sectors that lie wholly before byte
+ * HOLE_TO are left as a hole instead, where INODE can have one and
+ * has room for its extents.
+ * Returns false, leaving INODE as it was, if the disk is full.  The
+ * caller must hold INODE's RW for writing. */
+static bool
+inode_extend (struct inode *inode, off_t length, off_t hole_to UNUSED) {
+	size_t have, want, hole_cnt = 0;
+
+	ASSERT (rwlock_write_held_by_current_thread (&inode->rw));
+	if (length <= inode->data.length)
+		return true;
+	if (inode_is_inline (inode)) {
+		/* Bytes past the end of inline data are always zero. */
+		if (length <= INODE_INLINE_MAX) {
+			inode->data.length = inode->data.valid_length = length;
+			inode_save (inode);
+			return true;
+		}
+		if (!inode_uninline (inode))
+			return false;
+	}
+
+	have = bytes_to_sectors (inode->data.length);
+	want = bytes_to_sectors (length);
+#ifndef EFILESYS
+	if ((size_t) hole_to / DISK_SECTOR_SIZE > have)
+		hole_cnt = hole_to / DISK_SECTOR_SIZE - have;
+	if (hole_cnt > want - have)
+		hole_cnt = want - have;
+#endif
+	if (want > have
+			&& !allocate_sectors (inode, hole_cnt, want - have - hole_cnt)
+			&& (hole_cnt == 0 || !allocate_sectors (inode, 0, want - have)))
+		return false;
+	inode->data.length = length;
+	inode_save (inode);
+	return true;
+}
+
+/* Writes zeros over the bytes of INODE from FROM up to TO, which lie
+ * within INODE, except where they are in a hole already. */
+static void
+zero_range (struct inode *inode, off_t from, off_t to) {
+	while (from < to) {
+		int sector_ofs = from % DISK_SECTOR_SIZE;
+		int chunk = DISK_SECTOR_SIZE - sector_ofs;
+		disk_sector_t sector = byte_to_sector (inode, from, NULL);
+
+		if (chunk > to - from)
+			chunk = to - from;
+		if (sector != (disk_sector_t) -1)
+			buffer_cache_write (inode->mnt, sector, zeros, sector_ofs, chunk,
+					&inode->owner);
+		from += chunk;
+	}
+}
+
+/* Returns true if some byte from FROM up to TO of INODE is in a
+ * hole. */
+static bool
+range_has_hole (struct inode *inode UNUSED, off_t from UNUSED,
+		off_t to UNUSED) {
+#ifndef EFILESYS
+	size_t first = from / DISK_SECTOR_SIZE;
+	size_t end = DIV_ROUND_UP (to, DISK_SECTOR_SIZE);
+	size_t pos = 0;
+
+	for (size_t i = 0; i < inode->data.extent_cnt && pos < end; i++) {
+		struct inode_extent *e = extent_at (inode, i);
+
+		if (e->start == INODE_HOLE && pos + e->length > first)
+			return true;
+		pos += e->length;
+	}
+#endif
+	return false;
+}
+
+/* Allocates sectors for the holes from byte FROM up to TO of INODE.
+ * Those below the valid length are zeroed, except those wholly from
+ * WRITE_OFS up to WRITE_END, which the caller is about to write.
+ * Returns false, having filled some of the holes perhaps, if the
+ * disk or INODE's extents are full.  The caller must hold INODE's
+ * RW for writing. */
+static bool
+fill_holes (struct inode *inode UNUSED, off_t from UNUSED, off_t to UNUSED,
+		off_t write_ofs UNUSED, off_t write_end UNUSED) {
+#ifndef EFILESYS
+	size_t first = from / DISK_SECTOR_SIZE;
+	size_t end = DIV_ROUND_UP (to, DISK_SECTOR_SIZE);
+
+	for (;;) {
+		struct inode_extent *e = NULL, *prev = NULL;
+		size_t i, pos = 0, lo, cnt;
+		disk_sector_t hint = INODE_HOLE, start;
+
+		/* Find the first hole in the range. */
+		for (i = 0; i < inode->data.extent_cnt && pos < end; i++) {
+			e = extent_at (inode, i);
+			if (e->start == INODE_HOLE && pos + e->length > first)
+				break;
+			prev = e;
+			pos += e->length;
+		}
+		if (i == inode->data.extent_cnt || pos >= end)
+			return true;
+
+		/* Fill as much of it as one run of sectors allows, where the
+		 * sectors would be if the hole had been written along with the
+		 * sectors before it, if it can.  If splitting the hole would
+		 * take more extents than INODE has room for, fill all of it. */
+		lo = pos > first ? pos : first;
+		cnt = (pos + e->length < end ? pos + e->length : end) - lo;
+		if (!reserve_extents (inode, inode->data.extent_cnt
+					+ (lo > pos) + (lo + cnt < pos + e->length))) {
+			lo = pos;
+			cnt = e->length;
+		}
+		if (prev != NULL && prev->start != INODE_HOLE)
+			hint = prev->start + prev->length + (lo - pos);
+		if (!allocate_run (inode, hint, &cnt, &start))
+			return false;
+		for (size_t k = 0; k < cnt; k++) {
+			off_t p = (lo + k) * DISK_SECTOR_SIZE;
+
+			if (p < inode->data.valid_length
+					&& (p < write_ofs || p + DISK_SECTOR_SIZE > write_end))
+				buffer_cache_write (inode->mnt, start + k, zeros, 0,
+						DISK_SECTOR_SIZE, &inode->owner);
+		}
+		if (!split_hole (inode, i, lo - pos, start, cnt)) {
+			free_map_release (inode->mnt, start, cnt);
+			return false;
+		}
+	}
+#else
+	return true;
+#endif
+}
+
+/* Open inodes, by mount and sector, so that opening a single inode twice
+ * returns the same `struct inode'.  The table also holds up to
+ * INODE_CLOSED_MAX inodes that were closed recently, with open_cnt
+ * 0, so that opening one of them again needs no disk read; they are
+ * on closed_inodes, least recently closed first, and the oldest is
+ * freed to make room.  An inode that was removed is never kept. */
+static struct ohash open_inodes;
+static struct list closed_inodes;
+static size_t closed_cnt;
+#define INODE_CLOSED_MAX 32
+
+/* Protects open_inodes and closed_inodes.  Lookups of an already
+ * open inode only read the table, so they share the lock; anything
+ * else takes it exclusively.  open_cnt is changed atomically so
+ * that readers can bump it. */
+static struct rwlock open_inodes_lock;
+
+static struct inode *open_inodes_lookup (struct mount *, disk_sector_t);
+static struct inode *open_inodes_find (struct mount *, disk_sector_t,
+		bool exclusive);
+static void inode_free (struct inode *);
+
+/* Allocator for struct inode. */
+static struct kmem_cache *inode_cache;
+
+/* Returns the hash of inode E. */
+static uint64_t
+inode_hash (const struct ohash_elem *e, void *aux UNUSED) {
+	const struct inode *inode = ohash_entry (e, struct inode, elem);
+	return hash_u64 (inode->sector) ^ hash_ptr (inode->mnt);
+}
+
+/* Returns true if inode A orders before inode B, by mount and then
+ * by sector. */
+static bool
+inode_less (const struct ohash_elem *a_, const struct ohash_elem *b_,
+		void *aux UNUSED) {
+	const struct inode *a = ohash_entry (a_, struct inode, elem);
+	const struct inode *b = ohash_entry (b_, struct inode, elem);
+
+	if (a->mnt != b->mnt)
+		return a->mnt < b->mnt;
+	return a->sector < b->sector;
+}
 
 /* Initializes the inode module. */
 void
 inode_init (void) {
-	list_init (&open_inodes);
+	if (!ohash_init (&open_inodes, inode_hash, inode_less, NULL))
+		PANIC ("inode_init: out of memory");
+	list_init (&closed_inodes);
+	rwlock_init (&open_inodes_lock);
+	inode_cache = kmem_cache_create ("inode", sizeof (struct inode),
+			0, NULL);
+}
+
+/* Returns the inode for SECTOR of MNT in open_inodes, open or
+ * recently closed, or a null pointer if there is none.
+ * open_inodes_lock must be held. */
+static struct inode *
+open_inodes_lookup (struct mount *mnt, disk_sector_t sector) {
+	struct inode key;
+	struct ohash_elem *e;
+
+	key.mnt = mnt;
+	key.sector = sector;
+	e = ohash_find (&open_inodes, &key.elem);
+	return e != NULL ? ohash_entry (e, struct inode, elem) : NULL;
+}
+
+/* Returns the open inode for SECTOR of MNT, reopened, or a null
+ * pointer if it is not open.  open_inodes_lock must be held,
+ * EXCLUSIVE if held for writing; only then is a recently closed
+ * inode reopened too. */
+static struct inode *
+open_inodes_find (struct mount *mnt, disk_sector_t sector, bool exclusive) {
+	struct inode *inode = open_inodes_lookup (mnt, sector);
+
+	if (inode == NULL)
+		return NULL;
+	if (inode->open_cnt == 0) {
+		if (!exclusive)
+			return NULL;
+		list_remove (&inode->lru_elem);
+		closed_cnt--;
+	}
+	return inode_reopen (inode);
+}
+
+/* Frees recently closed inode for SECTOR of MNT, if there is one,
+ * because SECTOR is about to hold a new inode. */
+static void
+open_inodes_forget (struct mount *mnt, disk_sector_t sector) {
+	struct inode *inode;
+
+	rwlock_acquire_write (&open_inodes_lock);
+	inode = open_inodes_lookup (mnt, sector);
+	if (inode != NULL && inode->open_cnt == 0) {
+		list_remove (&inode->lru_elem);
+		closed_cnt--;
+		ohash_delete (&open_inodes, &inode->elem);
+	} else
+		inode = NULL;
+	rwlock_release_write (&open_inodes_lock);
+	if (inode != NULL)
+		inode_free (inode);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
- * writes the new inode to sector SECTOR on the file system
- * disk.
+ * writes the new inode to sector SECTOR on the disk of MNT.
+ * The data reads as zeros, and is a hole where the inode
+ * can have one.
  * Returns true if successful.
  * Returns false if memory or disk allocation fails. */
 bool
-inode_create (disk_sector_t sector, off_t length) {
+inode_create (struct mount *mnt, disk_sector_t sector, off_t length) {
 	struct inode_disk *disk_inode = NULL;
 	bool success = false;
 
@@ -75,60 +754,143 @@ inode_create (disk_sector_t sector, off_t length) {
 	 * one sector in size, and you should fix that. */
 	ASSERT (sizeof *disk_inode == DISK_SECTOR_SIZE);
 
+	/* A sector freed since its inode was last closed is reused. */
+	open_inodes_forget (mnt, sector);
+
 	disk_inode = calloc (1, sizeof *disk_inode);
 	if (disk_inode != NULL) {
-		size_t sectors = bytes_to_sectors (length);
-		disk_inode->length = length;
+		/* Write an empty inode, then grow it like any file. */
+		disk_inode->length = 0;
 		disk_inode->magic = INODE_MAGIC;
-		if (free_map_allocate (sectors, &disk_inode->start)) {
-			disk_write (filesys_disk, sector, disk_inode);
-			if (sectors > 0) {
-				static char zeros[DISK_SECTOR_SIZE];
-				size_t i;
-
-				for (i = 0; i < sectors; i++) 
-					disk_write (filesys_disk, disk_inode->start + i, zeros); 
-			}
-			success = true; 
-		} 
+		disk_inode->flags = INODE_INLINE;
+		buffer_cache_write_meta (mnt, sector, disk_inode, 0, DISK_SECTOR_SIZE,
+				NULL);
 		free (disk_inode);
+
+		success = true;
+		if (length > 0) {
+			struct inode *inode = inode_open (mnt, sector);
+
+			success = false;
+			if (inode != NULL) {
+				rwlock_acquire_write (&inode->rw);
+				success = inode_extend (inode, length, length);
+				rwlock_release_write (&inode->rw);
+			}
+			inode_close (inode);
+		}
 	}
 	return success;
 }
 
-/* Reads an inode from SECTOR
+/* Writes a symbolic link to TARGET, a null-terminated string of
+ * at most SYMLINK_MAX bytes, as the inode at SECTOR of MNT.  The target
+ * is kept inline, so that following the link costs no read beyond
+ * the inode's own sector once it is open.  Returns true if
+ * successful, false if memory allocation fails. */
+bool
+inode_create_symlink (struct mount *mnt, disk_sector_t sector,
+		const char *target) {
+	struct inode_disk *disk_inode;
+	size_t length = strlen (target);
+
+	ASSERT (length <= SYMLINK_MAX);
+	ASSERT (SYMLINK_MAX < INODE_INLINE_MAX);
+
+	open_inodes_forget (mnt, sector);
+
+	disk_inode = calloc (1, sizeof *disk_inode);
+	if (disk_inode == NULL)
+		return false;
+	disk_inode->length = disk_inode->valid_length = length;
+	disk_inode->magic = INODE_MAGIC;
+	disk_inode->flags = INODE_INLINE | INODE_SYMLINK;
+	memcpy (disk_inode->inline_data, target, length);
+	buffer_cache_write_meta (mnt, sector, disk_inode, 0, DISK_SECTOR_SIZE,
+			NULL);
+	free (disk_inode);
+	return true;
+}
+
+/* Returns true if INODE is a symbolic link. */
+bool
+inode_is_symlink (const struct inode *inode) {
+	return (inode->data.flags & INODE_SYMLINK) != 0;
+}
+
+/* Returns the target of symbolic link INODE, which stays valid
+ * while INODE is open.  A link is never written after it is
+ * created, and its target is null-padded in the inode, so this
+ * needs no lock and no copy. */
+const char *
+inode_symlink_target (const struct inode *inode) {
+	ASSERT (inode_is_symlink (inode));
+
+	return (const char *) inode->data.inline_data;
+}
+
+/* Reads an inode from SECTOR of MNT
  * and returns a `struct inode' that contains it.
  * Returns a null pointer if memory allocation fails. */
 /* 해당 SECTOR에서 inode 읽고 inode 구조체 반환 */
 struct inode *
-inode_open (disk_sector_t sector) {
-	struct list_elem *e;
+inode_open (struct mount *mnt, disk_sector_t sector) {
 	struct inode *inode;
 
 	/* Check whether this inode is already open. */
 	/* inode가 이미 열려 있다면 그걸 다시 reopen 해줌 */
-	for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-			e = list_next (e)) {
-		inode = list_entry (e, struct inode, elem);
-		if (inode->sector == sector) {
-			inode_reopen (inode);
-			return inode; 
-		}
-	}
+	rwlock_acquire_read (&open_inodes_lock);
+	inode = open_inodes_find (mnt, sector, false);
+	rwlock_release_read (&open_inodes_lock);
+	if (inode != NULL)
+		return inode;
+
+	/* Someone may have opened it between the two locks, so look
+	 * again before adding it.  This time a recently closed inode
+	 * counts too. */
+	rwlock_acquire_write (&open_inodes_lock);
+	inode = open_inodes_find (mnt, sector, true);
+	if (inode != NULL)
+		goto done;
 
 	/* Allocate memory. */
 	/* 해당 섹터에 찾고자 하는 inode 없을 경우 inode를 새로 만들어줌 */
-	inode = malloc (sizeof *inode); // 커널 메모리 영역에 inode를 위한 공간 할당
+	inode = kmem_cache_alloc (inode_cache); // 커널 메모리 영역에 inode를 위한 공간 할당
 	if (inode == NULL)
-		return NULL;
+		goto done;
 
 	/* Initialize. */
-	list_push_front (&open_inodes, &inode->elem);
+	inode->mnt = mnt;
 	inode->sector = sector;
 	inode->open_cnt = 1;
 	inode->deny_write_cnt = 0;
 	inode->removed = false;
-	disk_read (filesys_disk, inode->sector, &inode->data);
+	inode->meta = false;
+	inode->synced = true;
+	buffer_cache_owner_init (&inode->owner);
+	lock_init (&inode->lock);
+	rwlock_init (&inode->rw);
+	buffer_cache_read_meta (mnt, inode->sector, &inode->data, 0,
+			DISK_SECTOR_SIZE);
+#ifdef EFILESYS
+	fat_map_init (&inode->map, mnt, inode->data.start);
+#else
+	inode->indirect = NULL;
+	if (inode->data.indirect != 0) {
+		inode->indirect = malloc (DISK_SECTOR_SIZE);
+		if (inode->indirect == NULL) {
+			kmem_cache_free (inode_cache, inode);
+			inode = NULL;
+			goto done;
+		}
+		buffer_cache_read_meta (mnt, inode->data.indirect, inode->indirect, 0,
+				DISK_SECTOR_SIZE);
+	}
+#endif
+	ohash_insert (&open_inodes, &inode->elem);
+
+done:
+	rwlock_release_write (&open_inodes_lock);
 	return inode;
 }
 
@@ -136,7 +898,7 @@ inode_open (disk_sector_t sector) {
 struct inode *
 inode_reopen (struct inode *inode) {
 	if (inode != NULL)
-		inode->open_cnt++;
+		atomic_fetch_add (&inode->open_cnt, 1);
 	return inode;
 }
 
@@ -146,6 +908,19 @@ inode_get_inumber (const struct inode *inode) {
 	return inode->sector;
 }
 
+/* Returns the mount INODE is on. */
+struct mount *
+inode_get_mount (const struct inode *inode) {
+	return inode->mnt;
+}
+
+/* Marks INODE's data as metadata, which is journaled.  Called for
+ * directories and the free map. */
+void
+inode_set_meta (struct inode *inode) {
+	inode->meta = true;
+}
+
 /* Closes INODE and writes it to disk.
  * If this was the last reference to INODE, frees its memory.
  * If INODE was also a removed inode, frees its blocks. */
@@ -155,20 +930,74 @@ inode_close (struct inode *inode) {
 	if (inode == NULL)
 		return;
 
-	/* Release resources if this was the last opener. */
-	if (--inode->open_cnt == 0) {
-		/* Remove from inode list and release lock. */
-		list_remove (&inode->elem);
+	/* Release resources if this was the last opener.  The count is
+	 * dropped under the write lock so that no lookup can reopen the
+	 * inode while it is being torn down. */
+	rwlock_acquire_write (&open_inodes_lock);
+	if (atomic_fetch_add (&inode->open_cnt, -1) == 1) {
+		struct inode *victim = NULL;
 
-		/* Deallocate blocks if removed. */
 		if (inode->removed) {
-			free_map_release (inode->sector, 1);
-			free_map_release (inode->data.start,
-					bytes_to_sectors (inode->data.length)); 
+			/* Remove from inode table and release lock. */
+			ohash_delete (&open_inodes, &inode->elem);
+			victim = inode;
+		} else {
+			/* Keep it around, in place of the oldest one kept. */
+			list_push_back (&closed_inodes, &inode->lru_elem);
+			if (++closed_cnt > INODE_CLOSED_MAX) {
+				victim = list_entry (list_pop_front (&closed_inodes),
+						struct inode, lru_elem);
+				closed_cnt--;
+				ohash_delete (&open_inodes, &victim->elem);
+			}
 		}
+		rwlock_release_write (&open_inodes_lock);
+
+		/* Deallocate blocks if removed. */
+		if (inode->removed)
+			release_blocks (inode);
+		if (victim != NULL)
+			inode_free (victim);
+	} else
+		rwlock_release_write (&open_inodes_lock);
+}
 
-		free (inode); 
+/* Frees the recently closed inodes of MNT, which is being
+ * unmounted. */
+void
+inode_unmount (struct mount *mnt) {
+	struct list victims;
+
+	list_init (&victims);
+	rwlock_acquire_write (&open_inodes_lock);
+	for (struct list_elem *e = list_begin (&closed_inodes);
+			e != list_end (&closed_inodes); ) {
+		struct inode *inode = list_entry (e, struct inode, lru_elem);
+
+		e = list_next (e);
+		if (inode->mnt != mnt)
+			continue;
+		list_remove (&inode->lru_elem);
+		closed_cnt--;
+		ohash_delete (&open_inodes, &inode->elem);
+		list_push_back (&victims, &inode->lru_elem);
 	}
+	rwlock_release_write (&open_inodes_lock);
+	while (!list_empty (&victims))
+		inode_free (list_entry (list_pop_front (&victims), struct inode,
+					lru_elem));
+}
+
+/* Frees INODE, which is in no list. */
+static void
+inode_free (struct inode *inode) {
+	buffer_cache_disown (&inode->owner);
+#ifdef EFILESYS
+	fat_map_destroy (&inode->map);
+#else
+	free (inode->indirect);
+#endif
+	kmem_cache_free (inode_cache, inode);
 }
 
 /* Marks INODE to be deleted when it is closed by the last caller who
@@ -176,25 +1005,104 @@ inode_close (struct inode *inode) {
 void
 inode_remove (struct inode *inode) {
 	ASSERT (inode != NULL);
+	lock_acquire (&inode->lock);
 	inode->removed = true;
+	lock_release (&inode->lock);
 }
 
-/* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
- * Returns the number of bytes actually read, which may be less
- * than SIZE if an error occurs or end of file is reached. */
-off_t
-inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
-	uint8_t *buffer = buffer_;
-	off_t bytes_read = 0;
-	uint8_t *bounce = NULL;
+/* Acquires INODE's metadata lock on behalf of a user of INODE, such
+ * as the directory layer, to make a series of reads and writes of
+ * INODE atomic with respect to others that do the same.  Reads and
+ * writes of INODE do not take it themselves. */
+void
+inode_lock (struct inode *inode) {
+	lock_acquire (&inode->lock);
+}
+
+/* Releases the lock acquired by inode_lock(). */
+void
+inode_unlock (struct inode *inode) {
+	lock_release (&inode->lock);
+}
+
+/* Pages of a file that is mapped into memory are shared with
+ * read() and write() through the VM's file cache, since a mapped
+ * page may be newer than the disk.  Other data goes through the
+ * buffer cache.  Both copy to and from the caller's buffer directly,
+ * with a lock held, so a buffer in user memory must be pinned, as
+ * vm_pin_buffer() does, and cannot fault in the middle.
+ *
+ * The VM's file cache is consulted after the disk side of a read or
+ * a write is done and INODE's RW has been released again: a read
+ * copies the mapped pages over what it got from the buffer cache,
+ * and a write copies what it wrote into them. */
+
+/* Copies over the SIZE bytes at OFFSET in INODE, just read into
+ * BUFFER, those that lie in mapped pages of INODE. */
+static void
+cache_read (struct inode *inode UNUSED, off_t offset UNUSED,
+		uint8_t *buffer UNUSED, off_t size UNUSED) {
+#ifdef VM
+	while (size > 0 && !vm_cache_empty ()) {
+		off_t chunk = PGSIZE - offset % PGSIZE;
+
+		if (chunk > size)
+			chunk = size;
+		vm_cache_read (inode, offset, buffer, chunk);
+		offset += chunk;
+		buffer += chunk;
+		size -= chunk;
+	}
+#endif
+}
+
+/* Copies SIZE bytes from BUFFER, just written at OFFSET in INODE, to
+ * the mapped pages of INODE holding them, if there are any. */
+static void
+cache_write (struct inode *inode UNUSED, off_t offset UNUSED,
+		const uint8_t *buffer UNUSED, off_t size UNUSED) {
+#ifdef VM
+	while (size > 0 && !vm_cache_empty ()) {
+		off_t chunk = PGSIZE - offset % PGSIZE;
+
+		if (chunk > size)
+			chunk = size;
+		vm_cache_write (inode, offset, buffer, chunk);
+		offset += chunk;
+		buffer += chunk;
+		size -= chunk;
+	}
+#endif
+}
+
+/* Reads SIZE bytes from INODE into BUFFER, starting at position
+ * OFFSET, from the inode itself and the buffer cache, and zeros past
+ * the valid length.  Returns the number of bytes read.  The caller
+ * must hold INODE's RW. */
+static off_t
+read_locked (struct inode *inode, uint8_t *buffer, off_t size, off_t offset) {
+	off_t bytes_read = 0, zero_cnt;
+
+	if (inode_is_inline (inode)) {
+		off_t length = inode->data.length;
+
+		if (size <= 0 || offset >= length)
+			return 0;
+		if (size > length - offset)
+			size = length - offset;
+		memcpy (buffer, inode->data.inline_data + offset, size);
+		return size;
+	}
 
 	while (size > 0) {
 		/* Disk sector to read, starting byte offset within sector. */
-		disk_sector_t sector_idx = byte_to_sector (inode, offset);
+		size_t run_left = 1;
+		disk_sector_t sector_idx = byte_to_sector (inode, offset, &run_left);
 		int sector_ofs = offset % DISK_SECTOR_SIZE;
 
-		/* Bytes left in inode, bytes left in sector, lesser of the two. */
-		off_t inode_left = inode_length (inode) - offset;
+		/* Bytes left in inode's valid data, bytes left in sector,
+		 * lesser of the two. */
+		off_t inode_left = inode->data.valid_length - offset;
 		int sector_left = DISK_SECTOR_SIZE - sector_ofs;
 		int min_left = inode_left < sector_left ? inode_left : sector_left;
 
@@ -203,100 +1111,289 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 		if (chunk_size <= 0)
 			break;
 
-		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
-			/* Read full sector directly into caller's buffer. */
-			disk_read (filesys_disk, sector_idx, buffer + bytes_read); 
-		} else {
-			/* Read sector into bounce buffer, then partially copy
-			 * into caller's buffer. */
-			if (bounce == NULL) {
-				bounce = malloc (DISK_SECTOR_SIZE);
-				if (bounce == NULL)
-					break;
-			}
-			disk_read (filesys_disk, sector_idx, bounce);
-			memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
-		}
+		if (sector_idx == (disk_sector_t) -1) {
+			/* A hole, as far as it goes. */
+			off_t hole = run_left * DISK_SECTOR_SIZE - sector_ofs;
+
+			if (hole > size)
+				hole = size;
+			if (hole > inode_left)
+				hole = inode_left;
+			memset (buffer + bytes_read, 0, hole);
+			chunk_size = hole;
+		} else if (chunk_size == DISK_SECTOR_SIZE && !inode->meta) {
+			/* Read the whole sectors from here on together, with as
+			 * few disk commands as possible, as far as they are
+			 * contiguous on disk.  Metadata goes a sector at a time,
+			 * to be kept in the cache. */
+			off_t run = size < inode_left ? size : inode_left;
+			size_t cnt = run / DISK_SECTOR_SIZE;
+
+			if (cnt > run_left)
+				cnt = run_left;
+			if (cnt > DISK_MULTIPLE_MAX)
+				cnt = DISK_MULTIPLE_MAX;
+			buffer_cache_read_sectors (inode->mnt, sector_idx, cnt,
+					buffer + bytes_read);
+			chunk_size = cnt * DISK_SECTOR_SIZE;
+		} else if (inode->meta)
+			buffer_cache_read_meta (inode->mnt, sector_idx, buffer + bytes_read,
+					sector_ofs, chunk_size);
+		else
+			buffer_cache_read (inode->mnt, sector_idx, buffer + bytes_read,
+					sector_ofs, chunk_size);
 
 		/* Advance. */
 		size -= chunk_size;
 		offset += chunk_size;
 		bytes_read += chunk_size;
 	}
-	free (bounce);
 
+	/* Past the valid length, up to the end of file. */
+	zero_cnt = inode->data.length - offset;
+	if (zero_cnt > size)
+		zero_cnt = size;
+	if (zero_cnt > 0) {
+		memset (buffer + bytes_read, 0, zero_cnt);
+		bytes_read += zero_cnt;
+	}
 	return bytes_read;
 }
 
-/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
- * Returns the number of bytes actually written, which may be
- * less than SIZE if end of file is reached or an error occurs.
- * (Normally a write at end of file would extend the inode, but
- * growth is not yet implemented.) */
-off_t
-inode_write_at (struct inode *inode, const void *buffer_, off_t size,
+/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET,
+ * through the inode itself or the buffer cache, as far as INODE
+ * already reaches.  Returns the number of bytes written.  The
+ * caller must hold INODE's RW. */
+static off_t
+write_locked (struct inode *inode, const uint8_t *buffer, off_t size,
 		off_t offset) {
-	const uint8_t *buffer = buffer_;
 	off_t bytes_written = 0;
-	uint8_t *bounce = NULL;
 
-	if (inode->deny_write_cnt)
-		return 0;
+	if (inode_is_inline (inode)) {
+		off_t length = inode->data.length;
+
+		if (size <= 0 || offset >= length)
+			return 0;
+		if (size > length - offset)
+			size = length - offset;
+		memcpy (inode->data.inline_data + offset, buffer, size);
+		inode_save (inode);
+		return size;
+	}
 
 	while (size > 0) {
 		/* Sector to write, starting byte offset within sector. */
-		disk_sector_t sector_idx = byte_to_sector (inode, offset);
+		disk_sector_t sector_idx = byte_to_sector (inode, offset, NULL);
 		int sector_ofs = offset % DISK_SECTOR_SIZE;
 
 		/* Bytes left in inode, bytes left in sector, lesser of the two. */
-		off_t inode_left = inode_length (inode) - offset;
+		off_t inode_left = inode->data.length - offset;
 		int sector_left = DISK_SECTOR_SIZE - sector_ofs;
 		int min_left = inode_left < sector_left ? inode_left : sector_left;
 
-		/* Number of bytes to actually write into this sector. */
+		/* Number of bytes to actually write into this sector.  A hole
+		 * that could not be filled ends the write. */
 		int chunk_size = size < min_left ? size : min_left;
-		if (chunk_size <= 0)
+		if (chunk_size <= 0 || sector_idx == (disk_sector_t) -1)
 			break;
 
-		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
-			/* Write full sector directly to disk. */
-			disk_write (filesys_disk, sector_idx, buffer + bytes_written); 
-		} else {
-			/* We need a bounce buffer. */
-			if (bounce == NULL) {
-				bounce = malloc (DISK_SECTOR_SIZE);
-				if (bounce == NULL)
-					break;
-			}
-
-			/* If the sector contains data before or after the chunk
-			   we're writing, then we need to read in the sector
-			   first.  Otherwise we start with a sector of all zeros. */
-			if (sector_ofs > 0 || chunk_size < sector_left) 
-				disk_read (filesys_disk, sector_idx, bounce);
-			else
-				memset (bounce, 0, DISK_SECTOR_SIZE);
-			memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-			disk_write (filesys_disk, sector_idx, bounce); 
-		}
+		write_sector (inode, sector_idx, buffer + bytes_written, sector_ofs,
+				chunk_size);
 
 		/* Advance. */
 		size -= chunk_size;
 		offset += chunk_size;
 		bytes_written += chunk_size;
 	}
-	free (bounce);
+	return bytes_written;
+}
+
+/* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
+ * Returns the number of bytes actually read, which may be less
+ * than SIZE if an error occurs or end of file is reached. */
+off_t
+inode_read_at (struct inode *inode, void *buffer, off_t size, off_t offset) {
+	struct iovec iov = { .iov_base = buffer, .iov_len = size > 0 ? size : 0 };
+
+	return inode_readv (inode, &iov, 1, offset);
+}
+
+/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
+ * Returns the number of bytes actually written, which may be
+ * less than SIZE if the disk is full or an error occurs.
+ * A write past end of file extends the inode first. */
+off_t
+inode_write_at (struct inode *inode, const void *buffer, off_t size,
+		off_t offset) {
+	struct iovec iov = { .iov_base = (void *) buffer,
+		.iov_len = size > 0 ? size : 0 };
+
+	return inode_writev (inode, &iov, 1, offset);
+}
+
+/* Reads from INODE, starting at OFFSET, into the CNT buffers in IOV
+ * in turn, holding INODE's RW once for all of them.  Returns the
+ * number of bytes read, which is less than the buffers hold only if
+ * an error occurs or end of file is reached. */
+off_t
+inode_readv (struct inode *inode, const struct iovec *iov, int cnt,
+		off_t offset) {
+	off_t bytes_read = 0, left;
+	int i;
+
+	rwlock_acquire_read (&inode->rw);
+	for (i = 0; i < cnt; i++) {
+		off_t n = read_locked (inode, iov[i].iov_base, iov[i].iov_len,
+				offset + bytes_read);
 
+		bytes_read += n;
+		if (n < (off_t) iov[i].iov_len)
+			break;
+	}
+	rwlock_release_read (&inode->rw);
+
+	for (i = 0, left = bytes_read; left > 0; i++) {
+		off_t n = left < (off_t) iov[i].iov_len ? left : (off_t) iov[i].iov_len;
+
+		cache_read (inode, offset + bytes_read - left, iov[i].iov_base, n);
+		left -= n;
+	}
+	return bytes_read;
+}
+
+/* Writes the CNT buffers in IOV in turn into INODE, starting at
+ * OFFSET, holding INODE's RW once for all of them.  Returns the
+ * number of bytes written, which is less than the buffers hold only
+ * if the disk is full or an error occurs.
+ *
+ * A write past the valid length, or into a hole, holds INODE's RW
+ * exclusively.  It extends the inode first, all at once, if it goes
+ * past end of file, leaving the whole sectors before OFFSET as a
+ * hole; fills the holes it writes into; and zeros what lies between
+ * the valid length and OFFSET. */
+off_t
+inode_writev (struct inode *inode, const struct iovec *iov, int cnt,
+		off_t offset) {
+	off_t size = 0, bytes_written = 0, left;
+	bool exclusive = false;
+	int i;
+
+	for (i = 0; i < cnt; i++)
+		size += iov[i].iov_len;
+	if (size <= 0)
+		return 0;
+
+	rwlock_acquire_read (&inode->rw);
+	if (offset + size > inode->data.valid_length
+			|| range_has_hole (inode, offset, offset + size)) {
+		rwlock_release_read (&inode->rw);
+		rwlock_acquire_write (&inode->rw);
+		exclusive = true;
+	}
+	if (inode->deny_write_cnt == 0) {
+		if (exclusive) {
+			inode_extend (inode, offset + size, offset);
+			fill_holes (inode, offset, offset + size, offset, offset + size);
+			if (offset > inode->data.valid_length
+					&& offset <= inode->data.length) {
+				zero_range (inode, inode->data.valid_length, offset);
+				inode->data.valid_length = offset;
+			}
+		}
+		for (i = 0; i < cnt; i++) {
+			off_t n = write_locked (inode, iov[i].iov_base, iov[i].iov_len,
+					offset + bytes_written);
+
+			bytes_written += n;
+			if (n < (off_t) iov[i].iov_len)
+				break;
+		}
+		if (exclusive && !inode_is_inline (inode) && bytes_written > 0
+				&& offset + bytes_written > inode->data.valid_length) {
+			inode->data.valid_length = offset + bytes_written;
+			inode_save (inode);
+		}
+	}
+	if (exclusive)
+		rwlock_release_write (&inode->rw);
+	else
+		rwlock_release_read (&inode->rw);
+
+	/* Metadata is never mapped, and a commit writes the free map
+	 * without frame_lock to spare. */
+	for (i = 0, left = inode->meta ? 0 : bytes_written; left > 0; i++) {
+		off_t n = left < (off_t) iov[i].iov_len ? left : (off_t) iov[i].iov_len;
+
+		cache_write (inode, offset + bytes_written - left, iov[i].iov_base, n);
+		left -= n;
+	}
 	return bytes_written;
 }
 
+/* Has the sectors holding SIZE bytes of INODE at OFFSET read into
+ * the buffer cache in the background, as far as they lie within
+ * INODE. */
+void
+inode_read_ahead (struct inode *inode, off_t size, off_t offset) {
+	off_t length;
+	off_t end;
+
+	/* Nothing past the valid length is on disk. */
+	rwlock_acquire_read (&inode->rw);
+	length = inode->data.valid_length;
+	if (size <= 0 || offset >= length || inode_is_inline (inode))
+		goto done;
+	if (size > length - offset)
+		size = length - offset;
+	end = ROUND_UP (offset + size, DISK_SECTOR_SIZE);
+	offset = ROUND_DOWN (offset, DISK_SECTOR_SIZE);
+
+	/* One request for each contiguous run of sectors.  Holes are
+	 * skipped. */
+	while (offset < end) {
+		size_t run_left = 0, cnt = (end - offset) / DISK_SECTOR_SIZE;
+		disk_sector_t sector = byte_to_sector (inode, offset, &run_left);
+
+		if (run_left == 0)
+			break;
+		if (cnt > run_left)
+			cnt = run_left;
+		if (sector != (disk_sector_t) -1)
+			buffer_cache_read_ahead (inode->mnt, sector, cnt);
+		offset += cnt * DISK_SECTOR_SIZE;
+	}
+
+done:
+	rwlock_release_read (&inode->rw);
+}
+
+/* Makes sure that INODE has sectors for the SIZE bytes at OFFSET,
+ * growing it to OFFSET + SIZE bytes if it is shorter and filling
+ * any holes there, in as few runs of sectors as the disk allows.
+ * The new bytes read as zeros, and those past the valid length are
+ * not written until the file is.  Returns false if the disk is full
+ * or writes to INODE are denied. */
+bool
+inode_reserve (struct inode *inode, off_t offset, off_t size) {
+	bool success = false;
+
+	rwlock_acquire_write (&inode->rw);
+	if (inode->deny_write_cnt == 0)
+		success = inode_extend (inode, offset + size, 0)
+			&& fill_holes (inode, offset, offset + size, 0, 0);
+	rwlock_release_write (&inode->rw);
+	return success;
+}
+
 /* Disables writes to INODE.
    May be called at most once per inode opener. */
 	void
 inode_deny_write (struct inode *inode) 
 {
+	lock_acquire (&inode->lock);
 	inode->deny_write_cnt++;
 	ASSERT (inode->deny_write_cnt <= inode->open_cnt);
+	lock_release (&inode->lock);
 }
 
 /* Re-enables writes to INODE.
@@ -304,13 +1401,55 @@ inode_deny_write (struct inode *inode)
  * inode_deny_write() on the inode, before closing the inode. */
 void
 inode_allow_write (struct inode *inode) {
+	lock_acquire (&inode->lock);
 	ASSERT (inode->deny_write_cnt > 0);
 	ASSERT (inode->deny_write_cnt <= inode->open_cnt);
 	inode->deny_write_cnt--;
+	lock_release (&inode->lock);
+}
+
+/* Writes INODE's dirty data sectors to disk, and makes what has
+ * changed in its on-disk inode durable, as fsync() does.  If
+ * DATA_ONLY is true, as for fdatasync(), the inode is made durable
+ * only if it has changed since the last call, which saves a commit
+ * for a file rewritten in place.
+ *
+ * Without FAT, the inode, its extents and the free map are made
+ * durable by a journal commit, which covers every file's metadata
+ * at once, or on a mount without the journal, by writing the free
+ * map and the rest of the cache.  With FAT, the inode sector, like
+ * the FAT, is metadata that fat_flush() writes after the data.
+ * Either way, the disk's write cache is flushed last. */
+void
+inode_sync (struct inode *inode, bool data_only) {
+	ASSERT (inode != NULL);
+
+	buffer_cache_sync (&inode->owner);
+	if (!data_only || !inode->synced) {
+		inode->synced = true;
+#ifdef EFILESYS
+		fat_flush ();
+#else
+		if (inode->mnt->cache.journaled)
+			journal_commit ();
+		else {
+			free_map_flush (inode->mnt);
+			buffer_cache_flush ();
+		}
+#endif
+	}
+	disk_flush (inode->mnt->disk);
 }
 
 /* Returns the length, in bytes, of INODE's data. */
 off_t
 inode_length (const struct inode *inode) {
-	return inode->data.length;
+	struct rwlock *rw = (struct rwlock *) &inode->rw;
+	off_t length;
+
+	/* Growing an inline inode passes through length 0. */
+	rwlock_acquire_read (rw);
+	length = inode->data.length;
+	rwlock_release_read (rw);
+	return length;
 }
@@ -0,0 +1,300 @@
+/* journal.c: Write-ahead journal of file system metadata. */
+
+#include "filesys/journal.h"
+#include <crc32.h>
+#include <debug.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/buffer_cache.h"
+#include "filesys/filesys.h"
+#include "filesys/free-map.h"
+#include "filesys/mount.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+#ifndef EFILESYS
+/* Metadata journal.
+ *
+ * Inode sectors, indirect sectors, directory data and the free map
+ * are metadata.  The buffer cache keeps a changed metadata sector
+ * pinned: it is not written in place until a commit has put a copy
+ * of it in the journal.  A commit, which kworkerd makes at each
+ * periodic flush, or fsync asks for, gathers every pinned sector into
+ * one transaction and writes it to the journal with one sequential
+ * disk write, then a commit record after it.  Creating a file thus
+ * costs no disk write of its own; a second of creates shares one
+ * commit, in which each sector appears once however often it was
+ * changed.
+ *
+ * Committed sectors are written in place lazily, when the buffer
+ * cache replaces them, before they are changed again, and all of them
+ * when the journal is full, just before it starts over from the top.
+ * After a crash, journal_init() writes in place the transactions that
+ * were committed, which brings the metadata back to what it was at
+ * the last commit.
+ *
+ * The journal takes JOURNAL_SECTOR and the JOURNAL_SECTORS after it.
+ * JOURNAL_SECTOR says which transaction the journal starts with.
+ * Each transaction is a header sector listing the sectors in it,
+ * their contents, and a commit record with the checksum of the
+ * contents.  Transactions are numbered in order, so recovery stops at
+ * the first sector that is not the header of the next one.
+ *
+ * A commit must see the free map and the sectors that refer to it as
+ * of one moment, or a sector could be in a file after a crash but
+ * free in the free map.  The free map is changed only within
+ * journal_begin() and journal_end(), and a commit writes it into the
+ * buffer cache and takes its snapshot of the pinned sectors in
+ * between. */
+
+#define JOURNAL_MAGIC 0x4c4e524a        /* "JRNL". */
+#define JOURNAL_COMMIT_MAGIC 0x54494d43 /* "CMIT". */
+
+/* Most sectors in one transaction. */
+#define JOURNAL_TXN_MAX ((DISK_SECTOR_SIZE - 16) / sizeof (disk_sector_t))
+
+/* First sector of the transactions. */
+#define JOURNAL_START (JOURNAL_SECTOR + 1)
+
+/* On-disk journal superblock, at JOURNAL_SECTOR. */
+struct journal_super {
+	uint32_t magic;                     /* JOURNAL_MAGIC. */
+	uint32_t seq;                       /* Transaction at JOURNAL_START. */
+	uint8_t unused[DISK_SECTOR_SIZE - 8];
+};
+
+/* On-disk transaction header. */
+struct journal_header {
+	uint32_t magic;                     /* JOURNAL_MAGIC. */
+	uint32_t seq;                       /* Transaction number. */
+	uint32_t cnt;                       /* Number of sectors. */
+	uint32_t unused;
+	disk_sector_t sectors[JOURNAL_TXN_MAX]; /* Where each one goes. */
+};
+
+/* On-disk commit record, after the contents of a transaction. */
+struct journal_commit {
+	uint32_t magic;                     /* JOURNAL_COMMIT_MAGIC. */
+	uint32_t seq;                       /* Transaction number. */
+	uint64_t checksum;                  /* crc32c() of the contents. */
+	uint8_t unused[DISK_SECTOR_SIZE - 16];
+};
+
+static struct mount *journal_mnt;       /* Mount the journal is on. */
+static struct lock journal_lock;        /* One commit at a time. */
+static struct rwlock journal_map_rw;    /* Read for free map changes. */
+static bool journal_open;               /* Between init and close? */
+static uint32_t journal_seq;            /* Next transaction number. */
+static size_t journal_pos;              /* Where it goes. */
+
+/* A header sector, then the contents of a transaction, contiguous so
+ * that they go out in one write. */
+static uint8_t *journal_buf;
+#define JOURNAL_BUF_PAGES \
+	DIV_ROUND_UP ((JOURNAL_TXN_MAX + 1) * DISK_SECTOR_SIZE, PGSIZE)
+
+/* Statistics. */
+static long long journal_commit_cnt, journal_sector_cnt, journal_replay_cnt;
+
+static void write_super (void);
+static bool recover (void);
+
+/* Initializes the journal of MNT.  If FORMAT is true, the journal is
+ * made empty; otherwise the transactions committed in it are written
+ * in place first.  Must be called before the file system is read. */
+void
+journal_init (struct mount *mnt, bool format) {
+	journal_mnt = mnt;
+	lock_init (&journal_lock);
+	lock_register (&journal_lock, "journal");
+	/* A commit holds the lock across disk writes, and the committer
+	 * often comes right back for the next one; hand the lock to the
+	 * waiters in turn rather than let it win every time. */
+	lock_set_handoff (&journal_lock, 0);
+	rwlock_init (&journal_map_rw);
+	journal_buf = palloc_get_multiple (PAL_ASSERT,
+			JOURNAL_BUF_PAGES);
+
+	if (format || !recover ()) {
+		/* Nothing left from an older file system may pass for a
+		 * transaction. */
+		memset (journal_buf, 0, JOURNAL_BUF_PAGES * PGSIZE);
+		for (size_t i = 0, n; i < JOURNAL_SECTORS; i += n) {
+			n = JOURNAL_SECTORS - i < JOURNAL_TXN_MAX + 1
+				? JOURNAL_SECTORS - i : JOURNAL_TXN_MAX + 1;
+			disk_write_multiple (journal_mnt->disk, JOURNAL_START + i, n,
+					journal_buf);
+		}
+		journal_seq = 1;
+	}
+	/* What was replayed or cleared must be on disk before the
+	 * super says the journal is empty. */
+	disk_flush (journal_mnt->disk);
+	journal_pos = 0;
+	write_super ();
+	disk_flush (journal_mnt->disk);
+	journal_open = true;
+}
+
+/* Writes JOURNAL_SECTOR, saying the journal starts afresh at
+ * JOURNAL_START with the next transaction. */
+static void
+write_super (void) {
+	static struct journal_super super;
+
+	super.magic = JOURNAL_MAGIC;
+	super.seq = journal_seq;
+	disk_write (journal_mnt->disk, JOURNAL_SECTOR, &super);
+}
+
+/* Writes in place the transactions committed in the journal, and
+ * sets JOURNAL_SEQ to the number after the last.  Returns false if
+ * there is no journal on the disk. */
+static bool
+recover (void) {
+	struct journal_super *super = (struct journal_super *) journal_buf;
+	struct journal_header *h = (struct journal_header *) journal_buf;
+	uint8_t *data = journal_buf + DISK_SECTOR_SIZE;
+	static struct journal_commit c;
+	size_t pos = 0;
+
+	disk_read (journal_mnt->disk, JOURNAL_SECTOR, super);
+	if (super->magic != JOURNAL_MAGIC)
+		return false;
+	journal_seq = super->seq;
+
+	for (;;) {
+		size_t cnt;
+
+		if (pos + 2 > JOURNAL_SECTORS)
+			break;
+		disk_read (journal_mnt->disk, JOURNAL_START + pos, h);
+		cnt = h->cnt;
+		if (h->magic != JOURNAL_MAGIC || h->seq != journal_seq
+				|| cnt > JOURNAL_TXN_MAX || pos + cnt + 2 > JOURNAL_SECTORS)
+			break;
+		disk_read (journal_mnt->disk, JOURNAL_START + pos + cnt + 1, &c);
+		if (cnt > 0)
+			disk_read_multiple (journal_mnt->disk, JOURNAL_START + pos + 1,
+					cnt, data);
+		if (c.magic != JOURNAL_COMMIT_MAGIC || c.seq != journal_seq
+				|| c.checksum != crc32c (0, data, cnt * DISK_SECTOR_SIZE))
+			break;
+
+		for (size_t i = 0; i < cnt; i++)
+			disk_write (journal_mnt->disk, h->sectors[i],
+					data + i * DISK_SECTOR_SIZE);
+		journal_replay_cnt++;
+		journal_seq++;
+		pos += cnt + 2;
+	}
+	return true;
+}
+
+/* Commits every metadata sector changed since the last commit, with
+ * the free map as it is now, to the journal. */
+void
+journal_commit (void) {
+	struct journal_header *h = (struct journal_header *) journal_buf;
+	uint8_t *data = journal_buf + DISK_SECTOR_SIZE;
+	static struct journal_commit c;
+	size_t cnt;
+
+	if (!journal_open)
+		return;
+	lock_acquire (&journal_lock);
+
+	/* Take the snapshot with the free map held still. */
+	rwlock_acquire_write (&journal_map_rw);
+	free_map_flush (journal_mnt);
+	cnt = buffer_cache_snapshot (journal_mnt, h->sectors, data,
+			JOURNAL_TXN_MAX);
+	rwlock_release_write (&journal_map_rw);
+	if (cnt == 0)
+		goto done;
+
+	/* Start over from the top when the journal is full, once all
+	 * that it holds is in place. */
+	if (journal_pos + cnt + 2 > JOURNAL_SECTORS) {
+		buffer_cache_checkpoint ();
+		disk_flush (journal_mnt->disk);
+		journal_pos = 0;
+		write_super ();
+		disk_flush (journal_mnt->disk);
+	}
+
+	/* The commit record goes out only after all of the rest is on
+	 * disk, and what it commits may be written in place only once it
+	 * is. */
+	h->magic = JOURNAL_MAGIC;
+	h->seq = journal_seq;
+	h->cnt = cnt;
+	for (size_t i = 0; i <= cnt; i += DISK_MULTIPLE_MAX) {
+		size_t n = cnt + 1 - i < DISK_MULTIPLE_MAX
+			? cnt + 1 - i : DISK_MULTIPLE_MAX;
+
+		disk_write_multiple (journal_mnt->disk,
+				JOURNAL_START + journal_pos + i, n,
+				journal_buf + i * DISK_SECTOR_SIZE);
+	}
+	c.magic = JOURNAL_COMMIT_MAGIC;
+	c.seq = journal_seq;
+	c.checksum = crc32c (0, data, cnt * DISK_SECTOR_SIZE);
+	disk_flush (journal_mnt->disk);
+	disk_write (journal_mnt->disk, JOURNAL_START + journal_pos + cnt + 1, &c);
+	disk_flush (journal_mnt->disk);
+	buffer_cache_committed (journal_mnt);
+
+	journal_seq++;
+	journal_pos += cnt + 2;
+	journal_commit_cnt++;
+	journal_sector_cnt += cnt;
+
+done:
+	lock_release (&journal_lock);
+}
+
+/* Returns true if the running thread is making a commit. */
+bool
+journal_committing (void) {
+	return lock_held_by_current_thread (&journal_lock);
+}
+
+/* Commits what is left and writes all metadata in place, so that the
+ * journal is empty.  Called when its mount is closed. */
+void
+journal_close (void) {
+	journal_commit ();
+	lock_acquire (&journal_lock);
+	buffer_cache_checkpoint ();
+	disk_flush (journal_mnt->disk);
+	journal_pos = 0;
+	write_super ();
+	disk_flush (journal_mnt->disk);
+	journal_open = false;
+	lock_release (&journal_lock);
+}
+
+/* Starts a change to the free map, which a commit must not see half
+ * done. */
+void
+journal_begin (void) {
+	rwlock_acquire_read (&journal_map_rw);
+}
+
+/* Ends a change begun by journal_begin(). */
+void
+journal_end (void) {
+	rwlock_release_read (&journal_map_rw);
+}
+
+/* Prints journal statistics. */
+void
+journal_print_stats (void) {
+	printf ("Journal: %lld commits, %lld sectors committed, "
+			"%lld transactions replayed\n",
+			journal_commit_cnt, journal_sector_cnt, journal_replay_cnt);
+}
+#endif /* !EFILESYS */
@@ -0,0 +1,156 @@
+/* mount.c: Table of mounted file systems. */
+
+#include "filesys/mount.h"
+#include <debug.h>
+#include <stdio.h>
+#include "filesys/buffer_cache.h"
+#include "filesys/dcache.h"
+#include "filesys/directory.h"
+#include "filesys/fat.h"
+#include "filesys/filesys.h"
+#include "filesys/free-map.h"
+#include "filesys/inode.h"
+#include "filesys/journal.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* Mount table.
+ *
+ * Each disk with a file system on it has a struct mount, which holds
+ * what is the disk's own: its FAT, or without FAT, its free map, and
+ * its part of the buffer cache.  An inode knows the mount it is on,
+ * so everything done to a file goes to that file's disk, and through
+ * that disk's request queue, whatever the other disks are doing.
+ *
+ * The first mount is the root, whose root directory dir_open_root()
+ * opens.  Without FAT, only the root has the journal; the metadata of
+ * another mount is written like data.
+ *
+ * MOUNT_LOCK covers the table, not the mounts in it. */
+static struct list mount_list;
+static struct lock mount_lock;
+
+static void do_format (struct mount *);
+
+/* Initializes the mount table. */
+void
+mount_init (void) {
+	list_init (&mount_list);
+	lock_init (&mount_lock);
+}
+
+/* Mounts the file system on DISK, formatting it first if FORMAT is
+ * true, and returns the mount, or a null pointer if memory is short.
+ * The first mount made is the root. */
+struct mount *
+mount_open (struct disk *disk, bool format) {
+	struct mount *mnt = calloc (1, sizeof *mnt);
+
+	if (mnt == NULL)
+		return NULL;
+	mnt->disk = disk;
+#ifdef EFILESYS
+	if (!buffer_cache_mount (mnt, false)) {
+		free (mnt);
+		return NULL;
+	}
+	fat_init (mnt);
+
+	if (format)
+		do_format (mnt);
+
+	/* The root directory's inode is its first cluster. */
+	mnt->root_sector = cluster_to_sector (mnt, ROOT_DIR_CLUSTER);
+	fat_open (mnt);
+#else
+	bool root = mount_root () == NULL;
+
+	if (!buffer_cache_mount (mnt, root)) {
+		free (mnt);
+		return NULL;
+	}
+	mnt->root_sector = ROOT_DIR_SECTOR;
+	free_map_init (mnt);
+	if (root)
+		journal_init (mnt, format);
+
+	if (format)
+		do_format (mnt);
+
+	free_map_open (mnt);
+#endif
+
+	lock_acquire (&mount_lock);
+	list_push_back (&mount_list, &mnt->elem);
+	lock_release (&mount_lock);
+	return mnt;
+}
+
+/* Writes all that MNT has unwritten to its disk, takes it out of the
+ * mount table, and frees it.  No file on MNT may be in use. */
+void
+mount_close (struct mount *mnt) {
+	lock_acquire (&mount_lock);
+	list_remove (&mnt->elem);
+	lock_release (&mount_lock);
+
+#ifdef EFILESYS
+	fat_close (mnt);
+#else
+	free_map_close (mnt);
+	if (mnt->cache.journaled)
+		journal_close ();
+#endif
+	dcache_purge_dir (mnt, DCACHE_NONE);
+	inode_unmount (mnt);
+	buffer_cache_unmount (mnt);
+#ifdef EFILESYS
+	fat_destroy (mnt);
+#else
+	free_map_destroy (mnt);
+#endif
+	free (mnt);
+}
+
+/* Returns the root mount, or a null pointer if nothing is mounted. */
+struct mount *
+mount_root (void) {
+	struct mount *mnt = NULL;
+
+	lock_acquire (&mount_lock);
+	if (!list_empty (&mount_list))
+		mnt = list_entry (list_front (&mount_list), struct mount, elem);
+	lock_release (&mount_lock);
+	return mnt;
+}
+
+/* Flushes the write cache of every mounted disk. */
+void
+mount_flush_disks (void) {
+	lock_acquire (&mount_lock);
+	for (struct list_elem *e = list_begin (&mount_list);
+			e != list_end (&mount_list); e = list_next (e))
+		disk_flush (list_entry (e, struct mount, elem)->disk);
+	lock_release (&mount_lock);
+}
+
+/* Formats the file system of MNT. */
+static void
+do_format (struct mount *mnt) {
+	printf ("Formatting file system...");
+
+#ifdef EFILESYS
+	/* Create FAT and save it to the disk. */
+	fat_create (mnt);
+	if (!dir_create (mnt, cluster_to_sector (mnt, ROOT_DIR_CLUSTER), 16))
+		PANIC ("root directory creation failed");
+	fat_close (mnt);
+#else
+	free_map_create (mnt);
+	if (!dir_create (mnt, ROOT_DIR_SECTOR, 16))
+		PANIC ("root directory creation failed");
+	free_map_close (mnt);
+#endif
+
+	printf ("done.\n");
+}
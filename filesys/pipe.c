@@ -0,0 +1,247 @@
+/* pipe.c: Pipes between processes. */
+
+#include "filesys/pipe.h"
+#include <debug.h>
+#include <string.h>
+#include <uio.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#if defined (USERPROG) && !defined (VM)
+#include "threads/mmu.h"
+#include "threads/thread.h"
+#endif
+
+/* Pipes.
+ *
+ * A pipe's data is kept in a ring of up to PIPE_PAGES pages, each
+ * holding one run of bytes.  A write fills the newest page and then
+ * takes the next, so that a write of whole pages puts each in a page
+ * of its own; a read empties the oldest.  Pages stay with their slot
+ * of the ring once allocated, until the pipe goes away.
+ *
+ * A read into a page-aligned whole page of a process's memory that
+ * finds a whole page at the head of the ring does not copy it: the
+ * ring's page is mapped in the place of the process's, which goes
+ * into the ring to be written over later.  This is only done without
+ * VM, where every user page belongs to its process alone; with VM
+ * frames belong to the frame table and pages may be shared, so reads
+ * always copy.  Writes always copy, since the writer keeps its
+ * buffer.
+ *
+ * A read waits until there is data or no write end is left, and
+ * returns what there is, up to what was asked for; 0 means end of
+ * file.  A write waits for room until it has written everything,
+ * and stops early if no read end is left, returning -1 if it wrote
+ * nothing at all.  LOCK covers everything. */
+#define PIPE_PAGES 16
+
+/* A slot of the ring. */
+struct pipe_buf {
+	void *page;                 /* Page, or null if not yet allocated. */
+	size_t ofs;                 /* Offset of the first byte in PAGE. */
+	size_t len;                 /* Bytes in PAGE. */
+};
+
+struct pipe {
+	struct lock lock;
+	struct condition readable;  /* Signaled when data comes or writers go. */
+	struct condition writable;  /* Signaled when room frees or readers go. */
+	int readers, writers;       /* Open ends of each kind. */
+	unsigned head, tail;        /* Oldest and next free slot; only grow. */
+	struct pipe_buf bufs[PIPE_PAGES];
+};
+
+/* Returns the slot of PIPE for index I. */
+static struct pipe_buf *
+pipe_slot (struct pipe *pipe, unsigned i) {
+	return &pipe->bufs[i % PIPE_PAGES];
+}
+
+/* Returns true if another byte fits into PIPE. */
+static bool
+pipe_room (struct pipe *pipe) {
+	struct pipe_buf *last;
+
+	if (pipe->tail - pipe->head < PIPE_PAGES)
+		return true;
+	last = pipe_slot (pipe, pipe->tail - 1);
+	return last->ofs + last->len < PGSIZE;
+}
+
+/* Creates a pipe with one read end and one write end open.  Returns
+ * a null pointer if memory is short. */
+struct pipe *
+pipe_create (void) {
+	struct pipe *pipe = calloc (1, sizeof *pipe);
+
+	if (pipe != NULL) {
+		lock_init (&pipe->lock);
+		cond_init (&pipe->readable);
+		cond_init (&pipe->writable);
+		pipe->readers = pipe->writers = 1;
+	}
+	return pipe;
+}
+
+/* Opens another end of PIPE, a write end if WRITER is true and a read
+ * end otherwise. */
+void
+pipe_reopen (struct pipe *pipe, bool writer) {
+	lock_acquire (&pipe->lock);
+	if (writer)
+		pipe->writers++;
+	else
+		pipe->readers++;
+	lock_release (&pipe->lock);
+}
+
+/* Closes an end of PIPE, as opened by pipe_reopen(), and frees PIPE
+ * with the last one. */
+void
+pipe_close (struct pipe *pipe, bool writer) {
+	bool last;
+	int i;
+
+	lock_acquire (&pipe->lock);
+	if (writer) {
+		ASSERT (pipe->writers > 0);
+		if (--pipe->writers == 0)
+			cond_broadcast (&pipe->readable, &pipe->lock);
+	} else {
+		ASSERT (pipe->readers > 0);
+		if (--pipe->readers == 0)
+			cond_broadcast (&pipe->writable, &pipe->lock);
+	}
+	last = pipe->readers == 0 && pipe->writers == 0;
+	lock_release (&pipe->lock);
+
+	if (last) {
+		for (i = 0; i < PIPE_PAGES; i++)
+			palloc_free_page (pipe->bufs[i].page);
+		free (pipe);
+	}
+}
+
+#if defined (USERPROG) && !defined (VM)
+/* Maps BUF's page, which is full, at user page UPAGE in place of the
+ * page there, which BUF takes instead.  Returns false, changing
+ * nothing, if UPAGE is not a writable user page of the running
+ * process. */
+static bool
+pipe_flip (struct pipe_buf *buf, void *upage) {
+	uint64_t *pml4 = thread_pml4 (thread_current ());
+	uint64_t *pte;
+	void *kpage;
+
+	if (pml4 == NULL || !is_user_vaddr (upage))
+		return false;
+	pte = pml4e_walk (pml4, (uint64_t) upage, 0);
+	if (pte == NULL || !(*pte & PTE_P) || !is_writable (pte)
+			|| !is_user_pte (pte))
+		return false;
+
+	kpage = pml4_get_page (pml4, upage);
+	pml4_clear_page (pml4, upage);
+	pml4_set_page (pml4, upage, buf->page, true);
+	buf->page = kpage;
+	return true;
+}
+#endif
+
+/* Reads from PIPE into the CNT buffers in IOV in turn, waiting until
+ * there is something to read.  Returns the number of bytes read, or
+ * 0 once PIPE is empty and has no write end. */
+off_t
+pipe_readv (struct pipe *pipe, const struct iovec *iov, int cnt) {
+	off_t bytes_read = 0;
+	int i;
+
+	lock_acquire (&pipe->lock);
+	while (pipe->head == pipe->tail && pipe->writers > 0)
+		cond_wait (&pipe->readable, &pipe->lock);
+
+	for (i = 0; i < cnt && pipe->head != pipe->tail; i++) {
+		uint8_t *dst = iov[i].iov_base;
+		size_t left = iov[i].iov_len;
+
+		while (left > 0 && pipe->head != pipe->tail) {
+			struct pipe_buf *buf = pipe_slot (pipe, pipe->head);
+			size_t chunk = buf->len < left ? buf->len : left;
+
+#if defined (USERPROG) && !defined (VM)
+			if (chunk != PGSIZE || pg_ofs (dst) != 0
+					|| !pipe_flip (buf, dst))
+#endif
+				memcpy (dst, (uint8_t *) buf->page + buf->ofs, chunk);
+			buf->ofs += chunk;
+			buf->len -= chunk;
+			if (buf->len == 0)
+				pipe->head++;
+			dst += chunk;
+			left -= chunk;
+			bytes_read += chunk;
+		}
+		if (left > 0)
+			break;
+	}
+
+	if (bytes_read > 0)
+		cond_broadcast (&pipe->writable, &pipe->lock);
+	lock_release (&pipe->lock);
+	return bytes_read;
+}
+
+/* Writes the CNT buffers in IOV in turn into PIPE, waiting for room
+ * as needed.  Returns the number of bytes written, which is less than
+ * the buffers hold only if PIPE has no read end left or memory is
+ * short, or -1 if nothing could be written. */
+off_t
+pipe_writev (struct pipe *pipe, const struct iovec *iov, int cnt) {
+	off_t bytes_written = 0;
+	bool broken = false;
+	int i;
+
+	lock_acquire (&pipe->lock);
+	for (i = 0; i < cnt && !broken; i++) {
+		const uint8_t *src = iov[i].iov_base;
+		size_t left = iov[i].iov_len;
+
+		while (left > 0) {
+			struct pipe_buf *buf;
+			size_t chunk;
+
+			while (pipe->readers > 0 && !pipe_room (pipe))
+				cond_wait (&pipe->writable, &pipe->lock);
+			if (pipe->readers == 0) {
+				broken = true;
+				break;
+			}
+
+			buf = pipe_slot (pipe, pipe->tail - 1);
+			if (pipe->head == pipe->tail || buf->ofs + buf->len == PGSIZE) {
+				buf = pipe_slot (pipe, pipe->tail);
+				if (buf->page == NULL
+						&& (buf->page = palloc_get_page (PAL_USER)) == NULL) {
+					broken = true;
+					break;
+				}
+				buf->ofs = buf->len = 0;
+				pipe->tail++;
+			}
+
+			chunk = PGSIZE - buf->ofs - buf->len;
+			if (chunk > left)
+				chunk = left;
+			memcpy ((uint8_t *) buf->page + buf->ofs + buf->len, src, chunk);
+			buf->len += chunk;
+			src += chunk;
+			left -= chunk;
+			bytes_written += chunk;
+			cond_signal (&pipe->readable, &pipe->lock);
+		}
+	}
+	lock_release (&pipe->lock);
+	return broken && bytes_written == 0 ? -1 : bytes_written;
+}
@@ -1,7 +1,11 @@
 #ifndef DEVICES_DISK_H
 #define DEVICES_DISK_H
 
+#include <diskstat.h>
 #include <inttypes.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 /* Size of a disk sector in bytes. */
@@ -15,13 +19,54 @@ typedef uint32_t disk_sector_t;
  * printf ("sector=%"PRDSNu"\n", sector); */
 #define PRDSNu PRIu32
 
+/* Most sectors that one disk_read_multiple() or
+ * disk_write_multiple() can transfer. */
+#define DISK_MULTIPLE_MAX 256
+
+extern bool disk_use_dma;
+
+struct bio;
+
+/* Called when bio B is done. */
+typedef void bio_end_func (struct bio *b);
+
+/* An asynchronous transfer between a disk and memory. */
+struct bio {
+	struct disk *disk;          /* Disk. */
+	disk_sector_t sector;       /* First sector. */
+	size_t cnt;                 /* Number of sectors. */
+	void *buffer;               /* CNT * DISK_SECTOR_SIZE bytes. */
+	bool write;                 /* To the disk? */
+	bio_end_func *end;          /* Called when done. */
+	void *aux;                  /* For END. */
+
+	/* Owned by the driver. */
+	struct list_elem elem;      /* Element in the channel's queue. */
+	int ioprio;                 /* Submitter's I/O class, IOPRIO_*. */
+	int64_t deadline;           /* Tick by which it should be started. */
+	uint64_t submitted;         /* TSC at submission. */
+	struct bio *next;           /* Next bio merged into the same command. */
+};
+
 void disk_init (void);
+void disk_wait_probes (void);
 void disk_print_stats (void);
+void disk_get_stats (struct disk *, struct diskstat *);
 
 struct disk *disk_get (int chan_no, int dev_no);
+struct disk *disk_find (const char *name);
+bool disk_shares_channel (const struct disk *, const struct disk *);
 disk_sector_t disk_size (struct disk *);
 void disk_read (struct disk *, disk_sector_t, void *);
 void disk_write (struct disk *, disk_sector_t, const void *);
+void bio_init (struct bio *, struct disk *, disk_sector_t, size_t cnt,
+		void *buffer, bool write, bio_end_func *, void *aux);
+void bio_signal (struct bio *);
+void disk_submit (struct bio *);
+void disk_read_multiple (struct disk *, disk_sector_t, size_t cnt, void *);
+void disk_write_multiple (struct disk *, disk_sector_t, size_t cnt,
+		const void *);
+void disk_flush (struct disk *);
 
 void 	register_disk_inspect_intr ();
 #endif /* devices/disk.h */
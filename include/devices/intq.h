@@ -1,6 +1,7 @@
 #ifndef DEVICES_INTQ_H
 #define DEVICES_INTQ_H
 
+#include <stddef.h>
 #include "threads/interrupt.h"
 #include "threads/synch.h"
 
@@ -15,28 +16,43 @@
    and condition variables from threads/synch.h cannot be used in
    this case, as they normally would, because they can only
    protect kernel threads from one another, not from interrupt
-   handlers. */
+   handlers.
 
-/* Queue buffer size, in bytes. */
+   When a queue has a single producer and a single consumer, such
+   as an interrupt handler filling it and one thread draining it,
+   intq_put_bulk() and intq_get_bulk() move bytes without turning
+   interrupts off: each side writes only its own index, and only
+   after the bytes it covers.  intq_read() is the blocking form of
+   intq_get_bulk(), turning interrupts off only to sleep.
+
+   The two sides may run on different CPUs, so a thread that goes
+   to sleep and the side that wakes it meet under a spinlock. */
+
+/* Queue buffer size, in bytes.  A power of two. */
 #define INTQ_BUFSIZE 64
 
 /* A circular queue of bytes. */
 struct intq {
 	/* Waiting threads. */
 	struct lock lock;           /* Only one thread may wait at once. */
+	struct spinlock wait_lock;  /* Protects the two below. */
 	struct thread *not_full;    /* Thread waiting for not-full condition. */
 	struct thread *not_empty;   /* Thread waiting for not-empty condition. */
 
 	/* Queue. */
 	uint8_t buf[INTQ_BUFSIZE];  /* Buffer. */
-	int head;                   /* New data is written here. */
-	int tail;                   /* Old data is read here. */
+	size_t head;                /* New data is written here. */
+	size_t tail;                /* Old data is read here. */
+	                            /* Both only grow, modulo INTQ_BUFSIZE. */
 };
 
 void intq_init (struct intq *);
 bool intq_empty (const struct intq *);
 bool intq_full (const struct intq *);
 uint8_t intq_getc (struct intq *);
+size_t intq_read (struct intq *, uint8_t *, size_t);
 void intq_putc (struct intq *, uint8_t);
+size_t intq_get_bulk (struct intq *, uint8_t *, size_t);
+size_t intq_put_bulk (struct intq *, const uint8_t *, size_t);
 
 #endif /* devices/intq.h */
@@ -2,6 +2,7 @@
 #define DEVICES_TIMER_H
 
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
@@ -9,15 +10,26 @@
 
 void timer_init (void);
 void timer_calibrate (void);
+void timer_set_calibration (unsigned loops, uint64_t tsc, uint64_t apic);
+void timer_print_calibration (void);
 
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
+int64_t timer_ns (void);
+uint64_t timer_tsc_hz (void);
+void *timer_clock_page (void);
 
 void timer_sleep (int64_t ticks);
+void timer_sleep_slack (int64_t ticks, int64_t slack);
 void timer_msleep (int64_t milliseconds);
 void timer_usleep (int64_t microseconds);
 void timer_nsleep (int64_t nanoseconds);
 
 void timer_print_stats (void);
 
+/* Tickless idle. */
+extern bool timer_tickless;
+void timer_idle_enter (void);
+int64_t timer_idle_exit (void);
+
 #endif /* devices/timer.h */
\ No newline at end of file
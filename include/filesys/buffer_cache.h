@@ -0,0 +1,52 @@
+#ifndef FILESYS_BUFFER_CACHE_H
+#define FILESYS_BUFFER_CACHE_H
+
+#include <list.h>
+#include <ohash.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "filesys/off_t.h"
+#include "devices/disk.h"
+
+struct mount;
+
+/* The dirty sectors of one file, for buffer_cache_sync(). */
+struct bc_owner {
+	struct list dirty;          /* Entries the file has dirty. */
+};
+
+/* The part of the cache that holds one mount's sectors. */
+struct bc_part {
+	struct ohash index;         /* Its valid entries, by sector. */
+	disk_sector_t *ghosts;      /* Sectors that last left probation. */
+	size_t ghost_head, ghost_cnt; /* Most recent just before GHOST_HEAD. */
+	bool journaled;             /* Metadata goes through the journal? */
+};
+
+void buffer_cache_init (void);
+bool buffer_cache_mount (struct mount *, bool journaled);
+void buffer_cache_unmount (struct mount *);
+void buffer_cache_read (struct mount *, disk_sector_t, void *, off_t ofs,
+		size_t size);
+void buffer_cache_read_meta (struct mount *, disk_sector_t, void *,
+		off_t ofs, size_t size);
+void buffer_cache_read_sectors (struct mount *, disk_sector_t, size_t cnt,
+		void *);
+void buffer_cache_write (struct mount *, disk_sector_t, const void *,
+		off_t ofs, size_t size, struct bc_owner *);
+void buffer_cache_write_meta (struct mount *, disk_sector_t, const void *,
+		off_t ofs, size_t size, struct bc_owner *);
+void buffer_cache_read_ahead (struct mount *, disk_sector_t, size_t cnt);
+void buffer_cache_prefetch (struct mount *, disk_sector_t[], size_t cnt);
+void buffer_cache_flush (void);
+void buffer_cache_checkpoint (void);
+void buffer_cache_owner_init (struct bc_owner *);
+void buffer_cache_sync (struct bc_owner *);
+void buffer_cache_disown (struct bc_owner *);
+size_t buffer_cache_snapshot (struct mount *, disk_sector_t[], uint8_t *,
+		size_t max);
+void buffer_cache_committed (struct mount *);
+void buffer_cache_print_stats (void);
+
+#endif /* filesys/buffer_cache.h */
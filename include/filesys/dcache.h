@@ -0,0 +1,27 @@
+#ifndef FILESYS_DCACHE_H
+#define FILESYS_DCACHE_H
+
+#include <stdbool.h>
+#include "devices/disk.h"
+
+struct mount;
+
+/* Sector that stands for "no such name" in the cache. */
+#define DCACHE_NONE ((disk_sector_t) -1)
+
+void dcache_init (void);
+bool dcache_lookup (struct mount *, disk_sector_t dir, const char *name,
+		disk_sector_t *sector);
+void dcache_insert (struct mount *, disk_sector_t dir, const char *name,
+		disk_sector_t sector);
+void dcache_fill (struct mount *, disk_sector_t dir, const char *name,
+		disk_sector_t sector);
+unsigned dcache_generation (void);
+bool dcache_lookup_link (struct mount *, disk_sector_t dir,
+		const char *name, disk_sector_t *sector);
+void dcache_insert_link (struct mount *, disk_sector_t dir,
+		const char *name, disk_sector_t sector, unsigned gen);
+void dcache_purge_dir (struct mount *, disk_sector_t dir);
+void dcache_print_stats (void);
+
+#endif /* filesys/dcache.h */
@@ -1,9 +1,11 @@
 #ifndef FILESYS_DIRECTORY_H
 #define FILESYS_DIRECTORY_H
 
+#include <dirent.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include "devices/disk.h"
+#include "filesys/off_t.h"
 
 /* Maximum length of a file name component.
  * This is the traditional UNIX maximum length.
@@ -12,19 +14,27 @@
 #define NAME_MAX 14
 
 struct inode;
+struct mount;
+
+void dir_init (void);
 
 /* Opening and closing directories. */
-bool dir_create (disk_sector_t sector, size_t entry_cnt);
+bool dir_create (struct mount *, disk_sector_t sector, size_t entry_cnt);
 struct dir *dir_open (struct inode *);
 struct dir *dir_open_root (void);
 struct dir *dir_reopen (struct dir *);
 void dir_close (struct dir *);
 struct inode *dir_get_inode (struct dir *);
+void dir_seek (struct dir *, off_t);
+off_t dir_tell (struct dir *);
 
 /* Reading and writing. */
 bool dir_lookup (const struct dir *, const char *name, struct inode **);
+bool dir_lookup_follow (const struct dir *, const char *name,
+		struct inode **);
 bool dir_add (struct dir *, const char *name, disk_sector_t);
 bool dir_remove (struct dir *, const char *name);
 bool dir_readdir (struct dir *, char name[NAME_MAX + 1]);
+size_t dir_readdir_multiple (struct dir *, struct dirent *, size_t max);
 
 #endif /* filesys/directory.h */
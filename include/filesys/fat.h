@@ -7,6 +7,9 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include "threads/synch.h"
+
+struct mount;
 
 typedef uint32_t cluster_t;  /* Index of a cluster within FAT. */
 
@@ -18,21 +21,54 @@ typedef uint32_t cluster_t;  /* Index of a cluster within FAT. */
 #define FAT_BOOT_SECTOR 0     /* FAT boot sector. */
 #define ROOT_DIR_CLUSTER 1    /* Cluster for the root directory */
 
-void fat_init (void);
-void fat_open (void);
-void fat_close (void);
-void fat_create (void);
-void fat_close (void);
+void fat_init (struct mount *);
+void fat_open (struct mount *);
+void fat_close (struct mount *);
+void fat_destroy (struct mount *);
+void fat_create (struct mount *);
+void fat_flush (void);
 
 cluster_t fat_create_chain (
+    struct mount *,
     cluster_t clst /* Cluster # to stretch, 0: Create a new chain */
 );
 void fat_remove_chain (
+    struct mount *,
     cluster_t clst, /* Cluster # to be removed */
     cluster_t pclst /* Previous cluster of clst, 0: clst is the start of chain */
 );
-cluster_t fat_get (cluster_t clst);
-void fat_put (cluster_t clst, cluster_t val);
-disk_sector_t cluster_to_sector (cluster_t clst);
+cluster_t fat_get (struct mount *, cluster_t clst);
+void fat_put (struct mount *, cluster_t clst, cluster_t val);
+disk_sector_t cluster_to_sector (struct mount *, cluster_t clst);
+cluster_t sector_to_cluster (struct mount *, disk_sector_t sector);
+
+/* Consecutive clusters of a chain. */
+struct fat_extent {
+	uint32_t index;             /* Position of CLST within the chain. */
+	cluster_t clst;             /* First cluster. */
+	uint32_t length;            /* Number of clusters. */
+};
+
+/* Cached map of a cluster chain, as a sorted list of extents.
+ *
+ * Finding the Nth cluster of a chain means following N links with
+ * fat_get().  A map follows each link once, the first time a
+ * lookup reaches past what it knows, and records the chain as runs
+ * of consecutive clusters, which a binary search then finds in
+ * O(log n).  Chains are mostly contiguous, so the list is short. */
+struct fat_map {
+	struct mount *mnt;          /* Mount whose FAT has the chain. */
+	cluster_t start;            /* First cluster of the chain, or 0. */
+	struct fat_extent *runs;    /* Known extents, in chain order. */
+	size_t run_cnt;             /* Number of extents in RUNS. */
+	size_t run_cap;             /* Number of extents RUNS has room for. */
+	struct lock lock;           /* Protects all of the above. */
+};
+
+void fat_map_init (struct fat_map *, struct mount *, cluster_t start);
+void fat_map_reset (struct fat_map *, cluster_t start);
+void fat_map_destroy (struct fat_map *);
+cluster_t fat_map_lookup (struct fat_map *, uint32_t index,
+		uint32_t *run_left);
 
 #endif /* filesys/fat.h */
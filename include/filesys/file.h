@@ -4,28 +4,45 @@
 #include "filesys/off_t.h"
 #include <stdbool.h>
 
-/* An open file. */
+/* An open file: an open file description in POSIX terms.  Every
+ * descriptor made from it by dup2() or fork() refers to this one
+ * struct, so they share its position; see file_dup(). */
 struct file {
 	struct inode *inode;        /* File's inode. */
 	off_t pos;                  /* Current position. - 읽거나 써야할 현재 위치*/
 	bool deny_write;            /* Has file_deny_write() been called? */
-	int dup_count;				/* 0일 때만 close() */
+	bool dir;                   /* A directory, not to be written? */
+	int ref_cnt;                /* Number of references; see file_dup(). */
+	off_t ra_next;              /* Where a sequential read would start. */
+	off_t ra_end;               /* End of what was read ahead. */
+	off_t ra_window;            /* Readahead window in bytes, or 0. */
+	struct pipe *pipe;          /* Pipe this is an end of, or null. */
+	bool pipe_writer;           /* The write end of PIPE? */
 };
 
 struct inode;
+struct iovec;
+
+void file_init (void);
 
 /* Opening and closing files. */
 struct file *file_open (struct inode *);
+struct file *file_open_dir (struct inode *);
+bool file_open_pipe (struct file **reader, struct file **writer);
 struct file *file_reopen (struct file *);
 struct file *file_duplicate (struct file *file);
+struct file *file_dup (struct file *);
 void file_close (struct file *);
 struct inode *file_get_inode (struct file *);
+bool file_is_dir (struct file *);
 
 /* Reading and writing. */
 off_t file_read (struct file *, void *, off_t);
 off_t file_read_at (struct file *, void *, off_t size, off_t start);
 off_t file_write (struct file *, const void *, off_t);
 off_t file_write_at (struct file *, const void *, off_t size, off_t start);
+off_t file_readv (struct file *, const struct iovec *, int cnt);
+off_t file_writev (struct file *, const struct iovec *, int cnt);
 
 /* Preventing writes. */
 void file_deny_write (struct file *);
@@ -35,5 +52,7 @@ void file_allow_write (struct file *);
 void file_seek (struct file *, off_t);
 off_t file_tell (struct file *);
 off_t file_length (struct file *);
+bool file_reserve (struct file *, off_t offset, off_t size);
+void file_sync (struct file *, bool data_only);
 
 #endif /* filesys/file.h */
@@ -7,15 +7,24 @@
 /* Sectors of system file inodes. */
 /* inode 섹터 */
 #define FREE_MAP_SECTOR 0       /* Free map file inode sector. */
+#ifdef EFILESYS
+#include "filesys/fat.h"
+#else
 #define ROOT_DIR_SECTOR 1       /* Root directory file inode sector. */
+#define JOURNAL_SECTOR 2        /* Journal superblock sector. */
+#endif
 
-/* Disk used for file system. */
-extern struct disk *filesys_disk;
+/* Longest target of a symbolic link, in bytes. */
+#define SYMLINK_MAX 255
+
+/* Disk used for the root file system. */
+extern const char *filesys_disk_name;
 
 void filesys_init (bool format);
 void filesys_done (void);
 bool filesys_create (const char *name, off_t initial_size);
 struct file *filesys_open (const char *name);
 bool filesys_remove (const char *name);
+bool filesys_symlink (const char *target, const char *linkpath);
 
 #endif /* filesys/filesys.h */
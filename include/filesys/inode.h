@@ -6,16 +6,33 @@
 #include "devices/disk.h"
 
 struct bitmap;
+struct iovec;
+struct mount;
 
 void inode_init (void);
-bool inode_create (disk_sector_t, off_t);
-struct inode *inode_open (disk_sector_t);
+void inode_unmount (struct mount *);
+bool inode_create (struct mount *, disk_sector_t, off_t);
+bool inode_create_symlink (struct mount *, disk_sector_t, const char *target);
+struct inode *inode_open (struct mount *, disk_sector_t);
 struct inode *inode_reopen (struct inode *);
+bool inode_is_symlink (const struct inode *);
+const char *inode_symlink_target (const struct inode *);
 disk_sector_t inode_get_inumber (const struct inode *);
+struct mount *inode_get_mount (const struct inode *);
+void inode_set_meta (struct inode *);
 void inode_close (struct inode *);
 void inode_remove (struct inode *);
+void inode_lock (struct inode *);
+void inode_unlock (struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
 off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
+off_t inode_readv (struct inode *, const struct iovec *, int cnt,
+		off_t offset);
+off_t inode_writev (struct inode *, const struct iovec *, int cnt,
+		off_t offset);
+void inode_read_ahead (struct inode *, off_t size, off_t offset);
+bool inode_reserve (struct inode *, off_t offset, off_t size);
+void inode_sync (struct inode *, bool data_only);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
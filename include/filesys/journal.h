@@ -0,0 +1,27 @@
+#ifndef FILESYS_JOURNAL_H
+#define FILESYS_JOURNAL_H
+
+#include <stdbool.h>
+#include "devices/disk.h"
+
+/* Sectors of the journal that follow JOURNAL_SECTOR. */
+#define JOURNAL_SECTORS 128
+
+struct mount;
+
+void journal_init (struct mount *, bool format);
+void journal_close (void);
+void journal_commit (void);
+bool journal_committing (void);
+void journal_print_stats (void);
+
+#ifndef EFILESYS
+void journal_begin (void);
+void journal_end (void);
+#else
+/* With FAT, there is no journal. */
+static inline void journal_begin (void) { }
+static inline void journal_end (void) { }
+#endif
+
+#endif /* filesys/journal.h */
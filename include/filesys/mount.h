@@ -0,0 +1,28 @@
+#ifndef FILESYS_MOUNT_H
+#define FILESYS_MOUNT_H
+
+#include <list.h>
+#include <stdbool.h>
+#include "devices/disk.h"
+#include "filesys/buffer_cache.h"
+
+struct fat_fs;
+struct free_map;
+
+/* A file system on one disk, in the mount table. */
+struct mount {
+	struct disk *disk;          /* Disk the file system is on. */
+	disk_sector_t root_sector;  /* Inode sector of its root directory. */
+	struct bc_part cache;       /* Its sectors in the buffer cache. */
+	struct fat_fs *fat;         /* Its FAT, with EFILESYS. */
+	struct free_map *free_map;  /* Its free sector map, without. */
+	struct list_elem elem;      /* Element in the mount table. */
+};
+
+void mount_init (void);
+struct mount *mount_open (struct disk *, bool format);
+void mount_close (struct mount *);
+struct mount *mount_root (void);
+void mount_flush_disks (void);
+
+#endif /* filesys/mount.h */
@@ -0,0 +1,16 @@
+#ifndef FILESYS_PIPE_H
+#define FILESYS_PIPE_H
+
+#include <stdbool.h>
+#include "filesys/off_t.h"
+
+struct pipe;
+struct iovec;
+
+struct pipe *pipe_create (void);
+void pipe_reopen (struct pipe *, bool writer);
+void pipe_close (struct pipe *, bool writer);
+off_t pipe_readv (struct pipe *, const struct iovec *, int cnt);
+off_t pipe_writev (struct pipe *, const struct iovec *, int cnt);
+
+#endif /* filesys/pipe.h */
@@ -53,6 +53,34 @@ static __inline uint64_t rcr3(void) {
 	return val;
 }
 
+/* CR4 holds the paging feature enables, among them PGE (global
+   pages) and PCIDE (process-context identifiers). */
+__attribute__((always_inline))
+static __inline uint64_t rcr4(void) {
+	uint64_t val;
+	__asm __volatile("movq %%cr4,%0" : "=r" (val));
+	return val;
+}
+
+__attribute__((always_inline))
+static __inline void lcr4(uint64_t val) {
+	__asm __volatile("movq %0, %%cr4" : : "r" (val) : "memory");
+}
+
+/* CR0 holds, among others, TS (task switched), which makes the next
+   FPU or SSE instruction trap. */
+__attribute__((always_inline))
+static __inline uint64_t rcr0(void) {
+	uint64_t val;
+	__asm __volatile("movq %%cr0,%0" : "=r" (val));
+	return val;
+}
+
+__attribute__((always_inline))
+static __inline void lcr0(uint64_t val) {
+	__asm __volatile("movq %0, %%cr0" : : "r" (val) : "memory");
+}
+
 __attribute__((always_inline))
 static __inline uint64_t rrax(void) {
 	uint64_t val;
@@ -131,4 +159,41 @@ static __inline void write_msr(uint32_t ecx, uint64_t val) {
 			:: "c" (ecx), "d" (edx), "a" (eax) );
 }
 
+__attribute__((always_inline))
+static __inline uint64_t read_msr(uint32_t ecx) {
+	uint32_t edx, eax;
+	__asm __volatile("rdmsr" : "=d" (edx), "=a" (eax) : "c" (ecx));
+	return ((uint64_t) edx << 32) | eax;
+}
+
+__attribute__((always_inline))
+static __inline uint64_t rdtsc(void) {
+	uint32_t lo, hi;
+	__asm __volatile("rdtsc" : "=a" (lo), "=d" (hi));
+	return ((uint64_t) hi << 32) | lo;
+}
+
+/* Arms address monitoring of the cache line containing ADDR, for
+   mwait. */
+__attribute__((always_inline))
+static __inline void monitor(const volatile void *addr) {
+	__asm __volatile("monitor" : : "a" (addr), "c" (0), "d" (0));
+}
+
+/* Enables interrupts and waits, in the C-state given by HINT,
+   until the monitored line is written or an interrupt arrives.  As
+   with "sti; hlt", no interrupt can slip in between the two. */
+__attribute__((always_inline))
+static __inline void sti_mwait(uint32_t hint) {
+	__asm __volatile("sti; mwait" : : "a" (hint), "c" (0) : "memory");
+}
+
+__attribute__((always_inline))
+static __inline void cpuid(uint32_t leaf, uint32_t *eax, uint32_t *ebx,
+		uint32_t *ecx, uint32_t *edx) {
+	__asm __volatile("cpuid"
+			: "=a" (*eax), "=b" (*ebx), "=c" (*ecx), "=d" (*edx)
+			: "a" (leaf), "c" (0));
+}
+
 #endif /* intrinsic.h */
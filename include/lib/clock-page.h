@@ -0,0 +1,26 @@
+#ifndef __LIB_CLOCK_PAGE_H
+#define __LIB_CLOCK_PAGE_H
+
+#include <stdint.h>
+
+/* Clock page.
+
+   The kernel maps one read-only page at CLOCK_PAGE_VA into every
+   user process and keeps the timer tick count in it up to date, so
+   that user programs can read the time without a system call.  The
+   page is shared by all processes. */
+#define CLOCK_PAGE_VA ((void *) 0x1000)
+
+struct clock_page {
+	volatile int64_t ticks;     /* Timer ticks since boot. */
+	int64_t freq;               /* Timer ticks per second. */
+};
+
+/* Returns the number of timer ticks since boot.  An aligned 64-bit
+   load cannot tear on x86-64, so this needs no locking. */
+static inline int64_t
+clock_page_ticks (void) {
+	return ((const struct clock_page *) CLOCK_PAGE_VA)->ticks;
+}
+
+#endif /* lib/clock-page.h */
@@ -0,0 +1,13 @@
+#ifndef __LIB_CRC32_H
+#define __LIB_CRC32_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* CRC-32C, the Castagnoli polynomial that iSCSI, ext4 and btrfs
+   checksum with, and that SSE4.2 computes in hardware.  Pass 0 as
+   CRC to start, or the result for the bytes before to continue:
+   crc32c (crc32c (0, a, m), b, n) is the CRC of A followed by B. */
+uint32_t crc32c (uint32_t crc, const void *, size_t);
+
+#endif /* lib/crc32.h */
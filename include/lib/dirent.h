@@ -0,0 +1,16 @@
+#ifndef __LIB_DIRENT_H
+#define __LIB_DIRENT_H
+
+#include <stdint.h>
+
+/* Longest file name in a struct dirent. */
+#define DIRENT_NAME_MAX 14
+
+/* A directory entry, as the getdents system call returns it.  One
+   call fills a buffer with as many of them as fit. */
+struct dirent {
+	uint32_t d_ino;                     /* Inode number. */
+	char d_name[DIRENT_NAME_MAX + 1];   /* Null-terminated file name. */
+};
+
+#endif /* lib/dirent.h */
@@ -0,0 +1,38 @@
+#ifndef __LIB_DISKSTAT_H
+#define __LIB_DISKSTAT_H
+
+#include <stdint.h>
+
+/* Number of buckets in the request size histogram.  Bucket I counts
+   requests of 2^I up to 2^(I + 1) sectors. */
+#define DISKSTAT_SIZES 9
+
+/* Number of buckets in the request latency histogram.  Bucket 0
+   counts requests that took fewer than 2^(DISKSTAT_SHIFT + 1) TSC
+   cycles from submission to completion, bucket I > 0 those that
+   took from 2^(DISKSTAT_SHIFT + I) up to 2^(DISKSTAT_SHIFT + I + 1),
+   and the last bucket everything slower. */
+#define DISKSTAT_BUCKETS 16
+#define DISKSTAT_SHIFT 12
+
+/* I/O on one disk, as reported by the diskstat system call.
+
+   A request is one bio, as submitted: requests next to each other
+   may be merged into one disk command.  The queue depth is the
+   number of requests submitted and not yet completed on the disk,
+   counting the new one, at each submission; queue_depth_sum divided
+   by reads + writes is its average.  Busy cycles are those the
+   disk's channel spent carrying out its commands. */
+struct diskstat {
+	uint64_t reads;             /* Read requests. */
+	uint64_t writes;            /* Write requests. */
+	uint64_t bytes_read;        /* Bytes read. */
+	uint64_t bytes_written;     /* Bytes written. */
+	uint64_t sizes[DISKSTAT_SIZES];     /* Requests, by sectors. */
+	uint64_t latency[DISKSTAT_BUCKETS]; /* Requests, by cycles. */
+	uint64_t queue_depth_max;   /* Deepest queue seen. */
+	uint64_t queue_depth_sum;   /* Sum of depths seen. */
+	uint64_t busy_cycles;       /* TSC cycles spent on commands. */
+};
+
+#endif /* lib/diskstat.h */
@@ -90,6 +90,7 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <debug.h>
 
 /* List element. */
 struct list_elem {
@@ -115,39 +116,39 @@ struct list {
 	((STRUCT *) ((uint8_t *) &(LIST_ELEM)->next     \
 		- offsetof (STRUCT, MEMBER.next)))
 
-void list_init (struct list *);
+static inline void list_init (struct list *);
 
 /* List traversal. */
-struct list_elem *list_begin (struct list *);
-struct list_elem *list_next (struct list_elem *);
-struct list_elem *list_end (struct list *);
+static inline struct list_elem *list_begin (struct list *);
+static inline struct list_elem *list_next (struct list_elem *);
+static inline struct list_elem *list_end (struct list *);
 
-struct list_elem *list_rbegin (struct list *);
-struct list_elem *list_prev (struct list_elem *);
-struct list_elem *list_rend (struct list *);
+static inline struct list_elem *list_rbegin (struct list *);
+static inline struct list_elem *list_prev (struct list_elem *);
+static inline struct list_elem *list_rend (struct list *);
 
-struct list_elem *list_head (struct list *);
-struct list_elem *list_tail (struct list *);
+static inline struct list_elem *list_head (struct list *);
+static inline struct list_elem *list_tail (struct list *);
 
 /* List insertion. */
-void list_insert (struct list_elem *, struct list_elem *);
-void list_splice (struct list_elem *before,
+static inline void list_insert (struct list_elem *, struct list_elem *);
+static inline void list_splice (struct list_elem *before,
 		struct list_elem *first, struct list_elem *last);
-void list_push_front (struct list *, struct list_elem *);
-void list_push_back (struct list *, struct list_elem *);
+static inline void list_push_front (struct list *, struct list_elem *);
+static inline void list_push_back (struct list *, struct list_elem *);
 
 /* List removal. */
-struct list_elem *list_remove (struct list_elem *);
-struct list_elem *list_pop_front (struct list *);
-struct list_elem *list_pop_back (struct list *);
+static inline struct list_elem *list_remove (struct list_elem *);
+static inline struct list_elem *list_pop_front (struct list *);
+static inline struct list_elem *list_pop_back (struct list *);
 
 /* List elements. */
-struct list_elem *list_front (struct list *);
-struct list_elem *list_back (struct list *);
+static inline struct list_elem *list_front (struct list *);
+static inline struct list_elem *list_back (struct list *);
 
 /* List properties. */
 size_t list_size (struct list *);
-bool list_empty (struct list *);
+static inline bool list_empty (struct list *);
 
 /* Miscellaneous. */
 void list_reverse (struct list *);
@@ -166,7 +167,7 @@ typedef bool list_less_func (const struct list_elem *a,
 /* Operations on lists with ordered elements. */
 void list_sort (struct list *,
                 list_less_func *, void *aux);
-void list_insert_ordered (struct list *, struct list_elem *,
+static inline void list_insert_ordered (struct list *, struct list_elem *,
                           list_less_func *, void *aux);
 void list_unique (struct list *, struct list *duplicates,
                   list_less_func *, void *aux);
@@ -175,4 +176,288 @@ void list_unique (struct list *, struct list *duplicates,
 struct list_elem *list_max (struct list *, list_less_func *, void *aux);
 struct list_elem *list_min (struct list *, list_less_func *, void *aux);
 
+/* The primitives are defined here, rather than in list.c, so that
+   a traversal step compiles to a load or two instead of a call.
+   Their assertions go away with the others when NDEBUG is
+   defined.  list_insert_ordered() is here too, so that a
+   comparator known at the call site can be inlined into its
+   loop. */
+
+/* Returns true if ELEM is a head, false otherwise. */
+static inline bool
+list_elem_is_head (struct list_elem *elem) {
+	return elem != NULL && elem->prev == NULL && elem->next != NULL;
+}
+
+/* Returns true if ELEM is an interior element,
+   false otherwise. */
+static inline bool
+list_elem_is_interior (struct list_elem *elem) {
+	return elem != NULL && elem->prev != NULL && elem->next != NULL;
+}
+
+/* Returns true if ELEM is a tail, false otherwise. */
+static inline bool
+list_elem_is_tail (struct list_elem *elem) {
+	return elem != NULL && elem->prev != NULL && elem->next == NULL;
+}
+
+/* Initializes LIST as an empty list. */
+/* list 자료 구조를 초기화 */
+static inline void
+list_init (struct list *list) {		// list의 포인터형 변수로 & 메모리 주소를 받음
+	ASSERT (list != NULL);			// list가 NULL이 아니어야 프로그램 진행됨 (메모리 주소가 들어왔어야 함)
+	list->head.prev = NULL;			// list의 head의 prev 포인터 변수에 주소값으로 NULL을 넣어줌
+	list->head.next = &list->tail;	// list의 head의 next 포인터 변수에 주소값으로 list 변수의 tail 주소를 넣어줌
+	list->tail.prev = &list->head;  // list의 tail의 prev 포인터 변수에 주소값으로 list 변수의 head 주소를 넣어줌
+	list->tail.next = NULL;			// list의 tail의 next 포인터 변수에 주소값으로 NULL을 넣어줌
+}
+
+/* Returns the beginning of LIST.  */
+static inline struct list_elem *
+list_begin (struct list *list) {
+	ASSERT (list != NULL);
+	return list->head.next;			// list의 head의 next 포인터 변수를 리턴 -> 그래서 list_elem *e 포인터 변수로 받는 것
+}
+
+/* Returns the element after ELEM in its list.  If ELEM is the
+   last element in its list, returns the list tail.  Results are
+   undefined if ELEM is itself a list tail. */
+static inline struct list_elem *
+list_next (struct list_elem *elem) {
+	ASSERT (list_elem_is_head (elem) || list_elem_is_interior (elem));
+	return elem->next;
+}
+
+/* Returns LIST's tail.
+
+   list_end() is often used in iterating through a list from
+   front to back.  See the big comment at the top of list.h for
+   an example. */
+static inline struct list_elem *
+list_end (struct list *list) {
+	ASSERT (list != NULL);
+	return &list->tail;
+}
+
+/* Returns the LIST's reverse beginning, for iterating through
+   LIST in reverse order, from back to front. */
+static inline struct list_elem *
+list_rbegin (struct list *list) {
+	ASSERT (list != NULL);
+	return list->tail.prev;
+}
+
+/* Returns the element before ELEM in its list.  If ELEM is the
+   first element in its list, returns the list head.  Results are
+   undefined if ELEM is itself a list head. */
+static inline struct list_elem *
+list_prev (struct list_elem *elem) {
+	ASSERT (list_elem_is_interior (elem) || list_elem_is_tail (elem));
+	return elem->prev;
+}
+
+/* Returns LIST's head.
+
+   list_rend() is often used in iterating through a list in
+   reverse order, from back to front.  Here's typical usage,
+   following the example from the top of list.h:
+
+   for (e = list_rbegin (&foo_list); e != list_rend (&foo_list);
+   e = list_prev (e))
+   {
+   struct foo *f = list_entry (e, struct foo, elem);
+   ...do something with f...
+   }
+   */
+static inline struct list_elem *
+list_rend (struct list *list) {
+	ASSERT (list != NULL);
+	return &list->head;
+}
+
+/* Return's LIST's head.
+
+   list_head() can be used for an alternate style of iterating
+   through a list, e.g.:
+
+   e = list_head (&list);
+   while ((e = list_next (e)) != list_end (&list))
+   {
+   ...
+   }
+   */
+static inline struct list_elem *
+list_head (struct list *list) {
+	ASSERT (list != NULL);
+	return &list->head;
+}
+
+/* Return's LIST's tail. */
+static inline struct list_elem *
+list_tail (struct list *list) {
+	ASSERT (list != NULL);
+	return &list->tail;
+}
+
+/* Inserts ELEM just before BEFORE, which may be either an
+   interior element or a tail.  The latter case is equivalent to
+   list_push_back(). */
+static inline void
+list_insert (struct list_elem *before, struct list_elem *elem) {
+	ASSERT (list_elem_is_interior (before) || list_elem_is_tail (before));
+	ASSERT (elem != NULL);
+
+	elem->prev = before->prev;
+	elem->next = before;
+	before->prev->next = elem;
+	before->prev = elem;
+}
+
+/* Removes elements FIRST though LAST (exclusive) from their
+   current list, then inserts them just before BEFORE, which may
+   be either an interior element or a tail. */
+static inline void
+list_splice (struct list_elem *before,
+		struct list_elem *first, struct list_elem *last) {
+	ASSERT (list_elem_is_interior (before) || list_elem_is_tail (before));
+	if (first == last)
+		return;
+	last = list_prev (last);
+
+	ASSERT (list_elem_is_interior (first));
+	ASSERT (list_elem_is_interior (last));
+
+	/* Cleanly remove FIRST...LAST from its current list. */
+	first->prev->next = last->next;
+	last->next->prev = first->prev;
+
+	/* Splice FIRST...LAST into new list. */
+	first->prev = before->prev;
+	last->next = before;
+	before->prev->next = first;
+	before->prev = last;
+}
+
+/* Inserts ELEM at the beginning of LIST, so that it becomes the
+   front in LIST. */
+/* elem을 list의 처음에 삽입 */
+static inline void
+list_push_front (struct list *list, struct list_elem *elem) {
+	list_insert (list_begin (list), elem);
+}
+
+/* Inserts ELEM at the end of LIST, so that it becomes the
+   back in LIST. */
+/* elem을 list의 끝에 삽입 */
+static inline void
+list_push_back (struct list *list, struct list_elem *elem) {
+	list_insert (list_end (list), elem);
+}
+
+/* Removes ELEM from its list and returns the element that
+   followed it.  Undefined behavior if ELEM is not in a list.
+
+   It's not safe to treat ELEM as an element in a list after
+   removing it.  In particular, using list_next() or list_prev()
+   on ELEM after removal yields undefined behavior.  This means
+   that a naive loop to remove the elements in a list will fail:
+
+ ** DON'T DO THIS **
+ for (e = list_begin (&list); e != list_end (&list); e = list_next (e))
+ {
+ ...do something with e...
+ list_remove (e);
+ }
+ ** DON'T DO THIS **
+
+ Here is one correct way to iterate and remove elements from a
+list:
+
+for (e = list_begin (&list); e != list_end (&list); e = list_remove (e))
+{
+...do something with e...
+}
+
+If you need to free() elements of the list then you need to be
+more conservative.  Here's an alternate strategy that works
+even in that case:
+
+while (!list_empty (&list))
+{
+struct list_elem *e = list_pop_front (&list);
+...do something with e...
+}
+*/
+static inline struct list_elem *
+list_remove (struct list_elem *elem) {
+	ASSERT (list_elem_is_interior (elem));
+	elem->prev->next = elem->next;
+	elem->next->prev = elem->prev;
+	return elem->next; // next 포인터 반환
+}
+
+/* Removes the front element from LIST and returns it.
+   Undefined behavior if LIST is empty before removal. */
+static inline struct list_elem *
+list_pop_front (struct list *list) {
+	struct list_elem *front = list_front (list);
+	list_remove (front);
+	return front;
+}
+
+/* Removes the back element from LIST and returns it.
+   Undefined behavior if LIST is empty before removal. */
+static inline struct list_elem *
+list_pop_back (struct list *list) {
+	struct list_elem *back = list_back (list);
+	list_remove (back);
+	return back;
+}
+
+/* Returns the front element in LIST.
+   Undefined behavior if LIST is empty. */
+static inline struct list_elem *
+list_front (struct list *list) {
+	ASSERT (!list_empty (list));
+	return list->head.next;
+}
+
+/* Returns the back element in LIST.
+   Undefined behavior if LIST is empty. */
+static inline struct list_elem *
+list_back (struct list *list) {
+	ASSERT (!list_empty (list));
+	return list->tail.prev;
+}
+
+/* Returns true if LIST is empty, false otherwise. */
+static inline bool
+list_empty (struct list *list) {
+	return list_begin (list) == list_end (list);
+}
+
+/* Inserts ELEM in the proper position in LIST, which must be
+   sorted according to LESS given auxiliary data AUX.
+   Runs in O(n) average case in the number of elements in LIST. */
+/*
+   LIST의 적절한 위치에 ELEM을 삽입합니다. 
+   이 ELEM은 지정된 보조 데이터 AUX에 따라 정렬되어야 합니다.
+   LIST의 요소 수에서 O(n) 평균 대/소문자로 실행됩니다.
+*/
+static inline void
+list_insert_ordered (struct list *list, struct list_elem *elem,
+		list_less_func *less, void *aux) {
+	struct list_elem *e;
+
+	ASSERT (list != NULL);
+	ASSERT (elem != NULL);
+	ASSERT (less != NULL);
+
+	for (e = list_begin (list); e != list_end (list); e = list_next (e)) // e에는 인자로 받은 리스트의 처음부터 끝까지 원소를 넣어줌
+		if (less (elem, e, aux)) // 그래서 입력받은 elem과 리스트의 전체 원소가 비교되면서 정렬되는 것
+			break;				 // 현재 elem의 속성값 > 입력받은 elem의 속성값이면 참이 되어서 거기에 삽입하겠다는 뜻
+	return list_insert (e, elem);
+}
+
 #endif /* lib/kernel/list.h */
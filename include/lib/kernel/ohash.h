@@ -0,0 +1,109 @@
+#ifndef __LIB_KERNEL_OHASH_H
+#define __LIB_KERNEL_OHASH_H
+
+/* Open-addressing hash table.
+ *
+ * Like the chained tables in hash.h, this is an intrusive
+ * container: each structure that can be in a table embeds a
+ * struct ohash_elem member, and ohash_entry() gets back to the
+ * enclosing structure.  The interface mirrors hash.h function for
+ * function.
+ *
+ * Unlike hash.h, the table itself is a flat array of element
+ * pointers with one control byte per slot, in the style of a
+ * Swiss table.  A control byte holds 7 bits of the element's hash,
+ * or marks the slot empty or deleted, and a lookup compares 8
+ * control bytes at a time before it touches any element.  Most
+ * failed comparisons therefore cost no cache miss at all.
+ *
+ * Growing the table does not move every element at once.  The old
+ * array is kept next to the new one, and each later insertion or
+ * deletion moves a few of its slots over, so that no single call
+ * costs O(n).  Lookups search both arrays meanwhile.
+ *
+ * Insertion never fails once ohash_init() has succeeded, except
+ * that the kernel panics if the table is completely full and no
+ * memory is left to grow it. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Open-addressing hash element. */
+struct ohash_elem {
+	uint64_t hash;              /* Cached hash value. */
+};
+
+/* Converts pointer to hash element OHASH_ELEM into a pointer to
+ * the structure that OHASH_ELEM is embedded inside.  Supply the
+ * name of the outer structure STRUCT and the member name MEMBER
+ * of the hash element. */
+#define ohash_entry(OHASH_ELEM, STRUCT, MEMBER)                 \
+	((STRUCT *) ((uint8_t *) &(OHASH_ELEM)->hash            \
+		- offsetof (STRUCT, MEMBER.hash)))
+
+/* Computes and returns the hash value for hash element E, given
+ * auxiliary data AUX. */
+typedef uint64_t ohash_hash_func (const struct ohash_elem *e, void *aux);
+
+/* Compares the value of two hash elements A and B, given
+ * auxiliary data AUX.  Returns true if A is less than B, or
+ * false if A is greater than or equal to B. */
+typedef bool ohash_less_func (const struct ohash_elem *a,
+		const struct ohash_elem *b,
+		void *aux);
+
+/* Performs some operation on hash element E, given auxiliary
+ * data AUX. */
+typedef void ohash_action_func (struct ohash_elem *e, void *aux);
+
+/* One array of slots. */
+struct ohash_table {
+	size_t slot_cnt;            /* Number of slots, a power of 2, or 0. */
+	size_t used_cnt;            /* Slots that are not empty. */
+	uint8_t *ctrl;              /* Control bytes. */
+	struct ohash_elem **slots;  /* Elements. */
+};
+
+/* Open-addressing hash table. */
+struct ohash {
+	size_t elem_cnt;            /* Number of elements in table. */
+	struct ohash_table cur;     /* Table that insertions go to. */
+	struct ohash_table old;     /* Table being emptied into `cur'. */
+	size_t migrate_idx;         /* Next slot of `old' to move. */
+	ohash_hash_func *hash;      /* Hash function. */
+	ohash_less_func *less;      /* Comparison function. */
+	void *aux;                  /* Auxiliary data for `hash' and `less'. */
+};
+
+/* An open-addressing hash table iterator. */
+struct ohash_iterator {
+	struct ohash *hash;         /* The hash table. */
+	struct ohash_table *table;  /* Current array. */
+	size_t idx;                 /* Slot after the current element. */
+	struct ohash_elem *elem;    /* Current hash element. */
+};
+
+/* Basic life cycle. */
+bool ohash_init (struct ohash *, ohash_hash_func *, ohash_less_func *,
+		void *aux);
+void ohash_clear (struct ohash *, ohash_action_func *);
+void ohash_destroy (struct ohash *, ohash_action_func *);
+
+/* Search, insertion, deletion. */
+struct ohash_elem *ohash_insert (struct ohash *, struct ohash_elem *);
+struct ohash_elem *ohash_replace (struct ohash *, struct ohash_elem *);
+struct ohash_elem *ohash_find (struct ohash *, struct ohash_elem *);
+struct ohash_elem *ohash_delete (struct ohash *, struct ohash_elem *);
+
+/* Iteration. */
+void ohash_apply (struct ohash *, ohash_action_func *);
+void ohash_first (struct ohash_iterator *, struct ohash *);
+struct ohash_elem *ohash_next (struct ohash_iterator *);
+struct ohash_elem *ohash_cur (struct ohash_iterator *);
+
+/* Information. */
+size_t ohash_size (struct ohash *);
+bool ohash_empty (struct ohash *);
+
+#endif /* lib/kernel/ohash.h */
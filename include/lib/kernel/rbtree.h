@@ -0,0 +1,92 @@
+#ifndef __LIB_KERNEL_RBTREE_H
+#define __LIB_KERNEL_RBTREE_H
+
+/* Intrusive ordered tree.
+
+   This is a red-black tree.  Like the lists in list.h and the
+   heaps in heap.h, the tree does not allocate memory: each
+   structure that can be an element of a tree embeds a `struct
+   rb_elem' member, and rb_entry() converts a pointer to that
+   member back into a pointer to the enclosing structure.
+
+   Elements are kept in the order of the tree's less function.
+   Elements that compare equal are allowed and are kept in the
+   order they were inserted.
+
+   Costs: rb_insert(), rb_remove(), rb_find() and the bound
+   lookups are O(lg n) worst case; rb_min() is O(1); rb_next()
+   and rb_prev() are O(1) amortized over a whole traversal.
+
+   Iteration in order:
+
+      struct rb_elem *e;
+
+      for (e = rb_min (&tree); e != NULL; e = rb_next (e))
+        {
+          struct foo *f = rb_entry (e, struct foo, elem);
+          ...do something with f...
+        }
+
+   Removing the element E while iterating is safe if rb_next (E)
+   is taken first. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Tree element. */
+struct rb_elem {
+	struct rb_elem *parent;     /* Parent, or NULL at the root. */
+	struct rb_elem *left;       /* Subtree of lesser elements. */
+	struct rb_elem *right;      /* Subtree of greater elements. */
+	bool red;                   /* Red, or black? */
+};
+
+/* Converts pointer to tree element RB_ELEM into a pointer to the
+   structure that RB_ELEM is embedded inside.  Supply the name of
+   the outer structure STRUCT and the member name MEMBER of the
+   tree element. */
+#define rb_entry(RB_ELEM, STRUCT, MEMBER)               \
+	((STRUCT *) ((uint8_t *) &(RB_ELEM)->parent     \
+		- offsetof (STRUCT, MEMBER.parent)))
+
+/* Compares the value of two tree elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, or false
+   if A is greater than or equal to B. */
+typedef bool rb_less_func (const struct rb_elem *a,
+                           const struct rb_elem *b,
+                           void *aux);
+
+/* Tree. */
+struct rbtree {
+	struct rb_elem *root;       /* Root, or NULL if empty. */
+	struct rb_elem *min;        /* Least element, or NULL if empty. */
+	size_t size;                /* Number of elements. */
+	rb_less_func *less;         /* Comparison function. */
+	void *aux;                  /* Auxiliary data for `less'. */
+};
+
+void rb_init (struct rbtree *, rb_less_func *, void *aux);
+
+/* Insertion and removal. */
+void rb_insert (struct rbtree *, struct rb_elem *);
+void rb_remove (struct rbtree *, struct rb_elem *);
+
+/* Lookup.  KEY need not be in the tree: it is an element, usually
+   of a structure on the stack, with just the compared members set. */
+struct rb_elem *rb_find (struct rbtree *, const struct rb_elem *key);
+struct rb_elem *rb_lower_bound (struct rbtree *, const struct rb_elem *key);
+struct rb_elem *rb_upper_bound (struct rbtree *, const struct rb_elem *key);
+struct rb_elem *rb_floor (struct rbtree *, const struct rb_elem *key);
+
+/* Traversal. */
+struct rb_elem *rb_min (struct rbtree *);
+struct rb_elem *rb_max (struct rbtree *);
+struct rb_elem *rb_next (struct rb_elem *);
+struct rb_elem *rb_prev (struct rb_elem *);
+
+/* Tree properties. */
+size_t rb_size (struct rbtree *);
+bool rb_empty (struct rbtree *);
+
+#endif /* lib/kernel/rbtree.h */
@@ -0,0 +1,20 @@
+#ifndef __LIB_MEMSTAT_H
+#define __LIB_MEMSTAT_H
+
+#include <stdint.h>
+
+/* Kernel memory usage, as reported by the memstat system call.
+   Counts of free pages include pages held in the page allocator's
+   per-CPU and pre-zeroed caches. */
+struct memstat {
+	uint64_t kernel_pages;      /* Pages in the kernel pool. */
+	uint64_t kernel_free;       /* Free pages in the kernel pool. */
+	uint64_t user_pages;        /* Pages in the user pool. */
+	uint64_t user_free;         /* Free pages in the user pool. */
+	uint64_t heap_bytes;        /* Bytes in live malloc() blocks. */
+	uint64_t heap_peak;         /* Highest value of heap_bytes. */
+	uint64_t heap_arenas;       /* Pages used as malloc() arenas. */
+	uint64_t heap_big_pages;    /* Pages in big malloc() blocks. */
+};
+
+#endif /* lib/memstat.h */
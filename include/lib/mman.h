@@ -0,0 +1,15 @@
+#ifndef __LIB_MMAN_H
+#define __LIB_MMAN_H
+
+/* Flags for the WRITABLE argument of the mmap system call.  Any
+   other nonzero bit still just makes the mapping writable. */
+#define MAP_POPULATE 0x100          /* Read in the whole mapping now. */
+
+/* Access patterns for the madvise system call. */
+#define MADV_NORMAL 0               /* No special treatment. */
+#define MADV_RANDOM 1               /* Expect random access: no readahead. */
+#define MADV_SEQUENTIAL 2           /* Expect sequential access. */
+#define MADV_WILLNEED 3             /* Will be needed soon: read it in. */
+#define MADV_DONTNEED 4             /* Not needed: free the memory. */
+
+#endif /* lib/mman.h */
@@ -0,0 +1,25 @@
+#ifndef __LIB_PERF_H
+#define __LIB_PERF_H
+
+#include <stdint.h>
+
+/* Hardware events counted by the performance monitoring unit. */
+enum perf_event {
+	PERF_CYCLES,                /* Core cycles, unhalted. */
+	PERF_INSTRUCTIONS,          /* Instructions retired. */
+	PERF_LLC_MISSES,            /* Last level cache misses. */
+	PERF_DTLB_MISSES,           /* Data TLB load misses that walked. */
+	PERF_BRANCH_MISSES,         /* Mispredicted branches retired. */
+	PERF_EVENT_CNT
+};
+
+/* Event counts of one thread, in user mode and in the kernel on its
+   behalf, as reported by the perf_read system call.  Bit E of VALID
+   is set if event E is counted; the CPU may have no counters at
+   all, or fewer than there are events. */
+struct perf_counts {
+	uint32_t valid;                     /* Events counted. */
+	uint64_t count[PERF_EVENT_CNT];     /* Indexed by enum perf_event. */
+};
+
+#endif /* lib/perf.h */
@@ -7,4 +7,8 @@ void random_init (unsigned seed);
 void random_bytes (void *, size_t);
 unsigned long random_ulong (void);
 
+/* A faster generator, with its own stream. */
+void random_fast_bytes (void *, size_t);
+unsigned long random_fast_ulong (void);
+
 #endif /* lib/random.h */
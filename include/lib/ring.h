@@ -0,0 +1,81 @@
+#ifndef __LIB_RING_H
+#define __LIB_RING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* A ring of system calls, as taken by the ring_enter system call.
+
+   A process queues operations at SQ_TAIL of the submission queue
+   and calls ring_enter(), which makes each queued call in order and
+   puts its result at CQ_TAIL of the completion queue, as many as
+   there is room for, and returns how many it made.  Dozens of small
+   reads and writes thus cost one trap.  The ring is in the process's
+   own memory; the indexes only ever grow, and wrap around the
+   queues modulo RING_ENTRIES.
+
+   OPCODE is the number of the system call to make, one of SYS_READ,
+   SYS_WRITE, SYS_PREAD, SYS_PWRITE, SYS_SEEK, SYS_TELL, SYS_CLOSE,
+   SYS_FILESIZE, SYS_READV, SYS_WRITEV, SYS_SENDFILE, SYS_FALLOCATE,
+   SYS_FSYNC and SYS_FDATASYNC, and ARGS are its arguments.  Its
+   result is what the call would return, 0 for calls that return
+   nothing and -1 for any other opcode. */
+
+/* Entries in each queue.  A power of two. */
+#define RING_ENTRIES 64
+
+/* A queued system call. */
+struct ring_sqe {
+	uint32_t opcode;                    /* SYS_* number. */
+	uint32_t unused;
+	uint64_t args[4];                   /* Its arguments. */
+	uint64_t user_data;                 /* Copied to the completion. */
+};
+
+/* The result of one. */
+struct ring_cqe {
+	uint64_t user_data;                 /* From the submission. */
+	int64_t result;                     /* What the call returned. */
+};
+
+struct ring {
+	uint32_t sq_head;                   /* Next to make.  Kernel moves it. */
+	uint32_t sq_tail;                   /* Next to queue.  Process moves it. */
+	uint32_t cq_head;                   /* Next to reap.  Process moves it. */
+	uint32_t cq_tail;                   /* Next result.  Kernel moves it. */
+	struct ring_sqe sq[RING_ENTRIES];
+	struct ring_cqe cq[RING_ENTRIES];
+};
+
+/* Queues the system call OPCODE with arguments A0 to A3 in RING.
+   Returns false if the submission queue is full. */
+static inline bool
+ring_submit (struct ring *ring, uint32_t opcode, uint64_t a0, uint64_t a1,
+		uint64_t a2, uint64_t a3, uint64_t user_data) {
+	struct ring_sqe *sqe;
+
+	if (ring->sq_tail - ring->sq_head >= RING_ENTRIES)
+		return false;
+	sqe = &ring->sq[ring->sq_tail % RING_ENTRIES];
+	sqe->opcode = opcode;
+	sqe->args[0] = a0;
+	sqe->args[1] = a1;
+	sqe->args[2] = a2;
+	sqe->args[3] = a3;
+	sqe->user_data = user_data;
+	ring->sq_tail++;
+	return true;
+}
+
+/* Takes the oldest completion from RING into *CQE.  Returns false if
+   there is none. */
+static inline bool
+ring_reap (struct ring *ring, struct ring_cqe *cqe) {
+	if (ring->cq_head == ring->cq_tail)
+		return false;
+	*cqe = ring->cq[ring->cq_head % RING_ENTRIES];
+	ring->cq_head++;
+	return true;
+}
+
+#endif /* lib/ring.h */
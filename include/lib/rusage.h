@@ -0,0 +1,33 @@
+#ifndef __LIB_RUSAGE_H
+#define __LIB_RUSAGE_H
+
+#include <stdint.h>
+
+/* Whose resources getrusage() reports. */
+#define RUSAGE_SELF 0               /* The calling process. */
+#define RUSAGE_CHILDREN (-1)        /* Its children it waited for. */
+
+/* Resources used by a process, as reported by the getrusage system
+   call.
+
+   Time is measured with the TSC at every entry into and exit from
+   the kernel and at every context switch; CYCLES_PER_SEC converts
+   it to seconds.  A voluntary context switch is one where the
+   process blocked, an involuntary one where it was preempted.  I/O
+   counts the bytes returned by the read and write system calls and
+   their variants, from files, pipes and the console alike.  The
+   children's figures include those of their own waited-for
+   children. */
+struct rusage {
+	uint64_t user_cycles;       /* Running in user mode. */
+	uint64_t kernel_cycles;     /* Running in the kernel. */
+	uint64_t cycles_per_sec;    /* TSC frequency. */
+	uint64_t voluntary_switches;    /* Blocking switches. */
+	uint64_t involuntary_switches;  /* Preemptions. */
+	uint64_t minor_faults;      /* Page faults served from memory. */
+	uint64_t major_faults;      /* Page faults that paged in. */
+	uint64_t bytes_read;        /* Bytes read by system calls. */
+	uint64_t bytes_written;     /* Bytes written by system calls. */
+};
+
+#endif /* lib/rusage.h */
@@ -33,6 +33,39 @@ enum {
 
 	/* Extra for Project 2 */
 	SYS_DUP2,                   /* Duplicate the file descriptor */
+	SYS_SET_AFFINITY,           /* Restrict a process to a set of CPUs. */
+	SYS_GET_AFFINITY,           /* Report a process's CPU set. */
+	SYS_FUTEX_WAIT,             /* Sleep while a user word holds a value. */
+	SYS_FUTEX_WAKE,             /* Wake threads sleeping on a user word. */
+	SYS_MEMSTAT,                /* Report kernel memory usage. */
+	SYS_MADVISE,                /* Give a hint about memory use. */
+	SYS_MLOCK,                  /* Keep pages in memory. */
+	SYS_MUNLOCK,                /* Let locked pages be evicted again. */
+	SYS_VMSTAT,                 /* Report virtual memory events. */
+	SYS_DISKSTAT,               /* Report disk I/O. */
+	SYS_READV,                  /* Read into several buffers. */
+	SYS_WRITEV,                 /* Write from several buffers. */
+	SYS_PREAD,                  /* Read at a given file offset. */
+	SYS_PWRITE,                 /* Write at a given file offset. */
+	SYS_SENDFILE,               /* Copy between descriptors. */
+	SYS_FALLOCATE,              /* Reserve space for a file. */
+	SYS_FSYNC,                  /* Write a file to disk. */
+	SYS_FDATASYNC,              /* Write a file's data to disk. */
+	SYS_GETDENTS,               /* Read many directory entries. */
+	SYS_RING_ENTER,             /* Make the system calls queued in a ring. */
+	SYS_SPAWN,                  /* Start a new process from a program. */
+	SYS_VFORK,                  /* Create a process that borrows our memory. */
+	SYS_PIPE,                   /* Create a pipe. */
+	SYS_SHM_MAP,                /* Map a shared memory segment. */
+	SYS_SHM_UNLINK,             /* Remove a shared memory segment's name. */
+	SYS_SBRK,                   /* Grow or shrink the heap. */
+	SYS_PERF_READ,              /* Read hardware event counts. */
+	SYS_GETRUSAGE,              /* Report resources used. */
+	SYS_THREAD_SPAWN,           /* Start a thread in this process. */
+	SYS_THREAD_EXIT,            /* End the calling thread. */
+	SYS_SET_DEADLINE,           /* Reserve CPU time by deadline. */
+	SYS_SYSCTL,                 /* Read or set a kernel tunable. */
+	SYS_WAITANY,                /* Wait for whichever child exits first. */
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
@@ -0,0 +1,17 @@
+#ifndef __LIB_UIO_H
+#define __LIB_UIO_H
+
+#include <stddef.h>
+
+/* One buffer of a scatter-gather transfer, as taken by the readv
+   and writev system calls.  The buffers are filled or emptied in
+   order, as if they were one. */
+struct iovec {
+	void *iov_base;             /* Start of the buffer. */
+	size_t iov_len;             /* Bytes in the buffer. */
+};
+
+/* Most buffers in one readv or writev call. */
+#define IOV_MAX 32
+
+#endif /* lib/uio.h */
@@ -3,7 +3,17 @@
 
 #include <stdbool.h>
 #include <debug.h>
+#include <dirent.h>
+#include <diskstat.h>
+#include <memstat.h>
+#include <perf.h>
+#include <rusage.h>
+#include <mman.h>
+#include <ring.h>
+#include <vmstat.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <uio.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -25,7 +35,11 @@ void halt (void) NO_RETURN;
 void exit (int status) NO_RETURN;
 pid_t fork (const char *thread_name);
 int exec (const char *file);
+pid_t spawn (const char *file, char *const argv[]);
+pid_t vfork (void);
+int pipe (int fds[2]);
 int wait (pid_t);
+pid_t waitany (int *status);
 bool create (const char *file, unsigned initial_size);
 bool remove (const char *file);
 int open (const char *file);
@@ -37,10 +51,41 @@ unsigned tell (int fd);
 void close (int fd);
 
 int dup2(int oldfd, int newfd);
+bool set_affinity (pid_t, uint64_t mask);
+uint64_t get_affinity (pid_t);
+bool set_deadline (unsigned runtime, unsigned deadline, unsigned period);
+int sysctl (const char *name, size_t *oldval, const size_t *newval);
+int futex_wait (int *addr, int val);
+int futex_wake (int *addr, int n);
+void memstat (struct memstat *);
+bool diskstat (int disk, struct diskstat *);
+bool perf_read (struct perf_counts *);
+int getrusage (int who, struct rusage *);
+int readv (int fd, const struct iovec *iov, int iovcnt);
+int writev (int fd, const struct iovec *iov, int iovcnt);
+int pread (int fd, void *buffer, unsigned length, off_t offset);
+int pwrite (int fd, const void *buffer, unsigned length, off_t offset);
+int sendfile (int out_fd, int in_fd, off_t offset, unsigned length);
+int fallocate (int fd, off_t offset, off_t length);
+int fsync (int fd);
+int fdatasync (int fd);
+int getdents (int fd, void *buffer, unsigned size);
+int ring_enter (struct ring *ring);
+pid_t thread_spawn (void (*func) (void *), void *aux, void *stack, void *tls,
+		int *tidp);
+void thread_exit (void) NO_RETURN;
+void thread_join (int *tidp);
 
 /* Project 3 and optionally project 4. */
 void *mmap (void *addr, size_t length, int writable, int fd, off_t offset);
 void munmap (void *addr);
+int madvise (void *addr, size_t length, int advice);
+int mlock (void *addr, size_t length);
+int munlock (void *addr, size_t length);
+void vmstat (struct vmstat *thread, struct vmstat *system);
+void *shm_map (const char *name, void *addr, size_t length, int writable);
+bool shm_unlink (const char *name);
+void *sbrk (intptr_t increment);
 
 /* Project 4 only. */
 bool chdir (const char *dir);
@@ -0,0 +1,33 @@
+#ifndef __LIB_VMSTAT_H
+#define __LIB_VMSTAT_H
+
+#include <stdint.h>
+
+/* Number of buckets in the fault latency histogram.  Bucket 0 counts
+   faults that took fewer than 2^(VMSTAT_SHIFT + 1) TSC cycles,
+   bucket I > 0 those that took from 2^(VMSTAT_SHIFT + I) up to
+   2^(VMSTAT_SHIFT + I + 1), and the last bucket everything slower. */
+#define VMSTAT_BUCKETS 16
+#define VMSTAT_SHIFT 10
+
+/* Virtual memory events, as reported by the vmstat system call,
+   either for one thread or for the whole system, and the current
+   size of its memory.
+
+   A minor fault is served from memory.  A major fault is on a page
+   whose contents had been paged out to a file or swap.  The working
+   set is made of the pages accessed between the last two scans of
+   the accessed bits, which run about once a second. */
+struct vmstat {
+	uint64_t minor_faults;      /* Not-present faults without paging in. */
+	uint64_t major_faults;      /* Not-present faults that paged in. */
+	uint64_t cow_faults;        /* Writes to copy-on-write pages. */
+	uint64_t stack_faults;      /* Faults that grew the stack. */
+	uint64_t evictions;         /* Pages evicted from memory. */
+	uint64_t swap_ins;          /* Anonymous pages brought back in. */
+	uint64_t resident_pages;    /* Pages in memory now. */
+	uint64_t working_set_pages; /* Pages accessed lately. */
+	uint64_t latency[VMSTAT_BUCKETS]; /* Faults handled, by cycles. */
+};
+
+#endif /* lib/vmstat.h */
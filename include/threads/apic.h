@@ -0,0 +1,33 @@
+#ifndef THREADS_APIC_H
+#define THREADS_APIC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Vectors of the interrupts the local APIC raises itself.  Like
+   the I/O APIC's, which are those of the PICs, they are external
+   interrupts. */
+#define APIC_VEC_TIMER 0x30         /* Local APIC timer. */
+#define APIC_VEC_TLB 0x31           /* TLB shootdown IPI. */
+#define APIC_VEC_RESCHED 0x32       /* Reschedule IPI; see thread_unblock(). */
+#define APIC_VEC_TICK 0x33          /* Timer tick, for the other CPUs. */
+#define APIC_VEC_SPURIOUS 0xff      /* Spurious; never acknowledged. */
+
+/* If true, interrupts go through the PICs even if there is an APIC.
+   Controlled by kernel command-line option "-noapic". */
+extern bool apic_disabled;
+
+bool apic_init (void);
+void apic_init_ap (void);
+bool apic_enabled (void);
+void apic_eoi (void);
+
+void apic_timer_start (uint32_t count);
+uint32_t apic_timer_read (void);
+
+void apic_send_ipi (int cpu, uint8_t vec);
+void apic_send_ipi_others (uint8_t vec);
+void apic_send_nmi_others (void);
+void apic_start_ap (int apic_id, uint64_t pa);
+
+#endif /* threads/apic.h */
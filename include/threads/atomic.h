@@ -0,0 +1,51 @@
+#ifndef THREADS_ATOMIC_H
+#define THREADS_ATOMIC_H
+
+#include <stdint.h>
+
+/* Atomic operations on aligned integers.
+
+   These are single locked x86-64 instructions, so they are safe
+   against interrupt handlers and other CPUs without disabling
+   interrupts or taking a lock.  Use them for simple counters such
+   as ID generators and statistics; anything that must update more
+   than one word consistently still needs a lock.
+
+   Each operation is also a compiler barrier, like barrier() in
+   synch.h. */
+
+/* Atomically adds N to *P and returns the old value of *P. */
+static inline int
+atomic_fetch_add (int *p, int n) {
+	asm volatile ("lock xaddl %0, %1" : "+r" (n), "+m" (*p) : : "memory");
+	return n;
+}
+
+/* Atomically adds N to *P and returns the old value of *P. */
+static inline int64_t
+atomic_fetch_add_64 (int64_t *p, int64_t n) {
+	asm volatile ("lock xaddq %0, %1" : "+r" (n), "+m" (*p) : : "memory");
+	return n;
+}
+
+/* Atomically stores N into *P and returns the old value of *P. */
+static inline int
+atomic_xchg (int *p, int n) {
+	asm volatile ("xchgl %0, %1" : "+r" (n), "+m" (*p) : : "memory");
+	return n;
+}
+
+/* Atomically increments *P. */
+static inline void
+atomic_inc_64 (int64_t *p) {
+	asm volatile ("lock incq %0" : "+m" (*p) : : "memory");
+}
+
+/* Returns *P.  Aligned 64-bit loads cannot tear on x86-64; this
+   only keeps the compiler from caching or splitting the load. */
+static inline int64_t
+atomic_read_64 (const int64_t *p) {
+	return *(const volatile int64_t *) p;
+}
+
+#endif /* threads/atomic.h */
@@ -0,0 +1,92 @@
+#ifndef THREADS_CPU_H
+#define THREADS_CPU_H
+
+#include <list.h>
+#include <rbtree.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "threads/interrupt.h"
+#include "threads/spinlock.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Most CPUs the kernel keeps state for.  cpus[0] is the CPU that
+   booted; smp_init() starts as many of the others as the -smp
+   option asks for, up to this. */
+#define NCPU 8
+
+/* Affinity mask with a bit set for every CPU. */
+#define CPU_MASK_ALL ((uint64_t) -1 >> (64 - NCPU))
+
+/* Per-CPU scheduler state.  Owned by thread.c. */
+struct cpu {
+	int id;                             /* Index in cpus[]. */
+	int apic_id;                        /* Local APIC ID, to send IPIs. */
+	struct thread *idle_thread;         /* This CPU's idle thread. */
+
+	/* Run queue of threads in THREAD_READY state.  There is one
+	   FIFO list per priority level, and bit N of ready_bitmap is
+	   set if and only if ready_queue[N] is not empty, so the
+	   highest ready priority is found with a single bit scan.
+	   Under -fair the threads are in fair_queue instead, ordered
+	   by vruntime, and ready_bitmap stays 0.  Deadline threads are
+	   in dl_queue, earliest deadline first, and run before all. */
+	struct spinlock rq_lock;            /* Protects the six below. */
+	struct list ready_queue[PRI_CNT];
+	uint64_t ready_bitmap;
+	struct rbtree fair_queue;
+	int64_t min_vruntime;               /* Never decreases; see thread.c. */
+	struct rbtree dl_queue;
+	int nr_ready;                       /* Threads in any queue. */
+
+	/* Scheduling. */
+	unsigned thread_ticks;              /* Timer ticks since last yield. */
+	volatile int need_resched;          /* Written to wake our idle thread. */
+
+	/* Owned by interrupt.c. */
+	bool in_external_intr;              /* Processing an external interrupt? */
+	bool yield_on_return;               /* Yield on interrupt return? */
+
+	/* Owned by fpu.c. */
+	struct thread *fpu_owner;           /* Whose state the FPU holds. */
+	bool fpu_kernel;                    /* In kernel_fpu_begin()? */
+	enum intr_level fpu_level;          /* Level before kernel_fpu_begin(). */
+
+	/* Owned by rcu.c. */
+	int rcu_readers[2];                 /* Readers by epoch parity. */
+
+	/* Owned by userprog/process.c. */
+	uint64_t fs_base;                   /* FS base loaded, see process_activate(). */
+};
+
+extern struct cpu cpus[NCPU];
+
+/* Number of CPUs online, cpus[0] through cpus[cpu_cnt - 1].  Code
+   that waits on or balances across the other CPUs looks only at
+   these; the rest of cpus[] is never used. */
+extern int cpu_cnt;
+
+/* Affinity mask with a bit set for every CPU online. */
+#define CPU_MASK_ONLINE ((uint64_t) -1 >> (64 - cpu_cnt))
+
+/* True once smp_init() has begun to start the other CPUs.  Until
+   then everything runs on cpus[0], and this_cpu() must not look at
+   the running thread, because PANIC() may call it before
+   thread_init() has made the running code a thread. */
+extern bool smp_started;
+
+/* Returns the CPU we are running on.  Everything a CPU runs, even
+   an interrupt handler, is on the stack of its running thread, and
+   a thread's on_cpu is set before it is switched to and cleared
+   only after it has been switched out. */
+static inline struct cpu *
+this_cpu (void) {
+	uint64_t rsp;
+
+	if (!smp_started)
+		return &cpus[0];
+	asm ("movq %%rsp, %0" : "=r" (rsp));
+	return ((struct thread *) pg_round_down (rsp))->on_cpu;
+}
+
+#endif /* threads/cpu.h */
@@ -1,99 +1,92 @@
-#include <debug.h>
-#include <list.h>
+#ifndef THREADS_FIXED_POINT_H
+#define THREADS_FIXED_POINT_H
+
 #include <stdint.h>
-#include "threads/interrupt.h"
-
-#define F (1 << 14) //fixed point 1
-#define INT_MAX ((1 << 31) - 1)
-#define INT_MIN (-(1 << 31))
-
-// x and y denote fixed_point numbers in 17.14 format
-// n is an integer
-int int_to_fp(int n); /* integer를 fixed point로 전환 */
-int fp_to_int_round(int x); /* FP를 int로 전환(반올림) */
-int fp_to_int(int x); /* FP를 int로 전환(버림) */
-int add_fp(int x, int y); /* FP의 덧셈 */
-int add_mixed(int x, int n); /* FP와 int의 덧셈 */
-int sub_fp(int x, int y); /* FP의 뺄셈(x-y) */
-int sub_mixed(int x, int n); /* FP와 int의 뺄셈(x-n) */
-int mult_fp(int x, int y); /* FP의 곱셈 */
-int mult_mixed(int x, int y); /* FP와 int의 곱셈 */
-int div_fp(int x, int y); /* FP의 나눗셈(x/y) */
-int div_mixed(int x, int n); /* FP와 int 나눗셈(x/n) */
+
+/* 17.14 fixed-point arithmetic for the MLFQS.
+
+   All operations are static inline so that the scheduler's
+   per-tick and per-second math compiles down to a few
+   instructions with interrupts off, instead of a chain of calls.
+
+   x, y: fixed point
+   n: int */
 
 #define F (1 << 14) // fixed point 1: 0 00000000000000001 00000000000000
                     // 1 bit(sign), 17 bit(정수부), 14 bit(소수부)
                     // sign이 0이면 양수, 1이면 음수
-#define INT_MAX ((1 << 31) - 1) // 0 11111111111111111 11111111111111
-#define INT_MIN (-(1 << 31))    // 1 00000000000000000 00000000000000
 
-/* 
+/*
     만약 recent_cpu 가 2.75 라는 값을 가진다면
-    [0 00000000000000010 11000000000000] (소수부의 각 비트는 2^(-1), 2^(-2), ... ) 
+    [0 00000000000000010 11000000000000] (소수부의 각 비트는 2^(-1), 2^(-2), ... )
     = 45056
 */
 
-/* 
-    x, y: fixed point
-    n: int
-*/
+/* Fixed-point value of the fraction N/D, for integer constants N
+   and D; folded at compile time. */
+#define FP_FRAC(N, D) ((int) (((int64_t) (N) * F) / (D)))
+
+/* load_avg = (59/60) * load_avg + (1/60) * ready_threads */
+#define FP_LOAD_AVG_DECAY FP_FRAC (59, 60)
+#define FP_LOAD_AVG_GAIN FP_FRAC (1, 60)
 
 /* integer를 fixed point로 전환 */
-int int_to_fp(int n) {
+static inline int int_to_fp (int n) {
     return n * F;
-} 
+}
 
 /* FP를 int로 전환(반올림) */
-int fp_to_int_round(int x) {
+static inline int fp_to_int_round (int x) {
     if (x >= 0)
         return (x + F / 2) / F;
     else
         return (x - F / 2) / F;
-    // return (int)floor((x / 2^14) + 0.5);
-} 
+}
 
 /* FP를 int로 전환(버림) */
-int fp_to_int(int x) {
+static inline int fp_to_int (int x) {
     return x / F;
-    // return (int)floor(x / 2^14);
 }
 
 /* FP의 덧셈 */
-int add_fp(int x, int y) {
+static inline int add_fp (int x, int y) {
     return x + y;
 }
 
 /* FP와 int의 덧셈 */
-int add_mixed(int x, int n) {
+static inline int add_mixed (int x, int n) {
     return x + n * F;
 }
 
 /* FP의 뺄셈(x-y) */
-int sub_fp(int x, int y) {
+static inline int sub_fp (int x, int y) {
     return x - y;
 }
 
 /* FP와 int의 뺄셈(x-n) */
-int sub_mixed(int x, int n) {
+static inline int sub_mixed (int x, int n) {
     return x - n * F;
 }
 
 /* FP의 곱셈 */
-int mult_fp(int x, int y) {
-    return ((int64_t) x) * y / F; // 두 개의 fp 를 곱하면 32bit * 32bit 로 32bit 를 초과하는 값이 발생하기 때문에 x 를 64bit 로 일시적으로 바꿔준 후 곱하기 연산을 하여 오버플로우를 방지하고 계산 결과로 나온 64bit 값을 F 로 나눠서 다시 32bit 값으로 만들어 줌
+/* 32bit * 32bit 는 32bit 를 초과할 수 있으므로 64bit 로 곱한 후 F 로 나눠서 다시 32bit 값으로 만들어 줌 */
+static inline int mult_fp (int x, int y) {
+    return ((int64_t) x) * y / F;
 }
 
 /* FP와 int의 곱셈 */
-int mult_mixed(int x, int n) {
+static inline int mult_mixed (int x, int n) {
     return x * n;
 }
 
 /* FP의 나눗셈(x/y) */
-int div_fp(int x, int y) {
-    return ((int64_t)x) * F / y;
+static inline int div_fp (int x, int y) {
+    return ((int64_t) x) * F / y;
 }
 
 /* FP와 int 나눗셈(x/n) */
-int div_mixed(int x, int n) {
+static inline int div_mixed (int x, int n) {
     return x / n;
-}
\ No newline at end of file
+}
+
+#endif /* threads/fixed_point.h */
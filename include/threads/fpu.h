@@ -0,0 +1,23 @@
+#ifndef THREADS_FPU_H
+#define THREADS_FPU_H
+
+#include <stdbool.h>
+
+struct thread;
+
+void fpu_init (void);
+void fpu_init_ap (void);
+void fpu_init_smp (void);
+void fpu_switch (struct thread *next);
+bool fpu_fork (struct thread *child, struct thread *parent);
+void fpu_release (struct thread *);
+void fpu_print_stats (void);
+
+/* Sections of kernel code that use SSE registers. */
+void kernel_fpu_begin (void);
+void kernel_fpu_end (void);
+
+void fpu_copy_page (void *dst, const void *src);
+void fpu_zero_page (void *dst);
+
+#endif /* threads/fpu.h */
@@ -26,6 +26,10 @@
 #define LOADER_ARGS (LOADER_SIG - LOADER_ARGS_LEN)     /* Command-line args. */
 #define LOADER_ARG_CNT (LOADER_ARGS - LOADER_ARG_CNT_LEN) /* Number of args. */
 
+/* Page where application processors start, in real mode; see
+   threads/ap-start.S.  Below the kernel, so never allocated. */
+#define LOADER_AP_START 0x8000
+
 /* Sizes of loader data structures. */
 #define LOADER_SIG_LEN 2
 #define LOADER_ARGS_LEN 128 // 인자의 최대 길이가 128 바이트 (즉 128글자 라는 것)
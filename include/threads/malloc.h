@@ -2,12 +2,28 @@
 #define THREADS_MALLOC_H
 
 #include <debug.h>
+#include <stdbool.h>
 #include <stddef.h>
 
+/* Record the allocation site of every block? */
+extern bool malloc_tags;
+
 void malloc_init (void);
 void *malloc (size_t) __attribute__ ((malloc));
 void *calloc (size_t, size_t) __attribute__ ((malloc));
 void *realloc (void *, size_t);
 void free (void *);
 
+/* Object caches for fixed-size objects. */
+struct kmem_cache;
+typedef void kmem_ctor_func (void *obj);
+struct kmem_cache *kmem_cache_create (const char *name, size_t size,
+                                      size_t align, kmem_ctor_func *);
+void *kmem_cache_alloc (struct kmem_cache *) __attribute__ ((malloc));
+void kmem_cache_free (struct kmem_cache *, void *);
+
+struct memstat;
+void malloc_get_stats (struct memstat *);
+void malloc_print_stats (void);
+
 #endif /* threads/malloc.h */
@@ -2,19 +2,47 @@
 #define THREAD_MMU_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include "threads/pte.h"
 
+/* A batch of pending TLB invalidations; see tlb_batch_begin(). */
+#define TLB_BATCH_MAX 32
+struct tlb_batch {
+	uint64_t *pml4;                     /* Page table being changed. */
+	size_t cnt;                         /* Pages added, may exceed MAX. */
+	const void *va[TLB_BATCH_MAX];      /* First TLB_BATCH_MAX pages. */
+};
+
 typedef bool pte_for_each_func (uint64_t *pte, void *va, void *aux);
 
 uint64_t *pml4e_walk (uint64_t *pml4, const uint64_t va, int create);
 uint64_t *pml4_create (void);
+bool pml4_map_large (uint64_t *pml4, uint64_t va, uint64_t pa, uint64_t size,
+		uint64_t perm);
+void pml4_split_large (uint64_t *pml4, uint64_t va, uint64_t *pt);
+void pml4_share_init (void);
+bool pml4_share_page (uint64_t *pml4, void *upage, uint64_t *src_pte);
 bool pml4_for_each (uint64_t *, pte_for_each_func *, void *);
 void pml4_destroy (uint64_t *pml4);
+void pml4_destroy_tables (uint64_t *pml4);
+void pml4_reset (uint64_t *pml4);
+void pml4_reset_tables (uint64_t *pml4);
 void pml4_activate (uint64_t *pml4);
+void tlb_init (void);
+void tlb_init_ap (void);
+void tlb_batch_begin (struct tlb_batch *, uint64_t *pml4);
+void tlb_batch_add (struct tlb_batch *, const void *va);
+void tlb_batch_flush (struct tlb_batch *);
+struct intr_frame;
+void tlb_shootdown_interrupt (struct intr_frame *);
 void *pml4_get_page (uint64_t *pml4, const void *upage);
 bool pml4_set_page (uint64_t *pml4, void *upage, void *kpage, bool rw);
 void pml4_clear_page (uint64_t *pml4, void *upage);
+void pml4_clear_range (uint64_t *pml4, void *upage, size_t cnt);
+void pml4_move_page (uint64_t *pml4, void *upage, void *kpage);
+void pml4_protect_range (uint64_t *pml4, void *upage, size_t cnt,
+		bool writable);
 bool pml4_is_dirty (uint64_t *pml4, const void *upage);
 void pml4_set_dirty (uint64_t *pml4, const void *upage, bool dirty);
 bool pml4_is_accessed (uint64_t *pml4, const void *upage);
@@ -1,6 +1,8 @@
 #ifndef THREADS_PALLOC_H
 #define THREADS_PALLOC_H
 
+#include <list.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
 
@@ -15,9 +17,27 @@ enum palloc_flags {
 extern size_t user_page_limit;
 
 uint64_t palloc_init (void);
+void palloc_zero_init (void);
 void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+bool palloc_isolate (void *block, size_t page_cnt, size_t used_cnt);
+
+/* A cache that borrows pages of the user pool and gives them back
+   when the pool runs short. */
+struct shrinker {
+	/* Frees up to PAGE_CNT pages of the user pool that the cache can
+	   do without, without sleeping, and returns how many it freed. */
+	size_t (*shrink) (size_t page_cnt);
+	struct list_elem elem;          /* Element in the shrinker list. */
+};
+
+void palloc_register_shrinker (struct shrinker *);
+size_t palloc_shrink (size_t page_cnt);
+
+struct memstat;
+void palloc_get_stats (struct memstat *);
+void palloc_print_stats (void);
 
 #endif /* threads/palloc.h */
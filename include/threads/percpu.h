@@ -0,0 +1,60 @@
+#ifndef THREADS_PERCPU_H
+#define THREADS_PERCPU_H
+
+#include <stdint.h>
+#include "threads/atomic.h"
+#include "threads/cpu.h"
+
+/* Size of a cache line, in bytes. */
+#define CACHE_LINE_SIZE 64
+
+/* Per-CPU counter.
+
+   For statistics that are bumped often and read rarely.  Each CPU
+   adds to its own slot, which has a cache line to itself, so that
+   counting never moves a line between CPUs; reading sums the
+   slots.  The add is still a locked instruction, which costs little
+   on a line that stays in this CPU's cache, and keeps the count
+   right if the thread moves to another CPU between finding its
+   slot and adding to it, or is interrupted by a handler that
+   counts too.
+
+   The sum is a snapshot: adds that race with it may or may not be
+   in it.  A zeroed counter reads 0, so static counters need no
+   initialization. */
+struct percpu_counter {
+	struct {
+		int64_t cnt;
+	} __attribute__ ((aligned (CACHE_LINE_SIZE))) cpu[NCPU];
+};
+
+/* Adds N to counter C. */
+static inline void
+percpu_counter_add (struct percpu_counter *c, int64_t n) {
+	atomic_fetch_add_64 (&c->cpu[this_cpu ()->id].cnt, n);
+}
+
+/* Adds 1 to counter C. */
+static inline void
+percpu_counter_inc (struct percpu_counter *c) {
+	percpu_counter_add (c, 1);
+}
+
+/* Returns the sum of counter C over all CPUs. */
+static inline int64_t
+percpu_counter_read (const struct percpu_counter *c) {
+	int64_t sum = 0;
+
+	for (int i = 0; i < NCPU; i++)
+		sum += atomic_read_64 (&c->cpu[i].cnt);
+	return sum;
+}
+
+/* Sets counter C to 0.  Adds that race with this may be lost. */
+static inline void
+percpu_counter_reset (struct percpu_counter *c) {
+	for (int i = 0; i < NCPU; i++)
+		c->cpu[i].cnt = 0;
+}
+
+#endif /* threads/percpu.h */
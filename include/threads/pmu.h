@@ -0,0 +1,13 @@
+#ifndef THREADS_PMU_H
+#define THREADS_PMU_H
+
+#include <perf.h>
+
+struct thread;
+
+void pmu_init (void);
+void pmu_switch (struct thread *prev);
+void pmu_read (struct perf_counts *);
+void pmu_print_stats (void);
+
+#endif /* threads/pmu.h */
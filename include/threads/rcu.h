@@ -0,0 +1,43 @@
+#ifndef THREADS_RCU_H
+#define THREADS_RCU_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Epoch-based reclamation; see rcu.c. */
+
+struct rcu_head;
+
+/* Called with HEAD once no reader can still see the object that
+   embeds it. */
+typedef void rcu_func (struct rcu_head *head);
+
+/* Embedded in an object whose freeing is deferred with
+   call_rcu(). */
+struct rcu_head {
+	struct list_elem elem;      /* Element in a callback list. */
+	rcu_func *func;             /* Function to call. */
+};
+
+/* Converts pointer to rcu_head RCU_HEAD into a pointer to the
+   structure that RCU_HEAD is embedded inside.  Supply the name of
+   the outer structure STRUCT and the member name MEMBER of the
+   rcu_head. */
+#define rcu_entry(RCU_HEAD, STRUCT, MEMBER)                     \
+	((STRUCT *) ((uint8_t *) &(RCU_HEAD)->elem              \
+		- offsetof (STRUCT, MEMBER.elem)))
+
+void rcu_init (void);
+
+int rcu_read_lock (void);
+void rcu_read_unlock (int epoch);
+
+void call_rcu (struct rcu_head *, rcu_func *);
+void rcu_synchronize (void);
+
+void rcu_tick (void);
+bool rcu_pending (void);
+
+#endif /* threads/rcu.h */
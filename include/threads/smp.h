@@ -0,0 +1,12 @@
+#ifndef THREADS_SMP_H
+#define THREADS_SMP_H
+
+/* Number of CPUs to run on, counting the boot CPU, if there are that
+   many.  Controlled by kernel command-line option "-smp=N"; 1 by
+   default. */
+extern int smp_cpus;
+
+void smp_init (void);
+void smp_halt_others (void);
+
+#endif /* threads/smp.h */
@@ -0,0 +1,25 @@
+#ifndef THREADS_SOFTIRQ_H
+#define THREADS_SOFTIRQ_H
+
+#include <list.h>
+#include <stdbool.h>
+
+/* Work an interrupt handler defers until after the interrupt; see
+   softirq.c. */
+typedef void softirq_func (void *aux);
+
+struct softirq_work {
+	struct list_elem elem;      /* Element in the CPU's queue. */
+	softirq_func *func;         /* Function to run. */
+	void *aux;                  /* Its argument. */
+	bool queued;                /* In a queue, not yet run? */
+};
+
+void softirq_init (void);
+void softirq_work_init (struct softirq_work *, softirq_func *, void *aux);
+void softirq_queue (struct softirq_work *);
+bool softirq_pending (void);
+bool softirq_active (void);
+void softirq_run (void);
+
+#endif /* threads/softirq.h */
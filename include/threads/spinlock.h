@@ -0,0 +1,77 @@
+#ifndef THREADS_SPINLOCK_H
+#define THREADS_SPINLOCK_H
+
+#include <debug.h>
+#include "threads/atomic.h"
+#include "threads/interrupt.h"
+
+/* Spinlock.
+
+   Protects short critical sections that may be entered from
+   interrupt handlers or, on a multiprocessor, from another CPU.
+   Acquiring a spinlock disables interrupts on this CPU, so a
+   holder is never preempted, and then busy-waits on the lock
+   word.  The previous interrupt level is saved in the lock and
+   restored when it is released, so spinlocks must be released in
+   the reverse order of acquisition.
+
+   Never sleep while holding a spinlock.  With a single CPU the
+   lock word is always free when we get here, so the cost is that
+   of intr_disable() plus one locked instruction. */
+struct spinlock {
+	int locked;                 /* Nonzero while held. */
+	enum intr_level old_level;  /* Interrupt level before acquire. */
+};
+
+#define SPINLOCK_INITIALIZER { 0, INTR_OFF }
+
+static inline void
+spin_lock_init (struct spinlock *lock) {
+	lock->locked = 0;
+}
+
+static inline void
+spin_lock (struct spinlock *lock) {
+	enum intr_level old_level = intr_disable ();
+
+	while (atomic_xchg (&lock->locked, 1) != 0)
+		while (lock->locked)
+			asm volatile ("pause" : : : "memory");
+	lock->old_level = old_level;
+}
+
+static inline void
+spin_unlock (struct spinlock *lock) {
+	enum intr_level old_level = lock->old_level;
+
+	ASSERT (lock->locked);
+	atomic_xchg (&lock->locked, 0);
+	intr_set_level (old_level);
+}
+
+/* Releases LOCK like spin_unlock(), but leaves interrupts off and
+   returns the level that spin_unlock() would have restored.  For a
+   holder that must let go of LOCK before it can block; see
+   thread_block_on(). */
+static inline enum intr_level
+spin_unlock_irqoff (struct spinlock *lock) {
+	enum intr_level old_level = lock->old_level;
+
+	ASSERT (lock->locked);
+	atomic_xchg (&lock->locked, 0);
+	return old_level;
+}
+
+/* Takes LOCK back after spin_unlock_irqoff(), with interrupts still
+   off, so that the matching spin_unlock() restores OLD_LEVEL. */
+static inline void
+spin_relock (struct spinlock *lock, enum intr_level old_level) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	while (atomic_xchg (&lock->locked, 1) != 0)
+		while (lock->locked)
+			asm volatile ("pause" : : : "memory");
+	lock->old_level = old_level;
+}
+
+#endif /* threads/spinlock.h */
@@ -0,0 +1,19 @@
+#ifndef THREADS_SWITCH_H
+#define THREADS_SWITCH_H
+
+#include <stdint.h>
+
+struct intr_frame;
+struct thread;
+
+/* Switches from the running thread, whose saved stack pointer goes
+   to *CUR_RSP, to the thread whose stack pointer NEXT_RSP was saved
+   by an earlier switch, or, if NEXT_RSP is 0, launches a new thread
+   from NEXT_TF.  Returns, in the next thread, the thread switched
+   from, for schedule_tail(); a new thread calls schedule_tail()
+   before it is launched.  Interrupts must be off.  Defined in
+   threads/switch.S. */
+struct thread *switch_threads (uint64_t *cur_rsp, uint64_t next_rsp,
+		struct intr_frame *next_tf);
+
+#endif /* threads/switch.h */
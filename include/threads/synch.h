@@ -1,13 +1,19 @@
 #ifndef THREADS_SYNCH_H
 #define THREADS_SYNCH_H
 
+#include <heap.h>
+#include <limits.h>
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include "threads/spinlock.h"
+
+struct thread;
 
 /* A counting semaphore. */
 struct semaphore {
 	unsigned value;             /* Current value. */
-	struct list waiters;        /* List of waiting threads. */
+	struct heap waiters;        /* Waiting threads, highest priority on top. */
 };
 
 // 세마포어를 주어진 value로 초기화
@@ -17,14 +23,35 @@ void sema_down (struct semaphore *);
 bool sema_try_down (struct semaphore *);
 // 세마포어를 반환하고 value를 1 높임
 void sema_up (struct semaphore *);
+void sema_up_noyield (struct semaphore *);
 void sema_self_test (void);
 
+/* Contention statistics of a lock registered with
+   lock_register().  Only the holder updates them. */
+struct lock_stats {
+	char name[24];
+	int64_t acquisitions;       /* Times the lock was taken. */
+	int64_t contended;          /* Times the taker had to wait. */
+	int64_t wait_cycles;        /* TSC cycles spent waiting, in total. */
+	int64_t max_wait_cycles;    /* Longest single wait. */
+	int64_t hold_cycles;        /* TSC cycles the lock was held, in total. */
+	uint64_t acquired_at;       /* TSC when the holder took it. */
+};
+
 /* Lock. */
 struct lock {
 	struct thread *holder;      /* Thread holding lock (for debugging). */
 	struct semaphore semaphore; /* Binary semaphore controlling access. */
+	struct heap_elem elem;      /* Element in holder's held_locks. */
+	int max_priority;           /* Highest priority donated by waiters. */
+	struct lock_stats *stats;   /* Statistics, or null if not registered. */
+	unsigned barge_limit;       /* See lock_set_handoff(). */
+	unsigned barges;            /* Takes past waiters since one got it. */
 };
 
+/* lock_set_handoff() limit that never hands off, the default. */
+#define LOCK_BARGE_UNLIMITED UINT_MAX
+
 // lock 자료 구조를 초기화
 void lock_init (struct lock *);
 // lock을 요청
@@ -33,23 +60,43 @@ bool lock_try_acquire (struct lock *);
 // lock을 반환
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
+void lock_register (struct lock *, const char *name);
+void lock_set_handoff (struct lock *, unsigned barge_limit);
+void lock_print_stats (void);
 
 /* Condition variable. */
 struct condition {
-	struct list waiters;        /* List of waiting threads. */
+	struct heap waiters;        /* Waiting threads, highest priority on top. */
 };
 /* condition variable 자료구조를 초기화 */
 void cond_init (struct condition *);
 /* condition variable을 통해 signal이 오는지 기다림 */
 void cond_wait (struct condition *, struct lock *);
-/* waiters list를 우선순위를 재정렬하고,  */
 /* condition variable에서 기다리는 가장 높은 우선순위의 쓰레드에 signal을 보냄 */
 void cond_signal (struct condition *, struct lock *);
 /* condition variable에서 기다리는 모든 쓰레드에 signal을 보냄 */
 void cond_broadcast (struct condition *, struct lock *);
 
-bool cmp_sem_priority (const struct list_elem *a, const struct list_elem *b, void *aux);
-bool cmp_donation_priority (const struct list_elem *a, const struct list_elem *b, void *aux);
+/* Reader-writer lock. */
+struct rwlock {
+	struct lock writer;         /* Held by the active or draining writer. */
+	struct spinlock guard;      /* Protects the fields below. */
+	int readers;                /* Number of active readers. */
+	bool draining;              /* A writer is waiting for readers to leave. */
+	struct semaphore drained;   /* Upped by the last reader to leave. */
+};
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+bool rwlock_write_held_by_current_thread (const struct rwlock *);
+
+bool cmp_sem_priority (const struct heap_elem *a, const struct heap_elem *b, void *aux);
+void synch_waiter_update (struct thread *);
+void synch_change_priority (struct thread *, int priority);
+bool cmp_lock_priority (const struct heap_elem *a, const struct heap_elem *b, void *aux);
 
 void donate_priority(void); 
 void remove_with_lock(struct lock *lock); 
@@ -61,4 +108,55 @@ void refresh_priority(void);
  * reference guide for more information.*/
 #define barrier() asm volatile ("" : : : "memory")
 
+/* Sequence lock.
+
+   For small read-mostly data that is written from interrupt
+   context, where readers must not block the writer and should
+   not write to shared memory themselves.  A writer holds LOCK and
+   makes SEQ odd for the duration of its update.  A reader takes
+   no lock: it notes SEQ before reading, and retries if SEQ was
+   odd or has changed since.
+
+       unsigned seq;
+       do {
+           seq = seqlock_read_begin (&sl);
+           ...copy the protected fields...
+       } while (seqlock_read_retry (&sl, seq));
+
+   A reader may see a torn copy before it retries, so it must not
+   follow pointers or otherwise act on what it read inside the
+   loop.  Readers on the writer's own CPU are never entered during
+   an update, since the writer's spinlock has interrupts off. */
+struct seqlock {
+	volatile unsigned seq;      /* Odd while a writer is updating. */
+	struct spinlock lock;       /* Serializes writers. */
+};
+
+void seqlock_init (struct seqlock *);
+void seqlock_write_begin (struct seqlock *);
+void seqlock_write_end (struct seqlock *);
+
+/* Returns the sequence to pass to seqlock_read_retry(), waiting
+   out an update in progress.  x86 does not reorder loads with
+   other loads, so a compiler barrier orders SEQ before the
+   protected fields. */
+static inline unsigned
+seqlock_read_begin (const struct seqlock *sl) {
+	unsigned seq;
+
+	while ((seq = sl->seq) & 1)
+		asm volatile ("pause" : : : "memory");
+	barrier ();
+	return seq;
+}
+
+/* Returns true if a writer has updated SL since
+   seqlock_read_begin() returned SEQ, so the read must be
+   repeated. */
+static inline bool
+seqlock_read_retry (const struct seqlock *sl, unsigned seq) {
+	barrier ();
+	return sl->seq != seq;
+}
+
 #endif /* threads/synch.h */
\ No newline at end of file
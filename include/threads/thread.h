@@ -2,7 +2,12 @@
 #define THREADS_THREAD_H
 
 #include <debug.h>
+#include <heap.h>
 #include <list.h>
+#include <ohash.h>
+#include <perf.h>
+#include <rbtree.h>
+#include <rusage.h>
 #include <stdint.h>
 #include "threads/interrupt.h"
 #include "threads/synch.h"
@@ -24,10 +29,37 @@ enum thread_status {
 typedef int tid_t;
 #define TID_ERROR ((tid_t) -1)          /* Error value for tid_t. */
 
+/* What a parent keeps of each child it creates: what fork() and
+   wait() synchronize on, and the exit status.  Parent and child
+   share it and whichever lets go of it last frees it, so an exited
+   child's thread is freed at once while its status waits for the
+   parent.  A child that exits before its parent also queues it on
+   the parent process's exited_children, for waitany(). */
+struct child_status {
+	tid_t tid;                          /* The child's. */
+	int exit_status;                    /* Set by the child as it exits. */
+	int refcnt;                         /* Holders: the parent, the child. */
+	struct semaphore fork_sema;         /* Up once the child has started. */
+	struct semaphore wait_sema;         /* Up once the child has exited. */
+	struct ohash_elem elem;             /* In the parent's children. */
+	struct rusage rusage;               /* The child's and its children's. */
+	struct process *parent;             /* Null once the parent has exited. */
+	struct list_elem exit_elem;         /* In the parent's exited_children. */
+	bool listed;                        /* In exited_children? */
+	bool claimed;                       /* Taken by a wait() or waitany()? */
+};
+
 /* Thread priorities. */
 #define PRI_MIN 0                       /* Lowest priority. */
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
+#define PRI_CNT (PRI_MAX - PRI_MIN + 1) /* Number of priority levels. */
+
+/* I/O priority classes, in the order the disk serves them. */
+#define IOPRIO_RT 0                     /* Ahead of everything else. */
+#define IOPRIO_BE 1                     /* Best effort. */
+#define IOPRIO_IDLE 2                   /* When nothing else waits. */
+#define IOPRIO_NONE (-1)                /* Follow the priority. */
 
 
 #define NICE_DEFAULT 0
@@ -37,8 +69,63 @@ typedef int tid_t;
 
 /* --- project 2: system call --- */
 
-#define FDT_PAGES 3
-#define FDCOUNT_LIMIT FDT_PAGES *(1<<9) // limit fdidx
+#define FDT_INITIAL 16          /* Slots in a new file descriptor table. */
+#define FDCOUNT_LIMIT 1536      /* Most slots it may grow to. */
+
+/* Bytes of a file descriptor table with CAP slots: the slots, then
+   a bitmap of the ones in use, one bit per fd. */
+#define FDT_BYTES(CAP) \
+	((CAP) * sizeof (struct file *) + ((CAP) + 63) / 64 * sizeof (uint64_t))
+
+/* What the threads of one user process share.  thread_create() makes
+   each new thread a process of its own, with one thread, and
+   process_thread_spawn() (userprog/process.c) adds threads to the
+   running thread's.  The threads share the address space, the page
+   table and, with VM, the supplemental page table, which any of them
+   may fault on; vm_lock keeps them from changing it at the same time.
+   Children are the process's too, whichever thread created them, so
+   any thread can wait for them.
+
+   The last thread to leave closes the files, destroys the address
+   space, frees the process and reports to the parent through the
+   record of whichever thread held it: the exit status is the one
+   given to exit(), which ends every thread of the process. */
+struct process {
+	int thread_cnt;                     /* Threads still in the process. */
+	bool exiting;                       /* Has a thread called exit()? */
+	int exit_status;                    /* What it passed to exit(). */
+	struct child_status *child_status;  /* Left by a thread that exited. */
+	struct rusage rusage;               /* Used by threads that exited. */
+	struct spinlock leave_lock;         /* Protects the four above as threads leave. */
+
+#ifdef USERPROG
+	uint64_t *pml4;                     /* Page map level 4. */
+#endif
+#ifdef VM
+	struct supplemental_page_table spt; /* Pages of the address space. */
+	struct lock vm_lock;                /* Held while SPT is used or changed. */
+	uint8_t *heap_start;                /* Heap, right after the data segment. */
+	uint8_t *heap_brk;                  /* End of the heap, as set by sbrk(). */
+#endif
+
+	/* 자식 프로세스 목록. 어느 스레드가 만들었든 프로세스의 자식 */
+	struct lock child_lock; // children과 각 기록의 claimed를 보호
+	struct ohash children; // 자식들의 struct child_status, tid로 찾음. 첫 자식 때 만듦
+	struct list exited_children; // 종료했지만 아직 wait하지 않은 자식의 기록, 종료 순서대로
+	struct semaphore child_exited; // exited_children에 들어간 기록 하나마다 up
+
+	struct file **file_descriptor_table; // FDT 프로세스마다 있는 파일 디스크립터를 관리하는 테이블
+										 // palloc으로 동적 메모리 할당받는데, 핀토스에는 힙 섹션이 없으므로 커널 메모리에 위치
+										 // FDT_INITIAL칸에서 시작해 필요할 때 두 배씩 늘어남
+	uint64_t *fd_used; // 사용 중인 fd의 bitmap. 테이블 바로 뒤에 같이 할당됨
+	int fd_cap; // 테이블의 칸 수
+
+	int stdin_count;
+	int stdout_count;
+
+	/* 현재 실행 중인 파일 */
+	struct file *running;
+};
 
 
 /* A kernel thread or user process.
@@ -92,75 +179,103 @@ typedef int tid_t;
  * the `magic' member of the running thread's `struct thread' is
  * set to THREAD_MAGIC.  Stack overflow will normally change this
  * value, triggering the assertion. */
-/* The `elem' member has a dual purpose.  It can be an element in
- * the run queue (thread.c), or it can be an element in a
- * semaphore wait list (synch.c).  It can be used these two ways
- * only because they are mutually exclusive: only a thread in the
- * ready state is on the run queue, whereas only a thread in the
- * blocked state is on a semaphore wait list. */
+/* The `elem' member is an element in the run queue (thread.c):
+ * only a thread in the ready state is on the run queue.  A
+ * blocked thread waits on a semaphore through `wait_elem'
+ * (synch.c) or on the sleep queue through `sleep_elem'.
+ *
+ * The members that schedule(), the run queues, thread_awake() and
+ * cmp_priority() touch come first, within the first 64-byte cache
+ * line of the page, so that walking a queue of threads or switching
+ * between them costs one line per thread; thread_init() checks that
+ * they fit.  The rest is ordered roughly by how often it is used. */
+#define THREAD_HOT_BYTES 64
+
 struct thread {
-	/* Owned by thread.c. */
-	tid_t tid;                          /* 쓰레드 ID (Thread identifier.) */
+	/* Owned by thread.c; the hot line. */
 	enum thread_status status;          /* 쓰레드 상태 (Thread state.) */
-	char name[16];                      /* Name (for debugging purposes). */
 	int priority;                       /* Priority. */
+	struct list_elem elem;              /* List element, shared with synch.c. */
 	int64_t wakeup_tick; 				/* 깨어나야 할 tick */
+	struct heap_elem sleep_elem;		/* wakeup_tick 순서의 sleep heap element */
+	uint64_t switch_rsp;                /* Saved stack pointer, 0 if never run. */
 
-	/* Shared between thread.c and synch.c. */
-	struct list_elem elem;              /* List element. */
+	/* Owned by thread.c. */
+	tid_t tid;                          /* 쓰레드 ID (Thread identifier.) */
+	char name[16];                      /* Name (for debugging purposes). */
+	struct cpu *cpu;                    /* CPU whose run queue we are on or last ran on. */
+	struct cpu *on_cpu;                 /* CPU we are on until switched out, or NULL. */
+	bool migrating;                     /* Requeue elsewhere once switched out. */
+	int64_t last_run;                   /* Timer tick at which we were last switched out. */
+	uint64_t rusage_stamp;              /* TSC at the last mode change or switch. */
+	uint64_t affinity;                  /* Bit N set if we may run on cpus[N]. */
+	int ioprio;                         /* IOPRIO_*, or IOPRIO_NONE. */
+	struct list_elem all_elem;          /* List element for all threads list. */
+	int64_t vruntime;                   /* Weighted cycles run, for -fair. */
+	uint64_t fair_stamp;                /* TSC when vruntime was last charged. */
+	struct rb_elem fair_elem;           /* In cpu's fair_queue, for -fair. */
+	int64_t dl_runtime;                 /* Ticks per period if a deadline thread, else 0. */
+	int64_t dl_deadline;                /* Ticks from period start to deadline. */
+	int64_t dl_period;                  /* Ticks per period. */
+	int64_t dl_abs_deadline;            /* Tick of the current deadline. */
+	int64_t dl_budget;                  /* Ticks left of the current runtime. */
+	struct rb_elem dl_elem;             /* In cpu's dl_queue. */
+
+	/* Owned by synch.c. */
+	struct heap_elem wait_elem;         /* Semaphore waiters heap element. */
+	uint64_t wait_seq;                  /* Keeps waiters of equal priority FIFO. */
+	struct semaphore *wait_on_sema;     /* Semaphore whose waiters we are on. */
+	struct condition *wait_on_cond;     /* Condition whose waiters we are on. */
+	struct heap_elem *cond_elem;        /* Our element in wait_on_cond's waiters. */
+
+	/* Owned by pmu.c. */
+	struct perf_counts perf;            /* Hardware events while we ran. */
+
+	/* Owned by fpu.c. */
+	void *fpu_area;                     /* Saved FPU state, or NULL. */
 
 	/* priority donation */
 	int init_priority; 					/* 우선순위를 donation 받을 때, 자신의 원래 우선 순위를 저장할 수 있는 필드 */
 	struct lock *wait_on_lock;			/* 현재 쓰레드가 필요한 lock을 들고 있는 쓰레드의 주소를 저장하는 필드 */
 	
 	/* multiple priority를 구조체 선언 */
-	struct list donations; 				/* 자신에게 priority를 donate한 쓰레드의 리스트 */
-	struct list_elem donation_elem;  	/* priority를 donate한 쓰레드들의 리스트를 관리하기 위한 element 
-										이 element를 통해 자신이 우선 순위를 donate한 쓰레드의 donates 리스트에 연결*/
+	struct heap held_locks;				/* 자신이 들고 있는 lock들. max_priority가 가장 큰 lock이 top */
 
 	int nice;
 	int recent_cpu;
 	
 #ifdef USERPROG
 	/* Owned by userprog/process.c. */
-	uint64_t *pml4;                     /* Page map level 4 */
+	uint64_t fs_base;                   /* User FS base, for TLS. */
 #endif
 #ifdef VM
-	/* Table for whole virtual memory owned by thread. */
-	struct supplemental_page_table spt;
+	uintptr_t user_rsp;                 /* User rsp at the last system call. */
+	struct vmstat vmstat;               /* Page faults and paging we caused. */
 #endif
 
 	/* Owned by thread.c. */
-	struct intr_frame tf;               /* Information for switching */
-	unsigned magic;                     /* Detects stack overflow. */
+	struct rusage rusage;               /* What we used; faults in vmstat. */
+	struct rusage rusage_children;      /* What waited-for children used. */
+	struct intr_frame tf;               /* Context for the first launch. */
 
 	/* User programs - system call */
 	int exit_status; // _exit(), _wait() 구현 때 사용: exit에서 인자status에 exit_status를 넣어주고 thread_exit() 실행
-	struct file **file_descriptor_table; // FDT 스레드마다 있는 파일 디스크립터를 관리하는 테이블 
-										 // palloc으로 동적 메모리 할당받는데, 핀토스에는 힙 섹션이 없으므로 커널 메모리에 위치
-										 // 최대 64개의 파일 객체 포인터를 가짐
-	int fdidx; // fd index 파일에 대한 인덱스 값
+	struct process *process; // 같은 프로세스의 스레드들이 같이 쓰는 FDT 등
+	int *clear_tid; // 종료할 때 0을 쓰고 futex로 깨울 유저 주소. thread_join()이 기다림
 
-	/* 자식 프로세스 순회용 리스트 */
-	struct list child_list; // _fork(), wait()
-	struct list_elem child_elem; // _fork(), _wait() 구현 때 사용
+	struct child_status *child_status; // 부모가 가진 내 기록. 처음 스레드는 NULL
 
 	/* 자식한테 넘겨줄 intr_frame */
-	struct intr_frame parent_if; // _fork() 구현 때 사용, __do_fork() 함수
-								 // 부모 스레드는 현재 실행 중인 유저 스레드
-								 // fork 시 부모 스레드의 정보를 담은 itrp frame 필요
-								 // __do_fork()에서 생성해줌
-	struct semaphore fork_sema;
-	struct semaphore free_sema;
-
-	/* wait_sema를 이용하여 자식 프로세스가 종료할 때까지 대기함. 종료 상태를 저장 */
-	struct semaphore wait_sema;
+	struct intr_frame *syscall_if; // fork() 중인 system call의 intr_frame. 커널 스택에 있음
+								   // 자식이 __do_fork()에서 복사할 때까지 부모는 기다리므로
+								   // 따로 복사해 둘 필요 없음
+	bool vfork_borrowed; // vfork() 뒤 exec/exit 전까지 부모의 pml4를 빌려 쓰는 중
 
-	int stdin_count;
-	int stdout_count;
+	char *stdout_buf; // 표준 출력 줄 버퍼. 처음 쓸 때 만듦
+	size_t stdout_len; // stdout_buf에 모인 바이트 수
 
-	/* 현재 실행 중인 파일 */
-	struct file *running;
+	/* Owned by thread.c.  Last, next to the kernel stack. */
+	unsigned magic;                     /* Detects stack overflow. */
 };
 
 /* If false (default), use round-robin scheduler.
@@ -168,16 +283,44 @@ struct thread {
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+/* If true, pick the thread with the least virtual runtime instead
+   of the one of highest priority.  Overrides thread_mlfqs.
+   Controlled by kernel command-line option "-o fair". */
+extern bool thread_fair;
+
 void thread_init (void);
 void thread_start (void);
+struct thread *thread_create_idle (struct cpu *);
+void thread_start_ap (void) NO_RETURN;
 
 void thread_tick (void);
 void thread_print_stats (void);
 
+void thread_enter_kernel (void);
+void thread_leave_kernel (void);
+void thread_get_rusage (struct rusage *, bool children);
+void thread_reap_rusage (const struct child_status *);
+void rusage_add (struct rusage *, const struct rusage *);
+
 typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
+void child_status_release (struct child_status *);
+void child_status_unlist (struct process *, struct child_status *);
+struct child_status *child_status_pop_exited (struct process *);
+struct process *process_alloc (void);
+void process_free (struct process *);
+
+#ifdef USERPROG
+/* Returns the page table T runs on, or a null pointer if it has
+   none or has left its process. */
+static inline uint64_t *
+thread_pml4 (const struct thread *t) {
+	return t->process != NULL ? t->process->pml4 : NULL;
+}
+#endif
 
 void thread_block (void);
+void thread_block_on (struct spinlock *);
 void thread_unblock (struct thread *);
 
 struct thread *thread_current (void);
@@ -194,17 +337,27 @@ int thread_get_nice (void);
 void thread_set_nice (int);
 int thread_get_recent_cpu (void);
 int thread_get_load_avg (void);
+int thread_nr_running (void);
+
+void thread_set_ioprio (int);
+int thread_get_ioprio (void);
+
+bool thread_set_affinity (tid_t, uint64_t mask);
+bool thread_set_deadline (int64_t runtime, int64_t deadline, int64_t period);
+uint64_t thread_get_affinity (tid_t);
 
 void do_iret (struct intr_frame *tf);
+void schedule_tail (struct thread *prev);
 
 void thread_sleep(int64_t ticks);				// 실행중인 쓰레드를 슬립으로 바꿈
-void thread_awake(int64_t ticks);				// sleep_list에서 깨워야할 쓰레드를 깨움
+void thread_awake(int64_t ticks);				// sleep_heap에서 깨워야할 쓰레드를 깨움
 void update_next_tick_to_awake(int64_t ticks); // 최소 tick을 가진 쓰레드 저장
 int64_t get_next_tick_to_awake(void);		   // thread.c의 next_tick_to_awake 반환
 
 /* project1 : prority scheduling */
 void test_max_priority(void);
 bool cmp_priority(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED);
+void thread_change_priority (struct thread *t, int priority);
 
 
 /* project1 : priority donation */
@@ -215,7 +368,8 @@ void refresh_priority(void);
 
 /* advanced scheduling */
 void mlfqs_priority (struct thread *t);
-void mlfqs_recent_cpu (struct thread *t);
+void mlfqs_recent_cpu (struct thread *t, int decay);
+int mlfqs_decay (void);
 void mlfqs_load_avg (void);
 void mlfqs_increment_recent_cpu (void);
 void mlfqs_recalc_recent_cpu (void);
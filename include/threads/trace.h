@@ -0,0 +1,41 @@
+#ifndef THREADS_TRACE_H
+#define THREADS_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Kinds of trace events.  A _BEGIN or _ENTER event opens a span of
+   the current thread that the matching _END or _EXIT closes. */
+enum trace_type {
+	TRACE_SCHED_SWITCH,         /* ARG: thread switched to. */
+	TRACE_BLOCK,                /* Current thread blocks. */
+	TRACE_UNBLOCK,              /* ARG: thread unblocked. */
+	TRACE_LOCK_WAIT_BEGIN,      /* ARG: contended lock. */
+	TRACE_LOCK_WAIT_END,
+	TRACE_FAULT_BEGIN,          /* ARG: faulting address. */
+	TRACE_FAULT_END,
+	TRACE_DISK_READ_BEGIN,      /* ARG: first sector. */
+	TRACE_DISK_READ_END,
+	TRACE_DISK_WRITE_BEGIN,     /* ARG: first sector. */
+	TRACE_DISK_WRITE_END,
+	TRACE_SYSCALL_ENTER,        /* ARG: system call number. */
+	TRACE_SYSCALL_EXIT,         /* ARG: return value. */
+	TRACE_TYPE_CNT
+};
+
+/* Set by kernel command-line option "-trace". */
+extern bool trace_enabled;
+
+void trace_init (void);
+void trace_record (enum trace_type, uint64_t arg);
+void trace_dump (void);
+
+/* Static tracepoint: records event TYPE with ARG if tracing is on.
+   Costs one well-predicted branch when it is off. */
+#define TRACE(TYPE, ARG)                                        \
+	do {                                                        \
+		if (__builtin_expect (trace_enabled, 0))                \
+			trace_record (TRACE_##TYPE, (uint64_t) (ARG));      \
+	} while (0)
+
+#endif /* threads/trace.h */
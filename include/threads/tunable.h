@@ -0,0 +1,26 @@
+#ifndef THREADS_TUNABLE_H
+#define THREADS_TUNABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Longest tunable name, not counting the null terminator. */
+#define TUNABLE_NAME_MAX 31
+
+/* A kernel parameter that can be set at boot with -tune and at run
+   time with the sysctl system call; see tunable.c. */
+struct tunable {
+	const char *name;           /* "subsystem.parameter". */
+	size_t *value;              /* The variable the subsystem reads. */
+	size_t min, max;            /* Bounds of the value, inclusive. */
+	struct tunable *next;       /* Next registered tunable. */
+};
+
+void tunable_register (struct tunable *);
+bool tunable_get (const char *name, size_t *value);
+bool tunable_set (const char *name, size_t value);
+
+void tunable_boot_option (char *setting);
+void tunable_boot_check (void);
+
+#endif /* threads/tunable.h */
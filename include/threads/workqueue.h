@@ -0,0 +1,56 @@
+#ifndef THREADS_WORKQUEUE_H
+#define THREADS_WORKQUEUE_H
+
+#include <heap.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Work run later by a kernel thread of a workqueue; see
+   workqueue.c. */
+typedef void work_func (void *aux);
+
+/* Priority classes of the workqueues. */
+enum wq_class {
+	WQ_HIGH,                    /* Work that others wait for. */
+	WQ_NORMAL,                  /* Ordinary background work. */
+	WQ_IDLE,                    /* Work for when nothing else runs. */
+	WQ_CLASS_CNT
+};
+
+struct work_queue;
+
+/* A unit of work. */
+struct work {
+	struct list_elem elem;      /* Element in a queue. */
+	work_func *func;            /* Function to run. */
+	void *aux;                  /* Its argument. */
+	struct work_queue *queue;   /* Queue it was last queued on. */
+	bool pending;               /* Queued, not yet started? */
+	bool running;               /* Being run by a worker? */
+};
+
+/* Work queued once a number of timer ticks have passed. */
+struct delayed_work {
+	struct work work;
+	struct heap_elem timer_elem; /* Element in the timer heap. */
+	int64_t expires;            /* Tick at which to queue WORK. */
+	enum wq_class class;        /* Queue to put WORK on then. */
+	bool armed;                 /* In the timer heap? */
+};
+
+void workqueue_init (void);
+
+void work_init (struct work *, work_func *, void *aux);
+bool queue_work (enum wq_class, struct work *);
+bool cancel_work (struct work *);
+
+void delayed_work_init (struct delayed_work *, work_func *, void *aux);
+bool queue_delayed_work (enum wq_class, struct delayed_work *,
+		int64_t ticks);
+bool cancel_delayed_work (struct delayed_work *);
+
+void workqueue_tick (void);
+int64_t workqueue_next_expiry (void);
+
+#endif /* threads/workqueue.h */
@@ -3,8 +3,15 @@
 
 #include "threads/synch.h"
 
-void syscall_init (void);
+struct file;
+struct process;
+struct thread;
 
-struct lock filesys_lock;
+void syscall_init (void);
+void syscall_init_cpu (void);
+void syscall_print_stats (void);
+bool process_reserve_fd (struct process *p, int fd);
+void process_set_file (struct process *p, int fd, struct file *f);
+void stdout_flush (void);
 
 #endif /* userprog/syscall.h */
\ No newline at end of file
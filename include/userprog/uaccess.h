@@ -0,0 +1,15 @@
+#ifndef USERPROG_UACCESS_H
+#define USERPROG_UACCESS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct intr_frame;
+
+bool copy_from_user (void *dst, const void *usrc, size_t size);
+bool copy_to_user (void *udst, const void *src, size_t size);
+int strncpy_from_user (char *dst, const char *usrc, size_t size);
+bool user_probe (const void *uaddr, size_t size, bool write);
+bool uaccess_fixup (struct intr_frame *f);
+
+#endif /* userprog/uaccess.h */
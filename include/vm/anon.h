@@ -1,13 +1,29 @@
 #ifndef VM_ANON_H
 #define VM_ANON_H
+#include <stddef.h>
+#include <stdint.h>
 #include "vm/vm.h"
 struct page;
+struct zswap_entry;
+struct vm_teardown;
 enum vm_type;
 
+/* Slot number of a page that has no copy in swap. */
+#define SWAP_NONE SIZE_MAX
+
 struct anon_page {
+	size_t slot;                /* Swap slot with a copy, or SWAP_NONE. */
+	struct zswap_entry *zentry; /* Compressed copy in zswap, or NULL. */
 };
 
+extern size_t swap_readahead;
+extern const char *swap_disk_name;
+
 void vm_anon_init (void);
 bool anon_initializer (struct page *page, enum vm_type type, void *kva);
+size_t swap_write (const void *kva);
+void swap_load (size_t slot, void *kva);
+void swap_slot_free (size_t slot);
+void swap_slot_free_batch (struct vm_teardown *);
 
 #endif
@@ -0,0 +1,43 @@
+#ifndef VM_AREA_H
+#define VM_AREA_H
+#include <rbtree.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "filesys/off_t.h"
+
+struct file;
+struct supplemental_page_table;
+enum vm_type;
+
+/* A region of a process's address space: the pages from START up to
+ * END, all of one kind, made by one mapping.  That is a segment of
+ * the executable, the heap, the stack, an mmap() of a file or a
+ * shm_map() of a segment; see vm/area.c. */
+struct vm_area {
+	struct rb_elem elem;        /* Element in the SPT's AREAS. */
+	uint8_t *start;             /* First address, page-aligned. */
+	uint8_t *end;               /* Address past the last, page-aligned. */
+	enum vm_type type;          /* Type of the pages, with markers. */
+	bool writable;              /* May the user write to the pages? */
+	struct file *file;          /* File the pages come from, or NULL. */
+	off_t offset;               /* Offset in FILE of START. */
+};
+
+void vm_area_init (void);
+void vm_area_table_init (struct supplemental_page_table *);
+struct vm_area *vm_area_create (struct supplemental_page_table *,
+		void *start, void *end, enum vm_type, bool writable,
+		struct file *, off_t offset);
+void vm_area_destroy (struct supplemental_page_table *, struct vm_area *);
+bool vm_area_resize (struct vm_area *, void *end);
+struct vm_area *vm_area_find (struct supplemental_page_table *,
+		const void *addr);
+struct vm_area *vm_area_first (struct supplemental_page_table *,
+		const void *start, const void *end);
+struct vm_area *vm_area_next (struct vm_area *);
+bool vm_area_overlaps (struct supplemental_page_table *,
+		const void *start, const void *end);
+bool vm_area_copy (struct supplemental_page_table *dst,
+		struct supplemental_page_table *src);
+void vm_area_kill (struct supplemental_page_table *);
+#endif
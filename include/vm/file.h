@@ -6,7 +6,11 @@
 struct page;
 enum vm_type;
 
+/* A page of a mapped file.  FILE is a reopened copy owned by the
+ * page.  The mapping as a whole is a region, a struct vm_area. */
 struct file_page {
+	struct file *file;     /* Mapped file. */
+	off_t ofs;             /* Offset of the page in FILE. */
 };
 
 void vm_file_init (void);
@@ -14,4 +18,6 @@ bool file_backed_initializer (struct page *page, enum vm_type type, void *kva);
 void *do_mmap(void *addr, size_t length, int writable,
 		struct file *file, off_t offset);
 void do_munmap (void *va);
+void file_write_back_all (void);
+void file_page_release (struct page *page);
 #endif
@@ -0,0 +1,45 @@
+#ifndef VM_SHM_H
+#define VM_SHM_H
+#include <ohash.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "threads/synch.h"
+#include "vm/vm.h"
+
+struct page;
+struct frame;
+enum vm_type;
+
+/* Longest name of a shared memory segment. */
+#define SHM_NAME_MAX 31
+
+/* A page of a segment.  FRAME and SLOT are covered by frame_lock. */
+struct shm_slot {
+	struct frame *frame;        /* Frame holding the page, or NULL. */
+	size_t slot;                /* Swap slot with a copy, or SWAP_NONE. */
+};
+
+/* A shared memory segment; see vm/shm.c. */
+struct shm {
+	char name[SHM_NAME_MAX + 1]; /* Name, or empty if it has none. */
+	struct ohash_elem elem;     /* Element in shm_names, if named. */
+	unsigned ref_cnt;           /* Pages mapping it, plus one if named. */
+	struct lock lock;           /* Held while bringing in its pages. */
+	size_t page_cnt;            /* Number of pages. */
+	struct shm_slot slots[];    /* Its pages. */
+};
+
+/* A page mapping page IDX of segment SHM.  The mapping as a whole
+ * is a region, a struct vm_area. */
+struct shm_page {
+	struct shm *shm;            /* Segment, of which we hold a reference. */
+	size_t idx;                 /* Page number within SHM. */
+};
+
+void vm_shm_init (void);
+bool shm_initializer (struct page *page, enum vm_type type, void *kva);
+void shm_reopen (struct shm *);
+void shm_close (struct shm *);
+void *do_shm_map (const char *name, void *addr, size_t length, int writable);
+bool shm_unlink (const char *name);
+#endif
@@ -1,7 +1,12 @@
 #ifndef VM_VM_H
 #define VM_VM_H
+#include <list.h>
+#include <ohash.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <vmstat.h>
 #include "threads/palloc.h"
+#include "filesys/off_t.h"
 
 enum vm_type {
 	/* page not initialized */
@@ -12,6 +17,8 @@ enum vm_type {
 	VM_FILE = 2,
 	/* page that hold the page cache, for project 4 */
 	VM_PAGE_CACHE = 3,
+	/* page of a shared memory segment */
+	VM_SHM = 4,
 
 	/* Bit flags to store state */
 
@@ -24,9 +31,17 @@ enum vm_type {
 	VM_MARKER_END = (1 << 31),
 };
 
+/* Marks the pages of the user stack. */
+#define VM_STACK VM_MARKER_0
+
+/* Most bytes the user stack may grow to, below USER_STACK. */
+#define STACK_MAX (1 << 20)
+
 #include "vm/uninit.h"
 #include "vm/anon.h"
 #include "vm/file.h"
+#include "vm/shm.h"
+#include "vm/area.h"
 #ifdef EFILESYS
 #include "filesys/page_cache.h"
 #endif
@@ -46,6 +61,13 @@ struct page {
 	struct frame *frame;   /* Back reference for frame */
 
 	/* Your implementation */
+	struct process *owner; /* Process whose address space holds us. */
+	bool writable;         /* May the user write to the page? */
+	bool dirty;            /* Modified since last written back? */
+	int advice;            /* Access pattern, a MADV_* from madvise(). */
+	bool mlocked;          /* Frame pinned by mlock()? */
+	bool huge;             /* Mapped by a 2 MB page not split yet? */
+	struct list_elem share_elem; /* Element in frame's PAGES. */
 
 	/* Per-type data are binded into the union.
 	 * Each function automatically detects the current union */
@@ -53,16 +75,54 @@ struct page {
 		struct uninit_page uninit;
 		struct anon_page anon;
 		struct file_page file;
+		struct shm_page shm;
 #ifdef EFILESYS
 		struct page_cache page_cache;
 #endif
 	};
 };
 
-/* The representation of "frame" */
+/* The representation of "frame".
+ *
+ * Every frame that holds a user page is in the frame table, which
+ * the clock hand sweeps to choose eviction victims.  A pinned frame
+ * is never chosen; frames are pinned while their page is loaded or
+ * while the kernel works on their contents through KVA.
+ *
+ * After fork, a frame may be shared copy-on-write by the pages of
+ * several processes, all mapped read-only.  PAGE is then any one of
+ * them.  Shared frames are not evicted: the first write to one, or
+ * the exit of the other sharers, makes it private again.
+ *
+ * A page locked with mlock() holds one pin on its frame for as long
+ * as it is locked, moving it along if the page changes frames.
+ *
+ * A frame in one of the page caches is instead shared for good, by
+ * every page that maps the same part of the same file.  CACHE is
+ * then the cache, and INODE, OFS and READ_BYTES its key.  Same-page
+ * merging keeps a cache of anonymous frames too, keyed by their
+ * contents, with INODE null.  Frames of
+ * mapped files are evicted like any other, all their mappings at
+ * once.  So are the frames of shared memory segments, each shared
+ * by every page that maps that page of its segment. */
 struct frame {
 	void *kva;
 	struct page *page;
+	struct list_elem elem; /* Element in the frame table. */
+	unsigned pin_cnt;      /* Nonzero exempts it from eviction. */
+	struct list pages;     /* Pages mapping this frame. */
+	unsigned share_cnt;    /* Number of pages in PAGES. */
+
+	/* Set while the frame is in a page cache. */
+	struct ohash *cache;   /* Cache holding the frame, or NULL. */
+	struct inode *inode;   /* File the page was loaded from. */
+	off_t ofs;             /* Offset in INODE. */
+	size_t read_bytes;     /* Bytes read from INODE, rest zeros. */
+	struct ohash_elem cache_elem;
+
+	uint32_t ksm_sum;      /* CRC-32C of the contents when ksmd last
+	                          looked, see vm.c. */
+	bool referenced;       /* Accessed bit saved by ws_scan(). */
 };
 
 /* The function table for page operations.
@@ -82,9 +142,60 @@ struct page_operations {
 	if ((page)->operations->destroy) (page)->operations->destroy (page)
 
 /* Representation of current process's memory space.
- * We don't want to force you to obey any specific design for this struct.
- * All designs up to you for this. */
+ *
+ * This is a radix tree keyed by user virtual address, with the same
+ * four levels of 512 entries as the x86-64 page table it shadows.
+ * Each node is one kernel page; leaf entries point to the struct
+ * page of each user page, interior entries to the next level.  A
+ * lookup is four indexed loads, with no hashing and no chains.
+ *
+ * The leaf last used is remembered together with the 2 MB of
+ * address space it covers, so that runs of faults on neighbouring
+ * pages, as when a program walks an array or its stack grows, find
+ * their entry with a single index.
+ *
+ * Alongside the pages, AREAS holds the regions they belong to, so
+ * that questions about a whole range are answered without looking
+ * at every page in it. */
 struct supplemental_page_table {
+	void **root;                /* Top-level node, or NULL if empty. */
+	struct page **hint;         /* Leaf node of the last lookup, or NULL. */
+	uintptr_t hint_base;        /* First address covered by HINT. */
+	struct list huge_maps;      /* 2 MB mappings, see vm_map_huge(). */
+	struct rbtree areas;        /* Regions, see vm/area.c. */
+	struct vm_teardown *teardown; /* Set while the SPT is killed. */
+
+	/* Resident set, covered by frame_lock; see ws_scan(). */
+	size_t rss;                 /* Pages with a frame. */
+	size_t rss_limit;           /* Most pages with a frame, or 0. */
+	size_t ws_cnt;              /* Pages accessed in scan WS_EPOCH. */
+	size_t ws_prev;             /* In scan WS_EPOCH - 1, if it was counted. */
+	unsigned ws_epoch;          /* Working-set scan WS_CNT is from. */
+
+	/* Events that befall its pages, whichever thread causes them. */
+	uint64_t evictions;         /* Pages evicted from memory. */
+	uint64_t swap_ins;          /* Anonymous pages brought back in. */
+};
+
+/* What the pages of an address space being torn down give up, to be
+ * freed in bulk: see supplemental_page_table_kill(). */
+#define TEARDOWN_SLOTS 32
+struct vm_teardown {
+	struct list frames;             /* Frames to free. */
+	size_t slot_cnt;                /* Number of SLOTS in use. */
+	size_t slots[TEARDOWN_SLOTS];   /* Swap slots to free. */
+};
+
+/* Source of a page loaded lazily from a file: READ_BYTES bytes of
+ * FILE starting at OFS, followed by zeros up to the end of the page.
+ * This is the AUX of every initializer passed to
+ * vm_alloc_page_with_initializer().  It is allocated with malloc()
+ * and owned, along with FILE, by the page, which frees both when it
+ * is initialized or destroyed. */
+struct vm_load_aux {
+	struct file *file;
+	off_t ofs;
+	size_t read_bytes;
 };
 
 #include "threads/thread.h"
@@ -96,8 +207,29 @@ struct page *spt_find_page (struct supplemental_page_table *spt,
 		void *va);
 bool spt_insert_page (struct supplemental_page_table *spt, struct page *page);
 void spt_remove_page (struct supplemental_page_table *spt, struct page *page);
+typedef bool spt_action_func (struct page *, void *aux);
+bool spt_for_each (struct supplemental_page_table *, spt_action_func *,
+		void *aux);
+
+extern size_t stack_growth_window;
+extern bool thp_enabled;
+extern size_t rss_limit;
+
+/* Counts one more EVENT, a member of struct vmstat, for thread T and
+ * for the whole system. */
+#define vmstat_count(T, EVENT) \
+	((T)->vmstat.EVENT++, vmstat_global.EVENT++)
+
+/* Counts one more EVENT, a member of both struct vmstat and struct
+ * supplemental_page_table, against process P's address space and the
+ * whole system. */
+#define vmstat_count_spt(P, EVENT) \
+	((P)->spt.EVENT++, vmstat_global.EVENT++)
+extern struct vmstat vmstat_global;
 
 void vm_init (void);
+bool vm_lock_acquire (void);
+void vm_lock_release (bool locked);
 bool vm_try_handle_fault (struct intr_frame *f, void *addr, bool user,
 		bool write, bool not_present);
 
@@ -106,7 +238,25 @@ bool vm_try_handle_fault (struct intr_frame *f, void *addr, bool user,
 bool vm_alloc_page_with_initializer (enum vm_type type, void *upage,
 		bool writable, vm_initializer *init, void *aux);
 void vm_dealloc_page (struct page *page);
+void vm_release_frame (struct page *page);
+void vm_release_shm_frame (struct page *page);
+void vm_free_shm_frame (struct frame *frame);
+bool vm_pin_page (struct page *page);
+void vm_unpin_page (struct page *page);
+bool vm_pin_resident_page (struct page *page);
 bool vm_claim_page (void *va);
+bool vm_madvise (void *addr, size_t length, int advice);
+bool vm_set_brk (void *old_brk, void *new_brk);
+bool vm_mlock (void *addr, size_t length);
+bool vm_munlock (void *addr, size_t length);
+bool vm_grow_stack (const void *addr);
+bool vm_pin_buffer (const void *buffer, size_t size, bool write);
+void vm_unpin_buffer (const void *buffer, size_t size);
+bool vm_cache_empty (void);
+bool vm_cache_read (struct inode *, off_t, void *, size_t);
+void vm_cache_write (struct inode *, off_t, const void *, size_t);
 enum vm_type page_get_type (struct page *page);
+void vm_get_stats (struct vmstat *thread, struct vmstat *system);
+void vm_print_stats (void);
 
 #endif  /* VM_VM_H */
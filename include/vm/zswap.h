@@ -0,0 +1,16 @@
+#ifndef VM_ZSWAP_H
+#define VM_ZSWAP_H
+#include <stdbool.h>
+
+struct page;
+struct zswap_entry;
+
+/* Compress evicted anonymous pages into memory before swapping? */
+extern bool zswap_enabled;
+
+void zswap_init (void);
+bool zswap_store (struct page *page, const void *kva);
+bool zswap_load (struct page *page, void *kva);
+void zswap_invalidate (struct page *page);
+
+#endif
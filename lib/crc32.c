@@ -0,0 +1,121 @@
+#include <crc32.h>
+#include <stdbool.h>
+
+/* CRC-32C.
+
+   The software version is "slice-by-8": eight tables, where
+   table[K][B] is the CRC of byte B followed by K zero bytes, let
+   one step fold in eight bytes with eight independent lookups
+   instead of eight dependent ones.  The tables take 8 kB and are
+   computed on first use.  Two threads that race to compute them
+   store the same values, so no lock is needed.
+
+   CPUs with SSE4.2 have a CRC32 instruction for this polynomial,
+   which handles eight bytes per instruction; it is used when CPUID
+   reports it.  It works on general purpose registers, so the
+   kernel may use it outside kernel_fpu_begin(). */
+
+/* CRC-32C polynomial, bit-reversed. */
+#define POLY 0x82f63b78
+
+static uint32_t table[8][256];
+static bool table_ready;
+
+/* -1 until checked, then whether the CPU has SSE4.2. */
+static int have_sse42 = -1;
+
+/* Fills in TABLE. */
+static void
+make_table (void)
+{
+  uint32_t b, crc;
+  int i, k;
+
+  for (b = 0; b < 256; b++)
+    {
+      crc = b;
+      for (i = 0; i < 8; i++)
+        crc = crc & 1 ? (crc >> 1) ^ POLY : crc >> 1;
+      table[0][b] = crc;
+    }
+  for (b = 0; b < 256; b++)
+    for (k = 1; k < 8; k++)
+      table[k][b] = (table[k - 1][b] >> 8) ^ table[0][table[k - 1][b] & 0xff];
+  table_ready = true;
+}
+
+/* Returns true if the CPU has SSE4.2. */
+static bool
+check_sse42 (void)
+{
+  if (have_sse42 < 0)
+    {
+      uint32_t eax, ebx, ecx, edx;
+
+      asm ("cpuid"
+           : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx)
+           : "a" (1), "c" (0));
+      have_sse42 = (ecx & (1 << 20)) != 0;     /* CPUID.1:ECX.SSE4_2 */
+    }
+  return have_sse42;
+}
+
+/* Folds the SIZE bytes at P into CRC, which is not inverted, with
+   the CRC32 instruction. */
+static uint32_t
+crc32c_hw (uint32_t crc, const unsigned char *p, size_t size)
+{
+  uint64_t crc64 = crc;
+
+  for (; size > 0 && (uintptr_t) p % sizeof (uint64_t) != 0; size--)
+    asm ("crc32b %1, %k0" : "+r" (crc64) : "rm" (*p++));
+  for (; size >= sizeof (uint64_t); size -= sizeof (uint64_t))
+    {
+      asm ("crc32q %1, %0" : "+r" (crc64) : "rm" (*(const uint64_t *) p));
+      p += sizeof (uint64_t);
+    }
+  for (; size > 0; size--)
+    asm ("crc32b %1, %k0" : "+r" (crc64) : "rm" (*p++));
+  return crc64;
+}
+
+/* Folds the SIZE bytes at P into CRC, which is not inverted, eight
+   bytes per step. */
+static uint32_t
+crc32c_sw (uint32_t crc, const unsigned char *p, size_t size)
+{
+  if (!table_ready)
+    make_table ();
+
+  for (; size > 0 && (uintptr_t) p % sizeof (uint64_t) != 0; size--)
+    crc = (crc >> 8) ^ table[0][(crc ^ *p++) & 0xff];
+  for (; size >= sizeof (uint64_t); size -= sizeof (uint64_t))
+    {
+      /* Little-endian, so the first byte is the low one. */
+      uint64_t x = *(const uint64_t *) p ^ crc;
+
+      crc = table[7][x & 0xff] ^ table[6][(x >> 8) & 0xff]
+            ^ table[5][(x >> 16) & 0xff] ^ table[4][(x >> 24) & 0xff]
+            ^ table[3][(x >> 32) & 0xff] ^ table[2][(x >> 40) & 0xff]
+            ^ table[1][(x >> 48) & 0xff] ^ table[0][x >> 56];
+      p += sizeof (uint64_t);
+    }
+  for (; size > 0; size--)
+    crc = (crc >> 8) ^ table[0][(crc ^ *p++) & 0xff];
+  return crc;
+}
+
+/* Returns the CRC-32C of the SIZE bytes at BUF, continuing from
+   CRC, the CRC of the bytes before them, or 0 if there are none. */
+uint32_t
+crc32c (uint32_t crc, const void *buf, size_t size)
+{
+  const unsigned char *p = buf;
+
+  crc = ~crc;
+  if (check_sse42 ())
+    crc = crc32c_hw (crc, p, size);
+  else
+    crc = crc32c_sw (crc, p, size);
+  return ~crc;
+}
@@ -26,6 +26,7 @@ typedef unsigned long elem_type;
    simulates an array of bits. */
 struct bitmap {
 	size_t bit_cnt;     /* Number of bits. */
+	size_t cursor;      /* Where the next-fit scan starts. */
 	elem_type *bits;    /* Elements that represent bits. */
 };
 
@@ -63,6 +64,49 @@ last_mask (const struct bitmap *b) {
 	return last_bits ? ((elem_type) 1 << last_bits) - 1 : (elem_type) -1;
 }
 
+/* Returns a mask of the bits of element ELEM_IDX(START) that lie
+   in the range [START, END), which must not be empty. */
+static inline elem_type
+range_mask (size_t start, size_t end) {
+	size_t first = elem_idx (start) * ELEM_BITS;
+	elem_type mask = (elem_type) -1 << (start - first);
+	if (end - first < ELEM_BITS)
+		mask &= ((elem_type) 1 << (end - first)) - 1;
+	return mask;
+}
+
+/* Returns the number of 1-bits in W.  __builtin_popcountl() would
+   need libgcc without the POPCNT instruction. */
+static inline size_t
+popcount (elem_type w) {
+	w = w - ((w >> 1) & 0x5555555555555555UL);
+	w = (w & 0x3333333333333333UL) + ((w >> 2) & 0x3333333333333333UL);
+	w = (w + (w >> 4)) & 0x0f0f0f0f0f0f0f0fUL;
+	return (w * 0x0101010101010101UL) >> 56;
+}
+
+/* Returns the element of B holding bit BIT_IDX, with each bit
+   inverted unless VALUE, so that bits equal to VALUE read as 1. */
+static inline elem_type
+elem_value (const struct bitmap *b, size_t bit_idx, bool value) {
+	elem_type w = b->bits[elem_idx (bit_idx)];
+	return value ? w : ~w;
+}
+
+/* Returns the index of the first bit in B at or after START and
+   before END that is set to VALUE, or END if there is none.
+   Whole elements without such a bit are skipped at once. */
+static size_t
+find_bit (const struct bitmap *b, size_t start, size_t end, bool value) {
+	while (start < end) {
+		elem_type w = elem_value (b, start, value) & range_mask (start, end);
+		if (w != 0)
+			return elem_idx (start) * ELEM_BITS + __builtin_ctzl (w);
+		start = (elem_idx (start) + 1) * ELEM_BITS;
+	}
+	return end;
+}
+
 /* Creation and destruction. */
 
 /* Initializes B to be a bitmap of BIT_CNT bits
@@ -74,6 +118,7 @@ bitmap_create (size_t bit_cnt) {
 	struct bitmap *b = malloc (sizeof *b);
 	if (b != NULL) {
 		b->bit_cnt = bit_cnt;
+		b->cursor = 0;
 		b->bits = malloc (byte_cnt (bit_cnt));
 		if (b->bits != NULL || bit_cnt == 0) {
 			bitmap_set_all (b, false);
@@ -94,6 +139,7 @@ bitmap_create_in_buf (size_t bit_cnt, void *block, size_t block_size UNUSED) {
 	ASSERT (block_size >= bitmap_buf_size (bit_cnt));
 
 	b->bit_cnt = bit_cnt;
+	b->cursor = 0;
 	b->bits = (elem_type *) (b + 1);
 	bitmap_set_all (b, false);
 	return b;
@@ -194,33 +240,45 @@ bitmap_set_all (struct bitmap *b, bool value) {
 	bitmap_set_multiple (b, 0, bitmap_size (b), value);
 }
 
-/* Sets the CNT bits starting at START in B to VALUE. */
+/* Sets the CNT bits starting at START in B to VALUE.  Each
+   element is updated atomically, as by bitmap_set(). */
 void
 bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value) {
-	size_t i;
+	size_t end = start + cnt;
 
 	ASSERT (b != NULL);
 	ASSERT (start <= b->bit_cnt);
 	ASSERT (start + cnt <= b->bit_cnt);
 
-	for (i = 0; i < cnt; i++)
-		bitmap_set (b, start + i, value);
+	while (start < end) {
+		elem_type *e = &b->bits[elem_idx (start)];
+		elem_type mask = range_mask (start, end);
+
+		if (value)
+			asm ("lock orq %1, %0" : "+m" (*e) : "r" (mask) : "cc");
+		else
+			asm ("lock andq %1, %0" : "+m" (*e) : "r" (~mask) : "cc");
+		start = (elem_idx (start) + 1) * ELEM_BITS;
+	}
 }
 
 /* Returns the number of bits in B between START and START + CNT,
    exclusive, that are set to VALUE. */
 size_t
 bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value) {
-	size_t i, value_cnt;
+	size_t end = start + cnt;
+	size_t value_cnt;
 
 	ASSERT (b != NULL);
 	ASSERT (start <= b->bit_cnt);
 	ASSERT (start + cnt <= b->bit_cnt);
 
 	value_cnt = 0;
-	for (i = 0; i < cnt; i++)
-		if (bitmap_test (b, start + i) == value)
-			value_cnt++;
+	while (start < end) {
+		value_cnt += popcount (elem_value (b, start, value)
+				& range_mask (start, end));
+		start = (elem_idx (start) + 1) * ELEM_BITS;
+	}
 	return value_cnt;
 }
 
@@ -228,16 +286,11 @@ bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value) {
    exclusive, are set to VALUE, and false otherwise. */
 bool
 bitmap_contains (const struct bitmap *b, size_t start, size_t cnt, bool value) {
-	size_t i;
-
 	ASSERT (b != NULL);
 	ASSERT (start <= b->bit_cnt);
 	ASSERT (start + cnt <= b->bit_cnt);
 
-	for (i = 0; i < cnt; i++)
-		if (bitmap_test (b, start + i) == value)
-			return true;
-	return false;
+	return find_bit (b, start, start + cnt, value) < start + cnt;
 }
 
 /* Returns true if any bits in B between START and START + CNT,
@@ -272,12 +325,26 @@ bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value) {
 	ASSERT (b != NULL);
 	ASSERT (start <= b->bit_cnt);
 
+	if (cnt == 0)
+		return start;
 	if (cnt <= b->bit_cnt) {
 		size_t last = b->bit_cnt - cnt;
-		size_t i;
-		for (i = start; i <= last; i++)
-			if (!bitmap_contains (b, i, cnt, !value))
+		size_t i = start;
+
+		/* Jump to the next bit set to VALUE, then past the first
+		   bit set to !VALUE after it, until the group is long
+		   enough. */
+		while (i <= last) {
+			size_t run_end;
+
+			i = find_bit (b, i, last + 1, value);
+			if (i > last)
+				break;
+			run_end = find_bit (b, i, i + cnt, !value);
+			if (run_end == i + cnt)
 				return i;
+			i = run_end + 1;
+		}
 	}
 	return BITMAP_ERROR;
 }
@@ -296,7 +363,29 @@ bitmap_scan_and_flip (struct bitmap *b, size_t start, size_t cnt, bool value) {
 		bitmap_set_multiple (b, idx, cnt, !value);
 	return idx;
 }
-
+
+/* Like bitmap_scan_and_flip(), but starts where the previous call
+   on B left off and wraps around to bit 0, so that a run of
+   allocations does not rescan the groups it already took.  The
+   groups found are not necessarily the lowest ones. */
+size_t
+bitmap_scan_and_flip_next (struct bitmap *b, size_t cnt, bool value) {
+	size_t idx;
+
+	ASSERT (b != NULL);
+
+	if (b->cursor > b->bit_cnt)
+		b->cursor = 0;
+	idx = bitmap_scan (b, b->cursor, cnt, value);
+	if (idx == BITMAP_ERROR && b->cursor != 0)
+		idx = bitmap_scan (b, 0, cnt, value);
+	if (idx != BITMAP_ERROR) {
+		bitmap_set_multiple (b, idx, cnt, !value);
+		b->cursor = idx + cnt;
+	}
+	return idx;
+}
+
 /* File input and output. */
 
 #ifdef FILESYS
@@ -326,6 +415,25 @@ bitmap_write (const struct bitmap *b, struct file *file) {
 	off_t size = byte_cnt (b->bit_cnt);
 	return file_write_at (file, b->bits, size, 0) == size;
 }
+
+/* Writes the bytes of B that hold bits START through START + CNT - 1,
+   or up to the end of B, to the same place in FILE, in which the
+   rest of B was written before.  Returns true if successful, false
+   otherwise. */
+bool
+bitmap_write_part (const struct bitmap *b, struct file *file,
+		size_t start, size_t cnt) {
+	off_t ofs, size;
+
+	ASSERT (start <= b->bit_cnt);
+
+	if (cnt > b->bit_cnt - start)
+		cnt = b->bit_cnt - start;
+	ofs = start / 8;
+	size = byte_cnt (start + cnt) - ofs;
+	return file_write_at (file, (const uint8_t *) b->bits + ofs, size, ofs)
+		== size;
+}
 #endif /* FILESYS */
 
 /* Debugging. */
@@ -1,6 +1,7 @@
 #include <console.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
 #include "devices/serial.h"
 #include "devices/vga.h"
 #include "threads/init.h"
@@ -9,6 +10,7 @@
 
 static void vprintf_helper (char, void *);
 static void putchar_have_lock (uint8_t c);
+static void putbuf_have_lock (const char *, size_t);
 
 /* The console lock.
    Both the vga and serial layers do their own locking, so it's
@@ -111,18 +113,48 @@ console_locked_by_current_thread (void) {
 			|| lock_held_by_current_thread (&console_lock));
 }
 
+/* Auxiliary data for vprintf_helper(). */
+struct vprintf_aux {
+	char buf[128];      /* Formatted characters not yet written. */
+	size_t len;         /* Characters in BUF. */
+	int char_cnt;       /* Total characters formatted so far. */
+	bool locked;        /* Console lock acquired? */
+};
+
+/* Writes out the buffer in AUX, first taking the console lock if
+   this is the first time. */
+static void
+vprintf_flush (struct vprintf_aux *aux) {
+	if (!aux->locked) {
+		acquire_console ();
+		aux->locked = true;
+	}
+	putbuf_have_lock (aux->buf, aux->len);
+	aux->len = 0;
+}
+
 /* The standard vprintf() function,
    which is like printf() but uses a va_list.
-   Writes its output to both vga display and serial port. */
+   Writes its output to both vga display and serial port.
+
+   The output is formatted into a buffer on the stack and written
+   with one call to each device, so the console lock is held only
+   while writing, not while formatting, and never at all for the
+   characters one by one.  Output longer than the buffer takes the
+   lock at the first full buffer and keeps it to the end, so that
+   it is still not mixed with other threads' output. */
 int
 vprintf (const char *format, va_list args) {
-	int char_cnt = 0;
+	struct vprintf_aux aux;
 
-	acquire_console ();
-	__vprintf (format, args, vprintf_helper, &char_cnt);
+	aux.len = 0;
+	aux.char_cnt = 0;
+	aux.locked = false;
+	__vprintf (format, args, vprintf_helper, &aux);
+	vprintf_flush (&aux);
 	release_console ();
 
-	return char_cnt;
+	return aux.char_cnt;
 }
 
 /* Writes string S to the console, followed by a new-line
@@ -130,8 +162,7 @@ vprintf (const char *format, va_list args) {
 int
 puts (const char *s) {
 	acquire_console ();
-	while (*s != '\0')
-		putchar_have_lock (*s++);
+	putbuf_have_lock (s, strlen (s));
 	putchar_have_lock ('\n');
 	release_console ();
 
@@ -143,8 +174,7 @@ puts (const char *s) {
 void
 putbuf (const char *buffer, size_t n) {
 	acquire_console ();
-	while (n-- > 0)
-		putchar_have_lock (*buffer++);
+	putbuf_have_lock (buffer, n);
 	release_console (); // lock 풀어주고 console에 있는 거 작성해주나?
 }
 
@@ -160,10 +190,24 @@ putchar (int c) {
 
 /* Helper function for vprintf(). */
 static void
-vprintf_helper (char c, void *char_cnt_) {
-	int *char_cnt = char_cnt_;
-	(*char_cnt)++;
-	putchar_have_lock (c);
+vprintf_helper (char c, void *aux_) {
+	struct vprintf_aux *aux = aux_;
+
+	aux->buf[aux->len++] = c;
+	if (aux->len >= sizeof aux->buf)
+		vprintf_flush (aux);
+	aux->char_cnt++;
+}
+
+/* Writes the N characters in BUFFER to the vga display and serial
+   port.  The caller has already acquired the console lock if
+   appropriate. */
+static void
+putbuf_have_lock (const char *buffer, size_t n) {
+	ASSERT (console_locked_by_current_thread ());
+	write_cnt += n;
+	serial_write ((const uint8_t *) buffer, n);
+	vga_write (buffer, n);
 }
 
 /* Writes C to the vga display and serial port.
@@ -7,6 +7,7 @@
 #include <string.h>
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/smp.h"
 #include "devices/serial.h"
 
 /* Halts the OS, printing the source file name, line number, and
@@ -38,6 +39,7 @@ debug_panic (const char *file, int line, const char *function,
 	}
 
 	serial_flush ();
+	smp_halt_others ();
 	if (power_off_when_done)
 		power_off ();
 	for (;;);
@@ -255,7 +255,63 @@ hash_bytes (const void *buf_, size_t size) {
 	return hash;
 }
 
-/* Returns a hash of string S. */
+/* Returns a hash of the 64-bit value X.
+
+   This is the finalizer of MurmurHash3: two multiply and shift
+   rounds that let every bit of X affect every bit of the result,
+   so that page addresses or small integers, which differ only in
+   a few bits, still spread over all buckets.  That is much cheaper
+   than running hash_bytes() over the 8 bytes of X. */
+uint64_t
+hash_u64 (uint64_t x) {
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdUL;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53UL;
+	x ^= x >> 33;
+	return x;
+}
+
+/* Returns a hash of pointer P, which is not dereferenced. */
+uint64_t
+hash_ptr (const void *p) {
+	return hash_u64 ((uintptr_t) p);
+}
+
+/* Value with each of the 8 bytes equal to 0x01. */
+#define ONES 0x0101010101010101UL
+
+/* Nonzero if and only if some byte of W is zero.  The lowest set
+   bit is always the top bit of the first zero byte. */
+#define HAS_ZERO(W) (((W) - ONES) & ~(W) & (ONES * 0x80))
+
+/* Returns the next up to 8 bytes of string S as a little-endian
+   word, with the terminator and anything after it as zeros. */
+static inline uint64_t
+string_word (const unsigned char *s) {
+	uint64_t w = 0;
+	int i;
+
+	/* Read a whole word only if it cannot run into the next,
+	   possibly unmapped, page. */
+	if (((uintptr_t) s & (4096 - 1)) <= 4096 - 8) {
+		uint64_t z;
+
+		w = *(const uint64_t __attribute__ ((may_alias)) *) s;
+		z = HAS_ZERO (w);
+		if (z != 0) {
+			int len = __builtin_ctzl (z) / 8;
+			w = len != 0 ? w & ((1UL << (len * 8)) - 1) : 0;
+		}
+		return w;
+	}
+
+	for (i = 0; i < 8 && s[i] != '\0'; i++)
+		w |= (uint64_t) s[i] << (i * 8);
+	return w;
+}
+
+/* Returns a hash of string S.  S is read 8 bytes at a time. */
 uint64_t
 hash_string (const char *s_) {
 	const unsigned char *s = (const unsigned char *) s_;
@@ -264,18 +320,25 @@ hash_string (const char *s_) {
 	ASSERT (s != NULL);
 
 	hash = FNV_64_BASIS;
-	while (*s != '\0')
-		hash = (hash * FNV_64_PRIME) ^ *s++;
+	for (;;) {
+		uint64_t w = string_word (s);
 
-	return hash;
+		hash = (hash ^ w) * 0x9e3779b97f4a7c15UL;
+		hash ^= hash >> 29;
+		if (HAS_ZERO (w))
+			break;
+		s += 8;
+	}
+
+	return hash_u64 (hash);
 }
 
 /* Returns a hash of integer I. */
 uint64_t
 hash_int (int i) {
-	return hash_bytes (&i, sizeof i);
+	return hash_u64 ((unsigned) i);
 }
-
+
 /* Returns the bucket in H that E belongs in. */
 static struct list *
 find_bucket (struct hash *h, struct hash_elem *e) {
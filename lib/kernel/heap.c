@@ -0,0 +1,182 @@
+#include "heap.h"
+#include "../debug.h"
+
+/* Our heaps are pairing heaps: a heap-ordered multiway tree kept
+   in leftmost-child, next-sibling form.  The root is the top
+   element.  Each element's children form a doubly linked sibling
+   list; the `prev' link of a leftmost child points to its parent
+   instead of a sibling, which lets an arbitrary element be cut
+   out of the tree in O(1) before its children are merged back.
+
+   Pushing an element just melds it with the root.  Popping the
+   root merges its children in two passes, first pairing them up
+   left to right and then melding the pairs right to left; this is
+   what gives the O(lg n) amortized bound. */
+
+static struct heap_elem *meld (struct heap *,
+		struct heap_elem *, struct heap_elem *);
+static struct heap_elem *merge_pairs (struct heap *, struct heap_elem *);
+
+/* Initializes HEAP as an empty heap ordered by LESS, given
+   auxiliary data AUX. */
+void
+heap_init (struct heap *heap, heap_less_func *less, void *aux) {
+	ASSERT (heap != NULL);
+	ASSERT (less != NULL);
+
+	heap->root = NULL;
+	heap->size = 0;
+	heap->less = less;
+	heap->aux = aux;
+}
+
+/* Inserts ELEM into HEAP. */
+void
+heap_push (struct heap *heap, struct heap_elem *elem) {
+	ASSERT (heap != NULL);
+	ASSERT (elem != NULL);
+
+	elem->child = elem->next = elem->prev = NULL;
+	heap->root = meld (heap, heap->root, elem);
+	heap->size++;
+}
+
+/* Removes the top element of HEAP and returns it.  Undefined
+   behavior if HEAP is empty before removal. */
+struct heap_elem *
+heap_pop (struct heap *heap) {
+	struct heap_elem *top;
+
+	ASSERT (heap != NULL);
+	ASSERT (heap->root != NULL);
+
+	top = heap->root;
+	heap->root = merge_pairs (heap, top->child);
+	heap->size--;
+
+	top->child = top->next = top->prev = NULL;
+	return top;
+}
+
+/* Removes ELEM, which must be in HEAP, from HEAP. */
+void
+heap_remove (struct heap *heap, struct heap_elem *elem) {
+	struct heap_elem *sub;
+
+	ASSERT (heap != NULL);
+	ASSERT (elem != NULL);
+
+	if (elem == heap->root) {
+		heap_pop (heap);
+		return;
+	}
+
+	/* Cut ELEM and its subtree out of its sibling list. */
+	ASSERT (elem->prev != NULL);
+	if (elem->prev->child == elem)
+		elem->prev->child = elem->next;
+	else
+		elem->prev->next = elem->next;
+	if (elem->next != NULL)
+		elem->next->prev = elem->prev;
+
+	/* Put its children back. */
+	sub = merge_pairs (heap, elem->child);
+	heap->root = meld (heap, heap->root, sub);
+	heap->size--;
+
+	elem->child = elem->next = elem->prev = NULL;
+}
+
+/* Restores the heap order after the key of ELEM, which must be in
+   HEAP, has changed. */
+void
+heap_update (struct heap *heap, struct heap_elem *elem) {
+	heap_remove (heap, elem);
+	heap_push (heap, elem);
+}
+
+/* Returns the top element of HEAP, or NULL if HEAP is empty. */
+struct heap_elem *
+heap_top (struct heap *heap) {
+	ASSERT (heap != NULL);
+	return heap->root;
+}
+
+/* Returns the number of elements in HEAP. */
+size_t
+heap_size (struct heap *heap) {
+	ASSERT (heap != NULL);
+	return heap->size;
+}
+
+/* Returns true if HEAP is empty, false otherwise. */
+bool
+heap_empty (struct heap *heap) {
+	ASSERT (heap != NULL);
+	return heap->root == NULL;
+}
+
+/* Melds the trees rooted at A and B, either of which may be
+   null, and returns the new root.  Neither A nor B may have
+   siblings. */
+static struct heap_elem *
+meld (struct heap *heap, struct heap_elem *a, struct heap_elem *b) {
+	struct heap_elem *t;
+
+	if (a == NULL)
+		return b;
+	if (b == NULL)
+		return a;
+
+	if (heap->less (b, a, heap->aux)) {
+		t = a;
+		a = b;
+		b = t;
+	}
+
+	/* Make B the leftmost child of A. */
+	b->prev = a;
+	b->next = a->child;
+	if (a->child != NULL)
+		a->child->prev = b;
+	a->child = b;
+	return a;
+}
+
+/* Merges the sibling list that starts at FIRST into one tree and
+   returns its root, or a null pointer if FIRST is null. */
+static struct heap_elem *
+merge_pairs (struct heap *heap, struct heap_elem *first) {
+	struct heap_elem *pairs = NULL;
+	struct heap_elem *root = NULL;
+
+	/* First pass: meld adjacent pairs from left to right, stacking
+	   the results on PAIRS through their `next' links. */
+	while (first != NULL) {
+		struct heap_elem *a = first;
+		struct heap_elem *b = a->next;
+
+		first = b != NULL ? b->next : NULL;
+		a->next = a->prev = NULL;
+		if (b != NULL)
+			b->next = b->prev = NULL;
+
+		a = meld (heap, a, b);
+		a->next = pairs;
+		pairs = a;
+	}
+
+	/* Second pass: meld the pairs from right to left. */
+	while (pairs != NULL) {
+		struct heap_elem *p = pairs;
+
+		pairs = p->next;
+		p->next = NULL;
+		root = meld (heap, root, p);
+	}
+
+	if (root != NULL)
+		root->prev = NULL;
+	return root;
+}
@@ -34,267 +34,6 @@
 static bool is_sorted (struct list_elem *a, struct list_elem *b,
 		list_less_func *less, void *aux) UNUSED;
 
-/* Returns true if ELEM is a head, false otherwise. */
-static inline bool
-is_head (struct list_elem *elem) {
-	return elem != NULL && elem->prev == NULL && elem->next != NULL;
-}
-
-/* Returns true if ELEM is an interior element,
-   false otherwise. */
-static inline bool
-is_interior (struct list_elem *elem) {
-	// printf("interior elem 있나 %d\n", elem);
-	// printf("interior elem prev 있나 %d\n", elem->prev);
-	// printf("interior elem next 있나 %d\n", elem->next);
-	return elem != NULL && elem->prev != NULL && elem->next != NULL;
-}
-
-/* Returns true if ELEM is a tail, false otherwise. */
-static inline bool
-is_tail (struct list_elem *elem) {
-	// printf("tail elem 있나 %d\n", elem);
-	// printf("tail elem prev 있나 %d\n", elem->prev);
-	// printf("tail elem next 있나 %d\n", elem->next);
-	return elem != NULL && elem->prev != NULL && elem->next == NULL;
-}
-
-/* Initializes LIST as an empty list. */
-/* list 자료 구조를 초기화 */
-void
-list_init (struct list *list) {		// list의 포인터형 변수로 & 메모리 주소를 받음
-	ASSERT (list != NULL);			// list가 NULL이 아니어야 프로그램 진행됨 (메모리 주소가 들어왔어야 함)
-	list->head.prev = NULL;			// list의 head의 prev 포인터 변수에 주소값으로 NULL을 넣어줌
-	list->head.next = &list->tail;	// list의 head의 next 포인터 변수에 주소값으로 list 변수의 tail 주소를 넣어줌
-	list->tail.prev = &list->head;  // list의 tail의 prev 포인터 변수에 주소값으로 list 변수의 head 주소를 넣어줌
-	list->tail.next = NULL;			// list의 tail의 next 포인터 변수에 주소값으로 NULL을 넣어줌
-}
-
-/* Returns the beginning of LIST.  */
-struct list_elem *
-list_begin (struct list *list) {
-	ASSERT (list != NULL);
-	return list->head.next;			// list의 head의 next 포인터 변수를 리턴 -> 그래서 list_elem *e 포인터 변수로 받는 것
-}
-
-/* Returns the element after ELEM in its list.  If ELEM is the
-   last element in its list, returns the list tail.  Results are
-   undefined if ELEM is itself a list tail. */
-struct list_elem *
-list_next (struct list_elem *elem) {
-	ASSERT (is_head (elem) || is_interior (elem));
-	return elem->next;
-}
-
-/* Returns LIST's tail.
-
-   list_end() is often used in iterating through a list from
-   front to back.  See the big comment at the top of list.h for
-   an example. */
-struct list_elem *
-list_end (struct list *list) {
-	ASSERT (list != NULL);
-	return &list->tail;
-}
-
-/* Returns the LIST's reverse beginning, for iterating through
-   LIST in reverse order, from back to front. */
-struct list_elem *
-list_rbegin (struct list *list) {
-	ASSERT (list != NULL);
-	return list->tail.prev;
-}
-
-/* Returns the element before ELEM in its list.  If ELEM is the
-   first element in its list, returns the list head.  Results are
-   undefined if ELEM is itself a list head. */
-struct list_elem *
-list_prev (struct list_elem *elem) {
-	ASSERT (is_interior (elem) || is_tail (elem));
-	return elem->prev;
-}
-
-/* Returns LIST's head.
-
-   list_rend() is often used in iterating through a list in
-   reverse order, from back to front.  Here's typical usage,
-   following the example from the top of list.h:
-
-   for (e = list_rbegin (&foo_list); e != list_rend (&foo_list);
-   e = list_prev (e))
-   {
-   struct foo *f = list_entry (e, struct foo, elem);
-   ...do something with f...
-   }
-   */
-struct list_elem *
-list_rend (struct list *list) {
-	ASSERT (list != NULL);
-	return &list->head;
-}
-
-/* Return's LIST's head.
-
-   list_head() can be used for an alternate style of iterating
-   through a list, e.g.:
-
-   e = list_head (&list);
-   while ((e = list_next (e)) != list_end (&list))
-   {
-   ...
-   }
-   */
-struct list_elem *
-list_head (struct list *list) {
-	ASSERT (list != NULL);
-	return &list->head;
-}
-
-/* Return's LIST's tail. */
-struct list_elem *
-list_tail (struct list *list) {
-	ASSERT (list != NULL);
-	return &list->tail;
-}
-
-/* Inserts ELEM just before BEFORE, which may be either an
-   interior element or a tail.  The latter case is equivalent to
-   list_push_back(). */
-void
-list_insert (struct list_elem *before, struct list_elem *elem) {
-	// printf("이게 되나? %d \n", before);
-	// printf("여기 들어오나1\n");
-	// printf(is_interior (before) ? "true" : "false");
-	// printf("\n");
-	// printf("여기 들어오나2\n");
-	// printf(is_tail (before) ? "true" : "false");
-	// printf("\n");
-	ASSERT (is_interior (before) || is_tail (before));
-	ASSERT (elem != NULL);
-
-	elem->prev = before->prev;
-	elem->next = before;
-	before->prev->next = elem;
-	before->prev = elem;
-}
-
-/* Removes elements FIRST though LAST (exclusive) from their
-   current list, then inserts them just before BEFORE, which may
-   be either an interior element or a tail. */
-void
-list_splice (struct list_elem *before,
-		struct list_elem *first, struct list_elem *last) {
-	ASSERT (is_interior (before) || is_tail (before));
-	if (first == last)
-		return;
-	last = list_prev (last);
-
-	ASSERT (is_interior (first));
-	ASSERT (is_interior (last));
-
-	/* Cleanly remove FIRST...LAST from its current list. */
-	first->prev->next = last->next;
-	last->next->prev = first->prev;
-
-	/* Splice FIRST...LAST into new list. */
-	first->prev = before->prev;
-	last->next = before;
-	before->prev->next = first;
-	before->prev = last;
-}
-
-/* Inserts ELEM at the beginning of LIST, so that it becomes the
-   front in LIST. */
-/* elem을 list의 처음에 삽입 */
-void
-list_push_front (struct list *list, struct list_elem *elem) {
-	list_insert (list_begin (list), elem);
-}
-
-/* Inserts ELEM at the end of LIST, so that it becomes the
-   back in LIST. */
-/* elem을 list의 끝에 삽입 */
-void
-list_push_back (struct list *list, struct list_elem *elem) {
-	list_insert (list_end (list), elem);
-}
-
-/* Removes ELEM from its list and returns the element that
-   followed it.  Undefined behavior if ELEM is not in a list.
-
-   It's not safe to treat ELEM as an element in a list after
-   removing it.  In particular, using list_next() or list_prev()
-   on ELEM after removal yields undefined behavior.  This means
-   that a naive loop to remove the elements in a list will fail:
-
- ** DON'T DO THIS **
- for (e = list_begin (&list); e != list_end (&list); e = list_next (e))
- {
- ...do something with e...
- list_remove (e);
- }
- ** DON'T DO THIS **
-
- Here is one correct way to iterate and remove elements from a
-list:
-
-for (e = list_begin (&list); e != list_end (&list); e = list_remove (e))
-{
-...do something with e...
-}
-
-If you need to free() elements of the list then you need to be
-more conservative.  Here's an alternate strategy that works
-even in that case:
-
-while (!list_empty (&list))
-{
-struct list_elem *e = list_pop_front (&list);
-...do something with e...
-}
-*/
-struct list_elem *
-list_remove (struct list_elem *elem) {
-	ASSERT (is_interior (elem));
-	elem->prev->next = elem->next;
-	elem->next->prev = elem->prev;
-	return elem->next; // next 포인터 반환
-}
-
-/* Removes the front element from LIST and returns it.
-   Undefined behavior if LIST is empty before removal. */
-struct list_elem *
-list_pop_front (struct list *list) {
-	struct list_elem *front = list_front (list);
-	list_remove (front);
-	return front;
-}
-
-/* Removes the back element from LIST and returns it.
-   Undefined behavior if LIST is empty before removal. */
-struct list_elem *
-list_pop_back (struct list *list) {
-	struct list_elem *back = list_back (list);
-	list_remove (back);
-	return back;
-}
-
-/* Returns the front element in LIST.
-   Undefined behavior if LIST is empty. */
-struct list_elem *
-list_front (struct list *list) {
-	ASSERT (!list_empty (list));
-	return list->head.next;
-}
-
-/* Returns the back element in LIST.
-   Undefined behavior if LIST is empty. */
-struct list_elem *
-list_back (struct list *list) {
-	ASSERT (!list_empty (list));
-	return list->tail.prev;
-}
-
 /* Returns the number of elements in LIST.
    Runs in O(n) in the number of elements. */
 size_t
@@ -307,12 +46,6 @@ list_size (struct list *list) {
 	return cnt;
 }
 
-/* Returns true if LIST is empty, false otherwise. */
-bool
-list_empty (struct list *list) {
-	return list_begin (list) == list_end (list);
-}
-
 /* Swaps the `struct list_elem *'s that A and B point to. */
 static void
 swap (struct list_elem **a, struct list_elem **b) {
@@ -432,29 +165,6 @@ list_sort (struct list *list, list_less_func *less, void *aux) {
 	ASSERT (is_sorted (list_begin (list), list_end (list), less, aux));
 }
 
-/* Inserts ELEM in the proper position in LIST, which must be
-   sorted according to LESS given auxiliary data AUX.
-   Runs in O(n) average case in the number of elements in LIST. */
-/*
-   LIST의 적절한 위치에 ELEM을 삽입합니다. 
-   이 ELEM은 지정된 보조 데이터 AUX에 따라 정렬되어야 합니다.
-   LIST의 요소 수에서 O(n) 평균 대/소문자로 실행됩니다.
-*/
-void
-list_insert_ordered (struct list *list, struct list_elem *elem,
-		list_less_func *less, void *aux) {
-	struct list_elem *e;
-
-	ASSERT (list != NULL);
-	ASSERT (elem != NULL);
-	ASSERT (less != NULL);
-
-	for (e = list_begin (list); e != list_end (list); e = list_next (e)) // e에는 인자로 받은 리스트의 처음부터 끝까지 원소를 넣어줌
-		if (less (elem, e, aux)) // 그래서 입력받은 elem과 리스트의 전체 원소가 비교되면서 정렬되는 것
-			break;				 // 현재 elem의 속성값 > 입력받은 elem의 속성값이면 참이 되어서 거기에 삽입하겠다는 뜻
-	return list_insert (e, elem);
-}
-
 /* Iterates through LIST and removes all but the first in each
    set of adjacent elements that are equal according to LESS
    given auxiliary data AUX.  If DUPLICATES is non-null, then the
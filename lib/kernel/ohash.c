@@ -0,0 +1,468 @@
+/* Open-addressing hash table.
+
+   See ohash.h for basic information.
+
+   Each table is an array of SLOT_CNT element pointers and an array
+   of SLOT_CNT control bytes.  A control byte is CTRL_EMPTY,
+   CTRL_DELETED, or the low 7 bits of the hash of the element in
+   the slot (so the top bit is set only for slots without an
+   element).  An element with hash H is looked for in groups of
+   GROUP consecutive slots starting at slot H >> 7, one group after
+   another, until a group holds an empty slot.  Deleting an
+   element leaves a CTRL_DELETED "tombstone" so that those probe
+   sequences stay intact; tombstones are dropped when the table is
+   rebuilt.
+
+   The control array has GROUP extra bytes at its end that mirror
+   its first GROUP bytes, so that a group starting near the end can
+   be loaded as a single word without wrapping around. */
+
+#include "ohash.h"
+#include <string.h>
+#include "../debug.h"
+#include "threads/malloc.h"
+
+/* Slots per probe group, one 64-bit word of control bytes. */
+#define GROUP 8
+
+/* Control bytes of slots without an element. */
+#define CTRL_EMPTY 0x80
+#define CTRL_DELETED 0xfe
+
+/* Smallest table. */
+#define MIN_SLOTS 16
+
+/* Old slots moved to the new table by each insertion or
+   deletion while the table grows.  The new table is at least the
+   size of the old one and starts out at most half full, so the
+   move is long finished before the new table fills up. */
+#define MIGRATE_STEP 8
+
+/* Value with each of the 8 bytes equal to 0x01, and the same with
+   0x80. */
+#define ONES 0x0101010101010101ULL
+#define HIGHS (ONES * 0x80)
+
+/* A 64-bit word that may alias anything and be unaligned. */
+typedef uint64_t __attribute__ ((may_alias)) group_t;
+
+static bool table_alloc (struct ohash_table *, size_t slot_cnt);
+static void table_free (struct ohash_table *);
+static size_t table_find (struct ohash *, struct ohash_table *,
+		struct ohash_elem *);
+static void table_place (struct ohash_table *, struct ohash_elem *);
+static struct ohash_table *locate (struct ohash *, struct ohash_elem *,
+		size_t *idx);
+static void grow (struct ohash *);
+static void migrate (struct ohash *, size_t cnt);
+
+/* Returns the control byte for hash value HASH. */
+static inline uint8_t
+hash_ctrl (uint64_t hash) {
+	return hash & 0x7f;
+}
+
+/* Returns the 8 control bytes of T starting at slot IDX. */
+static inline uint64_t
+load_group (const struct ohash_table *t, size_t idx) {
+	return *(const group_t *) (t->ctrl + idx);
+}
+
+/* Returns a mask with the top bit set in each byte of group G that
+   may equal C, which must be below 0x80.  There may be false
+   positives, but only on slots that hold elements. */
+static inline uint64_t
+match_ctrl (uint64_t g, uint8_t c) {
+	uint64_t x = g ^ (c * ONES);
+	return (x - ONES) & ~x & HIGHS;
+}
+
+/* Returns a mask with the top bit set in each byte of group G that
+   is CTRL_EMPTY. */
+static inline uint64_t
+match_empty (uint64_t g) {
+	return g & (~g << 6) & HIGHS;
+}
+
+/* Returns a mask with the top bit set in each byte of group G that
+   is CTRL_EMPTY or CTRL_DELETED. */
+static inline uint64_t
+match_free (uint64_t g) {
+	return g & ~(g << 7) & HIGHS;
+}
+
+/* Returns the slot of T at byte M, a mask from one of the match_*()
+   functions, of the group that starts at slot IDX. */
+static inline size_t
+match_slot (const struct ohash_table *t, size_t idx, uint64_t m) {
+	return (idx + __builtin_ctzll (m) / 8) & (t->slot_cnt - 1);
+}
+
+/* Sets the control byte of slot IDX in T to C. */
+static inline void
+set_ctrl (struct ohash_table *t, size_t idx, uint8_t c) {
+	t->ctrl[idx] = c;
+	if (idx < GROUP)
+		t->ctrl[t->slot_cnt + idx] = c;
+}
+
+/* Returns true if slot IDX of T holds an element. */
+static inline bool
+slot_full (const struct ohash_table *t, size_t idx) {
+	return t->ctrl[idx] < CTRL_EMPTY;
+}
+
+/* Initializes hash table H to compute hash values using HASH and
+   compare hash elements using LESS, given auxiliary data AUX. */
+bool
+ohash_init (struct ohash *h,
+		ohash_hash_func *hash, ohash_less_func *less, void *aux) {
+	h->elem_cnt = 0;
+	h->old.slot_cnt = 0;
+	h->migrate_idx = 0;
+	h->hash = hash;
+	h->less = less;
+	h->aux = aux;
+	return table_alloc (&h->cur, MIN_SLOTS);
+}
+
+/* Removes all the elements from H.
+
+   If DESTRUCTOR is non-null, then it is called for each element
+   in the hash.  DESTRUCTOR may, if appropriate, deallocate the
+   memory used by the hash element.  However, modifying hash
+   table H while ohash_clear() is running yields undefined
+   behavior, whether done in DESTRUCTOR or elsewhere. */
+void
+ohash_clear (struct ohash *h, ohash_action_func *destructor) {
+	if (destructor != NULL)
+		ohash_apply (h, destructor);
+
+	table_free (&h->old);
+	memset (h->cur.ctrl, CTRL_EMPTY, h->cur.slot_cnt + GROUP);
+	h->cur.used_cnt = 0;
+	h->elem_cnt = 0;
+}
+
+/* Destroys hash table H.
+
+   If DESTRUCTOR is non-null, then it is first called for each
+   element in the hash, as in ohash_clear(). */
+void
+ohash_destroy (struct ohash *h, ohash_action_func *destructor) {
+	ohash_clear (h, destructor);
+	table_free (&h->cur);
+}
+
+/* Inserts NEW into hash table H and returns a null pointer, if
+   no equal element is already in the table.
+   If an equal element is already in the table, returns it
+   without inserting NEW. */
+struct ohash_elem *
+ohash_insert (struct ohash *h, struct ohash_elem *new) {
+	struct ohash_table *t;
+	size_t idx;
+
+	new->hash = h->hash (new, h->aux);
+	t = locate (h, new, &idx);
+	if (t != NULL)
+		return t->slots[idx];
+
+	grow (h);
+	table_place (&h->cur, new);
+	h->elem_cnt++;
+	migrate (h, MIGRATE_STEP);
+	return NULL;
+}
+
+/* Inserts NEW into hash table H, replacing any equal element
+   already in the table, which is returned. */
+struct ohash_elem *
+ohash_replace (struct ohash *h, struct ohash_elem *new) {
+	struct ohash_table *t;
+	struct ohash_elem *old;
+	size_t idx;
+
+	new->hash = h->hash (new, h->aux);
+	t = locate (h, new, &idx);
+	if (t == NULL)
+		return ohash_insert (h, new);
+
+	old = t->slots[idx];
+	t->slots[idx] = new;
+	return old;
+}
+
+/* Finds and returns an element equal to E in hash table H, or a
+   null pointer if no equal element exists in the table. */
+struct ohash_elem *
+ohash_find (struct ohash *h, struct ohash_elem *e) {
+	struct ohash_table *t;
+	size_t idx;
+
+	e->hash = h->hash (e, h->aux);
+	t = locate (h, e, &idx);
+	return t != NULL ? t->slots[idx] : NULL;
+}
+
+/* Finds, removes, and returns an element equal to E in hash
+   table H.  Returns a null pointer if no equal element existed
+   in the table.
+
+   If the elements of the hash table are dynamically allocated,
+   or own resources that are, then it is the caller's
+   responsibility to deallocate them. */
+struct ohash_elem *
+ohash_delete (struct ohash *h, struct ohash_elem *e) {
+	struct ohash_table *t;
+	struct ohash_elem *found;
+	size_t idx;
+
+	e->hash = h->hash (e, h->aux);
+	t = locate (h, e, &idx);
+	if (t == NULL)
+		return NULL;
+
+	found = t->slots[idx];
+	set_ctrl (t, idx, CTRL_DELETED);
+	h->elem_cnt--;
+	migrate (h, MIGRATE_STEP);
+	return found;
+}
+
+/* Calls ACTION for each element in hash table H in arbitrary
+   order.
+   Modifying hash table H while ohash_apply() is running yields
+   undefined behavior, whether done from ACTION or elsewhere. */
+void
+ohash_apply (struct ohash *h, ohash_action_func *action) {
+	struct ohash_iterator i;
+
+	ASSERT (action != NULL);
+
+	ohash_first (&i, h);
+	while (ohash_next (&i))
+		action (ohash_cur (&i), h->aux);
+}
+
+/* Initializes I for iterating hash table H.
+
+   Iteration idiom:
+
+   struct ohash_iterator i;
+
+   ohash_first (&i, h);
+   while (ohash_next (&i))
+   {
+   struct foo *f = ohash_entry (ohash_cur (&i), struct foo, elem);
+   ...do something with f...
+   }
+
+   Modifying hash table H during iteration, using any of the
+   functions ohash_clear(), ohash_destroy(), ohash_insert(),
+   ohash_replace(), or ohash_delete(), invalidates all
+   iterators. */
+void
+ohash_first (struct ohash_iterator *i, struct ohash *h) {
+	ASSERT (i != NULL);
+	ASSERT (h != NULL);
+
+	i->hash = h;
+	i->table = h->old.slot_cnt != 0 ? &h->old : &h->cur;
+	i->idx = 0;
+	i->elem = NULL;
+}
+
+/* Advances I to the next element in the hash table and returns
+   it.  Returns a null pointer if no elements are left.  Elements
+   are returned in arbitrary order. */
+struct ohash_elem *
+ohash_next (struct ohash_iterator *i) {
+	ASSERT (i != NULL);
+
+	for (;;) {
+		while (i->idx < i->table->slot_cnt) {
+			size_t idx = i->idx++;
+			if (slot_full (i->table, idx)) {
+				i->elem = i->table->slots[idx];
+				return i->elem;
+			}
+		}
+		if (i->table == &i->hash->cur)
+			break;
+		i->table = &i->hash->cur;
+		i->idx = 0;
+	}
+	i->elem = NULL;
+	return NULL;
+}
+
+/* Returns the current element in the hash table iteration, or a
+   null pointer at the end of the table.  Undefined behavior
+   after calling ohash_first() but before ohash_next(). */
+struct ohash_elem *
+ohash_cur (struct ohash_iterator *i) {
+	return i->elem;
+}
+
+/* Returns the number of elements in H. */
+size_t
+ohash_size (struct ohash *h) {
+	return h->elem_cnt;
+}
+
+/* Returns true if H contains no elements, false otherwise. */
+bool
+ohash_empty (struct ohash *h) {
+	return h->elem_cnt == 0;
+}
+
+/* Makes T an empty table of SLOT_CNT slots, a power of 2 no less
+   than MIN_SLOTS.  Returns true if successful, false on memory
+   allocation failure, in which case T is left unchanged. */
+static bool
+table_alloc (struct ohash_table *t, size_t slot_cnt) {
+	struct ohash_elem **slots;
+
+	ASSERT (slot_cnt >= MIN_SLOTS);
+	ASSERT ((slot_cnt & (slot_cnt - 1)) == 0);
+
+	slots = malloc (slot_cnt * sizeof *slots + slot_cnt + GROUP);
+	if (slots == NULL)
+		return false;
+
+	t->slot_cnt = slot_cnt;
+	t->used_cnt = 0;
+	t->slots = slots;
+	t->ctrl = (uint8_t *) (slots + slot_cnt);
+	memset (t->ctrl, CTRL_EMPTY, slot_cnt + GROUP);
+	return true;
+}
+
+/* Frees the arrays of T, if any, making it a table of no slots. */
+static void
+table_free (struct ohash_table *t) {
+	if (t->slot_cnt != 0) {
+		free (t->slots);
+		t->slot_cnt = 0;
+	}
+}
+
+/* Returns the slot of T that holds an element equal to E, whose
+   hash must already be set, or SIZE_MAX if there is none. */
+static size_t
+table_find (struct ohash *h, struct ohash_table *t, struct ohash_elem *e) {
+	uint8_t c = hash_ctrl (e->hash);
+	size_t mask = t->slot_cnt - 1;
+	size_t idx, probes;
+
+	if (t->slot_cnt == 0)
+		return SIZE_MAX;
+
+	idx = (e->hash >> 7) & mask;
+	for (probes = 0; probes <= t->slot_cnt / GROUP; probes++) {
+		uint64_t g = load_group (t, idx);
+		uint64_t m;
+
+		for (m = match_ctrl (g, c); m != 0; m &= m - 1) {
+			size_t slot = match_slot (t, idx, m);
+			struct ohash_elem *x = t->slots[slot];
+
+			if (x->hash == e->hash
+					&& !h->less (x, e, h->aux) && !h->less (e, x, h->aux))
+				return slot;
+		}
+		if (match_empty (g) != 0)
+			break;
+		idx = (idx + GROUP) & mask;
+	}
+	return SIZE_MAX;
+}
+
+/* Puts E, whose hash must already be set, into the first free
+   slot of its probe sequence in T.  T must not contain an element
+   equal to E. */
+static void
+table_place (struct ohash_table *t, struct ohash_elem *e) {
+	size_t mask = t->slot_cnt - 1;
+	size_t idx = (e->hash >> 7) & mask;
+	size_t probes;
+
+	for (probes = 0; probes <= t->slot_cnt / GROUP; probes++) {
+		uint64_t m = match_free (load_group (t, idx));
+
+		if (m != 0) {
+			size_t slot = match_slot (t, idx, m);
+
+			if (t->ctrl[slot] == CTRL_EMPTY)
+				t->used_cnt++;
+			set_ctrl (t, slot, hash_ctrl (e->hash));
+			t->slots[slot] = e;
+			return;
+		}
+		idx = (idx + GROUP) & mask;
+	}
+	PANIC ("ohash: table full");
+}
+
+/* Finds an element equal to E, whose hash must already be set, in
+   either table of H.  Returns the table and stores the slot in
+   *IDX if found, or returns a null pointer. */
+static struct ohash_table *
+locate (struct ohash *h, struct ohash_elem *e, size_t *idx) {
+	*idx = table_find (h, &h->cur, e);
+	if (*idx != SIZE_MAX)
+		return &h->cur;
+	*idx = table_find (h, &h->old, e);
+	if (*idx != SIZE_MAX)
+		return &h->old;
+	return NULL;
+}
+
+/* Makes room for one more element in the current table of H.  If
+   it is 7/8 used, a new table is allocated, twice as large unless
+   most of the used slots are tombstones, and becomes the current
+   one; the elements of the old one are moved by later calls to
+   migrate(). */
+static void
+grow (struct ohash *h) {
+	struct ohash_table t;
+	size_t slot_cnt = h->cur.slot_cnt;
+
+	if ((h->cur.used_cnt + 1) * 8 <= slot_cnt * 7)
+		return;
+
+	/* The previous move is normally long done by now. */
+	migrate (h, SIZE_MAX);
+
+	if (h->elem_cnt >= slot_cnt / 2)
+		slot_cnt *= 2;
+	if (!table_alloc (&t, slot_cnt)) {
+		/* Keep going in the current table while it has room. */
+		if (h->cur.used_cnt >= h->cur.slot_cnt)
+			PANIC ("ohash: out of memory");
+		return;
+	}
+
+	h->old = h->cur;
+	h->cur = t;
+	h->migrate_idx = 0;
+}
+
+/* Moves up to CNT slots' worth of elements from the old table of
+   H to the current one, freeing the old table once it is empty. */
+static void
+migrate (struct ohash *h, size_t cnt) {
+	struct ohash_table *old = &h->old;
+
+	while (cnt-- > 0 && old->slot_cnt != 0) {
+		size_t idx = h->migrate_idx++;
+
+		if (slot_full (old, idx)) {
+			table_place (&h->cur, old->slots[idx]);
+			set_ctrl (old, idx, CTRL_DELETED);
+		}
+		if (h->migrate_idx == old->slot_cnt)
+			table_free (old);
+	}
+}
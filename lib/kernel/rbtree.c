@@ -0,0 +1,396 @@
+#include "rbtree.h"
+#include "../debug.h"
+
+/* A red-black tree is a binary search tree whose elements are
+   colored so that no red element has a red child and every path
+   from the root down to a missing child passes the same number of
+   black elements.  That keeps the longest path at most twice the
+   shortest, so the height is O(lg n).  Insertion and removal
+   restore the colors with O(1) rotations and O(lg n) recoloring,
+   following Cormen et al., "Introduction to Algorithms", chapter
+   13, with null pointers for the leaves, which count as black. */
+
+static void rotate_left (struct rbtree *, struct rb_elem *);
+static void rotate_right (struct rbtree *, struct rb_elem *);
+static void insert_fixup (struct rbtree *, struct rb_elem *);
+static void remove_fixup (struct rbtree *, struct rb_elem *,
+		struct rb_elem *parent);
+
+/* Returns true if E is red; missing elements are black. */
+static inline bool
+is_red (const struct rb_elem *e) {
+	return e != NULL && e->red;
+}
+
+/* Initializes TREE as an empty tree ordered by LESS, given
+   auxiliary data AUX. */
+void
+rb_init (struct rbtree *tree, rb_less_func *less, void *aux) {
+	ASSERT (tree != NULL);
+	ASSERT (less != NULL);
+
+	tree->root = tree->min = NULL;
+	tree->size = 0;
+	tree->less = less;
+	tree->aux = aux;
+}
+
+/* Inserts ELEM into TREE, after any elements equal to it. */
+void
+rb_insert (struct rbtree *tree, struct rb_elem *elem) {
+	struct rb_elem *parent = NULL;
+	struct rb_elem **link = &tree->root;
+	bool leftmost = true;
+
+	ASSERT (tree != NULL);
+	ASSERT (elem != NULL);
+
+	while (*link != NULL) {
+		parent = *link;
+		if (tree->less (elem, parent, tree->aux))
+			link = &parent->left;
+		else {
+			link = &parent->right;
+			leftmost = false;
+		}
+	}
+
+	elem->parent = parent;
+	elem->left = elem->right = NULL;
+	elem->red = true;
+	*link = elem;
+	if (leftmost)
+		tree->min = elem;
+	tree->size++;
+	insert_fixup (tree, elem);
+}
+
+/* Replaces the subtree rooted at OLD, as a child of its parent, by
+   the one rooted at NEW, which may be null. */
+static void
+replace_child (struct rbtree *tree, struct rb_elem *old, struct rb_elem *new) {
+	struct rb_elem *parent = old->parent;
+
+	if (parent == NULL)
+		tree->root = new;
+	else if (parent->left == old)
+		parent->left = new;
+	else
+		parent->right = new;
+	if (new != NULL)
+		new->parent = parent;
+}
+
+/* Removes ELEM, which must be in TREE, from TREE. */
+void
+rb_remove (struct rbtree *tree, struct rb_elem *elem) {
+	struct rb_elem *child, *parent;
+	bool removed_red;
+
+	ASSERT (tree != NULL);
+	ASSERT (elem != NULL);
+	ASSERT (tree->size > 0);
+
+	if (tree->min == elem)
+		tree->min = rb_next (elem);
+
+	if (elem->left == NULL || elem->right == NULL) {
+		/* At most one child, which takes ELEM's place. */
+		child = elem->left != NULL ? elem->left : elem->right;
+		parent = elem->parent;
+		removed_red = elem->red;
+		replace_child (tree, elem, child);
+	} else {
+		/* Two children: ELEM's successor, which has no left child,
+		   takes ELEM's place and color, and the successor's right
+		   child takes the successor's place. */
+		struct rb_elem *next = elem->right;
+
+		while (next->left != NULL)
+			next = next->left;
+		child = next->right;
+		removed_red = next->red;
+		if (next->parent == elem)
+			parent = next;
+		else {
+			parent = next->parent;
+			replace_child (tree, next, child);
+			next->right = elem->right;
+			next->right->parent = next;
+		}
+		replace_child (tree, elem, next);
+		next->left = elem->left;
+		next->left->parent = next;
+		next->red = elem->red;
+	}
+
+	tree->size--;
+	if (!removed_red)
+		remove_fixup (tree, child, parent);
+	elem->parent = elem->left = elem->right = NULL;
+}
+
+/* Returns an element of TREE equal to KEY, or a null pointer if
+   there is none.  If there are several, returns the first. */
+struct rb_elem *
+rb_find (struct rbtree *tree, const struct rb_elem *key) {
+	struct rb_elem *e = rb_lower_bound (tree, key);
+
+	return e != NULL && !tree->less (key, e, tree->aux) ? e : NULL;
+}
+
+/* Returns the first element of TREE that is not less than KEY, or a
+   null pointer if there is none. */
+struct rb_elem *
+rb_lower_bound (struct rbtree *tree, const struct rb_elem *key) {
+	struct rb_elem *e = tree->root, *bound = NULL;
+
+	while (e != NULL)
+		if (tree->less (e, key, tree->aux))
+			e = e->right;
+		else {
+			bound = e;
+			e = e->left;
+		}
+	return bound;
+}
+
+/* Returns the first element of TREE that is greater than KEY, or a
+   null pointer if there is none. */
+struct rb_elem *
+rb_upper_bound (struct rbtree *tree, const struct rb_elem *key) {
+	struct rb_elem *e = tree->root, *bound = NULL;
+
+	while (e != NULL)
+		if (tree->less (key, e, tree->aux)) {
+			bound = e;
+			e = e->left;
+		} else
+			e = e->right;
+	return bound;
+}
+
+/* Returns the last element of TREE that is not greater than KEY, or
+   a null pointer if there is none.  For a tree of disjoint ranges
+   ordered by start, that is the only range that may contain KEY. */
+struct rb_elem *
+rb_floor (struct rbtree *tree, const struct rb_elem *key) {
+	struct rb_elem *e = tree->root, *bound = NULL;
+
+	while (e != NULL)
+		if (tree->less (key, e, tree->aux))
+			e = e->left;
+		else {
+			bound = e;
+			e = e->right;
+		}
+	return bound;
+}
+
+/* Returns the least element of TREE, or a null pointer if TREE is
+   empty. */
+struct rb_elem *
+rb_min (struct rbtree *tree) {
+	ASSERT (tree != NULL);
+	return tree->min;
+}
+
+/* Returns the greatest element of TREE, or a null pointer if TREE
+   is empty. */
+struct rb_elem *
+rb_max (struct rbtree *tree) {
+	struct rb_elem *e;
+
+	ASSERT (tree != NULL);
+
+	e = tree->root;
+	if (e != NULL)
+		while (e->right != NULL)
+			e = e->right;
+	return e;
+}
+
+/* Returns the element after E in its tree, or a null pointer if E
+   is the greatest. */
+struct rb_elem *
+rb_next (struct rb_elem *e) {
+	ASSERT (e != NULL);
+
+	if (e->right != NULL) {
+		e = e->right;
+		while (e->left != NULL)
+			e = e->left;
+		return e;
+	}
+	while (e->parent != NULL && e->parent->right == e)
+		e = e->parent;
+	return e->parent;
+}
+
+/* Returns the element before E in its tree, or a null pointer if E
+   is the least. */
+struct rb_elem *
+rb_prev (struct rb_elem *e) {
+	ASSERT (e != NULL);
+
+	if (e->left != NULL) {
+		e = e->left;
+		while (e->right != NULL)
+			e = e->right;
+		return e;
+	}
+	while (e->parent != NULL && e->parent->left == e)
+		e = e->parent;
+	return e->parent;
+}
+
+/* Returns the number of elements in TREE. */
+size_t
+rb_size (struct rbtree *tree) {
+	ASSERT (tree != NULL);
+	return tree->size;
+}
+
+/* Returns true if TREE is empty, false otherwise. */
+bool
+rb_empty (struct rbtree *tree) {
+	ASSERT (tree != NULL);
+	return tree->root == NULL;
+}
+
+/* Makes X's right child Y the root of X's subtree, with X as Y's
+   left child. */
+static void
+rotate_left (struct rbtree *tree, struct rb_elem *x) {
+	struct rb_elem *y = x->right;
+
+	x->right = y->left;
+	if (y->left != NULL)
+		y->left->parent = x;
+	replace_child (tree, x, y);
+	y->left = x;
+	x->parent = y;
+}
+
+/* Makes X's left child Y the root of X's subtree, with X as Y's
+   right child. */
+static void
+rotate_right (struct rbtree *tree, struct rb_elem *x) {
+	struct rb_elem *y = x->left;
+
+	x->left = y->right;
+	if (y->right != NULL)
+		y->right->parent = x;
+	replace_child (tree, x, y);
+	y->right = x;
+	x->parent = y;
+}
+
+/* Restores the colors after E, which is red, was inserted. */
+static void
+insert_fixup (struct rbtree *tree, struct rb_elem *e) {
+	while (is_red (e->parent)) {
+		struct rb_elem *parent = e->parent;
+		struct rb_elem *grand = parent->parent;
+
+		if (parent == grand->left) {
+			struct rb_elem *uncle = grand->right;
+
+			if (is_red (uncle)) {
+				parent->red = uncle->red = false;
+				grand->red = true;
+				e = grand;
+				continue;
+			}
+			if (e == parent->right) {
+				rotate_left (tree, parent);
+				e = parent;
+				parent = e->parent;
+			}
+			parent->red = false;
+			grand->red = true;
+			rotate_right (tree, grand);
+		} else {
+			struct rb_elem *uncle = grand->left;
+
+			if (is_red (uncle)) {
+				parent->red = uncle->red = false;
+				grand->red = true;
+				e = grand;
+				continue;
+			}
+			if (e == parent->left) {
+				rotate_right (tree, parent);
+				e = parent;
+				parent = e->parent;
+			}
+			parent->red = false;
+			grand->red = true;
+			rotate_left (tree, grand);
+		}
+	}
+	tree->root->red = false;
+}
+
+/* Restores the colors after a black element was removed from below
+   PARENT, leaving E, which may be null, in its place with one black
+   too few on its paths. */
+static void
+remove_fixup (struct rbtree *tree, struct rb_elem *e, struct rb_elem *parent) {
+	while (e != tree->root && !is_red (e)) {
+		if (e == parent->left) {
+			struct rb_elem *sibling = parent->right;
+
+			if (is_red (sibling)) {
+				sibling->red = false;
+				parent->red = true;
+				rotate_left (tree, parent);
+				sibling = parent->right;
+			}
+			if (!is_red (sibling->left) && !is_red (sibling->right)) {
+				sibling->red = true;
+				e = parent;
+				parent = e->parent;
+				continue;
+			}
+			if (!is_red (sibling->right)) {
+				sibling->left->red = false;
+				sibling->red = true;
+				rotate_right (tree, sibling);
+				sibling = parent->right;
+			}
+			sibling->red = parent->red;
+			parent->red = false;
+			sibling->right->red = false;
+			rotate_left (tree, parent);
+		} else {
+			struct rb_elem *sibling = parent->left;
+
+			if (is_red (sibling)) {
+				sibling->red = false;
+				parent->red = true;
+				rotate_right (tree, parent);
+				sibling = parent->left;
+			}
+			if (!is_red (sibling->left) && !is_red (sibling->right)) {
+				sibling->red = true;
+				e = parent;
+				parent = e->parent;
+				continue;
+			}
+			if (!is_red (sibling->left)) {
+				sibling->right->red = false;
+				sibling->red = true;
+				rotate_left (tree, sibling);
+				sibling = parent->left;
+			}
+			sibling->red = parent->red;
+			parent->red = false;
+			sibling->left->red = false;
+			rotate_right (tree, parent);
+		}
+		e = tree->root;
+	}
+	if (e != NULL)
+		e->red = false;
+}
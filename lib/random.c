@@ -1,6 +1,7 @@
 #include "random.h"
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 #include "debug.h"
 
 /* RC4-based pseudo-random number generator (PRNG).
@@ -20,6 +21,13 @@ static uint8_t s_i, s_j;        /* i, j. */
 /* Already initialized? */
 static bool inited;     
 
+/* xoshiro256** state, for random_fast_bytes().  See
+   https://prng.di.unimi.it/ for the generator. */
+static uint64_t x[4];
+static bool x_inited;
+
+static void fast_init (unsigned seed);
+
 /* Swaps the bytes pointed to by A and B. */
 static inline void
 swap_byte (uint8_t *a, uint8_t *b) {
@@ -44,6 +52,43 @@ random_init (unsigned seed) {
 
 	s_i = s_j = 0;
 	inited = true;
+	fast_init (seed);
+}
+
+/* Seeds the xoshiro256** state from SEED with splitmix64, which
+   cannot produce the all-zero state. */
+static void
+fast_init (unsigned seed) {
+	uint64_t z = seed;
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		uint64_t t = (z += 0x9e3779b97f4a7c15ULL);
+		t = (t ^ (t >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		t = (t ^ (t >> 27)) * 0x94d049bb133111ebULL;
+		x[i] = t ^ (t >> 31);
+	}
+	x_inited = true;
+}
+
+static inline uint64_t
+rotl (uint64_t v, int k) {
+	return (v << k) | (v >> (64 - k));
+}
+
+/* Returns the next 64 bits of xoshiro256** output. */
+static inline uint64_t
+fast_next (void) {
+	uint64_t result = rotl (x[1] * 5, 7) * 9;
+	uint64_t t = x[1] << 17;
+
+	x[2] ^= x[0];
+	x[3] ^= x[1];
+	x[1] ^= x[2];
+	x[0] ^= x[3];
+	x[2] ^= t;
+	x[3] = rotl (x[3], 45);
+	return result;
 }
 
 /* Writes SIZE random bytes into BUF. */
@@ -75,3 +120,36 @@ random_ulong (void) {
 	random_bytes (&ul, sizeof ul);
 	return ul;
 }
+
+/* Writes SIZE pseudo-random bytes into BUF, 8 at a time.  Much
+   faster than random_bytes(), for filling large buffers with data
+   nobody needs to reproduce outside of Pintos, but a different
+   stream: the tests' checkers replay random_bytes() as RC4.  Seeded
+   by random_init() as well. */
+void
+random_fast_bytes (void *buf_, size_t size) {
+	uint8_t *buf = buf_;
+
+	if (!x_inited)
+		fast_init (0);
+
+	for (; size > 0 && (uintptr_t) buf % sizeof (uint64_t) != 0; size--)
+		*buf++ = fast_next ();
+	for (; size >= sizeof (uint64_t); size -= sizeof (uint64_t)) {
+		*(uint64_t *) buf = fast_next ();
+		buf += sizeof (uint64_t);
+	}
+	if (size > 0) {
+		uint64_t v = fast_next ();
+		memcpy (buf, &v, size);
+	}
+}
+
+/* Returns a pseudo-random unsigned long from the same generator as
+   random_fast_bytes(). */
+unsigned long
+random_fast_ulong (void) {
+	if (!x_inited)
+		fast_init (0);
+	return fast_next ();
+}
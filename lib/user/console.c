@@ -24,11 +24,20 @@ hprintf (int handle, const char *format, ...) {
 }
 
 /* Writes string S to the console, followed by a new-line
-   character. */
+   character, with a single write if it is short. */
 int
 puts (const char *s) {
-	write (STDOUT_FILENO, s, strlen (s));
-	putchar ('\n');
+	size_t len = strlen (s);
+	char buf[256];
+
+	if (len < sizeof buf) {
+		memcpy (buf, s, len);
+		buf[len] = '\n';
+		write (STDOUT_FILENO, buf, len + 1);
+	} else {
+		write (STDOUT_FILENO, s, len);
+		putchar ('\n');
+	}
 
 	return 0;
 }
@@ -43,7 +52,7 @@ putchar (int c) {
 
 /* Auxiliary data for vhprintf_helper(). */
 struct vhprintf_aux {
-	char buf[64];       /* Character buffer. */
+	char buf[256];      /* Character buffer, enough for most lines. */
 	char *p;            /* Current position in buffer. */
 	int char_cnt;       /* Total characters written so far. */
 	int handle;         /* Output file handle. */
@@ -54,7 +63,7 @@ static void flush (struct vhprintf_aux *);
 
 /* Formats the printf() format specification FORMAT with
    arguments given in ARGS and writes the output to the given
-   HANDLE. */
+   HANDLE, with one write() for all but very long output. */
 int
 vhprintf (int handle, const char *format, va_list args) {
 	struct vhprintf_aux aux;
@@ -0,0 +1,427 @@
+#include <malloc.h>
+#include <debug.h>
+#include <mman.h>
+#include <round.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+
+/* A heap allocator for user programs.
+
+   The heap is the region above the data segment that sbrk()
+   grows, carved into runs of whole pages.  Each run starts with
+   a struct run and is one of three kinds:
+
+   - A slab: one page cut into blocks of a single size class, for
+     requests of up to MAX_SMALL bytes.  Each class keeps a list
+     of its slabs that have a block to spare, so malloc() and
+     free() of a small block touch only that list and one slab.
+     A fresh slab hands out its blocks front to back, so that its
+     page gets a frame only once a block is used.
+
+   - A large block: as many pages as a bigger request needs, with
+     the block right after the header.
+
+   - Free pages, kept in address order and merged with free
+     neighbours.  Once RELEASE_PAGES or more of a free run's
+     pages past its header may hold data, the kernel gets them
+     back through madvise(MADV_DONTNEED): they read as zeros and
+     hold no frame until reused.  A free run of at least
+     TRIM_PAGES at the top of the heap goes back with sbrk()
+     altogether.
+
+   The header of a block is found by masking its address down to
+   a page, which is why a large block starts in the first page of
+   its run.
+
+   Processes have one thread each, so there are no locks to take
+   and nothing to cache per thread. */
+
+#define PAGE_SIZE 4096
+
+/* Size class limit: larger requests get pages of their own. */
+#define MAX_SMALL 2016
+
+/* Pages to ask sbrk() for at least, at a time. */
+#define GROW_PAGES 16
+
+/* Pages of a free run worth giving back with madvise() at once. */
+#define RELEASE_PAGES 4
+
+/* Pages of free run at the top of the heap worth giving back with
+   sbrk().  Larger than GROW_PAGES, so that growing and trimming
+   do not take turns. */
+#define TRIM_PAGES 64
+
+/* Kinds of run. */
+#define RUN_SLAB 0x51ab51ab
+#define RUN_LARGE 0x1a26e000
+#define RUN_FREE 0xf4eef4ee
+
+/* Header at the start of every run. */
+struct run {
+	uint32_t magic;             /* RUN_SLAB, RUN_LARGE or RUN_FREE. */
+	uint16_t cls;               /* Slab: size class. */
+	uint16_t used;              /* Slab: blocks handed out. */
+	uint32_t bump;              /* Slab: offset of the first unused block. */
+	bool clean;                 /* Free: pages past the header released. */
+	size_t pages;               /* Length in pages. */
+	struct block *free;         /* Slab: blocks freed. */
+	struct run *prev, *next;    /* In its class's slab list or free_runs. */
+};
+
+/* Room the header takes, keeping blocks 16-byte aligned. */
+#define HDR_SIZE ROUND_UP (sizeof (struct run), 16)
+
+/* A free block in a slab. */
+struct block {
+	struct block *next;
+};
+
+/* Block sizes.  The larger ones are as big as an equal number of
+   them can be in a slab. */
+static const uint16_t class_size[] = {
+	16, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256,
+	320, 384, 448, 496, 576, 672, 800, 1008, 1344, MAX_SMALL,
+};
+#define CLASS_CNT (sizeof class_size / sizeof *class_size)
+
+/* Size class of each request size, in steps of 16 bytes. */
+static uint8_t class_of[MAX_SMALL / 16 + 1];
+
+static struct run *slabs[CLASS_CNT];    /* Slabs with a block to spare. */
+static struct run *free_runs;           /* Free runs, in address order. */
+static uint8_t *heap_end;               /* The break, page-aligned. */
+
+/* Removes R from the list *HEAD. */
+static void
+run_remove (struct run **head, struct run *r) {
+	if (r->prev != NULL)
+		r->prev->next = r->next;
+	else
+		*head = r->next;
+	if (r->next != NULL)
+		r->next->prev = r->prev;
+}
+
+/* Inserts R into the list *HEAD after PREV, or first if PREV is
+   null. */
+static void
+run_insert (struct run **head, struct run *prev, struct run *r) {
+	r->prev = prev;
+	r->next = prev != NULL ? prev->next : *head;
+	if (r->next != NULL)
+		r->next->prev = r;
+	if (prev != NULL)
+		prev->next = r;
+	else
+		*head = r;
+}
+
+/* Returns the byte just past run R. */
+static uint8_t *
+run_end (struct run *r) {
+	return (uint8_t *) r + r->pages * PAGE_SIZE;
+}
+
+/* Returns the header of the run that block P is in. */
+static struct run *
+run_of (void *p) {
+	return (struct run *) ((uintptr_t) p & ~(uintptr_t) (PAGE_SIZE - 1));
+}
+
+/* Aligns the break to a page and fills in class_of[].  Returns
+   false if there is no heap to be had. */
+static bool
+heap_init (void) {
+	uint8_t *brk = sbrk (0);
+	size_t pad, cls = 0;
+
+	if (brk == (void *) -1)
+		return false;
+	pad = ROUND_UP ((uintptr_t) brk, PAGE_SIZE) - (uintptr_t) brk;
+	if (pad > 0 && sbrk (pad) == (void *) -1)
+		return false;
+	heap_end = brk + pad;
+
+	for (size_t i = 0; i < sizeof class_of; i++) {
+		while (class_size[cls] < i * 16)
+			cls++;
+		class_of[i] = cls;
+	}
+	return true;
+}
+
+/* Adds the N pages at P to the free runs, merging them with their
+   neighbours.  FRESH pages come straight from sbrk() and read as
+   zeros; others are released or trimmed once there are enough. */
+static void
+pages_free (uint8_t *p, size_t n, bool fresh) {
+	struct run *prev = NULL, *next = free_runs, *r;
+	bool prev_clean = true, next_clean = true;
+	uint8_t *lo, *hi;
+
+	while (next != NULL && (uint8_t *) next < p) {
+		prev = next;
+		next = next->next;
+	}
+
+	/* Work out the pages that may hold data, LO to HI, as we
+	   merge.  A released run has only its header page left. */
+	if (prev != NULL && run_end (prev) == p) {
+		r = prev;
+		r->pages += n;
+		prev_clean = r->clean;
+		lo = prev_clean ? p : (uint8_t *) r + PAGE_SIZE;
+	} else {
+		r = (struct run *) p;
+		r->magic = RUN_FREE;
+		r->pages = n;
+		run_insert (&free_runs, prev, r);
+		lo = p + PAGE_SIZE;
+	}
+	hi = p + n * PAGE_SIZE;
+	if (next != NULL && run_end (r) == (uint8_t *) next) {
+		next_clean = next->clean;
+		hi = next_clean ? (uint8_t *) next + PAGE_SIZE : run_end (next);
+		r->pages += next->pages;
+		run_remove (&free_runs, next);
+	}
+
+	if (fresh) {
+		r->clean = prev_clean;
+		return;
+	}
+
+	if (run_end (r) == heap_end && r->pages >= TRIM_PAGES
+			&& sbrk (-(intptr_t) (r->pages * PAGE_SIZE)) != (void *) -1) {
+		run_remove (&free_runs, r);
+		heap_end = (uint8_t *) r;
+		return;
+	}
+
+	r->clean = lo >= hi;
+	if (!r->clean && (size_t) (hi - lo) >= RELEASE_PAGES * PAGE_SIZE) {
+		madvise (lo, hi - lo, MADV_DONTNEED);
+		r->clean = true;
+	}
+}
+
+/* Grows the heap by at least N pages.  Returns false if sbrk()
+   will not have it. */
+static bool
+heap_grow (size_t n) {
+	size_t grow = n > GROW_PAGES ? n : GROW_PAGES;
+	uint8_t *p;
+
+	if (n > (SIZE_MAX >> 1) / PAGE_SIZE)
+		return false;
+	p = sbrk (grow * PAGE_SIZE);
+	if (p == (void *) -1 && grow > n) {
+		grow = n;
+		p = sbrk (grow * PAGE_SIZE);
+	}
+	if (p == (void *) -1)
+		return false;
+
+	ASSERT (p == heap_end);
+	heap_end = p + grow * PAGE_SIZE;
+	pages_free (p, grow, true);
+	return true;
+}
+
+/* Takes N pages from the first free run big enough, growing the
+   heap if there is none.  Returns a null pointer if memory is
+   short. */
+static void *
+pages_alloc (size_t n) {
+	for (;;) {
+		struct run *r;
+
+		for (r = free_runs; r != NULL; r = r->next)
+			if (r->pages >= n) {
+				/* Take the end of the run, so that its header
+				   stays put. */
+				if (r->pages == n) {
+					run_remove (&free_runs, r);
+					return r;
+				}
+				r->pages -= n;
+				return run_end (r);
+			}
+		if (!heap_grow (n))
+			return NULL;
+	}
+}
+
+/* Returns true if slab S has no block to spare. */
+static bool
+slab_full (struct run *s) {
+	return s->free == NULL && s->bump + class_size[s->cls] > PAGE_SIZE;
+}
+
+/* Returns a block of size class CLS, or a null pointer if memory is
+   short. */
+static void *
+small_alloc (size_t cls) {
+	struct run *s = slabs[cls];
+	struct block *b;
+
+	if (s == NULL) {
+		s = pages_alloc (1);
+		if (s == NULL)
+			return NULL;
+		s->magic = RUN_SLAB;
+		s->cls = cls;
+		s->used = 0;
+		s->bump = HDR_SIZE;
+		s->pages = 1;
+		s->free = NULL;
+		run_insert (&slabs[cls], NULL, s);
+	}
+
+	if (s->free != NULL) {
+		b = s->free;
+		s->free = b->next;
+	} else {
+		b = (struct block *) ((uint8_t *) s + s->bump);
+		s->bump += class_size[cls];
+	}
+	s->used++;
+	if (slab_full (s))
+		run_remove (&slabs[cls], s);
+	return b;
+}
+
+/* Puts block P back into slab S.  An empty slab goes back to the
+   free pages unless it is the last one its class has to spare. */
+static void
+small_free (struct run *s, void *p) {
+	struct block *b = p;
+	bool was_full = slab_full (s);
+
+	b->next = s->free;
+	s->free = b;
+	s->used--;
+	if (was_full)
+		run_insert (&slabs[s->cls], NULL, s);
+	else if (s->used == 0 && (s->prev != NULL || s->next != NULL)) {
+		run_remove (&slabs[s->cls], s);
+		pages_free ((uint8_t *) s, 1, false);
+	}
+}
+
+/* Returns the size of block P. */
+static size_t
+block_size (void *p) {
+	struct run *r = run_of (p);
+
+	if (r->magic == RUN_SLAB)
+		return class_size[r->cls];
+	ASSERT (r->magic == RUN_LARGE);
+	return r->pages * PAGE_SIZE - HDR_SIZE;
+}
+
+/* Obtains and returns a new block of at least SIZE bytes.
+   Returns a null pointer if memory is not available. */
+void *
+malloc (size_t size) {
+	struct run *r;
+	size_t pages;
+
+	if (size == 0)
+		return NULL;
+	if (heap_end == NULL && !heap_init ())
+		return NULL;
+
+	if (size <= MAX_SMALL)
+		return small_alloc (class_of[DIV_ROUND_UP (size, 16)]);
+
+	if (size > SIZE_MAX - HDR_SIZE - PAGE_SIZE)
+		return NULL;
+	pages = DIV_ROUND_UP (size + HDR_SIZE, PAGE_SIZE);
+	r = pages_alloc (pages);
+	if (r == NULL)
+		return NULL;
+	r->magic = RUN_LARGE;
+	r->pages = pages;
+	return (uint8_t *) r + HDR_SIZE;
+}
+
+/* Allocates and return A times B bytes initialized to zeroes.
+   Returns a null pointer if memory is not available. */
+void *
+calloc (size_t a, size_t b) {
+	void *p;
+
+	if (b != 0 && a > SIZE_MAX / b)
+		return NULL;
+	p = malloc (a * b);
+	if (p != NULL)
+		memset (p, 0, a * b);
+	return p;
+}
+
+/* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly moving
+   it in the process.  If successful, returns the new block; on
+   failure, returns a null pointer.  A call with null OLD_BLOCK is
+   equivalent to malloc(NEW_SIZE).  A call with zero NEW_SIZE is
+   equivalent to free(OLD_BLOCK). */
+void *
+realloc (void *old_block, size_t new_size) {
+	size_t old_size;
+	void *new_block;
+
+	if (new_size == 0) {
+		free (old_block);
+		return NULL;
+	}
+	if (old_block == NULL)
+		return malloc (new_size);
+
+	/* A large block that shrinks gives back its tail pages. */
+	old_size = block_size (old_block);
+	if (new_size <= old_size) {
+		struct run *r = run_of (old_block);
+
+		if (r->magic == RUN_LARGE && new_size > MAX_SMALL) {
+			size_t pages = DIV_ROUND_UP (new_size + HDR_SIZE, PAGE_SIZE);
+
+			if (pages < r->pages) {
+				pages_free ((uint8_t *) r + pages * PAGE_SIZE, r->pages - pages,
+						false);
+				r->pages = pages;
+			}
+			return old_block;
+		}
+		if (r->magic == RUN_SLAB)
+			return old_block;
+	}
+
+	new_block = malloc (new_size);
+	if (new_block != NULL) {
+		memcpy (new_block, old_block,
+				old_size < new_size ? old_size : new_size);
+		free (old_block);
+	}
+	return new_block;
+}
+
+/* Frees block P, which must have been previously allocated with
+   malloc(), calloc(), or realloc(). */
+void
+free (void *p) {
+	struct run *r;
+
+	if (p == NULL)
+		return;
+	r = run_of (p);
+	if (r->magic == RUN_SLAB)
+		small_free (r, p);
+	else {
+		ASSERT (r->magic == RUN_LARGE);
+		r->magic = RUN_FREE;
+		pages_free ((uint8_t *) r, r->pages, false);
+	}
+}
@@ -25,7 +25,7 @@ static __inline int64_t syscall (uint64_t num_, uint64_t a1_, uint64_t a2_,
 			"syscall\n"
 			: "=a" (ret)
 			: "g" (num), "g" (a1), "g" (a2), "g" (a3), "g" (a4), "g" (a5), "g" (a6)
-			: "cc", "memory");
+			: "cc", "memory", "rcx", "r11");
 	return ret;
 }
 
@@ -54,7 +54,7 @@ static __inline int64_t syscall (uint64_t num_, uint64_t a1_, uint64_t a2_,
 			((uint64_t) ARG2), 0, 0, 0))
 
 #define syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3) ( \
-		syscall(((uint64_t *) NUMBER), \
+		syscall(((uint64_t) NUMBER), \
 			((uint64_t) ARG0), \
 			((uint64_t) ARG1), \
 			((uint64_t) ARG2), \
@@ -90,11 +90,90 @@ exec (const char *file) {
 	return (pid_t) syscall1 (SYS_EXEC, file);
 }
 
+pid_t
+spawn (const char *file, char *const argv[]) {
+	return (pid_t) syscall2 (SYS_SPAWN, file, argv);
+}
+
+/* The number of vfork, for the assembly below. */
+static const uint64_t vfork_nr __attribute__ ((used)) = SYS_VFORK;
+
+/* The child of vfork() runs on its parent's stack until it calls
+   exec() or exits, and overwrites what it finds there, so vfork()
+   cannot return through a stack frame of its own.  It keeps its
+   return address in RDX instead, which the kernel preserves. */
+asm (".text\n"
+	".globl vfork\n"
+	".type vfork, @function\n"
+	"vfork:\n"
+	"	popq %rdx\n"
+	"	movq vfork_nr(%rip), %rax\n"
+	"	syscall\n"
+	"	pushq %rdx\n"
+	"	ret\n");
+
+/* What thread_spawn() leaves at the top of a new thread's stack. */
+struct thread_start {
+	void (*func) (void *);
+	void *aux;
+};
+
+/* Where a thread made by thread_spawn() starts. */
+static void
+thread_start (struct thread_start *start) {
+	start->func (start->aux);
+	thread_exit ();
+}
+
+/* Starts a thread in this process that calls FUNC (AUX) on the
+   stack that ends just below STACK, with TLS as its FS base, and
+   ends when FUNC returns.  If TIDP is not null, the thread's id is
+   stored there before it runs and zero once it has ended, as
+   thread_join() waits for. */
+pid_t
+thread_spawn (void (*func) (void *), void *aux, void *stack, void *tls,
+		int *tidp) {
+	struct thread_start *start
+		= (struct thread_start *) ((uintptr_t) stack & ~(uintptr_t) 15) - 1;
+
+	start->func = func;
+	start->aux = aux;
+	/* As just after a call: a return address, never used, below. */
+	return (pid_t) syscall5 (SYS_THREAD_SPAWN, thread_start, start,
+			(void **) start - 1, tls, tidp);
+}
+
+void
+thread_exit (void) {
+	syscall0 (SYS_THREAD_EXIT);
+	NOT_REACHED ();
+}
+
+/* Waits for the thread whose id thread_spawn() stored in *TIDP to
+   end. */
+void
+thread_join (int *tidp) {
+	int tid;
+
+	while ((tid = *(volatile int *) tidp) != 0)
+		futex_wait (tidp, tid);
+}
+
+int
+pipe (int fds[2]) {
+	return syscall1 (SYS_PIPE, fds);
+}
+
 int
 wait (pid_t pid) {
 	return syscall1 (SYS_WAIT, pid);
 }
 
+pid_t
+waitany (int *status) {
+	return syscall1 (SYS_WAITANY, status);
+}
+
 bool
 create (const char *file, unsigned initial_size) {
 	return syscall2 (SYS_CREATE, file, initial_size);
@@ -145,6 +224,106 @@ dup2 (int oldfd, int newfd){
 	return syscall2 (SYS_DUP2, oldfd, newfd);
 }
 
+bool
+set_affinity (pid_t pid, uint64_t mask) {
+	return syscall2 (SYS_SET_AFFINITY, pid, mask);
+}
+
+uint64_t
+get_affinity (pid_t pid) {
+	return syscall1 (SYS_GET_AFFINITY, pid);
+}
+
+bool
+set_deadline (unsigned runtime, unsigned deadline, unsigned period) {
+	return syscall3 (SYS_SET_DEADLINE, runtime, deadline, period);
+}
+
+int
+sysctl (const char *name, size_t *oldval, const size_t *newval) {
+	return syscall3 (SYS_SYSCTL, name, oldval, newval);
+}
+
+int
+futex_wait (int *addr, int val) {
+	return syscall2 (SYS_FUTEX_WAIT, addr, val);
+}
+
+int
+futex_wake (int *addr, int n) {
+	return syscall2 (SYS_FUTEX_WAKE, addr, n);
+}
+
+void
+memstat (struct memstat *ms) {
+	syscall1 (SYS_MEMSTAT, ms);
+}
+
+bool
+diskstat (int disk, struct diskstat *ds) {
+	return syscall2 (SYS_DISKSTAT, disk, ds);
+}
+
+bool
+perf_read (struct perf_counts *pc) {
+	return syscall1 (SYS_PERF_READ, pc);
+}
+
+int
+getrusage (int who, struct rusage *ru) {
+	return syscall2 (SYS_GETRUSAGE, who, ru);
+}
+
+int
+readv (int fd, const struct iovec *iov, int iovcnt) {
+	return syscall3 (SYS_READV, fd, iov, iovcnt);
+}
+
+int
+writev (int fd, const struct iovec *iov, int iovcnt) {
+	return syscall3 (SYS_WRITEV, fd, iov, iovcnt);
+}
+
+int
+pread (int fd, void *buffer, unsigned length, off_t offset) {
+	return syscall4 (SYS_PREAD, fd, buffer, length, offset);
+}
+
+int
+pwrite (int fd, const void *buffer, unsigned length, off_t offset) {
+	return syscall4 (SYS_PWRITE, fd, buffer, length, offset);
+}
+
+int
+sendfile (int out_fd, int in_fd, off_t offset, unsigned length) {
+	return syscall4 (SYS_SENDFILE, out_fd, in_fd, offset, length);
+}
+
+int
+fallocate (int fd, off_t offset, off_t length) {
+	return syscall3 (SYS_FALLOCATE, fd, offset, length);
+}
+
+int
+fsync (int fd) {
+	return syscall1 (SYS_FSYNC, fd);
+}
+
+int
+fdatasync (int fd) {
+	return syscall1 (SYS_FDATASYNC, fd);
+}
+
+int
+getdents (int fd, void *buffer, unsigned size) {
+	return syscall3 (SYS_GETDENTS, fd, buffer, size);
+}
+
+int
+ring_enter (struct ring *ring) {
+	return syscall1 (SYS_RING_ENTER, ring);
+}
+
 void *
 mmap (void *addr, size_t length, int writable, int fd, off_t offset) {
 	return (void *) syscall5 (SYS_MMAP, addr, length, writable, fd, offset);
@@ -155,6 +334,41 @@ munmap (void *addr) {
 	syscall1 (SYS_MUNMAP, addr);
 }
 
+int
+madvise (void *addr, size_t length, int advice) {
+	return syscall3 (SYS_MADVISE, addr, length, advice);
+}
+
+int
+mlock (void *addr, size_t length) {
+	return syscall2 (SYS_MLOCK, addr, length);
+}
+
+int
+munlock (void *addr, size_t length) {
+	return syscall2 (SYS_MUNLOCK, addr, length);
+}
+
+void
+vmstat (struct vmstat *thread, struct vmstat *system) {
+	syscall2 (SYS_VMSTAT, thread, system);
+}
+
+void *
+shm_map (const char *name, void *addr, size_t length, int writable) {
+	return (void *) syscall4 (SYS_SHM_MAP, name, addr, length, writable);
+}
+
+bool
+shm_unlink (const char *name) {
+	return syscall1 (SYS_SHM_UNLINK, name);
+}
+
+void *
+sbrk (intptr_t increment) {
+	return (void *) syscall1 (SYS_SBRK, increment);
+}
+
 bool
 chdir (const char *dir) {
 	return syscall1 (SYS_CHDIR, dir);
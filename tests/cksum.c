@@ -1,5 +1,6 @@
 /* crctab[] and cksum() are from the `cksum' entry in SUSv3. */
 
+#include <stdbool.h>
 #include <stdint.h>
 #include "tests/cksum.h"
 
@@ -58,6 +59,25 @@ static unsigned long crctab[] = {
   0xa2f33668, 0xbcb4666d, 0xb8757bda, 0xb5365d03, 0xb1f740b4
 };
 
+/* crctab[] extended to slice-by-8: slice[K][B] is the CRC of byte
+   B followed by K zero bytes, so that eight bytes are folded in with
+   eight independent lookups.  Computed on first use. */
+static uint32_t slice[8][256];
+static bool slice_ready;
+
+static void
+make_slice (void)
+{
+  int b, k;
+
+  for (b = 0; b < 256; b++)
+    slice[0][b] = crctab[b];
+  for (k = 1; k < 8; k++)
+    for (b = 0; b < 256; b++)
+      slice[k][b] = (slice[k - 1][b] << 8) ^ crctab[slice[k - 1][b] >> 24];
+  slice_ready = true;
+}
+
 /* This is the algorithm used by the Posix `cksum' utility. */
 unsigned long
 cksum (const void *b_, size_t n)
@@ -65,7 +85,19 @@ cksum (const void *b_, size_t n)
   const unsigned char *b = b_;
   uint32_t s = 0;
   size_t i;
-  for (i = n; i > 0; --i)
+
+  if (!slice_ready)
+    make_slice ();
+  for (i = n; i >= 8; i -= 8)
+    {
+      uint32_t x = s ^ ((uint32_t) b[0] << 24 | (uint32_t) b[1] << 16
+                        | (uint32_t) b[2] << 8 | b[3]);
+      s = slice[7][x >> 24] ^ slice[6][(x >> 16) & 0xff]
+          ^ slice[5][(x >> 8) & 0xff] ^ slice[4][x & 0xff]
+          ^ slice[3][b[4]] ^ slice[2][b[5]] ^ slice[1][b[6]] ^ slice[0][b[7]];
+      b += 8;
+    }
+  for (; i > 0; --i)
     {
       unsigned char c = *b++;
       s = (s << 8) ^ crctab[(s >> 24) ^ c];
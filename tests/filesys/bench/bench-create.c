@@ -0,0 +1,57 @@
+/* Measures creating, opening and removing many small files in one
+   directory. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/filesys/bench/bench.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 256
+
+static void
+file_name (char name[16], int i)
+{
+  snprintf (name, 16, "f%d", i);
+}
+
+void
+test_main (void)
+{
+  struct bench b;
+  char name[16];
+  int i;
+
+  msg ("create %d files", FILE_CNT);
+  bench_start (&b, "create");
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      file_name (name, i);
+      if (!create (name, 512))
+        fail ("create \"%s\" failed", name);
+    }
+  bench_stop (&b, FILE_CNT);
+
+  msg ("open %d files", FILE_CNT);
+  bench_start (&b, "open+close");
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      int fd;
+
+      file_name (name, i);
+      if ((fd = open (name)) < 2)
+        fail ("open \"%s\" failed", name);
+      close (fd);
+    }
+  bench_stop (&b, FILE_CNT);
+
+  msg ("remove %d files", FILE_CNT);
+  bench_start (&b, "remove");
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      file_name (name, i);
+      if (!remove (name))
+        fail ("remove \"%s\" failed", name);
+    }
+  bench_stop (&b, FILE_CNT);
+}
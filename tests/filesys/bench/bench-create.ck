@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = grep (!/ cycles, /, read_text_file ("$test.output"));
+common_checks ("run", @output);
+compare_output ("run", IGNORE_EXIT_CODES => 1, \@output, [<<'EOF']);
+(bench-create) begin
+(bench-create) create 256 files
+(bench-create) open 256 files
+(bench-create) remove 256 files
+(bench-create) end
+EOF
+pass;
@@ -0,0 +1,46 @@
+/* Measures listing a directory of many files with getdents(). */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/filesys/bench/bench.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 512
+
+static struct dirent ents[4096 / sizeof (struct dirent)];
+
+void
+test_main (void)
+{
+  struct bench b;
+  char name[16];
+  int fd, n, calls, found;
+
+  msg ("create %d files", FILE_CNT);
+  for (n = 0; n < FILE_CNT; n++)
+    {
+      snprintf (name, sizeof name, "f%d", n);
+      if (!create (name, 0))
+        fail ("create \"%s\" failed", name);
+    }
+
+  CHECK ((fd = open ("/")) > 1, "open \"/\"");
+  bench_start (&b, "getdents 4 kB");
+  calls = found = 0;
+  while ((n = getdents (fd, ents, sizeof ents)) > 0)
+    {
+      calls++;
+      found += n / sizeof *ents;
+    }
+  bench_stop (&b, calls);
+  if (n < 0)
+    fail ("getdents failed");
+  msg ("close \"/\"");
+  close (fd);
+
+  /* The directory holds the test program too. */
+  if (found < FILE_CNT)
+    fail ("listed %d entries, expected at least %d", found, FILE_CNT);
+  msg ("listed all files");
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = grep (!/ cycles, /, read_text_file ("$test.output"));
+common_checks ("run", @output);
+compare_output ("run", IGNORE_EXIT_CODES => 1, \@output, [<<'EOF']);
+(bench-list) begin
+(bench-list) create 512 files
+(bench-list) open "/"
+(bench-list) close "/"
+(bench-list) listed all files
+(bench-list) end
+EOF
+pass;
@@ -0,0 +1,69 @@
+/* Measures random reads and writes of 512 B and 4 kB blocks at
+   block-aligned offsets in a file that is all on disk. */
+
+#include <random.h>
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/filesys/bench/bench.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE (1024 * 1024)
+#define OPS 512
+
+static char buf[64 * 1024];
+
+/* Carries out OPS random reads, or writes if WRITE is true, of
+   BLOCK_SIZE bytes each in FD. */
+static void
+random_io (int fd, size_t block_size, bool write)
+{
+  char what[32];
+  struct bench b;
+  int i;
+
+  snprintf (what, sizeof what, "random %s %zu B",
+            write ? "write" : "read", block_size);
+  bench_start (&b, what);
+  for (i = 0; i < OPS; i++)
+    {
+      off_t ofs = (random_fast_ulong () % (FILE_SIZE / block_size)
+                   * block_size);
+      int n = write ? pwrite (fd, buf, block_size, ofs)
+                    : pread (fd, buf, block_size, ofs);
+
+      if (n != (int) block_size)
+        fail ("%s of %zu bytes at offset %d failed",
+              write ? "write" : "read", block_size, (int) ofs);
+    }
+  if (write && fsync (fd) != 0)
+    fail ("fsync failed");
+  bench_stop (&b, OPS);
+}
+
+void
+test_main (void)
+{
+  const char *file_name = "random";
+  size_t ofs;
+  int fd;
+
+  random_init (84);
+  random_fast_bytes (buf, sizeof buf);
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+
+  msg ("fill \"%s\"", file_name);
+  for (ofs = 0; ofs < FILE_SIZE; ofs += sizeof buf)
+    if (write (fd, buf, sizeof buf) != (int) sizeof buf)
+      fail ("write %zu bytes at offset %zu failed", sizeof buf, ofs);
+  CHECK (fsync (fd) == 0, "fsync \"%s\"", file_name);
+
+  random_io (fd, 512, false);
+  random_io (fd, 4096, false);
+  random_io (fd, 512, true);
+  random_io (fd, 4096, true);
+
+  msg ("close \"%s\"", file_name);
+  close (fd);
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = grep (!/ cycles, /, read_text_file ("$test.output"));
+common_checks ("run", @output);
+compare_output ("run", IGNORE_EXIT_CODES => 1, \@output, [<<'EOF']);
+(bench-random) begin
+(bench-random) create "random"
+(bench-random) open "random"
+(bench-random) fill "random"
+(bench-random) fsync "random"
+(bench-random) close "random"
+(bench-random) end
+EOF
+pass;
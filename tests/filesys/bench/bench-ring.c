@@ -0,0 +1,97 @@
+/* Measures many small appends, as a logger makes them, with one
+   write() each and then queued in a ring and made RING_ENTRIES at a
+   time with ring_enter(). */
+
+#include <ring.h>
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include <syscall-nr.h>
+#include "tests/filesys/bench/bench.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define LINE_CNT 1024
+#define LINE_SIZE 64
+
+static char line[LINE_SIZE];
+static char buf[LINE_SIZE];
+static struct ring ring;
+
+/* Appends LINE_CNT lines to FILE_NAME through the ring. */
+static void
+log_ring (const char *file_name)
+{
+  struct ring_cqe cqe;
+  int fd, queued, done;
+
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  for (queued = done = 0; done < LINE_CNT; )
+    {
+      while (queued < LINE_CNT
+             && ring_submit (&ring, SYS_WRITE, fd, (uintptr_t) line,
+                             LINE_SIZE, 0, queued))
+        queued++;
+      if (ring_enter (&ring) < 0)
+        fail ("ring_enter failed");
+      while (ring_reap (&ring, &cqe))
+        {
+          if (cqe.result != LINE_SIZE)
+            fail ("write %d returned %lld", (int) cqe.user_data,
+                  (long long) cqe.result);
+          done++;
+        }
+    }
+  close (fd);
+}
+
+/* Appends LINE_CNT lines to FILE_NAME with a write() each. */
+static void
+log_write (const char *file_name)
+{
+  int fd, i;
+
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  for (i = 0; i < LINE_CNT; i++)
+    if (write (fd, line, LINE_SIZE) != LINE_SIZE)
+      fail ("write %d failed", i);
+  close (fd);
+}
+
+/* Checks that FILE_NAME holds LINE_CNT copies of the line. */
+static void
+check_log (const char *file_name)
+{
+  int fd, i;
+
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  if (filesize (fd) != LINE_CNT * LINE_SIZE)
+    fail ("\"%s\" is %d bytes, expected %d", file_name, filesize (fd),
+          LINE_CNT * LINE_SIZE);
+  for (i = 0; i < LINE_CNT; i++)
+    if (read (fd, buf, LINE_SIZE) != LINE_SIZE
+        || memcmp (buf, line, LINE_SIZE))
+      fail ("line %d of \"%s\" differs", i, file_name);
+  close (fd);
+}
+
+void
+test_main (void)
+{
+  struct bench b;
+
+  memset (line, 'x', LINE_SIZE - 1);
+  line[LINE_SIZE - 1] = '\n';
+
+  CHECK (create ("log-write", 0), "create \"log-write\"");
+  bench_start (&b, "write 64 B");
+  log_write ("log-write");
+  bench_stop (&b, LINE_CNT);
+  check_log ("log-write");
+
+  CHECK (create ("log-ring", 0), "create \"log-ring\"");
+  bench_start (&b, "ring write 64 B");
+  log_ring ("log-ring");
+  bench_stop (&b, LINE_CNT);
+  check_log ("log-ring");
+}
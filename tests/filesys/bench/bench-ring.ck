@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = grep (!/ cycles, /, read_text_file ("$test.output"));
+common_checks ("run", @output);
+compare_output ("run", IGNORE_EXIT_CODES => 1, \@output, [<<'EOF']);
+(bench-ring) begin
+(bench-ring) create "log-write"
+(bench-ring) open "log-write"
+(bench-ring) open "log-write"
+(bench-ring) create "log-ring"
+(bench-ring) open "log-ring"
+(bench-ring) open "log-ring"
+(bench-ring) end
+EOF
+pass;
@@ -0,0 +1,60 @@
+/* Measures sequential writes and reads of a large file at several
+   block sizes.  Each block size writes the file with seq_test(),
+   which reads it back to verify it, then reads it once more on its
+   own. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/filesys/bench/bench.h"
+#include "tests/filesys/seq-test.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE (512 * 1024)
+
+static char buf[FILE_SIZE];
+static char block[64 * 1024];
+static size_t block_size;
+
+static size_t
+return_block_size (void)
+{
+  return block_size;
+}
+
+void
+test_main (void)
+{
+  static const size_t block_sizes[] = {512, 4096, 16384, 65536};
+  size_t i;
+
+  for (i = 0; i < sizeof block_sizes / sizeof *block_sizes; i++)
+    {
+      char name[16], what[32];
+      struct bench b;
+      size_t ofs;
+      int fd;
+
+      block_size = block_sizes[i];
+      snprintf (name, sizeof name, "seq-%zu", block_size);
+
+      snprintf (what, sizeof what, "write+verify %zu B", block_size);
+      bench_start (&b, what);
+      seq_test (name, buf, sizeof buf, 0, return_block_size, NULL);
+      bench_stop (&b, sizeof buf / block_size);
+
+      snprintf (what, sizeof what, "read %zu B", block_size);
+      fd = open (name);
+      if (fd < 2)
+        fail ("open \"%s\" failed", name);
+      bench_start (&b, what);
+      for (ofs = 0; ofs < sizeof buf; ofs += block_size)
+        if (read (fd, block, block_size) != (int) block_size)
+          fail ("read %zu bytes at offset %zu in \"%s\" failed",
+                block_size, ofs, name);
+      bench_stop (&b, sizeof buf / block_size);
+      close (fd);
+
+      CHECK (remove (name), "remove \"%s\"", name);
+    }
+}
@@ -0,0 +1,44 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = grep (!/ cycles, /, read_text_file ("$test.output"));
+common_checks ("run", @output);
+compare_output ("run", IGNORE_EXIT_CODES => 1, \@output, [<<'EOF']);
+(bench-seq) begin
+(bench-seq) create "seq-512"
+(bench-seq) open "seq-512"
+(bench-seq) writing "seq-512"
+(bench-seq) close "seq-512"
+(bench-seq) open "seq-512" for verification
+(bench-seq) verified contents of "seq-512"
+(bench-seq) close "seq-512"
+(bench-seq) remove "seq-512"
+(bench-seq) create "seq-4096"
+(bench-seq) open "seq-4096"
+(bench-seq) writing "seq-4096"
+(bench-seq) close "seq-4096"
+(bench-seq) open "seq-4096" for verification
+(bench-seq) verified contents of "seq-4096"
+(bench-seq) close "seq-4096"
+(bench-seq) remove "seq-4096"
+(bench-seq) create "seq-16384"
+(bench-seq) open "seq-16384"
+(bench-seq) writing "seq-16384"
+(bench-seq) close "seq-16384"
+(bench-seq) open "seq-16384" for verification
+(bench-seq) verified contents of "seq-16384"
+(bench-seq) close "seq-16384"
+(bench-seq) remove "seq-16384"
+(bench-seq) create "seq-65536"
+(bench-seq) open "seq-65536"
+(bench-seq) writing "seq-65536"
+(bench-seq) close "seq-65536"
+(bench-seq) open "seq-65536" for verification
+(bench-seq) verified contents of "seq-65536"
+(bench-seq) close "seq-65536"
+(bench-seq) remove "seq-65536"
+(bench-seq) end
+EOF
+pass;
@@ -0,0 +1,54 @@
+#include "tests/filesys/bench/bench.h"
+#include <syscall.h>
+#include "tests/lib.h"
+
+/* The file system disk, hd0:1, as diskstat() numbers disks. */
+#define BENCH_DISK 1
+
+/* Returns the time stamp counter. */
+static uint64_t
+read_tsc (void)
+{
+  uint32_t lo, hi;
+
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t) hi << 32) | lo;
+}
+
+/* Reads the file system disk's statistics into *DS. */
+static void
+read_disk (struct diskstat *ds)
+{
+  if (!diskstat (BENCH_DISK, ds))
+    fail ("diskstat failed");
+}
+
+/* Starts measuring B, which is called NAME in the report. */
+void
+bench_start (struct bench *b, const char *name)
+{
+  b->name = name;
+  read_disk (&b->disk);
+  b->cycles = read_tsc ();
+}
+
+/* Stops measuring B, which carried out OPS operations, and reports
+   the cycles and disk requests it took.  Report lines all contain
+   " cycles, ", by which the .ck files leave them out. */
+void
+bench_stop (struct bench *b, unsigned long ops)
+{
+  uint64_t cycles = read_tsc () - b->cycles;
+  struct diskstat disk;
+
+  read_disk (&disk);
+  msg ("%s: %lu ops, %llu cycles, %llu cycles/op, "
+       "%llu disk reads (%llu kB), %llu disk writes (%llu kB)",
+       b->name, ops, (unsigned long long) cycles,
+       (unsigned long long) (ops > 0 ? cycles / ops : 0),
+       (unsigned long long) (disk.reads - b->disk.reads),
+       (unsigned long long) ((disk.bytes_read - b->disk.bytes_read) / 1024),
+       (unsigned long long) (disk.writes - b->disk.writes),
+       (unsigned long long) ((disk.bytes_written - b->disk.bytes_written)
+                             / 1024));
+}
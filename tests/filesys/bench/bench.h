@@ -0,0 +1,18 @@
+#ifndef TESTS_FILESYS_BENCH_BENCH_H
+#define TESTS_FILESYS_BENCH_BENCH_H
+
+#include <diskstat.h>
+#include <stdint.h>
+
+/* One measured run. */
+struct bench
+  {
+    const char *name;           /* What is measured. */
+    uint64_t cycles;            /* TSC at bench_start(). */
+    struct diskstat disk;       /* File system disk at bench_start(). */
+  };
+
+void bench_start (struct bench *, const char *name);
+void bench_stop (struct bench *, unsigned long ops);
+
+#endif /* tests/filesys/bench/bench.h */
@@ -0,0 +1,6 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_archive ({'dir' => {map (("f$_" => ['']), 0...19)}});
+pass;
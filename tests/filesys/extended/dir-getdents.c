@@ -0,0 +1,62 @@
+/* Creates a directory with FILE_CNT files and lists it with
+   getdents() into a buffer with room for only a few entries, so
+   that the listing takes several calls.  Checks that each call but
+   the last fills the buffer, that every file comes back exactly
+   once, and that the calls after the end return 0. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 20
+#define BATCH 3
+
+void
+test_main (void)
+{
+  struct dirent ents[BATCH];
+  bool seen[FILE_CNT];
+  int fd, file, n, i, calls = 0, total = 0;
+  char name[16];
+
+  CHECK (mkdir ("dir"), "mkdir \"dir\"");
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (name, sizeof name, "dir/f%d", i);
+      if (!create (name, 0))
+        fail ("create \"%s\"", name);
+    }
+  msg ("created %d files", FILE_CNT);
+
+  CHECK ((fd = open ("dir")) > 1, "open \"dir\"");
+  memset (seen, 0, sizeof seen);
+  while ((n = getdents (fd, ents, sizeof ents)) > 0)
+    {
+      calls++;
+      if (n % sizeof *ents != 0 || n > (int) sizeof ents)
+        fail ("getdents returned %d bytes", n);
+      n /= sizeof *ents;
+      if (n < BATCH && total + n != FILE_CNT)
+        fail ("call %d returned %d entries before the end", calls, n);
+      for (i = 0; i < n; i++)
+        {
+          if (ents[i].d_name[0] != 'f'
+              || (file = atoi (ents[i].d_name + 1)) < 0 || file >= FILE_CNT)
+            fail ("unexpected entry \"%s\"", ents[i].d_name);
+          if (seen[file])
+            fail ("\"%s\" listed twice", ents[i].d_name);
+          seen[file] = true;
+        }
+      total += n;
+    }
+  CHECK (n == 0, "getdents at the end returns 0");
+  CHECK (total == FILE_CNT, "listed %d entries in %d calls", total, calls);
+  CHECK (getdents (fd, ents, sizeof ents) == 0, "getdents still returns 0");
+  close (fd);
+
+  CHECK ((fd = open ("dir/f0")) > 1, "open \"dir/f0\"");
+  CHECK (getdents (fd, ents, sizeof ents) == -1, "getdents on a file fails");
+}
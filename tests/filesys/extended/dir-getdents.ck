@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(dir-getdents) begin
+(dir-getdents) mkdir "dir"
+(dir-getdents) created 20 files
+(dir-getdents) open "dir"
+(dir-getdents) getdents at the end returns 0
+(dir-getdents) listed 20 entries in 7 calls
+(dir-getdents) getdents still returns 0
+(dir-getdents) open "dir/f0"
+(dir-getdents) getdents on a file fails
+(dir-getdents) end
+EOF
+pass;
@@ -0,0 +1,139 @@
+/* Test program for lib/kernel/heap.c.
+
+   Attempts to test the heap functionality that is not
+   sufficiently tested elsewhere in Pintos.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <heap.h>
+#include <random.h>
+#include <stdio.h>
+#include "threads/test.h"
+
+/* Maximum number of elements in a heap that we will test. */
+#define MAX_SIZE 64
+
+/* A heap element. */
+struct value
+  {
+    struct heap_elem elem;      /* Heap element. */
+    int value;                  /* Item value. */
+  };
+
+static void shuffle (struct value[], size_t);
+static bool value_less (const struct heap_elem *, const struct heap_elem *,
+                        void *);
+static void verify_heap (struct heap *, int first, int size);
+
+/* Test the heap implementation. */
+void
+test (void)
+{
+  int size;
+
+  printf ("testing various size heaps:");
+  for (size = 0; size < MAX_SIZE; size++)
+    {
+      int repeat;
+
+      printf (" %d", size);
+      for (repeat = 0; repeat < 10; repeat++)
+        {
+          static struct value values[MAX_SIZE];
+          struct heap heap;
+          int i;
+
+          /* Put values 0...SIZE in random order in VALUES. */
+          for (i = 0; i < size; i++)
+            values[i].value = i;
+          shuffle (values, size);
+
+          /* Push and pop everything in order. */
+          heap_init (&heap, value_less, NULL);
+          for (i = 0; i < size; i++)
+            heap_push (&heap, &values[i].elem);
+          ASSERT (heap_size (&heap) == (size_t) size);
+          verify_heap (&heap, 0, size);
+
+          /* Remove the odd values from the middle of the heap,
+             then verify that the even ones still pop in order. */
+          heap_init (&heap, value_less, NULL);
+          for (i = 0; i < size; i++)
+            heap_push (&heap, &values[i].elem);
+          for (i = 0; i < size; i++)
+            if (values[i].value % 2)
+              heap_remove (&heap, &values[i].elem);
+          for (i = 0; i < size; i += 2)
+            {
+              struct heap_elem *e = heap_pop (&heap);
+              ASSERT (heap_entry (e, struct value, elem)->value == i);
+            }
+          ASSERT (heap_empty (&heap));
+
+          /* Re-key every element by shifting it down by SIZE, one
+             at a time in random order, and verify the order once
+             more. */
+          heap_init (&heap, value_less, NULL);
+          for (i = 0; i < size; i++)
+            heap_push (&heap, &values[i].elem);
+          for (i = 0; i < size; i++)
+            {
+              values[i].value -= size;
+              heap_update (&heap, &values[i].elem);
+            }
+          verify_heap (&heap, -size, size);
+        }
+    }
+
+  printf (" done\n");
+  printf ("heap: PASS\n");
+}
+
+/* Shuffles the values of the CNT elements in ARRAY into random
+   order.  Only call this on elements that are not in a heap. */
+static void
+shuffle (struct value *array, size_t cnt)
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    {
+      size_t j = i + random_ulong () % (cnt - i);
+      int t = array[j].value;
+      array[j].value = array[i].value;
+      array[i].value = t;
+    }
+}
+
+/* Returns true if value A is less than value B, false
+   otherwise. */
+static bool
+value_less (const struct heap_elem *a_, const struct heap_elem *b_,
+            void *aux UNUSED)
+{
+  const struct value *a = heap_entry (a_, struct value, elem);
+  const struct value *b = heap_entry (b_, struct value, elem);
+
+  return a->value < b->value;
+}
+
+/* Verifies that popping HEAP yields the values FIRST...FIRST+SIZE
+   in ascending order and leaves it empty. */
+static void
+verify_heap (struct heap *heap, int first, int size)
+{
+  int i;
+
+  for (i = 0; i < size; i++)
+    {
+      struct heap_elem *e = heap_top (heap);
+      ASSERT (e == heap_pop (heap));
+      ASSERT (heap_entry (e, struct value, elem)->value == first + i);
+    }
+  ASSERT (heap_empty (heap));
+  ASSERT (heap_top (heap) == NULL);
+}
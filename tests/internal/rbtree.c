@@ -0,0 +1,171 @@
+/* Test program for lib/kernel/rbtree.c.
+
+   Attempts to test the tree functionality that is not
+   sufficiently tested elsewhere in Pintos.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <rbtree.h>
+#include <random.h>
+#include <stdio.h>
+#include "threads/test.h"
+
+/* Maximum number of elements in a tree that we will test. */
+#define MAX_SIZE 64
+
+/* A tree element. */
+struct value
+  {
+    struct rb_elem elem;        /* Tree element. */
+    int value;                  /* Item value. */
+  };
+
+static void shuffle (struct value[], size_t);
+static bool value_less (const struct rb_elem *, const struct rb_elem *,
+                        void *);
+static int verify_colors (const struct rb_elem *);
+static void verify_tree (struct rbtree *, int first, int step, int size);
+
+/* Test the tree implementation. */
+void
+test (void)
+{
+  int size;
+
+  printf ("testing various size trees:");
+  for (size = 0; size < MAX_SIZE; size++)
+    {
+      int repeat;
+
+      printf (" %d", size);
+      for (repeat = 0; repeat < 10; repeat++)
+        {
+          static struct value values[MAX_SIZE];
+          struct value key;
+          struct rbtree tree;
+          int i;
+
+          /* Put values 0...SIZE in random order in VALUES and
+             insert them. */
+          for (i = 0; i < size; i++)
+            values[i].value = i;
+          shuffle (values, size);
+          rb_init (&tree, value_less, NULL);
+          for (i = 0; i < size; i++)
+            rb_insert (&tree, &values[i].elem);
+          verify_tree (&tree, 0, 1, size);
+
+          /* Look up every value, and the gaps between them. */
+          for (i = 0; i < size; i++)
+            {
+              struct rb_elem *e;
+
+              key.value = i;
+              e = rb_find (&tree, &key.elem);
+              ASSERT (e != NULL);
+              ASSERT (rb_entry (e, struct value, elem)->value == i);
+              ASSERT (rb_lower_bound (&tree, &key.elem) == e);
+              ASSERT (rb_floor (&tree, &key.elem) == e);
+              ASSERT (rb_upper_bound (&tree, &key.elem) == rb_next (e));
+            }
+          key.value = size;
+          ASSERT (rb_find (&tree, &key.elem) == NULL);
+          ASSERT (rb_lower_bound (&tree, &key.elem) == NULL);
+          ASSERT (rb_floor (&tree, &key.elem) == rb_max (&tree));
+
+          /* Remove the odd values in random order, then verify that
+             the even ones are still there in order. */
+          for (i = 0; i < size; i++)
+            if (values[i].value % 2)
+              rb_remove (&tree, &values[i].elem);
+          verify_tree (&tree, 0, 2, (size + 1) / 2);
+
+          /* Remove the rest. */
+          for (i = 0; i < size; i++)
+            if (values[i].value % 2 == 0)
+              rb_remove (&tree, &values[i].elem);
+          ASSERT (rb_empty (&tree));
+          ASSERT (rb_min (&tree) == NULL);
+        }
+    }
+
+  printf (" done\n");
+  printf ("rbtree: PASS\n");
+}
+
+/* Shuffles the values of the CNT elements in ARRAY into random
+   order.  Only call this on elements that are not in a tree. */
+static void
+shuffle (struct value *array, size_t cnt)
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    {
+      size_t j = i + random_ulong () % (cnt - i);
+      int t = array[j].value;
+      array[j].value = array[i].value;
+      array[i].value = t;
+    }
+}
+
+/* Returns true if value A is less than value B, false
+   otherwise. */
+static bool
+value_less (const struct rb_elem *a_, const struct rb_elem *b_,
+            void *aux UNUSED)
+{
+  const struct value *a = rb_entry (a_, struct value, elem);
+  const struct value *b = rb_entry (b_, struct value, elem);
+
+  return a->value < b->value;
+}
+
+/* Verifies that no red element below E has a red child and that
+   every path below E has the same number of black elements, and
+   returns that number. */
+static int
+verify_colors (const struct rb_elem *e)
+{
+  int left, right;
+
+  if (e == NULL)
+    return 1;
+  if (e->red)
+    ASSERT ((e->left == NULL || !e->left->red)
+            && (e->right == NULL || !e->right->red));
+  if (e->left != NULL)
+    ASSERT (e->left->parent == e);
+  if (e->right != NULL)
+    ASSERT (e->right->parent == e);
+
+  left = verify_colors (e->left);
+  right = verify_colors (e->right);
+  ASSERT (left == right);
+  return left + !e->red;
+}
+
+/* Verifies that TREE holds SIZE values FIRST, FIRST+STEP, ..., in
+   that order both ways, and that it is balanced. */
+static void
+verify_tree (struct rbtree *tree, int first, int step, int size)
+{
+  struct rb_elem *e;
+  int i;
+
+  ASSERT (rb_size (tree) == (size_t) size);
+  ASSERT (tree->root == NULL || !tree->root->red);
+  verify_colors (tree->root);
+
+  for (e = rb_min (tree), i = 0; e != NULL; e = rb_next (e), i++)
+    ASSERT (rb_entry (e, struct value, elem)->value == first + i * step);
+  ASSERT (i == size);
+
+  for (e = rb_max (tree); e != NULL; e = rb_prev (e))
+    ASSERT (rb_entry (e, struct value, elem)->value == first + --i * step);
+  ASSERT (i == 0);
+}
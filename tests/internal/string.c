@@ -0,0 +1,122 @@
+/* Test program for the block functions in lib/string.c.
+
+   Checks memcpy(), memmove() and memset() against simple byte
+   loops at every small alignment and length, then times both on
+   page-sized blocks, the size fork() and PAL_ZERO deal in.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <random.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/test.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
+
+/* Size of the buffers used for checking. */
+#define BUF_SIZE 256
+
+/* Number of page-sized operations timed for each function. */
+#define BENCH_ROUNDS 1000
+
+static void check_block_functions (void);
+static void bench_block_functions (void);
+static void byte_copy (unsigned char *, const unsigned char *, size_t);
+static void byte_set (unsigned char *, int, size_t);
+
+void
+test (void)
+{
+  check_block_functions ();
+  bench_block_functions ();
+  printf ("string: PASS\n");
+}
+
+/* Compares the library functions with byte loops for every
+   source and destination offset and length in a small window. */
+static void
+check_block_functions (void)
+{
+  static unsigned char a[BUF_SIZE], b[BUF_SIZE], tmp[BUF_SIZE];
+  size_t src, dst, len, i;
+
+  printf ("checking memcpy, memmove and memset:");
+  for (src = 0; src < 16; src++)
+    for (dst = 0; dst < 16; dst++)
+      for (len = 0; len < BUF_SIZE - 16; len += len < 40 ? 1 : 13)
+        {
+          for (i = 0; i < BUF_SIZE; i++)
+            a[i] = b[i] = random_ulong ();
+
+          /* Overlapping move, in either direction. */
+          byte_copy (tmp, b + src, len);
+          byte_copy (b + dst, tmp, len);
+          ASSERT (memmove (a + dst, a + src, len) == a + dst);
+          ASSERT (!memcmp (a, b, BUF_SIZE));
+
+          /* Disjoint copy. */
+          byte_copy (tmp, a + src, len);
+          ASSERT (memcpy (b + dst, tmp, len) == b + dst);
+          byte_copy (a + dst, tmp, len);
+          ASSERT (!memcmp (a, b, BUF_SIZE));
+
+          /* Fill. */
+          ASSERT (memset (a + dst, src * 17, len) == a + dst);
+          byte_set (b + dst, src * 17, len);
+          ASSERT (!memcmp (a, b, BUF_SIZE));
+        }
+  printf (" done\n");
+}
+
+/* Prints the time taken by BENCH_ROUNDS page-sized copies and
+   fills, with the byte loops and with the library. */
+static void
+bench_block_functions (void)
+{
+  static unsigned char src[PGSIZE], dst[PGSIZE];
+  uint64_t start, bytes, lib;
+  int i;
+
+  start = rdtsc ();
+  for (i = 0; i < BENCH_ROUNDS; i++)
+    byte_copy (dst, src, PGSIZE);
+  bytes = rdtsc () - start;
+  start = rdtsc ();
+  for (i = 0; i < BENCH_ROUNDS; i++)
+    memcpy (dst, src, PGSIZE);
+  lib = rdtsc () - start;
+  printf ("copy 4 kB: byte loop %llu cycles, memcpy %llu cycles\n",
+          bytes / BENCH_ROUNDS, lib / BENCH_ROUNDS);
+
+  start = rdtsc ();
+  for (i = 0; i < BENCH_ROUNDS; i++)
+    byte_set (dst, i, PGSIZE);
+  bytes = rdtsc () - start;
+  start = rdtsc ();
+  for (i = 0; i < BENCH_ROUNDS; i++)
+    memset (dst, i, PGSIZE);
+  lib = rdtsc () - start;
+  printf ("fill 4 kB: byte loop %llu cycles, memset %llu cycles\n",
+          bytes / BENCH_ROUNDS, lib / BENCH_ROUNDS);
+}
+
+/* Copies SIZE bytes from SRC to DST one at a time, front to back. */
+static void
+byte_copy (unsigned char *dst, const unsigned char *src, size_t size)
+{
+  while (size-- > 0)
+    *dst++ = *src++;
+}
+
+/* Sets SIZE bytes at DST to VALUE one at a time. */
+static void
+byte_set (unsigned char *dst, int value, size_t size)
+{
+  while (size-- > 0)
+    *dst++ = value;
+}
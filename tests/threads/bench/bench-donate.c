@@ -0,0 +1,97 @@
+/* Measures lock handoffs under priority donation chains.  For a
+   chain of depth D, thread I of D, of priority PRI_DEFAULT + I,
+   holds lock I and waits for lock I - 1, which main holds for I =
+   1, so main has every donation.  Building the chain makes D nested
+   donations; main's release of lock 0 then hands every lock down
+   the chain in turn.  Both are timed, round after round. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "tests/threads/bench/bench.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "intrinsic.h"
+
+#define ROUNDS 1000
+#define MAX_DEPTH 7
+
+static int depth;
+static struct lock locks[MAX_DEPTH + 1];
+static struct semaphore go[MAX_DEPTH + 1];
+static struct semaphore done;
+
+static void
+link_thread (void *aux)
+{
+  int i = (int) (intptr_t) aux;
+  int r;
+
+  for (r = 0; r < ROUNDS; r++)
+    {
+      sema_down (&go[i]);
+      lock_acquire (&locks[i]);
+      lock_acquire (&locks[i - 1]);
+      lock_release (&locks[i - 1]);
+      lock_release (&locks[i]);
+      if (i == depth)
+        sema_up (&done);
+    }
+}
+
+/* Runs ROUNDS rounds with a chain of D threads. */
+static void
+chain (int d)
+{
+  uint64_t build = 0, drain = 0, start;
+  char name[64];
+  int i, r;
+
+  depth = d;
+  for (i = 0; i <= d; i++)
+    {
+      lock_init (&locks[i]);
+      sema_init (&go[i], 0);
+    }
+  sema_init (&done, 0);
+  for (i = 1; i <= d; i++)
+    thread_create ("link", PRI_DEFAULT + i, link_thread, (void *) (intptr_t) i);
+
+  for (r = 0; r < ROUNDS; r++)
+    {
+      lock_acquire (&locks[0]);
+
+      /* Each sema_up() runs the next, higher-priority thread until
+         it blocks on the lock of the one before. */
+      start = rdtsc ();
+      for (i = 1; i <= d; i++)
+        sema_up (&go[i]);
+      build += rdtsc () - start;
+      if (thread_get_priority () != PRI_DEFAULT + d)
+        fail ("main has priority %d, expected %d",
+              thread_get_priority (), PRI_DEFAULT + d);
+
+      start = rdtsc ();
+      lock_release (&locks[0]);
+      sema_down (&done);
+      drain += rdtsc () - start;
+    }
+
+  msg ("chain of depth %d", d);
+  snprintf (name, sizeof name, "depth %d donation", d);
+  msg ("%s: %d ops, %llu cycles, %llu cycles/op", name, ROUNDS * d,
+       (unsigned long long) build, (unsigned long long) (build / (ROUNDS * d)));
+  snprintf (name, sizeof name, "depth %d handoff", d);
+  msg ("%s: %d ops, %llu cycles, %llu cycles/op", name, ROUNDS * (d + 1),
+       (unsigned long long) drain,
+       (unsigned long long) (drain / (ROUNDS * (d + 1))));
+}
+
+void
+test_bench_donate (void)
+{
+  ASSERT (!thread_mlfqs);
+
+  chain (1);
+  chain (4);
+  chain (MAX_DEPTH);
+}
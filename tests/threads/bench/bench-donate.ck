@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = grep (!/ cycles, /, read_text_file ("$test.output"));
+common_checks ("run", @output);
+compare_output ("run", \@output, [<<'EOF']);
+(bench-donate) begin
+(bench-donate) chain of depth 1
+(bench-donate) chain of depth 4
+(bench-donate) chain of depth 7
+(bench-donate) end
+EOF
+pass;
@@ -0,0 +1,192 @@
+/* Measures malloc() and free(): the latency of each, size class by
+   size class; how well a long run of mixed sizes keeps the arenas
+   used; and the throughput of several threads allocating at once. */
+
+#include <memstat.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "tests/threads/bench/bench.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
+
+/* Blocks allocated per size class. */
+#define BLOCKS 2000
+
+/* Live slots and steps of the mixed-size run. */
+#define SLOTS 512
+#define STEPS 20000
+#define REPORT_EVERY 4000
+
+/* malloc()/free() pairs per thread of the contention run. */
+#define PAIRS 5000
+#define MAX_THREADS 8
+
+static uint64_t *samples;
+static void **blocks;
+
+/* Returns a pseudo-random number; the sequence is the same on every
+   run, so runs can be compared. */
+static uint64_t
+next_random (void)
+{
+  static uint64_t x = 88172645463325252ULL;
+
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  return x;
+}
+
+/* Times BLOCKS malloc() calls of SIZE bytes and then the free()
+   of each block. */
+static void
+size_class (size_t size)
+{
+  char name[64];
+  uint64_t start;
+  int i;
+
+  for (i = 0; i < BLOCKS; i++)
+    {
+      start = rdtsc ();
+      blocks[i] = malloc (size);
+      samples[i] = rdtsc () - start;
+      if (blocks[i] == NULL)
+        fail ("malloc (%zu) failed", size);
+    }
+  snprintf (name, sizeof name, "malloc %zu", size);
+  bench_percentiles (name, samples, BLOCKS);
+
+  for (i = 0; i < BLOCKS; i++)
+    {
+      start = rdtsc ();
+      free (blocks[i]);
+      samples[i] = rdtsc () - start;
+    }
+  snprintf (name, sizeof name, "free %zu", size);
+  bench_percentiles (name, samples, BLOCKS);
+}
+
+/* Returns a size for the mixed run: mostly small, now and then a
+   page or more. */
+static size_t
+mixed_size (void)
+{
+  uint64_t r = next_random ();
+
+  if (r % 16 == 0)
+    return PGSIZE + r % (2 * PGSIZE);
+  return 8 + (r >> 8) % 1024;
+}
+
+/* Frees or allocates a random slot STEPS times, reporting how much
+   of the memory the heap holds is in live blocks. */
+static void
+mixed_run (void)
+{
+  struct memstat ms;
+  uint64_t start = rdtsc ();
+  int step;
+
+  for (step = 0; step < SLOTS; step++)
+    blocks[step] = NULL;
+  for (step = 1; step <= STEPS; step++)
+    {
+      int slot = next_random () % SLOTS;
+
+      if (blocks[slot] != NULL)
+        {
+          free (blocks[slot]);
+          blocks[slot] = NULL;
+        }
+      else if ((blocks[slot] = malloc (mixed_size ())) == NULL)
+        fail ("malloc failed in the mixed run");
+
+      if (step % REPORT_EVERY == 0)
+        {
+          uint64_t held;
+
+          malloc_get_stats (&ms);
+          held = (ms.heap_arenas + ms.heap_big_pages) * PGSIZE;
+          msg ("mixed step %d: %llu cycles, %llu live bytes, "
+               "%llu bytes held, %llu%% used", step,
+               (unsigned long long) (rdtsc () - start),
+               (unsigned long long) ms.heap_bytes,
+               (unsigned long long) held,
+               (unsigned long long) (held > 0
+                                     ? ms.heap_bytes * 100 / held : 0));
+          start = rdtsc ();
+        }
+    }
+  for (step = 0; step < SLOTS; step++)
+    free (blocks[step]);
+}
+
+static struct semaphore done;
+
+static void
+churn (void *aux UNUSED)
+{
+  void *p[4];
+  int i;
+
+  for (i = 0; i < PAIRS; i++)
+    {
+      p[i % 4] = malloc (64 + i % 4 * 64);
+      if (i % 4 == 3)
+        {
+          free (p[0]);
+          free (p[1]);
+          free (p[2]);
+          free (p[3]);
+        }
+    }
+  sema_up (&done);
+}
+
+/* Runs THREADS threads of malloc() and free() at once. */
+static void
+contention (int threads)
+{
+  struct bench b;
+  char name[64];
+  int i;
+
+  snprintf (name, sizeof name, "%d threads", threads);
+  bench_start (&b, name);
+  for (i = 0; i < threads; i++)
+    thread_create ("churn", PRI_DEFAULT, churn, NULL);
+  for (i = 0; i < threads; i++)
+    sema_down (&done);
+  bench_stop (&b, (unsigned long) threads * PAIRS * 2);
+}
+
+void
+test_bench_malloc (void)
+{
+  size_t size;
+  int threads;
+
+  samples = malloc (BLOCKS * sizeof *samples);
+  blocks = malloc (BLOCKS * sizeof *blocks);
+  ASSERT (samples != NULL && blocks != NULL);
+
+  msg ("size classes");
+  for (size = 16; size <= 2 * PGSIZE; size *= 2)
+    size_class (size);
+
+  msg ("mixed sizes");
+  mixed_run ();
+
+  msg ("contention");
+  sema_init (&done, 0);
+  for (threads = 1; threads <= MAX_THREADS; threads *= 2)
+    contention (threads);
+
+  free (blocks);
+  free (samples);
+}
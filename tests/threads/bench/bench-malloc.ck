@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = grep (!/ cycles, /, read_text_file ("$test.output"));
+common_checks ("run", @output);
+compare_output ("run", \@output, [<<'EOF']);
+(bench-malloc) begin
+(bench-malloc) size classes
+(bench-malloc) mixed sizes
+(bench-malloc) contention
+(bench-malloc) end
+EOF
+pass;
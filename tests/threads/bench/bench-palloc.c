@@ -0,0 +1,72 @@
+/* Measures palloc_get_page() and palloc_get_multiple() as the user
+   pool fills: allocates runs of pages until the pool is exhausted,
+   timing each call, and reports each quarter of the fill apart. */
+
+#include <memstat.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "tests/threads/bench/bench.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "intrinsic.h"
+
+static uint64_t *samples;
+static void **runs;
+
+/* Fills the user pool with runs of PAGES pages, then frees them. */
+static void
+fill (size_t pages)
+{
+  struct memstat ms;
+  size_t cnt, max, quarter, i;
+  uint64_t start, cycles;
+  char name[64];
+
+  palloc_get_stats (&ms);
+  max = ms.user_free / pages;
+  for (cnt = 0; cnt < max; cnt++)
+    {
+      start = rdtsc ();
+      runs[cnt] = palloc_get_multiple (PAL_USER, pages);
+      samples[cnt] = rdtsc () - start;
+      if (runs[cnt] == NULL)
+        break;
+    }
+
+  /* Reported by quarter, so each can be sorted on its own. */
+  for (quarter = 0; quarter < 4; quarter++)
+    {
+      size_t lo = cnt * quarter / 4, hi = cnt * (quarter + 1) / 4;
+
+      snprintf (name, sizeof name, "%zu page%s, %zu-%zu%% full", pages,
+                pages > 1 ? "s" : "", quarter * 25, quarter * 25 + 25);
+      bench_percentiles (name, samples + lo, hi - lo);
+    }
+
+  start = rdtsc ();
+  for (i = 0; i < cnt; i++)
+    palloc_free_multiple (runs[i], pages);
+  cycles = rdtsc () - start;
+  msg ("free runs of %zu: %zu ops, %llu cycles, %llu cycles/op", pages,
+       cnt, (unsigned long long) cycles,
+       (unsigned long long) (cnt > 0 ? cycles / cnt : 0));
+}
+
+void
+test_bench_palloc (void)
+{
+  struct memstat ms;
+
+  palloc_get_stats (&ms);
+  samples = malloc (ms.user_free * sizeof *samples);
+  runs = malloc (ms.user_free * sizeof *runs);
+  ASSERT (samples != NULL && runs != NULL);
+
+  msg ("fill the user pool one page at a time");
+  fill (1);
+  msg ("fill the user pool four pages at a time");
+  fill (4);
+
+  free (runs);
+  free (samples);
+}
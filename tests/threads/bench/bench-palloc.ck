@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = grep (!/ cycles, /, read_text_file ("$test.output"));
+common_checks ("run", @output);
+compare_output ("run", \@output, [<<'EOF']);
+(bench-palloc) begin
+(bench-palloc) fill the user pool one page at a time
+(bench-palloc) fill the user pool four pages at a time
+(bench-palloc) end
+EOF
+pass;
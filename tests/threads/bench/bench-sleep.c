@@ -0,0 +1,89 @@
+/* Measures timer_sleep() accuracy and jitter.  Groups of 1 up to
+   10,000 threads all sleep until the same tick; each records the
+   tick and the TSC at which it ran again.  A thread is late if it
+   ran after that tick, and the jitter is how long after the first
+   of its group each thread ran. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "tests/threads/bench/bench.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+#include "intrinsic.h"
+
+#define MAX_SLEEPERS 10000
+
+struct sleeper
+  {
+    uint64_t tsc;               /* When it ran again. */
+    int64_t tick;               /* Tick at which it ran again. */
+  };
+
+static struct sleeper *sleepers;
+static uint64_t *jitter;
+static int64_t target;
+static struct semaphore done;
+
+static void
+sleeper (void *s_)
+{
+  struct sleeper *s = s_;
+
+  timer_sleep (target - timer_ticks ());
+  s->tsc = rdtsc ();
+  s->tick = timer_ticks ();
+  sema_up (&done);
+}
+
+/* Puts CNT threads to sleep until the same tick and reports how
+   they woke. */
+static void
+sleep_group (int cnt)
+{
+  char name[64];
+  uint64_t first = UINT64_MAX;
+  int created, late = 0, i;
+
+  /* Leave enough ticks to create them all before TARGET. */
+  target = timer_ticks () + 5 + cnt / 100;
+  for (created = 0; created < cnt; created++)
+    if (thread_create ("sleeper", PRI_DEFAULT + 1, sleeper,
+                       &sleepers[created]) == TID_ERROR)
+      break;
+  for (i = 0; i < created; i++)
+    sema_down (&done);
+
+  for (i = 0; i < created; i++)
+    {
+      if (sleepers[i].tick > target)
+        late++;
+      if (sleepers[i].tsc < first)
+        first = sleepers[i].tsc;
+    }
+  for (i = 0; i < created; i++)
+    jitter[i] = sleepers[i].tsc - first;
+
+  msg ("group of %d", cnt);
+  snprintf (name, sizeof name, "%d of %d sleepers, %d late",
+            created, cnt, late);
+  bench_samples (name, jitter, created);
+}
+
+void
+test_bench_sleep (void)
+{
+  int cnt;
+
+  ASSERT (!thread_mlfqs);
+
+  sleepers = malloc (MAX_SLEEPERS * sizeof *sleepers);
+  jitter = malloc (MAX_SLEEPERS * sizeof *jitter);
+  ASSERT (sleepers != NULL && jitter != NULL);
+  sema_init (&done, 0);
+  for (cnt = 1; cnt <= MAX_SLEEPERS; cnt *= 10)
+    sleep_group (cnt);
+  free (jitter);
+  free (sleepers);
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = grep (!/ cycles, /, read_text_file ("$test.output"));
+common_checks ("run", @output);
+compare_output ("run", \@output, [<<'EOF']);
+(bench-sleep) begin
+(bench-sleep) group of 1
+(bench-sleep) group of 10
+(bench-sleep) group of 100
+(bench-sleep) group of 1000
+(bench-sleep) group of 10000
+(bench-sleep) end
+EOF
+pass;
@@ -0,0 +1,46 @@
+/* Measures thread_create() and thread exit throughput, both for
+   threads that preempt their creator and run to completion at once
+   and for a batch of threads that run only after all of them have
+   been created. */
+
+#include "tests/threads/tests.h"
+#include "tests/threads/bench/bench.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define THREADS 1000
+
+static struct semaphore done;
+
+static void
+quit (void *aux UNUSED)
+{
+  sema_up (&done);
+}
+
+void
+test_bench_spawn (void)
+{
+  struct bench b;
+  int i;
+
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&done, 0);
+
+  msg ("create and run %d threads one at a time", THREADS);
+  bench_start (&b, "create+exit, preempting");
+  for (i = 0; i < THREADS; i++)
+    thread_create ("quit", PRI_DEFAULT + 1, quit, NULL);
+  bench_stop (&b, THREADS);
+  for (i = 0; i < THREADS; i++)
+    sema_down (&done);
+
+  msg ("create %d threads, then run them", THREADS);
+  bench_start (&b, "create+exit, batched");
+  for (i = 0; i < THREADS; i++)
+    thread_create ("quit", PRI_DEFAULT, quit, NULL);
+  for (i = 0; i < THREADS; i++)
+    sema_down (&done);
+  bench_stop (&b, THREADS);
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = grep (!/ cycles, /, read_text_file ("$test.output"));
+common_checks ("run", @output);
+compare_output ("run", \@output, [<<'EOF']);
+(bench-spawn) begin
+(bench-spawn) create and run 1000 threads one at a time
+(bench-spawn) create 1000 threads, then run them
+(bench-spawn) end
+EOF
+pass;
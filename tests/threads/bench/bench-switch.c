@@ -0,0 +1,46 @@
+/* Measures the cost of a context switch, as two threads of the
+   same priority hand control back and forth through a pair of
+   semaphores. */
+
+#include "tests/threads/tests.h"
+#include "tests/threads/bench/bench.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define ROUNDS 10000
+
+static struct semaphore ping, pong;
+
+static void
+partner (void *aux UNUSED)
+{
+  int i;
+
+  for (i = 0; i < ROUNDS; i++)
+    {
+      sema_down (&ping);
+      sema_up (&pong);
+    }
+}
+
+void
+test_bench_switch (void)
+{
+  struct bench b;
+  int i;
+
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&ping, 0);
+  sema_init (&pong, 0);
+  thread_create ("partner", PRI_DEFAULT, partner, NULL);
+
+  msg ("ping-pong %d times", ROUNDS);
+  bench_start (&b, "context switch");
+  for (i = 0; i < ROUNDS; i++)
+    {
+      sema_up (&ping);
+      sema_down (&pong);
+    }
+  bench_stop (&b, 2 * ROUNDS);
+}
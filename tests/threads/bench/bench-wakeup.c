@@ -0,0 +1,53 @@
+/* Measures wakeup latency: the cycles from sema_up() on a
+   semaphore a higher-priority thread waits on until that thread
+   runs. */
+
+#include "tests/threads/tests.h"
+#include "tests/threads/bench/bench.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "intrinsic.h"
+
+#define ROUNDS 10000
+
+static struct semaphore wake, done;
+static volatile uint64_t woken_at;
+static uint64_t *latency;
+
+static void
+sleeper (void *aux UNUSED)
+{
+  int i;
+
+  for (i = 0; i < ROUNDS; i++)
+    {
+      sema_down (&wake);
+      latency[i] = rdtsc () - woken_at;
+    }
+  sema_up (&done);
+}
+
+void
+test_bench_wakeup (void)
+{
+  int i;
+
+  ASSERT (!thread_mlfqs);
+
+  latency = malloc (ROUNDS * sizeof *latency);
+  ASSERT (latency != NULL);
+  sema_init (&wake, 0);
+  sema_init (&done, 0);
+  thread_create ("sleeper", PRI_DEFAULT + 1, sleeper, NULL);
+
+  msg ("wake a higher-priority thread %d times", ROUNDS);
+  for (i = 0; i < ROUNDS; i++)
+    {
+      woken_at = rdtsc ();
+      sema_up (&wake);
+    }
+  sema_down (&done);
+  bench_samples ("sema_up to running", latency, ROUNDS);
+  free (latency);
+}
@@ -0,0 +1,83 @@
+#include "tests/threads/bench/bench.h"
+#include <stdlib.h>
+#include "tests/threads/tests.h"
+#include "intrinsic.h"
+
+/* Starts measuring B, which is called NAME in the report. */
+void
+bench_start (struct bench *b, const char *name)
+{
+  b->name = name;
+  b->cycles = rdtsc ();
+}
+
+/* Stops measuring B, which carried out OPS operations, and reports
+   the cycles it took.  Report lines all contain " cycles, ", by
+   which the .ck files leave them out. */
+void
+bench_stop (struct bench *b, unsigned long ops)
+{
+  uint64_t cycles = rdtsc () - b->cycles;
+
+  msg ("%s: %lu ops, %llu cycles, %llu cycles/op",
+       b->name, ops, (unsigned long long) cycles,
+       (unsigned long long) (ops > 0 ? cycles / ops : 0));
+}
+
+/* Reports the CNT latencies in SAMPLES, in cycles, as measured by
+   NAME: their sum, mean, minimum and maximum. */
+void
+bench_samples (const char *name, const uint64_t *samples, size_t cnt)
+{
+  uint64_t sum = 0, min = UINT64_MAX, max = 0;
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    {
+      sum += samples[i];
+      if (samples[i] < min)
+        min = samples[i];
+      if (samples[i] > max)
+        max = samples[i];
+    }
+  if (cnt == 0)
+    min = 0;
+  msg ("%s: %zu ops, %llu cycles, %llu cycles/op, %llu min, %llu max",
+       name, cnt, (unsigned long long) sum,
+       (unsigned long long) (cnt > 0 ? sum / cnt : 0),
+       (unsigned long long) min, (unsigned long long) max);
+}
+
+/* Orders uint64_t A and B for qsort(). */
+static int
+compare_u64 (const void *a_, const void *b_)
+{
+  uint64_t a = *(const uint64_t *) a_, b = *(const uint64_t *) b_;
+
+  return a < b ? -1 : a > b;
+}
+
+/* Reports the CNT latencies in SAMPLES, in cycles, as measured by
+   NAME: their sum and their 50th, 90th and 99th percentiles and
+   maximum.  Sorts SAMPLES. */
+void
+bench_percentiles (const char *name, uint64_t *samples, size_t cnt)
+{
+  uint64_t sum = 0;
+  size_t i;
+
+  if (cnt == 0)
+    {
+      msg ("%s: 0 ops, 0 cycles, no samples", name);
+      return;
+    }
+  qsort (samples, cnt, sizeof *samples, compare_u64);
+  for (i = 0; i < cnt; i++)
+    sum += samples[i];
+  msg ("%s: %zu ops, %llu cycles, p50 %llu, p90 %llu, p99 %llu, max %llu",
+       name, cnt, (unsigned long long) sum,
+       (unsigned long long) samples[cnt / 2],
+       (unsigned long long) samples[cnt * 9 / 10],
+       (unsigned long long) samples[cnt * 99 / 100],
+       (unsigned long long) samples[cnt - 1]);
+}
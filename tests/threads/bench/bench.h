@@ -0,0 +1,19 @@
+#ifndef TESTS_THREADS_BENCH_BENCH_H
+#define TESTS_THREADS_BENCH_BENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* One measured run. */
+struct bench
+  {
+    const char *name;           /* What is measured. */
+    uint64_t cycles;            /* TSC at bench_start(). */
+  };
+
+void bench_start (struct bench *, const char *name);
+void bench_stop (struct bench *, unsigned long ops);
+void bench_samples (const char *name, const uint64_t *samples, size_t cnt);
+void bench_percentiles (const char *name, uint64_t *samples, size_t cnt);
+
+#endif /* tests/threads/bench/bench.h */
@@ -32,6 +32,13 @@ extern test_func test_mlfqs_fair_20;
 extern test_func test_mlfqs_nice_2;
 extern test_func test_mlfqs_nice_10;
 extern test_func test_mlfqs_block;
+extern test_func test_bench_switch;
+extern test_func test_bench_wakeup;
+extern test_func test_bench_sleep;
+extern test_func test_bench_spawn;
+extern test_func test_bench_donate;
+extern test_func test_bench_malloc;
+extern test_func test_bench_palloc;
 
 void msg (const char *, ...);
 void fail (const char *, ...);
@@ -0,0 +1,43 @@
+/* Checks set_affinity() and get_affinity() on a child: an empty
+   mask, or one naming only CPUs that do not exist, is refused and
+   changes nothing, while a mask of CPU 0 is taken.  Another
+   process, here the child's sibling, may neither set nor read the
+   child's mask, and neither works once the child is gone. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  uint64_t all;
+  int fds[2];
+  pid_t a, b;
+  char c;
+
+  CHECK (pipe (fds) == 0, "pipe");
+  if ((b = fork ("child-b")) == 0)
+    {
+      read (fds[0], &c, 1);
+      exit (0);
+    }
+
+  CHECK ((all = get_affinity (b)) != 0, "get_affinity (child-b)");
+  CHECK (!set_affinity (b, 0), "set_affinity (child-b, 0) fails");
+  CHECK (!set_affinity (b, 1ULL << 63),
+         "set_affinity to a CPU that does not exist fails");
+  CHECK (get_affinity (b) == all, "mask is unchanged");
+  CHECK (set_affinity (b, 1), "set_affinity (child-b, CPU 0)");
+  CHECK (get_affinity (b) == 1, "get_affinity (child-b) is CPU 0");
+
+  /* child-a is child-b's sibling, not its parent. */
+  if ((a = fork ("child-a")) == 0)
+    exit (!set_affinity (b, 1) && get_affinity (b) == 0 ? 81 : 1);
+  CHECK (wait (a) == 81, "child-a may not touch child-b");
+
+  write (fds[1], "", 1);
+  CHECK (wait (b) == 0, "wait for child-b");
+  CHECK (get_affinity (b) == 0, "get_affinity of a reaped child fails");
+  CHECK (!set_affinity (b, 1), "set_affinity of a reaped child fails");
+}
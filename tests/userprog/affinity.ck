@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(affinity) begin
+(affinity) pipe
+(affinity) get_affinity (child-b)
+(affinity) set_affinity (child-b, 0) fails
+(affinity) set_affinity to a CPU that does not exist fails
+(affinity) mask is unchanged
+(affinity) set_affinity (child-b, CPU 0)
+(affinity) get_affinity (child-b) is CPU 0
+child-a: exit(81)
+(affinity) child-a may not touch child-b
+child-b: exit(0)
+(affinity) wait for child-b
+(affinity) get_affinity of a reaped child fails
+(affinity) set_affinity of a reaped child fails
+(affinity) end
+affinity: exit(0)
+EOF
+pass;
@@ -0,0 +1,30 @@
+/* Checks the admission control of set_deadline(): parameters out
+   of order are rejected, half the CPU may be reserved once but not
+   twice, and a thread may change or drop its own reservation. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  volatile int sum = 0;
+  int pid;
+  int i;
+
+  CHECK (!set_deadline (20, 10, 100), "runtime past deadline rejected");
+  CHECK (!set_deadline (10, 200, 100), "deadline past period rejected");
+  CHECK (set_deadline (50, 100, 100), "reserve half the CPU");
+
+  /* Spend a few budgets, so that we are throttled and replenished. */
+  for (i = 0; i < 10000000; i++)
+    sum += i;
+
+  if ((pid = fork ("child")) == 0)
+    exit (set_deadline (50, 100, 100));
+  CHECK (wait (pid) == 0, "second half reservation rejected");
+
+  CHECK (set_deadline (90, 100, 100), "grow own reservation");
+  CHECK (set_deadline (0, 0, 0), "drop reservation");
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(deadline-admit) begin
+(deadline-admit) runtime past deadline rejected
+(deadline-admit) deadline past period rejected
+(deadline-admit) reserve half the CPU
+child: exit(0)
+(deadline-admit) second half reservation rejected
+(deadline-admit) grow own reservation
+(deadline-admit) drop reservation
+(deadline-admit) end
+deadline-admit: exit(0)
+EOF
+pass;
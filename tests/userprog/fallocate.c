@@ -0,0 +1,46 @@
+/* Preallocates space past the end of a short file with fallocate()
+   and checks that the file grows to cover it, that the position
+   does not move, that the new bytes read as zeros, and that the
+   bytes written before are kept. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define OFFSET 1000
+#define LENGTH 3000
+
+static char buf[OFFSET + LENGTH];
+
+void
+test_main (void)
+{
+  static const char data[] = "0123456789";
+  int fd, i;
+
+  CHECK (create ("prealloc", 0), "create \"prealloc\"");
+  CHECK ((fd = open ("prealloc")) > 1, "open \"prealloc\"");
+  CHECK (write (fd, data, 10) == 10, "write 10 bytes");
+
+  CHECK (fallocate (fd, OFFSET, LENGTH) == 0,
+         "fallocate %d bytes at offset %d", LENGTH, OFFSET);
+  CHECK (filesize (fd) == OFFSET + LENGTH, "file size is %d", OFFSET + LENGTH);
+  CHECK (tell (fd) == 10, "position is still 10");
+
+  memset (buf, 'x', sizeof buf);
+  seek (fd, 0);
+  CHECK (read (fd, buf, sizeof buf) == OFFSET + LENGTH,
+         "read %d bytes", OFFSET + LENGTH);
+  if (memcmp (buf, data, 10))
+    fail ("bytes written before fallocate changed");
+  for (i = 10; i < OFFSET + LENGTH; i++)
+    if (buf[i] != 0)
+      fail ("byte %d is %d, not zero", i, buf[i]);
+  msg ("preallocated range reads as zeros");
+
+  CHECK (fallocate (fd, 0, 100) == 0, "fallocate inside the file");
+  CHECK (filesize (fd) == OFFSET + LENGTH, "file size is unchanged");
+  CHECK (fallocate (fd, 0, 0) == -1, "fallocate of 0 bytes fails");
+  CHECK (fallocate (fd, -1, 10) == -1, "fallocate at negative offset fails");
+}
@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fallocate) begin
+(fallocate) create "prealloc"
+(fallocate) open "prealloc"
+(fallocate) write 10 bytes
+(fallocate) fallocate 3000 bytes at offset 1000
+(fallocate) file size is 4000
+(fallocate) position is still 10
+(fallocate) read 4000 bytes
+(fallocate) preallocated range reads as zeros
+(fallocate) fallocate inside the file
+(fallocate) file size is unchanged
+(fallocate) fallocate of 0 bytes fails
+(fallocate) fallocate at negative offset fails
+(fallocate) end
+fallocate: exit(0)
+EOF
+pass;
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fpu-fork) begin
+(fpu-fork) child inherited xmm0
+(fpu-fork) child set xmm0
+child: exit(81)
+(fpu-fork) Parent: child exit status is 81
+(fpu-fork) parent's xmm0 preserved
+(fpu-fork) end
+fpu-fork: exit(0)
+EOF
+pass;
@@ -0,0 +1,47 @@
+/* Writes a file, syncs it with fsync(), and checks that the disk
+   holding the file system has written at least the file's bytes
+   by the time the call returns, and that the data still reads back
+   afterward. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* The file system disk, hd0:1, as diskstat() numbers disks. */
+#define FS_DISK 1
+
+#define SIZE 2048
+
+static char data[SIZE];
+static char copy[SIZE];
+
+void
+test_main (void)
+{
+  struct diskstat before, after;
+  int fd, i;
+
+  for (i = 0; i < SIZE; i++)
+    data[i] = 'a' + i % 26;
+
+  CHECK (create ("synced", 0), "create \"synced\"");
+  CHECK ((fd = open ("synced")) > 1, "open \"synced\"");
+  CHECK (diskstat (FS_DISK, &before), "diskstat before writing");
+  CHECK (write (fd, data, SIZE) == SIZE, "write %d bytes", SIZE);
+  CHECK (fsync (fd) == 0, "fsync \"synced\"");
+  CHECK (diskstat (FS_DISK, &after), "diskstat after fsync");
+  if (after.bytes_written - before.bytes_written < SIZE)
+    fail ("only %llu bytes reached the disk, fewer than %d",
+          after.bytes_written - before.bytes_written, SIZE);
+  msg ("fsync wrote the file's data to disk");
+
+  CHECK (pread (fd, copy, SIZE, 0) == SIZE, "read back %d bytes", SIZE);
+  if (memcmp (copy, data, SIZE))
+    fail ("data read back differs from data written");
+  msg ("contents match");
+
+  CHECK (fdatasync (fd) == 0, "fdatasync \"synced\"");
+  CHECK (fsync (1) == -1, "fsync of the console fails");
+  CHECK (fsync (fd + 100) == -1, "fsync of a closed fd fails");
+}
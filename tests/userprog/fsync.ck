@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fsync) begin
+(fsync) create "synced"
+(fsync) open "synced"
+(fsync) diskstat before writing
+(fsync) write 2048 bytes
+(fsync) fsync "synced"
+(fsync) diskstat after fsync
+(fsync) fsync wrote the file's data to disk
+(fsync) read back 2048 bytes
+(fsync) contents match
+(fsync) fdatasync "synced"
+(fsync) fsync of the console fails
+(fsync) fsync of a closed fd fails
+(fsync) end
+fsync: exit(0)
+EOF
+pass;
@@ -0,0 +1,77 @@
+/* Calls futex_wait() and futex_wake() directly.  A wait on a word
+   that no longer holds the expected value returns at once, a wake
+   returns how many threads it woke, and a bad futex address
+   terminates the process. */
+
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define WAITER_CNT 2
+
+static int word;
+static int woke[WAITER_CNT];
+static char stacks[WAITER_CNT][4096] __attribute__ ((aligned (16)));
+static int tids[WAITER_CNT];
+
+/* Sleeps once on WORD, then records that it was woken. */
+static void
+waiter (void *aux)
+{
+  int *flag = aux;
+
+  if (futex_wait (&word, 0) == 0)
+    *flag = 1;
+}
+
+/* Forks a child called NAME that calls futex_wake() on ADDR, and
+   returns its exit status. */
+static int
+wake_in_child (const char *name, int *addr)
+{
+  pid_t pid;
+
+  if ((pid = fork (name)) == 0)
+    {
+      futex_wake (addr, 1);
+      exit (0);
+    }
+  return wait (pid);
+}
+
+void
+test_main (void)
+{
+  int woken = 0, n, i;
+
+  CHECK (futex_wait (&word, 1) == -1, "futex_wait on a changed value fails");
+  CHECK (futex_wake (&word, 1) == 0, "futex_wake with no waiters wakes 0");
+
+  for (i = 0; i < WAITER_CNT; i++)
+    CHECK (thread_spawn (waiter, &woke[i], stacks[i] + sizeof stacks[i],
+                         NULL, &tids[i]) > 0, "spawn waiter %d", i);
+
+  /* A wake before a waiter is asleep finds nobody, so keep going
+     until both have been woken, one at a time. */
+  while (woken < WAITER_CNT)
+    {
+      n = futex_wake (&word, 1);
+      if (n < 0 || n > 1)
+        fail ("futex_wake (1) returned %d", n);
+      woken += n;
+    }
+  for (i = 0; i < WAITER_CNT; i++)
+    {
+      thread_join (&tids[i]);
+      if (!woke[i])
+        fail ("waiter %d was not woken", i);
+    }
+  msg ("futex_wake woke %d waiters", woken);
+  CHECK (futex_wake (&word, WAITER_CNT) == 0, "no waiters are left");
+
+  CHECK (wake_in_child ("child-kernel", (int *) 0x8004000000) == -1,
+         "futex_wake on a kernel address kills the process");
+  CHECK (wake_in_child ("child-unaligned", (int *) ((char *) &word + 1)) == -1,
+         "futex_wake on an unaligned address kills the process");
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(futex) begin
+(futex) futex_wait on a changed value fails
+(futex) futex_wake with no waiters wakes 0
+(futex) spawn waiter 0
+(futex) spawn waiter 1
+(futex) futex_wake woke 2 waiters
+(futex) no waiters are left
+child-kernel: exit(-1)
+(futex) futex_wake on a kernel address kills the process
+child-unaligned: exit(-1)
+(futex) futex_wake on an unaligned address kills the process
+(futex) end
+futex: exit(0)
+EOF
+pass;
@@ -0,0 +1,46 @@
+/* Has a forked child write a file, waits for it, and checks that
+   getrusage() charges the bytes and the time to the children only
+   once they have been waited for. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE 5000
+
+static char buf[SIZE];
+
+void
+test_main (void) 
+{
+  struct rusage self, children;
+  int pid, fd;
+
+  CHECK (getrusage (RUSAGE_CHILDREN, &children) == 0,
+         "getrusage(RUSAGE_CHILDREN)");
+  if (children.bytes_written != 0 || children.user_cycles != 0)
+    fail ("children used resources before there were any");
+  CHECK (create ("data", SIZE), "create \"data\"");
+
+  if ((pid = fork ("child")) == 0)
+    {
+      fd = open ("data");
+      if (fd < 0 || write (fd, buf, SIZE) != SIZE)
+        fail ("child could not write \"data\"");
+      exit (0);
+    }
+  CHECK (wait (pid) == 0, "wait for child");
+
+  CHECK (getrusage (RUSAGE_CHILDREN, &children) == 0,
+         "getrusage(RUSAGE_CHILDREN)");
+  if (children.bytes_written < SIZE)
+    fail ("children wrote %llu bytes, expected at least %d",
+          (unsigned long long) children.bytes_written, SIZE);
+  if (children.user_cycles + children.kernel_cycles == 0)
+    fail ("children took no time");
+
+  CHECK (getrusage (RUSAGE_SELF, &self) == 0, "getrusage(RUSAGE_SELF)");
+  if (self.kernel_cycles == 0)
+    fail ("we never ran in the kernel");
+  CHECK (getrusage (1, &self) == -1, "getrusage(1) fails");
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(getrusage-child) begin
+(getrusage-child) getrusage(RUSAGE_CHILDREN)
+(getrusage-child) create "data"
+child: exit(0)
+(getrusage-child) wait for child
+(getrusage-child) getrusage(RUSAGE_CHILDREN)
+(getrusage-child) getrusage(RUSAGE_SELF)
+(getrusage-child) getrusage(1) fails
+(getrusage-child) end
+getrusage-child: exit(0)
+EOF
+pass;
@@ -0,0 +1,31 @@
+/* Reads the hardware event counts twice, around some work, and
+   checks that no count went backward and that the work got
+   counted.  A CPU without counters passes too. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  struct perf_counts before, after;
+  volatile int sum = 0;
+  bool counted;
+  int e;
+
+  counted = perf_read (&before);
+  for (e = 0; e < 100000; e++)
+    sum += e;
+  CHECK (perf_read (&after) == counted, "perf_read");
+  CHECK (after.valid == before.valid, "same events counted");
+  for (e = 0; e < PERF_EVENT_CNT; e++)
+    if (after.count[e] < before.count[e])
+      fail ("event %d went from %llu to %llu", e,
+            (unsigned long long) before.count[e],
+            (unsigned long long) after.count[e]);
+  if ((after.valid & (1 << PERF_INSTRUCTIONS))
+      && after.count[PERF_INSTRUCTIONS] - before.count[PERF_INSTRUCTIONS]
+         < 100000)
+    fail ("loop retired too few instructions");
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(perf-read) begin
+(perf-read) perf_read
+(perf-read) same events counted
+(perf-read) end
+perf-read: exit(0)
+EOF
+pass;
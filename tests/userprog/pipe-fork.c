@@ -0,0 +1,47 @@
+/* Sends a few pages and some odd bytes through a pipe from a
+   forked child to its parent, which reads them back into
+   page-aligned buffers, and checks that they arrived intact and
+   that the read end sees end of file once the child is gone. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (3 * 4096 + 100)
+
+static char buf[4 * 4096] __attribute__ ((aligned (4096)));
+
+void
+test_main (void) 
+{
+  int fds[2];
+  int pid, total, n;
+  size_t i;
+
+  CHECK (pipe (fds) == 0, "pipe");
+  for (i = 0; i < SIZE; i++)
+    buf[i] = i * 7 + 3;
+
+  if ((pid = fork ("child")) == 0)
+    {
+      close (fds[0]);
+      if (write (fds[1], buf, SIZE) != SIZE)
+        fail ("short write to pipe");
+      exit (0);
+    }
+  close (fds[1]);
+
+  for (i = 0; i < SIZE; i++)
+    buf[i] = 0;
+  total = 0;
+  while ((n = read (fds[0], buf + total, sizeof buf - total)) > 0)
+    total += n;
+  if (total != SIZE)
+    fail ("read %d bytes from pipe, expected %d", total, SIZE);
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != (char) (i * 7 + 3))
+      fail ("byte %zu is wrong", i);
+  msg ("read %d bytes", total);
+  close (fds[0]);
+  msg ("wait(child) = %d", wait (pid));
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-fork) begin
+(pipe-fork) pipe
+child: exit(0)
+(pipe-fork) read 12388 bytes
+(pipe-fork) wait(child) = 0
+(pipe-fork) end
+pipe-fork: exit(0)
+EOF
+pass;
@@ -0,0 +1,46 @@
+/* Reads and writes a file at explicit offsets with pread() and
+   pwrite(), and checks the bytes moved and that the file position
+   that read() and write() use stays where seek() put it. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  char buf[32];
+  int fd, i;
+
+  CHECK (create ("positional", 0), "create \"positional\"");
+  CHECK ((fd = open ("positional")) > 1, "open \"positional\"");
+  CHECK (write (fd, "abcdefghij", 10) == 10, "write 10 bytes");
+  seek (fd, 3);
+
+  memset (buf, 0, sizeof buf);
+  CHECK (pread (fd, buf, 4, 5) == 4, "pread 4 bytes at offset 5");
+  CHECK (!strcmp (buf, "fghi"), "pread read \"fghi\"");
+  CHECK (tell (fd) == 3, "position is still 3");
+
+  CHECK (pwrite (fd, "XY", 2, 8) == 2, "pwrite 2 bytes at offset 8");
+  CHECK (tell (fd) == 3, "position is still 3");
+  memset (buf, 0, sizeof buf);
+  CHECK (pread (fd, buf, sizeof buf, 0) == 10, "pread the whole file");
+  CHECK (!strcmp (buf, "abcdefghXY"), "file is \"abcdefghXY\"");
+
+  CHECK (pwrite (fd, "Z", 1, 20) == 1, "pwrite 1 byte at offset 20");
+  CHECK (filesize (fd) == 21, "file size is 21");
+  memset (buf, 'x', sizeof buf);
+  CHECK (pread (fd, buf, 11, 10) == 11, "pread 11 bytes at offset 10");
+  for (i = 0; i < 10; i++)
+    if (buf[i] != 0)
+      fail ("byte %d of the gap is %d, not zero", i + 10, buf[i]);
+  CHECK (buf[10] == 'Z', "gap reads as zeros before \"Z\"");
+
+  memset (buf, 0, sizeof buf);
+  CHECK (read (fd, buf, 2) == 2 && !strcmp (buf, "de"),
+         "read at position 3 gets \"de\"");
+  CHECK (pread (fd, buf, 4, 21) == 0, "pread at end of file reads 0 bytes");
+  CHECK (pread (fd, buf, 4, -1) == -1, "pread at negative offset fails");
+}
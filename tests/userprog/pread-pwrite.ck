@@ -0,0 +1,27 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pread-pwrite) begin
+(pread-pwrite) create "positional"
+(pread-pwrite) open "positional"
+(pread-pwrite) write 10 bytes
+(pread-pwrite) pread 4 bytes at offset 5
+(pread-pwrite) pread read "fghi"
+(pread-pwrite) position is still 3
+(pread-pwrite) pwrite 2 bytes at offset 8
+(pread-pwrite) position is still 3
+(pread-pwrite) pread the whole file
+(pread-pwrite) file is "abcdefghXY"
+(pread-pwrite) pwrite 1 byte at offset 20
+(pread-pwrite) file size is 21
+(pread-pwrite) pread 11 bytes at offset 10
+(pread-pwrite) gap reads as zeros before "Z"
+(pread-pwrite) read at position 3 gets "de"
+(pread-pwrite) pread at end of file reads 0 bytes
+(pread-pwrite) pread at negative offset fails
+(pread-pwrite) end
+pread-pwrite: exit(0)
+EOF
+pass;
@@ -0,0 +1,59 @@
+/* Writes a file with writev() from several buffers, reads it back
+   with readv() into buffers split at other places, and checks the
+   byte counts and the contents.  Then passes readv() an invalid
+   iovec array, which must terminate the process with exit code
+   -1. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char head[] = "Scatter ";
+static char middle[] = "and gather, ";
+static char tail[] = "in one call.";
+
+void
+test_main (void)
+{
+  struct iovec out[3] = {
+    { head, sizeof head - 1 },
+    { middle, sizeof middle - 1 },
+    { tail, sizeof tail - 1 },
+  };
+  char expected[sizeof head + sizeof middle + sizeof tail];
+  char first[5], second[11], third[sizeof expected];
+  struct iovec in[3] = {
+    { first, sizeof first },
+    { second, sizeof second },
+    { third, sizeof third },
+  };
+  size_t size;
+  int fd;
+
+  strlcpy (expected, head, sizeof expected);
+  strlcat (expected, middle, sizeof expected);
+  strlcat (expected, tail, sizeof expected);
+  size = strlen (expected);
+
+  CHECK (create ("scatter", 0), "create \"scatter\"");
+  CHECK ((fd = open ("scatter")) > 1, "open \"scatter\"");
+  CHECK (writev (fd, out, 3) == (int) size, "writev %zu bytes in 3 buffers",
+         size);
+  CHECK (tell (fd) == size, "position is %zu", size);
+  CHECK (filesize (fd) == (int) size, "file size is %zu", size);
+
+  seek (fd, 0);
+  memset (third, 0, sizeof third);
+  CHECK (readv (fd, in, 3) == (int) size, "readv %zu bytes into 3 buffers",
+         size);
+  if (memcmp (first, expected, sizeof first)
+      || memcmp (second, expected + sizeof first, sizeof second)
+      || strcmp (third, expected + sizeof first + sizeof second))
+    fail ("readv read back the wrong bytes");
+  msg ("contents match");
+  CHECK (readv (fd, in, 3) == 0, "readv at end of file reads 0 bytes");
+
+  readv (fd, (struct iovec *) 0xc0100000, 3);
+  fail ("should not have survived readv()");
+}
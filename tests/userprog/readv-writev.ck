@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(readv-writev) begin
+(readv-writev) create "scatter"
+(readv-writev) open "scatter"
+(readv-writev) writev 32 bytes in 3 buffers
+(readv-writev) position is 32
+(readv-writev) file size is 32
+(readv-writev) readv 32 bytes into 3 buffers
+(readv-writev) contents match
+(readv-writev) readv at end of file reads 0 bytes
+readv-writev: exit(-1)
+EOF
+pass;
@@ -0,0 +1,58 @@
+/* Copies between two files with sendfile(), once from an explicit
+   offset, which must leave the source's position alone, and once
+   from the source's position, which must move it, and checks the
+   returned counts and the bytes that arrive. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SRC_SIZE 3000
+
+static char data[SRC_SIZE];
+static char copy[SRC_SIZE];
+
+/* Checks that the LENGTH bytes at OFFSET in the file open as FD are
+   the bytes of DATA starting at DATA_OFS. */
+static void
+check_bytes (int fd, int offset, int length, int data_ofs)
+{
+  CHECK (pread (fd, copy, length, offset) == length,
+         "read back %d bytes at offset %d", length, offset);
+  if (memcmp (copy, data + data_ofs, length))
+    fail ("bytes at offset %d differ from the source", offset);
+}
+
+void
+test_main (void)
+{
+  int src, dst, i;
+
+  for (i = 0; i < SRC_SIZE; i++)
+    data[i] = i % 251;
+
+  CHECK (create ("source", 0), "create \"source\"");
+  CHECK (create ("target", 0), "create \"target\"");
+  CHECK ((src = open ("source")) > 1, "open \"source\"");
+  CHECK ((dst = open ("target")) > 1, "open \"target\"");
+  CHECK (write (src, data, SRC_SIZE) == SRC_SIZE, "write %d bytes", SRC_SIZE);
+  seek (src, 0);
+
+  CHECK (sendfile (dst, src, 100, 500) == 500,
+         "sendfile 500 bytes from offset 100");
+  CHECK (tell (src) == 0, "source position unchanged");
+  CHECK (tell (dst) == 500, "target position is 500");
+  check_bytes (dst, 0, 500, 100);
+
+  seek (src, 1000);
+  CHECK (sendfile (dst, src, -1, 5000) == SRC_SIZE - 1000,
+         "sendfile from position 1000 stops at end of file");
+  CHECK (tell (src) == SRC_SIZE, "source position is %d", SRC_SIZE);
+  CHECK (filesize (dst) == 500 + SRC_SIZE - 1000, "target size is %d",
+         500 + SRC_SIZE - 1000);
+  check_bytes (dst, 500, SRC_SIZE - 1000, 1000);
+
+  CHECK (sendfile (dst, src, -1, 100) == 0, "sendfile at end of file is 0");
+  CHECK (sendfile (dst, dst + 100, 0, 100) == -1, "sendfile from bad fd fails");
+}
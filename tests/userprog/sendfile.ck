@@ -0,0 +1,25 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(sendfile) begin
+(sendfile) create "source"
+(sendfile) create "target"
+(sendfile) open "source"
+(sendfile) open "target"
+(sendfile) write 3000 bytes
+(sendfile) sendfile 500 bytes from offset 100
+(sendfile) source position unchanged
+(sendfile) target position is 500
+(sendfile) read back 500 bytes at offset 0
+(sendfile) sendfile from position 1000 stops at end of file
+(sendfile) source position is 3000
+(sendfile) target size is 2500
+(sendfile) read back 2000 bytes at offset 500
+(sendfile) sendfile at end of file is 0
+(sendfile) sendfile from bad fd fails
+(sendfile) end
+sendfile: exit(0)
+EOF
+pass;
@@ -0,0 +1,13 @@
+/* Spawns a child process with an argument and waits for it. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char *argv[] = { "child-args", "childarg", NULL };
+
+  msg ("wait(spawn()) = %d", wait (spawn ("child-args", argv)));
+}
@@ -0,0 +1,32 @@
+/* Reads and sets the sched.time_slice tunable through sysctl(),
+   and checks that unknown names and values out of bounds are
+   rejected without changing anything. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  size_t old, new;
+
+  CHECK (sysctl ("sched.time_slice", &old, NULL) == 0
+         && old == 4, "default time slice is 4");
+
+  new = 8;
+  CHECK (sysctl ("sched.time_slice", &old, &new) == 0
+         && old == 4, "set time slice to 8");
+  CHECK (sysctl ("sched.time_slice", &old, NULL) == 0
+         && old == 8, "time slice reads back 8");
+
+  new = 0;
+  CHECK (sysctl ("sched.time_slice", NULL, &new) == -1,
+         "time slice of 0 rejected");
+  CHECK (sysctl ("no.such_tunable", &old, NULL) == -1,
+         "unknown tunable rejected");
+
+  new = 4;
+  CHECK (sysctl ("sched.time_slice", &old, &new) == 0
+         && old == 8, "restore time slice");
+}
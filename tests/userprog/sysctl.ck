@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(sysctl) begin
+(sysctl) default time slice is 4
+(sysctl) set time slice to 8
+(sysctl) time slice reads back 8
+(sysctl) time slice of 0 rejected
+(sysctl) unknown tunable rejected
+(sysctl) restore time slice
+(sysctl) end
+sysctl: exit(0)
+EOF
+pass;
@@ -0,0 +1,71 @@
+/* Starts threads that run in the process's memory, each on a stack
+   and with a TLS block of its own, and joins them. */
+
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define THREAD_CNT 4
+#define SLICE 1000
+
+/* A thread's TLS block.  By the x86-64 convention, the first word
+   of the block that FS points to is the block's own address. */
+struct tls
+  {
+    struct tls *self;
+    int id;
+  };
+
+static char stacks[THREAD_CNT][4096] __attribute__ ((aligned (16)));
+static struct tls tls_blocks[THREAD_CNT];
+static int tids[THREAD_CNT];
+static long sums[THREAD_CNT];
+static bool tls_ok[THREAD_CNT];
+
+/* Sums the thread's slice of 1...THREAD_CNT * SLICE, then checks
+   that FS still points to the thread's own TLS block. */
+static void
+worker (void *aux)
+{
+  struct tls *tls = aux;
+  struct tls *self;
+  long sum = 0;
+  int i;
+
+  for (i = tls->id * SLICE + 1; i <= (tls->id + 1) * SLICE; i++)
+    sum += i;
+  sums[tls->id] = sum;
+
+  asm volatile ("movq %%fs:0, %0" : "=r" (self));
+  tls_ok[tls->id] = self == tls;
+}
+
+void
+test_main (void)
+{
+  long total = 0;
+  int i;
+
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      tls_blocks[i].self = &tls_blocks[i];
+      tls_blocks[i].id = i;
+      CHECK (thread_spawn (worker, &tls_blocks[i], stacks[i] + sizeof stacks[i],
+                           &tls_blocks[i], &tids[i]) > 0,
+             "spawn thread %d", i);
+    }
+
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      thread_join (&tids[i]);
+      if (!tls_ok[i])
+        fail ("thread %d did not see its own TLS block", i);
+      total += sums[i];
+    }
+  msg ("joined %d threads", THREAD_CNT);
+
+  if (total != (long) THREAD_CNT * SLICE * (THREAD_CNT * SLICE + 1) / 2)
+    fail ("sum is %ld", total);
+  msg ("sum = %ld", total);
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(thread-join) begin
+(thread-join) spawn thread 0
+(thread-join) spawn thread 1
+(thread-join) spawn thread 2
+(thread-join) spawn thread 3
+(thread-join) joined 4 threads
+(thread-join) sum = 8002000
+(thread-join) end
+thread-join: exit(0)
+EOF
+pass;
@@ -0,0 +1,16 @@
+/* Starts a child with vfork(), which runs in the parent's memory
+   until it calls exec(), and waits for it. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  pid_t pid = vfork ();
+
+  if (pid == 0)
+    exec ("child-simple");
+  msg ("wait(vfork()) = %d", wait (pid));
+}
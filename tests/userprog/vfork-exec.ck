@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(vfork-exec) begin
+(child-simple) run
+vfork-exec: exit(81)
+(vfork-exec) wait(vfork()) = 81
+(vfork-exec) end
+vfork-exec: exit(0)
+EOF
+pass;
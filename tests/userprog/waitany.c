@@ -0,0 +1,47 @@
+/* Forks two children that each exit once the parent writes to
+   their pipe, lets the second one go first, and checks that
+   waitany() reaps them in the order they exited, then fails once
+   there are none left. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Forks a child called NAME that exits with STATUS once a byte
+   arrives through a new pipe, whose write end is stored in *FD. */
+static pid_t
+spawn_child (const char *name, int status, int *fd)
+{
+  int fds[2];
+  pid_t pid;
+  char c;
+
+  CHECK (pipe (fds) == 0, "pipe for %s", name);
+  if ((pid = fork (name)) == 0)
+    {
+      close (fds[1]);
+      if (read (fds[0], &c, 1) != 1)
+        fail ("%s read nothing", name);
+      exit (status);
+    }
+  close (fds[0]);
+  *fd = fds[1];
+  return pid;
+}
+
+void
+test_main (void)
+{
+  int fd_a, fd_b, status;
+  pid_t a, b;
+
+  a = spawn_child ("child-a", 81, &fd_a);
+  b = spawn_child ("child-b", 82, &fd_b);
+
+  write (fd_b, "", 1);
+  CHECK (waitany (&status) == b && status == 82, "waitany() = child-b");
+  write (fd_a, "", 1);
+  CHECK (waitany (&status) == a && status == 81, "waitany() = child-a");
+  CHECK (wait (a) == -1, "child-a already reaped");
+  CHECK (waitany (&status) == -1, "waitany() with no children fails");
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(waitany) begin
+(waitany) pipe for child-a
+(waitany) pipe for child-b
+child-b: exit(82)
+(waitany) waitany() = child-b
+child-a: exit(81)
+(waitany) waitany() = child-a
+(waitany) child-a already reaped
+(waitany) waitany() with no children fails
+(waitany) end
+waitany: exit(0)
+EOF
+pass;
@@ -0,0 +1,36 @@
+/* Measures how fast lazily allocated anonymous pages are faulted in
+   on first touch, by writing one byte of each page of a 4 MB
+   array in the BSS, then how fast the same pages are touched once
+   they are present. */
+
+#include "tests/vm/bench/bench.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (4 * 1024 * 1024)
+#define PAGES (SIZE / PAGE_SIZE)
+
+static char buf[SIZE];
+
+void
+test_main (void)
+{
+  struct bench b;
+  size_t i;
+
+  msg ("touch %d pages", PAGES);
+  bench_start (&b, "first touch");
+  for (i = 0; i < PAGES; i++)
+    buf[i * PAGE_SIZE] = i;
+  bench_stop (&b, PAGES, 0);
+
+  msg ("touch them again");
+  bench_start (&b, "present touch");
+  for (i = 0; i < PAGES; i++)
+    buf[i * PAGE_SIZE]++;
+  bench_stop (&b, PAGES, 0);
+
+  for (i = 0; i < PAGES; i++)
+    if (buf[i * PAGE_SIZE] != (char) (i + 1))
+      fail ("page %zu holds %d", i, buf[i * PAGE_SIZE]);
+}
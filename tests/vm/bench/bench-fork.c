@@ -0,0 +1,57 @@
+/* Measures fork() and exit() of a process with a 4 MB address
+   space.  With copy-on-write, a fork costs little more than its
+   page tables, and a child that writes to one page copies only
+   that one. */
+
+#include <syscall.h>
+#include "tests/vm/bench/bench.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (4 * 1024 * 1024)
+#define PAGES (SIZE / PAGE_SIZE)
+#define FORKS 16
+
+static char buf[SIZE];
+
+/* Forks FORKS children that each write TOUCH pages and exit, one
+   after the other. */
+static void
+fork_children (const char *name, int touch)
+{
+  struct bench b;
+  int i, j;
+
+  bench_start (&b, name);
+  for (i = 0; i < FORKS; i++)
+    {
+      pid_t pid = fork ("child");
+
+      if (pid == 0)
+        {
+          for (j = 0; j < touch; j++)
+            buf[j * PAGE_SIZE] = j;
+          exit (0);
+        }
+      if (pid < 0 || wait (pid) != 0)
+        fail ("fork %d failed", i);
+    }
+  bench_stop (&b, FORKS, 0);
+}
+
+void
+test_main (void)
+{
+  size_t i;
+
+  msg ("dirty %d pages", PAGES);
+  for (i = 0; i < PAGES; i++)
+    buf[i * PAGE_SIZE] = 1;
+
+  msg ("fork children that only exit");
+  fork_children ("fork+exit", 0);
+  msg ("fork children that write one page");
+  fork_children ("fork+write 1 page+exit", 1);
+  msg ("fork children that write every page");
+  fork_children ("fork+write all pages+exit", PAGES);
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = grep (!/ cycles, /, read_text_file ("$test.output"));
+common_checks ("run", @output);
+compare_output ("run", IGNORE_EXIT_CODES => 1, \@output, [<<'EOF']);
+(bench-fork) begin
+(bench-fork) dirty 1024 pages
+(bench-fork) fork children that only exit
+(bench-fork) fork children that write one page
+(bench-fork) fork children that write every page
+(bench-fork) end
+EOF
+pass;
@@ -0,0 +1,63 @@
+/* Measures a sequential scan of a 2 MB file through mmap(), first
+   when every page has to be read in and then when they are all
+   mapped already. */
+
+#include <syscall.h>
+#include "tests/vm/bench/bench.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (2 * 1024 * 1024)
+
+static char block[PAGE_SIZE];
+
+/* Reads one word per cache line of the SIZE bytes at MAP, returning
+   their sum. */
+static uint64_t
+scan (const char *map)
+{
+  const uint64_t *p = (const uint64_t *) map;
+  uint64_t sum = 0;
+  size_t i;
+
+  for (i = 0; i < SIZE / sizeof *p; i += 8)
+    sum += p[i];
+  return sum;
+}
+
+void
+test_main (void)
+{
+  struct bench b;
+  char *map = (char *) 0x10000000;
+  uint64_t sum, expected = 0;
+  size_t i;
+  int fd;
+
+  CHECK (create ("data", 0), "create \"data\"");
+  CHECK ((fd = open ("data")) > 1, "open \"data\"");
+  for (i = 0; i < PAGE_SIZE; i += 64)
+    *(uint64_t *) &block[i] = i;
+  for (i = 0; i < SIZE / PAGE_SIZE; i++)
+    if (write (fd, block, PAGE_SIZE) != PAGE_SIZE)
+      fail ("write failed");
+  for (i = 0; i < PAGE_SIZE; i += 64)
+    expected += i;
+  expected *= SIZE / PAGE_SIZE;
+
+  CHECK (mmap (map, SIZE, 0, fd, 0) == map, "mmap \"data\"");
+  bench_start (&b, "cold scan");
+  sum = scan (map);
+  bench_stop (&b, SIZE / PAGE_SIZE, SIZE);
+  if (sum != expected)
+    fail ("scan read the wrong data");
+
+  bench_start (&b, "warm scan");
+  sum = scan (map);
+  bench_stop (&b, SIZE / PAGE_SIZE, SIZE);
+  if (sum != expected)
+    fail ("scan read the wrong data");
+
+  munmap (map);
+  close (fd);
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = grep (!/ cycles, /, read_text_file ("$test.output"));
+common_checks ("run", @output);
+compare_output ("run", IGNORE_EXIT_CODES => 1, \@output, [<<'EOF']);
+(bench-mmap) begin
+(bench-mmap) create "data"
+(bench-mmap) open "data"
+(bench-mmap) mmap "data"
+(bench-mmap) end
+EOF
+pass;
@@ -0,0 +1,33 @@
+/* Measures swapping under about 2x overcommit: writes every page of
+   an array twice the size of the user pool, which pages the early
+   ones out while the later ones are written, then reads them all
+   back in, which swaps them in again. */
+
+#include "tests/vm/bench/bench.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (10 * 1024 * 1024)
+#define PAGES (SIZE / PAGE_SIZE)
+
+static char buf[SIZE];
+
+void
+test_main (void)
+{
+  struct bench b;
+  size_t i;
+
+  msg ("write %d pages", PAGES);
+  bench_start (&b, "swap-out");
+  for (i = 0; i < PAGES; i++)
+    buf[i * PAGE_SIZE] = i;
+  bench_stop (&b, PAGES, SIZE);
+
+  msg ("read them back");
+  bench_start (&b, "swap-in");
+  for (i = 0; i < PAGES; i++)
+    if (buf[i * PAGE_SIZE] != (char) i)
+      fail ("page %zu holds %d", i, buf[i * PAGE_SIZE]);
+  bench_stop (&b, PAGES, SIZE);
+}
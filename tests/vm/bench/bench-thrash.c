@@ -0,0 +1,48 @@
+/* Measures random access to an array twice the size of the user
+   pool, where about every other touch misses memory.  Shows how
+   well eviction picks pages and how fast a page comes back. */
+
+#include <random.h>
+#include "tests/vm/bench/bench.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (10 * 1024 * 1024)
+#define PAGES (SIZE / PAGE_SIZE)
+#define TOUCHES 20000
+
+static char buf[SIZE];
+
+void
+test_main (void)
+{
+  struct bench b;
+  size_t i;
+
+  msg ("populate %d pages", PAGES);
+  for (i = 0; i < PAGES; i++)
+    buf[i * PAGE_SIZE] = i;
+
+  msg ("touch %d random pages", TOUCHES);
+  bench_start (&b, "random touch");
+  for (i = 0; i < TOUCHES; i++)
+    {
+      size_t page = random_fast_ulong () % PAGES;
+
+      if (buf[page * PAGE_SIZE] != (char) page)
+        fail ("page %zu holds %d", page, buf[page * PAGE_SIZE]);
+    }
+  bench_stop (&b, TOUCHES, 0);
+
+  /* Accesses that stay within a quarter of the array mostly hit. */
+  msg ("touch %d random pages of a quarter", TOUCHES);
+  bench_start (&b, "random touch, hot quarter");
+  for (i = 0; i < TOUCHES; i++)
+    {
+      size_t page = random_fast_ulong () % (PAGES / 4);
+
+      if (buf[page * PAGE_SIZE] != (char) page)
+        fail ("page %zu holds %d", page, buf[page * PAGE_SIZE]);
+    }
+  bench_stop (&b, TOUCHES, 0);
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = grep (!/ cycles, /, read_text_file ("$test.output"));
+common_checks ("run", @output);
+compare_output ("run", IGNORE_EXIT_CODES => 1, \@output, [<<'EOF']);
+(bench-thrash) begin
+(bench-thrash) populate 2560 pages
+(bench-thrash) touch 20000 random pages
+(bench-thrash) touch 20000 random pages of a quarter
+(bench-thrash) end
+EOF
+pass;
@@ -0,0 +1,51 @@
+#include "tests/vm/bench/bench.h"
+#include <syscall.h>
+#include "tests/lib.h"
+
+/* Returns the time stamp counter. */
+static uint64_t
+read_tsc (void)
+{
+  uint32_t lo, hi;
+
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t) hi << 32) | lo;
+}
+
+/* Starts measuring B, which is called NAME in the report. */
+void
+bench_start (struct bench *b, const char *name)
+{
+  b->name = name;
+  vmstat (NULL, &b->vm);
+  b->cycles = read_tsc ();
+}
+
+/* Stops measuring B, which carried out OPS operations on BYTES
+   bytes of memory, and reports the cycles, the rate in kB/s if
+   BYTES is nonzero, and the page faults, evictions and swap-ins it
+   took, system-wide.  Report lines all contain " cycles, ", by which
+   the .ck files leave them out. */
+void
+bench_stop (struct bench *b, unsigned long ops, uint64_t bytes)
+{
+  uint64_t cycles = read_tsc () - b->cycles;
+  struct vmstat vm;
+  struct rusage ru;
+  uint64_t kb_per_sec = 0;
+
+  vmstat (NULL, &vm);
+  if (bytes > 0 && cycles > 0 && getrusage (RUSAGE_SELF, &ru) == 0)
+    kb_per_sec = bytes / 1024 * ru.cycles_per_sec / cycles;
+  msg ("%s: %lu ops, %llu cycles, %llu cycles/op, %llu kB/s, "
+       "%llu minor faults, %llu major faults, %llu cow faults, "
+       "%llu evictions, %llu swap-ins",
+       b->name, ops, (unsigned long long) cycles,
+       (unsigned long long) (ops > 0 ? cycles / ops : 0),
+       (unsigned long long) kb_per_sec,
+       (unsigned long long) (vm.minor_faults - b->vm.minor_faults),
+       (unsigned long long) (vm.major_faults - b->vm.major_faults),
+       (unsigned long long) (vm.cow_faults - b->vm.cow_faults),
+       (unsigned long long) (vm.evictions - b->vm.evictions),
+       (unsigned long long) (vm.swap_ins - b->vm.swap_ins));
+}
@@ -0,0 +1,20 @@
+#ifndef TESTS_VM_BENCH_BENCH_H
+#define TESTS_VM_BENCH_BENCH_H
+
+#include <stdint.h>
+#include <vmstat.h>
+
+#define PAGE_SIZE 4096
+
+/* One measured run. */
+struct bench
+  {
+    const char *name;           /* What is measured. */
+    uint64_t cycles;            /* TSC at bench_start(). */
+    struct vmstat vm;           /* System-wide events at bench_start(). */
+  };
+
+void bench_start (struct bench *, const char *name);
+void bench_stop (struct bench *, unsigned long ops, uint64_t bytes);
+
+#endif /* tests/vm/bench/bench.h */
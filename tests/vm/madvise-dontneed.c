@@ -0,0 +1,52 @@
+/* Fills anonymous heap pages, drops the first two with
+   madvise(MADV_DONTNEED), and checks that those read back as
+   zeros and can be written again, while the page after them keeps
+   its contents. */
+
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 3
+
+/* Checks that the PAGE_SIZE bytes at P all equal C. */
+static void
+check_page (const char *p, char c, const char *what)
+{
+  int i;
+
+  for (i = 0; i < PAGE_SIZE; i++)
+    if (p[i] != c)
+      fail ("%s: byte %d is %d, not %d", what, i, p[i], c);
+}
+
+void
+test_main (void)
+{
+  uintptr_t brk = (uintptr_t) sbrk (0);
+  char *pages = (char *) ((brk + PAGE_SIZE - 1) & ~(uintptr_t) (PAGE_SIZE - 1));
+
+  CHECK (sbrk (pages - (char *) brk + PAGE_CNT * PAGE_SIZE) != (void *) -1,
+         "sbrk %d pages", PAGE_CNT);
+  memset (pages, 0x5a, PAGE_CNT * PAGE_SIZE);
+
+  CHECK (madvise (pages, 2 * PAGE_SIZE, MADV_DONTNEED) == 0,
+         "madvise 2 pages MADV_DONTNEED");
+  check_page (pages, 0, "first page");
+  check_page (pages + PAGE_SIZE, 0, "second page");
+  msg ("dropped pages read as zeros");
+  check_page (pages + 2 * PAGE_SIZE, 0x5a, "third page");
+  msg ("the next page is unchanged");
+
+  memset (pages, 0x17, PAGE_SIZE);
+  check_page (pages, 0x17, "rewritten page");
+  msg ("dropped page can be written again");
+
+  CHECK (madvise (pages + 1, PAGE_SIZE, MADV_DONTNEED) == -1,
+         "madvise at an unaligned address fails");
+  CHECK (madvise (pages, PAGE_SIZE, 99) == -1,
+         "madvise with bad advice fails");
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(madvise-dontneed) begin
+(madvise-dontneed) sbrk 3 pages
+(madvise-dontneed) madvise 2 pages MADV_DONTNEED
+(madvise-dontneed) dropped pages read as zeros
+(madvise-dontneed) the next page is unchanged
+(madvise-dontneed) dropped page can be written again
+(madvise-dontneed) madvise at an unaligned address fails
+(madvise-dontneed) madvise with bad advice fails
+(madvise-dontneed) end
+EOF
+pass;
@@ -0,0 +1,93 @@
+/* Allocates blocks of many sizes with malloc(), checks that they
+   keep their contents as others are freed and resized, and checks
+   that freeing a large block at the top of the heap gives its
+   pages back to the kernel. */
+
+#include <malloc.h>
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define BLOCK_CNT 512
+
+static char *blocks[BLOCK_CNT];
+static size_t sizes[BLOCK_CNT];
+
+/* Fills block I with its own byte. */
+static void
+fill (int i)
+{
+  memset (blocks[i], i, sizes[i]);
+}
+
+/* Checks that block I still holds its own byte. */
+static void
+verify (int i)
+{
+  for (size_t j = 0; j < sizes[i]; j++)
+    if (blocks[i][j] != (char) i)
+      fail ("block %d of %zu bytes corrupted at byte %zu", i, sizes[i], j);
+}
+
+void
+test_main (void)
+{
+  uint8_t *brk;
+  char *big, *zeros;
+  int i;
+
+  for (i = 0; i < BLOCK_CNT; i++)
+    {
+      sizes[i] = (i * 7919) % 3000 + 1;
+      blocks[i] = malloc (sizes[i]);
+      if (blocks[i] == NULL)
+        fail ("malloc of %zu bytes failed", sizes[i]);
+      if ((uintptr_t) blocks[i] % 16 != 0)
+        fail ("block %d at %p is not aligned", i, blocks[i]);
+      fill (i);
+    }
+  msg ("allocate %d blocks", BLOCK_CNT);
+  for (i = 0; i < BLOCK_CNT; i++)
+    verify (i);
+
+  for (i = 1; i < BLOCK_CNT; i += 2)
+    free (blocks[i]);
+  for (i = 0; i < BLOCK_CNT; i += 2)
+    {
+      blocks[i] = realloc (blocks[i], sizes[i] * 2);
+      if (blocks[i] == NULL)
+        fail ("realloc to %zu bytes failed", sizes[i] * 2);
+      verify (i);
+      sizes[i] *= 2;
+      fill (i);
+    }
+  for (i = 1; i < BLOCK_CNT; i += 2)
+    {
+      blocks[i] = malloc (sizes[i]);
+      if (blocks[i] == NULL)
+        fail ("malloc of %zu bytes failed", sizes[i]);
+      fill (i);
+    }
+  msg ("free and resize blocks");
+  for (i = 0; i < BLOCK_CNT; i++)
+    verify (i);
+
+  zeros = calloc (300, 16);
+  CHECK (zeros != NULL, "calloc");
+  for (i = 0; i < 300 * 16; i++)
+    if (zeros[i] != 0)
+      fail ("calloc'd byte %d is %d", i, zeros[i]);
+  free (zeros);
+
+  brk = sbrk (0);
+  big = malloc (1 << 20);
+  CHECK (big != NULL, "malloc 1 MB");
+  memset (big, 'x', 1 << 20);
+  free (big);
+  CHECK ((uint8_t *) sbrk (0) <= brk, "free gives the pages back");
+
+  for (i = 0; i < BLOCK_CNT; i++)
+    free (blocks[i]);
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(malloc-heap) begin
+(malloc-heap) allocate 512 blocks
+(malloc-heap) free and resize blocks
+(malloc-heap) calloc
+(malloc-heap) malloc 1 MB
+(malloc-heap) free gives the pages back
+(malloc-heap) end
+EOF
+pass;
@@ -0,0 +1,70 @@
+/* Checks that mlock() fails on a range with no pages, then locks a
+   few pages, writes more memory than fits in RAM so that others are
+   evicted, and checks that the locked pages stayed in memory, taking
+   no faults when read, with their contents intact. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define LOCKED_CNT 4
+#define BIG_SIZE (20 << 20)
+
+static char locked[LOCKED_CNT * PAGE_SIZE] __attribute__ ((aligned (PAGE_SIZE)));
+static char big[BIG_SIZE];
+
+/* Reads one byte of each of the CNT pages from START. */
+static void
+touch_pages (const char *start, int cnt)
+{
+  volatile char c;
+  int i;
+
+  for (i = 0; i < cnt; i++)
+    c = start[i * PAGE_SIZE];
+  (void) c;
+}
+
+void
+test_main (void)
+{
+  struct vmstat before, after, sys_before, sys_after;
+  size_t i;
+
+  CHECK (mlock ((void *) 0x30000000, PAGE_SIZE) == -1,
+         "mlock of an unmapped range fails");
+
+  memset (locked, 0x3c, sizeof locked);
+  CHECK (mlock (locked, sizeof locked) == 0, "mlock %d pages", LOCKED_CNT);
+
+  vmstat (NULL, &sys_before);
+  for (i = 0; i < BIG_SIZE; i += PAGE_SIZE)
+    big[i] = i / PAGE_SIZE;
+  for (i = 0; i < BIG_SIZE; i += PAGE_SIZE)
+    if (big[i] != (char) (i / PAGE_SIZE))
+      fail ("page %zu of the big array is corrupted", i / PAGE_SIZE);
+  vmstat (NULL, &sys_after);
+  CHECK (sys_after.evictions > sys_before.evictions,
+         "writing %d MB evicted pages", BIG_SIZE >> 20);
+
+  /* Bring in the code and stack the measured loop needs. */
+  touch_pages ((char *) &before, 1);
+  vmstat (&before, NULL);
+  touch_pages (locked, LOCKED_CNT);
+  vmstat (&after, NULL);
+  if (after.minor_faults != before.minor_faults
+      || after.major_faults != before.major_faults)
+    fail ("reading the locked pages took %llu faults",
+          after.minor_faults + after.major_faults
+          - before.minor_faults - before.major_faults);
+  msg ("locked pages stayed in memory");
+
+  for (i = 0; i < sizeof locked; i++)
+    if (locked[i] != 0x3c)
+      fail ("byte %zu of the locked pages changed", i);
+  msg ("locked pages kept their contents");
+
+  CHECK (munlock (locked, sizeof locked) == 0, "munlock %d pages", LOCKED_CNT);
+}
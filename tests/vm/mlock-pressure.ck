@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mlock-pressure) begin
+(mlock-pressure) mlock of an unmapped range fails
+(mlock-pressure) mlock 4 pages
+(mlock-pressure) writing 20 MB evicted pages
+(mlock-pressure) locked pages stayed in memory
+(mlock-pressure) locked pages kept their contents
+(mlock-pressure) munlock 4 pages
+(mlock-pressure) end
+EOF
+pass;
@@ -0,0 +1,19 @@
+/* Verifies that mapping into the part of the stack segment that
+   the stack has not grown into yet is disallowed, too. */
+
+#include <stdint.h>
+#include <round.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int handle;
+  uintptr_t handle_page = ROUND_DOWN ((uintptr_t) &handle, 4096);
+  
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (mmap ((void *) (handle_page - 64 * 4096), 4096, 0, handle, 0)
+         == MAP_FAILED, "try to mmap below the stack");
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-over-stk2) begin
+(mmap-over-stk2) open "sample.txt"
+(mmap-over-stk2) try to mmap below the stack
+(mmap-over-stk2) end
+EOF
+pass;
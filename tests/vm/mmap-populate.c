@@ -0,0 +1,56 @@
+/* Maps part of a file with MAP_POPULATE and checks that reading
+   the whole mapping takes no page faults, since it was read in
+   when it was made, and that it holds the right bytes of the
+   file. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/vm/large.inc"
+
+#define MAP_ADDR ((char *) 0x10000000)
+#define MAP_OFS 0x2000
+#define PAGE_CNT 16
+
+/* Reads one byte of each of the CNT pages from START. */
+static void
+touch_pages (const char *start, int cnt)
+{
+  volatile char c;
+  int i;
+
+  for (i = 0; i < cnt; i++)
+    c = start[i * 4096];
+  (void) c;
+}
+
+void
+test_main (void)
+{
+  struct vmstat before, after;
+  int handle;
+
+  CHECK ((handle = open ("large.txt")) > 1, "open \"large.txt\"");
+  CHECK (mmap (MAP_ADDR, PAGE_CNT * 4096, MAP_POPULATE, handle, MAP_OFS)
+         == MAP_ADDR, "mmap %d pages with MAP_POPULATE", PAGE_CNT);
+
+  /* Bring in the code and stack the measured loop needs. */
+  touch_pages ((char *) &before, 1);
+  vmstat (&before, NULL);
+  touch_pages (MAP_ADDR, PAGE_CNT);
+  vmstat (&after, NULL);
+  if (after.minor_faults != before.minor_faults
+      || after.major_faults != before.major_faults)
+    fail ("reading the mapping took %llu faults",
+          after.minor_faults + after.major_faults
+          - before.minor_faults - before.major_faults);
+  msg ("reading the mapping took no faults");
+
+  if (memcmp (MAP_ADDR, &large[MAP_OFS], PAGE_CNT * 4096))
+    fail ("mapping does not match the file");
+  msg ("mapping matches the file");
+
+  munmap (MAP_ADDR);
+  close (handle);
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-populate) begin
+(mmap-populate) open "large.txt"
+(mmap-populate) mmap 16 pages with MAP_POPULATE
+(mmap-populate) reading the mapping took no faults
+(mmap-populate) mapping matches the file
+(mmap-populate) end
+EOF
+pass;
@@ -0,0 +1,40 @@
+/* Maps a named shared memory segment and forks a child, which
+   writes to it through the mapping it inherits and through a second
+   mapping of the same name.  The parent must see both writes. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (2 * 4096)
+
+void
+test_main (void)
+{
+  char *shared = (char *) 0x10000000;
+  char *alias = (char *) 0x20000000;
+  pid_t child;
+
+  CHECK (shm_map ("shm-fork", shared, SIZE, 1) == shared, "map segment");
+  shared[0] = 'p';
+
+  child = fork ("child");
+  if (child == 0)
+    {
+      if (shm_map ("shm-fork", alias, SIZE, 1) != alias)
+        fail ("map segment again in child");
+      if (alias[0] != 'p')
+        fail ("child reads '%c' instead of 'p'", alias[0]);
+      alias[1] = 'c';
+      strlcpy (shared + 4096, "written by child", 32);
+      exit (0);
+    }
+  CHECK (wait (child) == 0, "wait for child");
+  if (shared[1] != 'c' || strcmp (shared + 4096, "written by child"))
+    fail ("child's writes are not visible");
+  msg ("child's writes are visible");
+  CHECK (shm_unlink ("shm-fork"), "unlink segment");
+  CHECK (!shm_unlink ("shm-fork"), "unlink it again (must fail)");
+  munmap (shared);
+}
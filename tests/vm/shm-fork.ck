@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(shm-fork) begin
+(shm-fork) map segment
+(shm-fork) wait for child
+(shm-fork) child's writes are visible
+(shm-fork) unlink segment
+(shm-fork) unlink it again (must fail)
+(shm-fork) end
+EOF
+pass;
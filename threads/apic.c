@@ -0,0 +1,281 @@
+/* apic.c: Local APIC and I/O APIC. */
+
+#include "threads/apic.h"
+#include <debug.h>
+#include "devices/timer.h"
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/mmu.h"
+#include "threads/pte.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
+
+/* Advanced Programmable Interrupt Controllers.
+ *
+ * Each CPU has a local APIC, reached through memory-mapped
+ * registers at the same physical address on every CPU, that takes
+ * interrupts for it, times one-shot and periodic interrupts of its
+ * own and sends interrupts to other CPUs.  Devices are wired to the
+ * I/O APIC, which forwards their interrupts as messages to a local
+ * APIC.  The end of an interrupt is a single store to the local
+ * APIC instead of one or two port writes to the PICs.
+ *
+ * The I/O APIC is programmed to give the ISA IRQs the vectors the
+ * PICs would, 0x20 plus the IRQ, so device drivers do not change.
+ * If the CPU has no APIC, or with -noapic, the PICs stay in charge.
+ *
+ * The I/O APIC is assumed to be at its usual address, with the PIT
+ * on input 2 and every other ISA IRQ on the input of its number,
+ * which is how PCs, QEMU and Bochs wire it; the ACPI tables that
+ * would say otherwise are not read. */
+#define IOAPIC_PHYS 0xfec00000
+
+/* Local APIC registers, as offsets from its base. */
+#define LAPIC_ID 0x020              /* ID, in bits 24...31. */
+#define LAPIC_TPR 0x080             /* Task priority. */
+#define LAPIC_EOI 0x0b0             /* End of interrupt. */
+#define LAPIC_SVR 0x0f0             /* Spurious vector and enable. */
+#define LAPIC_ICR_LO 0x300          /* Interrupt command. */
+#define LAPIC_ICR_HI 0x310          /* Destination of the command. */
+#define LAPIC_LVT_TIMER 0x320       /* Timer interrupt. */
+#define LAPIC_LVT_LINT0 0x350       /* Local interrupt pin 0. */
+#define LAPIC_LVT_ERROR 0x370       /* Error interrupt. */
+#define LAPIC_TIMER_INIT 0x380      /* Timer initial count. */
+#define LAPIC_TIMER_CUR 0x390       /* Timer current count. */
+#define LAPIC_TIMER_DIV 0x3e0       /* Timer divide configuration. */
+
+#define LAPIC_SVR_ENABLE 0x100
+#define LAPIC_LVT_MASKED 0x10000
+#define LAPIC_ICR_NMI 0x400         /* Delivery mode: NMI. */
+#define LAPIC_ICR_INIT 0x500        /* Delivery mode: INIT. */
+#define LAPIC_ICR_STARTUP 0x600     /* Delivery mode: STARTUP. */
+#define LAPIC_ICR_PENDING 0x1000    /* Delivery status: not yet accepted. */
+#define LAPIC_ICR_ASSERT 0x4000     /* Level: assert. */
+#define LAPIC_ICR_OTHERS 0xc0000    /* Shorthand: all but ourselves. */
+#define LAPIC_TIMER_DIV16 0x3
+
+/* IA32_APIC_BASE MSR and its global enable bit. */
+#define MSR_APIC_BASE 0x1b
+#define MSR_APIC_BASE_ENABLE 0x800
+
+/* I/O APIC registers, reached by storing an index to IOREGSEL and
+   accessing IOWIN. */
+#define IOAPIC_IOREGSEL 0x00
+#define IOAPIC_IOWIN 0x10
+#define IOAPIC_VER 0x01             /* Version; inputs - 1 in bits 16...23. */
+#define IOAPIC_REDTBL 0x10          /* 2 registers per input. */
+
+bool apic_disabled;
+
+static volatile uint32_t *lapic;    /* Local APIC registers, if enabled. */
+static volatile uint32_t *ioapic;   /* I/O APIC registers. */
+
+static intr_handler_func spurious_interrupt;
+
+/* Maps the page of registers at physical address PA into base_pml4,
+   uncached, and returns its address.  Physical memory is mapped only
+   up to the end of RAM, far below the APICs. */
+static volatile uint32_t *
+map_regs (uint64_t pa) {
+	uint64_t va = (uint64_t) ptov (pa);
+	uint64_t *pte = pml4e_walk (base_pml4, va, 1);
+
+	if (pte == NULL)
+		PANIC ("apic_init: out of memory");
+	*pte = pa | PTE_P | PTE_W | PTE_G | PTE_PCD | PTE_PWT;
+	invlpg (va);
+	return (volatile uint32_t *) va;
+}
+
+static uint32_t
+lapic_read (unsigned reg) {
+	return lapic[reg / 4];
+}
+
+static void
+lapic_write (unsigned reg, uint32_t value) {
+	lapic[reg / 4] = value;
+}
+
+static uint32_t
+ioapic_read (unsigned reg) {
+	ioapic[IOAPIC_IOREGSEL / 4] = reg;
+	return ioapic[IOAPIC_IOWIN / 4];
+}
+
+static void
+ioapic_write (unsigned reg, uint32_t value) {
+	ioapic[IOAPIC_IOREGSEL / 4] = reg;
+	ioapic[IOAPIC_IOWIN / 4] = value;
+}
+
+/* Sets I/O APIC input PIN to deliver VEC, edge triggered and active
+   high like an ISA IRQ, to the local APIC with ID DEST, or masks it
+   if VEC is 0. */
+static void
+ioapic_route (int pin, uint8_t vec, int dest) {
+	ioapic_write (IOAPIC_REDTBL + 2 * pin + 1, (uint32_t) dest << 24);
+	ioapic_write (IOAPIC_REDTBL + 2 * pin, vec != 0 ? vec : LAPIC_LVT_MASKED);
+}
+
+/* Sets up the local APIC of this CPU, whose registers are mapped
+   at LAPIC, records its ID in this_cpu() and returns it. */
+static int
+lapic_enable (void) {
+	/* Take every interrupt, but nothing from the PICs' old virtual
+	   wire, and time nothing yet. */
+	lapic_write (LAPIC_TPR, 0);
+	lapic_write (LAPIC_LVT_LINT0, LAPIC_LVT_MASKED);
+	lapic_write (LAPIC_LVT_ERROR, LAPIC_LVT_MASKED);
+	lapic_write (LAPIC_LVT_TIMER, LAPIC_LVT_MASKED | APIC_VEC_TIMER);
+	lapic_write (LAPIC_TIMER_DIV, LAPIC_TIMER_DIV16);
+	lapic_write (LAPIC_TIMER_INIT, 0);
+	lapic_write (LAPIC_SVR, LAPIC_SVR_ENABLE | APIC_VEC_SPURIOUS);
+	lapic_write (LAPIC_EOI, 0);
+
+	return this_cpu ()->apic_id = lapic_read (LAPIC_ID) >> 24;
+}
+
+/* Enables the local APIC of this CPU and routes the ISA IRQs to it
+   through the I/O APIC.  Called by intr_init(), with interrupts off.
+   Returns false, changing nothing, if the PICs are to be used
+   instead, in which case every other function here must not be
+   called. */
+bool
+apic_init (void) {
+	uint32_t eax, ebx, ecx, edx;
+	uint64_t base;
+	int id, pins;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	cpuid (1, &eax, &ebx, &ecx, &edx);
+	if (apic_disabled || !(edx & (1 << 9)))    /* CPUID.1:EDX.APIC */
+		return false;
+
+	base = read_msr (MSR_APIC_BASE);
+	if (!(base & MSR_APIC_BASE_ENABLE))
+		write_msr (MSR_APIC_BASE, base | MSR_APIC_BASE_ENABLE);
+	lapic = map_regs (base & 0xffffff000);
+	ioapic = map_regs (IOAPIC_PHYS);
+	id = lapic_enable ();
+
+	/* IRQ 2 is the PICs' cascade, which has no input of its own. */
+	pins = ((ioapic_read (IOAPIC_VER) >> 16) & 0xff) + 1;
+	for (int pin = 0; pin < pins; pin++)
+		ioapic_route (pin, 0, id);
+	for (int irq = 0; irq < 16 && irq < pins; irq++)
+		if (irq != 2)
+			ioapic_route (irq == 0 ? 2 : irq, 0x20 + irq, id);
+
+	intr_register_int (APIC_VEC_SPURIOUS, 0, INTR_OFF, spurious_interrupt,
+			"APIC Spurious");
+	intr_register_ext (APIC_VEC_TLB, tlb_shootdown_interrupt,
+			"TLB Shootdown");
+	return true;
+}
+
+/* Enables the local APIC of an application processor, which is at
+   the same address as the boot CPU's, leaving the I/O APIC to send
+   every device interrupt to the boot CPU.  Called by smp.c with
+   interrupts off, and only if apic_init() returned true. */
+void
+apic_init_ap (void) {
+	uint64_t base = read_msr (MSR_APIC_BASE);
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (apic_enabled ());
+
+	if (!(base & MSR_APIC_BASE_ENABLE))
+		write_msr (MSR_APIC_BASE, base | MSR_APIC_BASE_ENABLE);
+	lapic_enable ();
+}
+
+/* Returns true if interrupts go through the APICs. */
+bool
+apic_enabled (void) {
+	return lapic != NULL;
+}
+
+/* Acknowledges the external interrupt being handled. */
+void
+apic_eoi (void) {
+	lapic_write (LAPIC_EOI, 0);
+}
+
+/* Starts this CPU's local APIC timer to interrupt once, at vector
+   APIC_VEC_TIMER, after COUNT counts of its clock divided by 16,
+   or stops it if COUNT is 0. */
+void
+apic_timer_start (uint32_t count) {
+	lapic_write (LAPIC_LVT_TIMER, APIC_VEC_TIMER);
+	lapic_write (LAPIC_TIMER_INIT, count);
+}
+
+/* Returns the counts the local APIC timer has left to run. */
+uint32_t
+apic_timer_read (void) {
+	return lapic_read (LAPIC_TIMER_CUR);
+}
+
+/* Sends the interrupt command LO to the local APICs DEST selects,
+   after the previous command has been accepted. */
+static void
+send_icr (uint32_t dest, uint32_t lo) {
+	enum intr_level old_level = intr_disable ();
+
+	while (lapic_read (LAPIC_ICR_LO) & LAPIC_ICR_PENDING)
+		barrier ();
+	lapic_write (LAPIC_ICR_HI, dest);
+	lapic_write (LAPIC_ICR_LO, lo);
+	intr_set_level (old_level);
+}
+
+/* Interrupts CPU, which is an index in cpus[], at vector VEC. */
+void
+apic_send_ipi (int cpu, uint8_t vec) {
+	ASSERT (cpu >= 0 && cpu < NCPU);
+	send_icr ((uint32_t) cpus[cpu].apic_id << 24, vec);
+}
+
+/* Interrupts every CPU but this one at vector VEC. */
+void
+apic_send_ipi_others (uint8_t vec) {
+	send_icr (0, LAPIC_ICR_OTHERS | vec);
+}
+
+/* Sends a non-maskable interrupt to every CPU but this one.  It is
+   taken even with interrupts off, at vector 2. */
+void
+apic_send_nmi_others (void) {
+	send_icr (0, LAPIC_ICR_OTHERS | LAPIC_ICR_NMI);
+}
+
+/* Starts the application processor whose local APIC has ID APIC_ID
+   running in real mode at physical address PA, which must be page
+   aligned and below 1 MB: an INIT IPI resets it, and it starts at
+   the page that a STARTUP IPI names.  The second STARTUP is ignored
+   by a processor that took the first, as the MP specification
+   expects.  Sleeps between the IPIs, so interrupts must be on. */
+void
+apic_start_ap (int apic_id, uint64_t pa) {
+	uint32_t dest = (uint32_t) apic_id << 24;
+
+	ASSERT (pa % PGSIZE == 0 && pa < 0x100000);
+	ASSERT (intr_get_level () == INTR_ON);
+
+	send_icr (dest, LAPIC_ICR_INIT | LAPIC_ICR_ASSERT);
+	timer_msleep (10);
+	for (int i = 0; i < 2; i++) {
+		send_icr (dest, LAPIC_ICR_STARTUP | (pa >> 12));
+		timer_usleep (200);
+	}
+}
+
+/* The local APIC raises its spurious vector when an interrupt it was
+   about to deliver went away.  That one needs no end of interrupt. */
+static void
+spurious_interrupt (struct intr_frame *f UNUSED) {
+}
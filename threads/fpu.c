@@ -0,0 +1,425 @@
+/* fpu.c: Lazy switching of the FPU, SSE and AVX registers. */
+
+#include "threads/fpu.h"
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
+
+/* Floating-point registers.
+ *
+ * The x87, SSE and AVX registers hold the state of at most one
+ * thread per CPU, its FPU owner.  A context switch saves none of
+ * them; it only sets CR0.TS unless the next thread is the owner, so
+ * that the first FPU or SSE instruction another thread executes
+ * traps with #NM.  Only then is the owner's state saved to its save
+ * area and the new thread's loaded from its own.  A thread that
+ * never touches these registers has no save area and costs a CR0
+ * write per switch at most, and a thread that is the only one using
+ * them never has its state saved at all.
+ *
+ * Save areas are in the XSAVE format, covering x87, SSE and AVX,
+ * if the CPU has XSAVE, and in the 512-byte FXSAVE format, with x87
+ * and SSE only, otherwise.  A thread's first use loads the state the
+ * registers have right after FNINIT, captured by fpu_init().
+ *
+ * Once other CPUs run, a thread's registers may be needed on a CPU
+ * other than the one that holds them, so each CPU saves its owner's
+ * state when it switches away from it and owns nothing until the
+ * next trap.  Only a thread that runs uninterrupted by others keeps
+ * the state in its registers then.
+ *
+ * The kernel is compiled without SSE, so it never uses these
+ * registers behind our back.  Code between kernel_fpu_begin() and
+ * kernel_fpu_end() may use them: the owner's state is saved first
+ * and the owner disowned, so it reloads on its next use, and
+ * interrupts stay off in between, so that neither a switch nor
+ * another section can intervene. */
+
+#define CR0_MP (1 << 1)             /* Monitor coprocessor: WAIT traps too. */
+#define CR0_EM (1 << 2)             /* Emulate: every FPU instruction traps. */
+#define CR0_TS (1 << 3)             /* Task switched. */
+
+#define CR4_OSFXSR (1 << 9)         /* FXSAVE and SSE enabled. */
+#define CR4_OSXMMEXCPT (1 << 10)    /* SSE exceptions raise #XF. */
+#define CR4_OSXSAVE (1 << 18)       /* XSAVE and XCR0 enabled. */
+
+/* XCR0 state components. */
+#define XFEATURE_X87 (1 << 0)
+#define XFEATURE_SSE (1 << 1)
+#define XFEATURE_AVX (1 << 2)
+
+#define MXCSR_DEFAULT 0x1f80        /* All SSE exceptions masked. */
+#define FPU_ALIGN 64                /* Alignment of a save area. */
+#define FPU_STATE_MAX 1024          /* Largest save area we support. */
+
+static bool fpu_ready;              /* fpu_init() has run? */
+static bool fpu_eager;              /* Save on every switch away? */
+static bool use_xsave;              /* Save with XSAVE, not FXSAVE? */
+static uint64_t xfeatures;          /* Enabled XCR0 components. */
+static size_t state_size;           /* Bytes in a save area. */
+
+/* Registers right after FNINIT, that every thread starts from. */
+static uint8_t initial_state[FPU_STATE_MAX]
+	__attribute__ ((aligned (FPU_ALIGN)));
+
+/* Statistics. */
+static long long trap_cnt;          /* #NM traps taken. */
+static long long save_cnt;          /* States saved. */
+static long long kernel_cnt;        /* Kernel sections. */
+
+static intr_handler_func fpu_trap;
+
+static inline void
+clts (void) {
+	asm volatile ("clts" : : : "memory");
+}
+
+static inline void
+stts (void) {
+	lcr0 (rcr0 () | CR0_TS);
+}
+
+/* Returns T's save area, aligned for XSAVE. */
+static void *
+state_of (struct thread *t) {
+	return (void *) (((uintptr_t) t->fpu_area + FPU_ALIGN - 1)
+			& ~(uintptr_t) (FPU_ALIGN - 1));
+}
+
+/* Saves the registers to AREA.  CR0.TS must be clear. */
+static void
+save_state (void *area) {
+	if (use_xsave)
+		asm volatile ("xsave64 (%0)"
+				: : "r" (area), "a" ((uint32_t) xfeatures),
+				  "d" ((uint32_t) (xfeatures >> 32))
+				: "memory");
+	else
+		asm volatile ("fxsave64 (%0)" : : "r" (area) : "memory");
+	save_cnt++;
+}
+
+/* Loads the registers from AREA.  CR0.TS must be clear. */
+static void
+load_state (const void *area) {
+	if (use_xsave)
+		asm volatile ("xrstor64 (%0)"
+				: : "r" (area), "a" ((uint32_t) xfeatures),
+				  "d" ((uint32_t) (xfeatures >> 32))
+				: "memory");
+	else
+		asm volatile ("fxrstor64 (%0)" : : "r" (area) : "memory");
+}
+
+/* Gives T a save area holding the initial state.  Returns false if
+   memory is short. */
+static bool
+alloc_state (struct thread *t) {
+	ASSERT (t->fpu_area == NULL);
+
+	t->fpu_area = malloc (state_size + FPU_ALIGN - 1);
+	if (t->fpu_area == NULL)
+		return false;
+	memcpy (state_of (t), initial_state, state_size);
+	return true;
+}
+
+/* Sets CR4 to CR4 and turns on this CPU's FPU, with the XCR0
+   components in xfeatures if there is XSAVE. */
+static void
+fpu_enable (uint64_t cr4) {
+	lcr4 (cr4);
+	lcr0 ((rcr0 () & ~(CR0_EM | CR0_TS)) | CR0_MP);
+	if (use_xsave)
+		asm volatile ("xsetbv" : : "c" (0), "a" ((uint32_t) xfeatures),
+				"d" ((uint32_t) (xfeatures >> 32)));
+}
+
+/* Enables the FPU and SSE, and AVX if there is XSAVE, and takes
+   #NM.  Called by main() after intr_init(), with interrupts off. */
+void
+fpu_init (void) {
+	static const uint32_t mxcsr = MXCSR_DEFAULT;
+	uint32_t eax, ebx, ecx, edx;
+	uint64_t cr4 = rcr4 () | CR4_OSFXSR | CR4_OSXMMEXCPT;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	cpuid (1, &eax, &ebx, &ecx, &edx);
+	if (!(edx & (1 << 24)))                     /* CPUID.1:EDX.FXSR */
+		PANIC ("fpu_init: no FXSAVE");
+	use_xsave = (ecx & (1 << 26)) != 0;         /* CPUID.1:ECX.XSAVE */
+	state_size = 512;
+	if (use_xsave) {
+		uint32_t supported;
+
+		cpuid (0xd, &supported, &ebx, &ecx, &edx);
+		xfeatures = supported & (XFEATURE_X87 | XFEATURE_SSE | XFEATURE_AVX);
+		cr4 |= CR4_OSXSAVE;
+	}
+	fpu_enable (cr4);
+
+	if (use_xsave) {
+		/* XSAVE's size depends on the components XCR0 enables. */
+		cpuid (0xd, &eax, &ebx, &ecx, &edx);
+		state_size = ebx;
+	}
+	if (state_size > FPU_STATE_MAX)
+		PANIC ("fpu_init: %zu-byte save area", state_size);
+
+	asm volatile ("fninit");
+	asm volatile ("ldmxcsr %0" : : "m" (mxcsr));
+	save_state (initial_state);
+	save_cnt = 0;
+	stts ();
+
+	intr_register_int (7, 0, INTR_ON, fpu_trap,
+			"#NM Device Not Available Exception");
+	fpu_ready = true;
+}
+
+/* Turns on the FPU of an application processor as fpu_init() did
+   on the boot CPU.  Called by smp.c with interrupts off. */
+void
+fpu_init_ap (void) {
+	uint64_t cr4 = rcr4 () | CR4_OSFXSR | CR4_OSXMMEXCPT;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (!fpu_ready)
+		return;
+	fpu_enable (use_xsave ? cr4 | CR4_OSXSAVE : cr4);
+	asm volatile ("fninit");
+	stts ();
+}
+
+/* Called by smp_init() before it starts the other CPUs: from now
+   on a CPU never keeps a thread's state after switching away from
+   it.  The boot CPU lets go of what it kept so far, unless that is
+   the running thread's, which it saves on the next switch. */
+void
+fpu_init_smp (void) {
+	enum intr_level old_level = intr_disable ();
+	struct cpu *c = this_cpu ();
+
+	fpu_eager = true;
+	if (c->fpu_owner != NULL && c->fpu_owner != thread_current ()) {
+		clts ();
+		save_state (state_of (c->fpu_owner));
+		c->fpu_owner = NULL;
+		stts ();
+	}
+	intr_set_level (old_level);
+}
+
+/* Called by thread_launch() before switching to NEXT, with
+   interrupts off.  Lets NEXT use the registers without a trap only
+   if they still hold its state. */
+void
+fpu_switch (struct thread *next) {
+	struct cpu *c = this_cpu ();
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (!c->fpu_kernel);
+
+	if (!fpu_ready)
+		return;
+	if (next == c->fpu_owner)
+		clts ();
+	else {
+		if (fpu_eager && c->fpu_owner != NULL) {
+			/* The owner is the thread switched away from. */
+			clts ();
+			save_state (state_of (c->fpu_owner));
+			c->fpu_owner = NULL;
+		}
+		stts ();
+	}
+}
+
+/* #NM handler: the running thread used the FPU or SSE while
+   another thread, or nobody, owned the registers. */
+static void
+fpu_trap (struct intr_frame *f) {
+	struct thread *t = thread_current ();
+	struct cpu *c;
+	enum intr_level old_level;
+
+	if ((f->cs & 3) != 3) {
+		intr_dump_frame (f);
+		PANIC ("Kernel bug - FPU used outside kernel_fpu_begin()");
+	}
+
+	/* Allocating may sleep, so do it before turning interrupts off. */
+	if (t->fpu_area == NULL && !alloc_state (t)) {
+		printf ("%s: out of memory for FPU state\n", thread_name ());
+		thread_exit ();
+	}
+
+	old_level = intr_disable ();
+	c = this_cpu ();
+	trap_cnt++;
+	clts ();
+	if (c->fpu_owner != t) {
+		if (c->fpu_owner != NULL)
+			save_state (state_of (c->fpu_owner));
+		load_state (state_of (t));
+		c->fpu_owner = t;
+	}
+	intr_set_level (old_level);
+}
+
+/* Gives CHILD, which is being forked from PARENT, a copy of
+   PARENT's FPU state, if PARENT has any.  Returns false if memory is
+   short. */
+bool
+fpu_fork (struct thread *child, struct thread *parent) {
+	enum intr_level old_level;
+	struct cpu *c;
+
+	ASSERT (child->fpu_area == NULL);
+
+	if (parent->fpu_area == NULL)
+		return true;
+	if (!alloc_state (child))
+		return false;
+
+	/* The registers may hold a newer state than the save area. */
+	old_level = intr_disable ();
+	c = this_cpu ();
+	if (c->fpu_owner == parent) {
+		clts ();
+		save_state (state_of (parent));
+		if (thread_current () != parent)
+			stts ();
+	}
+	memcpy (state_of (child), state_of (parent), state_size);
+	intr_set_level (old_level);
+	return true;
+}
+
+/* Throws away T's FPU state, if any, so that its next use starts
+   from the initial state.  Called when T exits or executes a new
+   program. */
+void
+fpu_release (struct thread *t) {
+	enum intr_level old_level = intr_disable ();
+	struct cpu *c = this_cpu ();
+	void *area = t->fpu_area;
+
+	if (c->fpu_owner == t) {
+		c->fpu_owner = NULL;
+		stts ();
+	}
+	t->fpu_area = NULL;
+	intr_set_level (old_level);
+	free (area);
+}
+
+/* Starts a section of kernel code that may use the SSE registers,
+   which must end with kernel_fpu_end() before anything that might
+   sleep.  Turns interrupts off; sections do not nest. */
+void
+kernel_fpu_begin (void) {
+	enum intr_level old_level = intr_disable ();
+	struct cpu *c = this_cpu ();
+
+	ASSERT (fpu_ready);
+	ASSERT (!c->fpu_kernel);
+
+	c->fpu_kernel = true;
+	c->fpu_level = old_level;
+	kernel_cnt++;
+	clts ();
+	if (c->fpu_owner != NULL) {
+		save_state (state_of (c->fpu_owner));
+		c->fpu_owner = NULL;
+	}
+}
+
+/* Ends the section kernel_fpu_begin() started.  Whoever uses the
+   registers next traps and reloads its state. */
+void
+kernel_fpu_end (void) {
+	struct cpu *c = this_cpu ();
+
+	ASSERT (c->fpu_kernel);
+
+	stts ();
+	c->fpu_kernel = false;
+	intr_set_level (c->fpu_level);
+}
+
+/* Copies the page at SRC to DST, 64 bytes at a time.  Both must be
+   page-aligned. */
+void
+fpu_copy_page (void *dst, const void *src) {
+	unsigned cnt = PGSIZE / 64;
+
+	ASSERT (pg_ofs (dst) == 0 && pg_ofs (src) == 0);
+
+	if (!fpu_ready) {
+		memcpy (dst, src, PGSIZE);
+		return;
+	}
+	kernel_fpu_begin ();
+	asm volatile ("1:\n\t"
+			"movdqa (%1), %%xmm0\n\t"
+			"movdqa 16(%1), %%xmm1\n\t"
+			"movdqa 32(%1), %%xmm2\n\t"
+			"movdqa 48(%1), %%xmm3\n\t"
+			"movdqa %%xmm0, (%0)\n\t"
+			"movdqa %%xmm1, 16(%0)\n\t"
+			"movdqa %%xmm2, 32(%0)\n\t"
+			"movdqa %%xmm3, 48(%0)\n\t"
+			"addq $64, %0\n\t"
+			"addq $64, %1\n\t"
+			"decl %2\n\t"
+			"jnz 1b"
+			: "+r" (dst), "+r" (src), "+r" (cnt) : : "memory");
+	kernel_fpu_end ();
+}
+
+/* Zeros the page at DST, which must be page-aligned.  The stores
+   bypass the caches, since a page is seldom zeroed right before it
+   is read. */
+void
+fpu_zero_page (void *dst) {
+	unsigned cnt = PGSIZE / 64;
+
+	ASSERT (pg_ofs (dst) == 0);
+
+	if (!fpu_ready) {
+		memset (dst, 0, PGSIZE);
+		return;
+	}
+	kernel_fpu_begin ();
+	asm volatile ("pxor %%xmm0, %%xmm0\n"
+			"1:\n\t"
+			"movntdq %%xmm0, (%0)\n\t"
+			"movntdq %%xmm0, 16(%0)\n\t"
+			"movntdq %%xmm0, 32(%0)\n\t"
+			"movntdq %%xmm0, 48(%0)\n\t"
+			"addq $64, %0\n\t"
+			"decl %1\n\t"
+			"jnz 1b\n\t"
+			"sfence"
+			: "+r" (dst), "+r" (cnt) : : "memory");
+	kernel_fpu_end ();
+}
+
+/* Prints FPU statistics. */
+void
+fpu_print_stats (void) {
+	printf ("FPU: %s, %zu-byte state, %lld traps, %lld saves, "
+			"%lld kernel sections\n",
+			use_xsave ? "XSAVE" : "FXSAVE", state_size,
+			trap_cnt, save_cnt, kernel_cnt);
+}
@@ -1,6 +1,7 @@
 #include "threads/init.h"
 #include <console.h>
 #include <debug.h>
+#include <inttypes.h>
 #include <limits.h>
 #include <random.h>
 #include <stddef.h>
@@ -13,14 +14,25 @@
 #include "devices/serial.h"
 #include "devices/timer.h"
 #include "devices/vga.h"
+#include "threads/apic.h"
+#include "threads/fpu.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/loader.h"
 #include "threads/malloc.h"
 #include "threads/mmu.h"
 #include "threads/palloc.h"
+#include "threads/pmu.h"
+#include "threads/profile.h"
 #include "threads/pte.h"
+#include "threads/rcu.h"
+#include "threads/smp.h"
+#include "threads/workqueue.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
+#include "threads/tunable.h"
+#include "intrinsic.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -31,11 +43,15 @@
 #include "tests/threads/tests.h"
 #ifdef VM
 #include "vm/vm.h"
+#include "vm/zswap.h"
 #endif
 #ifdef FILESYS
 #include "devices/disk.h"
+#include "filesys/buffer_cache.h"
+#include "filesys/dcache.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
+#include "filesys/journal.h"
 #endif
 
 /* Page-map-level-4 with kernel mappings only. */
@@ -51,6 +67,22 @@ bool power_off_when_done;
 
 bool thread_tests;
 
+/* -boot-stats: Print how long each phase of the boot took? */
+static bool boot_stats;
+
+/* TSC at the end of each phase of the boot, after boot_start, the
+   TSC when main() was entered. */
+#define BOOT_PHASES_MAX 24
+static uint64_t boot_start;
+static struct boot_phase {
+	const char *name;
+	uint64_t tsc;
+} boot_phases[BOOT_PHASES_MAX];
+static int boot_phase_cnt;
+
+static void boot_phase (const char *name);
+static void print_boot_stats (void);
+
 static void bss_init (void);
 static void paging_init (uint64_t mem_end);
 
@@ -69,6 +101,7 @@ int main (void) NO_RETURN;
 /* 커맨드 라인을 parsing한 다음, run_actions( ) 함수를 실행 */
 int
 main (void) {
+	uint64_t start = rdtsc ();
 	uint64_t mem_end;
 	char **argv;
 
@@ -76,6 +109,8 @@ main (void) {
 	// .bss에는 초기화되지 않은 C전역변수와 정적변수 들어감
 	// 0으로 초기화된 전역변수 및 정적변수 저장됨
 	bss_init ();
+	boot_start = start;
+	boot_phase ("bss_init");
 
 	/* Break command line into arguments and parse options. */
 	/* command line: pintos –v -- run ‘echo x’ */
@@ -84,16 +119,23 @@ main (void) {
 	argv = parse_options (argv); // argv를 parsing하고 추가적인 option들을 세팅한다.
   								 // "run"등의 action부터 argv에 다시 넣는다.
 								 // argv = ["run", "'echo x'", NULL]
+	boot_phase ("command line");
 
 	/* Initialize ourselves as a thread so we can use locks,
 	   then enable console locking. */
 	thread_init ();
 	console_init ();
+	boot_phase ("thread_init");
 
 	/* Initialize memory system. */
 	mem_end = palloc_init ();
+	boot_phase ("palloc_init");
 	malloc_init ();
+	boot_phase ("malloc_init");
 	paging_init (mem_end);
+	boot_phase ("paging_init");
+	trace_init ();
+	profile_init ();
 
 #ifdef USERPROG
 	tss_init ();
@@ -102,6 +144,8 @@ main (void) {
 
 	/* Initialize interrupt handlers. */
 	intr_init ();
+	pmu_init ();
+	fpu_init ();
 	timer_init ();
 	kbd_init ();
 	input_init ();
@@ -109,21 +153,40 @@ main (void) {
 	exception_init ();
 	syscall_init ();
 #endif
+	boot_phase ("intr_init");
 	/* Start thread scheduler and enable interrupts. */
 	thread_start ();
+	boot_phase ("thread_start");
+	rcu_init ();
+	workqueue_init ();
+	palloc_zero_init ();
 	serial_init_queue ();
 	timer_calibrate ();
+	boot_phase ("timer_calibrate");
+	smp_init ();
+	boot_phase ("smp_init");
 
 #ifdef FILESYS
-	/* Initialize file system. */
+	/* Initialize file system.  The disks are probed in the
+	   background; filesys_init() waits only for its own. */
 	disk_init ();
+	boot_phase ("disk_init");
 	filesys_init (format_filesys);
+	boot_phase ("filesys_init");
 #endif
 
 #ifdef VM
 	vm_init ();
+	boot_phase ("vm_init");
+#endif
+#ifdef FILESYS
+	disk_wait_probes ();
+	boot_phase ("disk probes");
 #endif
 
+	tunable_boot_check ();
+	if (boot_stats)
+		print_boot_stats ();
 	printf ("Boot complete.\n");
 
 	/* Run actions specified on kernel command line. */
@@ -135,6 +198,39 @@ main (void) {
 	thread_exit ();
 }
 
+/* Marks the end of phase NAME of the boot. */
+static void
+boot_phase (const char *name) {
+	ASSERT (boot_phase_cnt < BOOT_PHASES_MAX);
+	boot_phases[boot_phase_cnt].name = name;
+	boot_phases[boot_phase_cnt].tsc = rdtsc ();
+	boot_phase_cnt++;
+}
+
+/* Prints the TSC cycles each phase of the boot took, in
+   microseconds as well once the timer has been calibrated, and
+   how to skip that calibration next time. */
+static void
+print_boot_stats (void) {
+	uint64_t hz = timer_tsc_hz (), prev = boot_start;
+
+	printf ("Boot: %'"PRIu64" cycles before main()\n", boot_start);
+	for (int i = 0; i < boot_phase_cnt; i++) {
+		uint64_t cycles = boot_phases[i].tsc - prev;
+
+		if (hz != 0)
+			printf ("Boot: %-16s %'14"PRIu64" cycles %'9"PRIu64" us\n",
+					boot_phases[i].name, cycles, cycles * 1000000 / hz);
+		else
+			printf ("Boot: %-16s %'14"PRIu64" cycles\n",
+					boot_phases[i].name, cycles);
+		prev = boot_phases[i].tsc;
+	}
+	printf ("Boot: %'"PRIu64" cycles in main(); next time pass ",
+			prev - boot_start);
+	timer_print_calibration ();
+}
+
 /* Clear BSS */
 static void
 bss_init (void) {
@@ -149,6 +245,32 @@ bss_init (void) {
 	memset (&_start_bss, 0, &_end_bss - &_start_bss); // 메모리의 내용(값)을 원하는 크기만큼 특정 값으로 세팅. 런타임에 메모리에 0으로 초기화되어 할당된다는 것.
 }
 
+/* Returns true if the CPU supports 1 GB pages. */
+static bool
+huge_pages_supported (void) {
+	uint32_t eax, ebx, ecx, edx;
+
+	cpuid (0x80000000, &eax, &ebx, &ecx, &edx);
+	if (eax < 0x80000001)
+		return false;
+	cpuid (0x80000001, &eax, &ebx, &ecx, &edx);
+	return (edx & (1 << 26)) != 0;
+}
+
+/* Returns true if the direct map may cover the SIZE bytes of
+   physical memory at PA, which must lie below MEM_END, with a
+   single large page.  Kernel text is read-only, so it is left to
+   4 kB pages. */
+static bool
+direct_map_fits (uint64_t pa, uint64_t mem_end, uint64_t size) {
+	extern char start, _end_kernel_text;
+	uint64_t va = (uint64_t) ptov (pa);
+
+	return pa % size == 0 && pa + size <= mem_end
+		&& (va + size <= (uint64_t) &start
+			|| va >= (uint64_t) &_end_kernel_text);
+}
+
 /* Populates the page table with the kernel virtual mapping,
  * and then sets up the CPU to use the new page directory.
  * Points base_pml4 to the pml4 it creates. */
@@ -156,15 +278,30 @@ static void
 paging_init (uint64_t mem_end) {
 	uint64_t *pml4, *pte;
 	int perm;
+	bool huge_ok = huge_pages_supported ();
 	pml4 = base_pml4 = palloc_get_page (PAL_ASSERT | PAL_ZERO);
 
 	extern char start, _end_kernel_text;
 	// Maps physical address [0 ~ mem_end] to
 	//   [LOADER_KERN_BASE ~ LOADER_KERN_BASE + mem_end].
+	// Most of it is mapped with large pages, to need fewer page
+	// tables and TLB entries.
 	for (uint64_t pa = 0; pa < mem_end; pa += PGSIZE) {
 		uint64_t va = (uint64_t) ptov(pa);
-
-		perm = PTE_P | PTE_W;
+		uint64_t size = 0;
+
+		if (huge_ok && direct_map_fits (pa, mem_end, HUGE_PGSIZE))
+			size = HUGE_PGSIZE;
+		else if (direct_map_fits (pa, mem_end, LARGE_PGSIZE))
+			size = LARGE_PGSIZE;
+		if (size != 0) {
+			if (!pml4_map_large (pml4, va, pa, size, PTE_W | PTE_G))
+				PANIC ("paging_init: out of memory");
+			pa += size - PGSIZE;
+			continue;
+		}
+
+		perm = PTE_P | PTE_W | PTE_G;
 		if ((uint64_t) &start <= va && va < (uint64_t) &_end_kernel_text)
 			perm &= ~PTE_W;
 
@@ -172,6 +309,11 @@ paging_init (uint64_t mem_end) {
 			*pte = pa | perm;
 	}
 
+	// The direct map is the same in every address space, so it is
+	// marked global and survives the CR3 loads of a context switch.
+	tlb_init ();
+	pml4_share_init ();
+
 	// reload cr3
 	pml4_activate(0);
 }
@@ -211,6 +353,20 @@ read_command_line (void) {
 	return argv; // 인자 문자열의 주소가 담긴 포인터 배열을 리턴 [0x13424, 0x23545, 0x44521]
 }
 
+/* Parses VALUE of option -calib, the loops, TSC cycles and local
+   APIC timer counts per tick separated by colons. */
+static void
+parse_calibration (char *value) {
+	char *save_ptr, *loops, *tsc, *apic;
+
+	if (value == NULL
+			|| (loops = strtok_r (value, ":", &save_ptr)) == NULL
+			|| (tsc = strtok_r (NULL, ":", &save_ptr)) == NULL
+			|| (apic = strtok_r (NULL, ":", &save_ptr)) == NULL)
+		PANIC ("-calib needs LOOPS:TSC:APIC");
+	timer_set_calibration (atoi (loops), atoi (tsc), atoi (apic));
+}
+
 /* Parses options in ARGV[]
    and returns the first non-option argument. */
 static char **
@@ -227,16 +383,54 @@ parse_options (char **argv) {
 #ifdef FILESYS
 		else if (!strcmp (name, "-f"))
 			format_filesys = true;
+		else if (!strcmp (name, "-pio"))
+			disk_use_dma = false;
+		else if (!strcmp (name, "-fs-disk"))
+			filesys_disk_name = value;
 #endif
 		else if (!strcmp (name, "-rs"))
 			random_init (atoi (value));
 		else if (!strcmp (name, "-mlfqs"))
 			thread_mlfqs = true;
+		else if (!strcmp (name, "-fair"))
+			thread_fair = true;
+		else if (!strcmp (name, "-tickless"))
+			timer_tickless = true;
+		else if (!strcmp (name, "-noapic"))
+			apic_disabled = true;
+		else if (!strcmp (name, "-smp"))
+			smp_cpus = atoi (value);
+		else if (!strcmp (name, "-mtags"))
+			malloc_tags = true;
+		else if (!strcmp (name, "-trace"))
+			trace_enabled = true;
+		else if (!strcmp (name, "-profile"))
+			profile_enabled = true;
+		else if (!strcmp (name, "-boot-stats"))
+			boot_stats = true;
+		else if (!strcmp (name, "-calib"))
+			parse_calibration (value);
+		else if (!strcmp (name, "-tune"))
+			tunable_boot_option (value);
 #ifdef USERPROG
 		else if (!strcmp (name, "-ul"))
 			user_page_limit = atoi (value);
 		else if (!strcmp (name, "-threads-tests"))
 			thread_tests = true;
+#endif
+#ifdef VM
+		else if (!strcmp (name, "-swap-ra"))
+			swap_readahead = atoi (value);
+		else if (!strcmp (name, "-zswap"))
+			zswap_enabled = true;
+		else if (!strcmp (name, "-stack-win"))
+			stack_growth_window = atoi (value);
+		else if (!strcmp (name, "-thp"))
+			thp_enabled = true;
+		else if (!strcmp (name, "-rss"))
+			rss_limit = atoi (value);
+		else if (!strcmp (name, "-swap-disk"))
+			swap_disk_name = value;
 #endif
 		else
 			PANIC ("unknown option `%s' (use -h for help)", name);
@@ -344,10 +538,30 @@ usage (void) {
 			"  -h                 Print this help message and power off.\n"
 			"  -q                 Power off VM after actions or on panic.\n"
 			"  -f                 Format file system disk during startup.\n"
+			"  -pio               Use PIO instead of DMA for disks.\n"
+			"  -fs-disk=DISK      Keep the file system on DISK, e.g. hd0:1.\n"
 			"  -rs=SEED           Set random number seed to SEED.\n"
 			"  -mlfqs             Use multi-level feedback queue scheduler.\n"
+			"  -fair              Use fair-share (virtual runtime) scheduler.\n"
+			"  -tickless          Stop the timer tick while idle.\n"
+			"  -noapic            Take interrupts through the PICs, not the APICs.\n"
+			"  -smp=N             Run on up to N CPUs.\n"
+			"  -mtags             Record the allocation site of each heap block.\n"
+			"  -trace             Trace kernel events; see utils/pintos-trace.\n"
+			"  -profile           Sample the timer tick; see utils/pintos-profile.\n"
+			"  -boot-stats        Print how long each phase of the boot took.\n"
+			"  -calib=L:T:A       Skip timer calibration, as -boot-stats suggests.\n"
+			"  -tune=NAME=VALUE   Set tunable NAME, such as sched.time_slice, to VALUE.\n"
 #ifdef USERPROG
 			"  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+			"  -swap-ra=COUNT     Read ahead COUNT pages on swap-in.\n"
+			"  -zswap             Compress evicted pages in memory first.\n"
+			"  -stack-win=COUNT   Grow the stack COUNT pages per fault.\n"
+			"  -thp               Map untouched 2 MB of memory with huge pages.\n"
+			"  -rss=COUNT         Keep at most COUNT pages of a process in memory.\n"
+			"  -swap-disk=DISK    Swap to DISK, e.g. hd1:1.\n"
 #endif
 			);
 	power_off ();
@@ -363,6 +577,8 @@ power_off (void) {
 #endif
 
 	print_stats ();
+	trace_dump ();
+	profile_dump ();
 
 	printf ("Powering off...\n");
 	outw (0x604, 0x2000);               /* Poweroff command for qemu */
@@ -374,12 +590,26 @@ static void
 print_stats (void) {
 	timer_print_stats ();
 	thread_print_stats ();
+	pmu_print_stats ();
+	fpu_print_stats ();
+	palloc_print_stats ();
+	malloc_print_stats ();
+	lock_print_stats ();
 #ifdef FILESYS
 	disk_print_stats ();
+	buffer_cache_print_stats ();
+#ifndef EFILESYS
+	journal_print_stats ();
+#endif
+	dcache_print_stats ();
 #endif
 	console_print_stats ();
 	kbd_print_stats ();
 #ifdef USERPROG
 	exception_print_stats ();
+	syscall_print_stats ();
+#endif
+#ifdef VM
+	vm_print_stats ();
 #endif
 }
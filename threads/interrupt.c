@@ -3,9 +3,12 @@
 #include <inttypes.h>
 #include <stdint.h>
 #include <stdio.h>
+#include "threads/apic.h"
+#include "threads/cpu.h"
 #include "threads/flags.h"
 #include "threads/intr-stubs.h"
 #include "threads/io.h"
+#include "threads/softirq.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
 #include "threads/vaddr.h"
@@ -13,6 +16,7 @@
 #include "intrinsic.h"
 #ifdef USERPROG
 #include "userprog/gdt.h"
+#include "userprog/process.h"
 #endif
 
 /* Number of x86_64 interrupts. */
@@ -105,12 +109,16 @@ static const char *intr_names[INTR_CNT];
    외부 인터럽트는 인터럽트가 꺼진 상태에서 실행되므로 둥지를 틀지 않으며 선점되지도 않습니다.
    외부 인터럽트를 위한 핸들러도 sleep하지 않을 수 있지만 
    인터럽트가 끝나기 직전에 새로운 프로세스가 예약되도록 요청하기 위해 intr_yield_on_return()을 호출할 수 있다.
-    */
-static bool in_external_intr;   /* Are we processing an external interrupt? */
-static bool yield_on_return;    /* Should we yield on interrupt return? */
+
+   Whether we are in one, and whether to yield on return, is kept
+   in struct cpu, since every CPU takes interrupts of its own. */
+
+/* Do external interrupts go through the APICs, not the PICs? */
+static bool use_apic;
 
 /* Programmable Interrupt Controller helpers. */
 static void pic_init (void);
+static void pic_disable (void);
 static void pic_end_of_interrupt (int irq);
 
 /* Interrupt handlers. */
@@ -141,7 +149,7 @@ intr_set_level (enum intr_level level) {
 enum intr_level
 intr_enable (void) {
 	enum intr_level old_level = intr_get_level ();
-	ASSERT (!intr_context ());
+	ASSERT (!this_cpu ()->in_external_intr);
 
 	/* Enable interrupts by setting the interrupt flag.
 
@@ -172,6 +180,7 @@ intr_init (void) {
 
 	/* Initialize interrupt controller. */
 	pic_init ();
+	softirq_init ();
 
 	/* Initialize IDT. */
 	for (i = 0; i < INTR_CNT; i++) {
@@ -207,6 +216,22 @@ intr_init (void) {
 	intr_names[17] = "#AC Alignment Check Exception";
 	intr_names[18] = "#MC Machine-Check Exception";
 	intr_names[19] = "#XF SIMD Floating-Point Exception";
+
+	/* Prefer the APICs.  The PICs stay behind, masked, and take over
+	   if there are none. */
+	use_apic = apic_init ();
+	if (use_apic)
+		pic_disable ();
+}
+
+/* Loads the IDT, which all CPUs share, and the TSS on an
+   application processor.  Called by smp.c with interrupts off. */
+void
+intr_init_ap (void) {
+#ifdef USERPROG
+	ltr (SEL_TSS);
+#endif
+	lidt (&idt_desc);
 }
 
 /* Registers interrupt VEC_NO to invoke HANDLER with descriptor
@@ -229,11 +254,12 @@ register_handler (uint8_t vec_no, int dpl, enum intr_level level,
 
 /* Registers external interrupt VEC_NO to invoke HANDLER, which
    is named NAME for debugging purposes.  The handler will
-   execute with interrupts disabled. */
+   execute with interrupts disabled.  Vectors 0x20...0x2f are the
+   device IRQs and 0x30...0x3f the local APIC's own interrupts. */
 void
 intr_register_ext (uint8_t vec_no, intr_handler_func *handler,
 		const char *name) {
-	ASSERT (vec_no >= 0x20 && vec_no <= 0x2f);
+	ASSERT (vec_no >= 0x20 && vec_no <= 0x3f);
 	register_handler (vec_no, 0, INTR_OFF, handler, name);
 }
 
@@ -254,18 +280,25 @@ void
 intr_register_int (uint8_t vec_no, int dpl, enum intr_level level,
 		intr_handler_func *handler, const char *name)
 {
-	ASSERT (vec_no < 0x20 || vec_no > 0x2f);
+	ASSERT (vec_no < 0x20 || vec_no > 0x3f);
 	register_handler (vec_no, dpl, level, handler, name);
 }
 
-/* Returns true during processing of an external interrupt
-   and false at all other times. */
+/* Returns true during processing of an external interrupt,
+   including the work its handler deferred (see softirq.c), and
+   false at all other times. */
 /* 외부 인터럽트를 처리하는 동안 true를 반환합니다.
    다른 모든 시간에는 false입니다.
 */
 bool
 intr_context (void) {
-	return in_external_intr;
+	enum intr_level old_level = intr_disable ();
+	bool in = this_cpu ()->in_external_intr || softirq_active ();
+
+	/* With interrupts on we might move to another CPU while
+	   looking, and see its interrupt instead of our own. */
+	intr_set_level (old_level);
+	return in;
 }
 
 /* During processing of an external interrupt, directs the
@@ -279,7 +312,7 @@ intr_context (void) {
 void
 intr_yield_on_return (void) {
 	ASSERT (intr_context ());
-	yield_on_return = true;
+	this_cpu ()->yield_on_return = true;
 }
 
 /* 8259A Programmable Interrupt Controller. */
@@ -321,6 +354,14 @@ pic_init (void) {
 	outb (0xa1, 0x00);
 }
 
+/* Masks every interrupt on both PICs, once the APICs have taken
+   over. */
+static void
+pic_disable (void) {
+	outb (0x21, 0xff);
+	outb (0xa1, 0xff);
+}
+
 /* Sends an end-of-interrupt signal to the PIC for the given IRQ.
    If we don't acknowledge the IRQ, it will never be delivered to
    us again, so this is important.  */
@@ -343,22 +384,30 @@ pic_end_of_interrupt (int irq) {
    interrupted thread's registers. */
 void
 intr_handler (struct intr_frame *frame) {
-	bool external;
+	struct cpu *c = NULL;
+	bool external, from_user;
 	intr_handler_func *handler;
 
 	/* External interrupts are special.
 	   We only handle one at a time (so interrupts must be off)
-	   and they need to be acknowledged on the PIC (see below).
-	   An external interrupt handler cannot sleep. */
-	external = frame->vec_no >= 0x20 && frame->vec_no < 0x30;
+	   and they need to be acknowledged on the PIC or the local
+	   APIC (see below).  An external interrupt handler cannot
+	   sleep. */
+	external = frame->vec_no >= 0x20 && frame->vec_no < 0x40;
 	if (external) {
+		c = this_cpu ();
 		ASSERT (intr_get_level () == INTR_OFF);
-		ASSERT (!intr_context ());
+		ASSERT (!c->in_external_intr);
 		// printf("들어오나\n");
-		in_external_intr = true;
-		yield_on_return = false;
+		c->in_external_intr = true;
+		if (!softirq_active ())
+			c->yield_on_return = false;
 	}
 
+	from_user = (frame->cs & 3) == 3;
+	if (from_user)
+		thread_enter_kernel ();
+
 	/* Invoke the interrupt's handler. */
 	handler = intr_handlers[frame->vec_no];
 	if (handler != NULL)
@@ -379,12 +428,27 @@ intr_handler (struct intr_frame *frame) {
 		ASSERT (intr_get_level () == INTR_OFF);
 		ASSERT (intr_context ());
 		// printf("여기로 들어오나\n");
-		in_external_intr = false;
-		pic_end_of_interrupt (frame->vec_no);
-
-		if (yield_on_return)
+		c->in_external_intr = false;
+		if (use_apic)
+			apic_eoi ();
+		else
+			pic_end_of_interrupt (frame->vec_no);
+
+		/* Run the work the handler deferred, unless this interrupt
+		   came in the middle of that, which will then run it and
+		   yield instead. */
+		if (softirq_pending ())
+			softirq_run ();
+		if (c->yield_on_return && !softirq_active ())
 			thread_yield ();
 	}
+	if (from_user) {
+#ifdef USERPROG
+		/* Another thread of the process may have called exit(). */
+		process_check_exiting ();
+#endif
+		thread_leave_kernel ();
+	}
 }
 
 /* Dumps interrupt frame F to the console, for debugging. */
@@ -1,45 +1,108 @@
 #include "threads/malloc.h"
 #include <debug.h>
+#include <inttypes.h>
 #include <list.h>
+#include <memstat.h>
 #include <round.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
 #include "threads/palloc.h"
+#include "threads/spinlock.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 
-/* A simple implementation of malloc().
-
-   The size of each request, in bytes, is rounded up to a power
-   of 2 and assigned to the "descriptor" that manages blocks of
-   that size.  The descriptor keeps a list of free blocks.  If
-   the free list is nonempty, one of its blocks is used to
-   satisfy the request.
-
-   Otherwise, a new page of memory, called an "arena", is
-   obtained from the page allocator (if none is available,
-   malloc() returns a null pointer).  The new arena is divided
-   into blocks, all of which are added to the descriptor's free
-   list.  Then we return one of the new blocks.
-
-   When we free a block, we add it to its descriptor's free list.
-   But if the arena that the block was in now has no in-use
-   blocks, we remove all of the arena's blocks from the free list
-   and give the arena back to the page allocator.
-
-   We can't handle blocks bigger than 2 kB using this scheme,
-   because they're too big to fit in a single page with a
-   descriptor.  We handle those by allocating contiguous pages
-   with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
-
-/* Descriptor. */
-struct desc {
+/* A slab implementation of malloc().
+
+   Memory is handed out by "caches", each of which manages blocks
+   of one size.  The size of each malloc() request, in bytes, is
+   rounded up to a power of 2 and served by the generic cache
+   ("descriptor") for blocks of that size.  Above 1 kB, where
+   doubling would waste the most, the sizes are instead chosen
+   so that exactly three, two or one blocks fill an arena.
+   kmem_cache_create()
+   makes caches for particular fixed-size objects, so that hot
+   structures like struct inode do not pay for the rounding.
+
+   Such a cache may have a constructor.  It is run once on each
+   object when the object's memory is first carved out of an
+   arena, not on every allocation: objects must be freed back in
+   their constructed state (empty lists, unlocked locks, and so
+   on), and come out of kmem_cache_alloc() still constructed.  The
+   free list link of such an object lives just past its end, so
+   that being free does not clobber it.
+
+   A cache obtains memory from the page allocator one page at a
+   time.  Such a page, called an "arena" (or slab), starts with a
+   header and is divided into blocks.  Each arena keeps its own
+   list of free blocks, and the cache keeps a list of the arenas
+   that have any, so a new arena is not walked at all when it is
+   created: its blocks are carved off one at a time as they are
+   first needed.  When an arena no longer has any blocks in use,
+   it is given back to the page allocator.
+
+   In front of the arenas, each CPU has a "magazine" per cache: a
+   small stack of free blocks.  malloc() and free() normally just
+   pop and push the current CPU's magazine with interrupts off,
+   without taking the cache's lock; only the statistics below are
+   shared with other CPUs, under a spinlock.  Only when the magazine is
+   empty or full does it trade MAG_BATCH blocks with the arenas,
+   under the lock.
+
+   We can't handle blocks bigger than a page minus the arena
+   header using this scheme.  We handle those by allocating
+   contiguous pages with the page allocator and sticking the
+   allocation size at the beginning of the allocated block's
+   arena header.
+
+   realloc() leaves a block where it is when it still fits and
+   would not be better off in a smaller descriptor; a big block
+   can likewise use the slack at the end of its last page, and
+   shrinks by giving whole pages back.
+
+   Each cache counts its live blocks, their peak and its arenas,
+   and malloc_print_stats() reports them along with the total
+   number of heap bytes in use.  With the -mtags kernel option,
+   every block also records the address of the code that
+   allocated it, so that the report can list live blocks by
+   allocation site to track down leaks. */
+
+/* Magazine: per-CPU stack of free blocks. */
+#define MAG_SIZE 16                 /* Most blocks a magazine holds. */
+#define MAG_BATCH 8                 /* Blocks moved per refill or flush. */
+
+struct magazine {
+	size_t cnt;                     /* Number of blocks. */
+	struct block *blocks[MAG_SIZE]; /* Free blocks, most recent last. */
+};
+
+/* Object cache ("descriptor"). */
+struct kmem_cache {
+	const char *name;           /* Name, for debugging. */
 	size_t block_size;          /* Size of each element in bytes. */
+	size_t obj_size;            /* Usable bytes in each element. */
 	size_t blocks_per_arena;    /* Number of blocks in an arena. */
-	struct list free_list;      /* List of free blocks. */
-	struct lock lock;           /* Lock. */
+	size_t first_ofs;           /* Offset of first block in an arena. */
+	size_t link_ofs;            /* Offset of free list link in a block. */
+	size_t tag_ofs;             /* Offset of allocation site, or 0. */
+	kmem_ctor_func *ctor;       /* Object constructor, or null. */
+	struct list_elem cache_elem; /* Element in CACHES. */
+
+	/* Arenas. */
+	struct lock lock;           /* Protects the three below. */
+	struct list partial;        /* Arenas that have free blocks. */
+	struct list arenas;         /* All arenas. */
+	size_t arena_cnt;           /* Number of arenas. */
+
+	/* Per-CPU magazines. */
+	struct magazine mags[NCPU];
+
+	/* Statistics, protected by heap_lock. */
+	int64_t allocs;             /* Blocks ever allocated. */
+	int64_t in_use;             /* Blocks allocated and not freed. */
+	int64_t peak;               /* Highest value of IN_USE. */
 };
 
 /* Magic number for detecting arena corruption. */
@@ -48,34 +111,76 @@ struct desc {
 /* Arena. */
 struct arena {
 	unsigned magic;             /* Always set to ARENA_MAGIC. */
-	struct desc *desc;          /* Owning descriptor, null for big block. */
+	struct kmem_cache *desc;    /* Owning cache, null for big block. */
 	size_t free_cnt;            /* Free blocks; pages in big block. */
+	struct block *free_list;    /* Free blocks below CARVED. */
+	size_t carved;              /* Blocks ever handed out. */
+	struct list_elem elem;      /* Element in desc's PARTIAL list. */
+	struct list_elem all_elem;  /* Element in desc's ARENAS list, or
+	                               in BIG_BLOCKS for a big block. */
+	void *tag;                  /* Allocation site of a big block. */
 };
 
-/* Free block. */
+/* Free block.  The link is at the start for caches without a
+   constructor, at the cache's link_ofs in general. */
 struct block {
-	struct list_elem free_elem; /* Free list element. */
+	struct block *next;         /* Next free block in arena. */
 };
 
 /* Our set of descriptors. */
-static struct desc descs[10];   /* Descriptors. */
+static struct kmem_cache descs[10]; /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
+/* Record allocation sites?  Set by the -mtags kernel option. */
+bool malloc_tags;
+
+/* All caches, both descriptors and kmem_cache_create()'d, and all
+   big blocks when malloc_tags is set.  Protected by heap_lock. */
+static struct list caches;
+static struct list big_blocks;
+
+/* Protects the heap totals below, CACHES, BIG_BLOCKS and each
+   cache's statistics. */
+static struct spinlock heap_lock;
+
+/* Heap totals. */
+static int64_t heap_bytes;      /* Bytes in live blocks. */
+static int64_t heap_peak;       /* Highest value of HEAP_BYTES. */
+static int64_t big_pages;       /* Pages in big blocks. */
+
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static void cache_init (struct kmem_cache *, const char *name, size_t size,
+		size_t align, kmem_ctor_func *);
+static void *malloc_at (size_t, void *pc);
+static void *cache_alloc (struct kmem_cache *, void *pc);
+static void cache_free (struct kmem_cache *, struct block *);
 
 /* Initializes the malloc() descriptors. */
 void
 malloc_init (void) {
-	size_t block_size;
+	size_t block_size, i;
+
+	spin_lock_init (&heap_lock);
+	list_init (&caches);
+	list_init (&big_blocks);
 
 	for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2) {
-		struct desc *d = &descs[desc_cnt++];
+		struct kmem_cache *d = &descs[desc_cnt++];
+		ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
+		cache_init (d, "malloc", block_size, 0, NULL);
+	}
+
+	/* Blocks that fill an arena 3, 2 and 1 to a page. */
+	for (i = 3; i > 0; i--) {
+		struct kmem_cache *d = &descs[desc_cnt++];
 		ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
-		d->block_size = block_size;
-		d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
-		list_init (&d->free_list);
-		lock_init (&d->lock);
+		block_size = ROUND_DOWN ((PGSIZE - sizeof (struct arena)) / i,
+				sizeof (struct block));
+		if (malloc_tags)
+			block_size -= sizeof (void *);
+		cache_init (d, "malloc", block_size, 0, NULL);
+		ASSERT (d->blocks_per_arena == i);
 	}
 }
 
@@ -83,8 +188,23 @@ malloc_init (void) {
    Returns a null pointer if memory is not available. */
 void *
 malloc (size_t size) {
-	struct desc *d;
-	struct block *b;
+	return malloc_at (size, __builtin_return_address (0));
+}
+
+/* Adds DELTA to the number of heap bytes in use.  heap_lock must
+   be held. */
+static void
+heap_account (int64_t delta) {
+	ASSERT (heap_lock.locked);
+	heap_bytes += delta;
+	if (heap_bytes > heap_peak)
+		heap_peak = heap_bytes;
+}
+
+/* Like malloc(), recording PC as the allocation site. */
+static void *
+malloc_at (size_t size, void *pc) {
+	struct kmem_cache *d;
 	struct arena *a;
 
 	/* A null pointer satisfies a request for 0 bytes. */
@@ -94,7 +214,7 @@ malloc (size_t size) {
 	/* Find the smallest descriptor that satisfies a SIZE-byte
 	   request. */
 	for (d = descs; d < descs + desc_cnt; d++)
-		if (d->block_size >= size)
+		if (d->obj_size >= size)
 			break;
 	if (d == descs + desc_cnt) {
 		/* SIZE is too big for any descriptor.
@@ -109,38 +229,31 @@ malloc (size_t size) {
 		a->magic = ARENA_MAGIC;
 		a->desc = NULL;
 		a->free_cnt = page_cnt;
+		a->tag = pc;
+
+		spin_lock (&heap_lock);
+		heap_account (PGSIZE * page_cnt - sizeof *a);
+		big_pages += page_cnt;
+		if (malloc_tags)
+			list_push_back (&big_blocks, &a->all_elem);
+		spin_unlock (&heap_lock);
 		return a + 1;
 	}
 
-	lock_acquire (&d->lock);
-
-	/* If the free list is empty, create a new arena. */
-	if (list_empty (&d->free_list)) {
-		size_t i;
-
-		/* Allocate a page. */
-		a = palloc_get_page (0);
-		if (a == NULL) {
-			lock_release (&d->lock);
-			return NULL;
-		}
-
-		/* Initialize arena and add its blocks to the free list. */
-		a->magic = ARENA_MAGIC;
-		a->desc = d;
-		a->free_cnt = d->blocks_per_arena;
-		for (i = 0; i < d->blocks_per_arena; i++) {
-			struct block *b = arena_to_block (a, i);
-			list_push_back (&d->free_list, &b->free_elem);
-		}
-	}
+	return cache_alloc (d, pc);
+}
 
-	/* Get a block from free list and return it. */
-	b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
-	a = block_to_arena (b);
-	a->free_cnt--;
-	lock_release (&d->lock);
-	return b;
+/* Frees big block A. */
+static void
+big_free (struct arena *a) {
+	spin_lock (&heap_lock);
+	heap_account (-(int64_t) (PGSIZE * a->free_cnt - sizeof *a));
+	big_pages -= a->free_cnt;
+	if (malloc_tags)
+		list_remove (&a->all_elem);
+	spin_unlock (&heap_lock);
+
+	palloc_free_multiple (a, a->free_cnt);
 }
 
 /* Allocates and return A times B bytes initialized to zeroes.
@@ -156,7 +269,7 @@ calloc (size_t a, size_t b) {
 		return NULL;
 
 	/* Allocate and zero memory. */
-	p = malloc (size);
+	p = malloc_at (size, __builtin_return_address (0));
 	if (p != NULL)
 		memset (p, 0, size);
 
@@ -168,9 +281,45 @@ static size_t
 block_size (void *block) {
 	struct block *b = block;
 	struct arena *a = block_to_arena (b);
-	struct desc *d = a->desc;
+	struct kmem_cache *d = a->desc;
+
+	return d != NULL ? d->obj_size : PGSIZE * a->free_cnt - pg_ofs (block);
+}
 
-	return d != NULL ? d->block_size : PGSIZE * a->free_cnt - pg_ofs (block);
+/* Tries to make BLOCK hold NEW_SIZE bytes without moving it.
+   Returns true if successful, false if it has to move. */
+static bool
+resize_in_place (void *block, size_t new_size) {
+	struct arena *a = block_to_arena (block);
+	struct kmem_cache *d = a->desc;
+	size_t page_cnt;
+
+	if (d != NULL) {
+		/* Keep the block unless more than half of it would be idle
+		   and a smaller descriptor could take it. */
+		return new_size <= d->obj_size
+			&& (new_size > d->obj_size / 2 || d == descs);
+	}
+
+	/* A big block can use the rest of its last page.  If it
+	   shrinks, trailing pages go back to the page allocator, unless
+	   it has become small enough for a descriptor. */
+	page_cnt = DIV_ROUND_UP (new_size + sizeof *a, PGSIZE);
+	if (page_cnt > a->free_cnt
+			|| new_size <= descs[desc_cnt - 1].obj_size)
+		return false;
+	if (page_cnt < a->free_cnt) {
+		size_t freed = a->free_cnt - page_cnt;
+
+		palloc_free_multiple ((uint8_t *) a + page_cnt * PGSIZE, freed);
+		a->free_cnt = page_cnt;
+
+		spin_lock (&heap_lock);
+		heap_account (-(int64_t) (PGSIZE * freed));
+		big_pages -= freed;
+		spin_unlock (&heap_lock);
+	}
+	return true;
 }
 
 /* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly
@@ -184,8 +333,10 @@ realloc (void *old_block, size_t new_size) {
 	if (new_size == 0) {
 		free (old_block);
 		return NULL;
-	} else {
-		void *new_block = malloc (new_size);
+	} else if (old_block != NULL && resize_in_place (old_block, new_size))
+		return old_block;
+	else {
+		void *new_block = malloc_at (new_size, __builtin_return_address (0));
 		if (old_block != NULL && new_block != NULL) {
 			size_t old_size = block_size (old_block);
 			size_t min_size = new_size < old_size ? new_size : old_size;
@@ -197,48 +348,407 @@ realloc (void *old_block, size_t new_size) {
 }
 
 /* Frees block P, which must have been previously allocated with
-   malloc(), calloc(), or realloc(). */
+   malloc(), calloc(), realloc(), or kmem_cache_alloc(). */
 void
 free (void *p) {
 	if (p != NULL) {
 		struct block *b = p;
 		struct arena *a = block_to_arena (b);
-		struct desc *d = a->desc;
+		struct kmem_cache *d = a->desc;
 
 		if (d != NULL) {
 			/* It's a normal block.  We handle it here. */
+			cache_free (d, b);
+		} else {
+			/* It's a big block.  Free its pages. */
+			big_free (a);
+			return;
+		}
+	}
+}
+
+/* Creates and returns a cache named NAME of SIZE-byte objects
+   aligned on ALIGN bytes, which must be a power of 2; 0 means
+   pointer alignment.  If CTOR is nonnull, objects are kept
+   constructed by it, as described at the top of this file.
+   Caches are created at initialization time, so this panics if
+   memory is not available. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, size_t align,
+		kmem_ctor_func *ctor) {
+	struct kmem_cache *d;
+
+	ASSERT (name != NULL);
+	ASSERT (size > 0 && size <= PGSIZE / 2);
+	ASSERT (align <= PGSIZE / 8);
+
+	d = malloc (sizeof *d);
+	if (d == NULL)
+		PANIC ("kmem_cache_create: out of memory");
+	cache_init (d, name, size, align, ctor);
+	return d;
+}
+
+/* Obtains and returns a new object from cache D.  Returns a null
+   pointer if memory is not available. */
+void *
+kmem_cache_alloc (struct kmem_cache *d) {
+	ASSERT (d != NULL);
+	return cache_alloc (d, __builtin_return_address (0));
+}
+
+/* Returns object P, which must have been obtained from cache D
+   with kmem_cache_alloc(), to D. */
+void
+kmem_cache_free (struct kmem_cache *d, void *p) {
+	if (p != NULL) {
+		ASSERT (block_to_arena (p)->desc == d);
+		cache_free (d, p);
+	}
+}
+
+/* Initializes D as a cache named NAME of SIZE-byte blocks aligned
+   on ALIGN bytes and constructed by CTOR, if nonnull. */
+static void
+cache_init (struct kmem_cache *d, const char *name, size_t size,
+		size_t align, kmem_ctor_func *ctor) {
+	size_t end, i;
+
+	/* Every block must hold a free list link and be suitably
+	   aligned for it.  A constructed object keeps its link, and
+	   the allocation site if recorded, past its end. */
+	if (align < sizeof (struct block))
+		align = sizeof (struct block);
+	ASSERT ((align & (align - 1)) == 0);
+	end = ROUND_UP (size, sizeof (struct block));
+	d->obj_size = end;
+	if (ctor != NULL) {
+		d->link_ofs = end;
+		end += sizeof (struct block);
+	} else
+		d->link_ofs = 0;
+	if (malloc_tags) {
+		d->tag_ofs = end;
+		end += sizeof (void *);
+	} else
+		d->tag_ofs = 0;
+
+	d->name = name;
+	d->block_size = ROUND_UP (end, align);
+	d->first_ofs = ROUND_UP (sizeof (struct arena), align);
+	d->blocks_per_arena = (PGSIZE - d->first_ofs) / d->block_size;
+	d->ctor = ctor;
+	ASSERT (d->blocks_per_arena > 0);
+	lock_init (&d->lock);
+	lock_register (&d->lock, name);
+	list_init (&d->partial);
+	list_init (&d->arenas);
+	d->arena_cnt = 0;
+	for (i = 0; i < NCPU; i++)
+		d->mags[i].cnt = 0;
+	d->allocs = d->in_use = d->peak = 0;
+
+	spin_lock (&heap_lock);
+	list_push_back (&caches, &d->cache_elem);
+	spin_unlock (&heap_lock);
+}
+
+/* Returns the free list link of block B in cache D. */
+static struct block **
+block_link (struct kmem_cache *d, struct block *b) {
+	return &((struct block *) ((uint8_t *) b + d->link_ofs))->next;
+}
+
+/* Returns the allocation site slot of block B in cache D, which
+   must record them. */
+static void **
+block_tag (struct kmem_cache *d, struct block *b) {
+	ASSERT (d->tag_ofs != 0);
+	return (void **) ((uint8_t *) b + d->tag_ofs);
+}
+
+/* Takes a free block for D from its arenas, creating a new arena
+   if none has any.  Returns a null pointer if memory is not
+   available.  D's lock must be held. */
+static struct block *
+arena_get_block (struct kmem_cache *d) {
+	struct arena *a;
+	struct block *b;
+
+	ASSERT (lock_held_by_current_thread (&d->lock));
+
+	/* If no arena has a free block, create a new one.  Its blocks
+	   are carved off as they are used. */
+	if (list_empty (&d->partial)) {
+		a = palloc_get_page (0);
+		if (a == NULL)
+			return NULL;
+
+		a->magic = ARENA_MAGIC;
+		a->desc = d;
+		a->free_cnt = d->blocks_per_arena;
+		a->free_list = NULL;
+		a->carved = 0;
+		list_push_front (&d->partial, &a->elem);
+		list_push_back (&d->arenas, &a->all_elem);
+		d->arena_cnt++;
+	}
+
+	a = list_entry (list_front (&d->partial), struct arena, elem);
+	if (a->free_list != NULL) {
+		b = a->free_list;
+		a->free_list = *block_link (d, b);
+	} else {
+		b = arena_to_block (a, a->carved++);
+		if (d->ctor != NULL)
+			d->ctor (b);
+	}
+	if (--a->free_cnt == 0)
+		list_remove (&a->elem);
+	return b;
+}
+
+/* Returns block B to its arena in D.  If the arena is now entirely
+   unused, frees it.  D's lock must be held. */
+static void
+arena_put_block (struct kmem_cache *d, struct block *b) {
+	struct arena *a = block_to_arena (b);
+
+	ASSERT (lock_held_by_current_thread (&d->lock));
+	ASSERT (a->desc == d);
+
+	*block_link (d, b) = a->free_list;
+	a->free_list = b;
+	if (a->free_cnt++ == 0)
+		list_push_front (&d->partial, &a->elem);
+
+	if (a->free_cnt >= d->blocks_per_arena) {
+		ASSERT (a->free_cnt == d->blocks_per_arena);
+		list_remove (&a->elem);
+		list_remove (&a->all_elem);
+		d->arena_cnt--;
+		palloc_free_page (a);
+	}
+}
+
+/* Obtains a block from D, through the current CPU's magazine.
+   Returns a null pointer if memory is not available. */
+static void *
+cache_get (struct kmem_cache *d) {
+	struct block *batch[MAG_BATCH];
+	struct magazine *m;
+	enum intr_level old_level;
+	struct block *b = NULL;
+	size_t cnt, i;
+
+	old_level = intr_disable ();
+	m = &d->mags[this_cpu ()->id];
+	if (m->cnt > 0)
+		b = m->blocks[--m->cnt];
+	intr_set_level (old_level);
+	if (b != NULL)
+		return b;
+
+	/* The magazine is empty: refill it from the arenas.  Taking
+	   the lock may block, so the batch is gathered first and only
+	   then put in the magazine, which may no longer be empty. */
+	lock_acquire (&d->lock);
+	for (cnt = 0; cnt < MAG_BATCH; cnt++)
+		if ((batch[cnt] = arena_get_block (d)) == NULL)
+			break;
+	lock_release (&d->lock);
+	if (cnt == 0)
+		return NULL;
+
+	old_level = intr_disable ();
+	m = &d->mags[this_cpu ()->id];
+	for (i = 1; i < cnt && m->cnt < MAG_SIZE; i++)
+		m->blocks[m->cnt++] = batch[i];
+	intr_set_level (old_level);
+
+	if (i < cnt) {
+		lock_acquire (&d->lock);
+		for (; i < cnt; i++)
+			arena_put_block (d, batch[i]);
+		lock_release (&d->lock);
+	}
+	return batch[0];
+}
+
+/* Obtains a block from D allocated at PC and accounts for it.
+   Returns a null pointer if memory is not available. */
+static void *
+cache_alloc (struct kmem_cache *d, void *pc) {
+	struct block *b = cache_get (d);
+
+	if (b == NULL)
+		return NULL;
+	if (d->tag_ofs != 0)
+		*block_tag (d, b) = pc;
+
+	spin_lock (&heap_lock);
+	d->allocs++;
+	if (++d->in_use > d->peak)
+		d->peak = d->in_use;
+	heap_account (d->obj_size);
+	spin_unlock (&heap_lock);
+	return b;
+}
+
+/* Returns block B to D, through the current CPU's magazine. */
+static void
+cache_free (struct kmem_cache *d, struct block *b) {
+	struct block *batch[MAG_BATCH];
+	struct magazine *m;
+	enum intr_level old_level;
+	size_t cnt = 0, i;
 
 #ifndef NDEBUG
-			/* Clear the block to help detect use-after-free bugs. */
-			memset (b, 0xcc, d->block_size);
+	/* Clear the block to help detect use-after-free bugs, unless
+	   it must stay constructed. */
+	if (d->ctor == NULL)
+		memset (b, 0xcc, d->block_size);
 #endif
+	if (d->tag_ofs != 0)
+		*block_tag (d, b) = NULL;
+
+	/* If the magazine is full, its MAG_BATCH least recently freed
+	   blocks go back to their arenas. */
+	spin_lock (&heap_lock);
+	d->in_use--;
+	heap_account (-(int64_t) d->obj_size);
+	spin_unlock (&heap_lock);
+
+	old_level = intr_disable ();
+	m = &d->mags[this_cpu ()->id];
+	if (m->cnt == MAG_SIZE) {
+		cnt = MAG_BATCH;
+		memcpy (batch, m->blocks, sizeof batch);
+		memmove (m->blocks, m->blocks + MAG_BATCH,
+				(MAG_SIZE - MAG_BATCH) * sizeof *m->blocks);
+		m->cnt -= MAG_BATCH;
+	}
+	m->blocks[m->cnt++] = b;
+	intr_set_level (old_level);
+
+	if (cnt > 0) {
+		lock_acquire (&d->lock);
+		for (i = 0; i < cnt; i++)
+			arena_put_block (d, batch[i]);
+		lock_release (&d->lock);
+	}
+}
 
-			lock_acquire (&d->lock);
+/* Fills in the heap fields of MS. */
+void
+malloc_get_stats (struct memstat *ms) {
+	struct list_elem *e;
+
+	spin_lock (&heap_lock);
+	ms->heap_bytes = heap_bytes;
+	ms->heap_peak = heap_peak;
+	ms->heap_big_pages = big_pages;
+	ms->heap_arenas = 0;
+	for (e = list_begin (&caches); e != list_end (&caches); e = list_next (e))
+		ms->heap_arenas += list_entry (e, struct kmem_cache, cache_elem)->arena_cnt;
+	spin_unlock (&heap_lock);
+}
 
-			/* Add block to free list. */
-			list_push_front (&d->free_list, &b->free_elem);
+/* Allocation site, for malloc_print_stats(). */
+struct malloc_site {
+	void *pc;                   /* Caller of the allocator. */
+	size_t cnt;                 /* Live blocks. */
+	size_t bytes;               /* Their total size. */
+};
 
-			/* If the arena is now entirely unused, free it. */
-			if (++a->free_cnt >= d->blocks_per_arena) {
-				size_t i;
+#define MALLOC_SITE_CNT 32      /* Most sites reported individually. */
 
-				ASSERT (a->free_cnt == d->blocks_per_arena);
-				for (i = 0; i < d->blocks_per_arena; i++) {
-					struct block *b = arena_to_block (a, i);
-					list_remove (&b->free_elem);
-				}
-				palloc_free_page (a);
-			}
+/* Counts a live block of BYTES bytes allocated at PC in SITES,
+   which has room for MALLOC_SITE_CNT sites and *SITE_CNT in use.
+   The last slot collects whatever does not fit. */
+static void
+count_site (struct malloc_site sites[], size_t *site_cnt, void *pc,
+		size_t bytes) {
+	size_t i;
 
-			lock_release (&d->lock);
-		} else {
-			/* It's a big block.  Free its pages. */
-			palloc_free_multiple (a, a->free_cnt);
-			return;
+	for (i = 0; i < *site_cnt; i++)
+		if (sites[i].pc == pc)
+			break;
+	if (i == *site_cnt) {
+		if (*site_cnt < MALLOC_SITE_CNT)
+			sites[(*site_cnt)++] = (struct malloc_site) { pc, 0, 0 };
+		else {
+			i = MALLOC_SITE_CNT - 1;
+			sites[i].pc = NULL;
 		}
 	}
+	sites[i].cnt++;
+	sites[i].bytes += bytes;
 }
-
+
+/* Prints heap statistics: totals, each cache that has been used,
+   and, with -mtags, live blocks by allocation site. */
+void
+malloc_print_stats (void) {
+	static struct malloc_site sites[MALLOC_SITE_CNT];
+	struct memstat ms;
+	struct list_elem *e;
+	size_t site_cnt = 0, i;
+
+	malloc_get_stats (&ms);
+	printf ("Heap: %"PRIu64" bytes in use (peak %"PRIu64"), "
+			"%"PRIu64" arena pages, %"PRIu64" big block pages\n",
+			ms.heap_bytes, ms.heap_peak, ms.heap_arenas, ms.heap_big_pages);
+
+	for (e = list_begin (&caches); e != list_end (&caches); e = list_next (e)) {
+		struct kmem_cache *d = list_entry (e, struct kmem_cache, cache_elem);
+
+		if (d->allocs == 0)
+			continue;
+		printf ("  %s-%zu: %"PRId64" in use (peak %"PRId64"), "
+				"%"PRId64" free, %zu arenas\n",
+				d->name, d->obj_size, d->in_use, d->peak,
+				(int64_t) (d->arena_cnt * d->blocks_per_arena) - d->in_use,
+				d->arena_cnt);
+	}
+
+	if (!malloc_tags)
+		return;
+
+	/* Walk every carved block of every arena; free ones have a null
+	   tag.  This runs at power off or from a debugger, so it does
+	   not bother with locks. */
+	for (e = list_begin (&caches); e != list_end (&caches); e = list_next (e)) {
+		struct kmem_cache *d = list_entry (e, struct kmem_cache, cache_elem);
+		struct list_elem *ae;
+
+		for (ae = list_begin (&d->arenas); ae != list_end (&d->arenas);
+				ae = list_next (ae)) {
+			struct arena *a = list_entry (ae, struct arena, all_elem);
+
+			for (i = 0; i < a->carved; i++) {
+				void *pc = *block_tag (d, arena_to_block (a, i));
+				if (pc != NULL)
+					count_site (sites, &site_cnt, pc, d->obj_size);
+			}
+		}
+	}
+	for (e = list_begin (&big_blocks); e != list_end (&big_blocks);
+			e = list_next (e)) {
+		struct arena *a = list_entry (e, struct arena, all_elem);
+		count_site (sites, &site_cnt, a->tag, PGSIZE * a->free_cnt - sizeof *a);
+	}
+
+	printf ("Live heap blocks by allocation site:\n");
+	for (i = 0; i < site_cnt; i++)
+		if (sites[i].pc != NULL)
+			printf ("  %p: %zu blocks, %zu bytes\n",
+					sites[i].pc, sites[i].cnt, sites[i].bytes);
+		else
+			printf ("  other: %zu blocks, %zu bytes\n",
+					sites[i].cnt, sites[i].bytes);
+}
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b) {
@@ -250,7 +760,7 @@ block_to_arena (struct block *b) {
 
 	/* Check that the block is properly aligned for the arena. */
 	ASSERT (a->desc == NULL
-			|| (pg_ofs (b) - sizeof *a) % a->desc->block_size == 0);
+			|| (pg_ofs (b) - a->desc->first_ofs) % a->desc->block_size == 0);
 	ASSERT (a->desc != NULL || pg_ofs (b) == sizeof *a);
 
 	return a;
@@ -263,6 +773,6 @@ arena_to_block (struct arena *a, size_t idx) {
 	ASSERT (a->magic == ARENA_MAGIC);
 	ASSERT (idx < a->desc->blocks_per_arena);
 	return (struct block *) ((uint8_t *) a
-			+ sizeof *a
+			+ a->desc->first_ofs
 			+ idx * a->desc->block_size);
 }
@@ -1,13 +1,184 @@
+#include <hash.h>
+#include <ohash.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <string.h>
+#include "threads/apic.h"
+#include "threads/atomic.h"
+#include "threads/cpu.h"
 #include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/pte.h"
 #include "threads/palloc.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
 #include "intrinsic.h"
 
+static bool pml4_is_active (uint64_t *pml4);
+static void pcid_forget (uint64_t *pml4);
+static void tlb_shootdown (void);
+
+/* Page-table page pools.
+ *
+ * Each CPU keeps up to PT_POOL_MAX pages for page tables, all zeros,
+ * that pml4_reset() gave back when a process ran exec().  The page
+ * tables of the new program come from there first, so that an exec
+ * rebuilds its tables without going to the page allocator or clearing
+ * whole pages. */
+#define PT_POOL_MAX 32
+
+struct pt_pool {
+	void *pages[PT_POOL_MAX];           /* Zeroed pages. */
+	size_t cnt;                         /* Number of PAGES in use. */
+};
+
+static struct pt_pool pt_pools[NCPU];
+
+/* Returns a zeroed page for a page table, or a null pointer if
+ * memory is short. */
+static void *
+pt_alloc (void) {
+	enum intr_level old_level = intr_disable ();
+	struct pt_pool *pool = &pt_pools[this_cpu ()->id];
+	void *page = pool->cnt > 0 ? pool->pages[--pool->cnt] : NULL;
+
+	intr_set_level (old_level);
+	return page != NULL ? page : palloc_get_page (PAL_ZERO);
+}
+
+/* Frees PAGE, a page table page that contains only zeros. */
+static void
+pt_free (void *page) {
+	enum intr_level old_level = intr_disable ();
+	struct pt_pool *pool = &pt_pools[this_cpu ()->id];
+
+	if (pool->cnt < PT_POOL_MAX) {
+		pool->pages[pool->cnt++] = page;
+		page = NULL;
+	}
+	intr_set_level (old_level);
+	if (page != NULL)
+		palloc_free_page (page);
+}
+
+/* Pages shared between page tables.
+ *
+ * Without virtual memory, fork() gives the child a copy of each of
+ * the parent's pages.  A read-only page can never change, though,
+ * so the child maps the parent's page instead, and no page is
+ * allocated or copied for it.  Every PTE that maps such a page has
+ * PTE_SHARED set, and SHARED_PAGES counts the PTEs mapping it, so
+ * that destroying a page table frees the page only with its last
+ * mapping.  A page mapped only once is not in SHARED_PAGES. */
+struct shared_page {
+	struct ohash_elem elem;             /* Element in shared_pages. */
+	void *kpage;                        /* Kernel address of the page. */
+	int refs;                           /* PTEs that map it. */
+};
+
+static struct ohash shared_pages;
+static struct lock shared_lock;
+static struct kmem_cache *shared_page_cache;
+
+static void user_page_free (uint64_t pte);
+
+/* Returns the hash of shared page E. */
+static uint64_t
+shared_page_hash (const struct ohash_elem *e, void *aux UNUSED) {
+	return hash_ptr (ohash_entry (e, struct shared_page, elem)->kpage);
+}
+
+/* Returns true if shared page A is at a lower address than B. */
+static bool
+shared_page_less (const struct ohash_elem *a, const struct ohash_elem *b,
+		void *aux UNUSED) {
+	return ohash_entry (a, struct shared_page, elem)->kpage
+		< ohash_entry (b, struct shared_page, elem)->kpage;
+}
+
+/* Returns the entry for KPAGE in shared_pages, or a null pointer.
+ * shared_lock must be held. */
+static struct shared_page *
+shared_page_find (void *kpage) {
+	struct shared_page key;
+	struct ohash_elem *e;
+
+	key.kpage = kpage;
+	e = ohash_find (&shared_pages, &key.elem);
+	return e != NULL ? ohash_entry (e, struct shared_page, elem) : NULL;
+}
+
+/* Initializes the table of shared pages. */
+void
+pml4_share_init (void) {
+	if (!ohash_init (&shared_pages, shared_page_hash, shared_page_less, NULL))
+		PANIC ("pml4_share_init: out of memory");
+	lock_init (&shared_lock);
+	shared_page_cache = kmem_cache_create ("shared_page",
+			sizeof (struct shared_page), 0, NULL);
+}
+
+/* Maps user virtual page UPAGE in PML4, read-only, to the page that
+ * SRC_PTE, a present read-only user PTE of another page table, maps,
+ * instead of to a copy of it.  Returns true if successful, false if
+ * memory allocation fails. */
+bool
+pml4_share_page (uint64_t *pml4, void *upage, uint64_t *src_pte) {
+	void *kpage = ptov (PTE_ADDR (*src_pte));
+	struct shared_page *sp;
+	uint64_t *pte;
+
+	ASSERT ((*src_pte & (PTE_P | PTE_U | PTE_W)) == (PTE_P | PTE_U));
+	ASSERT (pml4 != base_pml4);
+
+	pte = pml4e_walk (pml4, (uint64_t) upage, 1);
+	if (pte == NULL)
+		return false;
+
+	lock_acquire (&shared_lock);
+	sp = shared_page_find (kpage);
+	if (sp == NULL) {
+		sp = kmem_cache_alloc (shared_page_cache);
+		if (sp == NULL) {
+			lock_release (&shared_lock);
+			return false;
+		}
+		sp->kpage = kpage;
+		sp->refs = 1;
+		ohash_insert (&shared_pages, &sp->elem);
+		*src_pte |= PTE_SHARED;
+	}
+	sp->refs++;
+	*pte = PTE_ADDR (*src_pte) | PTE_SHARED | PTE_U | PTE_P;
+	lock_release (&shared_lock);
+	return true;
+}
+
+/* Frees the user page that PTE maps, unless it is shared and still
+ * mapped by another PTE. */
+static void
+user_page_free (uint64_t pte) {
+	void *kpage = ptov (PTE_ADDR (pte));
+
+	if (pte & PTE_SHARED) {
+		struct shared_page *sp;
+
+		lock_acquire (&shared_lock);
+		sp = shared_page_find (kpage);
+		if (sp != NULL && --sp->refs > 0)
+			kpage = NULL;
+		else if (sp != NULL) {
+			ohash_delete (&shared_pages, &sp->elem);
+			kmem_cache_free (shared_page_cache, sp);
+		}
+		lock_release (&shared_lock);
+	}
+	if (kpage != NULL)
+		palloc_free_page (kpage);
+}
+
 static uint64_t *
 pgdir_walk (uint64_t *pdp, const uint64_t va, int create) {
 	int idx = PDX (va);
@@ -15,7 +186,7 @@ pgdir_walk (uint64_t *pdp, const uint64_t va, int create) {
 		uint64_t *pte = (uint64_t *) pdp[idx];
 		if (!((uint64_t) pte & PTE_P)) {
 			if (create) {
-				uint64_t *new_page = palloc_get_page (PAL_ZERO);
+				uint64_t *new_page = pt_alloc ();
 				if (new_page)
 					pdp[idx] = vtop (new_page) | PTE_U | PTE_W | PTE_P;
 				else
@@ -23,6 +194,9 @@ pgdir_walk (uint64_t *pdp, const uint64_t va, int create) {
 			} else
 				return NULL;
 		}
+		/* A large page has no page table, hence no PTE. */
+		if (pdp[idx] & PTE_PS)
+			return NULL;
 		return (uint64_t *) ptov (PTE_ADDR (pdp[idx]) + 8 * PTX (va));
 	}
 	return NULL;
@@ -37,7 +211,7 @@ pdpe_walk (uint64_t *pdpe, const uint64_t va, int create) {
 		uint64_t *pde = (uint64_t *) pdpe[idx];
 		if (!((uint64_t) pde & PTE_P)) {
 			if (create) {
-				uint64_t *new_page = palloc_get_page (PAL_ZERO);
+				uint64_t *new_page = pt_alloc ();
 				if (new_page) {
 					pdpe[idx] = vtop (new_page) | PTE_U | PTE_W | PTE_P;
 					allocated = 1;
@@ -46,10 +220,12 @@ pdpe_walk (uint64_t *pdpe, const uint64_t va, int create) {
 			} else
 				return NULL;
 		}
+		if (pdpe[idx] & PTE_PS)
+			return NULL;
 		pte = pgdir_walk (ptov (PTE_ADDR (pdpe[idx])), va, create);
 	}
 	if (pte == NULL && allocated) {
-		palloc_free_page ((void *) ptov (PTE_ADDR (pdpe[idx])));
+		pt_free ((void *) ptov (PTE_ADDR (pdpe[idx])));
 		pdpe[idx] = 0;
 	}
 	return pte;
@@ -70,7 +246,7 @@ pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
 		uint64_t *pdpe = (uint64_t *) pml4e[idx];
 		if (!((uint64_t) pdpe & PTE_P)) {
 			if (create) {
-				uint64_t *new_page = palloc_get_page (PAL_ZERO);
+				uint64_t *new_page = pt_alloc ();
 				if (new_page) {
 					pml4e[idx] = vtop (new_page) | PTE_U | PTE_W | PTE_P;
 					allocated = 1;
@@ -82,12 +258,89 @@ pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
 		pte = pdpe_walk (ptov (PTE_ADDR (pml4e[idx])), va, create);
 	}
 	if (pte == NULL && allocated) {
-		palloc_free_page ((void *) ptov (PTE_ADDR (pml4e[idx])));
+		pt_free ((void *) ptov (PTE_ADDR (pml4e[idx])));
 		pml4e[idx] = 0;
 	}
 	return pte;
 }
 
+/* Returns the next level table that page table entry *E points
+ * to, first allocating an empty one if E is not present.  Returns
+ * a null pointer if memory allocation fails. */
+static uint64_t *
+table_get (uint64_t *e) {
+	if (!(*e & PTE_P)) {
+		uint64_t *new_page = pt_alloc ();
+		if (new_page == NULL)
+			return NULL;
+		*e = vtop (new_page) | PTE_U | PTE_W | PTE_P;
+	}
+	ASSERT (!(*e & PTE_PS));
+	return ptov (PTE_ADDR (*e));
+}
+
+/* Maps the SIZE bytes at virtual address VA in PML4 to physical
+ * address PA with a single large page, where SIZE is LARGE_PGSIZE
+ * (one PDE) or HUGE_PGSIZE (one PDPE).  VA and PA must be aligned
+ * to SIZE, and nothing may be mapped there yet.  PERM holds the
+ * PTE_* permission bits.  Returns true if successful, false if
+ * memory allocation failed. */
+bool
+pml4_map_large (uint64_t *pml4, uint64_t va, uint64_t pa, uint64_t size,
+		uint64_t perm) {
+	uint64_t *pdpe, *pgdir;
+
+	ASSERT (size == LARGE_PGSIZE || size == HUGE_PGSIZE);
+	ASSERT (va % size == 0 && pa % size == 0);
+
+	pdpe = table_get (&pml4[PML4 (va)]);
+	if (pdpe == NULL)
+		return false;
+	if (size == HUGE_PGSIZE) {
+		ASSERT (!(pdpe[PDPE (va)] & PTE_P));
+		pdpe[PDPE (va)] = pa | perm | PTE_PS | PTE_P;
+		return true;
+	}
+
+	pgdir = table_get (&pdpe[PDPE (va)]);
+	if (pgdir == NULL)
+		return false;
+	ASSERT (!(pgdir[PDX (va)] & PTE_P));
+	pgdir[PDX (va)] = pa | perm | PTE_PS | PTE_P;
+	return true;
+}
+
+/* Replaces the large page that maps the LARGE_PGSIZE bytes at VA in
+ * PML4 by page table PT, a kernel page, filled in to map the same
+ * memory with 4 kB pages, each with the large page's permissions and
+ * accessed and dirty bits.  The pages can then be unmapped or
+ * protected one by one.  PT is supplied by the caller so that this
+ * cannot fail. */
+void
+pml4_split_large (uint64_t *pml4, uint64_t va, uint64_t *pt) {
+	uint64_t *pdpe, *pgdir, pde;
+
+	ASSERT (va % LARGE_PGSIZE == 0);
+	ASSERT (pml4[PML4 (va)] & PTE_P);
+
+	pdpe = ptov (PTE_ADDR (pml4[PML4 (va)]));
+	ASSERT ((pdpe[PDPE (va)] & (PTE_P | PTE_PS)) == PTE_P);
+	pgdir = ptov (PTE_ADDR (pdpe[PDPE (va)]));
+	pde = pgdir[PDX (va)];
+	ASSERT ((pde & (PTE_P | PTE_PS)) == (PTE_P | PTE_PS));
+
+	for (size_t i = 0; i < PGSIZE / sizeof *pt; i++)
+		pt[i] = (PTE_ADDR (pde) + i * PGSIZE)
+			| (pde & (PTE_U | PTE_W | PTE_A | PTE_D | PTE_P));
+	pgdir[PDX (va)] = vtop (pt) | PTE_U | PTE_W | PTE_P;
+
+	/* One invlpg drops the whole large page's TLB entry. */
+	if (pml4_is_active (pml4))
+		invlpg (va);
+	else
+		pcid_forget (pml4);
+}
+
 /* Creates a new page map level 4 (pml4) has mappings for kernel
  * virtual addresses, but none for user virtual addresses.
  * Returns the new page directory, or a null pointer if memory
@@ -122,7 +375,8 @@ pgdir_for_each (uint64_t *pdp, pte_for_each_func *func, void *aux,
 		unsigned pml4_index, unsigned pdp_index) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pte) & PTE_P)
+		/* Large pages have no PTEs to visit. */
+		if (((uint64_t) pte) & PTE_P && !(((uint64_t) pte) & PTE_PS))
 			if (!pt_for_each ((uint64_t *) PTE_ADDR (pte), func, aux,
 					pml4_index, pdp_index, i))
 				return false;
@@ -135,7 +389,7 @@ pdp_for_each (uint64_t *pdp,
 		pte_for_each_func *func, void *aux, unsigned pml4_index) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pde = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pde) & PTE_P)
+		if (((uint64_t) pde) & PTE_P && !(((uint64_t) pde) & PTE_PS))
 			if (!pgdir_for_each ((uint64_t *) PTE_ADDR (pde), func,
 					 aux, pml4_index, i))
 				return false;
@@ -155,39 +409,46 @@ pml4_for_each (uint64_t *pml4, pte_for_each_func *func, void *aux) {
 	return true;
 }
 
+/* The destroy functions below free the page tables under them, and
+ * the pages those map as well if FREE_PAGES is true. */
 static void
-pt_destroy (uint64_t *pt) {
-	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
-		uint64_t *pte = ptov((uint64_t *) pt[i]);
-		if (((uint64_t) pte) & PTE_P)
-			palloc_free_page ((void *) PTE_ADDR (pte));
-	}
+pt_destroy (uint64_t *pt, bool free_pages) {
+	for (unsigned i = 0; free_pages && i < PGSIZE / sizeof(uint64_t *); i++)
+		if (pt[i] & PTE_P)
+			user_page_free (pt[i]);
 	palloc_free_page ((void *) pt);
 }
 
 static void
-pgdir_destroy (uint64_t *pdp) {
+pgdir_destroy (uint64_t *pdp, bool free_pages) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pte) & PTE_P)
-			pt_destroy (PTE_ADDR (pte));
+		if (((uint64_t) pte) & PTE_P && ((uint64_t) pte) & PTE_PS) {
+			if (free_pages)
+				palloc_free_multiple ((void *) PTE_ADDR (pte),
+						LARGE_PGSIZE / PGSIZE);
+		} else if (((uint64_t) pte) & PTE_P)
+			pt_destroy (PTE_ADDR (pte), free_pages);
 	}
 	palloc_free_page ((void *) pdp);
 }
 
 static void
-pdpe_destroy (uint64_t *pdpe) {
+pdpe_destroy (uint64_t *pdpe, bool free_pages) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pde = ptov((uint64_t *) pdpe[i]);
-		if (((uint64_t) pde) & PTE_P)
-			pgdir_destroy ((void *) PTE_ADDR (pde));
+		if (((uint64_t) pde) & PTE_P && ((uint64_t) pde) & PTE_PS) {
+			if (free_pages)
+				palloc_free_multiple ((void *) PTE_ADDR (pde),
+						HUGE_PGSIZE / PGSIZE);
+		} else if (((uint64_t) pde) & PTE_P)
+			pgdir_destroy ((void *) PTE_ADDR (pde), free_pages);
 	}
 	palloc_free_page ((void *) pdpe);
 }
 
-/* Destroys pml4e, freeing all the pages it references. */
-void
-pml4_destroy (uint64_t *pml4) {
+static void
+pml4e_destroy (uint64_t *pml4, bool free_pages) {
 	if (pml4 == NULL)
 		return;
 	ASSERT (pml4 != base_pml4);
@@ -195,15 +456,324 @@ pml4_destroy (uint64_t *pml4) {
 	/* if PML4 (vaddr) >= 1, it's kernel space by define. */
 	uint64_t *pdpe = ptov ((uint64_t *) pml4[0]);
 	if (((uint64_t) pdpe) & PTE_P)
-		pdpe_destroy ((void *) PTE_ADDR (pdpe));
+		pdpe_destroy ((void *) PTE_ADDR (pdpe), free_pages);
+	pcid_forget (pml4);
 	palloc_free_page ((void *) pml4);
 }
 
+/* Destroys pml4e, freeing all the pages it references. */
+void
+pml4_destroy (uint64_t *pml4) {
+	pml4e_destroy (pml4, true);
+}
+
+/* Destroys PML4 like pml4_destroy(), but frees only its page tables,
+ * not the pages they map, for when those are owned and freed by
+ * someone else.  The PTEs need not have been cleared, which saves a
+ * walk and a TLB flush per page when a process exits. */
+void
+pml4_destroy_tables (uint64_t *pml4) {
+	pml4e_destroy (pml4, false);
+}
+
+/* The reset functions below empty a page table, clearing each
+ * present entry, and give the page tables under it to pt_free() all
+ * zeros again.  The pages those map are freed as well if FREE_PAGES
+ * is true. */
+static void
+pt_reset (uint64_t *pt, bool free_pages) {
+	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++)
+		if (pt[i] != 0) {
+			if (free_pages && (pt[i] & PTE_P))
+				user_page_free (pt[i]);
+			pt[i] = 0;
+		}
+}
+
+static void
+pgdir_reset (uint64_t *pgdir, bool free_pages) {
+	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
+		uint64_t pde = pgdir[i];
+
+		if (!(pde & PTE_P))
+			continue;
+		if (pde & PTE_PS) {
+			if (free_pages)
+				palloc_free_multiple (ptov (PTE_ADDR (pde)),
+						LARGE_PGSIZE / PGSIZE);
+		} else {
+			pt_reset (ptov (PTE_ADDR (pde)), free_pages);
+			pt_free (ptov (PTE_ADDR (pde)));
+		}
+		pgdir[i] = 0;
+	}
+}
+
+static void
+pdpe_reset (uint64_t *pdpe, bool free_pages) {
+	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
+		uint64_t pdpte = pdpe[i];
+
+		if (!(pdpte & PTE_P))
+			continue;
+		if (pdpte & PTE_PS) {
+			if (free_pages)
+				palloc_free_multiple (ptov (PTE_ADDR (pdpte)),
+						HUGE_PGSIZE / PGSIZE);
+		} else {
+			pgdir_reset (ptov (PTE_ADDR (pdpte)), free_pages);
+			pt_free (ptov (PTE_ADDR (pdpte)));
+		}
+		pdpe[i] = 0;
+	}
+}
+
+/* Empties the user half of PML4, keeping PML4 itself, its kernel
+ * half and the top-level table of its user half, for exec() to build
+ * the new program's mappings in.  The lower level tables go to this
+ * CPU's pool for that.  Every TLB entry for the old mappings is
+ * dropped. */
+static void
+pml4e_reset (uint64_t *pml4, bool free_pages) {
+	ASSERT (pml4 != NULL && pml4 != base_pml4);
+
+	/* if PML4 (vaddr) >= 1, it's kernel space by define. */
+	if (pml4[0] & PTE_P)
+		pdpe_reset (ptov (PTE_ADDR (pml4[0])), free_pages);
+	pcid_forget (pml4);
+	if (pml4_is_active (pml4))
+		lcr3 (rcr3 ());
+	tlb_shootdown ();
+}
+
+/* Empties the user half of PML4, freeing all the pages it
+ * references. */
+void
+pml4_reset (uint64_t *pml4) {
+	pml4e_reset (pml4, true);
+}
+
+/* Empties the user half of PML4 like pml4_reset(), but does not free
+ * the pages it maps, as pml4_destroy_tables() does not. */
+void
+pml4_reset_tables (uint64_t *pml4) {
+	pml4e_reset (pml4, false);
+}
+
+/* Process-context identifiers.
+ *
+ * With CR4.PCIDE set, the CPU tags each TLB entry with the PCID in
+ * the low 12 bits of CR3, and a CR3 load with CR3_NOFLUSH set keeps
+ * the entries of every PCID.  Switching between processes then no
+ * longer throws away their translations.
+ *
+ * PCID 0 belongs to base_pml4.  The other slots are handed out round
+ * robin to page tables as they are activated.  A page table that
+ * lost its slot, or whose entries changed while it was not loaded,
+ * just gets a fresh slot with a flushing CR3 load the next time it
+ * runs, so the TLB never holds stale user entries for a PCID. */
+#define PCID_SLOTS 64
+#define CR3_NOFLUSH (1ULL << 63)
+#define CR4_PGE (1 << 7)
+#define CR4_PCIDE (1 << 17)
+
+struct pcid_cpu {
+	uint64_t *owner[PCID_SLOTS];        /* Page table using each PCID. */
+	int next;                           /* Next slot to recycle. */
+};
+
+static bool pcid_enabled;
+static struct pcid_cpu pcid_cpus[NCPU];
+static uint64_t tlb_cr4;            /* CR4 bits that tlb_init() set. */
+
+/* Enables global pages and, if the CPU has them, PCIDs.  Must be
+ * called while CR3 still holds PCID 0, that is, before the first
+ * pml4_activate(). */
+void
+tlb_init (void) {
+	uint32_t eax, ebx, ecx, edx;
+	uint64_t cr4 = rcr4 ();
+
+	cpuid (1, &eax, &ebx, &ecx, &edx);
+	if (edx & (1 << 13))
+		cr4 |= CR4_PGE;
+	if (ecx & (1 << 17)) {
+		cr4 |= CR4_PCIDE;
+		pcid_enabled = true;
+	}
+	lcr4 (cr4);
+	tlb_cr4 = cr4 & (CR4_PGE | CR4_PCIDE);
+	for (int i = 0; i < NCPU; i++)
+		pcid_cpus[i].next = 1;
+}
+
+/* Enables on an application processor what tlb_init() enabled on
+   the boot CPU.  CR3 must hold base_pml4 with PCID 0. */
+void
+tlb_init_ap (void) {
+	lcr4 (rcr4 () | tlb_cr4);
+}
+
+/* Returns true if PML4 is the page table loaded on this CPU. */
+static bool
+pml4_is_active (uint64_t *pml4) {
+	return PTE_ADDR (rcr3 ()) == vtop (pml4);
+}
+
+/* Drops every PCID slot held by PML4, so that its next activation
+ * flushes the TLB entries tagged with its PCID. */
+static void
+pcid_forget (uint64_t *pml4) {
+	enum intr_level old_level;
+
+	if (!pcid_enabled)
+		return;
+	old_level = intr_disable ();
+	for (int c = 0; c < NCPU; c++)
+		for (int i = 1; i < PCID_SLOTS; i++)
+			if (pcid_cpus[c].owner[i] == pml4)
+				pcid_cpus[c].owner[i] = NULL;
+	intr_set_level (old_level);
+}
+
+/* TLB invalidation batches.
+ *
+ * A caller that changes many PTEs of one page table brackets the
+ * changes with tlb_batch_begin() and tlb_batch_flush(), and calls
+ * tlb_batch_add() for each page whose old translation must go.
+ * The flush then issues one INVLPG per page, or a single CR3
+ * reload once more than TLB_BATCH_MAX pages were added, which is
+ * cheaper than that many INVLPGs.  A page table that is not loaded
+ * just gives up its PCID.  With more than one CPU, the others then
+ * get a single shootdown IPI for the whole batch. */
+
+/* Starts a batch of invalidations for PML4. */
+void
+tlb_batch_begin (struct tlb_batch *batch, uint64_t *pml4) {
+	batch->pml4 = pml4;
+	batch->cnt = 0;
+}
+
+/* Adds user virtual page VA to BATCH. */
+void
+tlb_batch_add (struct tlb_batch *batch, const void *va) {
+	if (batch->cnt < TLB_BATCH_MAX)
+		batch->va[batch->cnt] = pg_round_down (va);
+	batch->cnt++;
+}
+
+/* Invalidates the TLB entries for the pages in BATCH and empties
+ * it. */
+void
+tlb_batch_flush (struct tlb_batch *batch) {
+	if (batch->cnt == 0)
+		return;
+
+	if (!pml4_is_active (batch->pml4))
+		pcid_forget (batch->pml4);
+	else if (batch->cnt > TLB_BATCH_MAX)
+		/* Without CR3_NOFLUSH this drops all non-global entries of
+		 * the current PCID, which are exactly the user ones. */
+		lcr3 (rcr3 ());
+	else
+		for (size_t i = 0; i < batch->cnt; i++)
+			invlpg ((uint64_t) batch->va[i]);
+	batch->cnt = 0;
+	tlb_shootdown ();
+}
+
+/* TLB shootdowns.  A CPU sets the flag of every other CPU in
+ * shootdown_req and interrupts them, and each clears its flag once it
+ * has dropped the user entries of its TLB.  They drop all of them,
+ * for every PCID, which is much simpler than passing the pages along
+ * and, with invalidations batched, not much more expensive.  A CPU
+ * waiting to start a shootdown of its own serves the one in
+ * progress, since it may be waiting with interrupts off. */
+static int shootdown_req[NCPU];     /* Nonzero until each CPU acks. */
+static int shootdown_busy;          /* Nonzero while one is going on. */
+
+/* Carries out a shootdown requested from this CPU, if any: forgets
+ * every PCID slot, so that each page table gets a flushing load the
+ * next time it runs here, and flushes the running one's now. */
+static void
+tlb_shootdown_ack (void) {
+	int id = this_cpu ()->id;
+
+	if (atomic_xchg (&shootdown_req[id], 0) == 0)
+		return;
+	if (pcid_enabled)
+		for (int i = 1; i < PCID_SLOTS; i++)
+			pcid_cpus[id].owner[i] = NULL;
+	lcr3 (rcr3 ());
+}
+
+/* Makes every other CPU drop the user entries of its TLB and waits
+ * until they all have. */
+static void
+tlb_shootdown (void) {
+	enum intr_level old_level;
+	int self, c;
+
+	if (cpu_cnt == 1 || !apic_enabled ())
+		return;
+
+	old_level = intr_disable ();
+	while (atomic_xchg (&shootdown_busy, 1) != 0)
+		tlb_shootdown_ack ();
+	self = this_cpu ()->id;
+	for (c = 0; c < cpu_cnt; c++)
+		if (c != self)
+			atomic_xchg (&shootdown_req[c], 1);
+	apic_send_ipi_others (APIC_VEC_TLB);
+	for (c = 0; c < cpu_cnt; c++)
+		while (shootdown_req[c] != 0)
+			asm volatile ("pause" : : : "memory");
+	atomic_xchg (&shootdown_busy, 0);
+	intr_set_level (old_level);
+}
+
+/* Shootdown IPI handler. */
+void
+tlb_shootdown_interrupt (struct intr_frame *f UNUSED) {
+	tlb_shootdown_ack ();
+}
+
 /* Loads page directory PD into the CPU's page directory base
- * register. */
+ * register.  With PCIDs, reloading a page table that still owns its
+ * slot keeps its TLB entries. */
 void
 pml4_activate (uint64_t *pml4) {
-	lcr3 (vtop (pml4 ? pml4 : base_pml4));
+	struct pcid_cpu *pc;
+	enum intr_level old_level;
+	int i;
+
+	if (pml4 == NULL)
+		pml4 = base_pml4;
+	if (!pcid_enabled) {
+		lcr3 (vtop (pml4));
+		return;
+	}
+	if (pml4 == base_pml4) {
+		lcr3 (vtop (pml4) | CR3_NOFLUSH);
+		return;
+	}
+
+	old_level = intr_disable ();
+	pc = &pcid_cpus[this_cpu ()->id];
+	for (i = 1; i < PCID_SLOTS; i++)
+		if (pc->owner[i] == pml4) {
+			lcr3 (vtop (pml4) | i | CR3_NOFLUSH);
+			intr_set_level (old_level);
+			return;
+		}
+
+	/* Take over the next slot; the flushing load drops whatever
+	 * its previous owner left in the TLB. */
+	i = pc->next;
+	pc->next = i + 1 < PCID_SLOTS ? i + 1 : 1;
+	pc->owner[i] = pml4;
+	lcr3 (vtop (pml4) | i);
+	intr_set_level (old_level);
 }
 
 /* Looks up the physical address that corresponds to user virtual
@@ -258,17 +828,74 @@ pml4_set_page (uint64_t *pml4, void *upage, void *kpage, bool rw) {
  * UPAGE need not be mapped. */
 void
 pml4_clear_page (uint64_t *pml4, void *upage) {
-	uint64_t *pte;
+	pml4_clear_range (pml4, upage, 1);
+}
+
+/* Marks the CNT user virtual pages starting at UPAGE "not present"
+ * in PML4, like pml4_clear_page(), with one TLB invalidation for the
+ * whole range. */
+void
+pml4_clear_range (uint64_t *pml4, void *upage, size_t cnt) {
+	struct tlb_batch batch;
+	ASSERT (pg_ofs (upage) == 0);
+	ASSERT (is_user_vaddr (upage));
+
+	tlb_batch_begin (&batch, pml4);
+	for (size_t i = 0; i < cnt; i++) {
+		void *va = (uint8_t *) upage + i * PGSIZE;
+		uint64_t *pte = pml4e_walk (pml4, (uint64_t) va, false);
+
+		if (pte != NULL && (*pte & PTE_P) != 0) {
+			*pte &= ~PTE_P;
+			tlb_batch_add (&batch, va);
+		}
+	}
+	tlb_batch_flush (&batch);
+}
+
+/* Points the mapping of user virtual page UPAGE in PML4, which
+ * pml4_clear_page() made not present, at the frame KPAGE, and makes
+ * it present again.  The other bits in the page table entry,
+ * including the accessed and dirty bits, are preserved.  No TLB
+ * flush is needed, since a not present entry is never cached. */
+void
+pml4_move_page (uint64_t *pml4, void *upage, void *kpage) {
+	uint64_t *pte = pml4e_walk (pml4, (uint64_t) upage, false);
+
+	ASSERT (pg_ofs (kpage) == 0);
+	ASSERT (pte != NULL && (*pte & PTE_P) == 0);
+
+	*pte = (*pte & PTE_FLAGS) | vtop (kpage) | PTE_P;
+}
+
+/* Sets the writable bit to WRITABLE in the PTEs of the CNT user
+ * virtual pages starting at UPAGE in PML4, for example to
+ * write-protect a range for copy-on-write.  Unmapped pages are
+ * skipped. */
+void
+pml4_protect_range (uint64_t *pml4, void *upage, size_t cnt, bool writable) {
+	struct tlb_batch batch;
 	ASSERT (pg_ofs (upage) == 0);
 	ASSERT (is_user_vaddr (upage));
 
-	pte = pml4e_walk (pml4, (uint64_t) upage, false);
+	tlb_batch_begin (&batch, pml4);
+	for (size_t i = 0; i < cnt; i++) {
+		void *va = (uint8_t *) upage + i * PGSIZE;
+		uint64_t *pte = pml4e_walk (pml4, (uint64_t) va, false);
 
-	if (pte != NULL && (*pte & PTE_P) != 0) {
-		*pte &= ~PTE_P;
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) upage);
+		if (pte == NULL || (*pte & PTE_P) == 0
+				|| ((*pte & PTE_W) != 0) == writable)
+			continue;
+		if (writable)
+			*pte |= PTE_W;
+		else
+			*pte &= ~PTE_W;
+		/* Gaining a permission needs no invalidation: the CPU
+		 * rechecks the PTE before raising a fault. */
+		if (!writable)
+			tlb_batch_add (&batch, va);
 	}
+	tlb_batch_flush (&batch);
 }
 
 /* Returns true if the PTE for virtual page VPAGE in PML4 is dirty,
@@ -282,7 +909,9 @@ pml4_is_dirty (uint64_t *pml4, const void *vpage) {
 }
 
 /* Set the dirty bit to DIRTY in the PTE for virtual page VPAGE
- * in PML4. */
+ * in PML4.  Clearing it shoots down the other CPUs' entries too: one
+ * that still cached the page as dirty would write to it without
+ * setting the bit again, and the write would be lost on eviction. */
 void
 pml4_set_dirty (uint64_t *pml4, const void *vpage, bool dirty) {
 	uint64_t *pte = pml4e_walk (pml4, (uint64_t) vpage, false);
@@ -290,10 +919,14 @@ pml4_set_dirty (uint64_t *pml4, const void *vpage, bool dirty) {
 		if (dirty)
 			*pte |= PTE_D;
 		else
-			*pte &= ~(uint32_t) PTE_D;
+			*pte &= ~(uint64_t) PTE_D;
 
-		if (rcr3 () == vtop (pml4))
+		if (pml4_is_active (pml4))
 			invlpg ((uint64_t) vpage);
+		else
+			pcid_forget (pml4);
+		if (!dirty)
+			tlb_shootdown ();
 	}
 }
 
@@ -316,9 +949,11 @@ pml4_set_accessed (uint64_t *pml4, const void *vpage, bool accessed) {
 		if (accessed)
 			*pte |= PTE_A;
 		else
-			*pte &= ~(uint32_t) PTE_A;
+			*pte &= ~(uint64_t) PTE_A;
 
-		if (rcr3 () == vtop (pml4))
+		if (pml4_is_active (pml4))
 			invlpg ((uint64_t) vpage);
+		else
+			pcid_forget (pml4);
 	}
 }
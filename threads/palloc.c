@@ -2,14 +2,21 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
+#include <memstat.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
+#include "threads/fpu.h"
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
+#include "threads/spinlock.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
 
 /* Page allocator.  Hands out memory in page-size (or
@@ -24,13 +31,79 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Within a pool, free pages are managed by a binary buddy
+   allocator.  Free memory is kept as blocks of 2**ORDER pages,
+   each aligned to its own size in physical page numbers, on one
+   free list per order.  An allocation takes the smallest block
+   that fits, splitting larger blocks as needed, and gives back
+   any pages beyond the request.  A freed block is merged with its
+   buddy, the other half of the block it was split from, for as
+   long as the buddy is also free.  Both take O(lg n) time no
+   matter how fragmented the pool is.  The used_map still records
+   which pages are allocated, for sanity checks.
+
+   Single pages, by far the most common request, usually do not
+   reach the buddy allocator at all.  Each CPU keeps a small LIFO
+   cache of recently freed pages per pool, refilled from and
+   drained to the pool PCP_BATCH pages at a time.  The cache is
+   only touched by its own CPU with interrupts off, so it needs no
+   lock, and the page handed out is the one most likely to still
+   be in the CPU's cache.  Cached pages count as allocated in
+   used_map.
+
+   PAL_ZERO requests for single pages are served from a list of
+   pages that the "pagezero" kernel thread has already cleared.
+   That thread runs at PRI_MIN, so it only zeroes pages while
+   nothing else wants the CPU, and refills each list back up to
+   ZERO_HIGH whenever it drains below ZERO_LOW.  Pre-zeroed pages
+   are handed out to ordinary requests too once the pool itself
+   runs dry, so they never make memory unavailable.
+
+   Caches of the kernel may borrow pages of the user pool while it
+   has plenty, so that memory that user processes leave idle is not
+   wasted.  Each registers a struct shrinker, and a request for user
+   pages that the pool cannot meet asks them to give pages back
+   before it fails, as kswapd does when free pages run low. */
+
+/* Number of buddy orders: blocks range from 1 page up to
+   2**(BUDDY_ORDERS - 1) pages (4 MB). */
+#define BUDDY_ORDERS 11
+
+/* Buddy allocator state of one page. */
+struct buddy_page {
+	struct list_elem elem;          /* Element in pool's free_lists[order]. */
+	int order;                      /* Order if first page of a free block,
+	                                   otherwise -1. */
+};
+
+/* Per-CPU page cache. */
+#define PCP_HIGH 32                 /* Most pages a cache holds. */
+#define PCP_BATCH 8                 /* Pages moved per refill or drain. */
+
+struct page_cache {
+	size_t cnt;                     /* Number of cached pages. */
+	void *pages[PCP_HIGH];          /* Cached pages, most recent last. */
+};
+
+/* Pre-zeroed pages. */
+#define ZERO_HIGH 64                /* Number of pages to keep zeroed. */
+#define ZERO_LOW 16                 /* Refill when fewer than this. */
 
 /* A memory pool. */
 struct pool {
 	struct lock lock;               /* Mutual exclusion. */
 	struct bitmap *used_map;        /* Bitmap of free pages. */
 	uint8_t *base;                  /* Base of pool. */
+	struct buddy_page *pages;       /* Buddy state, one per page. */
+	struct list free_lists[BUDDY_ORDERS]; /* Free blocks by order. */
+	size_t free_cnt;                /* Pages on the free lists. */
+	struct page_cache pcp[NCPU];    /* Per-CPU single page caches. */
+
+	struct spinlock zero_lock;      /* Protects the two below. */
+	size_t zero_cnt;                /* Number of pre-zeroed pages. */
+	void *zero_pages[ZERO_HIGH];    /* Pre-zeroed pages. */
 };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -40,10 +113,32 @@ static struct pool kernel_pool, user_pool;
 
 /* Maximum number of pages to put in user pool. */
 size_t user_page_limit = SIZE_MAX;
+
+/* Registered shrinkers, added at boot and never removed. */
+static struct list shrinkers;
+
 static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end);
 
 static bool page_from_pool (const struct pool *, void *page);
+static size_t buddy_alloc (struct pool *, size_t page_cnt);
+static void buddy_free (struct pool *, size_t page_idx, size_t page_cnt);
+static void buddy_delete (struct pool *, size_t page_idx);
+static void *pool_get (struct pool *, enum palloc_flags, size_t page_cnt);
+static void *pool_take (struct pool *, size_t page_cnt);
+static void pool_give (struct pool *, void *pages, size_t page_cnt);
+static void *pcp_get (struct pool *);
+static void pcp_put (struct pool *, void *page);
+static void pcp_drain (struct pool *);
+static void *zero_get (struct pool *);
+static void zero_drain (struct pool *);
+static void pagezero (void *);
+
+/* The pagezero thread waits here while every zero list is full.
+   ZEROER_SLEEPING is true while it does. */
+static struct semaphore zero_sema;
+static bool zeroer_started;
+static bool zeroer_sleeping;
 
 /* multiboot info */
 struct multiboot_info {
@@ -226,11 +321,13 @@ split:
 			if ((uint64_t) pool_end < end) {
 				page_cnt = ((uint64_t) pool_end - start) / PGSIZE;
 				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				buddy_free (pool, page_idx, page_cnt);
 				start = (uint64_t) pool_end;
 				goto split;
 			} else {
 				page_cnt = ((uint64_t) end - start) / PGSIZE;
 				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				buddy_free (pool, page_idx, page_cnt);
 			}
 		}
 	}
@@ -252,9 +349,53 @@ palloc_init (void) {
 	printf ("\text_mem: 0x%llx ~ 0x%llx (Usable: %'llu kB)\n",
 		  ext_mem.start, ext_mem.end, ext_mem.size / 1024);
 	populate_pools (&base_mem, &ext_mem);
+	list_init (&shrinkers);
+	lock_register (&kernel_pool.lock, "palloc kernel");
+	lock_register (&user_pool.lock, "palloc user");
 	return ext_mem.end;
 }
 
+/* Starts the thread that keeps pre-zeroed pages ready for
+   PAL_ZERO requests.  Until this is called, PAL_ZERO pages are
+   zeroed inline. */
+void
+palloc_zero_init (void) {
+	sema_init (&zero_sema, 0);
+	zeroer_started = true;
+	thread_create ("pagezero", PRI_MIN, pagezero, NULL);
+}
+
+/* Returns the number of free pages in POOL, counting those held
+   in its caches.  Does not lock, so the result is a snapshot. */
+static size_t
+pool_free_pages (const struct pool *pool) {
+	size_t cnt = pool->free_cnt + pool->zero_cnt;
+	size_t i;
+
+	for (i = 0; i < NCPU; i++)
+		cnt += pool->pcp[i].cnt;
+	return cnt;
+}
+
+/* Fills in the page counts of MS. */
+void
+palloc_get_stats (struct memstat *ms) {
+	ms->kernel_pages = bitmap_size (kernel_pool.used_map);
+	ms->kernel_free = pool_free_pages (&kernel_pool);
+	ms->user_pages = bitmap_size (user_pool.used_map);
+	ms->user_free = pool_free_pages (&user_pool);
+}
+
+/* Prints page allocator statistics. */
+void
+palloc_print_stats (void) {
+	printf ("Pages: kernel %zu/%zu used, user %zu/%zu used\n",
+			bitmap_size (kernel_pool.used_map) - pool_free_pages (&kernel_pool),
+			bitmap_size (kernel_pool.used_map),
+			bitmap_size (user_pool.used_map) - pool_free_pages (&user_pool),
+			bitmap_size (user_pool.used_map));
+}
+
 /* Obtains and returns a group of PAGE_CNT contiguous free pages.
    If PAL_USER is set, the pages are obtained from the user pool,
    otherwise from the kernel pool.  If PAL_ZERO is set in FLAGS,
@@ -265,28 +406,81 @@ void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
 	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool; // flags가 4여서 true이면 user_pool, false이면 kernel_pool
 
-	lock_acquire (&pool->lock);
-	size_t page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-	lock_release (&pool->lock);
 	void *pages;
 
-	if (page_idx != BITMAP_ERROR)
-		pages = pool->base + PGSIZE * page_idx; /* 원하는 page의 포인터. (Bytes in a page * page_idx) */
-	else
-		pages = NULL;
+	if (page_cnt == 0)
+		return NULL;
 
-	if (pages) {
-		if (flags & PAL_ZERO)
-			memset (pages, 0, PGSIZE * page_cnt); 
-			// 세팅하고자 하는 메모리 주소, 메모리에 세팅하고자 하는 값, 바이트 단위로 메모리의 크기 한 조각 단위의 길이
+	pages = pool_get (pool, flags, page_cnt);
+	/* Out of user pages: take back what the caches borrowed. */
+	while (pages == NULL && (flags & PAL_USER) && !intr_context ()
+			&& palloc_shrink (page_cnt) > 0)
+		pages = pool_get (pool, flags, page_cnt);
+
+	if (pages == NULL && (flags & PAL_ASSERT))
+		PANIC ("palloc_get: out of pages");
+	return pages;
+}
+
+/* Takes PAGE_CNT contiguous pages from POOL for a request with
+   FLAGS, zeroed if PAL_ZERO is set, and returns them, or a null
+   pointer if there are not enough. */
+static void *
+pool_get (struct pool *pool, enum palloc_flags flags, size_t page_cnt) {
+	void *pages;
+
+	if (page_cnt == 1 && (flags & PAL_ZERO)) {
+		pages = zero_get (pool);
+		if (pages != NULL)
+			return pages;
+	}
+
+	if (page_cnt == 1) {
+		pages = pcp_get (pool);
+		if (pages == NULL)
+			pages = zero_get (pool);
 	} else {
-		if (flags & PAL_ASSERT)
-			PANIC ("palloc_get: out of pages");
+		lock_acquire (&pool->lock);
+		pages = pool_take (pool, page_cnt);
+		lock_release (&pool->lock);
+
+		/* Pages sitting in our cache may be what keeps the run
+		   from forming; give them back and try once more. */
+		if (pages == NULL) {
+			pcp_drain (pool);
+			zero_drain (pool);
+			lock_acquire (&pool->lock);
+			pages = pool_take (pool, page_cnt);
+			lock_release (&pool->lock);
+		}
 	}
 
+	// 세팅하고자 하는 메모리 주소, 메모리에 세팅하고자 하는 값, 바이트 단위로 메모리의 크기 한 조각 단위의 길이
+	if (pages && (flags & PAL_ZERO))
+		for (size_t i = 0; i < page_cnt; i++)
+			fpu_zero_page ((uint8_t *) pages + i * PGSIZE);
 	return pages;
 }
 
+/* Adds SHRINKER to the caches asked for user pages back. */
+void
+palloc_register_shrinker (struct shrinker *shrinker) {
+	list_push_back (&shrinkers, &shrinker->elem);
+}
+
+/* Asks the registered shrinkers to give back PAGE_CNT pages of the
+   user pool, and returns how many they gave back, which may be more
+   or fewer. */
+size_t
+palloc_shrink (size_t page_cnt) {
+	size_t freed = 0;
+
+	for (struct list_elem *e = list_begin (&shrinkers);
+			e != list_end (&shrinkers) && freed < page_cnt; e = list_next (e))
+		freed += list_entry (e, struct shrinker, elem)->shrink (page_cnt - freed);
+	return freed;
+}
+
 /* Obtains a single free page and returns its kernel virtual
    address.
    If PAL_USER is set, the page is obtained from the user pool,
@@ -303,7 +497,6 @@ palloc_get_page (enum palloc_flags flags) {
 void
 palloc_free_multiple (void *pages, size_t page_cnt) {
 	struct pool *pool;
-	size_t page_idx;
 
 	ASSERT (pg_ofs (pages) == 0);
 	if (pages == NULL || page_cnt == 0)
@@ -316,13 +509,17 @@ palloc_free_multiple (void *pages, size_t page_cnt) {
 	else
 		NOT_REACHED ();
 
-	page_idx = pg_no (pages) - pg_no (pool->base);
-
 #ifndef NDEBUG
 	memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
-	ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+	if (page_cnt == 1) {
+		pcp_put (pool, pages);
+		return;
+	}
+
+	lock_acquire (&pool->lock);
+	pool_give (pool, pages, page_cnt);
+	lock_release (&pool->lock);
 }
 
 /* Frees the page at PAGE. */
@@ -331,6 +528,60 @@ palloc_free_page (void *page) {
 	palloc_free_multiple (page, 1);
 }
 
+/* Isolates the PAGE_CNT pages at BLOCK in the user pool, a block
+   of a power of 2 pages aligned to its size, for compaction.  If
+   exactly USED_CNT pages of the block are allocated, nonzero, takes
+   all of its free pages off the free lists, so that they belong to
+   the caller as if allocated, and returns true.  Otherwise returns
+   false without changing anything.
+
+   The caller moves the contents of the allocated pages elsewhere
+   and frees the whole block with palloc_free_multiple(), which
+   merges it into a single free block, or frees the pages it got
+   from this function if it gives up. */
+bool
+palloc_isolate (void *block, size_t page_cnt, size_t used_cnt) {
+	struct pool *pool = &user_pool;
+	size_t page_idx = pg_no (block) - pg_no (pool->base);
+	size_t i;
+	bool ok;
+
+	ASSERT (page_cnt > 0 && (page_cnt & (page_cnt - 1)) == 0);
+	ASSERT (pg_no (block) % page_cnt == 0);
+
+	if (used_cnt == 0 || !page_from_pool (pool, block)
+			|| !page_from_pool (pool, (uint8_t *) block
+				+ (page_cnt - 1) * PGSIZE))
+		return false;
+
+	/* Cached pages count as allocated. */
+	pcp_drain (pool);
+	zero_drain (pool);
+
+	lock_acquire (&pool->lock);
+	ok = bitmap_count (pool->used_map, page_idx, page_cnt, true) == used_cnt;
+	if (ok) {
+		/* Any free block that overlaps BLOCK lies inside it, since
+		   BLOCK itself is not wholly free, and starts at an aligned
+		   index that the walk reaches before its other pages. */
+		for (i = 0; i < page_cnt; ) {
+			int order = pool->pages[page_idx + i].order;
+
+			if (order < 0) {
+				i++;
+				continue;
+			}
+			buddy_delete (pool, page_idx + i);
+			pool->free_cnt -= (size_t) 1 << order;
+			bitmap_set_multiple (pool->used_map, page_idx + i,
+					(size_t) 1 << order, true);
+			i += (size_t) 1 << order;
+		}
+	}
+	lock_release (&pool->lock);
+	return ok;
+}
+
 /* Initializes pool P as starting at START and ending at END */
 static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
@@ -339,15 +590,24 @@ init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
      and subtract it from the pool's size. */
 	uint64_t pgcnt = (end - start) / PGSIZE;
 	size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (pgcnt), PGSIZE) * PGSIZE;
+	size_t buddy_pages = DIV_ROUND_UP (pgcnt * sizeof *p->pages, PGSIZE)
+		* PGSIZE;
+	size_t i;
 
 	lock_init(&p->lock);
+	spin_lock_init (&p->zero_lock);
 	p->used_map = bitmap_create_in_buf (pgcnt, *bm_base, bm_pages);
 	p->base = (void *) start;
+	p->pages = (struct buddy_page *) ((uint8_t *) *bm_base + bm_pages);
 
 	// Mark all to unusable.
 	bitmap_set_all(p->used_map, true);
+	for (i = 0; i < pgcnt; i++)
+		p->pages[i].order = -1;
+	for (i = 0; i < BUDDY_ORDERS; i++)
+		list_init (&p->free_lists[i]);
 
-	*bm_base += bm_pages;
+	*bm_base += bm_pages + buddy_pages;
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -359,3 +619,317 @@ page_from_pool (const struct pool *pool, void *page) {
 	size_t end_page = start_page + bitmap_size (pool->used_map);
 	return page_no >= start_page && page_no < end_page;
 }
+
+/* Puts the free block of 2**ORDER pages at PAGE_IDX in POOL on
+   its free list. */
+static void
+buddy_insert (struct pool *pool, size_t page_idx, int order) {
+	pool->pages[page_idx].order = order;
+	list_push_front (&pool->free_lists[order], &pool->pages[page_idx].elem);
+}
+
+/* Takes the free block at PAGE_IDX in POOL off its free list. */
+static void
+buddy_delete (struct pool *pool, size_t page_idx) {
+	list_remove (&pool->pages[page_idx].elem);
+	pool->pages[page_idx].order = -1;
+}
+
+/* Frees the block of 2**ORDER pages at PAGE_IDX in POOL, merging
+   it with its buddy as long as the buddy is free and whole. */
+static void
+buddy_free_block (struct pool *pool, size_t page_idx, int order) {
+	size_t base_no = pg_no (pool->base);
+	size_t page_cnt = bitmap_size (pool->used_map);
+
+	while (order < BUDDY_ORDERS - 1) {
+		size_t buddy_idx = ((base_no + page_idx) ^ ((size_t) 1 << order))
+			- base_no;
+
+		/* Underflow wraps BUDDY_IDX around, so one check covers a
+		   buddy on either side of the pool. */
+		if (buddy_idx >= page_cnt
+				|| page_cnt - buddy_idx < ((size_t) 1 << order)
+				|| pool->pages[buddy_idx].order != order)
+			break;
+		buddy_delete (pool, buddy_idx);
+		if (buddy_idx < page_idx)
+			page_idx = buddy_idx;
+		order++;
+	}
+	buddy_insert (pool, page_idx, order);
+}
+
+/* Frees the PAGE_CNT pages at PAGE_IDX in POOL, which need not
+   form a single block: the range is split into the largest
+   aligned blocks that it contains. */
+static void
+buddy_free (struct pool *pool, size_t page_idx, size_t page_cnt) {
+	size_t base_no = pg_no (pool->base);
+
+	while (page_cnt > 0) {
+		int order = 0;
+
+		while (order < BUDDY_ORDERS - 1
+				&& ((base_no + page_idx) & ((size_t) 1 << order)) == 0
+				&& ((size_t) 2 << order) <= page_cnt)
+			order++;
+		buddy_free_block (pool, page_idx, order);
+		page_idx += (size_t) 1 << order;
+		page_cnt -= (size_t) 1 << order;
+		pool->free_cnt += (size_t) 1 << order;
+	}
+}
+
+/* Allocates PAGE_CNT contiguous pages from POOL and returns the
+   index of the first one, or BITMAP_ERROR if no free block is
+   large enough.  Pages beyond PAGE_CNT in the block that is used
+   go back to the free lists. */
+static size_t
+buddy_alloc (struct pool *pool, size_t page_cnt) {
+	int order = 0, o;
+	size_t page_idx;
+
+	while (((size_t) 1 << order) < page_cnt)
+		if (++order >= BUDDY_ORDERS)
+			return BITMAP_ERROR;
+
+	for (o = order; o < BUDDY_ORDERS; o++)
+		if (!list_empty (&pool->free_lists[o]))
+			break;
+	if (o == BUDDY_ORDERS)
+		return BITMAP_ERROR;
+
+	page_idx = list_entry (list_front (&pool->free_lists[o]),
+			struct buddy_page, elem) - pool->pages;
+	buddy_delete (pool, page_idx);
+
+	/* Split down to ORDER, keeping the lower half each time. */
+	while (o > order) {
+		o--;
+		buddy_insert (pool, page_idx + ((size_t) 1 << o), o);
+	}
+
+	/* Give back the tail that was not asked for. */
+	if (((size_t) 1 << order) > page_cnt)
+		buddy_free (pool, page_idx + page_cnt,
+				((size_t) 1 << order) - page_cnt);
+	pool->free_cnt -= (size_t) 1 << order;
+	return page_idx;
+}
+
+/* Allocates PAGE_CNT contiguous pages from POOL and returns the
+   first, or a null pointer if there are not enough.  POOL's lock
+   must be held. */
+static void *
+pool_take (struct pool *pool, size_t page_cnt) {
+	size_t page_idx;
+
+	ASSERT (lock_held_by_current_thread (&pool->lock));
+
+	page_idx = buddy_alloc (pool, page_cnt);
+	if (page_idx == BITMAP_ERROR)
+		return NULL;
+	ASSERT (bitmap_none (pool->used_map, page_idx, page_cnt));
+	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+	return pool->base + PGSIZE * page_idx; /* 원하는 page의 포인터. (Bytes in a page * page_idx) */
+}
+
+/* Returns the PAGE_CNT pages at PAGES to POOL.  POOL's lock must
+   be held. */
+static void
+pool_give (struct pool *pool, void *pages, size_t page_cnt) {
+	size_t page_idx = pg_no (pages) - pg_no (pool->base);
+
+	ASSERT (lock_held_by_current_thread (&pool->lock));
+	ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
+	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+	buddy_free (pool, page_idx, page_cnt);
+}
+
+/* Returns a page from this CPU's cache for POOL, refilling the
+   cache from POOL if it is empty, or a null pointer if POOL is out
+   of pages. */
+static void *
+pcp_get (struct pool *pool) {
+	void *batch[PCP_BATCH];
+	struct page_cache *pc;
+	enum intr_level old_level;
+	void *page = NULL;
+	size_t cnt, i;
+
+	old_level = intr_disable ();
+	pc = &pool->pcp[this_cpu ()->id];
+	if (pc->cnt > 0)
+		page = pc->pages[--pc->cnt];
+	intr_set_level (old_level);
+	if (page != NULL)
+		return page;
+
+	/* Refill.  The lock may block, so the batch is collected with
+	   interrupts on and only then put in the cache, which may have
+	   been refilled by someone else in the meantime. */
+	lock_acquire (&pool->lock);
+	for (cnt = 0; cnt < PCP_BATCH; cnt++)
+		if ((batch[cnt] = pool_take (pool, 1)) == NULL)
+			break;
+	lock_release (&pool->lock);
+	if (cnt == 0)
+		return NULL;
+
+	old_level = intr_disable ();
+	pc = &pool->pcp[this_cpu ()->id];
+	for (i = 1; i < cnt && pc->cnt < PCP_HIGH; i++)
+		pc->pages[pc->cnt++] = batch[i];
+	intr_set_level (old_level);
+
+	if (i < cnt) {
+		lock_acquire (&pool->lock);
+		for (; i < cnt; i++)
+			pool_give (pool, batch[i], 1);
+		lock_release (&pool->lock);
+	}
+	return batch[0];
+}
+
+/* Puts PAGE, which belongs to POOL, in this CPU's cache.  If the
+   cache is full, its PCP_BATCH least recently freed pages go back
+   to POOL first. */
+static void
+pcp_put (struct pool *pool, void *page) {
+	void *batch[PCP_BATCH];
+	struct page_cache *pc;
+	enum intr_level old_level;
+	size_t cnt = 0, i;
+
+	old_level = intr_disable ();
+	pc = &pool->pcp[this_cpu ()->id];
+	if (pc->cnt == PCP_HIGH) {
+		cnt = PCP_BATCH;
+		memcpy (batch, pc->pages, sizeof batch);
+		memmove (pc->pages, pc->pages + PCP_BATCH,
+				(PCP_HIGH - PCP_BATCH) * sizeof *pc->pages);
+		pc->cnt -= PCP_BATCH;
+	}
+	pc->pages[pc->cnt++] = page;
+	intr_set_level (old_level);
+
+	if (cnt > 0) {
+		lock_acquire (&pool->lock);
+		for (i = 0; i < cnt; i++)
+			pool_give (pool, batch[i], 1);
+		lock_release (&pool->lock);
+	}
+}
+
+/* Returns every page in this CPU's cache for POOL to POOL. */
+static void
+pcp_drain (struct pool *pool) {
+	void *batch[PCP_HIGH];
+	struct page_cache *pc;
+	enum intr_level old_level;
+	size_t cnt, i;
+
+	old_level = intr_disable ();
+	pc = &pool->pcp[this_cpu ()->id];
+	cnt = pc->cnt;
+	memcpy (batch, pc->pages, cnt * sizeof *pc->pages);
+	pc->cnt = 0;
+	intr_set_level (old_level);
+
+	lock_acquire (&pool->lock);
+	for (i = 0; i < cnt; i++)
+		pool_give (pool, batch[i], 1);
+	lock_release (&pool->lock);
+}
+
+/* Takes a pre-zeroed page from POOL, or returns a null pointer if
+   there is none.  Wakes the pagezero thread if the list is
+   getting short. */
+static void *
+zero_get (struct pool *pool) {
+	void *page = NULL;
+	bool wake = false;
+
+	spin_lock (&pool->zero_lock);
+	if (pool->zero_cnt > 0)
+		page = pool->zero_pages[--pool->zero_cnt];
+	if (pool->zero_cnt < ZERO_LOW && zeroer_sleeping) {
+		zeroer_sleeping = false;
+		wake = true;
+	}
+	spin_unlock (&pool->zero_lock);
+
+	if (wake)
+		sema_up (&zero_sema);
+	return page;
+}
+
+/* Returns all of POOL's pre-zeroed pages to POOL. */
+static void
+zero_drain (struct pool *pool) {
+	void *batch[ZERO_HIGH];
+	size_t cnt, i;
+
+	spin_lock (&pool->zero_lock);
+	cnt = pool->zero_cnt;
+	memcpy (batch, pool->zero_pages, cnt * sizeof *pool->zero_pages);
+	pool->zero_cnt = 0;
+	spin_unlock (&pool->zero_lock);
+
+	lock_acquire (&pool->lock);
+	for (i = 0; i < cnt; i++)
+		pool_give (pool, batch[i], 1);
+	lock_release (&pool->lock);
+}
+
+/* Zeroes free pages of POOL until it has ZERO_HIGH pre-zeroed
+   pages or runs out of free ones. */
+static void
+zero_fill (struct pool *pool) {
+	for (;;) {
+		void *page;
+		bool full;
+
+		spin_lock (&pool->zero_lock);
+		full = pool->zero_cnt >= ZERO_HIGH;
+		spin_unlock (&pool->zero_lock);
+		if (full)
+			return;
+
+		/* Not palloc_get_page(), which would hand us back our own
+		   zeroed pages once the pool is empty. */
+		page = pcp_get (pool);
+		if (page == NULL)
+			return;
+		fpu_zero_page (page);
+
+		spin_lock (&pool->zero_lock);
+		if (pool->zero_cnt < ZERO_HIGH) {
+			pool->zero_pages[pool->zero_cnt++] = page;
+			page = NULL;
+		}
+		spin_unlock (&pool->zero_lock);
+		if (page != NULL)
+			pcp_put (pool, page);
+	}
+}
+
+/* Body of the pagezero thread. */
+static void
+pagezero (void *aux UNUSED) {
+	if (thread_mlfqs)
+		thread_set_nice (20);
+
+	for (;;) {
+		zero_fill (&kernel_pool);
+		zero_fill (&user_pool);
+
+		/* Sleep until zero_get() finds a list running low.  A
+		   wakeup that comes, possibly from another CPU, between
+		   setting the flag and going to sleep is kept by the
+		   semaphore. */
+		zeroer_sleeping = true;
+		sema_down (&zero_sema);
+	}
+}
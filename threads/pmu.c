@@ -0,0 +1,145 @@
+/* pmu.c: Hardware performance counters. */
+
+#include "threads/pmu.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+#include "intrinsic.h"
+
+/* Performance monitoring unit.
+ *
+ * Intel CPUs since the Core 2 describe their "architectural"
+ * performance monitoring in CPUID leaf 0xa: how many general purpose
+ * counters there are, how wide they are, and which of a few
+ * standard events they can count.  Each counter is programmed with
+ * an event select MSR and read from a counter MSR.  Here counter N
+ * counts the Nth of enum perf_event that the CPU has, in user mode
+ * and in the kernel alike, from boot to power off.
+ *
+ * The counts are split among threads by reading the counters at
+ * every context switch, in thread_launch(), and adding what they
+ * advanced since the last switch to the thread being switched away
+ * from.  That costs one RDMSR per counter per switch and nothing in
+ * between.
+ *
+ * Data TLB misses are not an architectural event; the encoding used
+ * is that of the Nehalem through Skylake generations.  QEMU without
+ * KVM, and AMD CPUs, have no leaf 0xa counters, in which case
+ * nothing is counted and every perf_counts comes back with VALID 0. */
+#define MSR_PERFEVTSEL0 0x186
+#define MSR_PMC0 0xc1
+#define MSR_PERF_GLOBAL_CTRL 0x38f
+
+#define EVTSEL_USR (1 << 16)        /* Count in ring 3. */
+#define EVTSEL_OS (1 << 17)         /* Count in ring 0. */
+#define EVTSEL_EN (1 << 22)         /* Enable. */
+
+/* Event select and unit mask of each event, and the bit in CPUID
+   0xa EBX that says it is unavailable, or -1 if there is none. */
+static const struct {
+	uint8_t event, umask;
+	int unavailable_bit;
+	const char *name;
+} events[PERF_EVENT_CNT] = {
+	[PERF_CYCLES] = { 0x3c, 0x00, 0, "cycles" },
+	[PERF_INSTRUCTIONS] = { 0xc0, 0x00, 1, "instructions" },
+	[PERF_LLC_MISSES] = { 0x2e, 0x41, 4, "LLC misses" },
+	[PERF_DTLB_MISSES] = { 0x08, 0x01, -1, "dTLB misses" },
+	[PERF_BRANCH_MISSES] = { 0xc5, 0x00, 6, "branch misses" },
+};
+
+static uint32_t valid;              /* Events counted, as in perf_counts. */
+static int counter_of[PERF_EVENT_CNT];  /* Counter of each valid event. */
+static uint64_t counter_mask;       /* Counters' width, as a mask. */
+
+/* Counter values at the last switch on each CPU, and the counts
+   of every thread, exited or not. */
+static uint64_t last[NCPU][PERF_EVENT_CNT];
+static uint64_t totals[PERF_EVENT_CNT];
+
+/* Programs the counters of this CPU. */
+void
+pmu_init (void) {
+	uint32_t eax, ebx, ecx, edx;
+	int counters, version;
+
+	cpuid (0, &eax, &ebx, &ecx, &edx);
+	if (eax < 0xa)
+		return;
+	cpuid (0xa, &eax, &ebx, &ecx, &edx);
+	version = eax & 0xff;
+	counters = (eax >> 8) & 0xff;
+	if (version == 0 || counters == 0)
+		return;
+	counter_mask = ((eax >> 16) & 0xff) >= 64
+		? UINT64_MAX : ((uint64_t) 1 << ((eax >> 16) & 0xff)) - 1;
+
+	for (int e = 0, n = 0; e < PERF_EVENT_CNT && n < counters; e++) {
+		int bit = events[e].unavailable_bit;
+
+		if (bit >= 0 && (bit >= (int) (eax >> 24) || (ebx & (1 << bit))))
+			continue;
+		write_msr (MSR_PMC0 + n, 0);
+		write_msr (MSR_PERFEVTSEL0 + n, events[e].event
+				| (events[e].umask << 8) | EVTSEL_USR | EVTSEL_OS | EVTSEL_EN);
+		counter_of[e] = n++;
+		valid |= 1 << e;
+	}
+	if (version >= 2)
+		write_msr (MSR_PERF_GLOBAL_CTRL, ((uint64_t) 1 << counters) - 1);
+}
+
+/* Adds what the counters advanced since the last switch on this CPU
+   to PREV, which was running.  Called with interrupts off, when
+   switching from PREV to another thread. */
+void
+pmu_switch (struct thread *prev) {
+	uint64_t *base = last[this_cpu ()->id];
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (valid == 0)
+		return;
+	prev->perf.valid = valid;
+	for (int e = 0; e < PERF_EVENT_CNT; e++)
+		if (valid & (1 << e)) {
+			uint64_t now = read_msr (MSR_PMC0 + counter_of[e]);
+			uint64_t delta = (now - base[e]) & counter_mask;
+
+			prev->perf.count[e] += delta;
+			totals[e] += delta;
+			base[e] = now;
+		}
+}
+
+/* Stores the counts of the running thread, up to now, in PC. */
+void
+pmu_read (struct perf_counts *pc) {
+	enum intr_level old_level = intr_disable ();
+
+	pmu_switch (thread_current ());
+	*pc = thread_current ()->perf;
+	pc->valid = valid;
+	intr_set_level (old_level);
+}
+
+/* Prints the counts of all threads so far. */
+void
+pmu_print_stats (void) {
+	enum intr_level old_level;
+
+	if (valid == 0)
+		return;
+	old_level = intr_disable ();
+	pmu_switch (thread_current ());
+	intr_set_level (old_level);
+
+	printf ("PMU:");
+	for (int e = 0; e < PERF_EVENT_CNT; e++)
+		if (valid & (1 << e))
+			printf (" %llu %s", (unsigned long long) totals[e], events[e].name);
+	printf ("\n");
+}
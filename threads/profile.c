@@ -0,0 +1,165 @@
+/* profile.c: Sampling profiler driven by the timer interrupt. */
+
+#include "threads/profile.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
+
+/* Sampling profiler.
+ *
+ * With -profile, every timer tick records where the interrupted code
+ * was: its RIP and, walking the chain of saved frame pointers that
+ * -fno-omit-frame-pointer keeps, up to PROFILE_DEPTH - 1 return
+ * addresses above it.  Kernel frames are followed only within the
+ * running thread's page, user frames only through pages that are
+ * present in its page table, so a bad frame pointer ends the walk
+ * instead of faulting.
+ *
+ * Each CPU fills a buffer of its own, and only from its timer
+ * interrupt.  When it is full, later samples are counted but not
+ * kept, so the profile covers the start of the run.
+ *
+ * At power off, profile_dump() prints the samples between
+ * "profile-begin" and "profile-end".  utils/pintos-profile
+ * symbolizes them against kernel.o and the user programs into
+ * folded stacks, the input of flamegraph.pl and speedscope. */
+#define PROFILE_PAGES 128
+#define PROFILE_DEPTH 8
+#define PROFILE_SAMPLES (PROFILE_PAGES * PGSIZE / sizeof (struct profile_rec))
+
+struct profile_rec {
+	char name[16];              /* Running thread. */
+	uint8_t depth;              /* Addresses in PC. */
+	bool user;                  /* Interrupted in user mode? */
+	uint64_t pc[PROFILE_DEPTH]; /* Innermost first. */
+};
+
+struct profile_buf {
+	struct profile_rec *recs;   /* PROFILE_SAMPLES slots, or null. */
+	size_t cnt;                 /* Slots filled. */
+	uint64_t dropped;           /* Samples that found the buffer full. */
+};
+
+bool profile_enabled;
+
+static struct profile_buf profile_bufs[NCPU];
+
+/* Allocates the buffers if profiling was asked for.  Ticks before
+   this are not sampled. */
+void
+profile_init (void) {
+	if (!profile_enabled)
+		return;
+	for (int i = 0; i < NCPU; i++)
+		profile_bufs[i].recs = palloc_get_multiple (PAL_ASSERT, PROFILE_PAGES);
+}
+
+/* Follows the kernel frame pointer RBP of thread T into R, as long as
+   it stays on T's stack and moves toward its top. */
+static void
+walk_kernel (struct profile_rec *r, struct thread *t, uint64_t rbp) {
+	uint64_t lo = (uint64_t) t, hi = lo + PGSIZE - 16;
+
+	while (r->depth < PROFILE_DEPTH && rbp > lo && rbp <= hi
+			&& rbp % 8 == 0) {
+		uint64_t *frame = (uint64_t *) rbp;
+
+		if (frame[1] == 0)
+			break;
+		r->pc[r->depth++] = frame[1];
+		if (frame[0] <= rbp)
+			break;
+		rbp = frame[0];
+	}
+}
+
+#ifdef USERPROG
+/* Follows the user frame pointer RBP of thread T into R, reading
+   user memory through T's page table. */
+static void
+walk_user (struct profile_rec *r, struct thread *t, uint64_t rbp) {
+	while (r->depth < PROFILE_DEPTH && is_user_vaddr ((void *) rbp)
+			&& rbp % 8 == 0 && pg_ofs ((void *) rbp) <= PGSIZE - 16) {
+		uint64_t *frame = pml4_get_page (thread_pml4 (t), (void *) rbp);
+
+		if (frame == NULL || frame[1] == 0)
+			break;
+		r->pc[r->depth++] = frame[1];
+		if (frame[0] <= rbp)
+			break;
+		rbp = frame[0];
+	}
+}
+#endif
+
+/* Records a sample of the code that the timer interrupt in F
+   interrupted.  Called by the timer interrupt handler. */
+void
+profile_sample (const struct intr_frame *f) {
+	struct profile_buf *b = &profile_bufs[this_cpu ()->id];
+	struct thread *t = thread_current ();
+	struct profile_rec *r;
+
+	ASSERT (intr_context ());
+
+	if (b->recs == NULL)
+		return;
+	if (b->cnt >= PROFILE_SAMPLES) {
+		b->dropped++;
+		return;
+	}
+
+	r = &b->recs[b->cnt++];
+	/* Thread names may have spaces, which the dump cannot. */
+	strlcpy (r->name, t->name, sizeof r->name);
+	for (char *c = r->name; *c != '\0'; c++)
+		if (*c == ' ')
+			*c = '_';
+	r->user = (f->cs & 3) == 3;
+	r->pc[0] = f->rip;
+	r->depth = 1;
+	if (!r->user)
+		walk_kernel (r, t, f->R.rbp);
+#ifdef USERPROG
+	else if (thread_pml4 (t) != NULL)
+		walk_user (r, t, f->R.rbp);
+#endif
+}
+
+/* Prints the samples and stops profiling. */
+void
+profile_dump (void) {
+	size_t cnt = 0;
+	uint64_t dropped = 0;
+
+	if (!profile_enabled)
+		return;
+	profile_enabled = false;
+
+	for (int cpu = 0; cpu < NCPU; cpu++) {
+		cnt += profile_bufs[cpu].cnt;
+		dropped += profile_bufs[cpu].dropped;
+	}
+	printf ("profile-begin %zu %"PRIu64"\n", cnt, dropped);
+	for (int cpu = 0; cpu < NCPU; cpu++) {
+		struct profile_buf *b = &profile_bufs[cpu];
+
+		for (size_t i = 0; i < b->cnt; i++) {
+			struct profile_rec *r = &b->recs[i];
+
+			printf ("prof %c %s", r->user ? 'u' : 'k', r->name);
+			for (int d = 0; d < r->depth; d++)
+				printf (" %#"PRIx64, r->pc[d]);
+			printf ("\n");
+		}
+	}
+	printf ("profile-end\n");
+}
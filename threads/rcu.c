@@ -0,0 +1,218 @@
+/* rcu.c: Epoch-based reclamation of shared data. */
+
+#include "threads/rcu.h"
+#include <debug.h>
+#include "threads/atomic.h"
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+#include "threads/spinlock.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Read-copy-update, by epochs.
+ *
+ * A structure read far more often than it changes can let its
+ * readers take no lock at all, if a writer never frees anything a
+ * reader might still be looking at.  The writer unlinks an object
+ * under whatever lock writers share, then hands it to call_rcu()
+ * instead of freeing it.  The callback runs once every reader that
+ * could have found the object is done.
+ *
+ * Readers bracket their lookups with rcu_read_lock() and
+ * rcu_read_unlock().  These count the reader on its CPU under the
+ * parity of the current epoch, with a single locked add each; no
+ * memory is shared between readers on different CPUs.  A reader
+ * may block or be preempted inside, so that a lookup can take a
+ * sleeping lock on what it found, but it should not stay long:
+ * every deferred free waits for it.
+ *
+ * Grace periods are driven by the timer tick.  rcu_tick() starts
+ * one by moving the callbacks queued so far to rcu_wait and
+ * advancing the epoch.  Readers that start after that count under
+ * the new parity, and cannot find the objects, which were unlinked
+ * before they were queued.  Once the readers counted under the old
+ * parity on every CPU add up to zero, the grace period is over and
+ * its callbacks go to rcu_done.  Callbacks may need to free memory,
+ * which can sleep, so the "rcu" thread runs them rather than the
+ * interrupt. */
+
+/* Current epoch.  Only its parity matters to readers. */
+static volatile unsigned rcu_epoch;
+
+/* Callback lists, all protected by rcu_lock. */
+static struct spinlock rcu_lock;
+static struct list rcu_next;        /* Queued for the next grace period. */
+static struct list rcu_wait;        /* Waiting for the current one. */
+static struct list rcu_done;        /* Grace period over, not yet called. */
+static bool rcu_gp_active;          /* Is a grace period in progress? */
+
+/* Upped when rcu_done gets callbacks for the "rcu" thread. */
+static struct semaphore rcu_done_sema;
+static struct thread *rcu_worker;
+
+/* A thread in rcu_synchronize(). */
+struct rcu_waiter {
+	struct rcu_head head;
+	struct semaphore done;
+};
+
+static void rcu_thread (void *aux);
+static int rcu_readers (unsigned epoch);
+static void rcu_move (struct list *to, struct list *from);
+static void rcu_wakeup (struct rcu_head *);
+
+/* Starts the thread that runs callbacks.  Until this is called,
+   no grace period starts. */
+void
+rcu_init (void) {
+	list_init (&rcu_next);
+	list_init (&rcu_wait);
+	list_init (&rcu_done);
+	spin_lock_init (&rcu_lock);
+	sema_init (&rcu_done_sema, 0);
+	if (thread_create ("rcu", PRI_DEFAULT, rcu_thread, NULL) == TID_ERROR)
+		PANIC ("rcu_init: out of memory");
+}
+
+/* Begins a read-side critical section and returns the value to
+   pass to the matching rcu_read_unlock().  Sections nest, and may
+   be entered from interrupt handlers. */
+int
+rcu_read_lock (void) {
+	for (;;) {
+		unsigned epoch = rcu_epoch;
+		int idx = epoch & 1;
+
+		/* The locked add orders our count before we look at the
+		   epoch again.  If the epoch moved meanwhile, rcu_tick()
+		   may have summed the old parity without us, so count
+		   under the new one instead. */
+		atomic_fetch_add (&this_cpu ()->rcu_readers[idx], 1);
+		if (rcu_epoch == epoch)
+			return idx;
+		atomic_fetch_add (&this_cpu ()->rcu_readers[idx], -1);
+	}
+}
+
+/* Ends the read-side critical section that rcu_read_lock()
+   returned EPOCH for.  We may have moved to another CPU since, so
+   a CPU's count can go negative; only the sum over all CPUs
+   matters. */
+void
+rcu_read_unlock (int epoch) {
+	ASSERT (epoch == 0 || epoch == 1);
+
+	atomic_fetch_add (&this_cpu ()->rcu_readers[epoch], -1);
+}
+
+/* Arranges for FUNC to be called with HEAD after a grace period,
+   that is, once every read-side critical section that was active
+   when this was called has ended.  FUNC runs in a kernel thread,
+   so it may sleep but must not call rcu_synchronize().  May be
+   called from an interrupt handler. */
+void
+call_rcu (struct rcu_head *head, rcu_func *func) {
+	ASSERT (head != NULL);
+	ASSERT (func != NULL);
+
+	head->func = func;
+	spin_lock (&rcu_lock);
+	list_push_back (&rcu_next, &head->elem);
+	spin_unlock (&rcu_lock);
+}
+
+/* Waits for a grace period to pass.  Must not be called inside a
+   read-side critical section, from an interrupt handler, or from
+   an rcu callback. */
+void
+rcu_synchronize (void) {
+	struct rcu_waiter w;
+
+	ASSERT (!intr_context ());
+	ASSERT (thread_current () != rcu_worker);
+
+	sema_init (&w.done, 0);
+	call_rcu (&w.head, rcu_wakeup);
+	sema_down (&w.done);
+}
+
+/* Wakes the thread in rcu_synchronize() that queued HEAD. */
+static void
+rcu_wakeup (struct rcu_head *head) {
+	struct rcu_waiter *w = rcu_entry (head, struct rcu_waiter, head);
+
+	sema_up (&w->done);
+}
+
+/* Advances grace periods.  Called by the timer interrupt on every
+   tick. */
+void
+rcu_tick (void) {
+	ASSERT (intr_context ());
+
+	if (rcu_worker == NULL)
+		return;
+
+	spin_lock (&rcu_lock);
+	if (rcu_gp_active && rcu_readers (rcu_epoch - 1) == 0) {
+		rcu_move (&rcu_done, &rcu_wait);
+		rcu_gp_active = false;
+		sema_up (&rcu_done_sema);
+	}
+	if (!rcu_gp_active && !list_empty (&rcu_next)) {
+		/* The spinlock's locked exchange orders the unlinking of
+		   everything in rcu_next before the new epoch. */
+		rcu_move (&rcu_wait, &rcu_next);
+		rcu_epoch++;
+		rcu_gp_active = true;
+	}
+	spin_unlock (&rcu_lock);
+}
+
+/* Returns true if callbacks are waiting for a grace period, which
+   needs the timer tick to end. */
+bool
+rcu_pending (void) {
+	return rcu_gp_active || !list_empty (&rcu_next);
+}
+
+/* Returns the number of read-side critical sections counted under
+   EPOCH's parity, summed over all CPUs. */
+static int
+rcu_readers (unsigned epoch) {
+	int cnt = 0;
+	int i;
+
+	for (i = 0; i < NCPU; i++)
+		cnt += cpus[i].rcu_readers[epoch & 1];
+	return cnt;
+}
+
+/* Moves every element of FROM to the end of TO. */
+static void
+rcu_move (struct list *to, struct list *from) {
+	if (!list_empty (from))
+		list_splice (list_end (to), list_begin (from), list_end (from));
+}
+
+/* Runs callbacks whose grace period is over. */
+static void
+rcu_thread (void *aux UNUSED) {
+	rcu_worker = thread_current ();
+	for (;;) {
+		struct list done;
+
+		sema_down (&rcu_done_sema);
+		list_init (&done);
+		spin_lock (&rcu_lock);
+		rcu_move (&done, &rcu_done);
+		spin_unlock (&rcu_lock);
+
+		while (!list_empty (&done)) {
+			struct rcu_head *head = list_entry (list_pop_front (&done),
+					struct rcu_head, elem);
+
+			head->func (head);
+		}
+	}
+}
@@ -0,0 +1,152 @@
+/* smp.c: Starting the application processors. */
+
+#include "threads/smp.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "threads/apic.h"
+#include "threads/cpu.h"
+#include "threads/fpu.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/loader.h"
+#include "threads/mmu.h"
+#include "threads/pmu.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef USERPROG
+#include "userprog/gdt.h"
+#include "userprog/syscall.h"
+#include "userprog/tss.h"
+#endif
+
+/* Multiprocessor startup.
+ *
+ * The boot CPU starts the others one at a time through their local
+ * APICs, once the timer is calibrated, since the INIT and STARTUP
+ * IPIs must be spaced out.  Each one comes up in real mode in the
+ * code of ap-start.S, which takes it to long mode and onto the page
+ * its idle thread will have, and then does for itself the part of
+ * the boot that is per CPU: paging features, GDT and TSS, IDT, local
+ * APIC, performance counters, FPU and system call MSRs.  Nothing in
+ * there may sleep, since the CPU cannot schedule yet.  Last, it
+ * counts itself in cpu_cnt and idles until the scheduler gives it
+ * work, which it is woken for or steals from the others.
+ *
+ * The ACPI tables that list the CPUs are not read.  Local APIC IDs
+ * are assumed to be 0, 1, 2 and so on, which is how QEMU and Bochs
+ * number them, and the boot CPU stops at the first that does not
+ * come up in time.  Device interrupts all go to the boot CPU, which
+ * passes the timer tick on to the others. */
+
+int smp_cpus = 1;
+bool smp_started;
+
+/* Milliseconds to wait for a CPU to come online. */
+#define AP_START_MS 100
+
+/* Filled in for each CPU in the copy of ap-start.S. */
+struct ap_boot {
+	uint64_t boot_cr3;          /* boot_pml4e, on the way to long mode. */
+	uint64_t cr3;               /* base_pml4. */
+	uint64_t rsp;               /* Top of the idle thread's page. */
+	void (*entry) (void);       /* ap_main(). */
+};
+
+extern const char ap_start[], ap_start_end[], ap_boot[];
+extern uint64_t boot_pml4e[];
+
+static bool start_cpu (struct cpu *, int apic_id);
+static void ap_main (void) NO_RETURN;
+static intr_handler_func halt_interrupt;
+
+/* Starts up to smp_cpus - 1 more CPUs.  Called by main() with
+   interrupts on, once timer_msleep() works. */
+void
+smp_init (void) {
+	ASSERT (intr_get_level () == INTR_ON);
+	ASSERT (cpu_cnt == 1);
+	ASSERT (ap_start_end - ap_start <= PGSIZE);
+
+	if (smp_cpus <= 1)
+		return;
+	if (!apic_enabled ()) {
+		printf ("smp: no local APIC, using one CPU\n");
+		return;
+	}
+
+	intr_register_int (2, 0, INTR_OFF, halt_interrupt, "NMI Interrupt");
+	memcpy (ptov (LOADER_AP_START), ap_start, ap_start_end - ap_start);
+	fpu_init_smp ();
+	smp_started = true;
+
+	for (int id = 0; cpu_cnt < smp_cpus && cpu_cnt < NCPU; id++)
+		if (id != cpus[0].apic_id && !start_cpu (&cpus[cpu_cnt], id))
+			break;
+	printf ("smp: %d CPUs online\n", cpu_cnt);
+}
+
+/* Starts the CPU whose local APIC has ID APIC_ID as C, the next one
+   in cpus[], and waits for it to come online.  Returns false if it
+   does not.  Then it may still start late, so C must stay unused,
+   and no other CPU may be started, since that would rewrite the
+   ap_boot it is about to read. */
+static bool
+start_cpu (struct cpu *c, int apic_id) {
+	struct ap_boot *boot = (struct ap_boot *)
+		((uint8_t *) ptov (LOADER_AP_START) + (ap_boot - ap_start));
+	struct thread *idle = thread_create_idle (c);
+	int cnt = cpu_cnt;
+
+	if (idle == NULL)
+		return false;
+	c->apic_id = apic_id;
+	boot->boot_cr3 = vtop (boot_pml4e);
+	boot->cr3 = vtop (base_pml4);
+	boot->rsp = (uint64_t) idle + PGSIZE;
+	boot->entry = ap_main;
+
+	apic_start_ap (apic_id, LOADER_AP_START);
+	for (int ms = 0; ms < AP_START_MS; ms++) {
+		if (*(volatile int *) &cpu_cnt != cnt)
+			return true;
+		timer_msleep (1);
+	}
+	return false;
+}
+
+/* Where a CPU that start_cpu() started goes from ap-start.S, with
+   interrupts off, on base_pml4 and on the top of its idle thread's
+   page, so that this_cpu() finds it already. */
+static void
+ap_main (void) {
+	tlb_init_ap ();
+#ifdef USERPROG
+	tss_init ();
+	gdt_init ();
+#endif
+	intr_init_ap ();
+	apic_init_ap ();
+	pmu_init ();
+	fpu_init_ap ();
+#ifdef USERPROG
+	syscall_init_cpu ();
+#endif
+	thread_start_ap ();
+}
+
+/* Stops every other CPU for good, for a kernel panic.  An NMI gets
+   through even to a CPU that has interrupts off. */
+void
+smp_halt_others (void) {
+	if (cpu_cnt > 1)
+		apic_send_nmi_others ();
+}
+
+/* NMI handler.  Only smp_halt_others() sends NMIs. */
+static void
+halt_interrupt (struct intr_frame *f UNUSED) {
+	for (;;)
+		asm volatile ("cli; hlt" : : : "memory");
+}
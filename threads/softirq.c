@@ -0,0 +1,103 @@
+/* softirq.c: Work deferred from interrupt handlers. */
+
+#include "threads/softirq.h"
+#include <debug.h>
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+
+/* Deferred interrupt work.
+ *
+ * An external interrupt handler runs with interrupts off, so
+ * whatever it does delays every other interrupt.  It should do only
+ * what cannot wait, such as acknowledging the device, and queue the
+ * rest as a softirq_work.  intr_handler() runs the queued work once
+ * the interrupt has been acknowledged, with interrupts on, before
+ * returning to the thread it interrupted.
+ *
+ * Deferred work is still interrupt context: intr_context() is true,
+ * so it may not sleep, and it asks for a thread switch with
+ * intr_yield_on_return().  It may be interrupted, though, and the
+ * interrupt may queue more work, which the same run picks up.  An
+ * interrupt that arrives during the run leaves the work and any
+ * switch to the run.
+ *
+ * Each CPU has its own queue, which is only touched with interrupts
+ * off. */
+struct softirq_cpu {
+	struct list queue;          /* Queued softirq_work. */
+	bool active;                /* Running the queue? */
+};
+
+static struct softirq_cpu softirq_cpus[NCPU];
+
+/* Returns this CPU's queue. */
+static struct softirq_cpu *
+this_softirq_cpu (void) {
+	return &softirq_cpus[this_cpu ()->id];
+}
+
+/* Initializes the queues.  Called by intr_init(). */
+void
+softirq_init (void) {
+	for (int i = 0; i < NCPU; i++)
+		list_init (&softirq_cpus[i].queue);
+}
+
+/* Initializes W to call FUNC with AUX when it runs. */
+void
+softirq_work_init (struct softirq_work *w, softirq_func *func, void *aux) {
+	w->func = func;
+	w->aux = aux;
+	w->queued = false;
+}
+
+/* Queues W to run after the current interrupt, unless it is queued
+   already.  Interrupts must be off. */
+void
+softirq_queue (struct softirq_work *w) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (!w->queued) {
+		w->queued = true;
+		list_push_back (&this_softirq_cpu ()->queue, &w->elem);
+	}
+}
+
+/* Returns true if there is work for softirq_run() to do.
+   Interrupts must be off. */
+bool
+softirq_pending (void) {
+	struct softirq_cpu *sc = this_softirq_cpu ();
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	return !sc->active && !list_empty (&sc->queue);
+}
+
+/* Returns true while this CPU runs deferred work. */
+bool
+softirq_active (void) {
+	return softirq_cpus[this_cpu ()->id].active;
+}
+
+/* Runs the queued work of this CPU, in the order it was queued, until
+   there is none left.  Each item runs with interrupts on.  Called by
+   intr_handler() with interrupts off, and returns with them off. */
+void
+softirq_run (void) {
+	struct softirq_cpu *sc = this_softirq_cpu ();
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (!sc->active);
+
+	sc->active = true;
+	while (!list_empty (&sc->queue)) {
+		struct softirq_work *w = list_entry (list_pop_front (&sc->queue),
+				struct softirq_work, elem);
+
+		w->queued = false;
+		asm volatile ("sti" : : : "memory");
+		w->func (w->aux);
+		asm volatile ("cli" : : : "memory");
+	}
+	sc->active = false;
+}
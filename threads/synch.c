@@ -29,8 +29,42 @@
 #include "threads/synch.h"
 #include <stdio.h>
 #include <string.h>
+#include "threads/atomic.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/cpu.h"
+#include "threads/trace.h"
+#include "intrinsic.h"
+
+/* Protects every semaphore's value and waiters, every lock's holder
+   and donated priority, every condition's waiters, and the wait_*,
+   held_locks and cond_elem members of threads, from other CPUs as
+   well as interrupt handlers.  Donation walks from lock to holder to
+   lock across any number of them, so one lock covers all; it is only
+   ever held for a few heap operations. */
+static struct spinlock synch_lock = SPINLOCK_INITIALIZER;
+
+/* Source of wait_seq values, so that waiters of equal priority
+   are woken in FIFO order.  Protected by synch_lock. */
+static uint64_t next_wait_seq;
+
+static bool cmp_waiter_priority (const struct heap_elem *, const struct heap_elem *,
+		void *aux);
+static void sema_up_locked (struct semaphore *);
+static void lock_take (struct lock *, struct thread *, bool waited);
+static bool lock_spin (struct lock *);
+static void lock_wait (struct lock *);
+static void lock_acquired (struct lock *);
+static void lock_release_locked (struct lock *);
+static void lock_handoff (struct lock *);
+static void lock_enqueue (struct lock *, struct thread *);
+static void donate_priority_from (struct thread *);
+static void refresh_priority_locked (void);
+
+/* Upper bound on the iterations lock_acquire() busy-waits for a
+   lock whose holder is running on another CPU before it blocks.
+   Short critical sections are usually over well within this. */
+#define LOCK_SPIN_LIMIT 1000
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -46,7 +80,7 @@ sema_init (struct semaphore *sema, unsigned value) {
 	ASSERT (sema != NULL);
 
 	sema->value = value;
-	list_init (&sema->waiters);
+	heap_init (&sema->waiters, cmp_waiter_priority, NULL);
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -59,19 +93,20 @@ sema_init (struct semaphore *sema, unsigned value) {
    sema_down function. */
 void
 sema_down (struct semaphore *sema) {
-	enum intr_level old_level;
-
 	ASSERT (sema != NULL);
 	ASSERT (!intr_context ());
 
-	old_level = intr_disable ();
+	spin_lock (&synch_lock);
 	while (sema->value == 0) {
-		// list_push_back (&sema->waiters, &thread_current ()->elem);
-		list_insert_ordered(&sema->waiters,&thread_current ()->elem, cmp_priority,NULL);
-		thread_block ();
+		struct thread *curr = thread_current ();
+
+		curr->wait_seq = next_wait_seq++;
+		curr->wait_on_sema = sema;
+		heap_push (&sema->waiters, &curr->wait_elem);
+		thread_block_on (&synch_lock);
 	}
 	sema->value--;
-	intr_set_level (old_level);
+	spin_unlock (&synch_lock);
 }
 
 /* Down or "P" operation on a semaphore, but only if the
@@ -81,12 +116,11 @@ sema_down (struct semaphore *sema) {
    This function may be called from an interrupt handler. */
 bool
 sema_try_down (struct semaphore *sema) {
-	enum intr_level old_level;
 	bool success;
 
 	ASSERT (sema != NULL);
 
-	old_level = intr_disable ();
+	spin_lock (&synch_lock);
 	if (sema->value > 0)
 	{
 		sema->value--;
@@ -94,7 +128,7 @@ sema_try_down (struct semaphore *sema) {
 	}
 	else
 		success = false;
-	intr_set_level (old_level);
+	spin_unlock (&synch_lock);
 
 	return success;
 }
@@ -105,22 +139,41 @@ sema_try_down (struct semaphore *sema) {
    This function may be called from an interrupt handler. */
 void
 sema_up (struct semaphore *sema) {
-	enum intr_level old_level;
-
 	ASSERT (sema != NULL);
 
-	old_level = intr_disable ();
-	if (!list_empty (&sema->waiters)){
-		list_sort(&sema->waiters, cmp_priority, NULL); // Nested donation으로 인해 변경된 우선순위를 정렬
-		thread_unblock (list_entry (list_pop_front (&sema->waiters),
-					struct thread, elem));
-	}
-	sema->value++;
+	spin_lock (&synch_lock);
+	sema_up_locked (sema);
+	spin_unlock (&synch_lock);
+
 	// priority preemption
 	if (!intr_context())
 		test_max_priority(); // 다시 스케줄링 해주기
-	
-	intr_set_level (old_level);
+}
+
+/* Up or "V" operation on SEMA like sema_up(), but never yields to
+   the thread it wakes, so that it may be called with a spinlock
+   held. */
+void
+sema_up_noyield (struct semaphore *sema) {
+	ASSERT (sema != NULL);
+
+	spin_lock (&synch_lock);
+	sema_up_locked (sema);
+	spin_unlock (&synch_lock);
+}
+
+/* Does the work of sema_up() but for the preemption check, which
+   the caller must do after releasing synch_lock, which it holds. */
+static void
+sema_up_locked (struct semaphore *sema) {
+	if (!heap_empty (&sema->waiters)){
+		// donation으로 변경된 우선순위는 thread_change_priority()가 바로 heap에 반영하므로 top이 최고 우선순위
+		struct thread *t = heap_entry (heap_pop (&sema->waiters), struct thread, wait_elem);
+
+		t->wait_on_sema = NULL;
+		thread_unblock (t);
+	}
+	sema->value++;
 }
 
 static void sema_test_helper (void *sema_);
@@ -178,9 +231,77 @@ lock_init (struct lock *lock) {
 	ASSERT (lock != NULL);
 
 	lock->holder = NULL;
+	lock->max_priority = PRI_MIN - 1;
+	lock->stats = NULL;
+	lock->barge_limit = LOCK_BARGE_UNLIMITED;
+	lock->barges = 0;
 	sema_init (&lock->semaphore, 1);
 }
 
+/* Sets how LOCK is passed on while threads wait for it.
+
+   By default a release wakes the top waiter and lets it compete
+   for LOCK again, so a thread that comes along first, often the
+   releaser itself, takes LOCK instead ("barging").  That keeps LOCK
+   busy, but under contention a waiter may lose any number of times.
+
+   With BARGE_LIMIT set, once LOCK has been taken BARGE_LIMIT times
+   in a row by threads that did not wait while some thread did, the
+   next release hands LOCK directly to the top waiter: it is the
+   holder before it even runs.  A BARGE_LIMIT of 0 always hands off,
+   so waiters get LOCK strictly in priority and then arrival order,
+   at the cost of a thread switch for every contended release.  Must
+   be called while LOCK is not held. */
+void
+lock_set_handoff (struct lock *lock, unsigned barge_limit) {
+	ASSERT (lock->holder == NULL);
+
+	lock->barge_limit = barge_limit;
+	lock->barges = 0;
+}
+
+/* Lock statistics.  The locks that are worth watching are named
+   with lock_register() after lock_init(), which costs them a
+   couple of TSC reads per acquisition; lock_print_stats() reports
+   them.  Other locks only pay for a null check. */
+#define LOCK_STATS_MAX 64
+static struct lock_stats lock_stats[LOCK_STATS_MAX];
+static int lock_stats_cnt;
+
+/* Makes LOCK, which must not be held, keep statistics under NAME.
+   Does nothing once LOCK_STATS_MAX locks are registered. */
+void
+lock_register (struct lock *lock, const char *name) {
+	int i = atomic_fetch_add (&lock_stats_cnt, 1);
+
+	ASSERT (lock->holder == NULL);
+	if (i >= LOCK_STATS_MAX)
+		return;
+	strlcpy (lock_stats[i].name, name, sizeof lock_stats[i].name);
+	lock->stats = &lock_stats[i];
+}
+
+/* Prints the statistics of the registered locks that were ever
+   taken. */
+void
+lock_print_stats (void) {
+	int cnt = lock_stats_cnt < LOCK_STATS_MAX ? lock_stats_cnt : LOCK_STATS_MAX;
+
+	printf ("Locks: %d registered\n", cnt);
+	for (int i = 0; i < cnt; i++) {
+		const struct lock_stats *s = &lock_stats[i];
+
+		if (s->acquisitions == 0)
+			continue;
+		printf ("  %s: %lld acquired, %lld contended, wait %lld cycles avg "
+				"%lld max, held %lld cycles avg\n", s->name,
+				(long long) s->acquisitions, (long long) s->contended,
+				(long long) (s->contended > 0 ? s->wait_cycles / s->contended : 0),
+				(long long) s->max_wait_cycles,
+				(long long) (s->hold_cycles / s->acquisitions));
+	}
+}
+
 /* Acquires LOCK, sleeping until it becomes available if
    necessary.  The lock must not already be held by the current
    thread.
@@ -197,31 +318,133 @@ lock_acquire (struct lock *lock) {
 	// sema_down (&lock->semaphore);
 	// lock->holder = thread_current ();
 
-	/* advanced .. mlfqs인 경우 아래 return까지만 진행 */
-	if (thread_mlfqs) {
-		sema_down(&lock->semaphore);
-		lock->holder = thread_current();
+	if (lock_spin (lock))
 		return;
-	}
 
 	struct thread *curr = thread_current();
+	/* holder의 held_locks는 다른 쓰레드의 donation으로도 바뀌므로 synch_lock을 잡고 다룬다. */
+	spin_lock (&synch_lock);
 
-	/* 만약 해당 lock을 누가 사용하고 있다면 */
-	if (lock->holder != NULL){
+	/* 만약 해당 lock을 누가 사용하고 있다면. mlfqs에서는 donation 없음 */
+	if (!thread_mlfqs && lock->holder != NULL){
 		curr->wait_on_lock = lock; // 현재 쓰레드의 wait_on_block 필드에 해당 lock을 저장.
-		
-		/* 현재 lock을 소유하고 있는 쓰레드의 donations에 현재 쓰레드를 저장 */
-		list_insert_ordered(&lock->holder->donations, &curr->donation_elem, cmp_donation_priority, NULL);
-
 		donate_priority();
 	}
 	/* 해당 lock의 waiting list에서 기다리가 자신의 차례가 되면, 
 	CPU를 점유하고 나머지를 실행하여 lock을 획득한다. */
-	sema_down(&lock->semaphore); 
-
+	lock_wait (lock);
 	curr->wait_on_lock = NULL; // lock을 획득했으니 대기하고 있는 lock이 없음.
+	spin_unlock (&synch_lock);
+	lock_acquired (lock);
+}
+
+/* Busy-waits for LOCK while its holder is running on another CPU,
+   for at most LOCK_SPIN_LIMIT iterations, so that short critical
+   sections are waited out without the cost of blocking and waking
+   up.  Returns true if LOCK was acquired, false if the caller
+   should block instead: the holder is not running, so it cannot
+   release the lock until we get out of its way.  With a single
+   CPU online a holder other than us is never running, so this
+   returns false at once.  The lock is only looked at without synch_lock
+   until it seems free, so that spinners do not keep synch_lock
+   from everyone else. */
+static bool
+lock_spin (struct lock *lock) {
+	if (cpu_cnt == 1)
+		return false;
+
+	for (int i = 0; i < LOCK_SPIN_LIMIT; i++) {
+		struct thread *holder;
+
+		if (lock->semaphore.value > 0 && lock_try_acquire (lock))
+			return true;
+		holder = lock->holder;
+		if (holder != NULL && holder->status != THREAD_RUNNING)
+			return false;
+		/* Never overtake blocked waiters, which may have higher
+		   priority and are owed the lock by sema_up(). */
+		if (!heap_empty (&lock->semaphore.waiters))
+			return false;
+		asm volatile ("pause" : : : "memory");
+	}
+	return false;
+}
+
+/* Downs LOCK's semaphore and takes LOCK, or sleeps on the
+   semaphore until lock_release() hands LOCK over, tracing and
+   counting the wait if it has to block.  synch_lock must be
+   held. */
+static void
+lock_wait (struct lock *lock) {
+	struct thread *curr = thread_current ();
+	struct semaphore *sema = &lock->semaphore;
+	bool contended = sema->value == 0;
+	uint64_t start = 0;
+
+	ASSERT (synch_lock.locked);
+
+	if (contended) {
+		TRACE (LOCK_WAIT_BEGIN, lock);
+		if (lock->stats != NULL)
+			start = rdtsc ();
+	}
+	while (sema->value == 0 && lock->holder != curr) {
+		curr->wait_seq = next_wait_seq++;
+		curr->wait_on_sema = sema;
+		heap_push (&sema->waiters, &curr->wait_elem);
+		thread_block_on (&synch_lock);
+	}
+	if (lock->holder != curr) {
+		sema->value--;
+		lock_take (lock, curr, contended);
+	}
+	if (contended) {
+		TRACE (LOCK_WAIT_END, lock);
+		if (lock->stats != NULL) {
+			int64_t wait = rdtsc () - start;
+
+			lock->stats->contended++;
+			lock->stats->wait_cycles += wait;
+			if (wait > lock->stats->max_wait_cycles)
+				lock->stats->max_wait_cycles = wait;
+		}
+	}
+}
 
-	lock->holder = thread_current(); // 
+/* Counts an acquisition of LOCK, which the caller now holds. */
+static void
+lock_acquired (struct lock *lock) {
+	if (lock->stats != NULL) {
+		lock->stats->acquisitions++;
+		lock->stats->acquired_at = rdtsc ();
+	}
+}
+
+/* Makes CURR the holder of LOCK, which it has just downed or which
+   is being handed to it.  WAITED is true if CURR had to wait; taking
+   LOCK past waiters without having waited counts as barging.  The
+   lock's donated priority is recomputed from the threads still
+   waiting on it, which now donate to CURR instead of the previous
+   holder.  synch_lock must be held. */
+static void
+lock_take (struct lock *lock, struct thread *curr, bool waited) {
+	struct heap_elem *top = heap_top (&lock->semaphore.waiters);
+
+	ASSERT (synch_lock.locked);
+
+	lock->holder = curr;
+	if (waited)
+		lock->barges = 0;
+	else if (top != NULL)
+		lock->barges++;
+	if (thread_mlfqs)
+		return;
+	lock->max_priority = top != NULL
+		? heap_entry (top, struct thread, wait_elem)->priority
+		: PRI_MIN - 1;
+	heap_push (&curr->held_locks, &lock->elem);
+	if (lock->max_priority > curr->priority)
+		thread_change_priority (curr, lock->max_priority);
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -237,9 +460,15 @@ lock_try_acquire (struct lock *lock) {
 	ASSERT (lock != NULL);
 	ASSERT (!lock_held_by_current_thread (lock));
 
-	success = sema_try_down (&lock->semaphore);
+	spin_lock (&synch_lock);
+	success = lock->semaphore.value > 0;
+	if (success) {
+		lock->semaphore.value--;
+		lock_take (lock, thread_current (), false);
+	}
+	spin_unlock (&synch_lock);
 	if (success)
-		lock->holder = thread_current ();
+		lock_acquired (lock);
 	return success;
 }
 
@@ -254,18 +483,52 @@ lock_release (struct lock *lock) {
 	ASSERT (lock != NULL);
 	ASSERT (lock_held_by_current_thread (lock));
 
-	/* advanced .. mlfqs인 경우 아래 return까지만 진행 */
-	lock->holder = NULL;
-	if (thread_mlfqs) {
-		sema_up(&lock->semaphore);
-		return;
-	}
+	spin_lock (&synch_lock);
+	lock_release_locked (lock);
+	spin_unlock (&synch_lock);
+
+	// priority preemption
+	test_max_priority ();
+}
 
-	remove_with_lock(lock); // donations 리스트에서 해당 lock을 필요로하는 쓰레드를 없애준다.
-	refresh_priority(); 	// 현재 쓰레드의 우선순위를 업데이트
+/* Does the work of lock_release() but for the preemption check,
+   which the caller must do after releasing synch_lock, which it
+   holds. */
+static void
+lock_release_locked (struct lock *lock) {
+	if (lock->stats != NULL)
+		lock->stats->hold_cycles += rdtsc () - lock->stats->acquired_at;
+
+	/* advanced .. mlfqs에서는 donation이 없음 */
+	if (!thread_mlfqs) {
+		remove_with_lock(lock); // held_locks에서 해당 lock을 없애준다.
+		refresh_priority_locked(); // 현재 쓰레드의 우선순위를 업데이트
+	}
 
 	lock->holder = NULL; // lock의 holder를 NULL로 만들어줌
-	sema_up (&lock->semaphore); // semaphore를 UP시켜, 해당 lock에서 기다리고 있는 쓰레드 하나를 깨워준다.
+	if (lock->barge_limit != LOCK_BARGE_UNLIMITED
+			&& !heap_empty (&lock->semaphore.waiters)
+			&& lock->barges >= lock->barge_limit)
+		lock_handoff (lock); // 기다리던 쓰레드에게 바로 넘겨줌
+	else
+		sema_up_locked (&lock->semaphore); // semaphore를 UP시켜, 해당 lock에서 기다리고 있는 쓰레드 하나를 깨워준다.
+}
+
+/* Makes the top waiter of LOCK, which nobody holds, its holder and
+   wakes it up, leaving the semaphore at 0 so that nobody else can
+   take LOCK first.  synch_lock must be held. */
+static void
+lock_handoff (struct lock *lock) {
+	struct thread *t = heap_entry (heap_pop (&lock->semaphore.waiters),
+			struct thread, wait_elem);
+
+	ASSERT (synch_lock.locked);
+	ASSERT (lock->holder == NULL && lock->semaphore.value == 0);
+
+	t->wait_on_sema = NULL;
+	t->wait_on_lock = NULL;
+	lock_take (lock, t, true);
+	thread_unblock (t);
 }
 
 /* Returns true if the current thread holds LOCK, false
@@ -278,10 +541,153 @@ lock_held_by_current_thread (const struct lock *lock) {
 	return lock->holder == thread_current ();
 }
 
-/* One semaphore in a list. */
-struct semaphore_elem {
-	struct list_elem elem;              /* List element. */
-	struct semaphore semaphore;         /* This semaphore. */
+/* Initializes RW.  A reader-writer lock can be held either by
+   any number of readers at once or by a single writer.
+
+   Writers are preferred: once a writer is waiting, new readers
+   wait behind it instead of starving it.  This is arranged by
+   making the writer take RW->writer, an ordinary lock, and hold it
+   until it releases RW, while readers that find RW->writer taken
+   or contended queue up on it too.  So everyone who waits for a
+   writer donates priority to it through the usual lock
+   machinery.  Readers that find no writer around only touch the
+   reader count.  A writer that gets RW->writer while readers are
+   still inside sleeps on RW->drained until the last one leaves;
+   readers, being many, do not receive donations. */
+void
+rwlock_init (struct rwlock *rw) {
+	ASSERT (rw != NULL);
+
+	lock_init (&rw->writer);
+	spin_lock_init (&rw->guard);
+	rw->readers = 0;
+	rw->draining = false;
+	sema_init (&rw->drained, 0);
+}
+
+/* Acquires RW for reading, sleeping while a writer holds it or is
+   waiting for it.  This function may sleep, so it must not be
+   called within an interrupt handler. */
+void
+rwlock_acquire_read (struct rwlock *rw) {
+	ASSERT (rw != NULL);
+	ASSERT (!intr_context ());
+	ASSERT (!lock_held_by_current_thread (&rw->writer));
+
+	/* Fast path: no writer holds or wants RW. */
+	spin_lock (&rw->guard);
+	if (rw->writer.holder == NULL && heap_empty (&rw->writer.semaphore.waiters)) {
+		rw->readers++;
+		spin_unlock (&rw->guard);
+		return;
+	}
+	spin_unlock (&rw->guard);
+
+	/* Wait our turn behind the writers. */
+	lock_acquire (&rw->writer);
+	spin_lock (&rw->guard);
+	rw->readers++;
+	spin_unlock (&rw->guard);
+	lock_release (&rw->writer);
+}
+
+/* Releases RW, which the current thread must hold for reading. */
+void
+rwlock_release_read (struct rwlock *rw) {
+	bool wake;
+
+	ASSERT (rw != NULL);
+
+	spin_lock (&rw->guard);
+	ASSERT (rw->readers > 0);
+	wake = --rw->readers == 0 && rw->draining;
+	if (wake)
+		rw->draining = false;
+	spin_unlock (&rw->guard);
+
+	if (wake)
+		sema_up (&rw->drained);
+}
+
+/* Acquires RW for writing, sleeping until all current readers and
+   any other writer have released it.  This function may sleep, so
+   it must not be called within an interrupt handler. */
+void
+rwlock_acquire_write (struct rwlock *rw) {
+	bool wait;
+
+	ASSERT (rw != NULL);
+	ASSERT (!intr_context ());
+
+	lock_acquire (&rw->writer);
+
+	spin_lock (&rw->guard);
+	wait = rw->readers > 0;
+	if (wait)
+		rw->draining = true;
+	spin_unlock (&rw->guard);
+
+	if (wait)
+		sema_down (&rw->drained);
+}
+
+/* Releases RW, which the current thread must hold for writing. */
+void
+rwlock_release_write (struct rwlock *rw) {
+	ASSERT (rw != NULL);
+	ASSERT (rwlock_write_held_by_current_thread (rw));
+
+	lock_release (&rw->writer);
+}
+
+/* Returns true if the current thread holds RW for writing. */
+bool
+rwlock_write_held_by_current_thread (const struct rwlock *rw) {
+	ASSERT (rw != NULL);
+
+	return lock_held_by_current_thread (&rw->writer);
+}
+
+/* Initializes sequence lock SL. */
+void
+seqlock_init (struct seqlock *sl) {
+	ASSERT (sl != NULL);
+
+	sl->seq = 0;
+	spin_lock_init (&sl->lock);
+}
+
+/* Starts an update of the data SL protects.  Interrupts are off
+   until the matching seqlock_write_end(), so this may be called
+   from an interrupt handler, and the update must be short. */
+void
+seqlock_write_begin (struct seqlock *sl) {
+	ASSERT (sl != NULL);
+
+	spin_lock (&sl->lock);
+	sl->seq++;
+	barrier ();
+}
+
+/* Ends an update begun by seqlock_write_begin(), letting readers
+   that overlapped it retry. */
+void
+seqlock_write_end (struct seqlock *sl) {
+	ASSERT (sl != NULL);
+	ASSERT (sl->seq & 1);
+
+	barrier ();
+	sl->seq++;
+	spin_unlock (&sl->lock);
+}
+
+/* One thread in a condition's waiter heap. */
+struct cond_waiter {
+	struct heap_elem elem;              /* Heap element. */
+	struct thread *thread;              /* Thread waiting. */
+	uint64_t seq;                       /* FIFO order among equal priorities. */
+	bool blocked;                       /* Asleep in cond_wait()? */
+	bool signaled;                      /* Taken off the heap by a signal? */
 };
 
 /* Initializes condition variable COND.  A condition variable
@@ -291,7 +697,7 @@ void
 cond_init (struct condition *cond) {
 	ASSERT (cond != NULL);
 
-	list_init (&cond->waiters);
+	heap_init (&cond->waiters, cmp_sem_priority, NULL);
 }
 
 /* Atomically releases LOCK and waits for COND to be signaled by
@@ -310,25 +716,54 @@ cond_init (struct condition *cond) {
    condition variables.  That is, there is a one-to-many mapping
    from locks to condition variables.
 
+   A signal does not wake us: cond_signal() moves us straight onto
+   LOCK's waiters, and the release of LOCK wakes us when it is our
+   turn ("wait morphing").  So a broadcast to N waiters costs one
+   wakeup per release of LOCK instead of N wakeups of which all but
+   one go back to sleep on LOCK.
+
    This function may sleep, so it must not be called within an
    interrupt handler.  This function may be called with
    interrupts disabled, but interrupts will be turned back on if
    we need to sleep. */
 void
 cond_wait (struct condition *cond, struct lock *lock) {
-	struct semaphore_elem waiter;
+	struct cond_waiter waiter;
+	struct thread *curr = thread_current ();
 
 	ASSERT (cond != NULL); // 전역변수 condition이 비어있다면 fail
 	ASSERT (lock != NULL); // lock 
 	ASSERT (!intr_context ());
 	ASSERT (lock_held_by_current_thread (lock));
 
-	sema_init (&waiter.semaphore, 0);
-	// list_push_back (&cond->waiters, &waiter.elem);
-	list_insert_ordered(&cond->waiters, &waiter.elem, cmp_sem_priority, NULL);
-	lock_release (lock);
-	sema_down (&waiter.semaphore);
-	lock_acquire (lock);
+	waiter.thread = curr;
+	waiter.blocked = false;
+	waiter.signaled = false;
+
+	/* The waiter heap is re-keyed from thread_change_priority(),
+	   possibly on behalf of another thread, so it is only touched
+	   under synch_lock.  We hold it until we sleep, so that a signal
+	   either finds us asleep or arrives before we do. */
+	spin_lock (&synch_lock);
+	waiter.seq = next_wait_seq++;
+	curr->wait_on_cond = cond;
+	curr->cond_elem = &waiter.elem;
+	heap_push (&cond->waiters, &waiter.elem);
+
+	lock_release_locked (lock);
+	while (!waiter.signaled) {
+		waiter.blocked = true;
+		thread_block_on (&synch_lock);
+		waiter.blocked = false;
+	}
+	spin_unlock (&synch_lock);
+
+	/* Usually LOCK's release has just made it ours to take, or
+	   handed it to us. */
+	if (lock_held_by_current_thread (lock))
+		lock_acquired (lock);
+	else
+		lock_acquire (lock);
 }
 
 /* If any threads are waiting on COND (protected by LOCK), then
@@ -345,11 +780,36 @@ cond_signal (struct condition *cond, struct lock *lock UNUSED) {
 	ASSERT (!intr_context ());
 	ASSERT (lock_held_by_current_thread (lock));
 
-	if (!list_empty (&cond->waiters)) {
-		list_sort(&cond->waiters, cmp_sem_priority, NULL);
-		sema_up (&list_entry (list_pop_front (&cond->waiters),
-					struct semaphore_elem, elem)->semaphore);
-	}	
+	spin_lock (&synch_lock);
+	if (!heap_empty (&cond->waiters)) {
+		struct cond_waiter *waiter =
+			heap_entry (heap_pop (&cond->waiters), struct cond_waiter, elem);
+
+		waiter->thread->wait_on_cond = NULL;
+		waiter->thread->cond_elem = NULL;
+		waiter->signaled = true;
+		if (waiter->blocked)
+			lock_enqueue (lock, waiter->thread);
+	}
+	spin_unlock (&synch_lock);
+}
+
+/* Puts T, which is blocked in cond_wait(), on the waiters of LOCK,
+   which the current thread holds, as though T had tried to acquire
+   LOCK.  T stays asleep until a release of LOCK picks it, and
+   donates its priority to us meanwhile.  synch_lock must be held. */
+static void
+lock_enqueue (struct lock *lock, struct thread *t) {
+	ASSERT (synch_lock.locked);
+	ASSERT (lock_held_by_current_thread (lock));
+
+	t->wait_seq = next_wait_seq++;
+	t->wait_on_sema = &lock->semaphore;
+	heap_push (&lock->semaphore.waiters, &t->wait_elem);
+	if (!thread_mlfqs) {
+		t->wait_on_lock = lock;
+		donate_priority_from (t);
+	}
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -362,80 +822,138 @@ void cond_broadcast (struct condition *cond, struct lock *lock) {
 	ASSERT (cond != NULL);
 	ASSERT (lock != NULL);
 
-	while (!list_empty (&cond->waiters))
+	while (!heap_empty (&cond->waiters))
 		cond_signal (cond, lock);
 }
 
-// cond waiters 안에는 세마포어를 담고 있는 semaphore_elem 구조체가 있다.
-// 그 구조체 안에는 semaphore가 있고, semaphore 안에는 해당 semaphore를 기다리는 
-// waiting_list가 있다. 그리고 이 안에는 쓰레드가 존재한다.
-bool cmp_sem_priority (const struct list_elem *a, const struct list_elem *b, void *aux) {
-	struct semaphore_elem *sema_a = list_entry(a, struct semaphore_elem, elem);
-	struct semaphore_elem *sema_b = list_entry(b, struct semaphore_elem, elem);
+// cond waiters 안에는 cond_waiter 구조체가 있다.
+// 각 cond_waiter는 기다리는 쓰레드를 가리키며,
+// 쓰레드의 우선순위가 높을수록, 같다면 먼저 기다린 쪽이 heap의 top에 가깝다.
+bool cmp_sem_priority (const struct heap_elem *a, const struct heap_elem *b, void *aux UNUSED) {
+	struct cond_waiter *sema_a = heap_entry(a, struct cond_waiter, elem);
+	struct cond_waiter *sema_b = heap_entry(b, struct cond_waiter, elem);
+
+	if (sema_a->thread->priority != sema_b->thread->priority)
+		return sema_a->thread->priority > sema_b->thread->priority;
+	return sema_a->seq < sema_b->seq;
+}
 
-	struct list *list_a = &(sema_a->semaphore.waiters);
-	struct list *list_b = &(sema_b->semaphore.waiters);
+// semaphore waiters heap의 비교 함수. 우선순위가 높을수록, 같다면 먼저 기다린 쪽이 top에 가깝다.
+static bool cmp_waiter_priority (const struct heap_elem *a, const struct heap_elem *b, void *aux UNUSED) {
+	struct thread *t_a = heap_entry(a, struct thread, wait_elem);
+	struct thread *t_b = heap_entry(b, struct thread, wait_elem);
+
+	if (t_a->priority != t_b->priority)
+		return t_a->priority > t_b->priority;
+	return t_a->wait_seq < t_b->wait_seq;
+}
 
-	struct thread *t_a = list_entry(list_begin(list_a), struct thread, elem);
-	struct thread *t_b = list_entry(list_begin(list_b), struct thread, elem);
+/* Restores the order of the waiter heaps that T is on after T's
+   priority changed.  Called by thread_change_priority() with
+   synch_lock held. */
+void synch_waiter_update (struct thread *t) {
+	ASSERT (synch_lock.locked);
 
-	return (t_a->priority > t_b->priority) ? 1 : 0 ;
+	if (t->wait_on_sema != NULL)
+		heap_update (&t->wait_on_sema->waiters, &t->wait_elem);
+	if (t->wait_on_cond != NULL)
+		heap_update (&t->wait_on_cond->waiters, t->cond_elem);
 }
 
 /* - priority donation을 수행하는 함수 
 현재 쓰레드가 기다리고 있는 lock과 연결된 모든 쓰레드를 순회하며 
-현재 쓰레드의 우선순위를 Lock을 보유하고 있는 쓰레드에게 기부한다. */
+현재 쓰레드의 우선순위를 Lock을 보유하고 있는 쓰레드에게 기부한다.
+
+   Each lock on the chain remembers the highest priority donated
+   to it, so the walk stops as soon as a lock or holder already has
+   at least PRIORITY: nothing further along can change.  synch_lock
+   must be held. */
 void donate_priority(void) 
+{
+	donate_priority_from (thread_current ());
+}
+
+/* Donates the priority of CURR, which waits on its wait_on_lock,
+   along the chain of holders, as donate_priority() does for the
+   current thread. */
+static void
+donate_priority_from (struct thread *curr)
 {
 	int depth;
-	struct thread *curr = thread_current();
+	struct lock *lock = curr->wait_on_lock;
+	int priority = curr->priority;
+
+	ASSERT (synch_lock.locked); // ready 상태인 holder를 run queue에서 옮기는 동안 다른 donation 방지
 
 	/* nested depth를 8로 제한 */
-	for (depth=0; depth < 8; depth++){
-		if (!curr->wait_on_lock) // running 쓰레드가 필요한 lock이 없다면 donation을 해줄 필요가 없음
+	for (depth=0; depth < 8 && lock != NULL; depth++){
+		struct thread *holder = lock->holder; // 내가 필요한 lock을 잡고있는 쓰레드의 정보
+
+		if (lock->max_priority >= priority) // 이미 같거나 높은 우선 순위가 donate 되어 있다면 더 볼 필요가 없음
+			break;
+		lock->max_priority = priority;
+		if (holder == NULL) // lock이 막 해제되어 아직 새 holder가 없음
+			break;
+		heap_update(&holder->held_locks, &lock->elem);
+
+		if (holder->priority >= priority)
 			break;
-		
-		struct thread *holder = curr->wait_on_lock->holder; // 내가 필요한 lock을 잡고있는 쓰레드의 정보
-		holder->priority = curr->priority; // 내가 필요한 lock을 잡고 있는 쓰레드에게 현재 쓰레드의 우선 순위를 준다.
-										   // 즉, 현재 쓰레드가 원하는 lock을 갖기 위해 처리되어야하는 쓰레드들에게 우선순위를 넘겨줌
-		curr = holder; // 다음 depth로 가기 위해 curr 갱신
+		thread_change_priority(holder, priority); // 내가 필요한 lock을 잡고 있는 쓰레드에게 현재 쓰레드의 우선 순위를 준다.
+		lock = holder->wait_on_lock; // 다음 depth로 가기 위해 lock 갱신
 	}
 }
-/* lock을 해제 했을 때, donations 리스트에서 해당 엔트리를 삭제하기 위한 역할 
-현재 쓰레드의 donations 리스트를 확인하여 해지 할 lock을 보유하고 있는 엔트리를 삭제한다. */
+/* lock을 해제 했을 때, 현재 쓰레드의 held_locks에서 해당 lock을 삭제한다.
+   synch_lock must be held. */
 void remove_with_lock(struct lock *lock) 
 {
-	struct list_elem *e;
-	struct thread *curr = thread_current();
+	ASSERT (synch_lock.locked);
 
-	for (e = list_begin(&curr->donations); e != list_end(&curr->donations); e = list_next(e)) {
-		struct thread *t = list_entry(e, struct thread, donation_elem);
-		if (t->wait_on_lock == lock) { // donation_elem를 가진 쓰레드가 lock을 가지고 있다면
-			list_remove(&t->donation_elem);
-		}
-	}
+	heap_remove(&thread_current()->held_locks, &lock->elem);
 }
-/* lock이 해제되었을 때, running 쓰레드의 priority를 갱신하는 작업 */
+/* lock이 해제되었을 때, running 쓰레드의 priority를 갱신하는 작업.
+   The donated priority is the max_priority of the top held lock,
+   so this costs O(1) regardless of the number of donors. */
 void refresh_priority(void) 
+{
+	spin_lock (&synch_lock);
+	refresh_priority_locked ();
+	spin_unlock (&synch_lock);
+}
+
+/* refresh_priority() for a caller that holds synch_lock. */
+static void
+refresh_priority_locked (void)
 { 
 	struct thread *curr = thread_current(); // 현재 쓰레드의 정보
-
-	curr->priority = curr->init_priority; // 우선 순위를 원복
+	int priority = curr->init_priority; // 우선 순위를 원복
+	struct heap_elem *top = heap_top(&curr->held_locks);
 
 	/* donation을 받고 있다면 */
-	if (!list_empty(&curr->donations)) {
-		list_sort(&curr->donations, cmp_donation_priority,NULL);
-		
-		struct thread *front = list_entry(list_front(&curr->donations), struct thread, donation_elem); // donations의 가장 높은 우선순위
-		
-		if (front->priority > curr->priority) // 만약 초기 우선 순위보다 더 큰 값이라면.
-			curr->priority = front->priority; // donation 진행
+	if (top != NULL) {
+		struct lock *front = heap_entry(top, struct lock, elem); // donate된 우선 순위가 가장 높은 lock
+
+		if (front->max_priority > priority) // 만약 초기 우선 순위보다 더 큰 값이라면.
+			priority = front->max_priority; // donation 진행
 	}
+
+	// cond_wait() 중이라면 condition의 waiters heap도 함께 갱신됨
+	thread_change_priority(curr, priority);
+}
+
+/* Sets T's effective priority to PRIORITY with
+   thread_change_priority(), taking synch_lock for it, for callers
+   outside this file. */
+void
+synch_change_priority (struct thread *t, int priority) {
+	spin_lock (&synch_lock);
+	thread_change_priority (t, priority);
+	spin_unlock (&synch_lock);
 }
 
-bool cmp_donation_priority (const struct list_elem *a, const struct list_elem *b, void *aux) {
-	struct thread *thread_a = list_entry(a, struct thread, donation_elem);
-	struct thread *thread_b = list_entry(b, struct thread, donation_elem);
+// held_locks heap의 비교 함수. donate된 우선 순위가 높은 lock이 top에 가깝다.
+bool cmp_lock_priority (const struct heap_elem *a, const struct heap_elem *b, void *aux UNUSED) {
+	struct lock *lock_a = heap_entry(a, struct lock, elem);
+	struct lock *lock_b = heap_entry(b, struct lock, elem);
 
-	return (thread_a->priority > thread_b->priority) ? 1 : 0;
+	return lock_a->max_priority > lock_b->max_priority;
 }
@@ -1,8 +1,20 @@
 threads_SRC  = threads/init.c		# Main program.
 threads_SRC += threads/thread.c		# Thread management core.
 threads_SRC += threads/interrupt.c	# Interrupt core.
+threads_SRC += threads/apic.c		# Local and I/O APICs.
+threads_SRC += threads/softirq.c	# Deferred interrupt work.
+threads_SRC += threads/trace.c		# Kernel event tracing.
+threads_SRC += threads/profile.c	# Sampling profiler.
+threads_SRC += threads/pmu.c		# Performance counters.
+threads_SRC += threads/fpu.c		# Lazy FPU switching.
+threads_SRC += threads/smp.c		# Application processor startup.
 threads_SRC += threads/intr-stubs.S	# Interrupt stubs.
+threads_SRC += threads/switch.S		# Thread switch.
+threads_SRC += threads/ap-start.S	# Application processor startup code.
 threads_SRC += threads/synch.c		# Synchronization.
+threads_SRC += threads/rcu.c		# Epoch-based reclamation.
+threads_SRC += threads/workqueue.c	# Shared kernel worker threads.
+threads_SRC += threads/tunable.c	# Boot and run time parameters.
 threads_SRC += threads/palloc.c		# Page allocator.
 threads_SRC += threads/malloc.c		# Subpage allocator.
 threads_SRC += threads/start.S		# Startup code.
@@ -1,18 +1,32 @@
 #include "threads/thread.h"
 #include <debug.h>
 #include <stddef.h>
+#include <hash.h>
 #include <random.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/apic.h"
 #include "threads/flags.h"
+#include "threads/fpu.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/intr-stubs.h"
 #include "threads/palloc.h"
+#include "threads/percpu.h"
+#include "threads/pmu.h"
+#include "threads/rcu.h"
+#include "threads/workqueue.h"
 #include "threads/synch.h"
+#include "threads/switch.h"
+#include "threads/trace.h"
+#include "threads/tunable.h"
+#include "threads/atomic.h"
+#include "threads/cpu.h"
 #include "threads/vaddr.h"
 #include "intrinsic.h"
 #include "threads/fixed_point.h"
 #include <list.h>
+#include "devices/timer.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #endif
@@ -26,61 +40,208 @@
    Do not modify this value. */
 #define THREAD_BASIC 0xd42df210
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-// 대기중인 쓰레드들이 담겨있는 큐
-static struct list ready_list;
+/* Per-CPU scheduler state: run queue of processes in
+   THREAD_READY state (대기중인 쓰레드들이 담겨있는 큐) and idle
+   thread.  See threads/cpu.h. */
+struct cpu cpus[NCPU];
+int cpu_cnt = 1;
 
-/* 자고 있는 쓰레드들이 담겨 있는 큐 */
-static struct list sleep_list;
+/* Timer ticks spent idle, in kernel threads and in user programs,
+   for thread_print_stats(). */
+static struct percpu_counter idle_ticks, kernel_ticks, user_ticks;
 
-/* sleep_list의 쓰레드 중 최소 wakeup_tick을 저장 */
-static uint64_t next_tick_to_awake;
+/* 자고 있는 쓰레드들이 담겨 있는 큐.
+   Ordered by wakeup_tick, so that the timer interrupt only ever
+   looks at the earliest sleeper. */
+static struct heap sleep_heap;
+static struct spinlock sleep_lock = SPINLOCK_INITIALIZER;  /* Also next_tick_to_awake. */
 
-/* Idle thread. */
-static struct thread *idle_thread;
+/* List of all processes.  Processes are added to this list
+   when they are first scheduled and removed when they exit. */
+static struct list all_list;
+static struct spinlock all_lock = SPINLOCK_INITIALIZER;
+
+/* sleep_heap의 쓰레드 중 최소 wakeup_tick을 저장 */
+static int64_t next_tick_to_awake;
+
+/* Protects the exited_children of every process, and the parent
+   and listed members of every child_status: a child queues itself
+   on its parent's list while the parent may be exiting on another
+   CPU. */
+static struct spinlock exited_lock = SPINLOCK_INITIALIZER;
 
 /* Initial thread, the thread running init.c:main(). */
 // 초기 쓰레드 생성
 static struct thread *initial_thread;
 
-/* Lock used by allocate_tid(). */
-static struct lock tid_lock;
-
-/* Thread destruction requests */
-// 제거를 요청할 쓰레드의 앞, 뒤 정보를 담는 구조체
-static struct list destruction_req;
+/* Next tid to hand out; see allocate_tid(). */
+static tid_t next_tid = 1;
 
+/* Pages of dead threads kept for reuse by thread_create().
+   schedule_tail() moves a dying thread here in O(1) as soon as it
+   is off its stack, instead of freeing it with interrupts off;
+   thread_create() takes a page from here before going to the page
+   allocator, and returns anything beyond THREAD_CACHE_MAX to it in
+   one batch with interrupts on.  Only the struct thread header of a
+   recycled page is cleared (by init_thread()); the rest is stack. */
+#define THREAD_CACHE_MAX 16
+static struct list thread_cache;
+static size_t thread_cache_cnt;
+static struct spinlock cache_lock = SPINLOCK_INITIALIZER;  /* Protects both. */
 
-/* Statistics. */
-static long long idle_ticks;    /* idle thread가 수행되는데 걸리는 시간 */
-static long long kernel_ticks;  /* kernel thread가 수행되는 데 걸리는 시간 */
-static long long user_ticks;    /* 사용자 프로그램이 수행되는데 걸리는 시간 */
 
 /* Scheduling. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
-static unsigned thread_ticks;   /* # of timer ticks since last yield. */
+
+/* Ticks in a time slice, TIME_SLICE unless tuned. */
+static size_t time_slice = TIME_SLICE;
+static struct tunable time_slice_tunable = {
+	.name = "sched.time_slice", .value = &time_slice,
+	.min = 1, .max = TIMER_FREQ,
+};
+
+/* Load balancing.  An idle CPU steals from the busiest peer
+   whenever its own run queue is empty, and every CPU also tries
+   every STEAL_INTERVAL ticks if a peer has at least two more ready
+   threads than it does.  Threads that were switched out less than
+   CACHE_HOT_TICKS ago are left where they are, since their working
+   set is likely still in that CPU's cache. */
+#define STEAL_INTERVAL 4
+#define CACHE_HOT_TICKS 2
+
+/* Idle.  Where the CPU has MONITOR/MWAIT, the idle thread waits with
+   MWAIT on its CPU's need_resched word instead of halting, so that
+   thread_unblock() on another CPU wakes it by just writing the word,
+   without an interrupt.  It asks for the deepest C-state the CPU
+   reports when no sleeper is due for IDLE_DEEP_TICKS ticks and the
+   tick is stopped, and for C1 otherwise, since the next tick comes
+   too soon to pay for a deeper state's exit latency. */
+#define IDLE_DEEP_TICKS 5
+static bool idle_mwait;                 /* Use MWAIT in idle()? */
+static uint32_t idle_deep_hint;         /* MWAIT hint of the deepest C-state. */
+
+/* Fair-share scheduling, "-o fair".  Each thread accrues virtual
+   runtime: the TSC cycles it has run, scaled by FAIR_WEIGHT_0 over
+   the weight of its nice value, so that each step down in nice buys
+   about 25% more CPU.  A CPU runs its ready thread of least vruntime,
+   taken from a red-black tree in O(lg n), for time_slice ticks at a
+   time, and there is no periodic recalculation: a thread is charged
+   only when it stops running or is checked for preemption.
+
+   min_vruntime follows the least vruntime on the CPU.  A thread that
+   wakes up is placed no more than FAIR_SLEEP_CREDIT ticks' worth
+   behind it, so sleeping does not bank CPU time, and preempts the
+   running thread if it trails it by more than FAIR_WAKEUP_GRAN.
+   Priorities still order the waiters of locks and semaphores. */
+#define FAIR_WEIGHT_0 1024
+#define FAIR_SLEEP_CREDIT time_slice
+#define FAIR_WAKEUP_GRAN 1
+
+/* Weight of each nice value from -20 to 20, as in Linux. */
+static const int fair_weights[41] = {
+	88761, 71755, 56483, 46273, 36291, 29154, 23254, 18705, 14949, 11916,
+	9548, 7620, 6100, 4904, 3906, 3121, 2501, 1991, 1586, 1277,
+	1024, 820, 655, 526, 423, 335, 272, 215, 172, 137,
+	110, 87, 70, 56, 45, 36, 29, 23, 18, 15,
+	12,
+};
+
+/* Deadline scheduling.  A thread that calls thread_set_deadline()
+   is given DL_RUNTIME ticks of CPU in every DL_PERIOD ticks, to be
+   used within DL_DEADLINE ticks of the start of the period, and
+   runs before every thread that is not a deadline thread, earliest
+   deadline first.  The timer tick charges its budget; once that is
+   spent, the thread sleeps until its next period starts, so that it
+   cannot take more than it asked for.  A thread that wakes up keeps
+   its deadline and budget unless finishing the budget by the
+   deadline would exceed its bandwidth, in which case it starts a
+   new period (the constant bandwidth server rule).
+
+   The bandwidths RUNTIME / PERIOD of all deadline threads may add
+   up to no more than DL_BW_LIMIT, in units of 2^-DL_BW_SHIFT of a
+   CPU, which leaves some time to everything else.  Below that EDF
+   meets every deadline on one CPU.  Deadline threads are not moved
+   between CPUs and may all be on one, so the limit is that of one
+   CPU however many are online. */
+#define DL_BW_SHIFT 20
+#define DL_BW_LIMIT (((int64_t) 1 << DL_BW_SHIFT) * 95 / 100)
+static int64_t dl_total_bw;             /* Admitted so far. */
+static struct spinlock dl_lock = SPINLOCK_INITIALIZER;  /* Protects dl_total_bw. */
 
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* If true, use the fair-share scheduler; see FAIR_WEIGHT_0.
+   Controlled by kernel command-line option "-o fair". */
+bool thread_fair;
+
 /* 1분 동안 수행 가능한 프로세스의 평균 개수. */
 int load_avg;
 
+/* recent_cpu's decay coefficient for the current load_avg; see
+   mlfqs_decay().  Both change once a second and are read without
+   turning interrupts off, so they are updated together under
+   load_seq. */
+static int load_decay;
+static struct seqlock load_seq;
+
+static int load_decay_of (int load);
+
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
+static void idle_loop (void) NO_RETURN;
+static intr_handler_func resched_interrupt;
 static struct thread *next_thread_to_run (void);
 static void init_thread (struct thread *, const char *name, int priority);
 static void do_schedule(int status);
 static void schedule (void);
 static tid_t allocate_tid (void);
+static struct thread *thread_alloc (void);
+static void thread_cache_reap (void);
+static void exit_child_status (void);
+static uint64_t child_hash (const struct ohash_elem *, void *);
+static bool child_less (const struct ohash_elem *, const struct ohash_elem *,
+		void *);
+static void child_status_drop (struct ohash_elem *, void *);
+static void child_status_post (struct child_status *);
+static void cpu_init (struct cpu *, int id);
+static void ready_queue_push (struct cpu *, struct thread *);
+static void ready_queue_remove (struct cpu *, struct thread *);
+static struct thread *ready_queue_pop (struct cpu *);
+static int ready_queue_max_priority (struct cpu *);
+static bool ready_queue_preempts (struct cpu *, struct thread *,
+		unsigned gran);
+static bool fair_less (const struct rb_elem *, const struct rb_elem *,
+		void *aux);
+static int64_t fair_cycles (unsigned ticks);
+static void fair_charge (struct thread *, uint64_t now);
+static bool dl_less (const struct rb_elem *, const struct rb_elem *,
+		void *aux);
+static int64_t dl_bw (const struct thread *);
+static void dl_replenish (struct thread *, int64_t now);
+static void dl_wakeup (struct thread *);
+static bool dl_throttle (struct thread *);
+static bool thread_is_idle (const struct thread *);
+static void idle_init (void);
+static void idle_wait (struct cpu *);
+static bool cpu_steal (struct cpu *, int margin);
+static bool cpu_is_idle (const struct cpu *);
+static void cpu_kick (struct cpu *);
+static struct cpu *thread_select_cpu (struct thread *);
+static struct cpu *rq_lock_thread (struct thread *, struct cpu *);
+static void rq_lock_pair (struct cpu *, struct cpu *);
+static void rq_unlock_pair (struct cpu *, struct cpu *);
+static void thread_mark_blocked (struct thread *);
+static struct thread *thread_by_tid (tid_t);
+static bool cmp_wakeup_tick (const struct heap_elem *, const struct heap_elem *,
+		void *aux);
 
 /* 1. Alarm Call */
 void thread_sleep(int64_t ticks);				// 실행중인 쓰레드를 슬립으로 바꿈
-void thread_awake(int64_t ticks);				// sleep_list에서 깨워야할 쓰레드를 깨움
+void thread_awake(int64_t ticks);				// sleep_heap에서 깨워야할 쓰레드를 깨움
 void update_next_tick_to_awake(int64_t ticks); // 최소 tick을 가진 쓰레드 저장
 int64_t get_next_tick_to_awake(void);		   // thread.c의 next_tick_to_awake 반환
 
@@ -121,6 +282,8 @@ static uint64_t gdt[3] = { 0, 0x00af9a000000ffff, 0x00cf92000000ffff };
    finishes. */
 void thread_init (void) {
 	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (offsetof (struct thread, switch_rsp) + sizeof (uint64_t)
+			<= THREAD_HOT_BYTES);
 
 	/* Reload the temporal gdt for the kernel
 	 * This gdt does not include the user context.
@@ -132,17 +295,22 @@ void thread_init (void) {
 	lgdt (&gdt_ds);
 
 	/* Init the globla thread context */
-	lock_init (&tid_lock);
-	list_init (&ready_list);
-	list_init (&destruction_req);
-	list_init (&sleep_list);
+	for (int i = 0; i < NCPU; i++)
+		cpu_init (&cpus[i], i);
+	list_init (&thread_cache);
+	thread_cache_cnt = 0;
+	list_init (&all_list);
+	heap_init (&sleep_heap, cmp_wakeup_tick, NULL);
+	seqlock_init (&load_seq);
 	next_tick_to_awake = INT64_MAX;
+	tunable_register (&time_slice_tunable);
 
 	/* Set up a thread structure for the running thread. */
 	initial_thread = running_thread ();
 	init_thread (initial_thread, "main", PRI_DEFAULT);
 	initial_thread->status = THREAD_RUNNING;
 	initial_thread->tid = allocate_tid ();
+	initial_thread->cpu = initial_thread->on_cpu = &cpus[0];
 }
 
 /* Starts preemptive thread scheduling by enabling interrupts.
@@ -152,46 +320,182 @@ void thread_start (void) {
 	/* Create the idle thread. */
 	struct semaphore idle_started;
 	sema_init (&idle_started, 0);
-	// idle 쓰레드를 만들고, 맨 처음 ready_list에 들어감
+	idle_init ();
+
+	/* 처음 스레드도 자식을 두려면 프로세스가 있어야 함. 이제 malloc을 쓸 수 있음 */
+	initial_thread->process = process_alloc ();
+	if (initial_thread->process == NULL)
+		PANIC ("thread_start: out of memory");
+	// idle 쓰레드를 만들고, 맨 처음 ready queue에 들어감
 	// 세마포어를 1로 UP 시켜 공유자원에 접근이 가능하게 만들고 바로 block
 	thread_create ("idle", PRI_MIN, idle, &idle_started);
+	if (apic_enabled ())
+		intr_register_ext (APIC_VEC_RESCHED, resched_interrupt,
+				"Reschedule IPI");
 
 	/* Start preemptive thread scheduling. */
 	// 인터럽트 활성화. 이제 쓰레드 스케줄링이 가능하다.
+	thread_current ()->fair_stamp = rdtsc ();
 	intr_enable ();
 
 	// fp 연산을 할 수 있도록 load_avg를 초기화 해줌
+	seqlock_write_begin (&load_seq);
 	load_avg = LOAD_AVG_DEFAULT;
+	load_decay = load_decay_of (LOAD_AVG_DEFAULT);
+	seqlock_write_end (&load_seq);
 
 	/* Wait for the idle thread to initialize idle_thread. */
 	sema_down (&idle_started);
 }
 
+/* Makes a thread of a new page for application processor C to
+   start on, from the top of the page, and then to idle on.  It is
+   running already, as far as the scheduler can tell.  Returns the
+   thread, or a null pointer if memory is exhausted. */
+struct thread *
+thread_create_idle (struct cpu *c) {
+	struct thread *t = thread_alloc ();
+
+	if (t == NULL)
+		return NULL;
+	init_thread (t, "idle", PRI_MIN);
+	t->tid = allocate_tid ();
+	t->affinity = 1ULL << c->id;
+	t->status = THREAD_RUNNING;
+	t->cpu = t->on_cpu = c;
+	c->idle_thread = t;
+	return t;
+}
+
+/* Called by smp.c on an application processor, running as the
+   thread that thread_create_idle() made for it, once the CPU is set
+   up to take interrupts and IPIs.  Counts the CPU online, so that
+   the others balance work onto it and include it in TLB
+   shootdowns, and idles. */
+void
+thread_start_ap (void) {
+	struct thread *t = thread_current ();
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	t->fair_stamp = t->rusage_stamp = rdtsc ();
+	atomic_fetch_add (&cpu_cnt, 1);
+	idle_loop ();
+}
+
 /* Called by the timer interrupt handler at each timer tick.
    Thus, this function runs in an external interrupt context. */
 void thread_tick (void) {
+	struct cpu *c = this_cpu ();
 	struct thread *t = thread_current ();
 
 	/* Update statistics. */
-	if (t == idle_thread)
-		idle_ticks++;
+	if (t == c->idle_thread)
+		percpu_counter_inc (&idle_ticks);   /* idle thread가 수행되는데 걸리는 시간 */
 #ifdef USERPROG
-	else if (t->pml4 != NULL)
-		user_ticks++;
+	else if (thread_pml4 (t) != NULL)
+		percpu_counter_inc (&user_ticks);   /* 사용자 프로그램이 수행되는데 걸리는 시간 */
 #endif
 	else
-		kernel_ticks++;
+		percpu_counter_inc (&kernel_ticks); /* kernel thread가 수행되는 데 걸리는 시간 */
 
-	/* Enforce preemption. */
-	if (++thread_ticks >= TIME_SLICE)
+	/* Grace periods and delayed work are global; the boot CPU's
+	   tick drives them. */
+	if (c == &cpus[0]) {
+		rcu_tick ();
+		workqueue_tick ();
+	}
+
+	/* Pull work from an overloaded peer, and run it now if it beats
+	   the current thread. */
+	if (timer_ticks () % STEAL_INTERVAL == 0 && cpu_steal (c, 2)
+			&& ready_queue_preempts (c, t, 0))
+		intr_yield_on_return ();
+
+	/* A deadline thread that has spent its budget must wait for its
+	   next period; thread_yield() puts it to sleep. */
+	if (t->dl_runtime != 0 && --t->dl_budget <= 0)
+		intr_yield_on_return ();
+
+	/* Enforce preemption.  Under -fair a thread whose slice is up
+	   keeps the CPU while no ready thread has run less. */
+	if (++c->thread_ticks >= time_slice
+			&& (!thread_fair || ready_queue_preempts (c, t, 0)))
 		intr_yield_on_return ();
 }
 
-/* Prints thread statistics. */
+/* Prints thread statistics, summed over all CPUs. */
 void
 thread_print_stats (void) {
 	printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
-			idle_ticks, kernel_ticks, user_ticks);
+			(long long) percpu_counter_read (&idle_ticks),
+			(long long) percpu_counter_read (&kernel_ticks),
+			(long long) percpu_counter_read (&user_ticks));
+}
+
+/* Charges the time since the running thread's last mode change to
+   user mode, as it traps into the kernel.  Called on system call
+   entry and on interrupts from user mode. */
+void
+thread_enter_kernel (void) {
+	struct thread *t = thread_current ();
+	uint64_t now = rdtsc ();
+
+	t->rusage.user_cycles += now - t->rusage_stamp;
+	t->rusage_stamp = now;
+}
+
+/* Charges the time since the running thread's last mode change or
+   switch to the kernel, as it returns to user mode. */
+void
+thread_leave_kernel (void) {
+	struct thread *t = thread_current ();
+	uint64_t now = rdtsc ();
+
+	t->rusage.kernel_cycles += now - t->rusage_stamp;
+	t->rusage_stamp = now;
+}
+
+/* Adds the figures of B to A. */
+void
+rusage_add (struct rusage *a, const struct rusage *b) {
+	a->user_cycles += b->user_cycles;
+	a->kernel_cycles += b->kernel_cycles;
+	a->voluntary_switches += b->voluntary_switches;
+	a->involuntary_switches += b->involuntary_switches;
+	a->minor_faults += b->minor_faults;
+	a->major_faults += b->major_faults;
+	a->bytes_read += b->bytes_read;
+	a->bytes_written += b->bytes_written;
+}
+
+/* Stores in RU what the running thread has used up to now, or, if
+   CHILDREN, what the children it waited for used. */
+void
+thread_get_rusage (struct rusage *ru, bool children) {
+	struct thread *t = thread_current ();
+	enum intr_level old_level = intr_disable ();
+
+	if (children)
+		*ru = t->rusage_children;
+	else {
+		thread_leave_kernel ();
+		*ru = t->rusage;
+#ifdef VM
+		ru->minor_faults = t->vmstat.minor_faults + t->vmstat.cow_faults
+			+ t->vmstat.stack_faults;
+		ru->major_faults = t->vmstat.major_faults;
+#endif
+	}
+	intr_set_level (old_level);
+	ru->cycles_per_sec = timer_tsc_hz ();
+}
+
+/* Adds the usage left in the record of CHILD, which has exited, to
+   the running thread's children's. */
+void
+thread_reap_rusage (const struct child_status *child) {
+	rusage_add (&thread_current ()->rusage_children, &child->rusage);
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -210,7 +514,7 @@ thread_print_stats (void) {
    PRIORITY, but no actual priority scheduling is implemented.
    Priority scheduling is the goal of Problem 1-3. */
 
-/* 새 커널 스레드를 만들고 바로 ready_list에 넣어줌 */
+/* 새 커널 스레드를 만들고 바로 ready queue에 넣어줌 */
 tid_t thread_create (const char *name, int priority,
 		thread_func *function, void *aux) {
 	struct thread *t;
@@ -219,13 +523,18 @@ tid_t thread_create (const char *name, int priority,
 	ASSERT (function != NULL);
 
 	/* Allocate thread. */
-	t = palloc_get_page (PAL_ZERO);
+	thread_cache_reap ();
+	t = thread_alloc ();
 	if (t == NULL)
 		return TID_ERROR;
 
 	/* Initialize thread. */
 	init_thread (t, name, priority);
 	tid = t->tid = allocate_tid ();
+	t->affinity = thread_current ()->affinity;
+	t->ioprio = thread_current ()->ioprio;
+	t->cpu = this_cpu ();
+	t->vruntime = t->cpu->min_vruntime;
 
 
 	// /* Call the kernel_thread if it scheduled.
@@ -264,22 +573,43 @@ tid_t thread_create (const char *name, int priority,
 
 	// return tid;
 
-	/* 현재 스레드의 자식 리스트에 새로 생성한 스레드 추가 */
-    struct thread *curr = thread_current();
-	printf(&curr->child_list);
-	printf(&t->child_elem);
-	list_push_back(&curr->child_list,&t->child_elem);
-
-    /* 파일 디스크립터 초기화 */
-    t->file_descriptor_table = palloc_get_multiple(PAL_ZERO,FDT_PAGES);
-    if(t->file_descriptor_table == NULL)
-        return TID_ERROR;
-    t->fdidx = 2;
-    t->file_descriptor_table[0] = 1;
-    t->file_descriptor_table[1] = 2;
-
-    t->stdin_count = 1;
-    t->stdout_count = 1;
+	/* 현재 프로세스의 자식 목록에 새로 생성한 스레드의 기록 추가 */
+	struct process *parent = thread_current ()->process;
+	struct child_status *cs = malloc (sizeof *cs);
+
+	/* 프로세스와 파일 디스크립터 초기화. 처음엔 이 스레드 혼자 */
+	struct process *p = process_alloc ();
+	bool hashed = false;
+
+	ASSERT (parent != NULL);
+	if (cs != NULL && p != NULL) {
+		lock_acquire (&parent->child_lock);
+		hashed = parent->children.hash != NULL
+			|| ohash_init (&parent->children, child_hash, child_less, NULL);
+		if (hashed) {
+			cs->tid = tid;
+			cs->exit_status = 0;
+			cs->refcnt = 2;
+			sema_init (&cs->fork_sema, 0);
+			sema_init (&cs->wait_sema, 0);
+			cs->parent = parent;
+			cs->listed = false;
+			cs->claimed = false;
+			ohash_insert (&parent->children, &cs->elem);
+		}
+		lock_release (&parent->child_lock);
+	}
+	if (!hashed) {
+		spin_lock (&all_lock);
+		list_remove (&t->all_elem);
+		spin_unlock (&all_lock);
+		free (cs);
+		process_free (p);
+		palloc_free_page (t);
+		return TID_ERROR;
+	}
+	t->child_status = cs;
+	t->process = p;
 
     /* Call the kernel_thread if it scheduled.
      * Note) rdi is 1st argument, and rsi is 2nd argument. */
@@ -296,7 +626,7 @@ tid_t thread_create (const char *name, int priority,
     thread_unblock (t);
 
     /* 만약 새로 만든 thread의 우선순위가 현재 실행되고 있는 thread보다 높으면 yields*/
-    if (curr->priority < t->priority) {
+    if (thread_current ()->priority < t->priority) {
 		thread_yield();
 	}
 
@@ -309,14 +639,46 @@ tid_t thread_create (const char *name, int priority,
 
    This function must be called with interrupts turned off.  It
    is usually a better idea to use one of the synchronization
-   primitives in synch.h. */
+   primitives in synch.h.  Only this CPU is kept out by turning
+   interrupts off, so a thread whose waker may run on another CPU
+   should use thread_block_on() instead. */
 void thread_block (void) {
 	ASSERT (!intr_context ());
 	ASSERT (intr_get_level () == INTR_OFF);
-	thread_current ()->status = THREAD_BLOCKED;
+	thread_mark_blocked (thread_current ());
 	schedule ();
 }
 
+/* Puts the current thread to sleep like thread_block(), releasing
+   LOCK, which the caller holds and which protects whatever the
+   waker finds the thread on, and takes LOCK again after waking up.
+   LOCK is only released once the thread is marked blocked, so a
+   waker that holds LOCK either finds it blocked or runs before it
+   went to sleep, and cannot miss it.  Interrupts stay off
+   throughout. */
+void
+thread_block_on (struct spinlock *lock) {
+	enum intr_level old_level;
+
+	ASSERT (!intr_context ());
+	ASSERT (intr_get_level () == INTR_OFF);
+	thread_mark_blocked (thread_current ());
+	old_level = spin_unlock_irqoff (lock);
+	schedule ();
+	spin_relock (lock, old_level);
+}
+
+/* Marks T, the running thread, blocked, charging it for its run
+   under -fair first: once a waker may see it blocked, it may be put
+   on a run queue, which is ordered by vruntime. */
+static void
+thread_mark_blocked (struct thread *t) {
+	TRACE (BLOCK, 0);
+	if (thread_fair && t != this_cpu ()->idle_thread)
+		fair_charge (t, rdtsc ());
+	t->status = THREAD_BLOCKED;
+}
+
 /* Transitions a blocked thread T to the ready-to-run state.
    This is an error if T is not blocked.  (Use thread_yield() to
    make the running thread ready.)
@@ -324,20 +686,50 @@ void thread_block (void) {
    This function does not preempt the running thread.  This can
    be important: if the caller had disabled interrupts itself,
    it may expect that it can atomically unblock a thread and
-   update other data. */
+   update other data.
 
-// sleep_list에 있는 요소를 unblock 해주고, ready_list로 넣어주는 함수
+   T may not have finished switching out on its CPU yet.  Then it
+   goes back on that CPU's run queue, where no other CPU can pick
+   it up before it is off; see schedule_tail(). */
+
+// block된 쓰레드를 unblock 해주고, ready queue로 넣어주는 함수
 void thread_unblock (struct thread *t) {
 	enum intr_level old_level;
+	struct cpu *c, *last;
 
 	ASSERT (is_thread (t));
 	// 리스트로 요소를 삽입하는 동안 인터럽트가 발생하지 않도록 인터럽트를 비활성화
 	old_level = intr_disable ();
 	ASSERT (t->status == THREAD_BLOCKED);
-	list_insert_ordered(&ready_list, &t->elem, cmp_priority, NULL);
-	// 인터럽트 원복
+	TRACE (UNBLOCK, t->tid);
+	c = t->on_cpu;
+	if (c == NULL)
+		c = thread_select_cpu (t);
+	last = rq_lock_thread (t, c);
+	if (thread_fair) {
+		/* Place T against the CPU it last ran on; ready_queue_push()
+		   moves it to C's. */
+		int64_t floor = last->min_vruntime - fair_cycles (FAIR_SLEEP_CREDIT);
+
+		if (t->vruntime < floor)
+			t->vruntime = floor;
+	}
+	if (t->dl_runtime != 0)
+		dl_wakeup (t);
+	ready_queue_push (c, t);
 	t->status = THREAD_READY; // ready 상태로 갱신
+	rq_unlock_pair (last, c);
+
+	if (c != this_cpu ())
+		cpu_kick (c);
+
+	/* A deadline thread woken by an interrupt runs as soon as the
+	   interrupt returns if it is the most urgent. */
+	if (t->dl_runtime != 0 && intr_context () && c == this_cpu ()
+			&& ready_queue_preempts (c, thread_current (), 0))
+		intr_yield_on_return ();
 
+	// 인터럽트 원복
 	intr_set_level (old_level);
 }
 
@@ -390,28 +782,219 @@ void thread_exit (void) {
 	// printf("유저로!\n");
 	process_exit (); // 유저 프로그램에서 요청 왔을 시 process_exit()
 #endif
+	exit_child_status ();
+	fpu_release (thread_current ());
+	if (thread_current ()->dl_runtime != 0)
+		thread_set_deadline (0, 0, 0);
 	// printf("유저 아님!\n");
 	/* Just set our status to dying and schedule another process.
-	   We will be destroyed during the call to schedule_tail(). */
+	   Our page goes to thread_cache in schedule_tail(). */
 	intr_disable ();
+	spin_lock (&all_lock);
+	list_remove (&thread_current ()->all_elem);
+	spin_unlock (&all_lock);
 	do_schedule (THREAD_DYING);
 	NOT_REACHED ();
 }
 
+/* Leaves our exit status in our own record and lets go of it,
+   waking a parent in wait() or waitany().  Without user programs,
+   also frees our process, which no other thread can share.  Nothing
+   of ours is needed after this, so the thread can be freed as soon
+   as it has died. */
+static void
+exit_child_status (void) {
+	struct thread *curr = thread_current ();
+
+#ifndef USERPROG
+	process_free (curr->process);
+	curr->process = NULL;
+#endif
+	if (curr->child_status != NULL) {
+		curr->child_status->exit_status = curr->exit_status;
+		thread_get_rusage (&curr->child_status->rusage, false);
+		rusage_add (&curr->child_status->rusage, &curr->rusage_children);
+		child_status_post (curr->child_status);
+		sema_up (&curr->child_status->wait_sema);
+		child_status_release (curr->child_status);
+	}
+}
+
+/* Returns a hash of the tid of child_status E. */
+static uint64_t
+child_hash (const struct ohash_elem *e, void *aux UNUSED) {
+	return hash_int (ohash_entry (e, struct child_status, elem)->tid);
+}
+
+/* Returns true if child_status A has a lower tid than B. */
+static bool
+child_less (const struct ohash_elem *a, const struct ohash_elem *b,
+		void *aux UNUSED) {
+	return ohash_entry (a, struct child_status, elem)->tid
+		< ohash_entry (b, struct child_status, elem)->tid;
+}
+
+/* Queues CS, whose child is exiting, on its parent process's
+   exited_children, unless the parent has exited already. */
+static void
+child_status_post (struct child_status *cs) {
+	struct process *parent;
+
+	spin_lock (&exited_lock);
+	parent = cs->parent;
+	if (parent != NULL) {
+		list_push_back (&parent->exited_children, &cs->exit_elem);
+		cs->listed = true;
+		/* The parent may be freed once we let go of exited_lock. */
+		sema_up_noyield (&parent->child_exited);
+	}
+	spin_unlock (&exited_lock);
+}
+
+/* Drops the parent's hold on child_status E, for ohash_destroy().
+   The child no longer has anyone to queue it for. */
+static void
+child_status_drop (struct ohash_elem *e, void *aux UNUSED) {
+	struct child_status *cs = ohash_entry (e, struct child_status, elem);
+
+	spin_lock (&exited_lock);
+	cs->parent = NULL;
+	cs->listed = false;
+	spin_unlock (&exited_lock);
+	child_status_release (cs);
+}
+
+/* Takes CS, whose child has exited, off the exited_children of P, its
+   parent, together with its up of child_exited, unless waitany() took
+   it first.  For a wait() for CS's child in particular. */
+void
+child_status_unlist (struct process *p, struct child_status *cs) {
+	spin_lock (&exited_lock);
+	if (cs->listed) {
+		list_remove (&cs->exit_elem);
+		cs->listed = false;
+		sema_try_down (&p->child_exited);
+	}
+	spin_unlock (&exited_lock);
+}
+
+/* Takes the child that exited first off P's exited_children and
+   returns it, for waitany() after it downed P's child_exited, or
+   returns a null pointer if a wait() took it first. */
+struct child_status *
+child_status_pop_exited (struct process *p) {
+	struct child_status *cs = NULL;
+
+	spin_lock (&exited_lock);
+	if (!list_empty (&p->exited_children)) {
+		cs = list_entry (list_pop_front (&p->exited_children),
+				struct child_status, exit_elem);
+		cs->listed = false;
+	}
+	spin_unlock (&exited_lock);
+	return cs;
+}
+
+/* Returns a new process for one thread, with an empty file
+   descriptor table but for the console's fds, or a null pointer if
+   memory is exhausted. */
+struct process *
+process_alloc (void) {
+	struct process *p = calloc (1, sizeof *p);
+
+	if (p == NULL)
+		return NULL;
+	p->file_descriptor_table = calloc (1, FDT_BYTES (FDT_INITIAL));
+	if (p->file_descriptor_table == NULL) {
+		free (p);
+		return NULL;
+	}
+	p->thread_cnt = 1;
+	spin_lock_init (&p->leave_lock);
+	p->fd_cap = FDT_INITIAL;
+	p->fd_used = (uint64_t *) (p->file_descriptor_table + FDT_INITIAL);
+	p->file_descriptor_table[0] = 1;
+	p->file_descriptor_table[1] = 2;
+	p->fd_used[0] = 0x3;
+	p->stdin_count = 1;
+	p->stdout_count = 1;
+#ifdef VM
+	lock_init (&p->vm_lock);
+#endif
+	lock_init (&p->child_lock);
+	list_init (&p->exited_children);
+	sema_init (&p->child_exited, 0);
+	return p;
+}
+
+/* Lets go of the records of P's children that were never waited
+   for and frees P, if P is not null.  Its files must be closed and
+   its address space destroyed already. */
+void
+process_free (struct process *p) {
+	if (p == NULL)
+		return;
+	if (p->children.hash != NULL)
+		ohash_destroy (&p->children, child_status_drop);
+	free (p->file_descriptor_table);
+	free (p);
+}
+
+/* Drops one hold on CS, the parent's or the child's, and frees it
+   when neither holds it any more. */
+void
+child_status_release (struct child_status *cs) {
+	if (atomic_fetch_add (&cs->refcnt, -1) == 1)
+		free (cs);
+}
+
 /* Yields the CPU.  The current thread is not put to sleep and
    may be scheduled again immediately at the scheduler's whim. */
-/* cpu를 양보하고 ready_list에 스레드를 삽입하는 함수 */
+/* cpu를 양보하고 ready queue에 스레드를 삽입하는 함수 */
 void thread_yield (void) {
 	struct thread *curr = thread_current (); // 현재 실행중인 thread를 저장
 	enum intr_level old_level;
+	struct cpu *c;
 
 	ASSERT (!intr_context ()); // 외부 인터럽트를 수행중이라면 종료. 외부 인터럽트는 인터럽트를 당하면 안된다
 
 	old_level = intr_disable (); // 인터럽트 중지 및 이전 인터럽트 상태 저장
-	if (curr != idle_thread) // 현재 쓰레드가 idle 쓰레드가 아니라면
-		// list_push_back (&ready_list, &curr->elem); // 현재 스레드를 대기큐의 마지막으로 보냄
-		list_insert_ordered(&ready_list, &curr->elem, cmp_priority, NULL);
-	do_schedule (THREAD_READY); // 대기큐 첫번째에 있는 쓰레드와 컨텍스트 스위칭
+	c = this_cpu ();
+	if (curr->dl_runtime != 0 && curr->dl_budget <= 0) {
+		bool throttled;
+
+		spin_lock (&sleep_lock);
+		throttled = dl_throttle (curr);
+		if (throttled)
+			thread_block_on (&sleep_lock); // 다음 주기까지 sleep_heap에서 기다림
+		spin_unlock (&sleep_lock);
+		if (throttled) {
+			intr_set_level (old_level);
+			return;
+		}
+	}
+	if (curr == c->idle_thread)
+		curr->status = THREAD_READY;
+	else { // 현재 쓰레드가 idle 쓰레드가 아니라면
+		if (thread_fair)
+			fair_charge (curr, rdtsc ());
+		if (curr->affinity & (1ULL << c->id)) {
+			/* Once we are on the run queue and ready, only this CPU
+			   may pick us up, and only as its running thread. */
+			ASSERT (curr->cpu == c);
+			spin_lock (&c->rq_lock);
+			ready_queue_push (c, curr); // 현재 스레드를 자신의 우선순위 큐의 마지막으로 보냄
+			curr->status = THREAD_READY;
+			spin_unlock (&c->rq_lock);
+		} else {
+			/* We may not run here any more, but another CPU must not
+			   pick us up while we are still on this one, so
+			   schedule_tail() queues us once we are off. */
+			curr->migrating = true;
+			curr->status = THREAD_BLOCKED;
+		}
+	}
+	schedule (); // 대기큐 첫번째에 있는 쓰레드와 컨텍스트 스위칭
 	intr_set_level (old_level); // 인자로 전달된 인터럽트 상태로 인터럽트를 설정하고, 이전 인터럽트 상태를 반환
 }
 
@@ -436,7 +1019,7 @@ void thread_set_priority (int new_priority) {
 	thread_current() ->init_priority = new_priority;
 
 	/* 초기 우선순위가 변경되었을 때, 해당 쓰레드의 새 우선 순위와
-	donations 안의 우선 순위를 비교해서 donate가 제대로 이루어질 수 있도록 한다. */
+	들고 있는 lock들에 donate된 우선 순위를 비교해서 donate가 제대로 이루어질 수 있도록 한다. */
 	refresh_priority();
 
 	test_max_priority();
@@ -449,6 +1032,31 @@ thread_get_priority (void) {
 	return thread_current ()->priority;
 }
 
+/* Sets the current thread's I/O priority class to IOPRIO, one of
+   the IOPRIO_* values.  IOPRIO_NONE makes it follow the thread's
+   priority again. */
+void
+thread_set_ioprio (int ioprio) {
+	ASSERT (ioprio >= IOPRIO_NONE && ioprio <= IOPRIO_IDLE);
+	thread_current ()->ioprio = ioprio;
+}
+
+/* Returns the class the disk serves the current thread's requests
+   in: the one it set, or else IOPRIO_RT above the default priority,
+   IOPRIO_IDLE below it and IOPRIO_BE at it.  A donated priority
+   counts, so a holder of a lock that others wait for is not held
+   up behind lower classes. */
+int
+thread_get_ioprio (void) {
+	struct thread *t = thread_current ();
+
+	if (t->ioprio != IOPRIO_NONE)
+		return t->ioprio;
+	if (t->priority > PRI_DEFAULT)
+		return IOPRIO_RT;
+	return t->priority < PRI_DEFAULT ? IOPRIO_IDLE : IOPRIO_BE;
+}
+
 /* Sets the current thread's nice value to NICE. */
 // 현재 쓰레드의 nice 값을 새 값으로 수정
 void
@@ -456,8 +1064,11 @@ thread_set_nice (int nice UNUSED) {
 	/* TODO: Your implementation goes here */
 	// 현재 쓰레드의 nice 값을 새 값으로 수정
 	enum intr_level old_level = intr_disable();
+	if (thread_fair)
+		fair_charge (thread_current (), rdtsc ()); // 지금까지는 이전 nice의 weight로
 	thread_current() -> nice = nice;
-	mlfqs_priority(thread_current());
+	if (!thread_fair)
+		mlfqs_priority(thread_current());
 	test_max_priority(); // 우선순위에 의해 스케줄링
 	intr_set_level(old_level);
 
@@ -479,11 +1090,14 @@ thread_get_nice (void) {
 // 현재 시스템의 load_avg * 100 값을 반환
 int
 thread_get_load_avg (void) {
-	/* TODO: Your implementation goes here */
-	enum intr_level old_level = intr_disable();
-	int load_avg_value = fp_to_int_round(mult_mixed(load_avg, 100));
-	intr_set_level(old_level);
-	return load_avg_value;
+	int load;
+	unsigned seq;
+
+	do {
+		seq = seqlock_read_begin (&load_seq);
+		load = load_avg;
+	} while (seqlock_read_retry (&load_seq, seq));
+	return fp_to_int_round(mult_mixed(load, 100));
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
@@ -497,6 +1111,21 @@ thread_get_recent_cpu (void) {
 	return recent_cpu_value;
 }
 
+/* Returns the number of threads that are ready or running, not
+   counting the idle thread. */
+int
+thread_nr_running (void) {
+	enum intr_level old_level = intr_disable ();
+	int nr_running = 0;
+
+	for (int i = 0; i < cpu_cnt; i++)
+		nr_running += cpus[i].nr_ready;
+	if (thread_current () != this_cpu ()->idle_thread)
+		nr_running++; // idle 쓰레드가 아닐 경우, running 쓰레드까지 더해 준다.
+	intr_set_level (old_level);
+	return nr_running;
+}
+
 /* Idle thread.  Executes when no other thread is ready to run.
 
    The idle thread is initially put on the ready list by
@@ -511,14 +1140,26 @@ thread_get_recent_cpu (void) {
 static void idle (void *idle_started_ UNUSED) {
 	struct semaphore *idle_started = idle_started_;
 
-	idle_thread = thread_current (); // 현재 돌고 있는 쓰레드가 idle 밖에 없음.
+	this_cpu ()->idle_thread = thread_current (); // 현재 돌고 있는 쓰레드가 idle 밖에 없음.
 	sema_up (idle_started); // 세마포어의 값을 1로 만들어서 공유 자원의 공유 (인터럽트)가 가능하게 만듬.
+	idle_loop ();
+}
 
+/* Body of every CPU's idle thread. */
+static void
+idle_loop (void) {
 	for (;;) {
 		/* Let someone else run. */
 		intr_disable (); // 자신(idle)을 block해주기 전까지 인터럽트 당하면 안되므로 인터럽트를 비활성화 해줌
 		thread_block (); // 자신을 block함
 
+		/* In tickless mode, stop the periodic tick until the next
+		   sleeper or delayed work is due.  The scheduler restores it
+		   when it switches away from us.  A grace period in progress
+		   needs the tick to end, though. */
+		if (!rcu_pending ())
+			timer_idle_enter ();
+
 		/* Re-enable interrupts and wait for the next one.
 
 		   The `sti' instruction disables interrupts until the
@@ -531,10 +1172,64 @@ static void idle (void *idle_started_ UNUSED) {
 
 		   See [IA32-v2a] "HLT", [IA32-v2b] "STI", and [IA32-v3a]
 		   7.11.1 "HLT Instruction". */
-		asm volatile ("sti; hlt" : : : "memory");
+		if (idle_mwait)
+			idle_wait (this_cpu ());
+		else
+			asm volatile ("sti; hlt" : : : "memory");
+	}
+}
+
+/* Checks for MONITOR/MWAIT and picks the hint for the deepest
+   C-state that it reports. */
+static void
+idle_init (void) {
+	uint32_t eax, ebx, ecx, edx;
+
+	cpuid (1, &eax, &ebx, &ecx, &edx);
+	if (!(ecx & (1 << 3)))                 /* CPUID.1:ECX.MONITOR */
+		return;
+	cpuid (0, &eax, &ebx, &ecx, &edx);
+	if (eax < 5)
+		return;
+	idle_mwait = true;
+
+	/* CPUID.5:EDX holds the number of sub-states of C0 to C7, four
+	   bits each; the hint is the C-state less one, then the
+	   sub-state. */
+	cpuid (5, &eax, &ebx, &ecx, &edx);
+	for (int c = 7; c >= 1; c--) {
+		unsigned subs = (edx >> (4 * c)) & 0xf;
+
+		if (subs != 0) {
+			idle_deep_hint = (c - 1) << 4 | (subs - 1);
+			break;
+		}
 	}
 }
 
+/* Waits in MWAIT, with interrupts turned on, until C's need_resched
+   is written or an interrupt arrives, unless a thread is already
+   waiting to run on C.  Interrupts must be off. */
+static void
+idle_wait (struct cpu *c) {
+	int64_t now = timer_ticks ();
+	uint32_t hint = 0;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (timer_tickless && get_next_tick_to_awake () - now >= IDLE_DEEP_TICKS)
+		hint = idle_deep_hint;
+
+	/* Clear the word before arming the monitor, and look for work
+	   after, so that a wakeup in between is not missed. */
+	c->need_resched = 0;
+	monitor (&c->need_resched);
+	if (c->nr_ready == 0 && !c->need_resched)
+		sti_mwait (hint);
+	else
+		intr_enable ();
+}
+
 /* Function used as the basis for a kernel thread. */
 static void
 kernel_thread (thread_func *function, void *aux) {
@@ -565,6 +1260,8 @@ static void init_thread (struct thread *t, const char *name, int priority) {
 	t->tf.rsp = (uint64_t) t + PGSIZE - sizeof (void *);
 	t->priority = priority; 	// 우선순위 정해줌
 	t->magic = THREAD_MAGIC;
+	t->affinity = CPU_MASK_ALL;
+	t->ioprio = IOPRIO_NONE;
 
 	t->nice = NICE_DEFAULT;
 	t->recent_cpu = RECENT_CPU_DEFAULT;
@@ -572,17 +1269,14 @@ static void init_thread (struct thread *t, const char *name, int priority) {
 	/* priority donation 관련 초기화 */
 	t->init_priority = priority;
 	t->wait_on_lock = NULL;
-	list_init(&t->donations);
-
-	/* 자식 리스트 및 세마포어 초기화 */
-    list_init(&t->child_list);
-	sema_init(&t->fork_sema,0);
-	sema_init(&t->wait_sema,0);
-	sema_init(&t->free_sema,0);
+	heap_init(&t->held_locks, cmp_lock_priority, NULL);
 
 	/* system call exit(), wait() 관련 초기화 */
 	// t->exit_status = 0;
-	t->running = NULL;
+
+	spin_lock (&all_lock);
+	list_push_back (&all_list, &t->all_elem);
+	spin_unlock (&all_lock);
 }	
 
 /* Chooses and returns the next thread to be scheduled.  Should
@@ -592,15 +1286,565 @@ static void init_thread (struct thread *t, const char *name, int priority) {
    idle_thread. */
 static struct thread *
 next_thread_to_run (void) {
-	if (list_empty (&ready_list))
-		return idle_thread;
-	else
-		return list_entry (list_pop_front (&ready_list), struct thread, elem);
+	struct cpu *c = this_cpu ();
+	struct thread *t;
+
+	/* About to go idle: look for work on the other CPUs first. */
+	if (c->nr_ready == 0)
+		cpu_steal (c, 1);
+
+	spin_lock (&c->rq_lock);
+	t = c->nr_ready != 0 ? ready_queue_pop (c) : c->idle_thread;
+	t->status = THREAD_RUNNING;
+	spin_unlock (&c->rq_lock);
+	return t;
+}
+
+/* Returns true if T is the idle thread of some CPU. */
+static bool
+thread_is_idle (const struct thread *t) {
+	for (int i = 0; i < NCPU; i++)
+		if (t == cpus[i].idle_thread)
+			return true;
+	return false;
+}
+
+/* Returns true if ready thread T may be moved to C at timer tick
+   NOW: it is allowed to run there, is not cache-hot and is off the
+   CPU it last ran on. */
+static bool
+cpu_may_steal (const struct cpu *c, const struct thread *t, int64_t now) {
+	return (t->affinity & (1ULL << c->id)) && now - t->last_run >= CACHE_HOT_TICKS
+		&& t->on_cpu == NULL;
+}
+
+/* Moves one ready thread to C's run queue from the peer with the
+   most ready threads, provided that peer has at least MARGIN more
+   than C.  The thread is taken from the peer's highest non-empty
+   priority level, oldest first, or under -fair in order of
+   vruntime, skipping threads that are cache-hot or may not run on
+   C.  Returns true if a thread was moved.  Interrupts
+   must be off. */
+static bool
+cpu_steal (struct cpu *c, int margin) {
+	struct cpu *busiest = NULL;
+	struct thread *victim = NULL;
+	int64_t now;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	for (int i = 0; i < cpu_cnt; i++)
+		if (&cpus[i] != c && cpus[i].nr_ready >= c->nr_ready + margin
+				&& (busiest == NULL || cpus[i].nr_ready > busiest->nr_ready))
+			busiest = &cpus[i];
+	if (busiest == NULL)
+		return false;
+
+	rq_lock_pair (c, busiest);
+
+	now = timer_ticks ();
+	if (thread_fair) {
+		struct rb_elem *e;
+
+		for (e = rb_min (&busiest->fair_queue); e != NULL && victim == NULL;
+				e = rb_next (e)) {
+			struct thread *t = rb_entry (e, struct thread, fair_elem);
+
+			if (cpu_may_steal (c, t, now))
+				victim = t;
+		}
+	}
+	for (int pri = ready_queue_max_priority (busiest);
+			pri >= PRI_MIN && victim == NULL; pri--) {
+		struct list *queue = &busiest->ready_queue[pri - PRI_MIN];
+		struct list_elem *e;
+
+		for (e = list_begin (queue); e != list_end (queue); e = list_next (e)) {
+			struct thread *t = list_entry (e, struct thread, elem);
+
+			if (cpu_may_steal (c, t, now)) {
+				victim = t;
+				break;
+			}
+		}
+	}
+	if (victim != NULL) {
+		ready_queue_remove (busiest, victim);
+		ready_queue_push (c, victim);
+	}
+
+	rq_unlock_pair (c, busiest);
+	return victim != NULL;
+}
+
+/* Returns the CPU whose run queue T should go on: an idle CPU that
+   T's affinity allows, this one first, or else this CPU if T's
+   affinity allows it, otherwise the lowest-numbered CPU online that
+   it does allow. */
+static struct cpu *
+thread_select_cpu (struct thread *t) {
+	struct cpu *c = this_cpu ();
+	uint64_t allowed = t->affinity & CPU_MASK_ONLINE;
+
+	ASSERT (allowed != 0);
+
+	if ((allowed & (1ULL << c->id)) && cpu_is_idle (c))
+		return c;
+	for (int i = 0; i < cpu_cnt; i++)
+		if ((allowed & (1ULL << i)) && cpu_is_idle (&cpus[i]))
+			return &cpus[i];
+	if (allowed & (1ULL << c->id))
+		return c;
+	return &cpus[__builtin_ctzll (allowed)];
+}
+
+/* Returns true if C is running its idle thread with nothing ready.
+   Another CPU's answer may be stale by the time it is used. */
+static bool
+cpu_is_idle (const struct cpu *c) {
+	return c->nr_ready == 0 && c->idle_thread != NULL
+		&& c->idle_thread->on_cpu == c;
+}
+
+/* Makes C, another CPU, look at its run queue soon.  Writing
+   need_resched wakes its idle thread from MWAIT; the reschedule IPI
+   wakes it from HLT, or makes a busy C preempt its running thread
+   if a thread on the queue should run first. */
+static void
+cpu_kick (struct cpu *c) {
+	ASSERT (c != this_cpu ());
+
+	c->need_resched = 1;
+	if (apic_enabled ())
+		apic_send_ipi (c->id, APIC_VEC_RESCHED);
+}
+
+/* Reschedule IPI, sent by cpu_kick().  Taking it is enough to wake
+   an idle CPU. */
+static void
+resched_interrupt (struct intr_frame *f UNUSED) {
+	struct cpu *c = this_cpu ();
+	struct thread *t = thread_current ();
+
+	if (t != c->idle_thread && ready_queue_preempts (c, t, FAIR_WAKEUP_GRAN))
+		intr_yield_on_return ();
+}
+
+/* Locks the run queue of T's CPU, t->cpu, and also C's if C is not
+   null and another CPU, and returns T's.  t->cpu only changes under
+   its run queue lock, so this retries until the lock it took is
+   still T's.  Holding it keeps T from becoming ready elsewhere, and
+   T's priority from changing under a run queue that T is on.
+   Interrupts must be off. */
+static struct cpu *
+rq_lock_thread (struct thread *t, struct cpu *c) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	for (;;) {
+		struct cpu *home = t->cpu;
+
+		rq_lock_pair (home, c);
+		if (t->cpu == home)
+			return home;
+		rq_unlock_pair (home, c);
+	}
+}
+
+/* Locks the run queues of A and of B, if B is not null and not A,
+   taking them in CPU order to avoid deadlock. */
+static void
+rq_lock_pair (struct cpu *a, struct cpu *b) {
+	if (b == NULL || b == a)
+		spin_lock (&a->rq_lock);
+	else {
+		spin_lock (&(a->id < b->id ? a : b)->rq_lock);
+		spin_lock (&(a->id < b->id ? b : a)->rq_lock);
+	}
+}
+
+/* Unlocks what rq_lock_pair (A, B) locked. */
+static void
+rq_unlock_pair (struct cpu *a, struct cpu *b) {
+	if (b == NULL || b == a)
+		spin_unlock (&a->rq_lock);
+	else {
+		spin_unlock (&(a->id < b->id ? b : a)->rq_lock);
+		spin_unlock (&(a->id < b->id ? a : b)->rq_lock);
+	}
+}
+
+/* Returns the live thread with tid TID, or a null pointer if
+   there is none.  all_lock must be held, so that the thread cannot
+   exit while the caller uses it. */
+static struct thread *
+thread_by_tid (tid_t tid) {
+	struct list_elem *e;
+
+	ASSERT (all_lock.locked);
+
+	for (e = list_begin (&all_list); e != list_end (&all_list); e = list_next (e)) {
+		struct thread *t = list_entry (e, struct thread, all_elem);
+		if (t->tid == tid)
+			return t;
+	}
+	return NULL;
+}
+
+/* Restricts the thread with tid TID to the CPUs whose bits are set
+   in MASK.  Bits for CPUs that are not online are ignored.  A ready
+   thread is moved to an allowed run queue at once, unless it is
+   still switching out; that one, like a running one, moves the next
+   time it yields.  Returns false if there is no such thread or MASK
+   allows no CPU. */
+bool
+thread_set_affinity (tid_t tid, uint64_t mask) {
+	struct thread *t;
+
+	mask &= CPU_MASK_ONLINE;
+	if (mask == 0)
+		return false;
+
+	spin_lock (&all_lock);
+	t = thread_by_tid (tid);
+	if (t != NULL) {
+		t->affinity = mask;
+		if (t->status == THREAD_READY) {
+			struct cpu *to = thread_select_cpu (t);
+			struct cpu *from = rq_lock_thread (t, to);
+			bool moved = t->status == THREAD_READY && t->on_cpu == NULL
+				&& !(mask & (1ULL << from->id));
+
+			if (moved) {
+				ready_queue_remove (from, t);
+				ready_queue_push (to, t);
+			}
+			rq_unlock_pair (from, to);
+			if (moved && to != this_cpu ())
+				cpu_kick (to);
+		}
+	}
+	spin_unlock (&all_lock);
+
+	if (t == thread_current () && !(mask & (1ULL << this_cpu ()->id)))
+		thread_yield ();
+	return t != NULL;
+}
+
+/* Returns the affinity mask of the thread with tid TID, or 0 if
+   there is no such thread. */
+uint64_t
+thread_get_affinity (tid_t tid) {
+	struct thread *t;
+	uint64_t mask;
+
+	spin_lock (&all_lock);
+	t = thread_by_tid (tid);
+	mask = t != NULL ? t->affinity : 0;
+	spin_unlock (&all_lock);
+	return mask;
+}
+
+/* Makes the running thread a deadline thread that needs RUNTIME
+   ticks of CPU in every PERIOD ticks, within DEADLINE ticks of the
+   start of each, or with RUNTIME 0 an ordinary thread again.  Its
+   first period starts now.  Returns false, changing nothing, unless
+   0 < RUNTIME <= DEADLINE <= PERIOD and the deadline threads would
+   still reserve no more than DL_BW_LIMIT. */
+bool
+thread_set_deadline (int64_t runtime, int64_t deadline, int64_t period) {
+	struct thread *t = thread_current ();
+	enum intr_level old_level;
+	int64_t bw = 0;
+
+	if (runtime != 0) {
+		if (runtime < 0 || runtime > deadline || deadline > period)
+			return false;
+		bw = (runtime << DL_BW_SHIFT) / period;
+	}
+
+	old_level = intr_disable ();
+	spin_lock (&dl_lock);
+	if (dl_total_bw - dl_bw (t) + bw > DL_BW_LIMIT) {
+		spin_unlock (&dl_lock);
+		intr_set_level (old_level);
+		return false;
+	}
+	dl_total_bw += bw - dl_bw (t);
+	spin_unlock (&dl_lock);
+
+	t->dl_runtime = runtime;
+	t->dl_deadline = deadline;
+	t->dl_period = period;
+	t->dl_abs_deadline = timer_ticks () + deadline;
+	t->dl_budget = runtime;
+	intr_set_level (old_level);
+
+	/* Having left the class, we may no longer come first. */
+	test_max_priority ();
+	return true;
+}
+
+/* Returns the share of a CPU reserved by T, in units of
+   2^-DL_BW_SHIFT, or 0 if T is not a deadline thread. */
+static int64_t
+dl_bw (const struct thread *t) {
+	return t->dl_runtime != 0 ? (t->dl_runtime << DL_BW_SHIFT) / t->dl_period : 0;
+}
+
+/* Starts a new period for deadline thread T at timer tick NOW. */
+static void
+dl_replenish (struct thread *t, int64_t now) {
+	t->dl_abs_deadline = now + t->dl_deadline;
+	t->dl_budget = t->dl_runtime;
+}
+
+/* Called as deadline thread T becomes ready.  Starts a new period
+   if the current one has passed its deadline, or if running the
+   rest of the budget before the deadline would take more than T's
+   bandwidth. */
+static void
+dl_wakeup (struct thread *t) {
+	int64_t now = timer_ticks ();
+
+	if (now >= t->dl_abs_deadline
+			|| t->dl_budget * t->dl_deadline
+				> (t->dl_abs_deadline - now) * t->dl_runtime)
+		dl_replenish (t, now);
+}
+
+/* Called as deadline thread T, running, yields with its budget
+   spent.  If its next period has started, starts it and returns
+   false.  Otherwise puts T on the sleep heap until then, for the
+   caller to block it, and returns true.  sleep_lock must be held. */
+static bool
+dl_throttle (struct thread *t) {
+	int64_t now = timer_ticks ();
+	int64_t release = t->dl_abs_deadline - t->dl_deadline + t->dl_period;
+
+	ASSERT (sleep_lock.locked);
+
+	if (release <= now) {
+		dl_replenish (t, now);
+		return false;
+	}
+	t->wakeup_tick = release;
+	update_next_tick_to_awake (release);
+	heap_push (&sleep_heap, &t->sleep_elem);
+	return true;
+}
+
+/* Orders deadline threads A and B by absolute deadline. */
+static bool
+dl_less (const struct rb_elem *a, const struct rb_elem *b,
+		void *aux UNUSED) {
+	return rb_entry (a, struct thread, dl_elem)->dl_abs_deadline
+		< rb_entry (b, struct thread, dl_elem)->dl_abs_deadline;
+}
+
+/* Initializes C as CPU number ID with an empty run queue. */
+static void
+cpu_init (struct cpu *c, int id) {
+	memset (c, 0, sizeof *c);
+	c->id = id;
+	spin_lock_init (&c->rq_lock);
+	for (int i = 0; i < PRI_CNT; i++)
+		list_init (&c->ready_queue[i]);
+	rb_init (&c->fair_queue, fair_less, NULL);
+	rb_init (&c->dl_queue, dl_less, NULL);
+}
+
+/* Appends T to C's run queue of its priority level, or under -fair
+   inserts it by vruntime, rebased from the CPU T last ran on.  A
+   deadline thread goes by deadline on the deadline queue.  C's
+   rq_lock must be held. */
+static void
+ready_queue_push (struct cpu *c, struct thread *t) {
+	ASSERT (PRI_MIN <= t->priority && t->priority <= PRI_MAX);
+
+	if (t->dl_runtime != 0)
+		rb_insert (&c->dl_queue, &t->dl_elem);
+	else if (thread_fair) {
+		if (t->cpu != NULL && t->cpu != c)
+			t->vruntime += c->min_vruntime - t->cpu->min_vruntime;
+		rb_insert (&c->fair_queue, &t->fair_elem);
+	} else {
+		list_push_back (&c->ready_queue[t->priority - PRI_MIN], &t->elem);
+		c->ready_bitmap |= 1ULL << (t->priority - PRI_MIN);
+	}
+	c->nr_ready++;
+	t->cpu = c;
+}
+
+/* Removes T from C's run queue of its priority level.  T must be
+   on the queue matching its current priority, and C's rq_lock
+   must be held. */
+static void
+ready_queue_remove (struct cpu *c, struct thread *t) {
+	struct list *queue = &c->ready_queue[t->priority - PRI_MIN];
+
+	ASSERT (t->cpu == c);
+
+	if (t->dl_runtime != 0)
+		rb_remove (&c->dl_queue, &t->dl_elem);
+	else if (thread_fair)
+		rb_remove (&c->fair_queue, &t->fair_elem);
+	else {
+		list_remove (&t->elem);
+		if (list_empty (queue))
+			c->ready_bitmap &= ~(1ULL << (t->priority - PRI_MIN));
+	}
+	c->nr_ready--;
+}
+
+/* Removes and returns the deadline thread of C with the earliest
+   deadline, or if there is none the oldest thread of the highest
+   non-empty priority level, or under -fair the one of least
+   vruntime.  The run queue must not be empty, and C's rq_lock must
+   be held. */
+static struct thread *
+ready_queue_pop (struct cpu *c) {
+	struct thread *t;
+
+	ASSERT (c->nr_ready != 0);
+	if (rb_min (&c->dl_queue) != NULL)
+		t = rb_entry (rb_min (&c->dl_queue), struct thread, dl_elem);
+	else if (thread_fair) {
+		t = rb_entry (rb_min (&c->fair_queue), struct thread, fair_elem);
+		if (t->vruntime > c->min_vruntime)
+			c->min_vruntime = t->vruntime;
+	} else
+		t = list_entry (list_front (&c->ready_queue[ready_queue_max_priority (c) - PRI_MIN]),
+				struct thread, elem);
+	ready_queue_remove (c, t);
+	return t;
+}
+
+/* Returns the highest priority in C's run queue, or PRI_MIN - 1
+   if the run queue is empty.  Without C's rq_lock the answer may
+   be stale by the time it is used. */
+static int
+ready_queue_max_priority (struct cpu *c) {
+	uint64_t bitmap = c->ready_bitmap;
+
+	if (bitmap == 0)
+		return PRI_MIN - 1;
+	return PRI_MIN + 63 - __builtin_clzll (bitmap);
+}
+
+/* Returns true if CURR, the thread running on C, should give way
+   to a thread on C's run queue: a deadline thread with an earlier
+   deadline, any deadline thread if CURR is not one, one of higher
+   priority, or under -fair one whose vruntime is more than GRAN
+   ticks' worth less than CURR's.  CURR is charged for its run time
+   first, and C's min_vruntime brought up to date.  Interrupts must
+   be off. */
+static bool
+ready_queue_preempts (struct cpu *c, struct thread *curr, unsigned gran) {
+	struct rb_elem *e;
+	bool preempt;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	spin_lock (&c->rq_lock);
+	e = rb_min (&c->dl_queue);
+	if (e != NULL || curr->dl_runtime != 0) {
+		preempt = e != NULL
+			&& (curr->dl_runtime == 0 || dl_less (e, &curr->dl_elem, NULL));
+		spin_unlock (&c->rq_lock);
+		return preempt;
+	}
+	spin_unlock (&c->rq_lock);
+
+	if (!thread_fair)
+		return ready_queue_max_priority (c) > curr->priority;
+
+	spin_lock (&c->rq_lock);
+	e = rb_min (&c->fair_queue);
+	if (curr == c->idle_thread)
+		preempt = e != NULL;
+	else {
+		int64_t min;
+
+		fair_charge (curr, rdtsc ());
+		min = curr->vruntime;
+		if (e != NULL) {
+			int64_t first = rb_entry (e, struct thread, fair_elem)->vruntime;
+
+			preempt = curr->vruntime - first > fair_cycles (gran);
+			if (first < min)
+				min = first;
+		} else
+			preempt = false;
+		if (min > c->min_vruntime)
+			c->min_vruntime = min;
+	}
+	spin_unlock (&c->rq_lock);
+	return preempt;
+}
+
+/* Orders threads A and B by vruntime.  Threads with equal vruntime
+   keep the order they were inserted in. */
+static bool
+fair_less (const struct rb_elem *a, const struct rb_elem *b,
+		void *aux UNUSED) {
+	return rb_entry (a, struct thread, fair_elem)->vruntime
+		< rb_entry (b, struct thread, fair_elem)->vruntime;
+}
+
+/* Returns the vruntime a nice 0 thread accrues in TICKS timer
+   ticks. */
+static int64_t
+fair_cycles (unsigned ticks) {
+	return (int64_t) (timer_tsc_hz () / TIMER_FREQ) * ticks;
+}
+
+/* Adds to T's vruntime the cycles it has run since its fair_stamp
+   as of TSC value NOW, weighted by its nice value.  T must be
+   running, so not on a run queue, and interrupts must be off. */
+static void
+fair_charge (struct thread *t, uint64_t now) {
+	int nice = t->nice < -20 ? -20 : t->nice > 20 ? 20 : t->nice;
+
+	t->vruntime += (now - t->fair_stamp) * FAIR_WEIGHT_0 / fair_weights[nice + 20];
+	t->fair_stamp = now;
+}
+
+/* Sets T's effective priority to PRIORITY.  If T is ready, it is
+   moved to the back of the run queue of its new priority level,
+   so that the run queue stays indexed by priority, and if T is
+   waiting on a semaphore or condition variable, that waiter heap
+   is re-keyed.  Must be called with synch.c's synch_lock held, which
+   protects the waiter heaps; synch_change_priority() takes it. */
+void
+thread_change_priority (struct thread *t, int priority) {
+	struct cpu *c;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
+
+	if (t->priority == priority)
+		return;
+
+	/* Under its run queue lock T cannot become ready, or stop being,
+	   without our seeing it. */
+	c = rq_lock_thread (t, NULL);
+	if (t->status == THREAD_READY) {
+		ready_queue_remove (c, t);
+		t->priority = priority;
+		ready_queue_push (c, t);
+	} else
+		t->priority = priority;
+	spin_unlock (&c->rq_lock);
+
+	if (t->wait_on_sema != NULL || t->wait_on_cond != NULL)
+		synch_waiter_update (t);
 }
 
 /* Use iretq to launch the thread */
 void
 do_iret (struct intr_frame *tf) {
+	if ((tf->cs & 3) == 3)
+		thread_leave_kernel ();
 	__asm __volatile(
 			"movq %0, %%rsp\n"
 			"movq 0(%%rsp),%%r15\n"
@@ -626,72 +1870,55 @@ do_iret (struct intr_frame *tf) {
 			: : "g" ((uint64_t) tf) : "memory");
 }
 
-/* Switching the thread by activating the new thread's page
-   tables, and, if the previous thread is dying, destroying it.
-
-   At this function's invocation, we just switched from thread
-   PREV, the new thread is already running, and interrupts are
-   still disabled.
+/* Switches to thread TH and, once TH is switched back to, finishes
+   that switch with schedule_tail().  Interrupts must be off.
 
    It's not safe to call printf() until the thread switch is
    complete.  In practice that means that printf()s should be
    added at the end of the function. */
 static void thread_launch (struct thread *th) {
-	uint64_t tf_cur = (uint64_t) &running_thread ()->tf;
-	uint64_t tf = (uint64_t) &th->tf;
+	struct thread *prev;
+
 	ASSERT (intr_get_level () == INTR_OFF);
 
-	/* The main switching logic.
-	 * We first restore the whole execution context into the intr_frame
-	 * and then switching to the next thread by calling do_iret.
-	 * Note that, we SHOULD NOT use any stack from here
-	 * until switching is done. */
-	__asm __volatile (
-			/* Store registers that will be used. */
-			"push %%rax\n"
-			"push %%rbx\n"
-			"push %%rcx\n"
-			/* Fetch input once */
-			"movq %0, %%rax\n"
-			"movq %1, %%rcx\n"
-			"movq %%r15, 0(%%rax)\n"
-			"movq %%r14, 8(%%rax)\n"
-			"movq %%r13, 16(%%rax)\n"
-			"movq %%r12, 24(%%rax)\n"
-			"movq %%r11, 32(%%rax)\n"
-			"movq %%r10, 40(%%rax)\n"
-			"movq %%r9, 48(%%rax)\n"
-			"movq %%r8, 56(%%rax)\n"
-			"movq %%rsi, 64(%%rax)\n"
-			"movq %%rdi, 72(%%rax)\n"
-			"movq %%rbp, 80(%%rax)\n"
-			"movq %%rdx, 88(%%rax)\n"
-			"pop %%rbx\n"              // Saved rcx
-			"movq %%rbx, 96(%%rax)\n"
-			"pop %%rbx\n"              // Saved rbx
-			"movq %%rbx, 104(%%rax)\n"
-			"pop %%rbx\n"              // Saved rax
-			"movq %%rbx, 112(%%rax)\n"
-			"addq $120, %%rax\n"
-			"movw %%es, (%%rax)\n"
-			"movw %%ds, 8(%%rax)\n"
-			"addq $32, %%rax\n"
-			"call __next\n"         // read the current rip.
-			"__next:\n"
-			"pop %%rbx\n"
-			"addq $(out_iret -  __next), %%rbx\n"
-			"movq %%rbx, 0(%%rax)\n" // rip
-			"movw %%cs, 8(%%rax)\n"  // cs
-			"pushfq\n"
-			"popq %%rbx\n"
-			"mov %%rbx, 16(%%rax)\n" // eflags
-			"mov %%rsp, 24(%%rax)\n" // rsp
-			"movw %%ss, 32(%%rax)\n"
-			"mov %%rcx, %%rdi\n"
-			"call do_iret\n"
-			"out_iret:\n"
-			: : "g"(tf_cur), "g" (tf) : "memory"
-			);
+	/* Charge the events counted since the last switch to the
+	 * thread that caused them. */
+	pmu_switch (running_thread ());
+	fpu_switch (th);
+
+	/* Threads that have run before were switched out by
+	 * switch_threads() too, so only the callee-saved registers and
+	 * the stack pointer need to be swapped.  A new thread has no
+	 * saved stack yet and is started from its intr_frame with
+	 * iretq instead. */
+	prev = switch_threads (&running_thread ()->switch_rsp, th->switch_rsp, &th->tf);
+	schedule_tail (prev);
+}
+
+/* Finishes a switch from PREV on the new running thread, right
+   after switch_threads().  PREV's registers are saved now, so it may
+   run on another CPU from here on, or if it is dying, its page may
+   be reused.  A thread that yielded from a CPU its affinity no
+   longer allows is queued on one that it does.  Interrupts must be
+   off. */
+void
+schedule_tail (struct thread *prev) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (prev->status == THREAD_DYING && prev != initial_thread) {
+		spin_lock (&cache_lock);
+		prev->magic = 0;
+		list_push_front (&thread_cache, &prev->elem);
+		thread_cache_cnt++;
+		spin_unlock (&cache_lock);
+		return;
+	}
+	barrier ();
+	prev->on_cpu = NULL;
+	if (prev->migrating) {
+		prev->migrating = false;
+		thread_unblock (prev);
+	}
 }
 
 /* Schedules a new process. At entry, interrupts must be off.
@@ -701,28 +1928,34 @@ static void thread_launch (struct thread *th) {
 static void do_schedule(int status) {
 	ASSERT (intr_get_level () == INTR_OFF);
 	ASSERT (thread_current()->status == THREAD_RUNNING);
-	while (!list_empty (&destruction_req)) {
-		struct thread *victim =
-			list_entry (list_pop_front (&destruction_req), struct thread, elem);
-		palloc_free_page(victim);
-	}
 	thread_current ()->status = status;
 	schedule ();
 }
 
-// 컨텍스트 스위칭 실시
+/* 컨텍스트 스위칭 실시.  The running thread's status must already
+   say why it stops running, but once it is blocked, a waker on
+   another CPU may make it ready at any time, so schedule() reads it
+   only for statistics. */
 static void schedule (void) {
+	struct cpu *c = this_cpu ();
 	struct thread *curr = running_thread ();
-	struct thread *next = next_thread_to_run (); // ready_list 출구에 서 있는 쓰레드 
+	struct thread *next;
 
 	ASSERT (intr_get_level () == INTR_OFF);
 	ASSERT (curr->status != THREAD_RUNNING);
+	next = next_thread_to_run (); // ready queue의 최고 우선순위 큐 맨 앞에 서 있는 쓰레드
 	ASSERT (is_thread (next));
-	/* Mark us as running. */
-	next->status = THREAD_RUNNING;
+	ASSERT (next->cpu == c && (next == curr || next->on_cpu == NULL));
 
 	/* Start new time slice. */
-	thread_ticks = 0;
+	c->thread_ticks = 0;
+	next->on_cpu = c;
+	curr->last_run = timer_ticks ();
+
+	/* If the idle thread was woken early from a tickless halt,
+	   catch up on the ticks it slept through. */
+	if (curr == c->idle_thread)
+		percpu_counter_add (&idle_ticks, timer_idle_exit ());
 
 #ifdef USERPROG
 	/* Activate the new address space. */
@@ -730,73 +1963,108 @@ static void schedule (void) {
 #endif
 
 	if (curr != next) {
-		/* If the thread we switched from is dying, destroy its struct
-		   thread. This must happen late so that thread_exit() doesn't
-		   pull out the rug under itself.
-		   We just queuing the page free reqeust here because the page is
-		   currently used bye the stack.
-		   The real destruction logic will be called at the beginning of the
-		   schedule(). */
-		if (curr && curr->status == THREAD_DYING && curr != initial_thread) {
-			ASSERT (curr != next);
-			list_push_back (&destruction_req, &curr->elem);
-		}
+		/* Charge the time since the last mode change to the kernel,
+		   as switches happen there.  Under -fair CURR was charged
+		   before it became ready or blocked. */
+		uint64_t now = rdtsc ();
+		curr->rusage.kernel_cycles += now - curr->rusage_stamp;
+		next->rusage_stamp = now;
+		next->fair_stamp = now;
+		if (curr->status == THREAD_READY)
+			curr->rusage.involuntary_switches++;
+		else if (curr->status == THREAD_BLOCKED)
+			curr->rusage.voluntary_switches++;
 
 		/* Before switching the thread, we first save the information
 		 * of current running. */
+		TRACE (SCHED_SWITCH, next->tid);
 		thread_launch (next);
 	}
 }
 
-/* Returns a tid to use for a new thread. */
-static tid_t allocate_tid (void) {
-	static tid_t next_tid = 1;
-	tid_t tid;
+/* Returns a page for a new thread, taken from thread_cache if
+   possible, or a null pointer if memory is exhausted.  The page is
+   not zeroed; init_thread() clears the struct thread part. */
+static struct thread *
+thread_alloc (void) {
+	struct thread *t = NULL;
 
-	lock_acquire (&tid_lock);
-	tid = next_tid++;
-	lock_release (&tid_lock);
+	spin_lock (&cache_lock);
+	if (!list_empty (&thread_cache)) {
+		t = list_entry (list_pop_front (&thread_cache), struct thread, elem);
+		thread_cache_cnt--;
+	}
+	spin_unlock (&cache_lock);
 
-	return tid;
+	return t != NULL ? t : palloc_get_page (0);
 }
-// 다음에 깨워야할 tick의 최소값을 갱신하는 함수
+
+/* Frees the pages in thread_cache beyond THREAD_CACHE_MAX.  The
+   pages are unlinked under cache_lock and freed after it is
+   released. */
+static void
+thread_cache_reap (void) {
+	struct list batch;
+
+	if (thread_cache_cnt <= THREAD_CACHE_MAX)
+		return;
+
+	list_init (&batch);
+	spin_lock (&cache_lock);
+	while (thread_cache_cnt > THREAD_CACHE_MAX) {
+		list_push_back (&batch, list_pop_back (&thread_cache));
+		thread_cache_cnt--;
+	}
+	spin_unlock (&cache_lock);
+
+	while (!list_empty (&batch))
+		palloc_free_page (list_entry (list_pop_front (&batch),
+					struct thread, elem));
+}
+
+/* Returns a tid to use for a new thread. */
+static tid_t allocate_tid (void) {
+	return atomic_fetch_add (&next_tid, 1);
+}
+// 다음에 깨워야할 tick의 최소값을 갱신하는 함수.  sleep_lock must be held.
 void update_next_tick_to_awake(int64_t ticks)
 {
 	next_tick_to_awake = (next_tick_to_awake > ticks) ? ticks : next_tick_to_awake;
 }
-// sleep_list에서 깨워야할 쓰레드를 찾아서 큐에서 제거하고 unblock해주는 함수
+// sleep heap에서 깨울 시간이 된 쓰레드들을 꺼내 unblock해주는 함수
+// 깨울 쓰레드가 없다면 heap의 top만 확인하고 끝나므로 O(1), 깨우는 쓰레드마다 O(lg n)
 void thread_awake(int64_t ticks) {
-	struct list_elem *curr = list_begin(&sleep_list);
-	struct thread *t;
-
-	/* sleep_list의 끝까지 순회 */
-	while (curr != list_end(&sleep_list)) {
-		t = list_entry(curr, struct thread, elem);
-		if (t->wakeup_tick <= ticks) { // 깨울시간이 되었거나 지났다면
-			curr = list_remove(&t->elem); // 해당 쓰레드를 sleep_queue에서 제거하고, curr을 삭제한 쓰레드가 가리키는 위치로 갱신
-			thread_unblock(t); // 해당 쓰레드를 unblock
-		} else { // 깨울시간이 되지 않았다면
-			curr = list_next(curr); // 큐의 다음을 검색
-			update_next_tick_to_awake(t->wakeup_tick); // tick을 갱신
-		}
+	spin_lock (&sleep_lock);
+	while (!heap_empty(&sleep_heap)) {
+		struct thread *t = heap_entry(heap_top(&sleep_heap), struct thread, sleep_elem);
+		if (t->wakeup_tick > ticks) // 가장 먼저 깨어날 쓰레드도 아직 시간이 안 됨
+			break;
+		heap_pop(&sleep_heap);
+		thread_unblock(t);
 	}
+
+	// 남아있는 쓰레드 중 최소 wakeup_tick으로 갱신
+	if (heap_empty(&sleep_heap))
+		next_tick_to_awake = INT64_MAX;
+	else
+		next_tick_to_awake = heap_entry(heap_top(&sleep_heap), struct thread, sleep_elem)->wakeup_tick;
+	spin_unlock (&sleep_lock);
 }
 
-// thread를 block 상태로 만들고 sleep_list에 삽입하여 대기
+// thread를 block 상태로 만들고 sleep_heap에 삽입하여 대기
 void thread_sleep(int64_t ticks) {
 	struct thread *curr = thread_current();
-	enum intr_level old_level;
 
-	old_level = intr_disable();
-	ASSERT(curr != idle_thread);
+	ASSERT(!thread_is_idle (curr));
+	spin_lock (&sleep_lock);
 
 	curr->wakeup_tick = ticks;
 	update_next_tick_to_awake(curr->wakeup_tick);
-	list_push_back(&sleep_list, &curr->elem);
+	heap_push(&sleep_heap, &curr->sleep_elem);
 
-	thread_block();
+	thread_block_on (&sleep_lock);
 
-	intr_set_level(old_level);
+	spin_unlock (&sleep_lock);
 }
 
 // 다음에 깨어나야할 쓰레드의 tick값을 리턴
@@ -804,6 +2072,14 @@ int64_t get_next_tick_to_awake(void) {
 	return next_tick_to_awake;
 }
 
+// 첫번째 인자가 먼저 깨어나야 하면 true를 반환한다.
+static bool cmp_wakeup_tick (const struct heap_elem *a, const struct heap_elem *b, void *aux UNUSED) {
+	struct thread *tmp_a = heap_entry(a, struct thread, sleep_elem);
+	struct thread *tmp_b = heap_entry(b, struct thread, sleep_elem);
+
+	return tmp_a->wakeup_tick < tmp_b->wakeup_tick;
+}
+
 // 첫번째 인자의 우선순위가 높으면 1을 반환하고, 두번째 인자의 우선 순위가 높으면 0을 반환한다.
 bool cmp_priority (const struct list_elem *a, const struct list_elem *b, void *aux UNUSED) {
 	struct thread *tmp_a = list_entry(a, struct thread, elem);
@@ -812,24 +2088,19 @@ bool cmp_priority (const struct list_elem *a, const struct list_elem *b, void *a
 	return (tmp_a->priority > tmp_b->priority) ? 1 : 0;
 }
 
-// ready_list에서 우선 순위가 가장 높은 쓰레드와 현재 쓰레드의 우선순위를 비교
+// ready queue에서 우선 순위가 가장 높은 쓰레드와 현재 쓰레드의 우선순위를 비교
 // 만약 현재 쓰레드의 우선 순위가 더 작다면 CPU를 양보한다.
 void test_max_priority(void)
 {	
-	// ready_list가 비어있을 경우 실행하지 않고 return 
-	if (list_empty(&ready_list)){
-		return;
-	}
 	// 현재 쓰레드의 정보 가져옴
 	struct thread *curr = thread_current();
-	
-	// ready_list에서 우선 순위가 가장 높은 녀석의 정보
-	struct list_elem *pri_thread = list_front(&ready_list);
-	struct thread *priority_of_pri_thread = list_entry(pri_thread, struct thread, elem); 
 
-	// ready_list에서 뽑은 쓰레드의 우선순위가 현재 쓰레드의 우선순위보다 높다면
-	// thread_yield() 호출
-	if (curr->priority < priority_of_pri_thread->priority) {
+	// ready queue의 최고 우선순위가 현재 쓰레드의 우선순위보다 높다면
+	// thread_yield() 호출. -fair에서는 vruntime이 충분히 작은 쓰레드가 있을 때
+	enum intr_level old_level = intr_disable ();
+	bool preempt = ready_queue_preempts (this_cpu (), curr, FAIR_WAKEUP_GRAN);
+	intr_set_level (old_level);
+	if (preempt) {
 		thread_yield();
 	}
 }
@@ -837,83 +2108,105 @@ void test_max_priority(void)
 /* 특정 쓰레드의 priorirty를 계산하는 함수 */
 /* 계산 결과의 소수부분은 버림하고 정수의 priority로 설정 */
 void mlfqs_priority (struct thread *t) {
-	if (t == idle_thread) // idle 쓰레드의 priority는 고정이므로 제외
+	if (thread_is_idle (t)) // idle 쓰레드의 priority는 고정이므로 제외
 		return;
-	t->priority = fp_to_int(add_mixed(div_mixed(t->recent_cpu, -4), PRI_MAX - t->nice * 2));
+	int priority = fp_to_int(add_mixed(div_mixed(t->recent_cpu, -4), PRI_MAX - t->nice * 2));
 	// priority = PRI_MAX – (recent_cpu / 4) – (nice * 2)
+
+	if (priority < PRI_MIN)
+		priority = PRI_MIN;
+	else if (priority > PRI_MAX)
+		priority = PRI_MAX;
+	synch_change_priority (t, priority); // ready 상태라면 새 우선순위의 큐로 이동
 }
 
 /* recent_cpu 값 계산 */
-void mlfqs_recent_cpu (struct thread *t)
+/* DECAY is (2 * load_avg) / (2 * load_avg + 1) as returned by
+   mlfqs_decay(); it is the same for every thread, so callers
+   compute it once per pass. */
+void mlfqs_recent_cpu (struct thread *t, int decay)
 {
-	if (t == idle_thread)
+	if (thread_is_idle (t))
 		return;
 
-	t->recent_cpu = add_mixed(mult_fp(div_fp(mult_mixed(load_avg, 2), add_mixed(mult_mixed(load_avg, 2), 1)), t->recent_cpu), t->nice);
+	t->recent_cpu = add_mixed(mult_fp(decay, t->recent_cpu), t->nice);
 
 	// recent_cpu = (2 * load_avg) / (2 * load_avg + 1) * recent_cpu + nice
 }
 
+/* recent_cpu의 감쇠 계수 (2 * load_avg) / (2 * load_avg + 1) 를 반환 */
+int mlfqs_decay (void)
+{
+	int decay;
+	unsigned seq;
+
+	do {
+		seq = seqlock_read_begin (&load_seq);
+		decay = load_decay;
+	} while (seqlock_read_retry (&load_seq, seq));
+	return decay;
+}
+
+/* Returns (2 * LOAD) / (2 * LOAD + 1). */
+static int
+load_decay_of (int load)
+{
+	int twice_load = mult_mixed(load, 2);
+
+	return div_fp(twice_load, add_mixed(twice_load, 1));
+}
+
 /* load avg 값을 계산하는 함수 */
 void mlfqs_load_avg (void)
 {
 	// load_avg = (59/60) * load_avg + (1/60) * ready_threads
-	int ready_threads; // ready_list에 있는 쓰레드들과 실행 중인 쓰레드의 갯수를 저장할 변수
-
-	if (thread_current() == idle_thread)
-		ready_threads = list_size(&ready_list);  
-	else
-		ready_threads = list_size(&ready_list) + 1; // idle 쓰레드가 아닐 경우, running 쓰레드까지 더해 준다.
-
-	load_avg = add_fp(mult_fp(div_fp(int_to_fp(59), int_to_fp(60)), load_avg), // 59/60*load_avg
-					  mult_mixed(div_fp(int_to_fp(1), int_to_fp(60)), ready_threads)); // 1/60*ready_threads
+	int ready_threads = thread_nr_running(); // ready queue에 있는 쓰레드들과 실행 중인 쓰레드의 갯수
+
+	int load = add_fp(mult_fp(FP_LOAD_AVG_DECAY, load_avg), // 59/60*load_avg
+					  mult_mixed(FP_LOAD_AVG_GAIN, ready_threads)); // 1/60*ready_threads
+	int decay = load_decay_of (load);
+
+	/* Only this function writes load_avg, so reading it above
+	   needs no retry loop. */
+	seqlock_write_begin (&load_seq);
+	load_avg = load;
+	load_decay = decay;
+	seqlock_write_end (&load_seq);
 }
 
 /* 1tick마다 running 쓰레드의 recent_cpu의 값을 1 증가 */
 void mlfqs_increment_recent_cpu(void)
 {	
 	struct thread *curr = thread_current();
-	if (curr != idle_thread)
+	if (!thread_is_idle (curr))
 		curr->recent_cpu = add_mixed(curr->recent_cpu, 1);
 }
 
 /* 모든 thread의 recent_cpu의 값 재계산하는 함수 */
+/* Every thread's recent_cpu changes only at a second boundary,
+   so this is also where every thread's priority is recomputed.
+   Ready threads move to their new run queue level. */
 void mlfqs_recalc_recent_cpu (void)
 {
 	struct list_elem *e;
-	for (e = list_begin(&ready_list); e != list_end(&ready_list); e = list_next(e)) {
-		struct thread *t = list_entry(e, struct thread, elem);
-		mlfqs_recent_cpu (t);
-	}
+	int decay = mlfqs_decay();
 
-	for (e = list_begin(&sleep_list); e != list_end(&sleep_list); e = list_next(e)) {
-		struct thread *t = list_entry(e, struct thread, elem);
-		mlfqs_recent_cpu (t);
+	spin_lock (&all_lock);
+	for (e = list_begin(&all_list); e != list_end(&all_list); e = list_next(e)) {
+		struct thread *t = list_entry(e, struct thread, all_elem);
+		mlfqs_recent_cpu (t, decay);
+		mlfqs_priority (t);
 	}
-
-
-
-	// 현재 실행 중인 쓰레드까지 우선순위를 계산해줌
-	mlfqs_recent_cpu(thread_current());
+	spin_unlock (&all_lock);
 }
 
 
-/* 모든 thread의 priority값 재계산하는 함수 */
+/* 4 tick마다 priority를 재계산하는 함수 */
+/* Between second boundaries only the running thread's recent_cpu
+   changes, and nice only changes through thread_set_nice(), which
+   recomputes the priority itself.  So only the running thread's
+   priority can be stale here. */
 void mlfqs_recalc_priority (void)
 {
-	struct list_elem *e;
-	for (e = list_begin(&ready_list); e != list_end(&ready_list); e = list_next(e)) {
-		struct thread *t = list_entry(e, struct thread, elem);
-		mlfqs_priority (t);
-	}
-
-	for (e = list_begin(&sleep_list); e != list_end(&sleep_list); e = list_next(e)) {
-		struct thread *t = list_entry(e, struct thread, elem);
-		mlfqs_priority (t);
-	}
-
-
-
-	// 현재 실행 중인 쓰레드까지 우선순위를 계산해줌
 	mlfqs_priority(thread_current());
 }
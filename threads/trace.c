@@ -0,0 +1,118 @@
+/* trace.c: Ring buffers of kernel trace events. */
+
+#include "threads/trace.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "threads/atomic.h"
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
+
+/* Kernel tracing.
+ *
+ * With -trace, each CPU records the tracepoints it passes into a
+ * ring of its own, stamped with the TSC.  Only that CPU writes its
+ * ring.  An interrupt may record in the middle of another record,
+ * so a slot is claimed with a single atomic increment of the ring's
+ * head and then filled.  Once the ring is full, each event overwrites
+ * the oldest one.
+ *
+ * At power off, trace_dump() prints what the rings hold, one event
+ * per line between "trace-begin" and "trace-end".  utils/pintos-trace
+ * converts that to the Chrome trace format, which chrome://tracing
+ * and Perfetto can show. */
+#define TRACE_PAGES 64
+#define TRACE_EVENTS (TRACE_PAGES * PGSIZE / sizeof (struct trace_event))
+
+struct trace_event {
+	uint64_t tsc;               /* Time stamp. */
+	uint32_t type;              /* A TRACE_* value. */
+	int32_t tid;                /* Running thread. */
+	uint64_t arg;               /* Depends on TYPE. */
+};
+
+struct trace_buf {
+	struct trace_event *events; /* TRACE_EVENTS slots, or null. */
+	int64_t head;               /* Slots ever claimed. */
+};
+
+bool trace_enabled;
+
+static struct trace_buf trace_bufs[NCPU];
+
+/* Names of the event types, as printed by trace_dump(). */
+static const char *trace_names[TRACE_TYPE_CNT] = {
+	[TRACE_SCHED_SWITCH] = "sched_switch",
+	[TRACE_BLOCK] = "block",
+	[TRACE_UNBLOCK] = "unblock",
+	[TRACE_LOCK_WAIT_BEGIN] = "lock_wait_begin",
+	[TRACE_LOCK_WAIT_END] = "lock_wait_end",
+	[TRACE_FAULT_BEGIN] = "fault_begin",
+	[TRACE_FAULT_END] = "fault_end",
+	[TRACE_DISK_READ_BEGIN] = "disk_read_begin",
+	[TRACE_DISK_READ_END] = "disk_read_end",
+	[TRACE_DISK_WRITE_BEGIN] = "disk_write_begin",
+	[TRACE_DISK_WRITE_END] = "disk_write_end",
+	[TRACE_SYSCALL_ENTER] = "syscall_enter",
+	[TRACE_SYSCALL_EXIT] = "syscall_exit",
+};
+
+/* Allocates the rings if tracing was asked for.  Events before this
+   are not recorded. */
+void
+trace_init (void) {
+	if (!trace_enabled)
+		return;
+	for (int i = 0; i < NCPU; i++)
+		trace_bufs[i].events = palloc_get_multiple (PAL_ASSERT, TRACE_PAGES);
+}
+
+/* Records an event of TYPE with ARG on this CPU.  Called through
+   TRACE(). */
+void
+trace_record (enum trace_type type, uint64_t arg) {
+	struct trace_buf *b = &trace_bufs[this_cpu ()->id];
+	/* Not thread_current(), which insists that the thread be
+	   running, and in the scheduler it no longer is. */
+	struct thread *t = pg_round_down ((void *) rrsp ());
+	struct trace_event *e;
+
+	if (b->events == NULL)
+		return;
+	e = &b->events[atomic_fetch_add_64 (&b->head, 1) % TRACE_EVENTS];
+	e->tsc = rdtsc ();
+	e->type = type;
+	e->tid = t->tid;
+	e->arg = arg;
+}
+
+/* Prints the events in the rings, oldest first, and stops tracing. */
+void
+trace_dump (void) {
+	if (!trace_enabled)
+		return;
+	trace_enabled = false;
+
+	printf ("trace-begin %"PRIu64"\n", timer_tsc_hz ());
+	for (int cpu = 0; cpu < NCPU; cpu++) {
+		struct trace_buf *b = &trace_bufs[cpu];
+		int64_t first = 0;
+
+		if (b->events == NULL)
+			continue;
+		if (b->head > (int64_t) TRACE_EVENTS)
+			first = b->head - TRACE_EVENTS;
+		for (int64_t i = first; i < b->head; i++) {
+			struct trace_event *e = &b->events[i % TRACE_EVENTS];
+
+			printf ("trace %d %"PRIu64" %s %d %#"PRIx64"\n", cpu, e->tsc,
+					trace_names[e->type], e->tid, e->arg);
+		}
+	}
+	printf ("trace-end\n");
+}
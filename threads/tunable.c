@@ -0,0 +1,148 @@
+/* tunable.c: Kernel parameters settable at boot and run time. */
+
+#include "threads/tunable.h"
+#include <debug.h>
+#include <stdlib.h>
+#include <string.h>
+#include "threads/spinlock.h"
+
+/* Tunables.
+ *
+ * A subsystem that wants a parameter adjustable without rebuilding
+ * the kernel keeps it in a size_t variable, initialized to its
+ * default, and reads the variable wherever it used to use the
+ * constant.  It describes the variable in a static struct tunable
+ * and passes that to tunable_register() while it initializes.
+ *
+ * "-tune=NAME=VALUE" on the kernel command line sets a tunable at
+ * boot.  Options are parsed before any subsystem is up, so the
+ * settings are kept until the tunable they name is registered;
+ * tunable_boot_check() then rejects any that named none.  The
+ * sysctl system call reads and sets tunables once the system runs.
+ *
+ * A new value takes effect the next time the subsystem reads the
+ * variable.  Stores of a size_t are atomic, so a reader sees either
+ * the old value or the new one.  Registration and lookup go through
+ * a list kept under a spinlock; they are rare. */
+
+/* Registered tunables, most recent first, protected by
+   tunables_lock. */
+static struct tunable *tunables;
+static struct spinlock tunables_lock = SPINLOCK_INITIALIZER;
+
+/* Settings from the kernel command line. */
+#define TUNABLE_BOOT_MAX 16
+struct boot_setting {
+	const char *name;           /* Name of the tunable. */
+	size_t value;               /* Value to give it. */
+	bool applied;               /* Has its tunable been registered? */
+};
+static struct boot_setting boot_settings[TUNABLE_BOOT_MAX];
+static size_t boot_setting_cnt;
+
+static struct tunable *tunable_find (const char *name);
+static bool tunable_store (struct tunable *, size_t value);
+
+/* Registers T, whose variable holds its default, and applies any
+   boot setting for it. */
+void
+tunable_register (struct tunable *t) {
+	ASSERT (t->name != NULL && strlen (t->name) <= TUNABLE_NAME_MAX);
+	ASSERT (t->min <= *t->value && *t->value <= t->max);
+
+	spin_lock (&tunables_lock);
+	ASSERT (tunable_find (t->name) == NULL);
+	t->next = tunables;
+	tunables = t;
+	spin_unlock (&tunables_lock);
+
+	for (size_t i = 0; i < boot_setting_cnt; i++) {
+		struct boot_setting *s = &boot_settings[i];
+
+		if (!strcmp (s->name, t->name)) {
+			if (!tunable_store (t, s->value))
+				PANIC ("-tune: %s must be between %zu and %zu",
+						t->name, t->min, t->max);
+			s->applied = true;
+		}
+	}
+}
+
+/* Stores the value of the tunable called NAME in *VALUE and returns
+   true, or returns false if there is no such tunable. */
+bool
+tunable_get (const char *name, size_t *value) {
+	struct tunable *t;
+
+	spin_lock (&tunables_lock);
+	t = tunable_find (name);
+	if (t != NULL)
+		*value = *t->value;
+	spin_unlock (&tunables_lock);
+	return t != NULL;
+}
+
+/* Sets the tunable called NAME to VALUE.  Returns false, changing
+   nothing, if there is no such tunable or VALUE is out of its
+   bounds. */
+bool
+tunable_set (const char *name, size_t value) {
+	struct tunable *t;
+	bool ok;
+
+	spin_lock (&tunables_lock);
+	t = tunable_find (name);
+	ok = t != NULL && tunable_store (t, value);
+	spin_unlock (&tunables_lock);
+	return ok;
+}
+
+/* Records SETTING, the NAME=VALUE of a -tune option, to be applied
+   when the tunable NAME is registered. */
+void
+tunable_boot_option (char *setting) {
+	struct boot_setting *s;
+	char *save_ptr;
+	char *name, *value;
+
+	if (setting == NULL || boot_setting_cnt >= TUNABLE_BOOT_MAX)
+		PANIC ("-tune needs NAME=VALUE, at most %d times", TUNABLE_BOOT_MAX);
+	name = strtok_r (setting, "=", &save_ptr);
+	value = strtok_r (NULL, "", &save_ptr);
+	if (name == NULL || value == NULL || atoi (value) < 0)
+		PANIC ("-tune needs NAME=VALUE, VALUE not negative");
+
+	s = &boot_settings[boot_setting_cnt++];
+	s->name = name;
+	s->value = atoi (value);
+	s->applied = false;
+}
+
+/* Panics if a -tune option named a tunable that no subsystem
+   registered.  Called once the kernel has finished initializing. */
+void
+tunable_boot_check (void) {
+	for (size_t i = 0; i < boot_setting_cnt; i++)
+		if (!boot_settings[i].applied)
+			PANIC ("unknown tunable `%s'", boot_settings[i].name);
+}
+
+/* Returns the tunable called NAME, or a null pointer.  Interrupts
+   must be off. */
+static struct tunable *
+tunable_find (const char *name) {
+	for (struct tunable *t = tunables; t != NULL; t = t->next)
+		if (!strcmp (t->name, name))
+			return t;
+	return NULL;
+}
+
+/* Sets T to VALUE if it is in T's bounds, and returns whether it
+   was. */
+static bool
+tunable_store (struct tunable *t, size_t value) {
+	if (value < t->min || value > t->max)
+		return false;
+	*t->value = value;
+	return true;
+}
@@ -0,0 +1,295 @@
+/* workqueue.c: Kernel threads shared by background work. */
+
+#include "threads/workqueue.h"
+#include <debug.h>
+#include <stdio.h>
+#include "threads/spinlock.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Workqueues.
+ *
+ * Background jobs that would each want a kernel thread of their
+ * own, such as periodic scans or reclaim that a fault path kicks
+ * off, instead hand work to a queue.  There is one queue per
+ * priority class, each served by WQ_WORKERS kernel threads at the
+ * class's priority, so that all the jobs of a class share a few
+ * threads, and a burst of work is run by a worker that is already
+ * awake, up to WQ_BATCH items per trip to the queue.
+ *
+ * Work is described by a struct work that its owner embeds and
+ * initializes with work_init().  queue_work() appends it to a queue
+ * unless it is queued already; it may be called from an interrupt
+ * handler.  A work is never run by two workers at once: one queued
+ * again while it runs goes back on the queue when the run ends.
+ * Work functions may sleep, but since they share their workers with
+ * others, long waits hold up the rest of the class.
+ *
+ * A delayed work is queued by the timer tick once its expiry has
+ * passed.  Pending expiries are kept in a heap ordered by tick, so
+ * the tick looks at only the earliest, and tickless idle wakes up
+ * in time for it. */
+#define WQ_WORKERS 2                /* Threads per queue. */
+#define WQ_BATCH 8                  /* Most works taken at once. */
+
+/* A queue and its workers. */
+struct work_queue {
+	const char *name;           /* Prefix of the workers' names. */
+	int priority;               /* Priority of the workers. */
+	struct spinlock lock;       /* Protects WORKS and the items in it. */
+	struct list works;          /* Works waiting to run, oldest first. */
+	struct semaphore avail;     /* Upped once per work queued. */
+};
+
+static struct work_queue queues[WQ_CLASS_CNT] = {
+	[WQ_HIGH] = { .name = "kworker/h", .priority = PRI_DEFAULT + 16 },
+	[WQ_NORMAL] = { .name = "kworker/n", .priority = PRI_DEFAULT },
+	[WQ_IDLE] = { .name = "kworker/i", .priority = PRI_MIN },
+};
+
+/* Delayed works waiting for their expiry. */
+static struct spinlock timer_lock;
+static struct heap timers;
+static int64_t next_expiry = INT64_MAX; /* Earliest expiry in TIMERS. */
+
+static void worker (void *q_);
+static bool timer_less (const struct heap_elem *, const struct heap_elem *,
+		void *aux);
+static void update_next_expiry (void);
+
+/* Starts the workers of every queue. */
+void
+workqueue_init (void) {
+	spin_lock_init (&timer_lock);
+	heap_init (&timers, timer_less, NULL);
+	for (int c = 0; c < WQ_CLASS_CNT; c++) {
+		struct work_queue *q = &queues[c];
+
+		spin_lock_init (&q->lock);
+		list_init (&q->works);
+		sema_init (&q->avail, 0);
+		for (int i = 0; i < WQ_WORKERS; i++) {
+			char name[16];
+
+			snprintf (name, sizeof name, "%s%d", q->name, i);
+			if (thread_create (name, q->priority, worker, q) == TID_ERROR)
+				PANIC ("workqueue_init: out of memory");
+		}
+	}
+}
+
+/* Initializes W to call FUNC with AUX. */
+void
+work_init (struct work *w, work_func *func, void *aux) {
+	ASSERT (func != NULL);
+
+	w->func = func;
+	w->aux = aux;
+	w->queue = NULL;
+	w->pending = false;
+	w->running = false;
+}
+
+/* Queues W on the queue of CLASS, which must be the same every
+   time W is queued.  Returns true if successful, or false if W was
+   queued already, in which case it stays where it is.  May be
+   called from an interrupt handler. */
+bool
+queue_work (enum wq_class class, struct work *w) {
+	struct work_queue *q = &queues[class];
+	bool queued = false, wake = false;
+
+	ASSERT (class < WQ_CLASS_CNT);
+
+	spin_lock (&q->lock);
+	ASSERT (w->queue == NULL || w->queue == q);
+	w->queue = q;
+	if (!w->pending) {
+		w->pending = true;
+		queued = true;
+		if (!w->running) {
+			list_push_back (&q->works, &w->elem);
+			wake = true;
+		}
+	}
+	spin_unlock (&q->lock);
+	if (wake)
+		sema_up (&q->avail);
+	return queued;
+}
+
+/* Takes W off its queue if it is waiting there to run.  Returns
+   true if it was.  A run already started is not waited for. */
+bool
+cancel_work (struct work *w) {
+	struct work_queue *q = w->queue;
+	bool cancelled = false, listed = false;
+
+	if (q == NULL)
+		return false;
+	spin_lock (&q->lock);
+	if (w->pending) {
+		w->pending = false;
+		cancelled = true;
+		listed = !w->running;
+		if (listed)
+			list_remove (&w->elem);
+	}
+	spin_unlock (&q->lock);
+
+	/* If a worker is already on its way for W, it finds one work
+	   less than it counted, which it allows for. */
+	if (listed)
+		sema_try_down (&q->avail);
+	return cancelled;
+}
+
+/* Initializes DW to call FUNC with AUX. */
+void
+delayed_work_init (struct delayed_work *dw, work_func *func, void *aux) {
+	work_init (&dw->work, func, aux);
+	dw->armed = false;
+}
+
+/* Queues DW on the queue of CLASS once TICKS timer ticks have
+   passed, or at once if TICKS is not positive.  Returns true if
+   successful, or false if DW was waiting for its expiry or queued
+   already.  May be called from an interrupt handler. */
+bool
+queue_delayed_work (enum wq_class class, struct delayed_work *dw,
+		int64_t ticks) {
+	bool armed = false;
+
+	ASSERT (class < WQ_CLASS_CNT);
+
+	spin_lock (&timer_lock);
+	if (ticks <= 0) {
+		armed = dw->armed;
+		spin_unlock (&timer_lock);
+		return !armed && queue_work (class, &dw->work);
+	}
+	if (!dw->armed && !dw->work.pending) {
+		dw->expires = timer_ticks () + ticks;
+		dw->class = class;
+		dw->armed = true;
+		heap_push (&timers, &dw->timer_elem);
+		update_next_expiry ();
+		armed = true;
+	}
+	spin_unlock (&timer_lock);
+	return armed;
+}
+
+/* Stops DW from being queued if it is waiting for its expiry, or
+   takes it off its queue if it is waiting there.  Returns true if
+   it was doing either. */
+bool
+cancel_delayed_work (struct delayed_work *dw) {
+	bool disarmed = false;
+
+	spin_lock (&timer_lock);
+	if (dw->armed) {
+		heap_remove (&timers, &dw->timer_elem);
+		dw->armed = false;
+		update_next_expiry ();
+		disarmed = true;
+	}
+	spin_unlock (&timer_lock);
+	return disarmed || cancel_work (&dw->work);
+}
+
+/* Queues the delayed works whose expiry has come.  Called by the
+   timer interrupt on every tick. */
+void
+workqueue_tick (void) {
+	int64_t now = timer_ticks ();
+
+	ASSERT (intr_context ());
+
+	while (next_expiry <= now) {
+		struct delayed_work *dw;
+
+		spin_lock (&timer_lock);
+		if (next_expiry > now) {
+			spin_unlock (&timer_lock);
+			break;
+		}
+		dw = heap_entry (heap_pop (&timers), struct delayed_work, timer_elem);
+		dw->armed = false;
+		update_next_expiry ();
+		spin_unlock (&timer_lock);
+		queue_work (dw->class, &dw->work);
+	}
+}
+
+/* Returns the tick at which the next delayed work is due, or
+   INT64_MAX if none is waiting. */
+int64_t
+workqueue_next_expiry (void) {
+	return next_expiry;
+}
+
+/* Body of a worker of the queue Q_. */
+static void
+worker (void *q_) {
+	struct work_queue *q = q_;
+
+	for (;;) {
+		struct work *batch[WQ_BATCH];
+		size_t cnt = 1, i;
+
+		/* Take as much of a burst as we may at once. */
+		sema_down (&q->avail);
+		while (cnt < WQ_BATCH && sema_try_down (&q->avail))
+			cnt++;
+		spin_lock (&q->lock);
+		for (i = 0; i < cnt && !list_empty (&q->works); i++) {
+			struct work *w = list_entry (list_pop_front (&q->works),
+					struct work, elem);
+
+			w->pending = false;
+			w->running = true;
+			batch[i] = w;
+		}
+		spin_unlock (&q->lock);
+		cnt = i;
+
+		for (i = 0; i < cnt; i++) {
+			struct work *w = batch[i];
+			bool again;
+
+			w->func (w->aux);
+
+			/* Queued again while it ran. */
+			spin_lock (&q->lock);
+			w->running = false;
+			again = w->pending;
+			if (again)
+				list_push_back (&q->works, &w->elem);
+			spin_unlock (&q->lock);
+			if (again)
+				sema_up (&q->avail);
+		}
+	}
+}
+
+/* Orders delayed works A and B by expiry. */
+static bool
+timer_less (const struct heap_elem *a_, const struct heap_elem *b_,
+		void *aux UNUSED) {
+	const struct delayed_work *a = heap_entry (a_, struct delayed_work,
+			timer_elem);
+	const struct delayed_work *b = heap_entry (b_, struct delayed_work,
+			timer_elem);
+
+	return a->expires < b->expires;
+}
+
+/* Recomputes next_expiry.  timer_lock must be held. */
+static void
+update_next_expiry (void) {
+	next_expiry = heap_empty (&timers) ? INT64_MAX
+		: heap_entry (heap_top (&timers), struct delayed_work,
+				timer_elem)->expires;
+}
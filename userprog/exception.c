@@ -3,11 +3,13 @@
 #include <stdio.h>
 #include "userprog/gdt.h"
 #include "threads/interrupt.h"
+#include "threads/percpu.h"
 #include "threads/thread.h"
+#include "userprog/uaccess.h"
 #include "intrinsic.h"
 
 /* Number of page faults processed. */
-static long long page_fault_cnt;
+static struct percpu_counter page_fault_cnt;
 
 static void kill (struct intr_frame *);
 static void page_fault (struct intr_frame *);
@@ -45,8 +47,6 @@ exception_init (void) {
 	intr_register_int (0, 0, INTR_ON, kill, "#DE Divide Error");
 	intr_register_int (1, 0, INTR_ON, kill, "#DB Debug Exception");
 	intr_register_int (6, 0, INTR_ON, kill, "#UD Invalid Opcode Exception");
-	intr_register_int (7, 0, INTR_ON, kill,
-			"#NM Device Not Available Exception");
 	intr_register_int (11, 0, INTR_ON, kill, "#NP Segment Not Present");
 	intr_register_int (12, 0, INTR_ON, kill, "#SS Stack Fault Exception");
 	intr_register_int (13, 0, INTR_ON, kill, "#GP General Protection Exception");
@@ -63,7 +63,8 @@ exception_init (void) {
 /* Prints exception statistics. */
 void
 exception_print_stats (void) {
-	printf ("Exception: %lld page faults\n", page_fault_cnt);
+	printf ("Exception: %lld page faults\n",
+			(long long) percpu_counter_read (&page_fault_cnt));
 }
 
 /* Handler for an exception (probably) caused by a user process. */
@@ -146,8 +147,13 @@ page_fault (struct intr_frame *f) {
 		return;
 #endif
 
+	/* A bad user address given to copy_from_user() and the like
+	   makes it fail instead. */
+	if (!user && uaccess_fixup (f))
+		return;
+
 	/* Count page faults. */
-	page_fault_cnt++;
+	percpu_counter_inc (&page_fault_cnt);
 
 	exit(-1);
 
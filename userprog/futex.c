@@ -0,0 +1,177 @@
+#include "userprog/futex.h"
+#include <debug.h>
+#include <hash.h>
+#include <ohash.h>
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "userprog/uaccess.h"
+
+/* Fast user-space mutexes.
+
+   A user program keeps its lock word in its own memory and only
+   makes a system call when the lock is contended: futex_wait()
+   sleeps as long as the word still holds the value the caller saw,
+   and futex_wake() wakes sleepers after the word has changed.
+   Uncontended acquire and release never enter the kernel.
+
+   Sleepers are kept in a hash table of queues keyed by address
+   space and user address.  A queue exists only while someone is
+   waiting on it.  All of this is protected by futex_lock, which
+   futex_wait() holds from the moment it reads the user word until
+   it is on the queue, so a wake that follows a change of the word
+   cannot be missed. */
+
+/* Threads waiting on one user address. */
+struct futex_queue {
+	struct ohash_elem elem;     /* Element in futex_queues. */
+	uint64_t *pml4;             /* Address space. */
+	int *uaddr;                 /* User address of the futex word. */
+	struct condition waiters;   /* Sleeping threads. */
+	int nr_waiting;             /* Threads asleep and not yet woken. */
+	int nr_queued;              /* Threads that still reference us. */
+};
+
+static struct ohash futex_queues;
+static struct lock futex_lock;
+
+static uint64_t futex_hash (const struct ohash_elem *, void *aux);
+static bool futex_less (const struct ohash_elem *, const struct ohash_elem *,
+		void *aux);
+static struct futex_queue *futex_find (int *uaddr);
+static void futex_wake_queue (struct ohash_elem *, void *aux);
+static void futex_queue_ctor (void *);
+
+/* Allocator for futex queues.  A queue is freed only once nobody
+   waits on it, so it goes back to the same state its constructor
+   leaves it in. */
+static struct kmem_cache *futex_queue_cache;
+
+/* Initializes the futex module. */
+void
+futex_init (void) {
+	if (!ohash_init (&futex_queues, futex_hash, futex_less, NULL))
+		PANIC ("futex_init: out of memory");
+	lock_init (&futex_lock);
+	futex_queue_cache = kmem_cache_create ("futex_queue",
+			sizeof (struct futex_queue), 0, futex_queue_ctor);
+}
+
+/* Constructs futex queue Q_ for futex_queue_cache. */
+static void
+futex_queue_ctor (void *q_) {
+	struct futex_queue *q = q_;
+
+	cond_init (&q->waiters);
+	q->nr_waiting = q->nr_queued = 0;
+}
+
+/* If *UADDR equals VAL, sleeps until woken by futex_wake() on
+   UADDR; returns 0 in that case and -1 if *UADDR was different.
+   As with any condition variable, the caller must recheck its
+   lock word after waking.  UADDR must be aligned; if it cannot be
+   read, this returns -1 as well. */
+int
+futex_wait (int *uaddr, int val) {
+	struct futex_queue *q;
+	int cur;
+
+	lock_acquire (&futex_lock);
+	if (!copy_from_user (&cur, uaddr, sizeof cur) || cur != val) {
+		lock_release (&futex_lock);
+		return -1;
+	}
+
+	q = futex_find (uaddr);
+	if (q == NULL) {
+		q = kmem_cache_alloc (futex_queue_cache);
+		if (q == NULL) {
+			lock_release (&futex_lock);
+			return -1;
+		}
+		q->pml4 = thread_current ()->process->pml4;
+		q->uaddr = uaddr;
+		ohash_insert (&futex_queues, &q->elem);
+	}
+
+	q->nr_waiting++;
+	q->nr_queued++;
+	cond_wait (&q->waiters, &futex_lock);
+	if (--q->nr_queued == 0) {
+		ohash_delete (&futex_queues, &q->elem);
+		kmem_cache_free (futex_queue_cache, q);
+	}
+	lock_release (&futex_lock);
+	return 0;
+}
+
+/* Wakes up to N threads sleeping in futex_wait() on UADDR, highest
+   priority first, and returns the number woken. */
+int
+futex_wake (int *uaddr, int n) {
+	struct futex_queue *q;
+	int woken = 0;
+
+	lock_acquire (&futex_lock);
+	q = futex_find (uaddr);
+	while (q != NULL && woken < n && q->nr_waiting > 0) {
+		cond_signal (&q->waiters, &futex_lock);
+		q->nr_waiting--;
+		woken++;
+	}
+	lock_release (&futex_lock);
+	return woken;
+}
+
+/* Wakes every thread sleeping in futex_wait() in the current
+   address space, as its process exits: the woken threads find no
+   reason to go back to sleep, but end on their way to user mode. */
+void
+futex_wake_all (void) {
+	lock_acquire (&futex_lock);
+	ohash_apply (&futex_queues, futex_wake_queue);
+	lock_release (&futex_lock);
+}
+
+/* Wakes every sleeper on the queue E if it is in the current
+   address space, for futex_wake_all().  futex_lock must be held. */
+static void
+futex_wake_queue (struct ohash_elem *e, void *aux UNUSED) {
+	struct futex_queue *q = ohash_entry (e, struct futex_queue, elem);
+
+	if (q->pml4 == thread_current ()->process->pml4 && q->nr_waiting > 0) {
+		cond_broadcast (&q->waiters, &futex_lock);
+		q->nr_waiting = 0;
+	}
+}
+
+/* Returns the queue for UADDR in the current address space, or a
+   null pointer if nobody waits on it.  futex_lock must be held. */
+static struct futex_queue *
+futex_find (int *uaddr) {
+	struct futex_queue key;
+	struct ohash_elem *e;
+
+	key.pml4 = thread_current ()->process->pml4;
+	key.uaddr = uaddr;
+	e = ohash_find (&futex_queues, &key.elem);
+	return e != NULL ? ohash_entry (e, struct futex_queue, elem) : NULL;
+}
+
+static uint64_t
+futex_hash (const struct ohash_elem *e, void *aux UNUSED) {
+	const struct futex_queue *q = ohash_entry (e, struct futex_queue, elem);
+
+	return hash_u64 ((uintptr_t) q->uaddr ^ hash_ptr (q->pml4));
+}
+
+static bool
+futex_less (const struct ohash_elem *a_, const struct ohash_elem *b_,
+		void *aux UNUSED) {
+	const struct futex_queue *a = ohash_entry (a_, struct futex_queue, elem);
+	const struct futex_queue *b = ohash_entry (b_, struct futex_queue, elem);
+
+	if (a->pml4 != b->pml4)
+		return a->pml4 < b->pml4;
+	return a->uaddr < b->uaddr;
+}
@@ -1,34 +1,57 @@
 #include "userprog/process.h"
 #include <debug.h>
+#include <clock-page.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <round.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "userprog/futex.h"
 #include "userprog/gdt.h"
 #include "userprog/tss.h"
+#include "devices/timer.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "threads/atomic.h"
+#include "threads/cpu.h"
 #include "threads/flags.h"
+#include "threads/fpu.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
 #include "threads/vaddr.h"
 #include "intrinsic.h"
 #include "userprog/syscall.h"
+#include "userprog/uaccess.h"
 #ifdef VM
 #include "vm/vm.h"
 #endif
 
+#define MSR_FS_BASE 0xc0000100      /* FS base, for user TLS. */
+
 static void process_cleanup (void);
-static bool load (const char *file_name, struct intr_frame *if_);
+static void process_reset (void);
+static bool load (const char *args, size_t len, struct intr_frame *if_);
 static void initd (void *f_name);
 static void __do_fork (void *);
-void argument_stack(char **argv, int argc, struct intr_frame *if_);
-struct thread *get_child(int pid);
+static void spawnd (void *);
+#ifndef VM
+static void __do_vfork (void *);
+#endif
+static void thread_spawnd (void *);
+static void wait_started (tid_t tid);
+static struct child_status *find_child (struct process *, tid_t);
+static int reap_child (struct child_status *);
+static bool process_leave (void);
+static bool map_clock_page (uint64_t *pml4);
+static bool argument_stack (const char *args, size_t len, struct intr_frame *if_);
+static void args_name (char *name, size_t size, const char *args);
+struct child_status *get_child(int pid);
 
 /* General process initializer for initd and other process. */
 static void
@@ -69,11 +92,12 @@ process_create_initd (const char *file_name) { // filename = "echo x" a b c d"
 	// 	palloc_free_page (fn_copy);
 	// return tid;
 
-	char *save_ptr;
-	strtok_r(file_name, " ", &save_ptr);  // file_name : "args-single", save_ptr : "onearg"
+	/* 스레드 이름은 실행 파일 이름. 부르는 쪽의 문자열은 건드리지 않음 */
+	char name[16];
+	args_name (name, sizeof name, file_name);
 
 	/* Create a new thread to execute FILE_NAME. */
-	tid = thread_create (file_name, PRI_DEFAULT, initd, fn_copy); // 프로세스 이름 == 스레드 이름
+	tid = thread_create (name, PRI_DEFAULT, initd, fn_copy); // 프로세스 이름 == 스레드 이름
 	if (tid == TID_ERROR)
 		palloc_free_page (fn_copy);
 	return tid;
@@ -86,7 +110,7 @@ process_create_initd (const char *file_name) { // filename = "echo x" a b c d"
 static void
 initd (void *f_name) {
 #ifdef VM
-	supplemental_page_table_init (&thread_current ()->spt);
+	supplemental_page_table_init (&thread_current ()->process->spt);
 #endif
 
 	process_init ();
@@ -97,18 +121,24 @@ initd (void *f_name) {
 	NOT_REACHED ();
 }
 
+/* What process_fork() hands to the new process, on the parent's
+   stack, where it stays until the child has started. */
+struct fork_info {
+	struct thread *parent;
+	const struct intr_frame *if_;       /* The parent's user context. */
+	bool success;                       /* Set by the child: copied? */
+};
+
 /* Clones the current process as `name`. Returns the new process's thread id, or
  * TID_ERROR if the thread cannot be created. */
 tid_t
-process_fork (const char *name, struct intr_frame *if_ UNUSED) {
+process_fork (const char *name, struct intr_frame *if_) {
 	/* Clone current thread to new thread.*/
-	struct thread *parent = thread_current(); // 커널 스레드 
+	struct fork_info info = { thread_current (), if_, false }; // 커널 스레드 
 
-	/* 전달받은 intr_frame을 현재 parent_if에 복사 */
-	memcpy(&parent->parent_if, if_, sizeof(struct intr_frame)); // 부모 프로세스 메모리를 복사
-	
-	/* __do_fork를 실행하는 스레드 생성, 현재 스레드를 인자로 넘겨줌 */
-	tid_t tid = thread_create(name, PRI_DEFAULT, __do_fork, parent); // 전달받은 thread_name으로 __do_fork()를 진행
+	/* __do_fork를 실행하는 스레드 생성, 부모와 intr_frame을 인자로 넘겨줌.
+	 * 자식이 복사를 끝낼 때까지 부모는 기다리므로 복사해 둘 필요 없음 */
+	tid_t tid = thread_create(name, PRI_DEFAULT, __do_fork, &info); // 전달받은 thread_name으로 __do_fork()를 진행
 	// 자식 스레드한테 부모 스레드의 정보를 그대로 줌
 
 	// printf("찍히나?\n");
@@ -117,16 +147,22 @@ process_fork (const char *name, struct intr_frame *if_ UNUSED) {
 		return TID_ERROR;
 	}
 
-	struct thread *child = get_child(tid);
-	sema_down(&child->fork_sema);
-	// get_child()를 통해 해당 p sema_fork 값이 1이 될 때까지
-	// (=자식 스레드 load가 완료될 때까지)를 기다렸다가 끝나면 pid를 반환
+	// 자식의 sema_fork 값이 1이 될 때까지
+	// (=자식 스레드 복제가 완료될 때까지)를 기다렸다가 끝나면 pid를 반환
+	wait_started (tid);
+	return info.success ? tid : TID_ERROR;
+}
 
-	if (child->exit_status == -1) {
-		return TID_ERROR;
-	}
+/* 자식 TID가 fork_sema를 올릴 때까지, 즉 시작하거나 실패할 때까지 기다림.
+   그 사이 같은 프로세스의 다른 스레드가 waitany로 거둬 갔다면 이미 올린 것임 */
+static void
+wait_started (tid_t tid) {
+	struct child_status *child = get_child (tid);
 
-	return tid;
+	if (child != NULL) {
+		sema_down (&child->fork_sema);
+		child_status_release (child);
+	}
 }
 
 /*
@@ -138,18 +174,32 @@ sema_fork 값이 1이 될 때 (== 자식 스레드의 load가 완료될 때, 즉
 현재 실행 중인 프로세스의 자식 프로세스 중에서,
 인자로 받은 pid와 같은 tid를 갖는 자식 프로세스를 찾아 리턴
 */
-struct thread *get_child(int pid) {
-	struct thread *cur = thread_current();
-	struct list *child_list = &cur->child_list;
-
-	for (struct list_elem *e = list_begin(child_list); e != list_end(child_list); e = list_next(e)){
-		struct thread *t = list_entry(e, struct thread, child_elem);
-		if (t->tid == pid) {
-			return t;
-		}
-	}
-	
-	return NULL;
+/* 같은 프로세스의 다른 스레드가 거둬 가도 사라지지 않도록 기록에 hold를 하나 더 잡음.
+   다 쓰면 child_status_release()로 놓아야 함 */
+struct child_status *get_child(int pid) {
+	struct process *p = thread_current()->process;
+	struct child_status *cs = NULL;
+
+	lock_acquire(&p->child_lock);
+	cs = find_child(p, pid);
+	if (cs != NULL)
+		atomic_fetch_add(&cs->refcnt, 1);
+	lock_release(&p->child_lock);
+	return cs;
+}
+
+/* 프로세스 P의 children에서 PID의 기록을 찾음. P의 child_lock을 잡고 불러야 함 */
+static struct child_status *
+find_child (struct process *p, tid_t pid) {
+	struct child_status key;
+	struct ohash_elem *e;
+
+	/* 자식을 만든 적이 없으면 표도 없음 */
+	if (p->children.hash == NULL)
+		return NULL;
+	key.tid = pid;
+	e = ohash_find(&p->children, &key.elem);
+	return e != NULL ? ohash_entry(e, struct child_status, elem) : NULL;
 }
  
 #ifndef VM
@@ -168,14 +218,22 @@ duplicate_pte (uint64_t *pte, void *va, void *aux) {
 	if is_kernel_vaddr(va) { // 부모 스레드는 유저 모드에서 실행되었으므로 user_vaddr임
 		return true;
 	}
+	/* The clock page is shared, not copied; the child mapped it
+	   already. */
+	if (va == CLOCK_PAGE_VA)
+		return true;
 	/* 2. Resolve VA from the parent's page map level 4. */
-	parent_page = pml4_get_page (parent->pml4, va);
+	parent_page = pml4_get_page (parent->process->pml4, va);
 	// 인자로 받은 유저가상메모리에 매핑되는 커널 VA를 리턴
 	// 부모 스레드의 유저 VA를 받아 커널 스레드인 parent가 가지는 페이지 테이블 시작 포인터인 pml4에서
 	// 매핑되는 커널 VA를 리턴받는 것
 	if (parent_page == NULL){
 		return false;
 	}
+	/* 읽기 전용 페이지는 바뀔 일이 없으므로 복사하지 않고 부모의 페이지를
+	   그대로 매핑함. 물리 페이지는 마지막 매핑이 없어질 때 해제됨 */
+	if (!is_writable (pte))
+		return pml4_share_page (current->process->pml4, va, pte);
 
 	/* 3. TODO: Allocate new PAL_USER page for the child and set result to
 	 *    TODO: NEWPAGE. */
@@ -191,12 +249,12 @@ duplicate_pte (uint64_t *pte, void *va, void *aux) {
 	 *    TODO: according to the result). */
 	/* 부모 페이지를 복사해 3에서 새로 할당받은 페이지에 넣어준다. 
 	이때 부모 페이지가 writable인지 아닌지 확인하기 위해 is_writable() 함수를 이용 */
-	memcpy(newpage, parent_page, PGSIZE);
+	fpu_copy_page (newpage, parent_page);
 	writable = is_writable(pte);
 	/* 5. Add new page to child's page table at address VA with WRITABLE
 	 *    permission. */
 	/* 페이지 생성에 실패하면 에러 핸들링이 동작하도록 false를 리턴 */
-	if (!pml4_set_page (current->pml4, va, newpage, writable)) {
+	if (!pml4_set_page (current->process->pml4, va, newpage, writable)) {
 		/* 6. TODO: if fail to insert page, do error handling. */
 		return false;
 	}
@@ -205,11 +263,36 @@ duplicate_pte (uint64_t *pte, void *va, void *aux) {
 }
 #endif
 
-// project 2 - extra
-struct MapElem {
-	uintptr_t key;
-	uintptr_t value;
-};
+/* 부모의 열린 fd를 모두 현재 스레드로 복제함. fork, vfork, spawn이 같이 씀.
+   parent가 기다리고 있는 동안에만 불러야 함.
+   POSIX처럼 자식의 fd는 부모와 같은 struct file을 가리키고 위치도 공유하므로,
+   열린 fd마다 참조 카운트만 올리면 됨 */
+static bool
+duplicate_fdt (struct thread *parent) {
+	struct process *from = parent->process;
+	struct process *to = thread_current ()->process;
+
+	/* 부모의 fd 테이블만큼 자식 테이블을 늘려 둠 */
+	if (!process_reserve_fd(to, from->fd_cap - 1)) {
+		return false;
+	}
+	process_set_file(to, 0, NULL);
+	process_set_file(to, 1, NULL);
+
+	/* bitmap에서 열린 fd만 골라서 공유 */
+	for (int w = 0; w < DIV_ROUND_UP(from->fd_cap, 64); w++)
+		for (uint64_t used = from->fd_used[w]; used != 0; used &= used - 1) {
+			int i = w * 64 + __builtin_ctzll(used);
+			struct file *file = from->file_descriptor_table[i];
+
+			if (file > 2)
+				file_dup(file);
+			process_set_file(to, i, file);
+		}
+	to->stdin_count = from->stdin_count;
+	to->stdout_count = from->stdout_count;
+	return true;
+}
 
 /* A thread function that copies parent's execution context.
  * Hint) parent->tf does not hold the userland context of the process.
@@ -218,217 +301,413 @@ struct MapElem {
 static void
 __do_fork (void *aux) {
 	struct intr_frame if_;
-	struct thread *parent = (struct thread *) aux;
+	struct fork_info *info = aux;
+	struct thread *parent = info->parent;
 	struct thread *current = thread_current ();
-	/* TODO: somehow pass the parent_if. (i.e. process_fork()'s if_) */
-	struct intr_frame *parent_if;
 	bool succ = true;
 
-	/* process_fork에서 복사 해두었던 intr_frame */
-	parent_if = &parent->parent_if;
-	
 	/* 1. Read the cpu context to local stack. */
 	/* 부모의 intr_frame을 if_에 복사 */
-	memcpy (&if_, parent_if, sizeof (struct intr_frame));
+	memcpy (&if_, info->if_, sizeof (struct intr_frame));
 	/* if_의 리턴값을 0으로 설정? */
 	if_.R.rax = 0;
 
 	/* 2. Duplicate Page table */
-	current->pml4 = pml4_create();
-	if (current->pml4 == NULL)
+	current->process->pml4 = pml4_create();
+	if (current->process->pml4 == NULL
+			|| !map_clock_page (current->process->pml4))
 		goto error;
 
+	current->fs_base = parent->fs_base;
 	process_activate (current);
 #ifdef VM
-	supplemental_page_table_init (&current->spt);
-	if (!supplemental_page_table_copy (&current->spt, &parent->spt))
+	/* 부모 프로세스의 다른 스레드가 복사 도중 주소 공간을 바꾸지 못하게 함 */
+	supplemental_page_table_init (&current->process->spt);
+	lock_acquire (&parent->process->vm_lock);
+	succ = supplemental_page_table_copy (&current->process->spt,
+			&parent->process->spt);
+	current->process->heap_start = parent->process->heap_start;
+	current->process->heap_brk = parent->process->heap_brk;
+	lock_release (&parent->process->vm_lock);
+	if (!succ)
 		goto error;
 #else
-	if (!pml4_for_each (parent->pml4, duplicate_pte, parent))
+	if (!pml4_for_each (parent->process->pml4, duplicate_pte, parent))
 		goto error;
 	// 여기로 오지 못함
 #endif
 
 	/* TODO: Your code goes here.
-	 * TODO: Hint) To duplicate the file object, use `file_duplicate`
+	 * TODO: Hint) To share the file object, use `file_dup`
 	 * TODO:       in include/filesys/file.h. Note that parent should not return
 	 * TODO:       from the fork() until this function successfully duplicates
 	 * TODO:       the resources of parent.*/
-	if (parent->fdidx == FDCOUNT_LIMIT) {
+	if (!duplicate_fdt (parent))
+		goto error;
+	/* 부모의 FPU/SSE 레지스터 상태도 복사 */
+	if (!fpu_fork (current, parent))
 		goto error;
-	}
-	// current->file_descriptor_table[0] = parent->file_descriptor_table[0];
-	// current->file_descriptor_table[1] = parent->file_descriptor_table[1];
-
-	// for (int i = 2; i < FDCOUNT_LIMIT; i++){
-	// 	struct file *f = parent->file_descriptor_table[i];
-	// 	if (f == NULL) {
-	// 		continue;
-	// 	}
-	// 	current->file_descriptor_table[i] = file_duplicate(f);
-	// }
-
-	const int MAPLEN = 10;
-	struct MapElem map[10];
-	int dup_count = 0;
-
-	for (int i = 0; i < FDCOUNT_LIMIT; i++) {
-		struct file *file = parent->file_descriptor_table[i];
-		if (file == NULL){
-			continue;
-		}
-
-		bool found = false;
-
-		for (int j = 0; j < MAPLEN; j++) {
-			if (map[j].key == file){
-				found = true;
-				current->file_descriptor_table[i] = map[j].value;
-				break;
-			}
-		}
-		if (!found) {
-			struct file *new_file;
-			if (file > 2)
-				new_file = file_duplicate(file);
-			else
-				new_file = file;
-			current->file_descriptor_table[i] = new_file;
-			if (dup_count < MAPLEN) {
-				map[dup_count].key = file;
-				map[dup_count++].value = new_file;
-			}
-		}
-
-	}
-
 
-	current->fdidx = parent->fdidx;
-	sema_up(&current->fork_sema);
+	/* sema_up 뒤에는 부모 스택에 있는 info를 건드리면 안 됨 */
+	info->success = true;
+	sema_up(&current->child_status->fork_sema);
 
 	/* Finally, switch to the newly created process. */
 	if (succ)
 		do_iret (&if_);
 error:
-	current->exit_status = TID_ERROR;
-	sema_up(&current->fork_sema);
+	current->child_status->exit_status = TID_ERROR;
+	sema_up(&current->child_status->fork_sema);
 	exit(TID_ERROR);
 	// thread_exit ();
 }
 
-/* Switch the current execution context to the f_name.
- * Returns -1 on fail. */
-/* 현재 실행되고 있는 스레드를 f_name에 해당하는 명령을 실행하기 위해 context switching */
-int
-process_exec (void *f_name) { // 유저가 입력한 명령어를 수행하도록 프로그램을 메모리에 적재하고 실행하는 함수. 여기에 파일 네임 인자로 받아서 저장(문자열) => 근데 실행 프로그램 파일과 옵션이 분리되지 않은 상황.
-	/* 수정 */
-	char *file_name = f_name; // f_name은 문자열인데 위에서 (void *)로 넘겨받음! -> 문자열로 인식하기 위해서 char * 로 변환해줘야.
-
+/* Replaces the current process's address space with the program
+ * that ARGS names and sets up IF_ to start it with ARGS as its
+ * arguments.  ARGS is LEN bytes of null-terminated strings end to
+ * end, the first naming the program, in a page from
+ * palloc_get_page(), which this frees.  Returns true if successful. */
+static bool
+process_load (char *args, size_t len, struct intr_frame *if_) {
 	bool success;
 
-	char file_name_address[128]; 	// 원본 문자열을 파싱하면 다른 함수에서 원본 문자열을 쓸 수 있으므로 따로 복사본 만들어줌
-									// 지역변수이므로 스택에 할당됨 (함수의 호출과 함께 할당, 호출 완료 시 소멸)
-
-	memcpy(file_name_address, file_name, strlen(file_name)+1); // strlen에 +1? => 원래 문자열에는 \n이 들어가는데 strlen에서는 \n 앞까지만 읽고 끝내기 때문. 전체를 들고오기 위해 +1
-
 	/* We cannot use the intr_frame in the thread structure.
 	 * This is because when current thread rescheduled,
 	 * it stores the execution information to the member. */
+	if_->ds = if_->es = if_->ss = SEL_UDSEG;	// data_segment, more_data_seg, stack_seg
+	if_->cs = SEL_UCSEG;						// code_segment
+	if_->eflags = FLAG_IF | FLAG_MBS;			// cpu_flag
+	thread_current ()->fs_base = 0;				// TLS는 새 프로그램이 정함
 
-	struct intr_frame _if; 					// 이전에 레지스터에 작업하던 context(레지스터값 포함)를 인터럽트가 들어왔을 때 
-											// switching 하기 위해 intr_frame 내 구조체 멤버에 담아놓고 스택에 저장하기 위한 구조체
-	_if.ds = _if.es = _if.ss = SEL_UDSEG;	// data_segment, more_data_seg, stack_seg
-	_if.cs = SEL_UCSEG;						// code_segment
-	_if.eflags = FLAG_IF | FLAG_MBS;		// cpu_flag
-
-	/* We first kill the current context */
-	process_cleanup ();
+	/* We first kill the current context, keeping its page table */
+	process_reset ();
 	// 새로운 실행 파일을 현재 스레드에 담기 전에 먼저 현재 process에 담긴 context를 지워준다.
 	// 지운다? => 현재 프로세스에 할당된 page directory를 지운다는 뜻.
 
 	/* And then load the binary */
-	success = load (file_name, &_if); // file_name, _if를 현재 프로세스에 load. (메모리에 올린다는 뜻)
-	// success는 bool type이니까 load에 성공하면 1, 실패하면 0 반환.
-	// 이때 file_name: f_name의 첫 문자열을 parsing하여 넘겨줘야 한다!
+	success = load (args, len, if_); // file_name, _if를 현재 프로세스에 load. (메모리에 올린다는 뜻)
 
-	if (!success){
-		return -1;
+	palloc_free_page (args); // 프로그램 파일 받기 위해 만든 임시변수. load 끝나면 메모리 반환
+	return success;
+}
+
+/* Packs the command line CMD_LINE in place into arguments for
+ * process_load(): its words, separated by spaces, each ending in a
+ * null, back to back.  Returns the number of bytes they take. */
+static size_t
+pack_cmd_line (char *cmd_line) {
+	char *token, *save_ptr;
+	size_t len = 0;
+
+	for (token = strtok_r (cmd_line, " ", &save_ptr); token != NULL;
+			token = strtok_r (NULL, " ", &save_ptr)) {
+		size_t n = strlen (token) + 1;
+
+		/* 단어를 앞으로 당겨 붙임. 아직 안 읽은 부분은 건드리지 않음 */
+		memmove (cmd_line + len, token, n);
+		len += n;
 	}
+	return len;
+}
 
-	// hex_dump(_if.rsp, _if.rsp, USER_STACK - _if.rsp, true); // 유저 스택에 담기는 값을 확인하려고 메모리 안에 있는 걸 16진수로 값을 보여줌
+/* Copies the name of the program that ARGS, a command line or
+ * packed arguments, starts with into NAME, which has room for SIZE
+ * bytes, cutting it short if need be. */
+static void
+args_name (char *name, size_t size, const char *args) {
+	strlcpy (name, args, size);
+	name[strcspn (name, " ")] = '\0';
+}
+
+/* Switch the current execution context to the f_name.
+ * Returns -1 on fail. */
+/* 현재 실행되고 있는 스레드를 f_name에 해당하는 명령을 실행하기 위해 context switching */
+int
+process_exec (void *f_name) { // 유저가 입력한 명령어를 수행하도록 프로그램을 메모리에 적재하고 실행하는 함수. 여기에 파일 네임 인자로 받아서 저장(문자열) => 근데 실행 프로그램 파일과 옵션이 분리되지 않은 상황.
+	char *cmd_line = f_name;
+	struct intr_frame _if; 					// 이전에 레지스터에 작업하던 context(레지스터값 포함)를 인터럽트가 들어왔을 때 
+											// switching 하기 위해 intr_frame 내 구조체 멤버에 담아놓고 스택에 저장하기 위한 구조체
 
 	/* If load failed, quit. */
-	palloc_free_page (file_name); // file_name: 프로그램 파일 받기 위해 만든 임시변수. 
-								  // palloc()은 load() 함수 내에서 file_name을 메모리에 올리는 과정에서 page allocation을 해줌
-								  // 따라서 load 끝나면 메모리 반환
-	if (!success)
+	if (!process_load (cmd_line, pack_cmd_line (cmd_line), &_if))
 		return -1;
-	
+	/* 새 프로그램은 FPU 초기 상태에서 시작 */
+	fpu_release (thread_current ());
+
+	// hex_dump(_if.rsp, _if.rsp, USER_STACK - _if.rsp, true); // 유저 스택에 담기는 값을 확인하려고 메모리 안에 있는 걸 16진수로 값을 보여줌
+
 	/* Start switched process. */
 	do_iret (&_if); // 기존까지 작업했던 context를 intr_frame에 담는 과정
 	NOT_REACHED ();
 
 }
 
+/* What process_spawn() hands to the new process, on the parent's
+   stack. */
+struct spawn_info {
+	struct thread *parent;
+	char *args;                         /* Page with the arguments. */
+	size_t len;                         /* Bytes of them. */
+	bool success;                       /* Set by the child: loaded? */
+};
 
+/* Starts a new child process running the program that ARGS names,
+ * with ARGS as its arguments and copies of the current process's
+ * file descriptors.  ARGS is LEN bytes of null-terminated strings,
+ * as process_load() takes, in a page from palloc_get_page() that
+ * this takes over.  Unlike fork() followed
+ * by exec(), no part of the current address space is copied only to
+ * be thrown away.  Returns the child's thread id once its program is
+ * loaded, or TID_ERROR if it cannot be created or loaded. */
+tid_t
+process_spawn (char *args, size_t len) {
+	struct spawn_info info = { thread_current (), args, len, false };
+	char name[sizeof info.parent->name];
+	tid_t tid;
 
-/* 인자를 stack에 올린다 */
-void argument_stack(char **argv, int argc, struct intr_frame *if_) { // if_는 인터럽트 스택 프레임 -> 여기에다 쌓는다.
-
-	/* insert arguments' address */
-	char *arg_address[128];
-
-	// 거꾸로 삽입 -> 스택은 반대 방향으로 확장하기 때문!
-
-	/* 맨 끝 NULL값 (arg[4]) 제외하고 스택에 저장 (arg[0]~arg[3]) */
-	for (int i = argc-1; i >= 0; i--) {
-		int argv_len = strlen(argv[i]);
-		/*
-		if_ -> rsp: 현재 user stack에서 현재 위치를 가리키는 스택 포인터
-		각 인자에서 인자 크기(argv_len)를 읽고 (이때 각 인자에 sentinel이 포함되어 있으니 +1 - strlen에서는 sentinel 빼고 읽음)
-		그 크기만큼 rsp를 내려준다. 그 다음 빈 공간만큼 memcpy를 해준다.
-		*/
-		if_->rsp = if_->rsp - (argv_len+1);
-		memcpy(if_->rsp, argv[i], argv_len+1); // argv[i]의 메모리에 있는 값을 artv_len+1의 길이만큼 if_->rsp에 복사해서 붙여넣는 함수 
-		arg_address[i] = if_->rsp; // arg_address 배열에 현재 문자열 시작 주소 위치를 저장
-	}
-
-	/* word-align: 8의 배수 맞추기 위해 padding 삽입 */
-	while (if_->rsp % 8 != 0) {
-		if_->rsp--; // 주소값을 1 내리고
-		*(uint8_t *) if_->rsp = 0; // 데이터에 0 삽입 -> 8 바이트 저장
-	}
-
-
-	/* 주소값 자체를 삽입 (센티넬 포함해서 넣기) */
-	for (int i = argc; i >= 0; i--) {
-		// 여기서는 NULL 값 포인터도 같이 넣는다.
-		if_->rsp = if_->rsp - 8; // 8바이트만큼 내리고 (64비트 운영체제의 경우 한 번에 처리할 수 있는 데이터 양이 8바이트)
-		if (i == argc) { // 가장 위에는 NULL이 아닌 0을 넣음
-			memset(if_->rsp, 0, sizeof(char**)); // 메모리의 내용(값)을 원하는 크기만큼 특정 값으로 세팅
-												 // 세팅하고자 하는 메모리 주소, 메모리에 세팅하고자 하는 값, 바이트 단위로 메모리의 크기 한 조각 단위의 길이
-												 // 성공 시 첫번째 인자로 들어간 ptr 반환, 실패 시 NULL 반환
-		} else { // 나머지에는 arg_address 안에 들어있는 "값" 가져오기
-			memcpy(if_->rsp, &arg_address[i], sizeof(char**)); // char 포인터의 크기 : 8바이트
-		}
+	/* 스레드 이름은 실행 파일 이름 */
+	args_name (name, sizeof name, args);
+
+	tid = thread_create (name, PRI_DEFAULT, spawnd, &info);
+	if (tid == TID_ERROR) {
+		palloc_free_page (args);
+		return TID_ERROR;
+	}
+
+	/* 자식이 load를 끝낼 때까지 기다림. 실패한 자식의 기록은 wait으로 거둘 때까지 남아 있음 */
+	wait_started (tid);
+	return info.success ? tid : TID_ERROR;
+}
+
+/* A thread function that starts a process for process_spawn(). */
+static void
+spawnd (void *info_) {
+	struct spawn_info *info = info_;
+	struct thread *current = thread_current ();
+	struct intr_frame if_;
+	bool success;
+
+#ifdef VM
+	supplemental_page_table_init (&current->process->spt);
+#endif
+	process_init ();
+
+	if (duplicate_fdt (info->parent))
+		success = process_load (info->args, info->len, &if_);
+	else {
+		palloc_free_page (info->args);
+		success = false;
 	}
 
-	// /* fake return address */
-	// if_->rsp = if_->rsp - 8; // void 포인터도 8바이트 크기
-	// memset(if_->rsp, 0, sizeof(void *));
+	/* sema_up 뒤에는 부모 스택에 있는 info를 건드리면 안 됨 */
+	info->success = success;
+	sema_up (&current->child_status->fork_sema);
+	if (!success)
+		exit (-1);
+	do_iret (&if_);
+	NOT_REACHED ();
+}
 
-	// if_-> R.rdi = argc;			// main 함수에서 argc
-	// if_-> R.rsi = if_->rsp + 8; // fake_address 바로 위 : arg_address 맨 앞 가리키는 주소값 // rsi+8
+#ifndef VM
+/* What process_vfork() hands to the new process, on the parent's
+   stack. */
+struct vfork_info {
+	struct thread *parent;
+	const struct intr_frame *if_;       /* The parent's user context. */
+	bool success;                       /* Set by the child: started? */
+};
 
-	if_ -> R.rsi = if_->rsp;
-	if_ -> R.rdi = argc;
+/* Creates a child of the current process as NAME that runs in the
+ * current address space, on the same page table, until it calls
+ * exec() or exits.  Until then the current process waits, as the
+ * two would otherwise scribble over each other's stack.  This is
+ * vfork(): the child is meant to do little but call exec(), and
+ * nothing is copied for it but the file descriptors.  Returns the
+ * child's thread id, or TID_ERROR if it cannot be created.
+ *
+ * The supplemental page table of project 3 names its process as the
+ * owner of every page and cannot be lent to another like this, but
+ * there fork() already shares the pages copy-on-write, so vfork() is
+ * fork() with VM. */
+tid_t
+process_vfork (const char *name, struct intr_frame *if_) {
+	struct vfork_info info = { thread_current (), if_, false };
+	tid_t tid;
 
-	/* fake return address */
-	if_->rsp = if_->rsp - 8; // void 포인터도 8바이트 크기
-	memset(if_->rsp, 0, sizeof(void *));
+	tid = thread_create (name, PRI_DEFAULT, __do_vfork, &info);
+	if (tid == TID_ERROR)
+		return TID_ERROR;
 
+	/* 자식이 exec하거나 종료해서 page table을 돌려줄 때까지 기다림 */
+	wait_started (tid);
+	return info.success ? tid : TID_ERROR;
 }
 
+/* A thread function that starts a process for process_vfork(). */
+static void
+__do_vfork (void *info_) {
+	struct vfork_info *info = info_;
+	struct thread *parent = info->parent;
+	struct thread *current = thread_current ();
+	struct intr_frame if_;
+
+	memcpy (&if_, info->if_, sizeof if_);
+	if_.R.rax = 0;
+
+	/* 부모의 page table을 그대로 빌려 씀. exec나 exit에서 돌려줌 */
+	current->process->pml4 = parent->process->pml4;
+	current->vfork_borrowed = true;
+	current->fs_base = parent->fs_base;
+	process_activate (current);
+
+	process_init ();
+	if (!duplicate_fdt (parent) || !fpu_fork (current, parent))
+		exit (TID_ERROR);
+	info->success = true;
+	do_iret (&if_);
+	NOT_REACHED ();
+}
+#endif
+
+/* What process_thread_spawn() hands to the new thread, on its
+   creator's stack. */
+struct thread_spawn_info {
+	struct thread *parent;
+	struct intr_frame if_;              /* Where the thread starts. */
+	uint64_t fs_base;                   /* Its FS base. */
+	int *tidp;                          /* Gets its tid, or NULL. */
+	bool success;                       /* Set by the thread: started? */
+};
+
+/* Adds a thread to the current process that starts in user mode at
+ * ENTRY, with ARG as its argument, STACK as its stack pointer and
+ * TLS as its FS base, and shares the address space and the file
+ * descriptors of the other threads.  If TIDP is not null, the new
+ * thread's id is stored there before it runs, and zero as it exits,
+ * followed by a futex_wake() on TIDP, so that a thread sleeping in
+ * futex_wait() on that word until it is zero joins the new thread.
+ * Returns the new thread's id, or TID_ERROR if it cannot be created.
+ *
+ * With VM, the threads share the supplemental page table along with
+ * the page table, both in struct process, and take its vm_lock to
+ * work on them. */
+tid_t
+process_thread_spawn (void *entry, void *arg, void *stack, void *tls,
+		int *tidp) {
+	struct thread *curr = thread_current ();
+	struct thread_spawn_info info;
+	struct child_status *child;
+	tid_t tid;
+
+	/* vfork()로 빌린 주소 공간에는 스레드를 늘리지 않음 */
+	if (curr->vfork_borrowed)
+		return TID_ERROR;
+
+	memset (&info, 0, sizeof info);
+	info.parent = curr;
+	info.if_.ds = info.if_.es = info.if_.ss = SEL_UDSEG;
+	info.if_.cs = SEL_UCSEG;
+	info.if_.eflags = FLAG_IF | FLAG_MBS;
+	info.if_.rip = (uintptr_t) entry;
+	info.if_.rsp = (uintptr_t) stack;
+	info.if_.R.rdi = (uint64_t) arg;
+	info.fs_base = (uintptr_t) tls;
+	info.tidp = tidp;
+
+	tid = thread_create (curr->name, PRI_DEFAULT, thread_spawnd, &info);
+	if (tid == TID_ERROR)
+		return TID_ERROR;
+
+	/* 새 스레드는 자식이 아니므로 시작하고 나면 기록을 지움.
+	   새 스레드는 종료를 알리지 않으므로 waitany가 거둬 갈 일은 없음 */
+	child = get_child (tid);
+	sema_down (&child->fork_sema);
+	lock_acquire (&curr->process->child_lock);
+	if (!child->claimed) {
+		child->claimed = true;
+		ohash_delete (&curr->process->children, &child->elem);
+		child_status_release (child);
+	}
+	lock_release (&curr->process->child_lock);
+	child_status_release (child);
+	return info.success ? tid : TID_ERROR;
+}
+
+/* A thread function that starts a thread for
+   process_thread_spawn(). */
+static void
+thread_spawnd (void *info_) {
+	struct thread_spawn_info *info = info_;
+	struct thread *parent = info->parent;
+	struct thread *current = thread_current ();
+	struct child_status *cs = current->child_status;
+	struct intr_frame if_;
+	bool success;
+
+	memcpy (&if_, &info->if_, sizeof if_);
+
+	/* thread_create()가 만든 프로세스 대신 부모의 프로세스에 들어감.
+	   page table과 supplemental page table도 거기에 있음 */
+	process_free (current->process);
+	current->process = parent->process;
+	atomic_fetch_add (&current->process->thread_cnt, 1);
+	current->fs_base = info->fs_base;
+	process_activate (current);
+
+	if (info->tidp != NULL
+			&& copy_to_user (info->tidp, &current->tid, sizeof current->tid))
+		current->clear_tid = info->tidp;
+	success = info->tidp == NULL || current->clear_tid != NULL;
+
+	/* sema_up 뒤에는 부모 스택에 있는 info를 건드리면 안 됨 */
+	info->success = success;
+	current->child_status = NULL;
+	sema_up (&cs->fork_sema);
+	child_status_release (cs);
+	if (!success)
+		thread_exit ();
+	do_iret (&if_);
+	NOT_REACHED ();
+}
+
+/* 인자를 stack에 올린다 */
+/* Pushes ARGS, LEN bytes of null-terminated strings end to end, onto
+ * the new user stack at IF_->rsp, followed by argv[] pointing to
+ * them and a fake return address, and sets RDI and RSI to argc and
+ * argv for main().  The layout is worked out first, so the strings
+ * go in with one copy and each pointer is written once.  Returns
+ * false if it does not all fit in the stack page. */
+static bool
+argument_stack (const char *args, size_t len, struct intr_frame *if_) {
+	uintptr_t strings = if_->rsp - len;
+	const char *p;
+	char **argv;
+	int argc = 0;
+
+	for (p = args; p < args + len; p += strlen (p) + 1)
+		argc++;
+
+	/* 위에서부터 문자열, 8바이트 정렬, argv[argc]까지의 포인터(마지막은 NULL),
+	   가짜 return address 순서 */
+	argv = (char **) (ROUND_DOWN (strings, sizeof (char *))
+			- (argc + 1) * sizeof (char *));
+	if ((uintptr_t) argv - sizeof (void *) < USER_STACK - PGSIZE)
+		return false;
+
+	memcpy ((void *) strings, args, len);
+	p = (const char *) strings;
+	for (int i = 0; i < argc; i++) {
+		argv[i] = (char *) p;
+		p += strlen (p) + 1;
+	}
+	argv[argc] = NULL;
+
+	if_->R.rdi = argc;
+	if_->R.rsi = (uint64_t) argv;
+	if_->rsp = (uintptr_t) argv - sizeof (void *);
+	*(void **) if_->rsp = NULL;
+	return true;
+}
 
 
 /* Waits for thread TID to die and returns its exit status.  If
@@ -453,17 +732,82 @@ process_wait (tid_t child_tid UNUSED) {
 	// for (int i = 0; i < 100000000; i++); // 테스트를 위해 잠시 무한루프 해제 -> fork 완성 전까지만
 	// return -1;
 
-	struct thread *child = get_child(child_tid);
+	struct process *p = thread_current()->process;
+	struct child_status *child;
+
+	/* 기록을 children에서 빼 두면 같은 프로세스의 다른 스레드는 이 자식을 wait하지 못함 */
+	lock_acquire(&p->child_lock);
+	child = find_child(p, child_tid);
+	if (child != NULL) {
+		child->claimed = true;
+		ohash_delete(&p->children, &child->elem);
+	}
+	lock_release(&p->child_lock);
 	if (child == NULL)
 		return -1;
 
+	/* 자식은 종료할 때 기록만 남기고 바로 사라지므로 기록만 보면 됨 */
 	sema_down(&child->wait_sema);
 
-	int exit_status = child->exit_status;
+	/* 종료한 자식은 exited_children에도 있으므로 그 몫의 up도 가져감.
+	   waitany가 먼저 꺼내 갔으면 up도 그쪽이 가져갔음 */
+	child_status_unlist(p, child);
+	return reap_child(child);
+}
+
+/* Waits for any child of the running process, forked by whichever
+ * of its threads, to exit, stores its exit status in *STATUS and
+ * returns its tid.  Children are reaped in the order they exited,
+ * each taken off the front of exited_children, so the cost does not
+ * grow with their number.  A child that another thread is waiting
+ * for by tid is left to it.  Returns -1 at once if there are no
+ * children to wait for. */
+tid_t
+process_waitany (int *status) {
+	struct process *p = thread_current ()->process;
+	struct child_status *child;
+	bool empty;
+
+	for (;;) {
+		lock_acquire (&p->child_lock);
+		empty = p->children.hash == NULL || ohash_size (&p->children) == 0;
+		lock_release (&p->child_lock);
+		if (empty)
+			return -1;
+
+		/* up 하나마다 exited_children에 기록이 하나 있었음.
+		   wait(tid)가 그 기록을 먼저 빼 갔을 수 있음 */
+		sema_down (&p->child_exited);
+		child = child_status_pop_exited (p);
+		if (child == NULL)
+			continue;
+
+		/* wait(tid)로 기다리는 스레드가 있으면 그쪽이 거둠 */
+		lock_acquire (&p->child_lock);
+		if (!child->claimed) {
+			child->claimed = true;
+			ohash_delete (&p->children, &child->elem);
+		} else
+			child = NULL;
+		lock_release (&p->child_lock);
+		if (child != NULL) {
+			tid_t tid = child->tid;
+
+			*status = reap_child (child);
+			return tid;
+		}
+	}
+}
 
-	list_remove(&child->child_elem);
-	sema_up(&child->free_sema);
+/* children과 exited_children에서 이미 뺀 자식 CHILD의 기록을
+   놓은 뒤 종료 상태를 반환 */
+static int
+reap_child (struct child_status *child) {
+	int exit_status = child->exit_status;
 
+	/* 자식이 쓴 자원을 wait한 자식들 몫에 더함 */
+	thread_reap_rusage (child);
+	child_status_release (child);
 	return exit_status;
 }
 
@@ -471,42 +815,129 @@ process_wait (tid_t child_tid UNUSED) {
 void
 process_exit (void) {
 	struct thread *curr = thread_current ();
+	struct process *p = curr->process;
 	/* TODO: Your code goes here.
 	 * TODO: Implement process termination message (see
 	 * TODO: project2/process_termination.html).
 	 * TODO: We recommend you to implement process resource cleanup here. */
-	for (int i = 0; i < FDCOUNT_LIMIT; i++){
-		close(i);
+	stdout_flush();
+	free(curr->stdout_buf);
+	curr->stdout_buf = NULL;
+
+	/* 다른 스레드가 남아 있으면 프로세스는 그대로 두고 빠지기만 함 */
+	if (p == NULL || !process_leave ())
+		return;
+
+	/* 열린 fd만 bitmap에서 골라 닫음 */
+	for (int i = 0; i < DIV_ROUND_UP(p->fd_cap, 64); i++){
+		uint64_t used = p->fd_used[i];
+
+		while (used != 0) {
+			close(i * 64 + __builtin_ctzll(used));
+			used &= used - 1;
+		}
 	}
-	palloc_free_multiple(curr->file_descriptor_table, FDT_PAGES);
 	
 	// running이 NULL일 때는 file_close를 할 필요가 없음
 	// 모든 alarm-single 같은 것들이 다 userprog로 들어와서 process_exit으로 들어옴
 	// 이때는 running이 NULL임 -> file_close할 필요 없음
-	if (curr->running != NULL) {
-		file_close(curr->running);
+	if (p->running != NULL) {
+		file_close(p->running);
 	}
 
+	/* 주소 공간은 프로세스에 있으므로 프로세스를 놓기 전에 부숨 */
 	process_cleanup();
-
-	sema_up(&curr->wait_sema);
-	sema_down(&curr->free_sema);
+	curr->process = NULL;
+	process_free(p);
+	/* 종료 상태는 thread_exit()이 부모의 기록에 남김 */
 	
 }
 
+/* Takes the running thread out of its process: stores zero in its
+ * clear_tid word and wakes whoever waits on it, then, if other
+ * threads are left, lets go of the address space the way a vfork()
+ * child gives it back and leaves them what it used and its record
+ * for the parent, if it has it.  Returns true if it was the last
+ * thread, which is then the one to tear the process down and to
+ * report the process's exit status to the parent. */
+static bool
+process_leave (void) {
+	struct thread *curr = thread_current ();
+	struct process *p = curr->process;
+	struct rusage ru;
+	bool last;
+
+	if (curr->clear_tid != NULL) {
+		int zero = 0;
+
+		/* 주소가 망가졌으면 깨울 사람도 못 찾으므로 넘어감 */
+		if (copy_to_user (curr->clear_tid, &zero, sizeof zero))
+			futex_wake (curr->clear_tid, INT_MAX);
+		curr->clear_tid = NULL;
+	}
+	thread_get_rusage (&ru, false);
+
+	/* 마지막 스레드가 page table을 부수기 전에 놓아야 하므로 같이 함 */
+	spin_lock (&p->leave_lock);
+	last = --p->thread_cnt == 0;
+	if (!last) {
+		rusage_add (&p->rusage, &ru);
+		rusage_add (&p->rusage, &curr->rusage_children);
+		if (curr->child_status != NULL) {
+			p->child_status = curr->child_status;
+			curr->child_status = NULL;
+		}
+		/* page table은 프로세스의 것이므로 빠지면 더 쓰지 않음 */
+		curr->process = NULL;
+		pml4_activate (NULL);
+	}
+	spin_unlock (&p->leave_lock);
+
+	if (last) {
+		if (curr->child_status == NULL)
+			curr->child_status = p->child_status;
+		rusage_add (&curr->rusage_children, &p->rusage);
+		if (p->exiting)
+			curr->exit_status = p->exit_status;
+	}
+	return last;
+}
+
+/* Ends the running thread if another thread of its process has
+ * called exit().  Called on the way back to user mode, after a
+ * system call or an interrupt, where nothing is held. */
+void
+process_check_exiting (void) {
+	struct process *p = thread_current ()->process;
+
+	if (p != NULL && p->exiting) {
+		intr_enable ();
+		thread_exit ();
+	}
+}
+
 /* Free the current process's resources. */
 static void
 process_cleanup (void) {
 	struct thread *curr = thread_current ();
+	struct process *p = curr->process;
+
+	/* vfork()로 빌린 page table은 부수지 않고 돌려준 뒤 부모를 깨움 */
+	if (curr->vfork_borrowed) {
+		p->pml4 = NULL;
+		pml4_activate (NULL);
+		curr->vfork_borrowed = false;
+		sema_up (&curr->child_status->fork_sema);
+	}
 
 #ifdef VM
-	supplemental_page_table_kill (&curr->spt);
+	supplemental_page_table_kill (&p->spt);
 #endif
 
 	uint64_t *pml4;
 	/* Destroy the current process's page directory and switch back
 	 * to the kernel-only page directory. */
-	pml4 = curr->pml4;
+	pml4 = p->pml4;
 	if (pml4 != NULL) {
 		/* Correct ordering here is crucial.  We must set
 		 * cur->pagedir to NULL before switching page directories,
@@ -517,10 +948,54 @@ process_cleanup (void) {
 		 * that's been freed (and cleared).
 		 * 순서가 중요한 이유가 나와 있으나 이해 잘 못함
 		 *  */
-		curr->pml4 = NULL;
+		p->pml4 = NULL;
 		pml4_activate (NULL);
+		/* Unmap the shared clock page first so that pml4_destroy()
+		   does not free it. */
+		pml4_clear_page (pml4, CLOCK_PAGE_VA);
+#ifdef VM
+		/* The frames are gone with the supplemental page table
+		 * already, and the PTEs still pointing to them were left. */
+		pml4_destroy_tables (pml4);
+#else
 		pml4_destroy (pml4);
+#endif
+	}
+}
+
+/* Empties the current process's address space for exec(), like
+ * process_cleanup(), but keeps its page table, emptied of user
+ * mappings, for load() to fill in again: exec() then needs neither a
+ * new top-level table nor a fresh copy of the kernel's mappings, and
+ * takes its lower level tables from the pool pml4_reset() fills.  A
+ * page table borrowed from a vfork() parent is given back instead. */
+static void
+process_reset (void) {
+	struct thread *curr = thread_current ();
+	struct process *p = curr->process;
+
+	if (p->pml4 == NULL || curr->vfork_borrowed) {
+		process_cleanup ();
+		return;
 	}
+
+#ifdef VM
+	supplemental_page_table_kill (&p->spt);
+#endif
+	/* The clock page is not ours to free. */
+	pml4_clear_page (p->pml4, CLOCK_PAGE_VA);
+#ifdef VM
+	pml4_reset_tables (p->pml4);
+#else
+	pml4_reset (p->pml4);
+#endif
+}
+
+/* Maps the shared clock page read-only into PML4 at
+   CLOCK_PAGE_VA.  Returns true if successful. */
+static bool
+map_clock_page (uint64_t *pml4) {
+	return pml4_set_page (pml4, CLOCK_PAGE_VA, timer_clock_page (), false);
 }
 
 /* Sets up the CPU for running user code in the nest thread.
@@ -529,9 +1004,14 @@ void
 process_activate (struct thread *next) {
 	/* Activate thread's page tables. */
 	// printf("여기까지 오긴 하나 55\n");
-	pml4_activate (next->pml4);
+	pml4_activate (thread_pml4 (next));
 	/* Set thread's kernel stack for use in processing interrupts. */
 	tss_update (next);
+	/* And its TLS, unless the CPU already has its FS base. */
+	if (this_cpu ()->fs_base != next->fs_base) {
+		write_msr (MSR_FS_BASE, next->fs_base);
+		this_cpu ()->fs_base = next->fs_base;
+	}
 
 	// printf("여기까지 오긴 하나 66\n");
 }
@@ -595,7 +1075,8 @@ static bool load_segment (struct file *file, off_t ofs, uint8_t *upage,
 		uint32_t read_bytes, uint32_t zero_bytes,
 		bool writable);
 
-/* Loads an ELF executable from FILE_NAME into the current thread.
+/* Loads an ELF executable into the current thread, passing it the
+ * LEN bytes of arguments ARGS, the first of which names it.
  * Stores the executable's entry point into *RIP
  * and its initial stack pointer into *RSP.
  * Returns true if successful, false otherwise. */
@@ -606,39 +1087,29 @@ static bool load_segment (struct file *file, off_t ofs, uint8_t *upage,
  * cpu의 다음 명령어 주소를 해당 프로그램의 엔트리 주소(_start() 함수)로 설정
  */
 static bool
-load (const char *file_name, struct intr_frame *if_) { // file_name으로 함수 이름만 들어와야 원하는 작업 완료 가능
+load (const char *args, size_t len, struct intr_frame *if_) {
 	struct thread *t = thread_current ();
 	struct ELF ehdr;
 	struct file *file = NULL;
-	off_t file_ofs;
+	uint8_t *hdrs = NULL, *phdrs_buf = NULL;
+	const uint8_t *phdrs;
+	off_t hdrs_len;
+	size_t phdrs_len;
 	bool success = false;
 	int i;
 
-	/* command line parsing */
-	// char *arg_list[128];
-	// char *token, *save_ptr;
-	// int argc = 0;
-
-	// token = strtok_r(file_name, " ", &save_ptr); // 첫번째 이름
-	// arg_list[token_count] = token;
-
-	// while (token != NULL) {
-	// 	token = strtok_r (NULL, " ", &save_ptr);
-	// 	token_count++;
-	// 	arg_list[token_count] = token;
-	// }
+	/* The first argument names the program. */
+	const char *file_name = args;
 
-	char *argv[64];
-	char *token, *save_ptr;
-	int argc = 0;
-	for (token = strtok_r(file_name, " ", &save_ptr); token != NULL; token = strtok_r(NULL, " ", &save_ptr)) {
-		argv[argc] = token;
-		argc += 1;
-	}
+#ifdef VM
+	t->process->heap_start = NULL;
+#endif
 
-	/* Allocate and activate page directory. */
-	t->pml4 = pml4_create (); // 페이지 디렉토리 생성
-	if (t->pml4 == NULL)
+	/* Allocate and activate page directory, unless exec() kept the
+	 * old one. */
+	if (t->process->pml4 == NULL)
+		t->process->pml4 = pml4_create (); // 페이지 디렉토리 생성
+	if (t->process->pml4 == NULL || !map_clock_page (t->process->pml4))
 		goto done;
 	process_activate (thread_current ()); // 페이지 테이블 활성화
 
@@ -651,11 +1122,20 @@ load (const char *file_name, struct intr_frame *if_) { // file_name으로 함수
 	}
 
 	/* denying writes to executable */
-	t->running = file;
+	t->process->running = file;
 	file_deny_write(file);
 
-	/* Read and verify executable header. */
-	if (file_read (file, &ehdr, sizeof ehdr) != sizeof ehdr
+	/* Read the executable header and, in the same read, the program
+	 * headers, which normally follow it. */
+	hdrs = palloc_get_page (0);
+	if (hdrs == NULL)
+		goto done;
+	hdrs_len = file_read_at (file, hdrs, PGSIZE, 0);
+
+	/* Verify executable header. */
+	if (hdrs_len >= (off_t) sizeof ehdr)
+		memcpy (&ehdr, hdrs, sizeof ehdr);
+	if (hdrs_len < (off_t) sizeof ehdr
 			|| memcmp (ehdr.e_ident, "\177ELF\2\1\1", 7)
 			|| ehdr.e_type != 2
 			|| ehdr.e_machine != 0x3E // amd64
@@ -666,18 +1146,27 @@ load (const char *file_name, struct intr_frame *if_) { // file_name으로 함수
 		goto done;
 	}
 
-	/* Read program headers. */
-	file_ofs = ehdr.e_phoff;
+	/* Find the program headers, with one more read if they are not
+	 * in the first page. */
+	phdrs_len = ehdr.e_phnum * sizeof (struct Phdr);
+	if (ehdr.e_phoff > (uint64_t) file_length (file))
+		goto done;
+	if (ehdr.e_phoff + phdrs_len <= (uint64_t) hdrs_len)
+		phdrs = hdrs + ehdr.e_phoff;
+	else {
+		phdrs_buf = malloc (phdrs_len);
+		if (phdrs_buf == NULL
+				|| file_read_at (file, phdrs_buf, phdrs_len, ehdr.e_phoff)
+				!= (off_t) phdrs_len)
+			goto done;
+		phdrs = phdrs_buf;
+	}
+
 	for (i = 0; i < ehdr.e_phnum; i++) {
 		struct Phdr phdr;
 
-		if (file_ofs < 0 || file_ofs > file_length (file))
-			goto done;
-		file_seek (file, file_ofs);
-		// ELF 파일의 헤더 정보를 읽어와 저장
-		if (file_read (file, &phdr, sizeof phdr) != sizeof phdr)
-			goto done;
-		file_ofs += sizeof phdr;
+		/* The table need not be aligned in the file. */
+		memcpy (&phdr, phdrs + i * sizeof phdr, sizeof phdr);
 		switch (phdr.p_type) {
 			case PT_NULL:
 			case PT_NOTE:
@@ -713,6 +1202,11 @@ load (const char *file_name, struct intr_frame *if_) { // file_name으로 함수
 					if (!load_segment (file, file_page, (void *) mem_page,
 								read_bytes, zero_bytes, writable))
 						goto done;
+#ifdef VM
+					/* heap은 가장 높은 segment 바로 뒤에서 시작 */
+					if ((uint8_t *) mem_page + read_bytes + zero_bytes > t->process->heap_start)
+						t->process->heap_start = (uint8_t *) mem_page + read_bytes + zero_bytes;
+#endif
 				}
 				else
 					goto done;
@@ -720,6 +1214,10 @@ load (const char *file_name, struct intr_frame *if_) { // file_name으로 함수
 		}
 	}
 
+#ifdef VM
+	t->process->heap_brk = t->process->heap_start;
+#endif
+
 	/* Set up stack. */
 	if (!setup_stack (if_))
 		goto done;
@@ -733,14 +1231,17 @@ load (const char *file_name, struct intr_frame *if_) { // file_name으로 함수
 	 * TODO: Implement argument passing (see project2/argument_passing.html). */
 
 	/* Argument parsing */
-	// argument_stack(arg_list, token_count, if_); // 인자값을 스택에 올림
 	// 인터럽트 프레임 내 구조체 중 특정값(rsp)에 인자를 넣어주기
-	argument_stack(argv, argc, if_); // 인자값을 스택에 올림
+	if (!argument_stack (args, len, if_)) // 인자값을 스택에 올림
+		goto done;
 
 	success = true;
 
 done:
 	/* We arrive here whether the load is successful or not. */
+	if (hdrs != NULL)
+		palloc_free_page (hdrs);
+	free (phdrs_buf);
 	// 파일이 열려 있어야 하는 상태이므로 file_close() 주석처리
 	// file_close (file);
 	return success;
@@ -820,7 +1321,6 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 	ASSERT (pg_ofs (upage) == 0);
 	ASSERT (ofs % PGSIZE == 0);
 
-	file_seek (file, ofs);
 	while (read_bytes > 0 || zero_bytes > 0) {
 		/* Do calculate how to fill this page.
 		 * We will read PAGE_READ_BYTES bytes from FILE
@@ -834,7 +1334,8 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 			return false;
 
 		/* Load this page. */
-		if (file_read (file, kpage, page_read_bytes) != (int) page_read_bytes) {
+		if (file_read_at (file, kpage, page_read_bytes, ofs)
+				!= (int) page_read_bytes) {
 			palloc_free_page (kpage);
 			return false;
 		}
@@ -848,6 +1349,7 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 		}
 
 		/* Advance. */
+		ofs += page_read_bytes;
 		read_bytes -= page_read_bytes;
 		zero_bytes -= page_zero_bytes;
 		upage += PGSIZE;
@@ -887,8 +1389,8 @@ install_page (void *upage, void *kpage, bool writable) {
 
 	/* Verify that there's not already a page at that virtual
 	 * address, then map our page there. */
-	return (pml4_get_page (t->pml4, upage) == NULL
-			&& pml4_set_page (t->pml4, upage, kpage, writable));
+	return (pml4_get_page (t->process->pml4, upage) == NULL
+			&& pml4_set_page (t->process->pml4, upage, kpage, writable));
 }
 #else
 /* From here, codes will be used after project 3.
@@ -896,10 +1398,19 @@ install_page (void *upage, void *kpage, bool writable) {
  * upper block. */
 
 static bool
-lazy_load_segment (struct page *page, void *aux) {
-	/* TODO: Load the segment from the file */
-	/* TODO: This called when the first page fault occurs on address VA. */
-	/* TODO: VA is available when calling this function. */
+lazy_load_segment (struct page *page, void *aux_) {
+	struct vm_load_aux *aux = aux_;
+	uint8_t *kva = page->frame->kva;
+	bool success;
+
+	success = file_read_at (aux->file, kva, aux->read_bytes, aux->ofs)
+		== (off_t) aux->read_bytes;
+	/* The page owns AUX only until it is loaded. */
+	file_close (aux->file);
+
+	memset (kva + aux->read_bytes, 0, PGSIZE - aux->read_bytes);
+	free (aux);
+	return success;
 }
 
 /* Loads a segment starting at offset OFS in FILE at address
@@ -912,7 +1423,8 @@ lazy_load_segment (struct page *page, void *aux) {
  * - ZERO_BYTES bytes at UPAGE + READ_BYTES must be zeroed.
  *
  * The pages initialized by this function must be writable by the
- * user process if WRITABLE is true, read-only otherwise.
+ * user process if WRITABLE is true, read-only otherwise.  They make
+ * up one region of the address space.
  *
  * Return true if successful, false if a memory allocation error
  * or disk read error occurs. */
@@ -923,6 +1435,12 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 	ASSERT (pg_ofs (upage) == 0);
 	ASSERT (ofs % PGSIZE == 0);
 
+	if (read_bytes + zero_bytes > 0
+			&& vm_area_create (&thread_current ()->process->spt, upage,
+				upage + read_bytes + zero_bytes, VM_ANON, writable, file,
+				ofs) == NULL)
+		return false;
+
 	while (read_bytes > 0 || zero_bytes > 0) {
 		/* Do calculate how to fill this page.
 		 * We will read PAGE_READ_BYTES bytes from FILE
@@ -930,13 +1448,34 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 		size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
 		size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
-		/* TODO: Set up aux to pass information to the lazy_load_segment. */
-		void *aux = NULL;
-		if (!vm_alloc_page_with_initializer (VM_ANON, upage,
-					writable, lazy_load_segment, aux))
+		/* A page of nothing but zeros, as in .bss, needs nothing
+		 * from the file: it starts out as the shared zero page. */
+		if (page_read_bytes == 0) {
+			if (!vm_alloc_page (VM_ANON, upage, writable))
+				return false;
+			zero_bytes -= page_zero_bytes;
+			upage += PGSIZE;
+			continue;
+		}
+
+		/* Each page gets its own handle on FILE, since the caller
+		 * closes FILE long before the last page is faulted in. */
+		struct vm_load_aux *aux = malloc (sizeof *aux);
+		if (aux == NULL)
+			return false;
+		aux->file = file_reopen (file);
+		aux->ofs = ofs;
+		aux->read_bytes = page_read_bytes;
+		if (aux->file == NULL
+				|| !vm_alloc_page_with_initializer (VM_ANON, upage,
+					writable, lazy_load_segment, aux)) {
+			file_close (aux->file);
+			free (aux);
 			return false;
+		}
 
 		/* Advance. */
+		ofs += page_read_bytes;
 		read_bytes -= page_read_bytes;
 		zero_bytes -= page_zero_bytes;
 		upage += PGSIZE;
@@ -944,16 +1483,24 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 	return true;
 }
 
-/* Create a PAGE of stack at the USER_STACK. Return true on success. */
+/* Create a PAGE of stack at the USER_STACK. Return true on success.
+ * The stack's whole region, STACK_MAX bytes, is reserved now for it
+ * to grow into. */
 static bool
 setup_stack (struct intr_frame *if_) {
 	bool success = false;
 	void *stack_bottom = (void *) (((uint8_t *) USER_STACK) - PGSIZE);
 
-	/* TODO: Map the stack on stack_bottom and claim the page immediately.
-	 * TODO: If success, set the rsp accordingly.
-	 * TODO: You should mark the page is stack. */
-	/* TODO: Your code goes here */
+	/* The first stack page is needed right away for the
+	 * arguments, so claim it instead of waiting for a fault. */
+	if (vm_area_create (&thread_current ()->process->spt,
+				(uint8_t *) USER_STACK - STACK_MAX, (void *) USER_STACK,
+				VM_ANON | VM_STACK, true, NULL, 0) != NULL
+			&& vm_alloc_page (VM_ANON | VM_STACK, stack_bottom, true)
+			&& vm_claim_page (stack_bottom)) {
+		if_->rsp = USER_STACK;
+		success = true;
+	}
 
 	return success;
 }
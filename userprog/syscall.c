@@ -1,30 +1,59 @@
 #include "userprog/syscall.h"
+#include <dirent.h>
+#include <diskstat.h>
+#include <limits.h>
+#include <memstat.h>
+#include <perf.h>
+#include <rusage.h>
+#include <ring.h>
+#include <round.h>
 #include <stdio.h>
+#include <string.h>
 #include <syscall-nr.h>
+#include <uio.h>
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
+#include "threads/percpu.h"
+#include "threads/pmu.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
+#include "threads/tunable.h"
 #include "threads/loader.h"
 #include "userprog/gdt.h"
+#include "userprog/tss.h"
 #include "threads/flags.h"
 #include "intrinsic.h"
 
 /* 추가해준 헤더 파일들 */
+#include "devices/disk.h"
+#include "devices/timer.h"
+#include "devices/input.h"
+#include "devices/intq.h"
 #include "filesys/filesys.h"
+#include "filesys/directory.h"
 #include "filesys/file.h"
+#include "filesys/inode.h"
 #include <list.h>
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/vaddr.h"
 #include "userprog/process.h"
 #include "threads/synch.h"
+#include "userprog/futex.h"
+#include "userprog/uaccess.h"
 
 void syscall_entry (void);
 void syscall_handler (struct intr_frame *);
+uint64_t syscall_fast_handler (uint64_t a1, uint64_t a2, uint64_t a3,
+		uint64_t nr);
+static void syscall_init_fast (void);
 
 /* syscall functions */
 void halt (void);
 void exit (int status);
 bool create(const char *file, unsigned initial_size);
 bool remove(const char *file);
+int symlink(const char *target, const char *linkpath);
 int open(const char *file);
 int filesize(int fd);
 int read(int fd, void *buffer, unsigned size);
@@ -35,9 +64,50 @@ unsigned tell(int fd);
 void close(int fd);
 tid_t fork (const char *thread_name);
 int exec (const char *file_name);
+int wait (tid_t pid);
+tid_t waitany (int *status);
+int dup2 (int oldfd, int newfd);
+bool set_affinity (tid_t tid, uint64_t mask);
+static int *check_futex (int *uaddr);
+uint64_t get_affinity (tid_t tid);
+bool set_deadline (unsigned runtime, unsigned deadline, unsigned period);
+int sysctl (const char *name, size_t *oldval, const size_t *newval);
+void memstat (struct memstat *ms);
+bool diskstat (int disk, struct diskstat *ds);
+bool perf_read (struct perf_counts *pc);
+int getrusage (int who, struct rusage *ru);
+int readv (int fd, const struct iovec *iov, int iovcnt);
+int writev (int fd, const struct iovec *iov, int iovcnt);
+int pread (int fd, void *buffer, unsigned size, off_t offset);
+int pwrite (int fd, const void *buffer, unsigned size, off_t offset);
+int sendfile (int out_fd, int in_fd, off_t offset, unsigned size);
+int fallocate (int fd, off_t offset, off_t length);
+int fsync (int fd);
+int fdatasync (int fd);
+int getdents (int fd, void *buffer, unsigned size);
+int ring_enter (struct ring *ring);
+tid_t spawn (const char *file, char *const argv[]);
+tid_t vfork (void);
+int pipe (int *fds);
+static tid_t sys_thread_spawn (void *entry, void *arg, void *stack, void *tls,
+		int *tidp);
+static void sys_thread_exit (void);
+#ifdef VM
+void *mmap (void *addr, size_t length, int writable, int fd, off_t offset);
+void munmap (void *addr);
+int madvise (void *addr, size_t length, int advice);
+int mlock (void *addr, size_t length);
+int munlock (void *addr, size_t length);
+void vmstat (struct vmstat *thread, struct vmstat *system);
+void *shm_map (const char *name, void *addr, size_t length, int writable);
+static bool sys_shm_unlink (const char *name);
+void *sbrk (intptr_t increment);
+#endif
 
 /* syscall helper functions */
-void check_address(const uint64_t*);
+static void check_buffer(const void *buffer, size_t size, bool write);
+static bool copy_file_name(char *name, const char *file);
+static char *copy_spawn_args(const char *file, char *const argv[], size_t *len);
 static struct file *process_get_file(int fd);
 int process_add_file(struct file *file);
 void process_close_file(int fd);
@@ -58,9 +128,22 @@ const int STDOUT = 2;
 #define MSR_STAR 0xc0000081         /* Segment selector msr */
 #define MSR_LSTAR 0xc0000082        /* Long mode SYSCALL target */
 #define MSR_SYSCALL_MASK 0xc0000084 /* Mask for the eflags */
+#define MSR_GS_BASE 0xc0000101      /* GS base */
+#define MSR_KERNEL_GS_BASE 0xc0000102 /* GS base that swapgs swaps in */
 
+/* Per-CPU scratch of syscall_entry, which reaches it through GS
+ * after swapgs, so that entry needs no global temporaries. */
+struct syscall_scratch {
+	uint64_t user_rsp;          /* Offset 0: user rsp on the way in. */
+	void *kernel_rsp;           /* Offset 8: address of tss->rsp0. */
+};
+static struct syscall_scratch syscall_scratch[NCPU];
+
+/* Points this CPU's syscall instruction at syscall_entry.  Called
+ * by syscall_init() on the boot CPU and by smp.c on the others,
+ * after tss_init(). */
 void
-syscall_init (void) {
+syscall_init_cpu (void) {
 	write_msr(MSR_STAR, ((uint64_t)SEL_UCSEG - 0x10) << 48  |
 			((uint64_t)SEL_KCSEG) << 32);
 	write_msr(MSR_LSTAR, (uint64_t) syscall_entry);
@@ -70,122 +153,386 @@ syscall_init (void) {
 	 * mode stack. Therefore, we masked the FLAG_FL. */
 	write_msr(MSR_SYSCALL_MASK,
 			FLAG_IF | FLAG_TF | FLAG_DF | FLAG_IOPL | FLAG_AC | FLAG_NT);
-	/* LOCK INIT 추가*/
-	lock_init(&filesys_lock);
+
+	/* User programs never set GS, so the kernel may: syscall_entry
+	 * swaps this CPU's scratch in for a few instructions. */
+	syscall_scratch[this_cpu ()->id].kernel_rsp =
+		(uint8_t *) tss_get () + offsetof (struct task_state, rsp0);
+	write_msr(MSR_GS_BASE, 0);
+	write_msr(MSR_KERNEL_GS_BASE,
+			(uint64_t) &syscall_scratch[this_cpu ()->id]);
+}
+
+void
+syscall_init (void) {
+	syscall_init_cpu();
+	syscall_init_fast();
+	futex_init();
 }
 
 /* helper functions letsgo ! */
-void check_address(const uint64_t* addr){
-	struct thread *t = thread_current(); // 변경사항
-	/* 포인터가 가리키는 주소가 유저영역의 주소인지 확인 */
-	/* what if the user provides an invalid pointer, a pointer to kernel memory, 
-	 * or a block partially in one of those regions */
-	/* 잘못된 접근인 경우, 프로세스 종료 */
-	if (!is_user_vaddr(addr) || addr == NULL || pml4_get_page(t->pml4, addr) == NULL)
+/* 커널이 그대로 읽고 쓸 유저 버퍼 buffer의 size 바이트를 검사.
+ * 페이지마다 한 바이트씩 직접 접근해 보고, 잘못된 주소여서 fault가 나면
+ * 프로세스 종료. lazy page는 이때 올라옴 */
+static void check_buffer(const void *buffer, size_t size, bool write){
+	if (!user_probe(buffer, size, write))
 		exit(-1);
-} 
+}
 
-int process_add_file(struct file *f){
-	struct thread *curr = thread_current();
-	struct file **curr_fd_table = curr->file_descriptor_table;
-	for (int idx = curr->fdidx; idx < FDCOUNT_LIMIT; idx++){
-		if(curr_fd_table[idx] == NULL){
-			curr_fd_table[idx] = f;
-			curr->fdidx = idx; // fd의 최대값 + 1 // 논란있을듯???
-			return curr->fdidx;
+/* 유저 문자열 file을 커널 버퍼 name(NAME_MAX + 2 바이트)으로 복사.
+ * 잘못된 주소면 프로세스 종료, 파일 이름이 될 수 없을 만큼 길면 false */
+static bool copy_file_name(char *name, const char *file){
+	int len = strncpy_from_user(name, file, NAME_MAX + 2);
+
+	if (len < 0)
+		exit(-1);
+	return len < NAME_MAX + 2;
+}
+
+/* spawn의 file과 유저 배열 argv(NULL로 끝남)의 문자열을 한 페이지에
+ * NULL 문자까지 차례로 이어 붙임(process_spawn이 받는 모양). argv[0]은 관례대로
+ * 프로그램 이름이라 file로 대신함. 인자에 공백이 있어도 그대로 넘어감.
+ * 붙인 바이트 수를 *len에 넣음. 잘못된 주소면 프로세스 종료,
+ * 한 페이지를 넘거나 메모리가 없으면 NULL */
+static char *copy_spawn_args(const char *file, char *const argv[], size_t *len){
+	char *page = palloc_get_page(0);
+	const char *str = file;
+	size_t used = 0;
+
+	if (page == NULL)
+		return NULL;
+	for (int i = 1; str != NULL; i++) {
+		int n = strncpy_from_user(page + used, str, PGSIZE - used);
+
+		if (n < 0 || (size_t) n == PGSIZE - used) {
+			palloc_free_page(page);
+			if (n < 0)
+				exit(-1);
+			return NULL;
+		}
+		used += n + 1;
+		if (argv == NULL)
+			break;
+		if (!copy_from_user(&str, &argv[i], sizeof str)) {
+			palloc_free_page(page);
+			exit(-1);
 		}
 	}
-	curr->fdidx = FDCOUNT_LIMIT; // 이게 1 FAIL 의 원인
-	return -1;
+	*len = used;
+	return page;
 }
 
-struct file *process_get_file (int fd){
+/* p의 fd 테이블에 fd번 칸이 생길 때까지 크기를 두 배씩 늘림(FDCOUNT_LIMIT까지).
+ * 테이블과 bitmap을 한 덩어리로 새로 할당해서 옮김. 메모리가 없거나 한도를
+ * 넘으면 false */
+bool process_reserve_fd(struct process *p, int fd){
+	int cap = p->fd_cap;
+	struct file **fdt;
+
 	if (fd < 0 || fd >= FDCOUNT_LIMIT)
-		return NULL;
-	struct file *f = thread_current()->file_descriptor_table[fd];
-	return f;
+		return false;
+	if (fd < cap)
+		return true;
+	while (cap <= fd)
+		cap = cap * 2 < FDCOUNT_LIMIT ? cap * 2 : FDCOUNT_LIMIT;
+	fdt = calloc(1, FDT_BYTES(cap));
+	if (fdt == NULL)
+		return false;
+	memcpy(fdt, p->file_descriptor_table, p->fd_cap * sizeof *fdt);
+	memcpy(fdt + cap, p->fd_used, DIV_ROUND_UP(p->fd_cap, 64) * sizeof *p->fd_used);
+	free(p->file_descriptor_table);
+	p->file_descriptor_table = fdt;
+	p->fd_used = (uint64_t *) (fdt + cap);
+	p->fd_cap = cap;
+	return true;
 }
 
-/* revove the file(corresponding to fd) from the FDT of current process */
-void process_close_file(int fd){
-	if (fd < 0 || fd > FDCOUNT_LIMIT)
+/* p의 fd번 칸에 f를 넣음(NULL이면 비움). bitmap도 같이 맞춤 */
+void process_set_file(struct process *p, int fd, struct file *f){
+	uint64_t bit = (uint64_t) 1 << (fd % 64);
+
+	p->file_descriptor_table[fd] = f;
+	if (f != NULL)
+		p->fd_used[fd / 64] |= bit;
+	else
+		p->fd_used[fd / 64] &= ~bit;
+}
+
+/* 비어 있는 가장 작은 fd에 f를 넣고 그 fd를 반환. bitmap에서 word마다
+ * 처음 0인 비트를 찾으므로 열린 fd 수와 상관없이 빠름. 실패 시 -1 */
+int process_add_file(struct file *f){
+	struct process *p = thread_current()->process;
+	int words = DIV_ROUND_UP(p->fd_cap, 64);
+	int fd = p->fd_cap;
+
+	for (int i = 0; i < words; i++)
+		if (~p->fd_used[i] != 0) {
+			fd = i * 64 + __builtin_ctzll(~p->fd_used[i]);
+			break;
+		}
+	/* 테이블이 꽉 찼으면 늘림 */
+	if (!process_reserve_fd(p, fd))
+		return -1;
+	process_set_file(p, fd, f);
+	return fd;
+}
+
+struct file *process_get_file (int fd){
+	struct process *p = thread_current()->process;
+
+	if (fd < 0 || fd >= p->fd_cap)
 		return NULL;
-	thread_current()->file_descriptor_table[fd] = NULL;
+	return p->file_descriptor_table[fd];
 }
 
 void remove_file_from_fdt (int fd) {
-	struct thread *cur = thread_current();
+	struct process *p = thread_current()->process;
 
-	if (fd < 0 || fd >= FDCOUNT_LIMIT) {
+	if (fd < 0 || fd >= p->fd_cap) {
 		return;
 	}
-	cur->file_descriptor_table[fd] = NULL;
+	process_set_file(p, fd, NULL);
+}
+
+/* revove the file(corresponding to fd) from the FDT of current process */
+void process_close_file(int fd){
+	remove_file_from_fdt(fd);
 }
 
 /* helper functions gooooooooooood job */
 
-/* The main system call interface */
-void
-syscall_handler (struct intr_frame *f UNUSED) {
-	// TODO: Your implementation goes here.
-	int syscall_num = f->R.rax; // rax: system call number
-	switch(syscall_num){
-		case SYS_HALT:                   /* Halt the operating system. */
-			halt();
-			break;
-		case SYS_EXIT:                   /* Terminate this process. */
-			exit(f->R.rdi);
-			break;    
-		case SYS_FORK:   ;                /* Clone current process. */
-			struct thread *curr = thread_current();
-			memcpy(&curr->parent_if, f, sizeof(struct intr_frame));
-			f->R.rax = fork(f->R.rdi);
-			break;
-		case SYS_EXEC:                   /* Switch current process. */
-			if (exec(f->R.rdi) == -1)
-				exit(-1);
-			break;
-		case SYS_WAIT:                   /* Wait for a child process to die. */
-			f->R.rax = wait(f->R.rdi);
-			break;
-		case SYS_CREATE:                 /* Create a file. */
-			f->R.rax = create(f->R.rdi, f->R.rsi);
-			break;
-		case SYS_REMOVE:                 /* Delete a file. */
-			f->R.rax = remove(f->R.rdi);
-			break;
-		case SYS_OPEN:                   /* Open a file. */
-			f->R.rax = open(f->R.rdi);
-			break;
-		case SYS_FILESIZE:               /* Obtain a file's size. */
-			f->R.rax = filesize(f->R.rdi);
-			break;
-		case SYS_READ:                   /* Read from a file. */
-			f->R.rax = read(f->R.rdi, f->R.rsi, f->R.rdx);
-			break;
-		case SYS_WRITE:                  /* Write to a file. */
-			f->R.rax = write(f->R.rdi, f->R.rsi, f->R.rdx);
+/* 시스템 콜 표.
+ *
+ * 시스템 콜 번호마다 처리 함수, 인자 개수, 플래그를 둠. 인자는 rdi, rsi, rdx,
+ * r10, r8 순서로 처리 함수에 그대로 넘어가고, 반환값은 플래그의 SC_RET_*에
+ * 따라 rax에 넣음. 번호마다 호출 횟수와 걸린 TSC cycle을 세어 두었다가
+ * syscall_print_stats()에서 출력함 */
+
+#define SC_RET_VOID 1           /* 반환값 없음. rax는 그대로 */
+#define SC_RET_BOOL 2           /* bool 반환 */
+#define SC_RET_INT 3            /* int 반환, 64비트로 부호 확장 */
+#define SC_RET_UINT 4           /* unsigned 반환, 64비트로 0 확장 */
+#define SC_RET_MASK 7           /* 0이면 64비트 값(포인터 등) 그대로 */
+#define SC_SAVE_FRAME 8         /* 부르기 전에 intr_frame 주소를 syscall_if에 저장 */
+#define SC_FAST 16              /* intr_frame 없이 빠른 경로로 처리. 인자 3개까지,
+                                   유저 메모리를 건드리지 않는 것만 */
+#define SC_RING 32              /* ring_enter로 부를 수 있음. 인자 4개까지 */
+#define SC_IO_IN 64             /* 양수 반환값은 읽은 바이트 수. rusage에 셈 */
+#define SC_IO_OUT 128           /* 양수 반환값은 쓴 바이트 수. rusage에 셈 */
+
+struct syscall {
+	void (*func) (void);        /* 처리 함수. 실제 타입으로 바꿔 부름 */
+	int argc;                   /* 인자 개수 */
+	int flags;                  /* SC_* */
+	const char *name;           /* 통계에 찍을 이름 */
+};
+
+static void sys_exec (const char *file);
+static int sys_futex_wait (int *uaddr, int val);
+static int sys_futex_wake (int *uaddr, int n);
+
+#define SYSCALL(NR, FUNC, ARGC, FLAGS) \
+	[NR] = { (void (*) (void)) (FUNC), ARGC, FLAGS, #FUNC }
+
+static const struct syscall syscall_table[] = {
+	SYSCALL (SYS_HALT, halt, 0, SC_RET_VOID),
+	SYSCALL (SYS_EXIT, exit, 1, SC_RET_VOID),
+	SYSCALL (SYS_FORK, fork, 1, SC_RET_INT | SC_SAVE_FRAME),
+	SYSCALL (SYS_EXEC, sys_exec, 1, SC_RET_VOID),
+	SYSCALL (SYS_WAIT, wait, 1, SC_RET_INT),
+	SYSCALL (SYS_WAITANY, waitany, 1, SC_RET_INT),
+	SYSCALL (SYS_CREATE, create, 2, SC_RET_BOOL),
+	SYSCALL (SYS_REMOVE, remove, 1, SC_RET_BOOL),
+	SYSCALL (SYS_SYMLINK, symlink, 2, SC_RET_INT),
+	SYSCALL (SYS_OPEN, open, 1, SC_RET_INT),
+	SYSCALL (SYS_FILESIZE, filesize, 1, SC_RET_INT | SC_FAST | SC_RING),
+	SYSCALL (SYS_READ, read, 3, SC_RET_INT | SC_RING | SC_IO_IN),
+	SYSCALL (SYS_WRITE, write, 3, SC_RET_INT | SC_RING | SC_IO_OUT),
+	SYSCALL (SYS_SEEK, seek, 2, SC_RET_VOID | SC_FAST | SC_RING),
+	SYSCALL (SYS_TELL, tell, 1, SC_RET_UINT | SC_FAST | SC_RING),
+	SYSCALL (SYS_CLOSE, close, 1, SC_RET_VOID | SC_FAST | SC_RING),
+	SYSCALL (SYS_DUP2, dup2, 2, SC_RET_INT | SC_FAST),
+	SYSCALL (SYS_SET_AFFINITY, set_affinity, 2, SC_RET_BOOL | SC_FAST),
+	SYSCALL (SYS_GET_AFFINITY, get_affinity, 1, SC_FAST),
+	SYSCALL (SYS_SET_DEADLINE, set_deadline, 3, SC_RET_BOOL | SC_FAST),
+	SYSCALL (SYS_SYSCTL, sysctl, 3, SC_RET_INT),
+	SYSCALL (SYS_FUTEX_WAIT, sys_futex_wait, 2, SC_RET_INT),
+	SYSCALL (SYS_FUTEX_WAKE, sys_futex_wake, 2, SC_RET_INT),
+	SYSCALL (SYS_MEMSTAT, memstat, 1, SC_RET_VOID),
+	SYSCALL (SYS_DISKSTAT, diskstat, 2, SC_RET_BOOL),
+	SYSCALL (SYS_PERF_READ, perf_read, 1, SC_RET_BOOL),
+	SYSCALL (SYS_GETRUSAGE, getrusage, 2, SC_RET_INT),
+	SYSCALL (SYS_READV, readv, 3, SC_RET_INT | SC_RING | SC_IO_IN),
+	SYSCALL (SYS_WRITEV, writev, 3, SC_RET_INT | SC_RING | SC_IO_OUT),
+	SYSCALL (SYS_PREAD, pread, 4, SC_RET_INT | SC_RING | SC_IO_IN),
+	SYSCALL (SYS_PWRITE, pwrite, 4, SC_RET_INT | SC_RING | SC_IO_OUT),
+	SYSCALL (SYS_SENDFILE, sendfile, 4, SC_RET_INT | SC_RING | SC_IO_IN | SC_IO_OUT),
+	SYSCALL (SYS_FALLOCATE, fallocate, 3, SC_RET_INT | SC_FAST | SC_RING),
+	SYSCALL (SYS_FSYNC, fsync, 1, SC_RET_INT | SC_FAST | SC_RING),
+	SYSCALL (SYS_FDATASYNC, fdatasync, 1, SC_RET_INT | SC_FAST | SC_RING),
+	SYSCALL (SYS_GETDENTS, getdents, 3, SC_RET_INT),
+	SYSCALL (SYS_RING_ENTER, ring_enter, 1, SC_RET_INT),
+	SYSCALL (SYS_SPAWN, spawn, 2, SC_RET_INT),
+	SYSCALL (SYS_VFORK, vfork, 0, SC_RET_INT | SC_SAVE_FRAME),
+	SYSCALL (SYS_PIPE, pipe, 1, SC_RET_INT),
+	SYSCALL (SYS_THREAD_SPAWN, sys_thread_spawn, 5, SC_RET_INT),
+	SYSCALL (SYS_THREAD_EXIT, sys_thread_exit, 0, SC_RET_VOID),
+#ifdef VM
+	SYSCALL (SYS_MMAP, mmap, 5, 0),
+	SYSCALL (SYS_MUNMAP, munmap, 1, SC_RET_VOID),
+	SYSCALL (SYS_MADVISE, madvise, 3, SC_RET_INT),
+	SYSCALL (SYS_MLOCK, mlock, 2, SC_RET_INT),
+	SYSCALL (SYS_MUNLOCK, munlock, 2, SC_RET_INT),
+	SYSCALL (SYS_VMSTAT, vmstat, 2, SC_RET_VOID),
+	SYSCALL (SYS_SHM_MAP, shm_map, 4, 0),
+	SYSCALL (SYS_SHM_UNLINK, sys_shm_unlink, 1, SC_RET_BOOL),
+	SYSCALL (SYS_SBRK, sbrk, 1, 0),
+#endif
+};
+
+#define SYSCALL_CNT (sizeof syscall_table / sizeof *syscall_table)
+
+/* 번호별 호출 횟수와 cycle 합계. 여러 CPU에서 같이 더하므로 CPU마다 따로
+ * 세고 출력할 때 합침 */
+static struct syscall_stat {
+	struct percpu_counter calls;
+	struct percpu_counter cycles;
+} syscall_stats[SYSCALL_CNT];
+
+/* 빠른 경로로 처리할 시스템 콜 번호의 bitmap. syscall_entry가 읽음 */
+uint64_t syscall_fast_mask;
+
+/* 표에서 SC_FAST인 번호를 syscall_fast_mask에 모음 */
+static void
+syscall_init_fast (void) {
+	ASSERT (SYSCALL_CNT <= 64);
+	for (size_t i = 0; i < SYSCALL_CNT; i++)
+		if (syscall_table[i].flags & SC_FAST) {
+			ASSERT (syscall_table[i].argc <= 3);
+			syscall_fast_mask |= (uint64_t) 1 << i;
+		}
+}
+
+/* nr번 시스템 콜을 인자 a1...a5로 부르고 rax에 돌려줄 값을 반환.
+ * 반환값이 없는 시스템 콜이면 rax를 그대로 두도록 nr을 반환 */
+static uint64_t
+syscall_call (uint64_t nr, uint64_t a1, uint64_t a2, uint64_t a3,
+		uint64_t a4, uint64_t a5) {
+	const struct syscall *sc;
+	uint64_t start, ret = 0;
+
+	if (nr >= SYSCALL_CNT || syscall_table[nr].func == NULL)
+		exit(-1);
+	sc = &syscall_table[nr];
+	percpu_counter_inc(&syscall_stats[nr].calls);
+
+	start = rdtsc();
+	switch (sc->argc) {
+		case 0:
+			ret = ((uint64_t (*) (void)) sc->func) ();
 			break;
-		case SYS_SEEK:                   /* Change position in a file. */
-			seek(f->R.rdi, f->R.rsi);
+		case 1:
+			ret = ((uint64_t (*) (uint64_t)) sc->func) (a1);
 			break;
-		case SYS_TELL:                   /* Report current position in a file. */
-			f->R.rax = tell(f->R.rdi);
+		case 2:
+			ret = ((uint64_t (*) (uint64_t, uint64_t)) sc->func) (a1, a2);
 			break;
-		case SYS_CLOSE:					 /* Close a file. */
-			close(f->R.rdi);
+		case 3:
+			ret = ((uint64_t (*) (uint64_t, uint64_t, uint64_t)) sc->func) (
+					a1, a2, a3);
 			break;
-		case SYS_DUP2:
-			f->R.rax = dup2(f->R.rdi, f->R.rsi);
+		case 4:
+			ret = ((uint64_t (*) (uint64_t, uint64_t, uint64_t, uint64_t))
+					sc->func) (a1, a2, a3, a4);
 			break;
-		default:						 /* call thread_exit() ? */
-			exit(-1);
+		case 5:
+			ret = ((uint64_t (*) (uint64_t, uint64_t, uint64_t, uint64_t,
+							uint64_t)) sc->func) (a1, a2, a3, a4, a5);
 			break;
+		default:
+			NOT_REACHED();
 	}
+	percpu_counter_add(&syscall_stats[nr].cycles, rdtsc() - start);
+
+	if ((sc->flags & (SC_IO_IN | SC_IO_OUT)) && (int) ret > 0) {
+		struct rusage *ru = &thread_current()->rusage;
+
+		if (sc->flags & SC_IO_IN)
+			ru->bytes_read += (int) ret;
+		if (sc->flags & SC_IO_OUT)
+			ru->bytes_written += (int) ret;
+	}
+
+	switch (sc->flags & SC_RET_MASK) {
+		case SC_RET_VOID:
+			return nr;
+		case SC_RET_BOOL:
+			return (bool) ret;
+		case SC_RET_INT:
+			return (int) ret;
+		case SC_RET_UINT:
+			return (unsigned) ret;
+		default:
+			return ret;
+	}
+}
+
+/* syscall_entry의 빠른 경로. intr_frame 없이 인자 레지스터만 받아서
+ * 처리하고 rax에 넣을 값을 반환 */
+uint64_t
+syscall_fast_handler (uint64_t a1, uint64_t a2, uint64_t a3, uint64_t nr) {
+	uint64_t ret;
+
+	thread_enter_kernel();
+	ret = syscall_call(nr, a1, a2, a3, 0, 0);
+	process_check_exiting();
+	thread_leave_kernel();
+	return ret;
+}
+
+/* The main system call interface */
+void
+syscall_handler (struct intr_frame *f UNUSED) {
+	// TODO: Your implementation goes here.
+	uint64_t syscall_num = f->R.rax; // rax: system call number
+
+	thread_enter_kernel();
+#ifdef VM
+	/* 커널 안에서 난 page fault도 스택 확장 여부를 판단할 수 있도록 저장 */
+	thread_current()->user_rsp = f->rsp;
+#endif
+	if (syscall_num < SYSCALL_CNT
+			&& (syscall_table[syscall_num].flags & SC_SAVE_FRAME))
+		thread_current()->syscall_if = f;
+	TRACE (SYSCALL_ENTER, syscall_num);
+	f->R.rax = syscall_call(syscall_num, f->R.rdi, f->R.rsi, f->R.rdx,
+			f->R.r10, f->R.r8);
+	TRACE (SYSCALL_EXIT, f->R.rax);
+	process_check_exiting();
+	thread_leave_kernel();
 	// printf ("system call!\n");
 	// thread_exit ();
 }
 
+/* Prints the number of calls of each system call made so far and
+ * the cycles each took on average. */
+void
+syscall_print_stats (void) {
+	int64_t total = 0;
+
+	for (size_t i = 0; i < SYSCALL_CNT; i++)
+		total += percpu_counter_read(&syscall_stats[i].calls);
+	printf ("Syscalls: %lld calls\n", (long long) total);
+	for (size_t i = 0; i < SYSCALL_CNT; i++) {
+		int64_t calls = percpu_counter_read(&syscall_stats[i].calls);
+
+		if (calls > 0)
+			printf ("  %s: %lld calls, %lld cycles each\n",
+					syscall_table[i].name, (long long) calls,
+					(long long) (percpu_counter_read(&syscall_stats[i].cycles) / calls));
+	}
+}
+
 //변경사항 
 
 /* halt the operating system */ 
@@ -196,7 +543,17 @@ void halt(void){
 /* terminate this process */
 void exit(int status){
 	struct thread *curr = thread_current(); // 실행 중인 스레드 구조체 가져오기
+	struct process *p = curr->process;
+
 	curr->exit_status = status;
+	/* 프로세스 전체가 끝남. 다른 스레드는 유저 모드로 돌아가는 길에 끝나고,
+	   futex에서 자고 있으면 깨워서 그렇게 함 */
+	p->exit_status = status;
+	if (p->thread_cnt > 1 && !p->exiting) {
+		p->exiting = true;
+		futex_wake_all();
+	}
+	stdout_flush(); // 종료 메시지보다 먼저 나가도록
 	printf("%s: exit(%d)\n", thread_name(), status); // if status != 0, error
 	thread_exit(); // 스레드 종료
 }
@@ -205,19 +562,37 @@ void exit(int status){
 tid_t fork (const char *thread_name){
 	/* create new process, which is the clone of current process with the name THREAD_NAME*/
 	struct thread *curr = thread_current();
-	return process_fork(thread_name, &curr->parent_if);
+	char name[sizeof curr->name];
+	int len = strncpy_from_user(name, thread_name, sizeof name);
+
+	if (len < 0)
+		exit(-1);
+	/* 스레드 이름처럼 길면 잘라서 씀 */
+	name[sizeof name - 1] = '\0';
+	return process_fork(name, curr->syscall_if);
 	/* must return pid of the child process */
 }
 
 int exec (const char *file){
-	check_address(file);
-	int size = strlen(file) + 1;
-	char *fn_copy = palloc_get_page(PAL_ZERO);
-	
+	char *fn_copy = palloc_get_page(0);
+	int len;
+
 	if(fn_copy==NULL)
 		exit(-1);
+	/* 다른 스레드가 쓰고 있는 주소 공간은 바꿀 수 없음 */
+	if (thread_current()->process->thread_cnt > 1) {
+		palloc_free_page(fn_copy);
+		return -1;
+	}
 	//palloc 쓰는 이유 좀 더 고민해보기(아마 paging과 연관)
-	strlcpy(fn_copy, file, size);
+	/* 유저 메모리에서 바로 복사. 잘못된 주소면 종료, 한 페이지를 넘으면 실패 */
+	len = strncpy_from_user(fn_copy, file, PGSIZE);
+	if (len < 0 || len == PGSIZE) {
+		palloc_free_page(fn_copy);
+		if (len < 0)
+			exit(-1);
+		return -1;
+	}
 	if (process_exec(fn_copy) == -1)
 		return -1;
 
@@ -225,33 +600,139 @@ int exec (const char *file){
 	return 0;
 }
 
+/* exec이 돌아왔다면 실패한 것. 이미 주소 공간이 없어졌을 수 있으므로 종료 */
+static void sys_exec (const char *file){
+	exec(file);
+	exit(-1);
+}
+
+/* FILE을 argv의 인자로 실행하는 자식을 바로 만듦. fork처럼 주소 공간을
+   복사하지 않고 fd만 물려줌. 자식의 pid, 실패하면 -1 */
+tid_t spawn (const char *file, char *const argv[]){
+	size_t len;
+	char *args = copy_spawn_args(file, argv, &len);
+
+	if (args == NULL)
+		return -1;
+	return process_spawn(args, len);
+}
+
+/* exec나 exit할 때까지 부모의 주소 공간에서 도는 자식을 만듦.
+   VM에서는 fork가 이미 copy-on-write이므로 fork와 같음 */
+tid_t vfork (void){
+	struct thread *curr = thread_current();
+
+#ifdef VM
+	return process_fork(curr->name, curr->syscall_if);
+#else
+	return process_vfork(curr->name, curr->syscall_if);
+#endif
+}
+
+/* 현재 프로세스에 스레드를 하나 더 만듦. ENTRY에서 rdi에 ARG를 받고 STACK을
+   rsp로, TLS를 FS base로 해서 시작하고, 주소 공간과 fd는 다른 스레드와 같이 씀.
+   TIDP가 NULL이 아니면 시작 전에 tid를 써 두고, 끝날 때 0을 쓴 뒤 futex로
+   깨우므로 thread_join()은 그 word가 0이 될 때까지 futex_wait하면 됨.
+   새 스레드의 tid, 실패하면 -1 */
+static tid_t sys_thread_spawn (void *entry, void *arg, void *stack,
+		void *tls, int *tidp){
+	if (!is_user_vaddr(entry) || !is_user_vaddr(stack) || !is_user_vaddr(tls))
+		return -1;
+	if (tidp != NULL)
+		check_futex(tidp);
+	return process_thread_spawn(entry, arg, stack, tls, tidp);
+}
+
+/* 현재 스레드만 끝냄. 마지막 스레드였으면 exit(0)과 같음 */
+static void sys_thread_exit (void){
+	if (thread_current()->process->thread_cnt == 1)
+		exit(0);
+	thread_exit();
+}
+
+/* 파이프를 만들어 읽는 쪽 fd를 fds[0]에, 쓰는 쪽 fd를 fds[1]에 넣음.
+   양쪽 다 보통 파일처럼 read, write, close, dup2하고 fork로 물려줌.
+   성공 시 0, 실패 시 -1 */
+int pipe (int *fds){
+	struct file *r, *w;
+	int pair[2];
+
+	check_buffer(fds, sizeof pair, true);
+	if (!file_open_pipe(&r, &w))
+		return -1;
+	pair[0] = process_add_file(r);
+	pair[1] = pair[0] != -1 ? process_add_file(w) : -1;
+	if (pair[1] == -1 || !copy_to_user(fds, pair, sizeof pair)) {
+		if (pair[0] != -1)
+			remove_file_from_fdt(pair[0]);
+		if (pair[1] != -1)
+			remove_file_from_fdt(pair[1]);
+		file_close(r);
+		file_close(w);
+		return -1;
+	}
+	return 0;
+}
+
 /* Wait for a child process to die. */
 int wait(tid_t pid){
-	process_wait(pid);
+	return process_wait(pid);
+}
+
+/* Wait for whichever child dies first. */
+tid_t waitany(int *status){
+	int exit_status;
+	tid_t tid = process_waitany(&exit_status);
+
+	// 기록은 이미 거뒀으므로 잘못된 주소면 프로세스를 끝냄
+	if (tid != -1 && status != NULL
+			&& !copy_to_user(status, &exit_status, sizeof exit_status))
+		exit(-1);
+	return tid;
 }
 
  /* Create a file. */
 bool create(const char *file, unsigned initial_size){
-	check_address(file); // 포인터가 가리키는 주소가 유저영역의 주소인지 확인
-	return filesys_create(file, initial_size); // 파일 이름 & 크기에 해당하는 파일 생성
+	char name[NAME_MAX + 2];
+
+	if (!copy_file_name(name, file)) // 포인터가 가리키는 주소가 유저영역의 주소인지 확인
+		return false;
+	return filesys_create(name, initial_size); // 파일 이름 & 크기에 해당하는 파일 생성
 }
 
  /* Delete a file. */
 bool remove(const char *file){
-	check_address(file); // 포인터가 가리키는 주소가 유저영역의 주소인지 확인
-	return filesys_remove(file); // 파일 이름에 해당하는 파일을 제거
+	char name[NAME_MAX + 2];
+
+	if (!copy_file_name(name, file)) // 포인터가 가리키는 주소가 유저영역의 주소인지 확인
+		return false;
+	return filesys_remove(name); // 파일 이름에 해당하는 파일을 제거
+}
+
+/* target을 가리키는 심볼릭 링크 linkpath를 만듦. 성공하면 0, 실패하면 -1 */
+int symlink(const char *target, const char *linkpath){
+	char path[SYMLINK_MAX + 1];
+	char name[NAME_MAX + 2];
+	int len = strncpy_from_user(path, target, sizeof path);
+
+	if (len < 0)
+		exit(-1);
+	if (len >= (int) sizeof path || !copy_file_name(name, linkpath))
+		return -1;
+	return filesys_symlink(path, name) ? 0 : -1;
 }
 
 int open (const char *file){
-	check_address(file);
-	lock_acquire(&filesys_lock);
-	struct file *f = filesys_open(file); // 파일을 오픈
+	char name[NAME_MAX + 2];
+
+	if (!copy_file_name(name, file))
+		return -1;
+	struct file *f = filesys_open(name); // 파일을 오픈
 	if (f == NULL)
 		return -1;
 	int fd = process_add_file(f);
 	if (fd == -1)
 		file_close(f);
-	lock_release(&filesys_lock);
 	return fd;
 }
 
@@ -290,7 +771,7 @@ int filesize (int fd){
 // }
 
 int read (int fd, void *buffer, unsigned size){
-	check_address(buffer);
+	check_buffer(buffer, size, true);
 	unsigned char *buf = buffer;
 	int readsize;
 	struct file *f = process_get_file(fd);
@@ -308,31 +789,39 @@ int read (int fd, void *buffer, unsigned size){
 		// 	if (c == '\0')
 		// 		break;
 		// }
-		if (cur->stdin_count == 0){ // stdin_count가 비정상적인 경우
+		if (cur->process->stdin_count == 0){ // stdin_count가 비정상적인 경우
 			NOT_REACHED();
 			process_close_file(fd);
 			readsize = -1;
 		}
 		else {
-			int i;
-			unsigned char *buf = buffer;
-			for (i = 0; i < size; i++){
-				char c = input_getc();
-				*buf++ = c;
-				if (c == '\0'){
-					break;
-				}
-			}
-			readsize = i;
+			/* 입력 큐에 있는 만큼 한 번에 가져오고, 비어 있으면 1바이트가 올 때까지
+			 * 기다림. 인터럽트를 끈 채로 유저 버퍼에서 page fault가 나지 않도록
+			 * 커널 버퍼에 받은 다음 복사 */
+			uint8_t keys[INTQ_BUFSIZE];
+			size_t n;
+
+			stdout_flush(); // 입력을 기다리기 전에 프롬프트부터 내보냄
+			n = input_read(keys, size < sizeof keys ? size : sizeof keys);
+
+			if (!copy_to_user(buffer, keys, n))
+				exit(-1);
+			readsize = n;
 		}
 	}
 	else if (f == STDOUT) { // read에서 입출력 fd일 경우 -1 리턴
 		readsize = -1;
 	}
 	else{
-		lock_acquire(&filesys_lock); // 파일에 동시접근 일어날 수 있으므로 lock 사용
-		readsize = file_read(f, buffer, size);
-		lock_release(&filesys_lock);
+#ifdef VM
+		/* 버퍼 전체를 검사하고 복사 도중 evict되지 않도록 고정 */
+		if (!vm_pin_buffer(buffer, size, true))
+			exit(-1);
+#endif
+		readsize = file_read(f, buffer, size); // 동시접근은 inode의 lock이 막아줌
+#ifdef VM
+		vm_unpin_buffer(buffer, size);
+#endif
 	}
 	return readsize;
 
@@ -358,8 +847,56 @@ int read (int fd, void *buffer, unsigned size){
 // 	return writesize;
 // }
 
+/* 표준 출력 줄 버퍼의 크기. 줄바꿈이 들어오거나 버퍼가 차거나
+ * 프로세스가 끝날 때 putbuf() 한 번으로 내보냄 */
+#define STDOUT_BUF_SIZE 256
+
+/* 현재 프로세스의 표준 출력 버퍼를 비움 */
+void stdout_flush (void) {
+	struct thread *cur = thread_current();
+
+	if (cur->stdout_len > 0) {
+		putbuf(cur->stdout_buf, cur->stdout_len);
+		cur->stdout_len = 0;
+	}
+}
+
+/* 유저 buffer의 size바이트를 표준 출력 버퍼에 모음.
+ * 버퍼를 못 만들면 예전처럼 바로 출력 */
+static void stdout_write (const void *buffer, unsigned size) {
+	struct thread *cur = thread_current();
+	const char *src = buffer;
+	bool newline = false;
+
+	if (cur->stdout_buf == NULL)
+		cur->stdout_buf = malloc(STDOUT_BUF_SIZE);
+	if (cur->stdout_buf == NULL) {
+		putbuf(buffer, size);
+		return;
+	}
+
+	while (size > 0) {
+		char *dst = cur->stdout_buf + cur->stdout_len;
+		size_t chunk = STDOUT_BUF_SIZE - cur->stdout_len;
+
+		if (chunk > size)
+			chunk = size;
+		if (!copy_from_user(dst, src, chunk))
+			exit(-1);
+		if (memchr(dst, '\n', chunk) != NULL)
+			newline = true;
+		cur->stdout_len += chunk;
+		src += chunk;
+		size -= chunk;
+		if (cur->stdout_len == STDOUT_BUF_SIZE)
+			stdout_flush();
+	}
+	if (newline)
+		stdout_flush();
+}
+
 int write(int fd, const void *buffer, unsigned size) {
-	check_address(buffer);
+	check_buffer(buffer, size, false);
 	int write_result;
 	struct file *file_fd = process_get_file(fd);
 
@@ -370,13 +907,13 @@ int write(int fd, const void *buffer, unsigned size) {
 	struct thread *cur = thread_current();
 
 	if (file_fd == STDOUT) {
-		if (cur->stdout_count == 0){
+		if (cur->process->stdout_count == 0){
 			NOT_REACHED();
 			remove_file_from_fdt(fd);
 			write_result = -1;
 		}
 		else {
-			putbuf(buffer, size);
+			stdout_write(buffer, size);
 			write_result = size;
 		}
 	}
@@ -384,9 +921,14 @@ int write(int fd, const void *buffer, unsigned size) {
 		write_result = -1;
 	}
 	else {
-		lock_acquire(&filesys_lock); // 파일에 동시접근 일어날 수 있으므로 lock 사용
-		write_result = file_write(file_fd, buffer, size);
-		lock_release(&filesys_lock);
+#ifdef VM
+		if (!vm_pin_buffer(buffer, size, false))
+			exit(-1);
+#endif
+		write_result = file_write(file_fd, buffer, size); // 동시접근은 inode의 lock이 막아줌
+#ifdef VM
+		vm_unpin_buffer(buffer, size);
+#endif
 	}
 	return write_result;
 }
@@ -426,26 +968,21 @@ void close(int fd)  {
 	struct thread *cur = thread_current();
 
 	if (fd == 0 || close_file == STDIN) {
-		cur -> stdin_count--;
+		cur->process->stdin_count--;
 	}
 	else if (fd == 1 || close_file == STDOUT) {
 
-		cur -> stdout_count--;
+		cur->process->stdout_count--;
 	}
 
 	remove_file_from_fdt(fd);
 
-	if (fd <= 1 || close_file <= 2){
+	if (close_file == STDIN || close_file == STDOUT){
 		return;
 	}
 
-	if (close_file -> dup_count == 0){
-		file_close(close_file);
-	}
-	else {
-		close_file->dup_count--;
-	}
-
+	/* 다른 fd나 자식 프로세스가 같이 쓰고 있으면 참조만 하나 줄어듦 */
+	file_close(close_file);
 }
 
 /* 기존의 파일 디스크립터 oldfd를 새로운 newfd로 복제하여 생성 */
@@ -461,20 +998,556 @@ int dup2(int oldfd, int newfd) {
 	}
 
 	struct thread *cur = thread_current();
-	struct file **fdt = cur->file_descriptor_table;
+
+	/* newfd 칸이 생기도록 테이블을 먼저 늘림 */
+	if (!process_reserve_fd(cur->process, newfd))
+		return -1;
 
 	if (file_fd == STDIN){
-		cur->stdin_count++;
+		cur->process->stdin_count++;
 	}
 	else if (file_fd == STDOUT){
-		cur->stdout_count++;
+		cur->process->stdout_count++;
 	}
 	else {
-		file_fd->dup_count++;
+		file_dup(file_fd);	// 같은 open file을 공유하므로 위치도 같이 움직임
 	}
 
 	close(newfd);
-	fdt[newfd] = file_fd;
+	process_set_file(cur->process, newfd, file_fd);
 	return newfd;
  
-}
\ No newline at end of file
+}
+
+/* A process may only change or query the CPU affinity of itself
+   and of its direct children. */
+static bool
+affinity_allowed (tid_t tid) {
+	struct child_status *child;
+
+	if (tid == thread_current ()->tid)
+		return true;
+	child = get_child (tid);
+	if (child == NULL)
+		return false;
+	child_status_release (child);
+	return true;
+}
+
+/* tid 프로세스가 mask에 표시된 CPU에서만 실행되도록 제한 */
+bool set_affinity (tid_t tid, uint64_t mask) {
+	if (!affinity_allowed (tid))
+		return false;
+	return thread_set_affinity (tid, mask);
+}
+
+/* tid 프로세스의 CPU affinity mask를 반환. 실패 시 0 */
+uint64_t get_affinity (tid_t tid) {
+	if (!affinity_allowed (tid))
+		return 0;
+	return thread_get_affinity (tid);
+}
+
+/* 밀리초를 timer tick으로. 모자라지 않게 올림 */
+static int64_t ms_to_ticks (unsigned ms) {
+	return ((int64_t) ms * TIMER_FREQ + 999) / 1000;
+}
+
+/* 이 스레드가 period ms마다, 주기 시작 후 deadline ms 안에 runtime ms씩
+   CPU를 쓰도록 예약. runtime이 0이면 예약 해제. 과부하면 false */
+bool set_deadline (unsigned runtime, unsigned deadline, unsigned period) {
+	return thread_set_deadline (ms_to_ticks (runtime), ms_to_ticks (deadline),
+			ms_to_ticks (period));
+}
+
+/* 이름이 name인 튜너블의 값을 oldval이 NULL이 아니면 거기에 넣고,
+   newval이 NULL이 아니면 그 값으로 바꿈. 성공하면 0,
+   없는 이름이거나 범위를 벗어난 값이면 아무것도 바꾸지 않고 -1 */
+int sysctl (const char *name, size_t *oldval, const size_t *newval) {
+	char key[TUNABLE_NAME_MAX + 1];
+	size_t old, new;
+	int len = strncpy_from_user (key, name, sizeof key);
+
+	if (len < 0)
+		exit (-1);
+	if (newval != NULL && !copy_from_user (&new, newval, sizeof new))
+		exit (-1);
+	if (len >= (int) sizeof key || !tunable_get (key, &old))
+		return -1;
+	if (newval != NULL && !tunable_set (key, new))
+		return -1;
+	if (oldval != NULL && !copy_to_user (oldval, &old, sizeof old))
+		exit (-1);
+	return 0;
+}
+
+/* futex word는 정렬된 유저 주소여야 함. 아니면 프로세스 종료 */
+static int *check_futex (int *uaddr) {
+	if ((uintptr_t) uaddr % sizeof *uaddr != 0)
+		exit(-1);
+	check_buffer(uaddr, sizeof *uaddr, false);
+	return uaddr;
+}
+
+/* futex_wait과 futex_wake는 futex word를 검사한 다음 부름 */
+static int sys_futex_wait (int *uaddr, int val) {
+	return futex_wait(check_futex(uaddr), val);
+}
+
+static int sys_futex_wake (int *uaddr, int n) {
+	return futex_wake(check_futex(uaddr), n);
+}
+
+/* 커널 메모리 사용량을 유저 버퍼 ms에 채워서 반환 */
+void memstat (struct memstat *ms) {
+	struct memstat stats;
+
+	/* 인터럽트를 끈 채 유저 메모리에 쓰지 않도록 먼저 커널에 모아 둠 */
+	palloc_get_stats(&stats);
+	malloc_get_stats(&stats);
+	if (!copy_to_user(ms, &stats, sizeof stats))
+		exit(-1);
+}
+
+/* disk번(채널 * 2 + 장치 번호) 디스크의 I/O 통계를 유저 버퍼 ds에 채움.
+ * 그런 디스크가 없으면 false */
+bool diskstat (int disk, struct diskstat *ds) {
+	struct diskstat stats;
+	struct disk *d;
+
+	if (disk < 0 || disk >= 4 || (d = disk_get(disk / 2, disk % 2)) == NULL) {
+		/* 없는 디스크여도 잘못된 버퍼면 종료 */
+		check_buffer(ds, sizeof *ds, true);
+		return false;
+	}
+
+	/* 인터럽트를 끈 채 유저 메모리에 쓰지 않도록 먼저 복사해 둠 */
+	disk_get_stats(d, &stats);
+	if (!copy_to_user(ds, &stats, sizeof stats))
+		exit(-1);
+	return true;
+}
+
+/* 현재 스레드가 지금까지 일으킨 하드웨어 이벤트 수를 유저 버퍼 pc에 채움.
+ * 셀 수 있는 카운터가 하나도 없으면 false */
+bool perf_read (struct perf_counts *pc) {
+	struct perf_counts counts;
+
+	/* 인터럽트를 끈 채 유저 메모리에 쓰지 않도록 먼저 커널에 모아 둠 */
+	pmu_read(&counts);
+	if (!copy_to_user(pc, &counts, sizeof counts))
+		exit(-1);
+	return counts.valid != 0;
+}
+
+/* who가 RUSAGE_SELF면 현재 프로세스가, RUSAGE_CHILDREN이면 wait으로 거둔
+ * 자식들이 쓴 자원을 유저 버퍼 ru에 채움. 성공 시 0, who가 잘못되면 -1 */
+int getrusage (int who, struct rusage *ru) {
+	struct rusage usage;
+
+	if (who != RUSAGE_SELF && who != RUSAGE_CHILDREN) {
+		check_buffer(ru, sizeof *ru, true);
+		return -1;
+	}
+
+	/* 인터럽트를 끈 채 유저 메모리에 쓰지 않도록 먼저 커널에 모아 둠 */
+	thread_get_rusage(&usage, who == RUSAGE_CHILDREN);
+	if (!copy_to_user(ru, &usage, sizeof usage))
+		exit(-1);
+	return 0;
+}
+
+/* 유저의 iovec 배열 iov를 커널의 vec으로 복사하고 각 버퍼 주소를 검사.
+ * iovcnt가 범위를 벗어나거나 전체 길이가 int를 넘으면 false */
+static bool copy_iovec (struct iovec *vec, const struct iovec *iov, int iovcnt, bool write) {
+	size_t total = 0;
+
+	if (iovcnt < 0 || iovcnt > IOV_MAX)
+		return false;
+	if (iovcnt == 0)
+		return true;
+	if (!copy_from_user(vec, iov, iovcnt * sizeof *iov))
+		exit(-1);
+	for (int i = 0; i < iovcnt; i++) {
+		if (vec[i].iov_len > INT_MAX - total)
+			return false;
+		total += vec[i].iov_len;
+		check_buffer(vec[i].iov_base, vec[i].iov_len, write);
+	}
+	return true;
+}
+
+/* vec의 앞쪽 cnt개 버퍼를 고정. 하나라도 실패하면 프로세스 종료 */
+static void pin_iovec (const struct iovec *vec UNUSED, int cnt UNUSED, bool write UNUSED) {
+#ifdef VM
+	for (int i = 0; i < cnt; i++)
+		if (!vm_pin_buffer(vec[i].iov_base, vec[i].iov_len, write)) {
+			while (i-- > 0)
+				vm_unpin_buffer(vec[i].iov_base, vec[i].iov_len);
+			exit(-1);
+		}
+#endif
+}
+
+/* pin_iovec으로 고정한 버퍼들을 다시 풀어줌 */
+static void unpin_iovec (const struct iovec *vec UNUSED, int cnt UNUSED) {
+#ifdef VM
+	for (int i = 0; i < cnt; i++)
+		vm_unpin_buffer(vec[i].iov_base, vec[i].iov_len);
+#endif
+}
+
+/* fd에서 iov의 iovcnt개 버퍼로 차례로 읽음. 파일이면 한 번의 읽기로 처리해서
+ * inode lock과 위치 갱신도 한 번뿐. 읽은 바이트 수, 실패 시 -1 */
+int readv (int fd, const struct iovec *iov, int iovcnt) {
+	struct iovec vec[IOV_MAX];
+	struct file *f = process_get_file(fd);
+	int total = 0;
+
+	if (!copy_iovec(vec, iov, iovcnt, true) || f == NULL || f == STDOUT)
+		return -1;
+
+	/* 콘솔은 버퍼마다 read()로 */
+	if (f == STDIN) {
+		for (int i = 0; i < iovcnt; i++) {
+			int n = read(fd, vec[i].iov_base, vec[i].iov_len);
+
+			if (n < 0)
+				return -1;
+			total += n;
+			if ((size_t) n < vec[i].iov_len)
+				break;
+		}
+		return total;
+	}
+
+	pin_iovec(vec, iovcnt, true);
+	total = file_readv(f, vec, iovcnt);
+	unpin_iovec(vec, iovcnt);
+	return total;
+}
+
+/* iov의 iovcnt개 버퍼를 차례로 fd에 씀. 파일이면 한 번의 쓰기로 처리.
+ * 쓴 바이트 수, 실패 시 -1 */
+int writev (int fd, const struct iovec *iov, int iovcnt) {
+	struct iovec vec[IOV_MAX];
+	struct file *f = process_get_file(fd);
+	int total = 0;
+
+	if (!copy_iovec(vec, iov, iovcnt, false) || f == NULL || f == STDIN)
+		return -1;
+
+	/* 콘솔은 버퍼마다 write()로 */
+	if (f == STDOUT) {
+		for (int i = 0; i < iovcnt; i++) {
+			int n = write(fd, vec[i].iov_base, vec[i].iov_len);
+
+			if (n < 0)
+				return -1;
+			total += n;
+		}
+		return total;
+	}
+
+	pin_iovec(vec, iovcnt, false);
+	total = file_writev(f, vec, iovcnt);
+	unpin_iovec(vec, iovcnt);
+	return total;
+}
+
+/* fd 파일의 offset 위치부터 size 바이트를 읽음. file->pos는 건드리지 않으므로
+ * 같은 fd를 여러 스레드가 seek 없이 동시에 쓸 수 있음. 콘솔은 -1 */
+int pread (int fd, void *buffer, unsigned size, off_t offset) {
+	struct file *f = process_get_file(fd);
+	int readsize;
+
+	check_buffer(buffer, size, true);
+	if (f == NULL || (uintptr_t) f <= (uintptr_t) STDOUT || offset < 0)
+		return -1;
+#ifdef VM
+	if (!vm_pin_buffer(buffer, size, true))
+		exit(-1);
+#endif
+	readsize = file_read_at(f, buffer, size, offset);
+#ifdef VM
+	vm_unpin_buffer(buffer, size);
+#endif
+	return readsize;
+}
+
+/* buffer의 size 바이트를 fd 파일의 offset 위치에 씀. file->pos는 그대로. 콘솔은 -1 */
+int pwrite (int fd, const void *buffer, unsigned size, off_t offset) {
+	struct file *f = process_get_file(fd);
+	int writesize;
+
+	check_buffer(buffer, size, false);
+	if (f == NULL || (uintptr_t) f <= (uintptr_t) STDOUT || offset < 0)
+		return -1;
+#ifdef VM
+	if (!vm_pin_buffer(buffer, size, false))
+		exit(-1);
+#endif
+	writesize = file_write_at(f, buffer, size, offset);
+#ifdef VM
+	vm_unpin_buffer(buffer, size);
+#endif
+	return writesize;
+}
+
+/* sendfile이 한 번에 옮기는 최대 크기(페이지 수). 통째로 읽히는 섹터가 많을수록
+ * 디스크 명령 수가 줄어듦 */
+#define SENDFILE_PAGES 8
+
+/* in_fd 파일의 offset 위치부터 size 바이트를 out_fd로 복사. offset이 -1이면
+ * in_fd의 현재 위치부터 읽고 위치를 옮김. 데이터는 커널 버퍼를 거쳐 buffer cache
+ * 사이에서만 오가므로 유저 메모리 복사가 없음. 복사한 바이트 수, 실패 시 -1 */
+int sendfile (int out_fd, int in_fd, off_t offset, unsigned size) {
+	struct file *in = process_get_file(in_fd);
+	struct file *out = process_get_file(out_fd);
+	size_t page_cnt = SENDFILE_PAGES;
+	uint8_t *buf;
+	int total = 0;
+
+	if (in == NULL || (uintptr_t) in <= (uintptr_t) STDOUT
+			|| out == NULL || out == STDIN || offset < -1)
+		return -1;
+	if (size > INT_MAX)
+		size = INT_MAX;
+
+	/* 큰 버퍼를 못 얻으면 한 페이지로 */
+	buf = palloc_get_multiple(0, page_cnt);
+	if (buf == NULL) {
+		page_cnt = 1;
+		buf = palloc_get_page(0);
+		if (buf == NULL)
+			return -1;
+	}
+
+	while (size > 0) {
+		off_t chunk = size < page_cnt * PGSIZE ? size : page_cnt * PGSIZE;
+		off_t n, written;
+
+		if (offset == -1)
+			n = file_read(in, buf, chunk);
+		else
+			n = file_read_at(in, buf, chunk, offset + total);
+		if (n <= 0)
+			break;
+		if (out == STDOUT) {
+			stdout_flush();
+			putbuf((const char *) buf, n);
+			written = n;
+		} else
+			written = file_write(out, buf, n);
+		if (written < 0)
+			written = 0;
+		total += written;
+		size -= written;
+		if (written < n) {
+			/* 못 쓴 만큼은 읽지 않은 것으로 */
+			if (offset == -1)
+				file_seek(in, file_tell(in) - (n - written));
+			break;
+		}
+	}
+	palloc_free_multiple(buf, page_cnt);
+	return total;
+}
+
+/* fd 파일의 offset부터 length 바이트에 쓸 디스크 공간을 미리 연속으로 잡아둠.
+ * 파일이 짧으면 offset + length까지 늘어나고, 늘어난 부분은 쓰기 전까지 0으로
+ * 읽힘(디스크 I/O 없음). 그 범위의 hole도 채움. 성공 시 0, 실패 시 -1 */
+int fallocate (int fd, off_t offset, off_t length) {
+	struct file *f = process_get_file(fd);
+
+	if (f == NULL || (uintptr_t) f <= (uintptr_t) STDOUT
+			|| offset < 0 || length <= 0 || offset > INT_MAX - length)
+		return -1;
+	return file_reserve(f, offset, length) ? 0 : -1;
+}
+
+/* fd 파일에 쓴 내용을 디스크에 기록하고 돌아옴. 그 파일의 dirty 섹터만 쓰고,
+ * inode와 free map 같은 메타데이터는 journal commit으로 보장. 성공 시 0, 실패 시 -1 */
+int fsync (int fd) {
+	struct file *f = process_get_file(fd);
+
+	if (f == NULL || (uintptr_t) f <= (uintptr_t) STDOUT)
+		return -1;
+	file_sync(f, false);
+	return 0;
+}
+
+/* fsync와 같지만 inode가 바뀌지 않았으면 commit을 생략함 (제자리 덮어쓰기) */
+int fdatasync (int fd) {
+	struct file *f = process_get_file(fd);
+
+	if (f == NULL || (uintptr_t) f <= (uintptr_t) STDOUT)
+		return -1;
+	file_sync(f, true);
+	return 0;
+}
+
+/* 디렉터리 fd의 다음 엔트리들을 buffer에 struct dirent로 size 바이트까지 채움.
+ * 디렉터리를 섹터 단위로 읽으므로 한 번에 여러 엔트리를 가져옴.
+ * 채운 바이트 수를 돌려주고 끝이면 0, 디렉터리가 아니면 -1 */
+int getdents (int fd, void *buffer, unsigned size) {
+	struct file *f = process_get_file(fd);
+	struct dir *dir;
+	size_t cnt;
+
+	check_buffer(buffer, size, true);
+	if (f == NULL || (uintptr_t) f <= (uintptr_t) STDOUT || !file_is_dir(f)
+			|| size < sizeof (struct dirent))
+		return -1;
+	dir = dir_open(inode_reopen(file_get_inode(f)));
+	if (dir == NULL)
+		return -1;
+#ifdef VM
+	if (!vm_pin_buffer(buffer, size, true))
+		exit(-1);
+#endif
+	/* 읽던 위치는 file의 pos에 둠 */
+	dir_seek(dir, file_tell(f));
+	cnt = dir_readdir_multiple(dir, buffer, size / sizeof (struct dirent));
+	file_seek(f, dir_tell(dir));
+#ifdef VM
+	vm_unpin_buffer(buffer, size);
+#endif
+	dir_close(dir);
+	return cnt * sizeof (struct dirent);
+}
+
+/* ring의 제출 큐에 쌓인 시스템 콜을 차례로 부르고 결과를 완료 큐에 넣음.
+ * 완료 큐에 자리가 있는 만큼만 처리하고, 제출 큐의 head와 완료 큐의 tail은
+ * 마지막에 한 번만 씀. 처리한 개수, ring이 망가졌으면 -1 */
+int ring_enter (struct ring *ring) {
+	uint32_t idx[4];            /* sq_head, sq_tail, cq_head, cq_tail */
+	int done = 0;
+
+	if (!copy_from_user(idx, ring, sizeof idx))
+		exit(-1);
+	if (idx[1] - idx[0] > RING_ENTRIES || idx[3] - idx[2] > RING_ENTRIES)
+		return -1;
+
+	while (idx[0] != idx[1] && idx[3] - idx[2] < RING_ENTRIES) {
+		struct ring_sqe sqe;
+		struct ring_cqe cqe;
+
+		if (!copy_from_user(&sqe, &ring->sq[idx[0] % RING_ENTRIES], sizeof sqe))
+			exit(-1);
+		cqe.user_data = sqe.user_data;
+		if (sqe.opcode >= SYSCALL_CNT
+				|| !(syscall_table[sqe.opcode].flags & SC_RING))
+			cqe.result = -1;
+		else {
+			cqe.result = syscall_call(sqe.opcode, sqe.args[0], sqe.args[1],
+					sqe.args[2], sqe.args[3], 0);
+			if ((syscall_table[sqe.opcode].flags & SC_RET_MASK) == SC_RET_VOID)
+				cqe.result = 0;
+		}
+		if (!copy_to_user(&ring->cq[idx[3] % RING_ENTRIES], &cqe, sizeof cqe))
+			exit(-1);
+		idx[0]++;
+		idx[3]++;
+		done++;
+	}
+
+	if (!copy_to_user(&ring->sq_head, &idx[0], sizeof idx[0])
+			|| !copy_to_user(&ring->cq_tail, &idx[3], sizeof idx[3]))
+		exit(-1);
+	return done;
+}
+
+#ifdef VM
+/* fd의 파일을 addr부터 length 바이트만큼 메모리에 매핑. 실패 시 NULL */
+void *mmap (void *addr, size_t length, int writable, int fd, off_t offset) {
+	struct file *f = process_get_file(fd);
+
+	/* 콘솔과 디렉터리는 매핑할 수 없음 */
+	if (f == NULL || (uintptr_t) f <= (uintptr_t) STDOUT || file_is_dir(f))
+		return NULL;
+	return do_mmap(addr, length, writable, f, offset);
+}
+
+/* mmap이 돌려준 addr의 매핑을 해제 */
+void munmap (void *addr) {
+	do_munmap(addr);
+}
+
+/* addr부터 length 바이트를 어떻게 쓸지 VM에 알려줌. 성공 시 0, 실패 시 -1 */
+int madvise (void *addr, size_t length, int advice) {
+	return vm_madvise(addr, length, advice) ? 0 : -1;
+}
+
+/* addr부터 length 바이트의 페이지를 메모리에 고정. 성공 시 0, 실패 시 -1 */
+int mlock (void *addr, size_t length) {
+	return vm_mlock(addr, length) ? 0 : -1;
+}
+
+/* mlock으로 고정한 페이지를 다시 evict될 수 있게 함 */
+int munlock (void *addr, size_t length) {
+	return vm_munlock(addr, length) ? 0 : -1;
+}
+
+/* 현재 스레드와 시스템 전체의 VM 이벤트 통계를 유저 버퍼에 채움. NULL인 쪽은 건너뜀 */
+void vmstat (struct vmstat *thread, struct vmstat *system) {
+	struct vmstat stats[2];
+
+	vm_get_stats(&stats[0], &stats[1]);
+	if ((thread != NULL && !copy_to_user(thread, &stats[0], sizeof *thread))
+			|| (system != NULL && !copy_to_user(system, &stats[1], sizeof *system)))
+		exit(-1);
+}
+
+/* 공유 메모리 segment의 이름을 유저 영역에서 복사. 잘못된 주소면 프로세스 종료,
+ * 비어 있거나 너무 길면 false */
+static bool copy_shm_name(char *buf, const char *name){
+	int len = strncpy_from_user(buf, name, SHM_NAME_MAX + 1);
+
+	if (len < 0)
+		exit(-1);
+	return len > 0 && len <= SHM_NAME_MAX;
+}
+
+/* 이름이 name인 공유 메모리 segment의 앞 length 바이트를 addr에 매핑. 없으면
+ * length 크기로 만들고, name이 NULL이면 이름 없는 segment를 새로 만듦.
+ * fork한 자식도 같은 segment를 매핑하고, munmap으로 해제. 성공 시 addr, 실패 시 NULL */
+void *shm_map (const char *name, void *addr, size_t length, int writable) {
+	char buf[SHM_NAME_MAX + 1];
+
+	if (name == NULL)
+		return do_shm_map(NULL, addr, length, writable);
+	if (!copy_shm_name(buf, name))
+		return NULL;
+	return do_shm_map(buf, addr, length, writable);
+}
+
+/* segment의 이름을 지움. segment는 매핑이 모두 없어질 때 사라짐 */
+static bool sys_shm_unlink (const char *name) {
+	char buf[SHM_NAME_MAX + 1];
+
+	return copy_shm_name(buf, name) && shm_unlink(buf);
+}
+
+/* heap의 끝(break)을 increment바이트만큼 옮기고 예전 break를 반환.
+ * 늘린 페이지는 처음 건드릴 때 0으로 채워짐. 실패 시 (void *) -1 */
+void *sbrk (intptr_t increment) {
+	struct process *cur = thread_current()->process;
+	/* 다른 스레드의 sbrk와 page fault를 막아 break를 읽고 옮기는 동안 그대로 둠 */
+	bool locked = vm_lock_acquire();
+	uint8_t *old_brk = cur->heap_brk;
+	uint8_t *new_brk = old_brk + increment;
+
+	/* heap 시작 아래로 줄이거나 유저 영역 밖으로 늘릴 수 없음 */
+	if ((increment < 0
+			? (uintptr_t) 0 - (uintptr_t) increment
+				> (uintptr_t) (old_brk - cur->heap_start)
+			: (uintptr_t) increment > KERN_BASE - (uintptr_t) old_brk)
+			|| !vm_set_brk(old_brk, new_brk))
+		old_brk = (void *) -1;
+	else
+		cur->heap_brk = new_brk;
+	vm_lock_release(locked);
+	return old_brk;
+}
+#endif
@@ -2,8 +2,8 @@
 #include <debug.h>
 #include <stddef.h>
 #include "userprog/gdt.h"
+#include "threads/cpu.h"
 #include "threads/thread.h"
-#include "threads/palloc.h"
 #include "threads/vaddr.h"
 #include "intrinsic.h"
 
@@ -45,24 +45,23 @@
  *      stack pointer to point to the new thread's kernel stack.
  *      (The call is in schedule in thread.c.) */
 
-/* Kernel TSS. */
-struct task_state *tss;
+/* Kernel TSS of each CPU.  They are static, so that an application
+ * processor need not allocate memory before it can schedule. */
+static struct task_state tss[NCPU];
 
-/* Initializes the kernel TSS. */
+/* Initializes the kernel TSS of this CPU. */
 void
 tss_init (void) {
 	/* Our TSS is never used in a call gate or task gate, so only a
 	 * few fields of it are ever referenced, and those are the only
 	 * ones we initialize. */
-	tss = palloc_get_page (PAL_ASSERT | PAL_ZERO);
 	tss_update (thread_current ());
 }
 
-/* Returns the kernel TSS. */
+/* Returns the kernel TSS of this CPU. */
 struct task_state *
 tss_get (void) {
-	ASSERT (tss != NULL);
-	return tss;
+	return &tss[this_cpu ()->id];
 }
 
 /* Sets the ring 0 stack pointer in the TSS to point to the end
@@ -71,6 +70,5 @@ tss_get (void) {
 // 사용자 프로세스가 인터럽트 핸들러에 들어갈 때 하드웨어가 커널 스택 포인터를 찾기 위해 tss를 참조
 void
 tss_update (struct thread *next) {
-	ASSERT (tss != NULL);
-	tss->rsp0 = (uint64_t) next + PGSIZE;
+	tss_get ()->rsp0 = (uint64_t) next + PGSIZE;
 }
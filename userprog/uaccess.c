@@ -0,0 +1,161 @@
+#include "userprog/uaccess.h"
+#include <stdint.h>
+#include "threads/interrupt.h"
+#include "threads/vaddr.h"
+
+/* Access to user memory.
+
+   The kernel reads and writes user memory by simply dereferencing
+   it, without looking the pages up first.  Each instruction that
+   does so has an entry in the exception table, the __ex_table
+   section, giving the address to resume at if it faults.
+   page_fault() calls uaccess_fixup() for a fault in the kernel it
+   cannot otherwise handle, which sends the instruction to its fixup
+   instead of killing the process; the fixup makes the access report
+   failure.  A good address thus costs nothing beyond the access
+   itself, and a page of a VM process that is not in memory yet is
+   brought in by the fault as usual.
+
+   Only addresses below KERN_BASE are accessed this way: a fault at
+   a kernel address is a bug, and a kernel address that is mapped
+   must not be reachable through a user pointer. */
+
+/* An entry in the exception table. */
+struct ex_entry {
+	uintptr_t insn;             /* Instruction that may fault. */
+	uintptr_t fixup;            /* Where to resume if it does. */
+};
+
+/* The exception table, put together by the linker. */
+extern const struct ex_entry __start_ex_table[], __stop_ex_table[];
+
+/* Returns true if all of the SIZE bytes at UADDR are below
+   KERN_BASE. */
+static bool
+user_range (const void *uaddr, size_t size) {
+	return is_user_vaddr (uaddr) && size <= KERN_BASE - (uintptr_t) uaddr;
+}
+
+/* Copies SIZE bytes from SRC to DST, either of which may be a user
+   address.  Returns the number of bytes left uncopied, which is 0
+   unless the copy faulted. */
+static size_t
+user_copy (void *dst, const void *src, size_t size) {
+	/* A fault in REP MOVSB leaves RCX at the count still to go. */
+	asm volatile ("1: rep movsb\n"
+			"2:\n"
+			".pushsection __ex_table, \"a\"\n"
+			"	.quad 1b, 2b\n"
+			".popsection"
+			: "+D" (dst), "+S" (src), "+c" (size) : : "memory");
+	return size;
+}
+
+/* Reads the byte at user address USRC.  Returns it, or -1 if the
+   read faults. */
+static int
+get_user (const uint8_t *usrc) {
+	int byte;
+
+	asm volatile ("1: movzbl %1, %0\n"
+			"2:\n"
+			".pushsection .text.fixup, \"ax\"\n"
+			"3: movl $-1, %0\n"
+			"	jmp 2b\n"
+			".popsection\n"
+			".pushsection __ex_table, \"a\"\n"
+			"	.quad 1b, 3b\n"
+			".popsection"
+			: "=r" (byte) : "m" (*usrc));
+	return byte;
+}
+
+/* Writes the byte at user address UDST back unchanged, atomically
+   so that a write by another thread in between is not lost.
+   Returns false if the write faults. */
+static bool
+touch_user (uint8_t *udst) {
+	int ok = 1;
+
+	asm volatile ("1: lock orb $0, %1\n"
+			"2:\n"
+			".pushsection .text.fixup, \"ax\"\n"
+			"3: movl $0, %0\n"
+			"	jmp 2b\n"
+			".popsection\n"
+			".pushsection __ex_table, \"a\"\n"
+			"	.quad 1b, 3b\n"
+			".popsection"
+			: "+r" (ok), "+m" (*udst));
+	return ok;
+}
+
+/* Copies SIZE bytes from user address USRC to DST.  Returns false
+   if part of the source is not readable user memory, in which case
+   DST may have been partly written. */
+bool
+copy_from_user (void *dst, const void *usrc, size_t size) {
+	return user_range (usrc, size) && user_copy (dst, usrc, size) == 0;
+}
+
+/* Copies SIZE bytes from SRC to user address UDST.  Returns false
+   if part of the destination is not writable user memory, in which
+   case the part before it may have been written. */
+bool
+copy_to_user (void *udst, const void *src, size_t size) {
+	return user_range (udst, size) && user_copy (udst, src, size) == 0;
+}
+
+/* Copies the null-terminated string at user address USRC into DST,
+   which has room for SIZE bytes.  Returns the length of the string,
+   or SIZE if it does not fit, in which case DST is not terminated,
+   or -1 if it runs into memory that is not readable. */
+int
+strncpy_from_user (char *dst, const char *usrc, size_t size) {
+	const uint8_t *src = (const uint8_t *) usrc;
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		int c;
+
+		if (!is_user_vaddr (src + i) || (c = get_user (src + i)) < 0)
+			return -1;
+		dst[i] = c;
+		if (c == '\0')
+			return i;
+	}
+	return size;
+}
+
+/* Returns true if the SIZE bytes at user address UADDR can be read,
+   and written as well if WRITE is true, touching one byte of each
+   page to find out.  For buffers that the kernel uses in place,
+   such as those of read() and write(). */
+bool
+user_probe (const void *uaddr, size_t size, bool write) {
+	uint8_t *va = (uint8_t *) uaddr;
+	uint8_t *end = (uint8_t *) uaddr + size;
+
+	if (!user_range (uaddr, size))
+		return false;
+	while (va < end) {
+		if (write ? !touch_user (va) : get_user (va) < 0)
+			return false;
+		va = (uint8_t *) pg_round_down (va) + PGSIZE;
+	}
+	return true;
+}
+
+/* If F is a fault in one of the accesses above, makes it resume at
+   its fixup and returns true. */
+bool
+uaccess_fixup (struct intr_frame *f) {
+	const struct ex_entry *e;
+
+	for (e = __start_ex_table; e < __stop_ex_table; e++)
+		if (e->insn == f->rip) {
+			f->rip = e->fixup;
+			return true;
+		}
+	return false;
+}
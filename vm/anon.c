@@ -1,7 +1,16 @@
 /* anon.c: Implementation of page for non-disk image (a.k.a. anonymous page). */
 
+#include <bitmap.h>
+#include <mman.h>
+#include <stdio.h>
+#include <string.h>
 #include "vm/vm.h"
+#include "vm/zswap.h"
 #include "devices/disk.h"
+#include "filesys/filesys.h"
+#include "threads/synch.h"
+#include "threads/tunable.h"
+#include "threads/vaddr.h"
 
 /* DO NOT MODIFY BELOW LINE */
 static struct disk *swap_disk;
@@ -17,36 +26,339 @@ static const struct page_operations anon_ops = {
 	.type = VM_ANON,
 };
 
+/* Swap space.
+ *
+ * The swap disk is divided into page-sized slots, tracked in
+ * SWAP_MAP.  Slots are handed out from clusters of SWAP_CLUSTER
+ * adjacent slots, reserved in the map all at once, so that the pages
+ * evicted in a row by one kswapd batch are written to consecutive
+ * sectors instead of wherever a free slot happened to be.
+ *
+ * A page that is swapped back in keeps its slot as long as it stays
+ * clean: if it is chosen for eviction again, the copy on disk is
+ * still good and no write is needed.  This is the swap cache. */
+#define SECTORS_PER_SLOT (PGSIZE / DISK_SECTOR_SIZE)
+#define SWAP_CLUSTER 8
+
+static struct bitmap *swap_map;
+static struct lock swap_lock;
+static size_t cluster_next;     /* Next slot of the current cluster. */
+static size_t cluster_end;      /* End of the current cluster. */
+
+/* Swap readahead.
+ *
+ * When a page is read back from swap, the slots after it in its
+ * cluster usually hold pages that were evicted together with it and
+ * will be wanted soon, as when a program walks an array.  Up to
+ * swap_readahead of them are read along with it into the readahead
+ * cache, a small ring of spare pages.  A later fault on one of those
+ * slots takes the page from the cache instead of the disk, trading
+ * its frame's page for the cached one.
+ *
+ * Entries are dropped whenever their slot is freed or rewritten, and
+ * the ring overwrites its oldest entry when full.  swap_lock covers
+ * the cache and is held across readahead, so a stale read cannot
+ * slip in after the drop. */
+#define SWAP_CACHE_SIZE 32
+
+struct swap_cache_entry {
+	size_t slot;                /* Slot cached, or SWAP_NONE. */
+	void *kva;                  /* Copy of the slot's contents. */
+};
+static struct swap_cache_entry swap_cache[SWAP_CACHE_SIZE];
+static size_t swap_cache_hand;  /* Next entry to replace. */
+
+/* Number of pages read ahead on each swap-in; 0 disables it. */
+size_t swap_readahead = 4;
+static struct tunable swap_readahead_tunable = {
+	.name = "vm.swap_readahead", .value = &swap_readahead,
+	.min = 0, .max = SWAP_CLUSTER - 1,
+};
+
+/* Name of the swap disk, see disk_find().  By default it is on the
+ * other channel from the file system disk, so that paging and file
+ * I/O do not wait for each other. */
+const char *swap_disk_name = "hd1:1";
+
 /* Initialize the data for anonymous pages */
 void
 vm_anon_init (void) {
-	/* TODO: Set up the swap_disk. */
-	swap_disk = NULL;
+	lock_init (&swap_lock);
+	lock_register (&swap_lock, "swap");
+	for (size_t i = 0; i < SWAP_CACHE_SIZE; i++)
+		swap_cache[i].slot = SWAP_NONE;
+	if (swap_readahead > SWAP_CLUSTER - 1)
+		swap_readahead = SWAP_CLUSTER - 1;
+	tunable_register (&swap_readahead_tunable);
+	swap_disk = disk_find (swap_disk_name);
+	if (swap_disk != NULL) {
+		swap_map = bitmap_create (disk_size (swap_disk) / SECTORS_PER_SLOT);
+		struct disk *fs_disk = disk_find (filesys_disk_name);
+		if (fs_disk != NULL && disk_shares_channel (swap_disk, fs_disk))
+			printf ("swap: %s shares a channel with the file system disk\n",
+					swap_disk_name);
+	}
+	zswap_init ();
+}
+
+/* Allocates a swap slot and returns its number, or SWAP_NONE if
+ * swap is full or missing. */
+static size_t
+swap_slot_alloc (void) {
+	size_t slot = SWAP_NONE;
+
+	if (swap_map == NULL)
+		return SWAP_NONE;
+
+	lock_acquire (&swap_lock);
+	if (cluster_next == cluster_end) {
+		/* Reserve a fresh cluster, or settle for a lone slot once
+		 * swap is too fragmented for one. */
+		size_t start = bitmap_scan_and_flip_next (swap_map, SWAP_CLUSTER,
+				false);
+		size_t cnt = SWAP_CLUSTER;
+
+		if (start == BITMAP_ERROR) {
+			start = bitmap_scan_and_flip_next (swap_map, 1, false);
+			cnt = 1;
+		}
+		if (start != BITMAP_ERROR) {
+			cluster_next = start;
+			cluster_end = start + cnt;
+		}
+	}
+	if (cluster_next != cluster_end)
+		slot = cluster_next++;
+	lock_release (&swap_lock);
+	return slot;
+}
+
+/* Returns the readahead cache entry for SLOT, or NULL. */
+static struct swap_cache_entry *
+swap_cache_find (size_t slot) {
+	ASSERT (lock_held_by_current_thread (&swap_lock));
+
+	for (size_t i = 0; i < SWAP_CACHE_SIZE; i++)
+		if (swap_cache[i].slot == slot)
+			return &swap_cache[i];
+	return NULL;
+}
+
+/* Drops the cached copy of SLOT, if any. */
+static void
+swap_cache_drop (size_t slot) {
+	struct swap_cache_entry *e = swap_cache_find (slot);
+
+	if (e != NULL) {
+		palloc_free_page (e->kva);
+		e->slot = SWAP_NONE;
+	}
+}
+
+/* Reads SLOT into KVA. */
+static void
+swap_read (size_t slot, void *kva) {
+	disk_read_multiple (swap_disk, slot * SECTORS_PER_SLOT, SECTORS_PER_SLOT,
+			kva);
 }
 
-/* Initialize the file mapping */
+/* Reads up to swap_readahead slots following SLOT in its cluster
+ * into the readahead cache.  The reads are all submitted before any
+ * is waited for, so that the disk does them back to back. */
+static void
+swap_read_ahead (size_t slot) {
+	static struct bio bios[SWAP_CLUSTER];
+	size_t end = slot - slot % SWAP_CLUSTER + SWAP_CLUSTER;
+	struct semaphore done;
+	size_t cnt = 0;
+
+	ASSERT (lock_held_by_current_thread (&swap_lock));
+
+	sema_init (&done, 0);
+	if (end > slot + 1 + swap_readahead)
+		end = slot + 1 + swap_readahead;
+	if (end > bitmap_size (swap_map))
+		end = bitmap_size (swap_map);
+
+	for (slot++; slot < end; slot++) {
+		struct swap_cache_entry *e;
+		void *kva;
+
+		if (!bitmap_test (swap_map, slot) || swap_cache_find (slot) != NULL)
+			continue;
+		kva = palloc_get_page (PAL_USER);
+		if (kva == NULL)
+			break;
+		bio_init (&bios[cnt], swap_disk, slot * SECTORS_PER_SLOT,
+				SECTORS_PER_SLOT, kva, false, bio_signal, &done);
+		disk_submit (&bios[cnt++]);
+
+		e = &swap_cache[swap_cache_hand];
+		swap_cache_hand = (swap_cache_hand + 1) % SWAP_CACHE_SIZE;
+		if (e->slot != SWAP_NONE)
+			palloc_free_page (e->kva);
+		e->slot = slot;
+		e->kva = kva;
+	}
+	while (cnt-- > 0)
+		sema_down (&done);
+}
+
+/* Frees swap slot SLOT. */
+void
+swap_slot_free (size_t slot) {
+	lock_acquire (&swap_lock);
+	swap_cache_drop (slot);
+	bitmap_reset (swap_map, slot);
+	lock_release (&swap_lock);
+}
+
+/* Frees the swap slots collected in TD, all under one hold of the
+ * lock, and empties it. */
+void
+swap_slot_free_batch (struct vm_teardown *td) {
+	if (td->slot_cnt == 0)
+		return;
+	lock_acquire (&swap_lock);
+	for (size_t i = 0; i < td->slot_cnt; i++) {
+		swap_cache_drop (td->slots[i]);
+		bitmap_reset (swap_map, td->slots[i]);
+	}
+	lock_release (&swap_lock);
+	td->slot_cnt = 0;
+}
+
+/* Writes the page at KVA to a newly allocated swap slot and returns
+ * the slot, or SWAP_NONE if swap is full or missing. */
+size_t
+swap_write (const void *kva) {
+	size_t slot = swap_slot_alloc ();
+
+	if (slot == SWAP_NONE)
+		return SWAP_NONE;
+	disk_write_multiple (swap_disk, slot * SECTORS_PER_SLOT, SECTORS_PER_SLOT,
+			kva);
+
+	/* Readahead may have copied the slot before we filled it. */
+	lock_acquire (&swap_lock);
+	swap_cache_drop (slot);
+	lock_release (&swap_lock);
+	return slot;
+}
+
+/* Reads SLOT into KVA, taking it from the readahead cache if it is
+ * there.  The slot stays allocated. */
+void
+swap_load (size_t slot, void *kva) {
+	struct swap_cache_entry *e;
+
+	lock_acquire (&swap_lock);
+	e = swap_cache_find (slot);
+	if (e != NULL) {
+		memcpy (kva, e->kva, PGSIZE);
+		swap_cache_drop (slot);
+	} else
+		swap_read (slot, kva);
+	lock_release (&swap_lock);
+}
+
+/* Initialize the file mapping.  If KVA is null, the contents of the
+ * page are already in a frame it shares. */
 bool
 anon_initializer (struct page *page, enum vm_type type, void *kva) {
 	/* Set up the handler */
 	page->operations = &anon_ops;
 
 	struct anon_page *anon_page = &page->anon;
+	anon_page->slot = SWAP_NONE;
+	anon_page->zentry = NULL;
+
+	/* A fresh anonymous page reads as zeros.  It has no copy in swap
+	 * yet, so it counts as dirty. */
+	if (kva != NULL)
+		memset (kva, 0, PGSIZE);
+	page->dirty = true;
+	return true;
 }
 
 /* Swap in the page by read contents from the swap disk. */
 static bool
 anon_swap_in (struct page *page, void *kva) {
 	struct anon_page *anon_page = &page->anon;
+	struct swap_cache_entry *e;
+
+	vmstat_count_spt (page->owner, swap_ins);
+
+	/* The page has no other copy once it leaves zswap. */
+	if (zswap_load (page, kva)) {
+		page->dirty = true;
+		return true;
+	}
+	ASSERT (anon_page->slot != SWAP_NONE);
+
+	lock_acquire (&swap_lock);
+	e = swap_cache_find (anon_page->slot);
+	if (e != NULL) {
+		/* Read ahead earlier: hand the cached page to our frame and
+		 * give the frame's page back. */
+		palloc_free_page (kva);
+		page->frame->kva = e->kva;
+		e->slot = SWAP_NONE;
+	} else {
+		swap_read (anon_page->slot, kva);
+		if (page->advice != MADV_RANDOM)
+			swap_read_ahead (anon_page->slot);
+	}
+	lock_release (&swap_lock);
+
+	/* Keep the slot: until the page is written to, it is an exact
+	 * copy and the next eviction can skip the write. */
+	page->dirty = false;
+	return true;
 }
 
 /* Swap out the page by writing contents to the swap disk. */
 static bool
 anon_swap_out (struct page *page) {
 	struct anon_page *anon_page = &page->anon;
+
+	if (anon_page->slot != SWAP_NONE) {
+		if (!page->dirty)
+			return true;
+
+		/* The old copy is stale; write to a slot of the current
+		 * cluster rather than seek back to it. */
+		swap_slot_free (anon_page->slot);
+		anon_page->slot = SWAP_NONE;
+	}
+
+	if (zswap_store (page, page->frame->kva)) {
+		page->dirty = false;
+		return true;
+	}
+	anon_page->slot = swap_write (page->frame->kva);
+	if (anon_page->slot == SWAP_NONE)
+		return false;
+	page->dirty = false;
+	return true;
 }
 
 /* Destroy the anonymous page. PAGE will be freed by the caller. */
 static void
 anon_destroy (struct page *page) {
 	struct anon_page *anon_page = &page->anon;
+
+	struct vm_teardown *td = page->owner->spt.teardown;
+
+	vm_release_frame (page);
+	zswap_invalidate (page);
+	if (anon_page->slot == SWAP_NONE)
+		return;
+	if (td == NULL)
+		swap_slot_free (anon_page->slot);
+	else {
+		td->slots[td->slot_cnt++] = anon_page->slot;
+		if (td->slot_cnt == TEARDOWN_SLOTS)
+			swap_slot_free_batch (td);
+	}
 }
@@ -0,0 +1,170 @@
+/* area.c: Regions of a process's address space. */
+
+#include <debug.h>
+#include "vm/vm.h"
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/vaddr.h"
+
+/* Address space regions.
+ *
+ * Besides its pages, each supplemental page table holds the regions
+ * they were made for, one struct vm_area per mapping, in a red-black
+ * tree ordered by start address.  The regions of one process never
+ * overlap, so the only region that may contain an address is the
+ * last one starting at or below it; that makes the questions asked
+ * about a whole range, as when mmap() checks that nothing is mapped
+ * where it is asked to map, O(lg n) in the number of regions instead
+ * of O(n) in the number of pages.
+ *
+ * Regions are made and removed by the mapping calls, a whole mapping
+ * at a time, and the pages within them come and go on their own: a
+ * region may be sparsely populated, as the stack is until it grows,
+ * but no page lies outside every region.  Only the owner of the
+ * table touches its regions, so there is no locking. */
+
+static struct kmem_cache *area_cache;
+
+/* Orders regions A and B by start address. */
+static bool
+area_less (const struct rb_elem *a, const struct rb_elem *b,
+		void *aux UNUSED) {
+	return rb_entry (a, struct vm_area, elem)->start
+		< rb_entry (b, struct vm_area, elem)->start;
+}
+
+/* Initializes address space regions. */
+void
+vm_area_init (void) {
+	area_cache = kmem_cache_create ("vm_area", sizeof (struct vm_area), 0,
+			NULL);
+}
+
+/* Initializes the regions of SPT, which has none. */
+void
+vm_area_table_init (struct supplemental_page_table *spt) {
+	rb_init (&spt->areas, area_less, NULL);
+}
+
+/* Returns the region of SPT after AREA, or NULL. */
+struct vm_area *
+vm_area_next (struct vm_area *area) {
+	struct rb_elem *e = rb_next (&area->elem);
+
+	return e != NULL ? rb_entry (e, struct vm_area, elem) : NULL;
+}
+
+/* Returns the first region of SPT that has a page between START and
+ * END, or NULL if there is none. */
+struct vm_area *
+vm_area_first (struct supplemental_page_table *spt, const void *start,
+		const void *end) {
+	struct vm_area key;
+	struct rb_elem *e;
+	struct vm_area *area;
+
+	key.start = (uint8_t *) start;
+	e = rb_floor (&spt->areas, &key.elem);
+	if (e == NULL || rb_entry (e, struct vm_area, elem)->end <= key.start)
+		e = e != NULL ? rb_next (e) : rb_min (&spt->areas);
+	if (e == NULL)
+		return NULL;
+	area = rb_entry (e, struct vm_area, elem);
+	return area->start < (uint8_t *) end ? area : NULL;
+}
+
+/* Returns the region of SPT containing ADDR, or NULL. */
+struct vm_area *
+vm_area_find (struct supplemental_page_table *spt, const void *addr) {
+	struct vm_area *area = vm_area_first (spt, addr, (uint8_t *) addr + 1);
+
+	return area != NULL && area->start <= (uint8_t *) addr ? area : NULL;
+}
+
+/* Returns true if any region of SPT has a page between START and
+ * END. */
+bool
+vm_area_overlaps (struct supplemental_page_table *spt, const void *start,
+		const void *end) {
+	return vm_area_first (spt, start, end) != NULL;
+}
+
+/* Adds a region from START to END, both page-aligned, for pages of
+ * TYPE that the user may write if WRITABLE is true and that come
+ * from FILE at OFFSET, if FILE is not null.  The region holds its own
+ * handle on FILE.  Returns the region, or NULL if it would overlap
+ * another or memory is short. */
+struct vm_area *
+vm_area_create (struct supplemental_page_table *spt, void *start,
+		void *end, enum vm_type type, bool writable, struct file *file,
+		off_t offset) {
+	struct vm_area *area;
+
+	ASSERT (pg_ofs (start) == 0 && pg_ofs (end) == 0);
+	ASSERT ((uint8_t *) start < (uint8_t *) end);
+
+	if (vm_area_overlaps (spt, start, end))
+		return NULL;
+	area = kmem_cache_alloc (area_cache);
+	if (area == NULL)
+		return NULL;
+	area->start = start;
+	area->end = end;
+	area->type = type;
+	area->writable = writable;
+	area->offset = offset;
+	area->file = NULL;
+	if (file != NULL && (area->file = file_reopen (file)) == NULL) {
+		kmem_cache_free (area_cache, area);
+		return NULL;
+	}
+	rb_insert (&spt->areas, &area->elem);
+	return area;
+}
+
+/* Removes AREA from SPT and frees it.  Its pages are left alone. */
+void
+vm_area_destroy (struct supplemental_page_table *spt, struct vm_area *area) {
+	rb_remove (&spt->areas, &area->elem);
+	file_close (area->file);
+	kmem_cache_free (area_cache, area);
+}
+
+/* Moves the end of AREA to END, which is page-aligned and
+ * above its start.  Returns false, changing nothing, if AREA would
+ * then overlap the region after it. */
+bool
+vm_area_resize (struct vm_area *area, void *end) {
+	struct vm_area *next = vm_area_next (area);
+
+	ASSERT (pg_ofs (end) == 0);
+	ASSERT ((uint8_t *) end > area->start);
+
+	if (next != NULL && next->start < (uint8_t *) end)
+		return false;
+	area->end = end;
+	return true;
+}
+
+/* Copies the regions of SRC into DST, which has none, for fork. */
+bool
+vm_area_copy (struct supplemental_page_table *dst,
+		struct supplemental_page_table *src) {
+	struct vm_area *area;
+
+	for (area = vm_area_first (src, NULL, (void *) KERN_BASE); area != NULL;
+			area = vm_area_next (area))
+		if (vm_area_create (dst, area->start, area->end, area->type,
+					area->writable, area->file, area->offset) == NULL)
+			return false;
+	return true;
+}
+
+/* Removes every region of SPT. */
+void
+vm_area_kill (struct supplemental_page_table *spt) {
+	struct rb_elem *e;
+
+	while ((e = rb_min (&spt->areas)) != NULL)
+		vm_area_destroy (spt, rb_entry (e, struct vm_area, elem));
+}
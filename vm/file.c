@@ -1,10 +1,18 @@
 /* file.c: Implementation of memory backed file object (mmaped object). */
 
+#include <mman.h>
+#include <round.h>
+#include <string.h>
 #include "vm/vm.h"
+#include "filesys/inode.h"
+#include "threads/mmu.h"
+#include "threads/vaddr.h"
 
 static bool file_backed_swap_in (struct page *page, void *kva);
 static bool file_backed_swap_out (struct page *page);
 static void file_backed_destroy (struct page *page);
+static void *map_file (void *addr, size_t length, int writable,
+		struct file *file, off_t offset);
 
 /* DO NOT MODIFY this struct */
 static const struct page_operations file_ops = {
@@ -21,38 +29,280 @@ vm_file_init (void) {
 
 /* Initialize the file backed page */
 bool
-file_backed_initializer (struct page *page, enum vm_type type, void *kva) {
+file_backed_initializer (struct page *page, enum vm_type type UNUSED,
+		void *kva UNUSED) {
 	/* Set up the handler */
 	page->operations = &file_ops;
 
 	struct file_page *file_page = &page->file;
+	file_page->file = NULL;
+	file_page->ofs = 0;
+	page->dirty = false;
+	return true;
+}
+
+/* Returns the number of bytes of PAGE that lie within its file. */
+static size_t
+file_page_bytes (struct page *page) {
+	struct file_page *file_page = &page->file;
+	off_t length = file_length (file_page->file);
+
+	if (file_page->ofs >= length)
+		return 0;
+	return length - file_page->ofs < PGSIZE ? length - file_page->ofs : PGSIZE;
+}
+
+/* Writes PAGE, whose contents are at KVA, back to its file.  Only
+ * the bytes within the file's length are written; a mapping never
+ * makes its file longer. */
+static void
+file_page_write_back (struct page *page, const void *kva) {
+	struct file_page *file_page = &page->file;
+	size_t bytes = file_page_bytes (page);
+
+	if (bytes > 0)
+		inode_write_at (file_get_inode (file_page->file), kva, bytes,
+				file_page->ofs);
+}
+
+/* Returns true if PAGE is in memory and has been written to since
+ * it was last written back. */
+static bool
+file_page_dirty (struct page *page) {
+	return page->frame != NULL
+		&& (page->dirty || pml4_is_dirty (page->owner->pml4, page->va));
+}
+
+/* Write-back at teardown.  When a mapping goes away, because of
+ * munmap() or exit, the dirty pages of each run of adjacent pages
+ * that map adjacent parts of one file are written back with a single
+ * inode_write_at() from their user addresses, pinned for the write,
+ * so that the sectors go out in one sequential stream.  Pages that were only read cost
+ * nothing.  The dirty bits of what was written are cleared, so that
+ * destroying the pages afterward writes nothing more. */
+struct write_back_run {
+	struct inode *inode;   /* File of the run. */
+	off_t ofs;             /* Offset of the run's first page in INODE. */
+	uint8_t *va;           /* Address of the run's first page. */
+	size_t page_cnt;       /* Number of pages in the run, or 0. */
+	off_t length;          /* Length of INODE. */
+};
+
+/* Writes back RUN, if it is not empty, and empties it. */
+static void
+write_back_flush (struct write_back_run *run) {
+	struct process *cur = thread_current ()->process;
+	off_t bytes = run->page_cnt * PGSIZE;
+
+	if (run->page_cnt == 0)
+		return;
+	if (bytes > run->length - run->ofs)
+		bytes = run->length - run->ofs;
+	if (bytes > 0) {
+		/* If the pages cannot be pinned, destroying them writes them
+		 * back one by one instead. */
+		if (!vm_pin_buffer (run->va, bytes, false)) {
+			run->page_cnt = 0;
+			return;
+		}
+		inode_write_at (run->inode, run->va, bytes, run->ofs);
+		vm_unpin_buffer (run->va, bytes);
+	}
+
+	for (size_t i = 0; i < run->page_cnt; i++) {
+		struct page *page = spt_find_page (&cur->spt, run->va + i * PGSIZE);
+
+		page->dirty = false;
+		pml4_set_dirty (cur->pml4, page->va, false);
+	}
+	run->page_cnt = 0;
+}
+
+/* Adds PAGE to RUN_, a struct write_back_run, if it is dirty,
+ * writing back the run collected so far first if PAGE does not
+ * continue it.  Suits spt_for_each(). */
+static bool
+write_back_add (struct page *page, void *run_) {
+	struct write_back_run *run = run_;
+	struct file_page *file_page = &page->file;
+	struct inode *inode;
+
+	if (VM_TYPE (page->operations->type) != VM_FILE
+			|| !file_page_dirty (page)) {
+		write_back_flush (run);
+		return true;
+	}
+
+	inode = file_get_inode (file_page->file);
+	if (run->page_cnt > 0
+			&& (inode != run->inode
+				|| (uint8_t *) page->va != run->va + run->page_cnt * PGSIZE
+				|| file_page->ofs != run->ofs + (off_t) (run->page_cnt * PGSIZE)))
+		write_back_flush (run);
+	if (run->page_cnt == 0) {
+		run->inode = inode;
+		run->ofs = file_page->ofs;
+		run->va = page->va;
+		run->length = inode_length (inode);
+	}
+	run->page_cnt++;
+	return true;
+}
+
+/* Writes back the dirty pages of mapped files in the current
+ * process, in as few writes as possible.  Called before its pages
+ * are torn down. */
+void
+file_write_back_all (void) {
+	struct write_back_run run = { .page_cnt = 0 };
+
+	spt_for_each (&thread_current ()->process->spt, write_back_add, &run);
+	write_back_flush (&run);
 }
 
 /* Swap in the page by read contents from the file. */
 static bool
 file_backed_swap_in (struct page *page, void *kva) {
-	struct file_page *file_page UNUSED = &page->file;
+	struct file_page *file_page = &page->file;
+	size_t bytes = file_page_bytes (page);
+
+	/* The inode layer takes its own locks; none of them is held by
+	 * whoever waits for frame_lock. */
+	if (inode_read_at (file_get_inode (file_page->file), kva, bytes,
+				file_page->ofs) != (off_t) bytes)
+		return false;
+	memset ((uint8_t *) kva + bytes, 0, PGSIZE - bytes);
+	return true;
 }
 
 /* Swap out the page by writeback contents to the file. */
 static bool
 file_backed_swap_out (struct page *page) {
-	struct file_page *file_page UNUSED = &page->file;
+	if (page->dirty) {
+		file_page_write_back (page, page->frame->kva);
+		page->dirty = false;
+	}
+	return true;
+}
+
+/* Writes PAGE back if this mapping changed it, and lets go of its
+ * frame.  The next access reads the page from the file again. */
+void
+file_page_release (struct page *page) {
+	/* An evicted page has been written back already, and teardown
+	 * may have done it too. */
+	if (vm_pin_resident_page (page)) {
+		if (page->dirty || pml4_is_dirty (page->owner->pml4, page->va))
+			file_page_write_back (page, page->frame->kva);
+		vm_unpin_page (page);
+	}
+	vm_release_frame (page);
 }
 
 /* Destory the file backed page. PAGE will be freed by the caller. */
 static void
 file_backed_destroy (struct page *page) {
-	struct file_page *file_page UNUSED = &page->file;
+	struct file_page *file_page = &page->file;
+
+	file_page_release (page);
+	file_close (file_page->file);
 }
 
-/* Do the mmap */
+/* Do the mmap
+ *
+ * WRITABLE may include MAP_POPULATE, which reads in the whole mapping
+ * right away, front to back, instead of one fault per page; for a
+ * file that is going to be scanned once, that saves the faults.  The
+ * mapping is made all the same if memory runs out partway.
+ *
+ * The mapping is one region of the address space; whether it would
+ * overlap another is a single lookup, however long it is. */
 void *
 do_mmap (void *addr, size_t length, int writable,
 		struct file *file, off_t offset) {
+	bool locked = vm_lock_acquire ();
+
+	addr = map_file (addr, length, writable, file, offset);
+	vm_lock_release (locked);
+	return addr;
+}
+
+/* Does do_mmap() with vm_lock held. */
+static void *
+map_file (void *addr, size_t length, int writable,
+		struct file *file, off_t offset) {
+	struct supplemental_page_table *spt = &thread_current ()->process->spt;
+	bool populate = (writable & MAP_POPULATE) != 0;
+	size_t page_cnt, i;
+
+	writable &= ~MAP_POPULATE;
+	if (addr == NULL || pg_ofs (addr) != 0 || !is_user_vaddr (addr)
+			|| length == 0 || offset < 0 || offset % PGSIZE != 0
+			|| file_length (file) == 0)
+		return NULL;
+	page_cnt = DIV_ROUND_UP (length, PGSIZE);
+	if (page_cnt > (KERN_BASE - (uint64_t) addr) / PGSIZE)
+		return NULL;
+	if (vm_area_create (spt, addr, (uint8_t *) addr + page_cnt * PGSIZE,
+				VM_FILE, writable, file, offset) == NULL)
+		return NULL;
+
+	for (i = 0; i < page_cnt; i++) {
+		void *upage = (uint8_t *) addr + i * PGSIZE;
+		struct file *f = file_reopen (file);
+		struct page *page;
+
+		if (f == NULL || !vm_alloc_page (VM_FILE, upage, writable)) {
+			file_close (f);
+			do_munmap (addr);
+			return NULL;
+		}
+
+		/* Nothing to do at the first fault that swap_in() cannot do,
+		 * so the page is a file page from the start. */
+		page = spt_find_page (spt, upage);
+		page->uninit.page_initializer (page, VM_FILE, NULL);
+		page->file.file = f;
+		page->file.ofs = offset + i * PGSIZE;
+	}
+
+	if (populate)
+		for (i = 0; i < page_cnt; i++)
+			if (!vm_claim_page ((uint8_t *) addr + i * PGSIZE))
+				break;
+	return addr;
 }
 
-/* Do the munmap */
+/* Do the munmap
+ *
+ * ADDR must be the start of an mmap() or shm_map() mapping, which is
+ * removed whole.  Pages it never got, if making it failed partway,
+ * are skipped. */
 void
 do_munmap (void *addr) {
+	struct supplemental_page_table *spt = &thread_current ()->process->spt;
+	bool locked = vm_lock_acquire ();
+	struct vm_area *area = vm_area_find (spt, addr);
+	struct write_back_run run = { .page_cnt = 0 };
+	struct page *page;
+	uint8_t *va;
+
+	if (area == NULL || area->start != addr
+			|| (VM_TYPE (area->type) != VM_FILE
+				&& VM_TYPE (area->type) != VM_SHM)) {
+		vm_lock_release (locked);
+		return;
+	}
+
+	/* Write back first, in as few writes as possible. */
+	for (va = area->start; va < area->end; va += PGSIZE)
+		if ((page = spt_find_page (spt, va)) != NULL)
+			write_back_add (page, &run);
+	write_back_flush (&run);
+
+	for (va = area->start; va < area->end; va += PGSIZE)
+		if ((page = spt_find_page (spt, va)) != NULL)
+			spt_remove_page (spt, page);
+	vm_area_destroy (spt, area);
+	vm_lock_release (locked);
 }
@@ -0,0 +1,291 @@
+/* shm.c: Implementation of shared memory segments. */
+
+#include <debug.h>
+#include <hash.h>
+#include <mman.h>
+#include <round.h>
+#include <string.h>
+#include "vm/vm.h"
+#include "threads/malloc.h"
+#include "threads/vaddr.h"
+
+static bool shm_swap_in (struct page *page, void *kva);
+static bool shm_swap_out (struct page *page);
+static void shm_destroy (struct page *page);
+static void *map_segment (const char *name, void *addr, size_t length,
+		int writable);
+
+static const struct page_operations shm_ops = {
+	.swap_in = shm_swap_in,
+	.swap_out = shm_swap_out,
+	.destroy = shm_destroy,
+	.type = VM_SHM,
+};
+
+/* Shared memory segments.
+ *
+ * A segment is a run of anonymous pages that every process mapping
+ * it sees the same.  A process maps it with one VM_SHM page per page
+ * of the segment, and all the pages that map one page of a segment
+ * share a single frame, found through the segment's SLOTS once it is
+ * in memory.  Writes go to that frame, not a copy.  Like the frame of
+ * a mapped file, it is evicted with all its mappings at once, to a
+ * swap slot of the segment, and the next fault in any of the
+ * processes brings it back in.
+ *
+ * The frame of a page that no process maps anymore stays with the
+ * segment, out of the frame table, until the page is mapped again or
+ * the segment goes away.
+ *
+ * A segment lives as long as it has a name or any page maps it.  A
+ * fork maps the same segments in the child, so that a segment without
+ * a name is shared by a process and its descendants.  shm_lock covers
+ * SHM_NAMES and the reference counts. */
+static struct ohash shm_names;
+static struct lock shm_lock;
+
+/* Returns the hash of segment E. */
+static uint64_t
+shm_hash (const struct ohash_elem *e, void *aux UNUSED) {
+	return hash_string (ohash_entry (e, struct shm, elem)->name);
+}
+
+/* Orders segments A and B by name. */
+static bool
+shm_less (const struct ohash_elem *a, const struct ohash_elem *b,
+		void *aux UNUSED) {
+	return strcmp (ohash_entry (a, struct shm, elem)->name,
+			ohash_entry (b, struct shm, elem)->name) < 0;
+}
+
+/* Initializes shared memory segments. */
+void
+vm_shm_init (void) {
+	lock_init (&shm_lock);
+	if (!ohash_init (&shm_names, shm_hash, shm_less, NULL))
+		PANIC ("vm_shm_init: out of memory");
+}
+
+/* Returns the segment named NAME, or NULL. */
+static struct shm *
+shm_lookup (const char *name) {
+	struct shm key;
+	struct ohash_elem *e;
+
+	ASSERT (lock_held_by_current_thread (&shm_lock));
+
+	strlcpy (key.name, name, sizeof key.name);
+	e = ohash_find (&shm_names, &key.elem);
+	return e != NULL ? ohash_entry (e, struct shm, elem) : NULL;
+}
+
+/* Returns the segment named NAME, creating it with PAGE_CNT pages if
+ * there is none, or a new segment without a name if NAME is NULL, with
+ * a reference for the caller.  Returns NULL if the segment is smaller
+ * than PAGE_CNT pages or memory is short. */
+static struct shm *
+shm_get (const char *name, size_t page_cnt) {
+	struct shm *shm;
+
+	lock_acquire (&shm_lock);
+	shm = name != NULL ? shm_lookup (name) : NULL;
+	if (shm != NULL) {
+		if (shm->page_cnt >= page_cnt)
+			shm->ref_cnt++;
+		else
+			shm = NULL;
+		lock_release (&shm_lock);
+		return shm;
+	}
+
+	shm = malloc (sizeof *shm + page_cnt * sizeof *shm->slots);
+	if (shm != NULL) {
+		strlcpy (shm->name, name != NULL ? name : "", sizeof shm->name);
+		shm->ref_cnt = 1;
+		lock_init (&shm->lock);
+		shm->page_cnt = page_cnt;
+		for (size_t i = 0; i < page_cnt; i++) {
+			shm->slots[i].frame = NULL;
+			shm->slots[i].slot = SWAP_NONE;
+		}
+		if (name != NULL) {
+			ohash_insert (&shm_names, &shm->elem);
+			shm->ref_cnt++;
+		}
+	}
+	lock_release (&shm_lock);
+	return shm;
+}
+
+/* Takes another reference to SHM. */
+void
+shm_reopen (struct shm *shm) {
+	lock_acquire (&shm_lock);
+	shm->ref_cnt++;
+	lock_release (&shm_lock);
+}
+
+/* Drops a reference to SHM, freeing it and its pages with the last. */
+void
+shm_close (struct shm *shm) {
+	bool last;
+
+	lock_acquire (&shm_lock);
+	last = --shm->ref_cnt == 0;
+	lock_release (&shm_lock);
+	if (!last)
+		return;
+
+	/* No page maps SHM, so none of its frames is in the frame table. */
+	for (size_t i = 0; i < shm->page_cnt; i++) {
+		struct shm_slot *slot = &shm->slots[i];
+
+		if (slot->frame != NULL)
+			vm_free_shm_frame (slot->frame);
+		if (slot->slot != SWAP_NONE)
+			swap_slot_free (slot->slot);
+	}
+	free (shm);
+}
+
+/* Removes the name NAME.  The segment goes away once no page maps it
+ * either.  Returns false if there is no segment named NAME. */
+bool
+shm_unlink (const char *name) {
+	struct shm *shm;
+
+	lock_acquire (&shm_lock);
+	shm = shm_lookup (name);
+	if (shm != NULL) {
+		ohash_delete (&shm_names, &shm->elem);
+		shm->name[0] = '\0';
+	}
+	lock_release (&shm_lock);
+	if (shm != NULL)
+		shm_close (shm);
+	return shm != NULL;
+}
+
+/* Initializes a page of a segment.  Its fields are set by whoever
+ * maps it. */
+bool
+shm_initializer (struct page *page, enum vm_type type UNUSED,
+		void *kva UNUSED) {
+	page->operations = &shm_ops;
+
+	struct shm_page *shm_page = &page->shm;
+	shm_page->shm = NULL;
+	shm_page->idx = 0;
+	page->dirty = true;
+	return true;
+}
+
+/* Brings in the page of the segment that PAGE maps, which no frame
+ * holds, from swap or, if it was never evicted, as zeros.  The
+ * caller holds the segment's lock, and frees the swap slot once the
+ * frame is in the slot. */
+static bool
+shm_swap_in (struct page *page, void *kva) {
+	struct shm_slot *slot = &page->shm.shm->slots[page->shm.idx];
+
+	if (slot->slot == SWAP_NONE)
+		memset (kva, 0, PGSIZE);
+	else {
+		vmstat_count_spt (page->owner, swap_ins);
+		swap_load (slot->slot, kva);
+	}
+
+	/* The frame will be the only copy. */
+	page->dirty = true;
+	return true;
+}
+
+/* Writes the frame of PAGE, which the caller has unmapped from every
+ * page sharing it, to swap for the segment. */
+static bool
+shm_swap_out (struct page *page) {
+	struct shm_slot *slot = &page->shm.shm->slots[page->shm.idx];
+
+	ASSERT (slot->frame == page->frame);
+	ASSERT (slot->slot == SWAP_NONE);
+
+	slot->slot = swap_write (page->frame->kva);
+	if (slot->slot == SWAP_NONE)
+		return false;
+	slot->frame = NULL;
+	page->dirty = false;
+	return true;
+}
+
+/* Unmaps PAGE and drops its reference to the segment.  PAGE will be
+ * freed by the caller. */
+static void
+shm_destroy (struct page *page) {
+	vm_release_shm_frame (page);
+	shm_close (page->shm.shm);
+}
+
+/* Maps LENGTH bytes of the segment named NAME at ADDR, creating the
+ * segment if there is none, or a new segment without a name if NAME
+ * is NULL.  WRITABLE may include MAP_POPULATE, as for do_mmap(), to
+ * bring the pages in right away.  Returns ADDR, or NULL if the
+ * mapping cannot be made. */
+void *
+do_shm_map (const char *name, void *addr, size_t length, int writable) {
+	bool locked = vm_lock_acquire ();
+
+	addr = map_segment (name, addr, length, writable);
+	vm_lock_release (locked);
+	return addr;
+}
+
+/* Does do_shm_map() with vm_lock held. */
+static void *
+map_segment (const char *name, void *addr, size_t length, int writable) {
+	struct supplemental_page_table *spt = &thread_current ()->process->spt;
+	bool populate = (writable & MAP_POPULATE) != 0;
+	struct shm *shm;
+	size_t page_cnt, i;
+
+	writable &= ~MAP_POPULATE;
+	if (addr == NULL || pg_ofs (addr) != 0 || !is_user_vaddr (addr)
+			|| length == 0)
+		return NULL;
+	page_cnt = DIV_ROUND_UP (length, PGSIZE);
+	if (page_cnt > (KERN_BASE - (uint64_t) addr) / PGSIZE
+			|| vm_area_overlaps (spt, addr, (uint8_t *) addr + page_cnt * PGSIZE))
+		return NULL;
+
+	shm = shm_get (name, page_cnt);
+	if (shm == NULL)
+		return NULL;
+	if (vm_area_create (spt, addr, (uint8_t *) addr + page_cnt * PGSIZE,
+				VM_SHM, writable, NULL, 0) == NULL) {
+		shm_close (shm);
+		return NULL;
+	}
+	for (i = 0; i < page_cnt; i++) {
+		void *upage = (uint8_t *) addr + i * PGSIZE;
+		struct page *page;
+
+		if (!vm_alloc_page (VM_SHM, upage, writable)) {
+			do_munmap (addr);
+			shm_close (shm);
+			return NULL;
+		}
+
+		/* Like a file page, the page is a segment page from the start. */
+		page = spt_find_page (spt, upage);
+		page->uninit.page_initializer (page, VM_SHM, NULL);
+		shm_reopen (shm);
+		page->shm.shm = shm;
+		page->shm.idx = i;
+	}
+	shm_close (shm);
+
+	if (populate)
+		for (i = 0; i < page_cnt; i++)
+			if (!vm_claim_page ((uint8_t *) addr + i * PGSIZE))
+				break;
+	return addr;
+}
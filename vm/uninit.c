@@ -10,6 +10,8 @@
 
 #include "vm/vm.h"
 #include "vm/uninit.h"
+#include "filesys/file.h"
+#include "threads/malloc.h"
 
 static bool uninit_initialize (struct page *page, void *kva);
 static void uninit_destroy (struct page *page);
@@ -62,7 +64,14 @@ uninit_initialize (struct page *page, void *kva) {
  * PAGE will be freed by the caller. */
 static void
 uninit_destroy (struct page *page) {
-	struct uninit_page *uninit UNUSED = &page->uninit;
-	/* TODO: Fill this function.
-	 * TODO: If you don't have anything to do, just return. */
+	struct vm_load_aux *aux = page->uninit.aux;
+
+	/* Drop the zero page, if we were reading it. */
+	vm_release_frame (page);
+
+	/* The load source was never consumed. */
+	if (aux != NULL) {
+		file_close (aux->file);
+		free (aux);
+	}
 }
@@ -1,13 +1,176 @@
 /* vm.c: Generic interface for virtual memory objects. */
 
+#include <crc32.h>
+#include <hash.h>
+#include <memstat.h>
+#include <mman.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "filesys/inode.h"
+#include "threads/atomic.h"
+#include "threads/fpu.h"
 #include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/trace.h"
+#include "threads/tunable.h"
+#include "threads/vaddr.h"
+#include "threads/workqueue.h"
+#include "devices/timer.h"
+#include "userprog/syscall.h"
 #include "vm/vm.h"
 #include "vm/inspect.h"
+#include "intrinsic.h"
+
+/* Allocators for the page and frame descriptors. */
+static struct kmem_cache *page_cache;
+static struct kmem_cache *frame_cache;
+
+/* A page of zeros, mapped read-only for read faults on anonymous
+ * pages that have never been written, in place of a frame of their
+ * own.  The first write to such a page goes through vm_handle_wp(),
+ * which gives it a real frame. */
+static void *zero_page;
+
+/* Frame table.  Holds every frame that is in use, in clock order;
+ * CLOCK_HAND is the next frame to look at.  FRAME_LOCK protects the
+ * table and the PAGE and FRAME links between pages and frames, and
+ * is held across an eviction so that a page is never seen half
+ * evicted. */
+static struct list frame_table;
+static struct list_elem *clock_hand;
+static struct lock frame_lock;
+
+/* Background reclaim.  When the free frames of the user pool drop
+ * below kswapd_low, kswapd is woken to evict pages until kswapd_high
+ * frames are free again, so that faults usually find a free frame
+ * instead of paying for a swap write themselves.  It first takes back
+ * the pages that caches such as the buffer cache borrowed from the
+ * user pool while it was idle, see palloc_shrink().  It evicts up to
+ * KSWAPD_BATCH pages per hold of frame_lock, so their writes go out
+ * back to back. */
+#define KSWAPD_BATCH 16
+static size_t kswapd_low, kswapd_high;
+static struct tunable kswapd_low_tunable = {
+	.name = "vm.kswapd_low", .value = &kswapd_low, .min = 1, .max = SIZE_MAX,
+};
+static struct tunable kswapd_high_tunable = {
+	.name = "vm.kswapd_high", .value = &kswapd_high, .min = 1, .max = SIZE_MAX,
+};
+static struct semaphore kswapd_sema;
+static int kswapd_sleeping;         /* Nonzero while kswapd sleeps. */
+static void kswapd (void *);
+static void kswapd_poke (void);
+
+/* Working sets and resident set limits.
+ *
+ * Every WS_SCAN_TICKS, ws_scan() goes over the frame table and counts
+ * each page whose accessed bit is set toward its process's working
+ * set, then clears the bit for the next round.  The clock still sees
+ * that the page was used, through the frame's REFERENCED flag.  A
+ * page mapped by a huge page is always counted, since it has no
+ * accessed bit of its own.  A pass holds frame_lock for at most
+ * WS_SCAN_BATCH frames at a time, so that faults are not held up for
+ * the whole walk; until it is done, the counts of the previous pass
+ * are the ones reported.
+ *
+ * A process may have at most rss_limit pages in memory, if that is
+ * nonzero.  Once it has that many, it gets frames for new pages by
+ * evicting pages of its own, local reclaim, not anyone else's.  A
+ * change to rss_limit applies to processes created after it. */
+#define WS_SCAN_TICKS TIMER_FREQ
+#define WS_SCAN_BATCH 256
+size_t rss_limit;
+static struct tunable rss_limit_tunable = {
+	.name = "vm.rss_limit", .value = &rss_limit, .min = 0, .max = SIZE_MAX,
+};
+/* See vm_stack_growth(). */
+static struct tunable stack_growth_tunable = {
+	.name = "vm.stack_growth_window", .value = &stack_growth_window,
+	.min = 0, .max = 256,
+};
+static unsigned ws_epoch;          /* Number of the last full scan. */
+static size_t ws_total;            /* Pages accessed in that scan. */
+static bool ws_in_pass;            /* Is scan WS_EPOCH + 1 under way? */
+static size_t ws_pass_total;       /* Pages accessed in it so far. */
+static struct list_elem *ws_hand;  /* Next frame for that scan. */
+static struct delayed_work ws_work;
+static void ws_scan (void *);
+
+/* Compaction, see compact(). */
+static struct work compact_work;
+static uint16_t *compact_movable;  /* Frames in each 2 MB block. */
+static size_t compact_block_cnt;   /* Number of blocks counted. */
+static int64_t compact_failed;     /* When compaction last failed. */
+static void compact_run (void *);
+static void compact_poke (void);
+
+/* Page caches.  Frames are indexed by the part of a file they were
+ * loaded from, so that pages with the same source map the same frame
+ * instead of reading their own copies.  A frame stays in its cache,
+ * holding a reference to the inode, as long as some page maps it.
+ * Both caches are covered by frame_lock.
+ *
+ * The text cache holds read-only pages of executables, which every
+ * process running the same program shares.
+ *
+ * The file cache holds the pages of mapped files, keyed by inode and
+ * page offset alone.  Every mapping of a page shares its frame, with
+ * write access if the mapping has it, and read() and write() on the
+ * file go through the frame too, by vm_cache_read() and
+ * vm_cache_write(), so that all of them see the same data. */
+static struct ohash text_cache;
+static struct ohash file_cache;
+static uint64_t cache_hash (const struct ohash_elem *, void *aux);
+static bool cache_less (const struct ohash_elem *, const struct ohash_elem *,
+		void *aux);
+static void cache_remove (struct frame *);
+
+/* Same-page merging.  Processes often hold many pages with the same
+ * contents: workers forked from one parent fill in the same tables,
+ * and buffers stay zeroed.  While vm.ksm_scan is nonzero, a delayed
+ * work looks at that many frames of the frame table every
+ * KSM_SCAN_TICKS, and merges anonymous pages with equal contents into
+ * one frame, shared copy-on-write as after fork().  The first write
+ * to a merged page gives it a copy of its own again, in
+ * vm_handle_wp().
+ *
+ * Frames that pages can be merged into are kept in ksm_cache, a
+ * third page cache, keyed by contents instead of by file: by the
+ * CRC-32C of the frame, with frames of equal CRCs told apart by
+ * comparing their bytes.  A frame in the cache must not change, so
+ * its pages are all mapped read-only, and vm_handle_wp() takes it out
+ * of the cache before giving one write access back.  The scan only
+ * puts a frame in the cache if its CRC is the same as when the scan
+ * last looked at it, so that pages being written are left alone; one that
+ * is written after all takes one extra fault.
+ *
+ * Only private anonymous frames, mapped by a single page, are merged,
+ * and not pinned ones, those in a huge page or those of a process
+ * that is exiting. */
+#define KSM_SCAN_TICKS (TIMER_FREQ / 5)
+static size_t ksm_scan;
+static struct tunable ksm_scan_tunable = {
+	.name = "vm.ksm_scan", .value = &ksm_scan, .min = 0, .max = SIZE_MAX,
+};
+static struct ohash ksm_cache;
+static struct list_elem *ksm_hand; /* Next frame for the scan. */
+static uint64_t ksm_merged;        /* Pages merged so far. */
+static uint64_t ksm_hash (const struct ohash_elem *, void *aux);
+static bool ksm_less (const struct ohash_elem *, const struct ohash_elem *,
+		void *aux);
+static struct delayed_work ksm_work;
+static void ksm_scan_frames (void *);
 
 /* Initializes the virtual memory subsystem by invoking each subsystem's
  * intialize codes. */
 void
 vm_init (void) {
+	struct memstat ms;
+
 	vm_anon_init ();
 	vm_file_init ();
 #ifdef EFILESYS  /* For project 4 */
@@ -15,7 +178,49 @@ vm_init (void) {
 #endif
 	register_inspect_intr ();
 	/* DO NOT MODIFY UPPER LINES. */
-	/* TODO: Your code goes here. */
+	vm_shm_init ();
+	vm_area_init ();
+	list_init (&frame_table);
+	clock_hand = list_end (&frame_table);
+	ksm_hand = list_end (&frame_table);
+	ws_hand = list_end (&frame_table);
+	lock_init (&frame_lock);
+	lock_register (&frame_lock, "frame table");
+	sema_init (&kswapd_sema, 0);
+	/* A low watermark of 1/64 of the user pool, but at least a
+	 * batch, and a high watermark twice that. */
+	palloc_get_stats (&ms);
+	kswapd_low = ms.user_pages / 64;
+	if (kswapd_low < KSWAPD_BATCH)
+		kswapd_low = KSWAPD_BATCH;
+	kswapd_high = kswapd_low * 2;
+	tunable_register (&kswapd_low_tunable);
+	tunable_register (&kswapd_high_tunable);
+	tunable_register (&rss_limit_tunable);
+	tunable_register (&stack_growth_tunable);
+	tunable_register (&ksm_scan_tunable);
+	thread_create ("kswapd", PRI_DEFAULT, kswapd, NULL);
+	delayed_work_init (&ws_work, ws_scan, NULL);
+	queue_delayed_work (WQ_NORMAL, &ws_work, WS_SCAN_TICKS);
+	delayed_work_init (&ksm_work, ksm_scan_frames, NULL);
+	queue_delayed_work (WQ_NORMAL, &ksm_work, KSM_SCAN_TICKS);
+
+	/* One more block than the pool spans, for a pool that does not
+	 * start on a block boundary. */
+	work_init (&compact_work, compact_run, NULL);
+	compact_failed = -TIMER_FREQ;
+	compact_block_cnt = ms.user_pages / (LARGE_PGSIZE / PGSIZE) + 2;
+	compact_movable = malloc (compact_block_cnt * sizeof *compact_movable);
+	if (compact_movable == NULL)
+		PANIC ("vm_init: out of memory");
+	zero_page = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+	if (!ohash_init (&text_cache, cache_hash, cache_less, NULL)
+			|| !ohash_init (&file_cache, cache_hash, cache_less, NULL)
+			|| !ohash_init (&ksm_cache, ksm_hash, ksm_less, NULL))
+		PANIC ("vm_init: out of memory");
+	page_cache = kmem_cache_create ("vm_page", sizeof (struct page), 0, NULL);
+	frame_cache = kmem_cache_create ("vm_frame", sizeof (struct frame), 0,
+			NULL);
 }
 
 /* Get the type of the page. This function is useful if you want to know the
@@ -32,10 +237,34 @@ page_get_type (struct page *page) {
 	}
 }
 
+/* Acquires the running process's vm_lock, which its threads hold
+ * while they look up or change its supplemental page table and its
+ * regions, unless the running thread holds it already, as it does
+ * when it faults on a user address while working on them.  Returns
+ * true if it took the lock, to be passed to vm_lock_release(). */
+bool
+vm_lock_acquire (void) {
+	struct lock *lock = &thread_current ()->process->vm_lock;
+
+	if (lock_held_by_current_thread (lock))
+		return false;
+	lock_acquire (lock);
+	return true;
+}
+
+/* Undoes vm_lock_acquire(), which returned LOCKED. */
+void
+vm_lock_release (bool locked) {
+	if (locked)
+		lock_release (&thread_current ()->process->vm_lock);
+}
+
 /* Helpers */
-static struct frame *vm_get_victim (void);
+static struct frame *vm_get_victim (struct process *owner);
 static bool vm_do_claim_page (struct page *page);
-static struct frame *vm_evict_frame (void);
+static bool vm_claim (struct page *page);
+static struct frame *vm_evict_frame (struct process *owner);
+static void vm_split_huge (struct page *page);
 
 /* Create the pending page object with initializer. If you want to create a
  * page, do not create it directly and make it through this function or
@@ -44,100 +273,2111 @@ bool
 vm_alloc_page_with_initializer (enum vm_type type, void *upage, bool writable,
 		vm_initializer *init, void *aux) {
 
-	ASSERT (VM_TYPE(type) != VM_UNINIT)
+	ASSERT (VM_TYPE(type) != VM_UNINIT);
 
-	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct supplemental_page_table *spt = &thread_current ()->process->spt;
+	bool (*initializer) (struct page *, enum vm_type, void *);
+	struct page *page;
+
+	upage = pg_round_down (upage);
 
 	/* Check wheter the upage is already occupied or not. */
 	if (spt_find_page (spt, upage) == NULL) {
-		/* TODO: Create the page, fetch the initialier according to the VM type,
-		 * TODO: and then create "uninit" page struct by calling uninit_new. You
-		 * TODO: should modify the field after calling the uninit_new. */
+		switch (VM_TYPE (type)) {
+			case VM_ANON:
+				initializer = anon_initializer;
+				break;
+			case VM_FILE:
+				initializer = file_backed_initializer;
+				break;
+			case VM_SHM:
+				initializer = shm_initializer;
+				break;
+			default:
+				goto err;
+		}
+
+		page = kmem_cache_alloc (page_cache);
+		if (page == NULL)
+			goto err;
+		uninit_new (page, upage, init, type, aux, initializer);
+		page->owner = thread_current ()->process;
+		page->writable = writable;
 
-		/* TODO: Insert the page into the spt. */
+		if (!spt_insert_page (spt, page)) {
+			kmem_cache_free (page_cache, page);
+			goto err;
+		}
+		return true;
 	}
 err:
 	return false;
 }
 
+/* Number of entries in a node of the supplemental page table, and
+ * bytes of address space covered by a leaf. */
+#define SPT_FANOUT (PGSIZE / sizeof (void *))
+#define SPT_LEAF_SPAN (SPT_FANOUT * PGSIZE)
+
+/* Returns the leaf node covering VA in SPT.  If the path to it does
+ * not exist, creates it if CREATE is true or returns a null pointer
+ * otherwise; a null pointer is also returned if memory runs out.
+ * Unlike spt_slot(), this leaves the hint alone, so that threads
+ * outside SPT's process, which do not hold its vm_lock, can look
+ * pages up. */
+static struct page **
+spt_leaf (struct supplemental_page_table *spt, const void *va, bool create) {
+	void **node;
+	unsigned shift;
+
+	if (spt->root == NULL) {
+		if (!create || (spt->root = palloc_get_page (PAL_ZERO)) == NULL)
+			return NULL;
+	}
+
+	/* Walk the PML4, PDPT and page directory levels down to the
+	 * leaf, as pml4e_walk() does. */
+	node = spt->root;
+	for (shift = PML4SHIFT; shift > PTXSHIFT; shift -= PTXSHIFT - 3) {
+		void **next = &node[((uintptr_t) va >> shift) & (SPT_FANOUT - 1)];
+
+		if (*next == NULL
+				&& (!create || (*next = palloc_get_page (PAL_ZERO)) == NULL))
+			return NULL;
+		node = *next;
+	}
+	return (struct page **) node;
+}
+
+/* Returns the leaf entry for VA in SPT, creating the path to it if
+ * CREATE is true, like spt_leaf(). */
+static struct page **
+spt_slot (struct supplemental_page_table *spt, const void *va, bool create) {
+	uintptr_t base = (uintptr_t) va & ~(SPT_LEAF_SPAN - 1);
+	struct page **leaf;
+
+	if (spt->hint != NULL && spt->hint_base == base)
+		return &spt->hint[PTX (va)];
+
+	leaf = spt_leaf (spt, va, create);
+	if (leaf == NULL)
+		return NULL;
+	spt->hint = leaf;
+	spt->hint_base = base;
+	return &leaf[PTX (va)];
+}
+
 /* Find VA from spt and return page. On error, return NULL. */
 struct page *
-spt_find_page (struct supplemental_page_table *spt UNUSED, void *va UNUSED) {
-	struct page *page = NULL;
-	/* TODO: Fill this function. */
+spt_find_page (struct supplemental_page_table *spt, void *va) {
+	struct page **slot;
 
-	return page;
+	if (!is_user_vaddr (va))
+		return NULL;
+	slot = spt_slot (spt, va, false);
+	return slot != NULL ? *slot : NULL;
 }
 
 /* Insert PAGE into spt with validation. */
 bool
-spt_insert_page (struct supplemental_page_table *spt UNUSED,
-		struct page *page UNUSED) {
-	int succ = false;
-	/* TODO: Fill this function. */
+spt_insert_page (struct supplemental_page_table *spt,
+		struct page *page) {
+	struct page **slot;
 
-	return succ;
+	ASSERT (pg_ofs (page->va) == 0);
+
+	if (!is_user_vaddr (page->va))
+		return false;
+	slot = spt_slot (spt, page->va, true);
+	if (slot == NULL || *slot != NULL)
+		return false;
+	*slot = page;
+	return true;
 }
 
+/* Removes PAGE from SPT and frees it. */
 void
 spt_remove_page (struct supplemental_page_table *spt, struct page *page) {
+	struct page **slot = spt_slot (spt, page->va, false);
+
+	ASSERT (slot != NULL && *slot == page);
+	*slot = NULL;
 	vm_dealloc_page (page);
+}
+
+/* Calls ACTION on each page in the subtree NODE of LEVELS levels,
+ * in order of address, stopping early if ACTION returns false.
+ * ACTION may remove the page it is called on. */
+static bool
+spt_node_for_each (void **node, int levels, spt_action_func *action,
+		void *aux) {
+	for (size_t i = 0; i < SPT_FANOUT; i++) {
+		if (node[i] == NULL)
+			continue;
+		if (levels > 1) {
+			if (!spt_node_for_each (node[i], levels - 1, action, aux))
+				return false;
+		} else if (!action (node[i], aux))
+			return false;
+	}
 	return true;
 }
 
-/* Get the struct frame, that will be evicted. */
+/* Calls ACTION with AUX on each page in SPT, in order of address.
+ * Stops and returns false as soon as ACTION returns false; returns
+ * true otherwise.  ACTION may remove the page it is called on from
+ * SPT, but must not insert pages. */
+bool
+spt_for_each (struct supplemental_page_table *spt, spt_action_func *action,
+		void *aux) {
+	return spt->root == NULL || spt_node_for_each (spt->root, 4, action, aux);
+}
+
+/* Frees the pages in the subtree NODE of LEVELS levels, in order of
+ * address, and then the subtree itself.  The path to each page stays
+ * in place until the page is gone, for spt_leaf() to find. */
+static void
+spt_node_kill (void **node, int levels) {
+	for (size_t i = 0; i < SPT_FANOUT; i++) {
+		void *entry = node[i];
+
+		if (entry == NULL)
+			continue;
+		if (levels > 1)
+			spt_node_kill (entry, levels - 1);
+		else {
+			node[i] = NULL;
+			vm_dealloc_page (entry);
+		}
+	}
+	palloc_free_page (node);
+}
+
+/* Returns the frame after E in clock order, wrapping around at
+ * the end of the frame table. */
+static struct list_elem *
+clock_next (struct list_elem *e) {
+	e = list_next (e);
+	return e != list_end (&frame_table) ? e : list_begin (&frame_table);
+}
+
+/* Adds FRAME to the frame table just behind the clock hand, so that
+ * it is the last frame the hand comes back to. */
+static void
+frame_table_insert (struct frame *frame) {
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+
+	list_insert (clock_hand, &frame->elem);
+	if (clock_hand == list_end (&frame_table))
+		clock_hand = list_begin (&frame_table);
+}
+
+/* Removes FRAME from the frame table. */
+static void
+frame_table_remove (struct frame *frame) {
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+
+	if (clock_hand == &frame->elem)
+		clock_hand = list_next (clock_hand);
+	if (ksm_hand == &frame->elem)
+		ksm_hand = list_next (ksm_hand);
+	if (ws_hand == &frame->elem)
+		ws_hand = list_next (ws_hand);
+	list_remove (&frame->elem);
+	if (clock_hand == list_end (&frame_table))
+		clock_hand = list_begin (&frame_table);
+}
+
+/* Returns true if any page mapping FRAME has been accessed since
+ * the last call that cleared the accessed bits, and clears them if
+ * CLEAR is true. */
+static bool
+frame_accessed (struct frame *frame, bool clear) {
+	bool accessed = frame->referenced;
+
+	if (accessed && !clear)
+		return true;
+	frame->referenced = false;
+	for (struct list_elem *e = list_begin (&frame->pages);
+			e != list_end (&frame->pages); e = list_next (e)) {
+		struct page *p = list_entry (e, struct page, share_elem);
+		uint64_t *pml4 = p->owner->pml4;
+
+		if (pml4_is_accessed (pml4, p->va)) {
+			accessed = true;
+			if (!clear)
+				break;
+			pml4_set_accessed (pml4, p->va, false);
+		}
+	}
+	return accessed;
+}
+
+/* Returns true if FRAME holds changes that evicting it would have to
+ * write out. */
+static bool
+frame_dirty (struct frame *frame) {
+	for (struct list_elem *e = list_begin (&frame->pages);
+			e != list_end (&frame->pages); e = list_next (e)) {
+		struct page *p = list_entry (e, struct page, share_elem);
+
+		if (p->dirty || pml4_is_dirty (p->owner->pml4, p->va))
+			return true;
+	}
+	return false;
+}
+
+/* Get the struct frame, that will be evicted.
+ *
+ * This is the second-chance clock, refined to prefer clean pages.
+ * Each sweep of the table first looks for a page that was neither
+ * accessed nor modified, which costs no write to evict, leaving the
+ * accessed bits alone; failing that, it looks for any page that was
+ * not accessed, clearing accessed bits as it passes.  Two sweeps
+ * therefore always find a victim unless every frame is pinned, in
+ * which case this returns NULL.  Pages mapped by a huge page are
+ * passed over by the first two sweeps; after that, each one met has
+ * its huge page split, and is then treated like any other.
+ *
+ * If OWNER is nonnull, only frames that OWNER's pages alone map are
+ * considered. */
 static struct frame *
-vm_get_victim (void) {
-	struct frame *victim = NULL;
-	 /* TODO: The policy for eviction is up to you. */
+vm_get_victim (struct process *owner) {
+	size_t cnt = list_size (&frame_table);
 
-	return victim;
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+
+	for (int pass = 0; pass < 4; pass++) {
+		bool want_clean = pass % 2 == 0;
+
+		for (size_t i = 0; i < cnt; i++) {
+			struct frame *frame = list_entry (clock_hand, struct frame, elem);
+
+			clock_hand = clock_next (clock_hand);
+			if (frame->pin_cnt > 0 || (frame->share_cnt != 1
+						&& frame->cache != &file_cache
+						&& VM_TYPE (frame->page->operations->type) != VM_SHM))
+				continue;
+			if (owner != NULL && (frame->share_cnt != 1
+						|| frame->page->owner != owner))
+				continue;
+			if (frame->page->huge) {
+				if (pass < 2)
+					continue;
+				vm_split_huge (frame->page);
+			}
+			if (frame_accessed (frame, !want_clean))
+				continue;
+			if (want_clean && frame_dirty (frame))
+				continue;
+			return frame;
+		}
+	}
+	return NULL;
 }
 
-/* Evict one page and return the corresponding frame.
+/* Evict one page and return the corresponding frame, one of
+ * OWNER's if OWNER is nonnull.
  * Return NULL on error.*/
 static struct frame *
-vm_evict_frame (void) {
-	struct frame *victim UNUSED = vm_get_victim ();
-	/* TODO: swap out the victim and return the evicted frame. */
+vm_evict_frame (struct process *owner) {
+	struct frame *victim = vm_get_victim (owner);
+	struct page *page;
+	struct list_elem *e;
 
-	return NULL;
+	if (victim == NULL)
+		return NULL;
+	page = victim->page;
+
+	/* Unmap the pages before writing the frame out, so that their
+	 * owners cannot change it behind our back, and fold the hardware
+	 * dirty bits into the page for swap_out() to look at.  Only a
+	 * frame of a mapped file or a shared memory segment has more than
+	 * one page here; any of them can write it out. */
+	for (e = list_begin (&victim->pages); e != list_end (&victim->pages);
+			e = list_next (e)) {
+		struct page *p = list_entry (e, struct page, share_elem);
+		uint64_t *pml4 = p->owner->pml4;
+
+		if (p->dirty || pml4_is_dirty (pml4, p->va))
+			page->dirty = true;
+		pml4_clear_page (pml4, p->va);
+	}
+
+	if (!swap_out (page)) {
+		/* The page gets write access back. */
+		if (victim->cache == &ksm_cache)
+			cache_remove (victim);
+		for (e = list_begin (&victim->pages); e != list_end (&victim->pages);
+				e = list_next (e)) {
+			struct page *p = list_entry (e, struct page, share_elem);
+
+			pml4_set_page (p->owner->pml4, p->va, victim->kva, p->writable);
+		}
+		return NULL;
+	}
+
+	vmstat_count_spt (page->owner, evictions);
+	frame_table_remove (victim);
+	cache_remove (victim);
+	while (!list_empty (&victim->pages)) {
+		struct page *p = list_entry (list_pop_front (&victim->pages),
+				struct page, share_elem);
+
+		p->frame = NULL;
+		p->owner->spt.rss--;
+	}
+	victim->page = NULL;
+	victim->share_cnt = 0;
+	return victim;
 }
 
 /* palloc() and get frame. If there is no available page, evict the page
  * and return it. This always return valid address. That is, if the user pool
  * memory is full, this function evicts the frame to get the available memory
- * space.*/
+ * space.
+ *
+ * The frame is returned pinned and already in the frame table.  It is
+ * for a page of OWNER, which if it is at its resident set limit gets
+ * the frame of one of its own pages.  If none of those can be evicted,
+ * because they are all pinned or shared, OWNER gets a free frame
+ * anyway and goes over its limit, as waiting for one of its own pages
+ * to come free could wait forever; the next fault at the limit tries
+ * local reclaim again. */
 static struct frame *
-vm_get_frame (void) {
+vm_get_frame (struct process *owner) {
+	struct supplemental_page_table *spt = &owner->spt;
 	struct frame *frame = NULL;
-	/* TODO: Fill this function. */
+	void *kva;
+
+	lock_acquire (&frame_lock);
+	if (spt->rss_limit != 0 && spt->rss >= spt->rss_limit)
+		frame = vm_evict_frame (owner);
+	if (frame == NULL && (kva = palloc_get_page (PAL_USER)) != NULL) {
+		frame = kmem_cache_alloc (frame_cache);
+		if (frame != NULL)
+			frame->kva = kva;
+		else
+			palloc_free_page (kva);
+	} else if (frame == NULL)
+		frame = vm_evict_frame (NULL);
+
+	if (frame != NULL) {
+		frame->page = NULL;
+		frame->pin_cnt = 1;
+		list_init (&frame->pages);
+		frame->share_cnt = 0;
+		frame->cache = NULL;
+		frame->ksm_sum = 0;
+		frame->referenced = false;
+		frame_table_insert (frame);
+	}
+	lock_release (&frame_lock);
+	kswapd_poke ();
 
-	ASSERT (frame != NULL);
-	ASSERT (frame->page == NULL);
+	ASSERT (frame == NULL || frame->page == NULL);
 	return frame;
 }
 
-/* Growing the stack. */
+/* Returns the number of free frames in the user pool. */
+static size_t
+free_frames (void) {
+	struct memstat ms;
+
+	palloc_get_stats (&ms);
+	return ms.user_free;
+}
+
+/* Wakes kswapd if free frames have run low. */
 static void
-vm_stack_growth (void *addr UNUSED) {
+kswapd_poke (void) {
+	if (!kswapd_sleeping || free_frames () >= kswapd_low)
+		return;
+	if (atomic_xchg (&kswapd_sleeping, 0))
+		sema_up (&kswapd_sema);
 }
 
-/* Handle the fault on write_protected page */
+/* Body of the kswapd thread. */
+static void
+kswapd (void *aux UNUSED) {
+	/* Keep our swap-outs behind the faults of running processes. */
+	thread_set_ioprio (IOPRIO_IDLE);
+	for (;;) {
+		bool stuck = false;
+		size_t free_cnt;
+
+		while (!stuck && (free_cnt = free_frames ()) < kswapd_high) {
+			/* Pages that the caches borrowed come back without any
+			 * I/O, so ask for them before evicting anything. */
+			if (palloc_shrink (kswapd_high - free_cnt) > 0)
+				continue;
+			lock_acquire (&frame_lock);
+			for (int i = 0; i < KSWAPD_BATCH; i++) {
+				struct frame *frame = vm_evict_frame (NULL);
+
+				if (frame == NULL) {
+					stuck = true;
+					break;
+				}
+				palloc_free_page (frame->kva);
+				kmem_cache_free (frame_cache, frame);
+			}
+			lock_release (&frame_lock);
+		}
+
+		/* Sleep until kswapd_poke() finds free frames running low.
+		 * Only one poke, from whichever CPU, clears the flag, and a
+		 * wakeup that comes before we sleep is kept by the
+		 * semaphore. */
+		atomic_xchg (&kswapd_sleeping, 1);
+		sema_down (&kswapd_sema);
+	}
+}
+
+/* Counts the pages accessed since they were last looked at toward
+ * the working sets of their processes, and clears their accessed
+ * bits, for the next WS_SCAN_BATCH frames of the current pass.  Runs
+ * as ws_work, again at once until the pass is done and then every
+ * WS_SCAN_TICKS. */
+static void
+ws_scan (void *aux UNUSED) {
+	unsigned epoch = ws_epoch + 1;
+	bool done = false;
+
+	lock_acquire (&frame_lock);
+	if (!ws_in_pass) {
+		ws_in_pass = true;
+		ws_pass_total = 0;
+		ws_hand = list_begin (&frame_table);
+	}
+	for (int i = 0; i < WS_SCAN_BATCH && ws_hand != list_end (&frame_table);
+			i++) {
+		struct frame *frame = list_entry (ws_hand, struct frame, elem);
+
+		ws_hand = list_next (ws_hand);
+		for (struct list_elem *e = list_begin (&frame->pages);
+				e != list_end (&frame->pages); e = list_next (e)) {
+			struct page *p = list_entry (e, struct page, share_elem);
+			struct supplemental_page_table *spt = &p->owner->spt;
+
+			if (!p->huge) {
+				if (!pml4_is_accessed (p->owner->pml4, p->va))
+					continue;
+				pml4_set_accessed (p->owner->pml4, p->va, false);
+				frame->referenced = true;
+			}
+			if (spt->ws_epoch != epoch) {
+				spt->ws_prev = spt->ws_epoch == ws_epoch ? spt->ws_cnt : 0;
+				spt->ws_epoch = epoch;
+				spt->ws_cnt = 0;
+			}
+			spt->ws_cnt++;
+			ws_pass_total++;
+		}
+	}
+	if (ws_hand == list_end (&frame_table)) {
+		ws_in_pass = false;
+		ws_epoch = epoch;
+		ws_total = ws_pass_total;
+		done = true;
+	}
+	lock_release (&frame_lock);
+	queue_delayed_work (WQ_NORMAL, &ws_work, done ? WS_SCAN_TICKS : 0);
+}
+
+/* Removes FRAME from the frame table and frees it. */
+static void
+frame_free (struct frame *frame) {
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+
+	frame_table_remove (frame);
+	cache_remove (frame);
+	palloc_free_page (frame->kva);
+	kmem_cache_free (frame_cache, frame);
+}
+
+/* Links PAGE to FRAME, as one more page mapping it. */
+static void
+frame_attach (struct frame *frame, struct page *page) {
+	list_push_back (&frame->pages, &page->share_elem);
+	frame->share_cnt++;
+	frame->page = page;
+	page->frame = frame;
+	page->owner->spt.rss++;
+}
+
+/* Unlinks PAGE from its frame.  Returns true if that was the last
+ * page mapping the frame. */
 static bool
-vm_handle_wp (struct page *page UNUSED) {
+frame_detach (struct page *page) {
+	struct frame *frame = page->frame;
+
+	list_remove (&page->share_elem);
+	page->frame = NULL;
+	page->owner->spt.rss--;
+	if (--frame->share_cnt == 0) {
+		frame->page = NULL;
+		return true;
+	}
+	frame->page = list_entry (list_front (&frame->pages), struct page,
+			share_elem);
+	return false;
 }
 
-/* Return true on success */
+/* Unmaps PAGE from its owner's address space and frees its frame,
+ * if it has one and no one else shares it.  The contents are lost;
+ * the caller must have written them back if needed. */
+void
+vm_release_frame (struct page *page) {
+	struct vm_teardown *td = page->owner->spt.teardown;
+	uint64_t *pml4 = page->owner->pml4;
+
+	/* A dying address space keeps its PTEs: its page tables go away
+	 * whole, without freeing what they map. */
+	if (td != NULL)
+		pml4 = NULL;
+
+	lock_acquire (&frame_lock);
+	if (page->huge)
+		vm_split_huge (page);
+	if (page->frame != NULL) {
+		struct frame *frame = page->frame;
+
+		if (page->mlocked) {
+			frame->pin_cnt--;
+			page->mlocked = false;
+		}
+		if (pml4 != NULL)
+			pml4_clear_page (pml4, page->va);
+		if (frame_detach (page)) {
+			if (td == NULL)
+				frame_free (frame);
+			else {
+				frame_table_remove (frame);
+				cache_remove (frame);
+				list_push_back (&td->frames, &frame->elem);
+			}
+		}
+	} else if (pml4 != NULL && pml4_get_page (pml4, page->va) == zero_page) {
+		/* Keep pml4_destroy() from freeing the zero page. */
+		pml4_clear_page (pml4, page->va);
+	}
+	lock_release (&frame_lock);
+}
+
+/* Unmaps PAGE, a page of a shared memory segment, from its owner's
+ * address space.  If it was the last page mapping its frame, the
+ * frame leaves the frame table but stays with the segment, to be
+ * mapped again or freed with vm_free_shm_frame(). */
+void
+vm_release_shm_frame (struct page *page) {
+	uint64_t *pml4 = page->owner->spt.teardown == NULL
+		? page->owner->pml4 : NULL;
+
+	lock_acquire (&frame_lock);
+	if (page->frame != NULL) {
+		struct frame *frame = page->frame;
+
+		if (page->mlocked) {
+			frame->pin_cnt--;
+			page->mlocked = false;
+		}
+		if (pml4 != NULL)
+			pml4_clear_page (pml4, page->va);
+		if (frame_detach (page))
+			frame_table_remove (frame);
+	}
+	lock_release (&frame_lock);
+}
+
+/* Frees FRAME, a frame of a shared memory segment that no page maps,
+ * as left by vm_release_shm_frame(). */
+void
+vm_free_shm_frame (struct frame *frame) {
+	ASSERT (frame->share_cnt == 0);
+
+	palloc_free_page (frame->kva);
+	kmem_cache_free (frame_cache, frame);
+}
+
+/* Makes sure PAGE is in memory and pins its frame, so that the
+ * kernel can use its contents through the frame's KVA.  Returns
+ * false if the page cannot be brought in. */
+bool
+vm_pin_page (struct page *page) {
+	for (;;) {
+		lock_acquire (&frame_lock);
+		if (page->frame != NULL) {
+			page->frame->pin_cnt++;
+			lock_release (&frame_lock);
+			return true;
+		}
+		lock_release (&frame_lock);
+
+		/* The page may be evicted again before we retake the
+		 * lock, hence the loop. */
+		if (!vm_claim (page))
+			return false;
+	}
+}
+
+/* Pins PAGE's frame like vm_pin_page(), but only if PAGE is in
+ * memory already.  Returns true if so. */
+bool
+vm_pin_resident_page (struct page *page) {
+	bool resident;
+
+	lock_acquire (&frame_lock);
+	resident = page->frame != NULL;
+	if (resident)
+		page->frame->pin_cnt++;
+	lock_release (&frame_lock);
+	return resident;
+}
+
+/* Lets PAGE, pinned by vm_pin_page(), be evicted again. */
+void
+vm_unpin_page (struct page *page) {
+	lock_acquire (&frame_lock);
+	ASSERT (page->frame != NULL && page->frame->pin_cnt > 0);
+	page->frame->pin_cnt--;
+	lock_release (&frame_lock);
+}
+
+/* Returns true if every address from ADDR up to ADDR + LENGTH is in
+ * user space and has a page, growing the stack if needed. */
+static bool
+vm_range_mapped (const void *addr, size_t length) {
+	const uint8_t *va = pg_round_down (addr);
+
+	if (!is_user_vaddr (addr) || length > KERN_BASE - (uint64_t) addr)
+		return false;
+	for (; va < (const uint8_t *) addr + length; va += PGSIZE)
+		if (!vm_grow_stack (va))
+			return false;
+	return true;
+}
+
+/* Locks the pages from ADDR up to ADDR + LENGTH in memory, for
+ * mlock(): each is brought in and its frame pinned until munlock()
+ * or the page goes away.  Returns false if part of the range has no
+ * page, or a page cannot be brought in; the pages locked so far stay
+ * locked. */
+bool
+vm_mlock (void *addr, size_t length) {
+	struct supplemental_page_table *spt = &thread_current ()->process->spt;
+	bool locked = vm_lock_acquire ();
+	bool success = pg_ofs (addr) == 0 && vm_range_mapped (addr, length);
+	uint8_t *va;
+
+	for (va = addr; success && va < (uint8_t *) addr + length;
+			va += PGSIZE) {
+		struct page *page = spt_find_page (spt, va);
+
+		if (page->mlocked)
+			continue;
+		success = vm_pin_page (page);
+		page->mlocked = success;
+	}
+	vm_lock_release (locked);
+	return success;
+}
+
+/* Undoes vm_mlock() for the pages from ADDR up to ADDR + LENGTH.
+ * Pages that are not locked are skipped.  Returns false if the range
+ * is bad. */
+bool
+vm_munlock (void *addr, size_t length) {
+	struct supplemental_page_table *spt = &thread_current ()->process->spt;
+	bool locked = vm_lock_acquire ();
+	bool success = pg_ofs (addr) == 0 && vm_range_mapped (addr, length);
+	uint8_t *va;
+
+	for (va = addr; success && va < (uint8_t *) addr + length;
+			va += PGSIZE) {
+		struct page *page = spt_find_page (spt, va);
+
+		if (page->mlocked) {
+			page->mlocked = false;
+			vm_unpin_page (page);
+		}
+	}
+	vm_lock_release (locked);
+	return success;
+}
+
+/* Returns true if PAGE is mapped with write access. */
+static bool
+is_mapped_writable (struct page *page) {
+	uint64_t *pte = pml4e_walk (page->owner->pml4, (uint64_t) page->va, false);
+
+	return pte != NULL && (*pte & PTE_P) != 0 && is_writable (pte);
+}
+
+static bool vm_handle_wp (struct page *page);
+
+/* Pins the pages of the user buffer BUFFER of SIZE bytes, so that a
+ * system call can copy to or from it holding locks, without faults
+ * in the middle.  If WRITE is true, the kernel is going to write to
+ * the buffer, which must then be writable; any copy-on-write is done
+ * up front.  Returns false, with nothing pinned, if part of the
+ * buffer is not a valid place to read or write. */
+bool
+vm_pin_buffer (const void *buffer, size_t size, bool write) {
+	struct supplemental_page_table *spt = &thread_current ()->process->spt;
+	const uint8_t *va;
+	bool locked;
+
+	if (size == 0)
+		return true;
+	locked = vm_lock_acquire ();
+	if (!vm_range_mapped (buffer, size)) {
+		vm_lock_release (locked);
+		return false;
+	}
+	for (va = pg_round_down (buffer); va < (const uint8_t *) buffer + size;
+			va += PGSIZE) {
+		struct page *page = spt_find_page (spt, (void *) va);
+
+		if ((write && !page->writable)
+				|| (write && !is_mapped_writable (page) && !vm_handle_wp (page))
+				|| !vm_pin_page (page)) {
+			if (va > (const uint8_t *) pg_round_down (buffer))
+				vm_unpin_buffer (buffer, va - (const uint8_t *) buffer);
+			vm_lock_release (locked);
+			return false;
+		}
+	}
+	vm_lock_release (locked);
+	return true;
+}
+
+/* Unpins a buffer pinned by vm_pin_buffer(). */
+void
+vm_unpin_buffer (const void *buffer, size_t size) {
+	struct supplemental_page_table *spt = &thread_current ()->process->spt;
+	bool locked = vm_lock_acquire ();
+	const uint8_t *va;
+
+	for (va = pg_round_down (buffer); va < (const uint8_t *) buffer + size;
+			va += PGSIZE)
+		vm_unpin_page (spt_find_page (spt, (void *) va));
+	vm_lock_release (locked);
+}
+
+/* Stack growth.  The stack may grow down to STACK_MAX bytes below
+ * USER_STACK, through the region setup_stack() reserves for it, which
+ * nothing else may map into.  An access to an unmapped page there counts as growth
+ * if it is at or above the stack pointer, or at most 8 bytes below
+ * it for PUSH.  Since a program that grows its stack usually goes on
+ * growing it, as with a big local array, a growth fault creates the
+ * faulting page and up to stack_growth_window - 1 more below it in
+ * one go, bringing them all in while free frames are plentiful.  The
+ * pages from the fault up to the old bottom of the stack are created
+ * too, so that the stack never has holes. */
+
+/* Number of pages the stack grows by per fault. */
+size_t stack_growth_window = 8;
+
+/* Returns the stack region if an access to ADDR, in AREA, with the
+ * stack pointer at RSP, should grow the stack, or NULL otherwise. */
+static struct vm_area *
+is_stack_growth (struct vm_area *area, const void *addr, uintptr_t rsp) {
+	if (area == NULL || !(area->type & VM_STACK)
+			|| (uintptr_t) addr + 8 < rsp)
+		return NULL;
+	return area;
+}
+
+/* Growing the stack, whose region is AREA. */
+static bool
+vm_stack_growth (struct vm_area *area, void *addr) {
+	struct supplemental_page_table *spt = &thread_current ()->process->spt;
+	uint8_t *fault = pg_round_down (addr);
+	uint8_t *bottom = fault;
+	uint8_t *va;
+
+	/* Go down by the window, but not past the limit. */
+	for (size_t i = 1; i < stack_growth_window; i++) {
+		if (bottom == area->start
+				|| spt_find_page (spt, bottom - PGSIZE) != NULL)
+			break;
+		bottom -= PGSIZE;
+	}
+
+	for (va = bottom; va < area->end
+			&& spt_find_page (spt, va) == NULL; va += PGSIZE)
+		if (!vm_alloc_page (VM_ANON | VM_STACK, va, true))
+			return false;
+
+	/* The faulting page must come in; the rest only if it is cheap. */
+	if (!vm_claim_page (fault))
+		return false;
+	for (va = bottom; va < fault; va += PGSIZE)
+		if (free_frames () < kswapd_high || !vm_claim_page (va))
+			break;
+	return true;
+}
+
+/* Grows the stack down to ADDR, a user address a system call was
+ * given, if it lies in the stack above the caller's stack pointer.
+ * Returns true if ADDR has a page now. */
+bool
+vm_grow_stack (const void *addr) {
+	struct thread *cur = thread_current ();
+	bool locked = vm_lock_acquire ();
+	struct vm_area *area;
+	bool success = true;
+
+	if (spt_find_page (&cur->process->spt, (void *) addr) == NULL) {
+		area = is_stack_growth (vm_area_find (&cur->process->spt, addr), addr,
+				cur->user_rsp);
+		success = area != NULL && vm_stack_growth (area, (void *) addr);
+	}
+	vm_lock_release (locked);
+	return success;
+}
+
+/* Handle the fault on write_protected page
+ *
+ * This is the copy in copy-on-write: PAGE is writable but mapped
+ * read-only because its frame is shared.  If it is the last page on
+ * the frame, it simply gets write access back; otherwise it moves to
+ * a private copy of the frame.  The other sharers can go away while
+ * the copy is being allocated, so both cases are checked again once
+ * it has been.  A frame left to PAGE alone also leaves any cache it
+ * is in, since its contents are about to change. */
+static bool
+vm_handle_wp (struct page *page) {
+	uint64_t *pml4 = page->owner->pml4;
+	struct frame *old, *new;
+	bool last;
+
+	/* First write to a page that was reading the zero page. */
+	if (page->frame == NULL && pml4_get_page (pml4, page->va) == zero_page)
+		return vm_do_claim_page (page);
+
+	lock_acquire (&frame_lock);
+	old = page->frame;
+	if (old == NULL || old->share_cnt == 1) {
+		/* Evicted since the fault, in which case retrying the
+		 * access faults it back in, or no longer shared. */
+		if (old != NULL) {
+			cache_remove (old);
+			pml4_protect_range (pml4, page->va, 1, true);
+		}
+		lock_release (&frame_lock);
+		return true;
+	}
+	old->pin_cnt++;
+	lock_release (&frame_lock);
+
+	new = vm_get_frame (page->owner);
+
+	lock_acquire (&frame_lock);
+	old->pin_cnt--;
+	if (new == NULL) {
+		lock_release (&frame_lock);
+		return false;
+	}
+
+	/* The other sharers may have let go of OLD while we had no lock,
+	 * in which case it is ours alone and the copy is not needed. */
+	if (old->share_cnt == 1) {
+		frame_free (new);
+		cache_remove (old);
+		pml4_protect_range (pml4, page->va, 1, true);
+		lock_release (&frame_lock);
+		return true;
+	}
+	fpu_copy_page (new->kva, old->kva);
+	pml4_clear_page (pml4, page->va);
+	last = frame_detach (page);
+	frame_attach (new, page);
+	pml4_set_page (pml4, page->va, new->kva, true);
+	if (page->mlocked)
+		old->pin_cnt--;
+	else
+		new->pin_cnt--;
+	if (last)
+		frame_free (old);
+	lock_release (&frame_lock);
+	return true;
+}
+
+/* Maps the zero page at PAGE, if PAGE is an anonymous page that has
+ * never been touched.  Returns true if successful. */
+static bool
+vm_map_zero_page (struct page *page) {
+	if (VM_TYPE (page->operations->type) != VM_UNINIT
+			|| VM_TYPE (page->uninit.type) != VM_ANON
+			|| page->uninit.init != NULL)
+		return false;
+	return pml4_set_page (page->owner->pml4, page->va, zero_page, false);
+}
+
+/* Returns the hash of page cache frame E. */
+static uint64_t
+cache_hash (const struct ohash_elem *e, void *aux UNUSED) {
+	const struct frame *f = ohash_entry (e, struct frame, cache_elem);
+
+	return hash_u64 (hash_ptr (f->inode) ^ f->ofs ^ (f->read_bytes << 48));
+}
+
+/* Orders page cache frames A and B by their source. */
+static bool
+cache_less (const struct ohash_elem *a_, const struct ohash_elem *b_,
+		void *aux UNUSED) {
+	const struct frame *a = ohash_entry (a_, struct frame, cache_elem);
+	const struct frame *b = ohash_entry (b_, struct frame, cache_elem);
+
+	if (a->inode != b->inode)
+		return a->inode < b->inode;
+	if (a->ofs != b->ofs)
+		return a->ofs < b->ofs;
+	return a->read_bytes < b->read_bytes;
+}
+
+/* Returns the frame in CACHE loaded from READ_BYTES bytes of INODE
+ * at OFS, or NULL. */
+static struct frame *
+cache_lookup (struct ohash *cache, struct inode *inode, off_t ofs,
+		size_t read_bytes) {
+	struct frame key;
+	struct ohash_elem *e;
+
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+
+	key.inode = inode;
+	key.ofs = ofs;
+	key.read_bytes = read_bytes;
+	e = ohash_find (cache, &key.cache_elem);
+	return e != NULL ? ohash_entry (e, struct frame, cache_elem) : NULL;
+}
+
+/* Adds FRAME, loaded from READ_BYTES bytes of INODE at OFS, to
+ * CACHE, unless it already holds a frame from there.  Returns true
+ * if successful, in which case the cache owns the reference to
+ * INODE. */
+static bool
+cache_insert (struct ohash *cache, struct frame *frame, struct inode *inode,
+		off_t ofs, size_t read_bytes) {
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+	ASSERT (frame->cache == NULL);
+
+	frame->inode = inode;
+	frame->ofs = ofs;
+	frame->read_bytes = read_bytes;
+	if (ohash_insert (cache, &frame->cache_elem) != NULL)
+		return false;
+	frame->cache = cache;
+	return true;
+}
+
+/* Drops FRAME from its page cache, if it is in one. */
+static void
+cache_remove (struct frame *frame) {
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+
+	if (frame->cache != NULL) {
+		ohash_delete (frame->cache, &frame->cache_elem);
+		inode_close (frame->inode);
+		frame->cache = NULL;
+	}
+}
+
+/* Returns the hash of ksm_cache frame E. */
+static uint64_t
+ksm_hash (const struct ohash_elem *e, void *aux UNUSED) {
+	return hash_u64 (ohash_entry (e, struct frame, cache_elem)->ksm_sum);
+}
+
+/* Orders ksm_cache frames A and B by their contents. */
+static bool
+ksm_less (const struct ohash_elem *a_, const struct ohash_elem *b_,
+		void *aux UNUSED) {
+	const struct frame *a = ohash_entry (a_, struct frame, cache_elem);
+	const struct frame *b = ohash_entry (b_, struct frame, cache_elem);
+
+	if (a->ksm_sum != b->ksm_sum)
+		return a->ksm_sum < b->ksm_sum;
+	return memcmp (a->kva, b->kva, PGSIZE) < 0;
+}
+
+/* Returns the page mapping FRAME if same-page merging may take it,
+ * or NULL. */
+static struct page *
+ksm_candidate (struct frame *frame) {
+	struct page *page = frame->page;
+
+	if (frame->pin_cnt > 0 || frame->share_cnt != 1 || frame->cache != NULL
+			|| page->huge || VM_TYPE (page->operations->type) != VM_ANON
+			|| page->owner->pml4 == NULL || page->owner->spt.teardown != NULL
+			|| pml4_get_page (page->owner->pml4, page->va) == NULL)
+		return NULL;
+	return page;
+}
+
+/* Merges the page of FRAME into the frame of ksm_cache with the same
+ * contents, freeing FRAME, or else puts FRAME in the cache, if FRAME
+ * is a candidate whose contents have not changed since the last
+ * call.  Returns true if FRAME was freed. */
+static bool
+ksm_merge (struct frame *frame) {
+	struct page *page = ksm_candidate (frame);
+	struct ohash_elem *e;
+	struct frame *stable;
+	uint64_t *pml4;
+	uint32_t sum;
+
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+
+	if (page == NULL)
+		return false;
+	sum = crc32c (0, frame->kva, PGSIZE);
+	if (sum != frame->ksm_sum) {
+		frame->ksm_sum = sum;
+		return false;
+	}
+
+	/* The contents must hold still from here on.  The owner may have
+	 * written them since the CRC, so take it again once it cannot. */
+	pml4 = page->owner->pml4;
+	pml4_protect_range (pml4, page->va, 1, false);
+	sum = crc32c (0, frame->kva, PGSIZE);
+	if (sum != frame->ksm_sum) {
+		frame->ksm_sum = sum;
+		if (page->writable)
+			pml4_protect_range (pml4, page->va, 1, true);
+		return false;
+	}
+
+	e = ohash_find (&ksm_cache, &frame->cache_elem);
+	if (e == NULL) {
+		frame->inode = NULL;
+		ohash_insert (&ksm_cache, &frame->cache_elem);
+		frame->cache = &ksm_cache;
+		return false;
+	}
+
+	/* The page table entry is there already, so mapping the page
+	 * again cannot fail. */
+	stable = ohash_entry (e, struct frame, cache_elem);
+	if (pml4_is_dirty (pml4, page->va))
+		page->dirty = true;
+	pml4_clear_page (pml4, page->va);
+	ASSERT (frame->share_cnt == 1);
+	if (frame_detach (page))
+		frame_free (frame);
+	if (!pml4_set_page (pml4, page->va, stable->kva, false))
+		NOT_REACHED ();
+	frame_attach (stable, page);
+	ksm_merged++;
+	return true;
+}
+
+/* Looks at the next ksm_scan frames of the frame table for pages to
+ * merge.  Runs as ksm_work, every KSM_SCAN_TICKS. */
+static void
+ksm_scan_frames (void *aux UNUSED) {
+	if (ksm_scan != 0) {
+		size_t cnt;
+
+		/* Look at each frame at most once per round. */
+		lock_acquire (&frame_lock);
+		cnt = list_size (&frame_table);
+		if (cnt > ksm_scan)
+			cnt = ksm_scan;
+		for (size_t i = 0; i < cnt; i++) {
+			struct frame *frame;
+
+			if (ksm_hand == list_end (&frame_table))
+				ksm_hand = list_begin (&frame_table);
+			frame = list_entry (ksm_hand, struct frame, elem);
+			ksm_hand = list_next (ksm_hand);
+			ksm_merge (frame);
+		}
+		lock_release (&frame_lock);
+	}
+	queue_delayed_work (WQ_NORMAL, &ksm_work, KSM_SCAN_TICKS);
+}
+
+/* Returns true if PAGE is a page of executable code or read-only
+ * data not loaded yet, which the text cache can hold. */
+static bool
+is_text_page (struct page *page) {
+	return VM_TYPE (page->operations->type) == VM_UNINIT
+		&& VM_TYPE (page->uninit.type) == VM_ANON
+		&& page->uninit.aux != NULL && !page->writable;
+}
+
+/* Closes the file of AUX, which has been used up, and frees it. */
+static void
+load_aux_free (struct vm_load_aux *aux) {
+	file_close (aux->file);
+	free (aux);
+}
+
+/* Transparent huge pages.  With -thp, the first fault in a 2 MB
+ * aligned block of anonymous memory that has never been touched
+ * brings in the whole block at once, in one 2 MB run of frames
+ * mapped by a single page directory entry: one fault and one TLB
+ * entry instead of 512.  Every page of the block must be allocated,
+ * writable and read as zeros, and nothing in the block may be mapped
+ * yet.
+ *
+ * Each 4 kB page of the block still gets a struct frame of its own,
+ * so the frame table and everything built on it see ordinary frames.
+ * Only the mapping differs, and it is split into 4 kB mappings,
+ * through a page table set aside when the block is mapped, before
+ * any page in it is evicted, shared by fork() or freed.  The pages
+ * then go on as before, each on its own. */
+#define HUGE_PAGE_CNT (LARGE_PGSIZE / PGSIZE)
+
+/* Map fresh anonymous memory with huge pages? */
+bool thp_enabled;
+
+/* A 2 MB mapping not split yet. */
+struct huge_map {
+	uintptr_t va;               /* First address mapped. */
+	uint64_t *pt;               /* Page table to split into. */
+	struct list_elem elem;      /* Element in the SPT's huge_maps. */
+};
+
+/* Returns true if PAGE has not been touched yet and can be part of
+ * a huge page, that is, it is writable, anonymous and all zeros. */
+static bool
+is_huge_candidate (struct page *page) {
+	struct vm_load_aux *aux;
+
+	if (page == NULL || !page->writable
+			|| VM_TYPE (page->operations->type) != VM_UNINIT
+			|| VM_TYPE (page->uninit.type) != VM_ANON)
+		return false;
+	aux = page->uninit.aux;
+	return page->uninit.init == NULL || (aux != NULL && aux->read_bytes == 0);
+}
+
+/* Maps the 2 MB block holding PAGE, which is not present, with a
+ * huge page, if the block qualifies and free frames are plentiful.
+ * Returns true if successful; otherwise nothing has changed. */
+static bool
+vm_map_huge (struct page *page) {
+	struct process *cur = thread_current ()->process;
+	uintptr_t base = (uintptr_t) page->va & ~(LARGE_PGSIZE - 1);
+	struct page **leaf;
+	struct huge_map *h = NULL;
+	struct list frames;
+	uint64_t *pt = NULL;
+	uint8_t *kva = NULL;
+	size_t i;
+
+	list_init (&frames);
+	if (!thp_enabled || !is_huge_candidate (page)
+			|| !is_user_vaddr ((void *) (base + LARGE_PGSIZE - 1))
+			|| pml4e_walk (cur->pml4, base, false) != NULL)
+		return false;
+	leaf = spt_leaf (&cur->spt, (void *) base, false);
+	for (i = 0; i < HUGE_PAGE_CNT; i++)
+		if (!is_huge_candidate (leaf[i]))
+			return false;
+	if (free_frames () < HUGE_PAGE_CNT + kswapd_high)
+		return false;
+
+	kva = palloc_get_multiple (PAL_USER | PAL_ZERO, HUGE_PAGE_CNT);
+	if (kva == NULL)
+		compact_poke ();
+	pt = palloc_get_page (0);
+	h = malloc (sizeof *h);
+	if (kva == NULL || pt == NULL || h == NULL
+			|| vtop (kva) % LARGE_PGSIZE != 0)
+		goto fail;
+	for (i = 0; i < HUGE_PAGE_CNT; i++) {
+		struct frame *frame = kmem_cache_alloc (frame_cache);
+
+		if (frame == NULL)
+			goto fail;
+		frame->kva = kva + i * PGSIZE;
+		list_push_back (&frames, &frame->elem);
+	}
+	if (!pml4_map_large (cur->pml4, base, vtop (kva), LARGE_PGSIZE,
+				PTE_U | PTE_W))
+		goto fail;
+
+	/* Nothing can fail from here on.  The load sources are used up,
+	 * and closing their files may take inode locks, which must come
+	 * before frame_lock. */
+	for (i = 0; i < HUGE_PAGE_CNT; i++)
+		if (leaf[i]->uninit.aux != NULL) {
+			load_aux_free (leaf[i]->uninit.aux);
+			leaf[i]->uninit.aux = NULL;
+		}
+
+	h->va = base;
+	h->pt = pt;
+	lock_acquire (&frame_lock);
+	for (i = 0; i < HUGE_PAGE_CNT; i++) {
+		struct page *p = leaf[i];
+		struct frame *frame = list_entry (list_pop_front (&frames),
+				struct frame, elem);
+
+		p->uninit.page_initializer (p, p->uninit.type, NULL);
+		frame->page = NULL;
+		frame->pin_cnt = 0;
+		list_init (&frame->pages);
+		frame->share_cnt = 0;
+		frame->cache = NULL;
+		frame->ksm_sum = 0;
+		frame->referenced = false;
+		frame_table_insert (frame);
+		frame_attach (frame, p);
+		p->huge = true;
+	}
+	list_push_back (&cur->spt.huge_maps, &h->elem);
+	lock_release (&frame_lock);
+	return true;
+
+fail:
+	while (!list_empty (&frames))
+		kmem_cache_free (frame_cache, list_entry (list_pop_front (&frames),
+					struct frame, elem));
+	free (h);
+	palloc_free_page (pt);
+	palloc_free_multiple (kva, HUGE_PAGE_CNT);
+	return false;
+}
+
+/* Splits the huge page mapping PAGE into 4 kB mappings of the same
+ * frames.  PAGE's owner need not be the current process. */
+static void
+vm_split_huge (struct page *page) {
+	struct process *t = page->owner;
+	uintptr_t base = (uintptr_t) page->va & ~(LARGE_PGSIZE - 1);
+	struct page **leaf = spt_leaf (&t->spt, (void *) base, false);
+	struct huge_map *h = NULL;
+	struct list_elem *e;
+
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+	ASSERT (page->huge);
+
+	for (e = list_begin (&t->spt.huge_maps);
+			e != list_end (&t->spt.huge_maps); e = list_next (e)) {
+		h = list_entry (e, struct huge_map, elem);
+		if (h->va == base)
+			break;
+	}
+	ASSERT (e != list_end (&t->spt.huge_maps));
+	list_remove (&h->elem);
+	if (t->pml4 != NULL)
+		pml4_split_large (t->pml4, base, h->pt);
+	else
+		palloc_free_page (h->pt);
+	free (h);
+
+	/* PAGE itself may be on its way out of the table already. */
+	page->huge = false;
+	for (size_t i = 0; i < HUGE_PAGE_CNT; i++)
+		if (leaf[i] != NULL)
+			leaf[i]->huge = false;
+}
+
+/* Compaction.  A huge page needs a free, aligned 2 MB block of the
+ * user pool, which a pool that has been in use for a while seldom
+ * has even with plenty of memory free: a few frames scattered over
+ * each block keep the buddy allocator from merging the free pages
+ * around them.  When vm_map_huge() finds no such block, it queues
+ * compact_work, which makes one by moving frames out of the way.
+ *
+ * compact() picks the 2 MB block holding the fewest frames, among
+ * those whose allocated pages are all frames it can move: unpinned,
+ * not part of a huge page, and mapped only by live processes.  It
+ * isolates the block with palloc_isolate(), so that no page of it is
+ * handed out again, then gives each frame a page outside the block,
+ * copies the contents over and points the frame's mappings at the
+ * copy.  The struct frame stays the same, so the page caches and
+ * the links of the pages need no change.  Freeing the block then
+ * leaves a free 2 MB block for the next fault that wants one.
+ *
+ * All of this happens under frame_lock.  A thread that touches a
+ * page while its frame is moving faults on the cleared mapping, and
+ * handle_fault() waits for the lock, after which the page is mapped
+ * again.  A try that fails is not repeated for COMPACT_BACKOFF
+ * ticks, since nothing is likely to have changed. */
+#define COMPACT_BACKOFF TIMER_FREQ
+#define COMPACT_MAX_SHARE 64            /* Most pages mapping a frame
+                                           that is moved. */
+#define COMPACT_IMMOVABLE UINT16_MAX    /* Block holds a pinned frame. */
+
+/* Returns the number of the 2 MB block holding KVA. */
+static size_t
+block_no (const void *kva) {
+	return vtop (kva) / LARGE_PGSIZE;
+}
+
+/* Returns true if compaction can move FRAME. */
+static bool
+is_movable (struct frame *frame) {
+	if (frame->pin_cnt > 0 || frame->page == NULL || frame->page->huge
+			|| frame->share_cnt > COMPACT_MAX_SHARE)
+		return false;
+	for (struct list_elem *e = list_begin (&frame->pages);
+			e != list_end (&frame->pages); e = list_next (e)) {
+		struct process *t = list_entry (e, struct page, share_elem)->owner;
+
+		if (t->pml4 == NULL || t->spt.teardown != NULL)
+			return false;
+	}
+	return true;
+}
+
+/* Moves the contents of FRAME to a new page of the user pool and
+ * points the mappings of its pages there.  The old page is left to
+ * the caller.  Returns false, changing nothing, if there is no free
+ * page. */
+static bool
+frame_move (struct frame *frame) {
+	void *kva = palloc_get_page (PAL_USER);
+	uint64_t mapped = 0;
+	struct list_elem *e;
+	size_t i;
+
+	if (kva == NULL)
+		return false;
+
+	/* Unmap the pages first, so that no write lands in the old page
+	 * after it is copied. */
+	for (e = list_begin (&frame->pages), i = 0; e != list_end (&frame->pages);
+			e = list_next (e), i++) {
+		struct page *p = list_entry (e, struct page, share_elem);
+
+		if (pml4_get_page (p->owner->pml4, p->va) != NULL) {
+			mapped |= (uint64_t) 1 << i;
+			pml4_clear_page (p->owner->pml4, p->va);
+		}
+	}
+	fpu_copy_page (kva, frame->kva);
+	frame->kva = kva;
+	for (e = list_begin (&frame->pages), i = 0; e != list_end (&frame->pages);
+			e = list_next (e), i++)
+		if (mapped & ((uint64_t) 1 << i)) {
+			struct page *p = list_entry (e, struct page, share_elem);
+
+			pml4_move_page (p->owner->pml4, p->va, kva);
+		}
+	return true;
+}
+
+/* Moves every frame out of BLOCK, a 2 MB block isolated with
+ * palloc_isolate(), and frees the block.  Returns true if successful.
+ * Otherwise, the frames moved so far stay where they went, and the
+ * pages of BLOCK that no frame uses are freed one by one. */
+static bool
+compact_block (uint8_t *block) {
+	static bool busy[HUGE_PAGE_CNT];
+	struct list_elem *e;
+	bool ok = true;
+
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+
+	for (e = list_begin (&frame_table); e != list_end (&frame_table);
+			e = list_next (e)) {
+		struct frame *frame = list_entry (e, struct frame, elem);
+
+		if (block_no (frame->kva) == block_no (block) && !frame_move (frame)) {
+			ok = false;
+			break;
+		}
+	}
+	if (ok) {
+		palloc_free_multiple (block, HUGE_PAGE_CNT);
+		return true;
+	}
+
+	memset (busy, 0, sizeof busy);
+	for (e = list_begin (&frame_table); e != list_end (&frame_table);
+			e = list_next (e)) {
+		struct frame *frame = list_entry (e, struct frame, elem);
+
+		if (block_no (frame->kva) == block_no (block))
+			busy[((uint8_t *) frame->kva - block) / PGSIZE] = true;
+	}
+	for (size_t i = 0; i < HUGE_PAGE_CNT; i++)
+		if (!busy[i])
+			palloc_free_page (block + i * PGSIZE);
+	return false;
+}
+
+/* Tries to make a free 2 MB block in the user pool by moving frames,
+ * and returns true if successful.  MOVABLE has room for a count of
+ * BLOCK_CNT blocks, enough for the whole pool. */
+static bool
+compact (uint16_t *movable, size_t block_cnt) {
+	size_t lo = SIZE_MAX;
+	struct list_elem *e;
+
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+
+	/* Count the frames in each block, from the lowest one that has
+	 * any. */
+	for (e = list_begin (&frame_table); e != list_end (&frame_table);
+			e = list_next (e)) {
+		size_t no = block_no (list_entry (e, struct frame, elem)->kva);
+
+		if (no < lo)
+			lo = no;
+	}
+	memset (movable, 0, block_cnt * sizeof *movable);
+	for (e = list_begin (&frame_table); e != list_end (&frame_table);
+			e = list_next (e)) {
+		struct frame *frame = list_entry (e, struct frame, elem);
+		size_t i = block_no (frame->kva) - lo;
+
+		ASSERT (i < block_cnt);
+		if (!is_movable (frame))
+			movable[i] = COMPACT_IMMOVABLE;
+		else if (movable[i] != COMPACT_IMMOVABLE)
+			movable[i]++;
+	}
+
+	/* Try the blocks with the fewest frames first.  A block also
+	 * holding pages that are not frames fails to isolate. */
+	for (;;) {
+		size_t best = SIZE_MAX;
+
+		for (size_t i = 0; i < block_cnt; i++)
+			if (movable[i] != 0 && movable[i] != COMPACT_IMMOVABLE
+					&& (best == SIZE_MAX || movable[i] < movable[best]))
+				best = i;
+		if (best == SIZE_MAX || free_frames () < movable[best] + kswapd_high)
+			return false;
+		if (palloc_isolate (ptov ((lo + best) * LARGE_PGSIZE), HUGE_PAGE_CNT,
+					movable[best]))
+			return compact_block (ptov ((lo + best) * LARGE_PGSIZE));
+		movable[best] = COMPACT_IMMOVABLE;
+	}
+}
+
+/* Queues compact_work, unless the last try failed only recently. */
+static void
+compact_poke (void) {
+	if (timer_elapsed (compact_failed) >= COMPACT_BACKOFF)
+		queue_work (WQ_NORMAL, &compact_work);
+}
+
+/* Runs compact() as compact_work. */
+static void
+compact_run (void *aux UNUSED) {
+	lock_acquire (&frame_lock);
+	if (!compact (compact_movable, compact_block_cnt))
+		compact_failed = timer_ticks ();
+	lock_release (&frame_lock);
+}
+
+/* Returns true if PAGE, on which a not present fault was taken, is
+ * mapped by now.  Its frame may have been moving, see compact():
+ * taking frame_lock waits for that to finish. */
+static bool
+vm_wait_compact (struct page *page) {
+	bool mapped;
+
+	/* The frames of pages that are not in memory never move. */
+	if (page->frame == NULL)
+		return false;
+	lock_acquire (&frame_lock);
+	mapped = page->frame != NULL
+		&& pml4_get_page (page->owner->pml4, page->va) != NULL;
+	lock_release (&frame_lock);
+	return mapped;
+}
+
+/* Brings in PAGE, which has not been loaded yet.  A text page is
+ * mapped to the cached frame if there is one, and otherwise loaded
+ * and added to the cache. */
+static bool
+vm_claim_lazy_page (struct page *page) {
+	struct vm_load_aux *aux = page->uninit.aux;
+	struct frame *frame;
+	struct inode *inode;
+	off_t ofs;
+	size_t read_bytes;
+
+	if (!is_text_page (page))
+		return vm_do_claim_page (page);
+
+	inode = file_get_inode (aux->file);
+	ofs = aux->ofs;
+	read_bytes = aux->read_bytes;
+
+	lock_acquire (&frame_lock);
+	frame = cache_lookup (&text_cache, inode, ofs, read_bytes);
+	if (frame != NULL
+			&& pml4_set_page (page->owner->pml4, page->va, frame->kva, false)) {
+		/* Become the anonymous page loading would have made, without
+		 * touching the shared contents. */
+		page->uninit.page_initializer (page, page->uninit.type, NULL);
+		frame_attach (frame, page);
+		lock_release (&frame_lock);
+		load_aux_free (aux);
+		return true;
+	}
+	lock_release (&frame_lock);
+
+	/* Loading uses up AUX, so take the cache's reference to the inode
+	 * first. */
+	inode = inode_reopen (inode);
+	if (!vm_do_claim_page (page)) {
+		inode_close (inode);
+		return false;
+	}
+
+	lock_acquire (&frame_lock);
+	frame = page->frame;
+	if (frame != NULL && frame->cache == NULL
+			&& cache_insert (&text_cache, frame, inode, ofs, read_bytes))
+		inode = NULL;
+	lock_release (&frame_lock);
+	inode_close (inode);
+	return true;
+}
+
+/* Brings in PAGE, a page of a mapped file, through the file cache:
+ * it maps the frame holding that page of the file if there is one,
+ * or else a newly loaded frame that is added to the cache. */
+static bool
+vm_claim_file_page (struct page *page) {
+	struct inode *inode = file_get_inode (page->file.file);
+	off_t ofs = page->file.ofs;
+	uint64_t *pml4 = page->owner->pml4;
+	struct frame *frame, *cached;
+
+	lock_acquire (&frame_lock);
+	frame = cache_lookup (&file_cache, inode, ofs, 0);
+	if (frame != NULL && page->frame == NULL
+			&& pml4_set_page (pml4, page->va, frame->kva, page->writable)) {
+		frame_attach (frame, page);
+		lock_release (&frame_lock);
+		return true;
+	}
+	lock_release (&frame_lock);
+
+	if (!vm_do_claim_page (page))
+		return false;
+
+	lock_acquire (&frame_lock);
+	frame = page->frame;
+	if (frame != NULL && frame->cache == NULL) {
+		cached = cache_lookup (&file_cache, inode, ofs, 0);
+		if (cached == NULL) {
+			if (!cache_insert (&file_cache, frame, inode_reopen (inode), ofs, 0))
+				NOT_REACHED ();
+		} else {
+			/* Someone else loaded the same page meanwhile.  There
+			 * must be only one copy, so switch to theirs. */
+			pml4_clear_page (pml4, page->va);
+			frame_detach (page);
+			frame_free (frame);
+			if (pml4_set_page (pml4, page->va, cached->kva, page->writable))
+				frame_attach (cached, page);
+		}
+	}
+	lock_release (&frame_lock);
+	return true;
+}
+
+/* Brings in PAGE, a page of a shared memory segment: it maps the
+ * frame holding that page of the segment if there is one, or else
+ * loads one for the segment, from swap or as zeros.  The segment's
+ * lock keeps two processes from loading the same page at once. */
+static bool
+vm_claim_shm_page (struct page *page) {
+	struct shm *shm = page->shm.shm;
+	struct shm_slot *slot = &shm->slots[page->shm.idx];
+	uint64_t *pml4 = page->owner->pml4;
+	struct frame *frame;
+	size_t old_slot;
+	bool success = false;
+
+	lock_acquire (&shm->lock);
+	lock_acquire (&frame_lock);
+	frame = slot->frame;
+	if (frame != NULL) {
+		if (page->frame == NULL
+				&& pml4_set_page (pml4, page->va, frame->kva, page->writable)) {
+			if (frame->share_cnt == 0)
+				frame_table_insert (frame);
+			frame_attach (frame, page);
+			success = true;
+		}
+		lock_release (&frame_lock);
+		lock_release (&shm->lock);
+		return success;
+	}
+	lock_release (&frame_lock);
+
+	/* Load it as vm_do_claim_page() would, but keep the frame pinned
+	 * until the segment knows about it. */
+	frame = vm_get_frame (page->owner);
+	if (frame != NULL) {
+		lock_acquire (&frame_lock);
+		frame_attach (frame, page);
+		lock_release (&frame_lock);
+		if (swap_in (page, frame->kva)
+				&& pml4_set_page (pml4, page->va, frame->kva, page->writable)) {
+			lock_acquire (&frame_lock);
+			slot->frame = frame;
+			old_slot = slot->slot;
+			slot->slot = SWAP_NONE;
+			lock_release (&frame_lock);
+			if (old_slot != SWAP_NONE)
+				swap_slot_free (old_slot);
+			vm_unpin_page (page);
+			success = true;
+		} else
+			vm_release_frame (page);
+	}
+	lock_release (&shm->lock);
+	return success;
+}
+
+/* Returns true if no file is mapped, so that read() and write()
+ * need not look for mapped pages. */
+bool
+vm_cache_empty (void) {
+	return ohash_empty (&file_cache);
+}
+
+/* Copies SIZE bytes of INODE at OFS into DST, if that part of the
+ * file is mapped, and returns true; otherwise returns false.  The
+ * bytes must lie within one page.  DST must not fault, since it is
+ * written with frame_lock held. */
 bool
-vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr UNUSED,
-		bool user UNUSED, bool write UNUSED, bool not_present UNUSED) {
-	struct supplemental_page_table *spt UNUSED = &thread_current ()->spt;
+vm_cache_read (struct inode *inode, off_t ofs, void *dst, size_t size) {
+	size_t page_ofs = ofs % PGSIZE;
+	struct frame *frame;
+
+	ASSERT (page_ofs + size <= PGSIZE);
+
+	/* The holder of frame_lock only reads into frames it loads. */
+	if (lock_held_by_current_thread (&frame_lock))
+		return false;
+	lock_acquire (&frame_lock);
+	frame = cache_lookup (&file_cache, inode, ofs - page_ofs, 0);
+	if (frame != NULL)
+		memcpy (dst, (uint8_t *) frame->kva + page_ofs, size);
+	lock_release (&frame_lock);
+	return frame != NULL;
+}
+
+/* Copies SIZE bytes from SRC into the mapped page of INODE holding
+ * OFS, if there is one, after the same bytes have been written to
+ * the disk.  The bytes must lie within one page.  SRC must not
+ * fault. */
+void
+vm_cache_write (struct inode *inode, off_t ofs, const void *src, size_t size) {
+	size_t page_ofs = ofs % PGSIZE;
+	struct frame *frame;
+
+	ASSERT (page_ofs + size <= PGSIZE);
+
+	/* The holder of frame_lock only writes frames back. */
+	if (lock_held_by_current_thread (&frame_lock))
+		return;
+	lock_acquire (&frame_lock);
+	frame = cache_lookup (&file_cache, inode, ofs - page_ofs, 0);
+	if (frame != NULL)
+		memcpy ((uint8_t *) frame->kva + page_ofs, src, size);
+	lock_release (&frame_lock);
+}
+
+/* Fault-around.  A fault on a page loaded lazily from a file also
+ * loads the other pages of the aligned FAULT_AROUND_PAGES block
+ * around it that come from the same file at the matching offsets,
+ * so that running a program takes one fault per block of its image
+ * instead of one per page.  The neighbours are only loaded while
+ * free frames are plentiful, so that speculation never causes an
+ * eviction. */
+#define FAULT_AROUND_PAGES 8
+
+/* Returns true if PAGE has not been loaded yet and will be loaded
+ * by INIT from INODE at the offset OFS would have at its address,
+ * given that BASE is loaded from OFS. */
+static bool
+fault_around_match (struct page *page, vm_initializer *init,
+		struct inode *inode, uintptr_t base, off_t ofs) {
+	struct vm_load_aux *aux;
+
+	if (page == NULL || VM_TYPE (page->operations->type) != VM_UNINIT
+			|| page->uninit.init != init || page->uninit.aux == NULL)
+		return false;
+	aux = page->uninit.aux;
+	return file_get_inode (aux->file) == inode
+		&& aux->ofs - ofs == (off_t) ((uintptr_t) page->va - base);
+}
+
+/* Loads the neighbours of PAGE, which is about to be loaded, for
+ * fault-around.  Must be called before PAGE is claimed. */
+static void
+fault_around (struct page *page) {
+	struct supplemental_page_table *spt = &thread_current ()->process->spt;
+	struct vm_load_aux *aux = page->uninit.aux;
+	vm_initializer *init = page->uninit.init;
+	uintptr_t base = (uintptr_t) page->va;
+	uintptr_t start = base & ~(uintptr_t) (FAULT_AROUND_PAGES * PGSIZE - 1);
+	uintptr_t end = start + FAULT_AROUND_PAGES * PGSIZE;
+	struct vm_area *area = vm_area_find (spt, page->va);
+	struct inode *inode = file_get_inode (aux->file);
+	off_t ofs = aux->ofs;
+
+	/* Only the pages of the same segment can match. */
+	if (area != NULL) {
+		if (start < (uintptr_t) area->start)
+			start = (uintptr_t) area->start;
+		if (end > (uintptr_t) area->end)
+			end = (uintptr_t) area->end;
+	}
+	for (uintptr_t va = start; va < end; va += PGSIZE) {
+		struct page *n;
+
+		if (va == base || !is_user_vaddr ((void *) va))
+			continue;
+		if (free_frames () < kswapd_high)
+			break;
+		n = spt_find_page (spt, (void *) va);
+		if (fault_around_match (n, init, inode, base, ofs)
+				&& !vm_claim_lazy_page (n))
+			break;
+	}
+}
+
+/* Readahead for MADV_SEQUENTIAL.  After a fault on a page accessed
+ * sequentially, the next SEQ_READAHEAD pages are brought in too if
+ * they come from a file or swap, as long as free frames are
+ * plentiful.  The page SEQ_READAHEAD pages behind is marked not
+ * accessed, so that the clock takes pages already scanned before any
+ * others: drop-behind. */
+#define SEQ_READAHEAD 16
+
+static bool is_paged_out (struct page *);
+
+/* Reads ahead from PAGE, which has just been brought in. */
+static void
+vm_read_ahead (struct page *page) {
+	struct supplemental_page_table *spt = &page->owner->spt;
+	uint8_t *va = page->va;
+	struct page *behind;
+
+	for (int i = 1; i <= SEQ_READAHEAD; i++) {
+		struct page *next = spt_find_page (spt, va + i * PGSIZE);
+
+		if (next == NULL || free_frames () < kswapd_high)
+			break;
+		if (is_paged_out (next) && !vm_claim (next))
+			break;
+	}
+
+	if ((uintptr_t) va < SEQ_READAHEAD * PGSIZE)
+		return;
+	behind = spt_find_page (spt, va - SEQ_READAHEAD * PGSIZE);
+	if (behind != NULL && behind->frame != NULL)
+		pml4_set_accessed (page->owner->pml4, behind->va, false);
+}
+
+/* Handles a page fault for vm_try_handle_fault(), counting it by
+ * kind in the current thread's statistics if successful. */
+static bool
+handle_fault (struct intr_frame *f, void *addr, bool user, bool write,
+		bool not_present) {
+	struct thread *cur = thread_current ();
+	struct supplemental_page_table *spt = &cur->process->spt;
 	struct page *page = NULL;
-	/* TODO: Validate the fault */
-	/* TODO: Your code goes here */
+	bool major;
+
+	/* Validate the fault. */
+	if (addr == NULL || !is_user_vaddr (addr))
+		return false;
+	page = spt_find_page (spt, addr);
+	if (page == NULL) {
+		/* In a system call, F is the kernel's frame.  Outside every
+		 * region, the fault is a bad access. */
+		uintptr_t rsp = user ? f->rsp : cur->user_rsp;
+		struct vm_area *area = is_stack_growth (vm_area_find (spt, addr),
+				addr, rsp);
+
+		if (area == NULL || !vm_stack_growth (area, addr))
+			return false;
+		vmstat_count (cur, stack_faults);
+		return true;
+	}
+	if (write && !page->writable)
+		return false;
+
+	/* A write to a present, writable page is copy-on-write. */
+	if (!not_present) {
+		if (!write || !vm_handle_wp (page))
+			return false;
+		vmstat_count (cur, cow_faults);
+		return true;
+	}
+	if (vm_wait_compact (page) || vm_map_huge (page)
+			|| (!write && vm_map_zero_page (page))) {
+		vmstat_count (cur, minor_faults);
+		return true;
+	}
+	major = is_paged_out (page);
+	if (VM_TYPE (page->operations->type) == VM_UNINIT
+			&& page->uninit.aux != NULL && page->advice != MADV_RANDOM)
+		fault_around (page);
+	if (!vm_claim (page))
+		return false;
+	if (major)
+		vmstat_count (cur, major_faults);
+	else
+		vmstat_count (cur, minor_faults);
+	if (page->advice == MADV_SEQUENTIAL)
+		vm_read_ahead (page);
+	return true;
+}
+
+/* Return true on success */
+bool
+vm_try_handle_fault (struct intr_frame *f, void *addr,
+		bool user, bool write, bool not_present) {
+	uint64_t start = rdtsc ();
+	uint64_t cycles;
+	size_t bucket = 0;
+	bool locked;
+	bool ok;
+
+	/* A thread that has left its process has no user memory. */
+	if (thread_current ()->process == NULL)
+		return false;
+	TRACE (FAULT_BEGIN, addr);
+	locked = vm_lock_acquire ();
+	ok = handle_fault (f, addr, user, write, not_present);
+	vm_lock_release (locked);
+	TRACE (FAULT_END, addr);
+	if (!ok)
+		return false;
+
+	/* Record how long it took, in the histogram of struct vmstat. */
+	cycles = (rdtsc () - start) >> (VMSTAT_SHIFT + 1);
+	while (cycles > 0 && bucket < VMSTAT_BUCKETS - 1) {
+		cycles >>= 1;
+		bucket++;
+	}
+	vmstat_count (thread_current (), latency[bucket]);
+	return true;
+}
+
+/* Statistics of the whole system, kept next to each thread's own. */
+struct vmstat vmstat_global;
+
+/* Copies the statistics of the current thread into THREAD and those
+ * of the whole system into SYSTEM, skipping either if it is null.
+ * The evictions, swap-ins and memory sizes in THREAD are those of
+ * the thread's process, whose address space they concern.  Either
+ * may be in user memory, so no lock is held while copying. */
+void
+vm_get_stats (struct vmstat *thread, struct vmstat *system) {
+	struct thread *cur = thread_current ();
+	struct supplemental_page_table *spt = &cur->process->spt;
+	size_t rss, wss, frames, total;
+	uint64_t evictions, swap_ins;
+
+	lock_acquire (&frame_lock);
+	rss = spt->rss;
+	evictions = spt->evictions;
+	swap_ins = spt->swap_ins;
+	if (spt->ws_epoch == ws_epoch)
+		wss = spt->ws_cnt;
+	else if (ws_in_pass && spt->ws_epoch == ws_epoch + 1)
+		wss = spt->ws_prev;
+	else
+		wss = 0;
+	frames = list_size (&frame_table);
+	total = ws_total;
+	lock_release (&frame_lock);
+
+	if (thread != NULL) {
+		*thread = cur->vmstat;
+		thread->evictions = evictions;
+		thread->swap_ins = swap_ins;
+		thread->resident_pages = rss;
+		thread->working_set_pages = wss;
+	}
+	if (system != NULL) {
+		*system = vmstat_global;
+		system->resident_pages = frames;
+		system->working_set_pages = total;
+	}
+}
+
+/* Prints the statistics of the whole system. */
+void
+vm_print_stats (void) {
+	const struct vmstat *vs = &vmstat_global;
 
-	return vm_do_claim_page (page);
+	printf ("VM: %llu minor, %llu major, %llu copy-on-write, "
+			"%llu stack faults\n", vs->minor_faults, vs->major_faults,
+			vs->cow_faults, vs->stack_faults);
+	printf ("VM: %llu evictions, %llu swap-ins\n", vs->evictions,
+			vs->swap_ins);
+	if (ksm_merged > 0)
+		printf ("VM: %llu pages merged\n", ksm_merged);
+	for (size_t i = 0; i < VMSTAT_BUCKETS; i++)
+		if (vs->latency[i] > 0)
+			printf ("VM: %llu faults under 2^%zu cycles\n", vs->latency[i],
+					i + VMSTAT_SHIFT + 1);
+}
+
+/* Returns true if PAGE is not in memory and would be read from swap
+ * or a file to bring it in, as opposed to being created. */
+static bool
+is_paged_out (struct page *page) {
+	switch (VM_TYPE (page->operations->type)) {
+		case VM_UNINIT:
+			return page->uninit.aux != NULL;
+		case VM_ANON:
+		case VM_FILE:
+		case VM_SHM:
+			return page->frame == NULL;
+		default:
+			return false;
+	}
+}
+
+/* Drops the contents of PAGE, for madvise(MADV_DONTNEED), and frees
+ * its frame and swap.  A page of a mapped file is written back and
+ * read in again on its next access.  A writable anonymous page
+ * becomes a fresh one, reading as zeros; read-only ones, which only
+ * executables have and which could not be reloaded, are kept. */
+static void
+vm_discard_page (struct page *page) {
+	struct supplemental_page_table *spt = &thread_current ()->process->spt;
+	void *va = page->va;
+	int advice = page->advice;
+
+	switch (VM_TYPE (page->operations->type)) {
+		case VM_FILE:
+			file_page_release (page);
+			break;
+		case VM_ANON:
+			if (!page->writable)
+				break;
+			spt_remove_page (spt, page);
+			if (vm_alloc_page (VM_ANON, va, true))
+				spt_find_page (spt, va)->advice = advice;
+			break;
+		default:
+			break;
+	}
+}
+
+/* Applies ADVICE, one of the MADV_* values, to the pages between ADDR
+ * and ADDR + LENGTH, which must start on a page boundary.  The access
+ * patterns are recorded in each page for later faults to follow;
+ * MADV_WILLNEED brings the pages in now, as long as free frames are
+ * plentiful, and MADV_DONTNEED frees them.  Addresses without a page
+ * are skipped, and only the regions within the range are looked at,
+ * so that the gaps between them cost nothing.  Returns false if the
+ * arguments are bad. */
+bool
+vm_madvise (void *addr, size_t length, int advice) {
+	struct supplemental_page_table *spt = &thread_current ()->process->spt;
+	struct vm_area *area;
+	uint8_t *end;
+	bool locked;
+
+	if (pg_ofs (addr) != 0 || !is_user_vaddr (addr)
+			|| length > KERN_BASE - (uint64_t) addr
+			|| advice < MADV_NORMAL || advice > MADV_DONTNEED)
+		return false;
+	end = pg_round_up ((uint8_t *) addr + length);
+
+	locked = vm_lock_acquire ();
+	for (area = vm_area_first (spt, addr, end);
+			area != NULL && area->start < end; area = vm_area_next (area)) {
+		uint8_t *va = area->start > (uint8_t *) addr ? area->start : addr;
+		uint8_t *area_end = area->end < end ? area->end : end;
+
+		for (; va < area_end; va += PGSIZE) {
+			struct page *page = spt_find_page (spt, va);
+
+			if (page == NULL)
+				continue;
+			switch (advice) {
+				case MADV_WILLNEED:
+					if (is_paged_out (page) && free_frames () >= kswapd_high)
+						vm_claim (page);
+					break;
+				case MADV_DONTNEED:
+					if (!page->mlocked)
+						vm_discard_page (page);
+					break;
+				default:
+					page->advice = advice;
+					break;
+			}
+		}
+	}
+	vm_lock_release (locked);
+	return true;
+}
+
+/* Moves the break of the running process's heap from OLD_BRK to
+ * NEW_BRK, for sbrk().  Pages that come to lie below the break are
+ * added as anonymous pages, which read as zeros and get a frame only
+ * when touched; pages that come to lie above it are removed with
+ * whatever they held.  The heap is a region from heap_start to the
+ * break, there only while the heap has pages.  Returns false,
+ * changing nothing, if the heap would grow into another region or
+ * memory is short.  The caller holds vm_lock, which also covers
+ * heap_brk. */
+bool
+vm_set_brk (void *old_brk, void *new_brk) {
+	struct process *cur = thread_current ()->process;
+	struct supplemental_page_table *spt = &cur->spt;
+	uint8_t *start = cur->heap_start;
+	uint8_t *old_end = pg_round_up (old_brk);
+	uint8_t *new_end = pg_round_up (new_brk);
+	struct vm_area *area = old_end > start ? vm_area_find (spt, start) : NULL;
+	uint8_t *va;
+
+	ASSERT (lock_held_by_current_thread (&cur->vm_lock));
+
+	if (new_end == old_end)
+		return true;
+	if (new_end < old_end) {
+		for (va = new_end; va < old_end; va += PGSIZE) {
+			struct page *page = spt_find_page (spt, va);
+
+			if (page != NULL)
+				spt_remove_page (spt, page);
+		}
+		if (new_end > start)
+			vm_area_resize (area, new_end);
+		else
+			vm_area_destroy (spt, area);
+		return true;
+	}
+
+	if (area != NULL ? !vm_area_resize (area, new_end)
+			: (area = vm_area_create (spt, start, new_end, VM_ANON, true,
+					NULL, 0)) == NULL)
+		return false;
+	for (va = old_end; va < new_end; va += PGSIZE)
+		if (!vm_alloc_page (VM_ANON, va, true)) {
+			while (va > old_end) {
+				va -= PGSIZE;
+				spt_remove_page (spt, spt_find_page (spt, va));
+			}
+			if (old_end > start)
+				vm_area_resize (area, old_end);
+			else
+				vm_area_destroy (spt, area);
+			return false;
+		}
+	return true;
 }
 
 /* Free the page.
@@ -150,41 +2390,219 @@ vm_dealloc_page (struct page *page) {
 
 /* Claim the page that allocate on VA. */
 bool
-vm_claim_page (void *va UNUSED) {
-	struct page *page = NULL;
-	/* TODO: Fill this function */
+vm_claim_page (void *va) {
+	bool locked = vm_lock_acquire ();
+	struct page *page = spt_find_page (&thread_current ()->process->spt, va);
+	bool success = page != NULL && vm_claim (page);
 
-	return vm_do_claim_page (page);
+	vm_lock_release (locked);
+	return success;
+}
+
+/* Brings in PAGE, through a page cache if it can be in one. */
+static bool
+vm_claim (struct page *page) {
+	switch (VM_TYPE (page->operations->type)) {
+		case VM_UNINIT:
+			return vm_claim_lazy_page (page);
+		case VM_FILE:
+			return vm_claim_file_page (page);
+		case VM_SHM:
+			return vm_claim_shm_page (page);
+		default:
+			return vm_do_claim_page (page);
+	}
 }
 
 /* Claim the PAGE and set up the mmu. */
 static bool
 vm_do_claim_page (struct page *page) {
-	struct frame *frame = vm_get_frame ();
+	struct frame *frame;
 
-	/* Set links */
-	frame->page = page;
-	page->frame = frame;
+	/* Get the frame first: if PAGE is being evicted, this waits for
+	 * the eviction to finish. */
+	frame = vm_get_frame (page->owner);
+	if (frame == NULL)
+		return false;
+	ASSERT (page->frame == NULL);
 
-	/* TODO: Insert page table entry to map page's VA to frame's PA. */
+	/* Set links */
+	lock_acquire (&frame_lock);
+	frame_attach (frame, page);
+	lock_release (&frame_lock);
 
-	return swap_in (page, frame->kva);
+	/* Map the page only once its contents are in place, so that no
+	 * other thread of ours can see it half loaded.  Replacing a
+	 * zero-page mapping needs a TLB flush, which clearing gives. */
+	if (pml4_get_page (page->owner->pml4, page->va) == zero_page)
+		pml4_clear_page (page->owner->pml4, page->va);
+	if (!swap_in (page, frame->kva)
+			|| !pml4_set_page (page->owner->pml4, page->va, frame->kva,
+				page->writable)) {
+		vm_release_frame (page);
+		return false;
+	}
+	vm_unpin_page (page);
+	return true;
 }
 
 /* Initialize new supplemental page table */
 void
-supplemental_page_table_init (struct supplemental_page_table *spt UNUSED) {
+supplemental_page_table_init (struct supplemental_page_table *spt) {
+	spt->root = NULL;
+	spt->hint = NULL;
+	spt->hint_base = 0;
+	list_init (&spt->huge_maps);
+	vm_area_table_init (spt);
+	spt->teardown = NULL;
+	spt->rss = 0;
+	spt->rss_limit = rss_limit;
+	spt->ws_cnt = 0;
+	spt->ws_prev = 0;
+	spt->ws_epoch = 0;
+	spt->evictions = 0;
+	spt->swap_ins = 0;
+}
+
+/* Makes a copy of the page SRC in the current thread's address
+ * space.  A page that was never touched stays lazy, with its own
+ * copy of the load source.  A page of a mapped file or a shared
+ * memory segment is mapped in the child too, through the file cache
+ * or the segment on its first access.  Any other
+ * page with contents shares SRC's frame copy-on-write, with both
+ * mapped read-only, so that nothing is copied until one of them
+ * writes. */
+static bool
+copy_page (struct page *src, void *aux_ UNUSED) {
+	struct process *cur = thread_current ()->process;
+
+	if (VM_TYPE (src->operations->type) == VM_UNINIT) {
+		struct vm_load_aux *aux = src->uninit.aux;
+		struct vm_load_aux *copy = NULL;
+
+		if (aux != NULL) {
+			copy = malloc (sizeof *copy);
+			if (copy == NULL)
+				return false;
+			*copy = *aux;
+			copy->file = file_reopen (aux->file);
+			if (copy->file == NULL) {
+				free (copy);
+				return false;
+			}
+		}
+		if (!vm_alloc_page_with_initializer (src->uninit.type, src->va,
+					src->writable, src->uninit.init, copy)) {
+			if (copy != NULL) {
+				file_close (copy->file);
+				free (copy);
+			}
+			return false;
+		}
+		spt_find_page (&cur->spt, src->va)->advice = src->advice;
+		return true;
+	}
+
+	struct page *dst = kmem_cache_alloc (page_cache);
+	bool success = false;
+
+	if (dst == NULL)
+		return false;
+	*dst = *src;
+	dst->owner = cur;
+	dst->frame = NULL;
+	dst->mlocked = false;
+	dst->huge = false;
+	if (VM_TYPE (src->operations->type) == VM_FILE) {
+		dst->dirty = false;
+		dst->file.file = file_reopen (src->file.file);
+		if (dst->file.file == NULL || !spt_insert_page (&cur->spt, dst)) {
+			file_close (dst->file.file);
+			kmem_cache_free (page_cache, dst);
+			return false;
+		}
+		return true;
+	}
+	if (VM_TYPE (src->operations->type) == VM_SHM) {
+		shm_reopen (dst->shm.shm);
+		if (!spt_insert_page (&cur->spt, dst)) {
+			shm_close (dst->shm.shm);
+			kmem_cache_free (page_cache, dst);
+			return false;
+		}
+		return true;
+	}
+	if (VM_TYPE (src->operations->type) == VM_ANON) {
+		/* The swap copies stay with SRC. */
+		dst->anon.slot = SWAP_NONE;
+		dst->anon.zentry = NULL;
+		dst->dirty = true;
+	}
+	if (!spt_insert_page (&cur->spt, dst)) {
+		kmem_cache_free (page_cache, dst);
+		return false;
+	}
+
+	/* Bring SRC in if it was evicted, and keep it in while we share
+	 * its frame. */
+	if (!vm_pin_page (src))
+		return false;
+	lock_acquire (&frame_lock);
+	if (src->huge)
+		vm_split_huge (src);
+	if (pml4_set_page (cur->pml4, dst->va, src->frame->kva, false)) {
+		if (src->writable)
+			pml4_protect_range (src->owner->pml4, src->va, 1, false);
+		frame_attach (src->frame, dst);
+		success = true;
+	}
+	lock_release (&frame_lock);
+	vm_unpin_page (src);
+	return success;
 }
 
 /* Copy supplemental page table from src to dst */
 bool
-supplemental_page_table_copy (struct supplemental_page_table *dst UNUSED,
-		struct supplemental_page_table *src UNUSED) {
+supplemental_page_table_copy (struct supplemental_page_table *dst,
+		struct supplemental_page_table *src) {
+	ASSERT (dst == &thread_current ()->process->spt);
+
+	return vm_area_copy (dst, src) && spt_for_each (src, copy_page, NULL);
 }
 
-/* Free the resource hold by the supplemental page table */
+/* Free the resource hold by the supplemental page table
+ *
+ * This is the bulk teardown at exit and exec.  Mapped files are
+ * written back first, from their user addresses.  Then one pass over
+ * the table frees every page together with the nodes holding it.
+ * Along the way the PTEs are left alone, since process_cleanup()
+ * frees the page tables whole with pml4_destroy_tables(), which
+ * costs no walk and no TLB flush per page, and the frames and swap
+ * slots given up are collected in a struct vm_teardown and freed in
+ * batches, without taking frame_lock or swap_lock for each. */
 void
-supplemental_page_table_kill (struct supplemental_page_table *spt UNUSED) {
-	/* TODO: Destroy all the supplemental_page_table hold by thread and
-	 * TODO: writeback all the modified contents to the storage. */
+supplemental_page_table_kill (struct supplemental_page_table *spt) {
+	struct vm_teardown td;
+
+	ASSERT (spt == &thread_current ()->process->spt);
+	file_write_back_all ();
+
+	list_init (&td.frames);
+	td.slot_cnt = 0;
+	spt->teardown = &td;
+	spt->hint = NULL;
+	if (spt->root != NULL)
+		spt_node_kill (spt->root, 4);
+	ASSERT (list_empty (&spt->huge_maps));
+	vm_area_kill (spt);
+	swap_slot_free_batch (&td);
+
+	while (!list_empty (&td.frames)) {
+		struct frame *frame = list_entry (list_pop_front (&td.frames),
+				struct frame, elem);
+
+		palloc_free_page (frame->kva);
+		kmem_cache_free (frame_cache, frame);
+	}
+	supplemental_page_table_init (spt);
 }
@@ -0,0 +1,371 @@
+/* zswap.c: Compressed cache of anonymous pages in front of the swap disk.
+ *
+ * An anonymous page picked for eviction is first compressed with a
+ * small LZ77 compressor of the LZ4 family and kept in memory.  Only
+ * when the pool of compressed pages is full is its oldest entry
+ * written to the swap disk, in LRU order.  A page of zeros takes no
+ * pool space at all.  Bringing back a page that is still here is a
+ * decompression instead of eight PIO sector reads.
+ *
+ * Compressed pages are kept in a handful of size classes, each an
+ * object cache, so that pool memory is not fragmented by the odd
+ * sizes.  Pages that do not compress to the largest class go
+ * straight to disk.
+ *
+ * zswap_lock covers the whole pool, including the anon.zentry
+ * links of the pages in it, and is held across a writeback, so that
+ * a page is never seen between the pool and its swap slot. */
+
+#include "vm/zswap.h"
+#include <list.h>
+#include <memstat.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "vm/vm.h"
+
+bool zswap_enabled;
+
+/* Size classes of compressed pages, in bytes. */
+static const size_t class_size[] = { 64, 128, 256, 512, 768, 1024, 1536 };
+static const char *class_name[] = {
+	"zswap_64", "zswap_128", "zswap_256", "zswap_512", "zswap_768",
+	"zswap_1024", "zswap_1536",
+};
+#define CLASS_CNT (sizeof class_size / sizeof *class_size)
+#define ZSWAP_MAX_LEN 1536
+
+/* A compressed page. */
+struct zswap_entry {
+	struct list_elem lru_elem;  /* Element in lru, oldest first. */
+	struct page *page;          /* Page this is a copy of. */
+	size_t len;                 /* Compressed bytes, 0 for all zeros. */
+	size_t class;               /* Size class of DATA. */
+	uint8_t *data;              /* Compressed bytes, or NULL. */
+};
+
+static struct kmem_cache *entry_cache;
+static struct kmem_cache *class_cache[CLASS_CNT];
+static struct list lru;
+static struct lock zswap_lock;
+static size_t pool_bytes;       /* Bytes of DATA in use. */
+static size_t pool_limit;       /* Maximum for pool_bytes. */
+
+/* Scratch space, used under zswap_lock. */
+static uint8_t compress_buf[ZSWAP_MAX_LEN];
+static uint8_t writeback_buf[PGSIZE];
+
+static size_t lz_compress (const uint8_t *, size_t, uint8_t *, size_t);
+static bool lz_decompress (const uint8_t *, size_t, uint8_t *, size_t);
+
+/* Sets up the pool.  It may grow to 1/16 of the kernel pool. */
+void
+zswap_init (void) {
+	struct memstat ms;
+
+	list_init (&lru);
+	lock_init (&zswap_lock);
+	entry_cache = kmem_cache_create ("zswap_entry",
+			sizeof (struct zswap_entry), 0, NULL);
+	for (size_t i = 0; i < CLASS_CNT; i++)
+		class_cache[i] = kmem_cache_create (class_name[i], class_size[i], 0,
+				NULL);
+	palloc_get_stats (&ms);
+	pool_limit = ms.kernel_pages * PGSIZE / 16;
+}
+
+/* Returns true if the page at KVA is all zeros. */
+static bool
+page_is_zero (const void *kva) {
+	const uint64_t *p = kva;
+
+	for (size_t i = 0; i < PGSIZE / sizeof *p; i++)
+		if (p[i] != 0)
+			return false;
+	return true;
+}
+
+/* Removes E from the pool and frees it. */
+static void
+entry_free (struct zswap_entry *e) {
+	ASSERT (lock_held_by_current_thread (&zswap_lock));
+
+	list_remove (&e->lru_elem);
+	e->page->anon.zentry = NULL;
+	if (e->data != NULL) {
+		kmem_cache_free (class_cache[e->class], e->data);
+		pool_bytes -= class_size[e->class];
+	}
+	kmem_cache_free (entry_cache, e);
+}
+
+/* Decompresses E into KVA. */
+static void
+entry_read (const struct zswap_entry *e, void *kva) {
+	bool ok UNUSED;
+
+	if (e->data == NULL) {
+		memset (kva, 0, PGSIZE);
+		return;
+	}
+	ok = lz_decompress (e->data, e->len, kva, PGSIZE);
+	ASSERT (ok);
+}
+
+/* Writes the oldest page in the pool to the swap disk and frees its
+ * entry.  Returns false if the pool is empty or swap is full. */
+static bool
+writeback_oldest (void) {
+	struct zswap_entry *e;
+	size_t slot;
+
+	if (list_empty (&lru))
+		return false;
+	e = list_entry (list_front (&lru), struct zswap_entry, lru_elem);
+	entry_read (e, writeback_buf);
+	slot = swap_write (writeback_buf);
+	if (slot == SWAP_NONE)
+		return false;
+	e->page->anon.slot = slot;
+	entry_free (e);
+	return true;
+}
+
+/* Compresses PAGE, whose contents are at KVA, into the pool.
+ * Returns false if zswap is off, or if the page does not compress
+ * well or does not fit. */
+bool
+zswap_store (struct page *page, const void *kva) {
+	struct zswap_entry *e;
+	size_t len = 0, class = 0;
+	bool success = false;
+
+	if (!zswap_enabled)
+		return false;
+
+	lock_acquire (&zswap_lock);
+	ASSERT (page->anon.zentry == NULL);
+	if (!page_is_zero (kva)) {
+		len = lz_compress (kva, PGSIZE, compress_buf, ZSWAP_MAX_LEN);
+		if (len == 0)
+			goto done;
+		while (class_size[class] < len)
+			class++;
+
+		/* Make room by pushing the oldest pages out to disk. */
+		while (pool_bytes + class_size[class] > pool_limit)
+			if (!writeback_oldest ())
+				goto done;
+	}
+
+	e = kmem_cache_alloc (entry_cache);
+	if (e == NULL)
+		goto done;
+	e->page = page;
+	e->len = len;
+	e->class = class;
+	e->data = NULL;
+	if (len != 0) {
+		e->data = kmem_cache_alloc (class_cache[class]);
+		if (e->data == NULL) {
+			kmem_cache_free (entry_cache, e);
+			goto done;
+		}
+		memcpy (e->data, compress_buf, len);
+		pool_bytes += class_size[class];
+	}
+	list_push_back (&lru, &e->lru_elem);
+	page->anon.zentry = e;
+	success = true;
+
+done:
+	lock_release (&zswap_lock);
+	return success;
+}
+
+/* If PAGE is in the pool, decompresses it into KVA, removes it from
+ * the pool and returns true.  Otherwise returns false. */
+bool
+zswap_load (struct page *page, void *kva) {
+	struct zswap_entry *e;
+
+	lock_acquire (&zswap_lock);
+	e = page->anon.zentry;
+	if (e != NULL) {
+		entry_read (e, kva);
+		entry_free (e);
+	}
+	lock_release (&zswap_lock);
+	return e != NULL;
+}
+
+/* Drops PAGE from the pool, if it is there.  Also waits for any
+ * writeback of PAGE to finish, so that its swap slot is settled
+ * when this returns. */
+void
+zswap_invalidate (struct page *page) {
+	lock_acquire (&zswap_lock);
+	if (page->anon.zentry != NULL)
+		entry_free (page->anon.zentry);
+	lock_release (&zswap_lock);
+}
+
+/* LZ compression.
+ *
+ * The format is that of LZ4 blocks: a series of sequences, each a
+ * token byte whose high and low nibbles give a literal length and a
+ * match length minus LZ_MIN_MATCH, any extension bytes of the
+ * literal length, the literals, a 2-byte little-endian match
+ * offset, and any extension bytes of the match length.  A nibble of
+ * 15 is extended by bytes that are added to it, up to the first one
+ * that is not 255.  The last sequence has only literals. */
+#define LZ_MIN_MATCH 4
+#define LZ_HASH_BITS 10
+#define LZ_MAX_OFFSET 0xffff
+
+/* Returns the 4 bytes at P as an integer. */
+static inline uint32_t
+lz_load32 (const uint8_t *p) {
+	return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+/* Hashes the 4 bytes SEQ to a match table index. */
+static inline size_t
+lz_hash (uint32_t seq) {
+	return (seq * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/* Appends the extension bytes of length LEN, beyond the 15 that
+ * fit in a token, to DST at *OP.  Returns false if CAP is hit. */
+static bool
+lz_put_len (uint8_t *dst, size_t cap, size_t *op, size_t len) {
+	for (; len >= 255; len -= 255) {
+		if (*op >= cap)
+			return false;
+		dst[(*op)++] = 255;
+	}
+	if (*op >= cap)
+		return false;
+	dst[(*op)++] = len;
+	return true;
+}
+
+/* Appends a sequence to DST at *OP: LIT_LEN literal bytes from
+ * LIT, then, unless MATCH_LEN is 0, a match of MATCH_LEN bytes
+ * OFFSET bytes back.  Returns false if CAP is hit. */
+static bool
+lz_put_seq (uint8_t *dst, size_t cap, size_t *op, const uint8_t *lit,
+		size_t lit_len, size_t offset, size_t match_len) {
+	size_t m = match_len != 0 ? match_len - LZ_MIN_MATCH : 0;
+
+	if (*op >= cap)
+		return false;
+	dst[(*op)++] = (lit_len < 15 ? lit_len : 15) << 4 | (m < 15 ? m : 15);
+	if (lit_len >= 15 && !lz_put_len (dst, cap, op, lit_len - 15))
+		return false;
+	if (cap - *op < lit_len)
+		return false;
+	memcpy (dst + *op, lit, lit_len);
+	*op += lit_len;
+	if (match_len == 0)
+		return true;
+
+	if (cap - *op < 2)
+		return false;
+	dst[(*op)++] = offset;
+	dst[(*op)++] = offset >> 8;
+	return m < 15 || lz_put_len (dst, cap, op, m - 15);
+}
+
+/* Compresses the N bytes at SRC into DST, which has room for CAP
+ * bytes.  Returns the compressed size, or 0 if it would exceed CAP.
+ * Not reentrant: the match table is static, and used under
+ * zswap_lock. */
+static size_t
+lz_compress (const uint8_t *src, size_t n, uint8_t *dst, size_t cap) {
+	static uint16_t table[1 << LZ_HASH_BITS];
+	size_t ip = 0, anchor = 0, op = 0;
+
+	/* Table entries are positions plus 1, so that 0 means empty. */
+	memset (table, 0, sizeof table);
+	while (ip + LZ_MIN_MATCH <= n) {
+		uint32_t seq = lz_load32 (src + ip);
+		size_t h = lz_hash (seq);
+		size_t cand = table[h];
+
+		table[h] = ip + 1;
+		if (cand != 0 && ip - (cand - 1) <= LZ_MAX_OFFSET
+				&& lz_load32 (src + cand - 1) == seq) {
+			size_t ref = cand - 1;
+			size_t len = LZ_MIN_MATCH;
+
+			while (ip + len < n && src[ref + len] == src[ip + len])
+				len++;
+			if (!lz_put_seq (dst, cap, &op, src + anchor, ip - anchor,
+						ip - ref, len))
+				return 0;
+			ip += len;
+			anchor = ip;
+		} else
+			ip++;
+	}
+	if (!lz_put_seq (dst, cap, &op, src + anchor, n - anchor, 0, 0))
+		return 0;
+	return op;
+}
+
+/* Reads a length extension from SRC at *IP, adding it to *LEN.
+ * Returns false if the input ends first. */
+static bool
+lz_get_len (const uint8_t *src, size_t n, size_t *ip, size_t *len) {
+	uint8_t b;
+
+	do {
+		if (*ip >= n)
+			return false;
+		b = src[(*ip)++];
+		*len += b;
+	} while (b == 255);
+	return true;
+}
+
+/* Decompresses the N bytes at SRC into the OUT_N bytes at DST.
+ * Returns true if the input was well formed and filled DST
+ * exactly. */
+static bool
+lz_decompress (const uint8_t *src, size_t n, uint8_t *dst, size_t out_n) {
+	size_t ip = 0, op = 0;
+
+	while (ip < n) {
+		uint8_t token = src[ip++];
+		size_t lit_len = token >> 4;
+		size_t match_len = token & 15;
+		size_t offset;
+
+		if (lit_len == 15 && !lz_get_len (src, n, &ip, &lit_len))
+			return false;
+		if (n - ip < lit_len || out_n - op < lit_len)
+			return false;
+		memcpy (dst + op, src + ip, lit_len);
+		ip += lit_len;
+		op += lit_len;
+		if (ip == n)
+			break;
+
+		if (n - ip < 2)
+			return false;
+		offset = src[ip] | src[ip + 1] << 8;
+		ip += 2;
+		if (match_len == 15 && !lz_get_len (src, n, &ip, &match_len))
+			return false;
+		match_len += LZ_MIN_MATCH;
+		if (offset == 0 || offset > op || out_n - op < match_len)
+			return false;
+
+		/* Byte by byte: the match may overlap its own output. */
+		for (; match_len > 0; match_len--, op++)
+			dst[op] = dst[op - offset];
+	}
+	return op == out_n;
+}